@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 08:32:36 UTC 2026
+//
+// Accuracy check and benchmark of the fast modified bessel
+// functions K in TOMATH against the Kostroun integral evaluated
+// in long double with a fine step, and of the dipole theory
+// functions which use them.  Build with "make test".
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TOMATH.h"
+#include "OSCARSTH.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+
+
+
+long double Reference (double const Nu, double const x, bool const Integral)
+{
+  // Trapezoidal rule on K_nu(x) = int_0^infty exp(-x cosh t) cosh(nu t) dt, or the
+  // same divided by cosh t for the integral from x to infinity.  Scaled by exp(x).
+  long double const h = 0.02L / sqrtl(1.L + x);
+  long double Sum = 0.5L;
+  for (int r = 1; ; ++r) {
+    long double const t = r * h;
+    long double const Exponent = x * (coshl(t) - 1.L);
+    long double Term = expl(-Exponent) * coshl(Nu * t);
+    if (Integral) {
+      Term /= coshl(t);
+    }
+    Sum += Term;
+    if (Exponent - 2.L * t > 60.L) {
+      break;
+    }
+  }
+  return Sum * h * expl(-(long double) x);
+}
+
+
+
+double Benchmark (std::vector<double> const& X, std::vector<double>& K, int const Function)
+{
+  // Evaluations per second for one function over the input array
+  int const NRepeat = 20;
+  std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+  for (int i = 0; i != NRepeat; ++i) {
+    if (Function == 0) {
+      TOMATH::BesselK_1_3(X.data(), K.data(), X.size());
+    } else if (Function == 1) {
+      TOMATH::BesselK_2_3(X.data(), K.data(), X.size());
+    } else if (Function == 2) {
+      TOMATH::BesselK_5_3(X.data(), K.data(), X.size());
+    } else {
+      TOMATH::BesselK_5_3_IntegralToInfty(X.data(), K.data(), X.size());
+    }
+  }
+  std::chrono::duration<double> const Time = std::chrono::steady_clock::now() - Start;
+  return NRepeat * X.size() / Time.count();
+}
+
+
+
+int main (int argc, char* argv[])
+{
+  char const* Names[4] = {"K_1/3", "K_2/3", "K_5/3", "IntK_5/3"};
+  double const Nu[4] = {1. / 3., 2. / 3., 5. / 3., 5. / 3.};
+
+  // Accuracy: maximum relative difference on a log grid
+  std::cout << "Maximum relative difference to reference for 1e-12 < x < 600" << std::endl;
+  for (int f = 0; f != 4; ++f) {
+    double MaxRel = 0;
+    double XAtMax = 0;
+    for (double lx = -12; lx < log10(600.); lx += 0.0137) {
+      double const x = pow(10., lx);
+      double const Fast = f == 0 ? TOMATH::BesselK_1_3(x) : f == 1 ? TOMATH::BesselK_2_3(x) : f == 2 ? TOMATH::BesselK_5_3(x) : TOMATH::BesselK_5_3_IntegralToInfty(x);
+      long double const Ref = Reference(Nu[f], x, f == 3);
+      double const Rel = fabs((double) ((Fast - Ref) / Ref));
+      if (Rel > MaxRel) {
+        MaxRel = Rel;
+        XAtMax = x;
+      }
+    }
+    std::cout << std::setw(10) << Names[f] << "  " << MaxRel << "  at x = " << XAtMax << std::endl;
+  }
+
+  // Speed: typical range of arguments for dipole and wiggler spectra
+  size_t const N = 1000000;
+  std::vector<double> X(N);
+  std::vector<double> K(N);
+  for (size_t i = 0; i != N; ++i) {
+    X[i] = pow(10., -3. + 4.5 * (double) ((i * 7919) % N) / (double) N);
+  }
+
+  std::cout << "\nEvaluations per second (single core)" << std::endl;
+  for (int f = 0; f != 4; ++f) {
+    std::cout << std::setw(10) << Names[f] << "  " << Benchmark(X, K, f) / 1e6 << " M/s" << std::endl;
+  }
+
+  // Previous series evaluation for comparison
+  size_t const NSeries = 20000;
+  std::chrono::steady_clock::time_point const Start = std::chrono::steady_clock::now();
+  double Sum = 0;
+  for (size_t i = 0; i != NSeries; ++i) {
+    Sum += TOMATH::BesselK(2. / 3., X[i]);
+  }
+  std::chrono::duration<double> const Time = std::chrono::steady_clock::now() - Start;
+  std::cout << std::setw(10) << "BesselK" << "  " << NSeries / Time.count() / 1e6 << " M/s (series, nu = 2/3)" << (Sum < 0 ? " " : "") << std::endl;
+
+  // Dipole theory functions, 3 GeV beam in a 0.4 T dipole
+  OSCARSTH TH;
+  TH.SetParticleBeam(3, 0.5, TVector2D(1, 1));
+  std::vector<double> Energy_eV(N);
+  for (size_t i = 0; i != N; ++i) {
+    Energy_eV[i] = 10. + 1e4 * (double) ((i * 7919) % N) / (double) N;
+  }
+  for (int f = 0; f != 2; ++f) {
+    std::chrono::steady_clock::time_point const StartTH = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != N; ++i) {
+      K[i] = f == 0 ? TH.DipoleSpectrum(0.4, 3, 0, Energy_eV[i]) : TH.DipoleSpectrumAngleIntegrated(0.4, 3, Energy_eV[i]);
+    }
+    std::chrono::duration<double> const TimeTH = std::chrono::steady_clock::now() - StartTH;
+    std::cout << std::setw(10) << (f == 0 ? "Dipole" : "DipoleInt") << "  " << N / TimeTH.count() / 1e6 << " M/s" << std::endl;
+  }
+
+  return 0;
+}
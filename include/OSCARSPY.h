@@ -40,6 +40,9 @@ namespace OSCARSPY {
   void      ListToVectorInt (PyObject* List, std::vector<int>& V);
   PyObject* VectorIntToList (std::vector<int>& V);
 
+  void      SequenceToVectorDouble (PyObject* S, std::vector<double>& V);
+  PyObject* VectorAsMemoryView (std::vector<double> const& V, size_t const N0, size_t const N1);
+
   PyObject* TVector2DAsList (TVector2D const& V);
   PyObject* TVector3DAsList (TVector3D const& V);
 
@@ -21,8 +21,13 @@
 #include "TParticleBeamContainer.h"
 #include "TDriftVolumeContainer.h"
 #include "TSurfacePoints.h"
+#include "TSurfacePoints_Rectangle.h"
+#include "TSurfaceQuadtree.h"
+#include "TApertureCubature.h"
+#include "TTriangle3DBVH.h"
 #include "TSpectrumContainer.h"
 #include "T3DScalarContainer.h"
+#include "T4DScalarContainer.h"
 #include "TParticleTrajectoryInterpolated.h"
 #include "TRandomA.h"
 
@@ -177,12 +182,79 @@ class OSCARSSR
     std::string GetGPUInfo (int const) const;
     void SetNThreadsGlobal (int const);
     int  GetNThreadsGlobal () const;
+    void SetNProcessesGlobal (int const);
+    int  GetNProcessesGlobal () const;
+
+    // Analytic fast path for ideal configurations
+    enum OSCARSSR_AnalyticMode {
+      kAnalyticMode_Off,
+      kAnalyticMode_Auto
+    };
+    void SetAnalyticMode (std::string const& Mode, int const NValidation = 3, double const Tolerance = 0.01);
+    std::string GetAnalyticMode () const;
+    std::string const& GetLastCalculationPath () const;
+
+    // Integrator for the spectrum and flux trajectory integrals
+    enum OSCARSSR_Integrator {
+      kIntegrator_Riemann,
+      kIntegrator_Filon
+    };
+    void SetIntegrator (std::string const& Integrator);
+    std::string GetIntegrator () const;
+
+    // How convergence across trajectory levels is decided
+    enum OSCARSSR_ConvergenceMode {
+      kConvergenceMode_Level,
+      kConvergenceMode_Richardson
+    };
+    void SetConvergenceMode (std::string const& Mode);
+    std::string GetConvergenceMode () const;
+
+    // Start the level loop of each point from its neighbour's converged level
+    void SetWarmStart (bool const WarmStart);
+    bool GetWarmStart () const;
+
+    // Skip trajectory segments whose emission cone cannot reach a power density point
+    void SetEmissionConeCulling (double const ConeAngleGamma);
+    double GetEmissionConeCulling () const;
+
+    // Triangles which may shadow the points of power density calculations (0 for none)
+    void SetOccluders (TTriangle3DBVH const* Occluders, bool const PointsOnTriangles = true);
+    TTriangle3DBVH const* GetOccluders () const;
+
+    // Sets the occluders for its lifetime and turns shadowing off again when it goes
+    // out of scope, also when the calculation throws
+    class TOccludersScope
+    {
+      public:
+        TOccludersScope (OSCARSSR& SR, TTriangle3DBVH const* Occluders, bool const PointsOnTriangles = true);
+        ~TOccludersScope ();
+
+      private:
+        TOccludersScope (TOccludersScope const&);
+        TOccludersScope& operator = (TOccludersScope const&);
+
+        OSCARSSR& fSR;
+    };
 
     // Random seed setting and random numbers
     void SetSeed (int const) const;
     double GetRandomNormal () const;
     double GetRandomUniform () const;
 
+    // Checkpointing of multi-particle calculations
+    void SetCheckpoint (std::string const& FileName,
+                        int const NParticlesPerCheckpoint,
+                        bool const Resume = false);
+    void ClearCheckpoint ();
+
+    // Types of calculation stored in a checkpoint
+    enum OSCARSSR_CheckpointType {
+      kCheckpoint_Spectrum,
+      kCheckpoint_Flux,
+      kCheckpoint_PowerDensity
+    };
+
     void CalculateSpectrum (TParticleA& Particle,
                             TVector3D const& ObservationPoint,
                             TSpectrumContainer& Spectrum,
@@ -256,6 +328,21 @@ class OSCARSSR
                                int    const MaxLevelExtended = 0,
                                int    const ReturnQuantity = 0);
 
+    void CalculateSpectrumEnergySpread (TVector3D const& ObservationPoint,
+                                        TSpectrumContainer& Spectrum,
+                                        std::string const& Polarization = "all",
+                                        double const Angle = 0,
+                                        TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                        TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                        int const NThreads = 0,
+                                        int const GPU = 0,
+                                        int const NGPU = -1,
+                                        std::vector<int> VGPU = std::vector<int>(),
+                                        double const Precision = 0.01,
+                                        int    const MaxLevel = -2,
+                                        int    const MaxLevelExtended = 0,
+                                        int    const ReturnQuantity = 0);
+
     void AddToSpectrum (TSpectrumContainer const&, double const Weight = 1);
     void AddToFlux (T3DScalarContainer const&, double const Weight = 1);
     void AddToPowerDensity (T3DScalarContainer const&, double const Weight = 1);
@@ -395,6 +482,51 @@ class OSCARSSR
                                double const Weight = 1,
                                int    const ReturnQuantity = 0);
 
+    // Flux at many energies in one pass over the trajectory
+    void CalculateFluxCube (TSurfacePoints const& Surface,
+                            T4DScalarContainer& FluxContainer,
+                            std::string const& Polarization = "all",
+                            double const Angle = 0,
+                            TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                            TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                            int const NParticles = 0,
+                            int const NThreads = 0,
+                            double const Precision = 0.01,
+                            int    const MaxLevel = -2,
+                            int    const MaxLevelExtended = 0,
+                            int    const Dimension = 3);
+
+    void CalculateFluxCubePoints (TParticleA& Particle,
+                                  TSurfacePoints const& Surface,
+                                  T4DScalarContainer& FluxContainer,
+                                  size_t const iFirst,
+                                  size_t const iLast,
+                                  size_t const iEnergyFirst,
+                                  size_t const EnergyStride,
+                                  bool& Done,
+                                  std::vector<size_t>& NotConverged,
+                                  std::string const& Polarization = "all",
+                                  double const Angle = 0,
+                                  TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                  TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                  double const Precision = 0.01,
+                                  int    const MaxLevel = -2,
+                                  int    const MaxLevelExtended = 0,
+                                  double const Weight = 1);
+
+    void CalculateFluxCubeThreads (TParticleA& Particle,
+                                   TSurfacePoints const& Surface,
+                                   T4DScalarContainer& FluxContainer,
+                                   std::string const& Polarization = "all",
+                                   double const Angle = 0,
+                                   TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                   TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                   int const NThreads = 0,
+                                   double const Precision = 0.01,
+                                   int    const MaxLevel = -2,
+                                   int    const MaxLevelExtended = 0,
+                                   double const Weight = 1);
+
     void CalculateFluxGPU (TSurfacePoints const& Surface,
                            double const Energy_eV,
                            T3DScalarContainer& FluxContainer,
@@ -424,6 +556,153 @@ class OSCARSSR
                            int    const MaxLevelExtended = 0,
                            int    const ReturnQuantity = 0);
 
+    // Emittance by convolution of the filament result with the projected beam size
+    void CalculateFluxConvolution (TSurfacePoints_Rectangle const& Surface,
+                                   double const Energy_eV,
+                                   T3DScalarContainer& FluxContainer,
+                                   std::string const& Polarization = "all",
+                                   double const Angle = 0,
+                                   TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                   TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                   int const NThreads = 0,
+                                   int const GPU = 0,
+                                   int const NGPU = -1,
+                                   std::vector<int> VGPU = std::vector<int>(),
+                                   double const Precision = 0.01,
+                                   int    const MaxLevel = -2,
+                                   int    const MaxLevelExtended = 0,
+                                   int    const Dimension = 3,
+                                   int    const ReturnQuantity = 0);
+
+    void CalculatePowerDensityConvolution (TSurfacePoints_Rectangle const& Surface,
+                                           T3DScalarContainer& PowerDensityContainer,
+                                           int const Dimension,
+                                           bool const Directional,
+                                           double const Precision,
+                                           int    const MaxLevel,
+                                           int    const MaxLevelExtended,
+                                           int const NThreads,
+                                           int const GPU,
+                                           int const NGPU = -1,
+                                           std::vector<int> VGPU = std::vector<int>(),
+                                           int const ReturnQuantity = 0);
+
+    // Adaptive refinement of the cells of a rectangle, see TSurfaceQuadtree.  With
+    // NParticles one ensemble is drawn and used for every round of refinement, as it is
+    // for every point of CalculateSpectrumAperture
+    void DrawEnsemble (int const NParticles,
+                       int const GPU,
+                       std::vector<TParticleA>& Ensemble);
+    void CalculateFluxAdaptive (TSurfacePoints_Rectangle const& Surface,
+                                TSurfaceQuadtree& Tree,
+                                double const Tolerance,
+                                int const MaxDepth,
+                                double const Energy_eV,
+                                std::string const& Polarization = "all",
+                                double const Angle = 0,
+                                TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                int const NParticles = 0,
+                                int const NThreads = 0,
+                                int const GPU = 0,
+                                int const NGPU = -1,
+                                std::vector<int> VGPU = std::vector<int>(),
+                                double const Precision = 0.01,
+                                int    const MaxLevel = -2,
+                                int    const MaxLevelExtended = 0,
+                                int    const ReturnQuantity = 0);
+
+    void CalculatePowerDensityAdaptive (TSurfacePoints_Rectangle const& Surface,
+                                        TSurfaceQuadtree& Tree,
+                                        double const Tolerance,
+                                        int const MaxDepth,
+                                        bool const Directional,
+                                        double const Precision,
+                                        int    const MaxLevel,
+                                        int    const MaxLevelExtended,
+                                        int const NParticles,
+                                        int const NThreads,
+                                        int const GPU,
+                                        int const NGPU = -1,
+                                        std::vector<int> VGPU = std::vector<int>(),
+                                        int const ReturnQuantity = 0);
+
+    // Mirror symmetry of a rectangle about its centre lines in X1 and X2.  Only the
+    // fundamental half or quadrant is calculated
+    enum OSCARSSR_Symmetry {
+      kSymmetry_None = 0,
+      kSymmetry_X1   = 1,
+      kSymmetry_X2   = 2,
+      kSymmetry_X1X2 = 3,
+      kSymmetry_Auto = 4
+    };
+
+    int CalculateFluxSymmetric (TSurfacePoints_Rectangle const& Surface,
+                                int const Symmetry,
+                                double const Energy_eV,
+                                T3DScalarContainer& FluxContainer,
+                                std::string const& Polarization = "all",
+                                double const Angle = 0,
+                                TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                int const NParticles = 0,
+                                int const NThreads = 0,
+                                int const GPU = 0,
+                                int const NGPU = -1,
+                                std::vector<int> VGPU = std::vector<int>(),
+                                double const Precision = 0.01,
+                                int    const MaxLevel = -2,
+                                int    const MaxLevelExtended = 0,
+                                int    const Dimension = 3,
+                                int    const ReturnQuantity = 0);
+
+    int CalculatePowerDensitySymmetric (TSurfacePoints_Rectangle const& Surface,
+                                        int const Symmetry,
+                                        T3DScalarContainer& PowerDensityContainer,
+                                        int const Dimension,
+                                        bool const Directional,
+                                        double const Precision,
+                                        int    const MaxLevel,
+                                        int    const MaxLevelExtended,
+                                        int const NParticles,
+                                        int const NThreads,
+                                        int const GPU,
+                                        int const NGPU = -1,
+                                        std::vector<int> VGPU = std::vector<int>(),
+                                        int const ReturnQuantity = 0);
+
+    // Flux through an aperture versus energy by adaptive cubature of the spectrum over
+    // the aperture, see TApertureCubature
+    void CalculateSpectrumAperture (TApertureCubature& Aperture,
+                                    double const Tolerance,
+                                    TSpectrumContainer& Spectrum,
+                                    std::string const& Polarization = "all",
+                                    double const Angle = 0,
+                                    TVector3D const& HorizontalDirection = TVector3D(0, 0, 0),
+                                    TVector3D const& PropogationDirection = TVector3D(0, 0, 0),
+                                    int const NParticles = 0,
+                                    int const NThreads = 0,
+                                    int const GPU = 0,
+                                    int const NGPU = -1,
+                                    std::vector<int> VGPU = std::vector<int>(),
+                                    double const Precision = 0.01,
+                                    int    const MaxLevel = -2,
+                                    int    const MaxLevelExtended = 0);
+
+    void GetBeamConvolutionParameters (TSurfacePoints_Rectangle const& Surface,
+                                       TVector2D& Sigma,
+                                       int& NPadX1,
+                                       int& NPadX2);
+
+    void ConvolveRectangle (TSurfacePoints_Rectangle const& Surface,
+                            T3DScalarContainer const& PaddedContainer,
+                            T3DScalarContainer& Container,
+                            TVector2D const& Sigma,
+                            int const NPadX1,
+                            int const NPadX2,
+                            int const Dimension,
+                            int const ReturnQuantity) const;
+
     // Electric Field Calculations
     void CalculateElectricFieldTimeDomain (TVector3D const& Observer, T3DScalarContainer&);
     void CalculateElectricFieldTimeDomain (TVector3D const& Observer, T3DScalarContainer&, TParticleA& Particle);
@@ -442,6 +721,163 @@ class OSCARSSR
 
     void SetDerivativesFunction ();
 
+    void WriteCheckpoint (OSCARSSR_CheckpointType const Type,
+                          int const NParticles,
+                          int const NParticlesDone,
+                          TSpectrumContainer const* Spectrum,
+                          T3DScalarContainer const* Container) const;
+
+    int ReadCheckpoint (OSCARSSR_CheckpointType const Type,
+                        int const NParticles,
+                        TSpectrumContainer* Spectrum,
+                        T3DScalarContainer* Container);
+
+    bool CheckpointNow (int const NParticles, int const NParticlesDone) const;
+
+    int  GetNProcessesToUse (int const NParticles) const;
+
+    bool CheckAnalyticUndulator (int const NParticles,
+                                 std::string const& Polarization,
+                                 int const ReturnQuantity,
+                                 TVector3D& Source,
+                                 TVector3D& XAxis,
+                                 TVector3D& YAxis,
+                                 TVector3D& ZAxis,
+                                 double& K,
+                                 double& Period,
+                                 int& NPeriods,
+                                 double& Length,
+                                 std::string& Reason) const;
+
+    bool CalculateSpectrumAnalytic (TVector3D const& ObservationPoint,
+                                    TSpectrumContainer& Spectrum,
+                                    std::string const& Polarization,
+                                    int const NParticles,
+                                    int const NThreads,
+                                    int const ReturnQuantity);
+
+    bool CalculatePowerDensityAnalytic (TSurfacePoints const& Surface,
+                                        T3DScalarContainer& PowerDensityContainer,
+                                        bool const Directional,
+                                        double const Precision,
+                                        int    const MaxLevel,
+                                        int    const MaxLevelExtended,
+                                        int const NParticles,
+                                        int const NThreads,
+                                        int const ReturnQuantity);
+
+    bool CalculateFluxAnalytic (TSurfacePoints const& Surface,
+                                double const Energy_eV,
+                                T3DScalarContainer& FluxContainer,
+                                std::string const& Polarization,
+                                int const NParticles,
+                                int const NThreads,
+                                int const ReturnQuantity);
+
+    void GetSymmetrySample (TSurfacePoints_Rectangle const& Surface,
+                            TSurfacePoints_3D& Sample) const;
+
+    int  CheckSymmetrySample (TSurfacePoints_Rectangle const& Surface,
+                              T3DScalarContainer const& Sample,
+                              double const Tolerance) const;
+
+    void GetSymmetryPoints (TSurfacePoints_Rectangle const& Surface,
+                            int const Symmetry,
+                            TSurfacePoints_3D& Points,
+                            std::vector<size_t>& Index) const;
+
+    void FillSymmetric (TSurfacePoints_Rectangle const& Surface,
+                        T3DScalarContainer const& Fundamental,
+                        std::vector<size_t> const& Index,
+                        T3DScalarContainer& Container,
+                        int const Dimension) const;
+
+    // Convergence state of one point over the trajectory levels, shared by the spectrum,
+    // flux, and power density kernels
+    class TLevelConvergence
+    {
+      public:
+        TLevelConvergence ();
+
+        void Start (int const MinLevel, int const NeighbourLevel, bool const WarmStart);
+
+        std::vector<double>     fRombergRow;
+        std::vector<TVector3DC> fRombergRowE;
+        double fLastValue;
+        double fLastRawChange;
+        int    fThisMinLevel;
+        bool   fLastLevelPassed;
+        bool   fLastLevelSame;
+        double fPrecision;
+        int    fLevel;
+    };
+
+    bool PowerDensityLevelConverged (TLevelConvergence& State,
+                                     double const LevelSum,
+                                     int    const iLevel,
+                                     int    const MinLevel,
+                                     bool   const Resolved,
+                                     bool   const UseRichardson,
+                                     double const Precision) const;
+
+    bool FieldLevelConverged (TLevelConvergence& State,
+                              TVector3DC const& LevelSumE,
+                              int    const iLevel,
+                              int    const MinLevel,
+                              int    const StartLevel,
+                              bool   const Resolved,
+                              bool   const UseRichardson,
+                              double const Precision) const;
+
+    int  PredictLevel (TParticleA& Particle,
+                       TVector3D const& ObservationPoint,
+                       double const Omega,
+                       int const LevelStopMemory);
+
+    void FilonInterval (TVector3D const& Amplitude0,
+                        TVector3D const& DAmplitude0,
+                        double    const  Phase0,
+                        double    const  PhaseDot0,
+                        TVector3D const& Amplitude1,
+                        TVector3D const& DAmplitude1,
+                        double    const  Phase1,
+                        double    const  PhaseDot1,
+                        double    const  DT,
+                        TVector3DC& Sum,
+                        double& MaxPhaseDeviation) const;
+
+    void FilonSpread (std::vector<double>& Points, size_t const NNew) const;
+
+    TVector3DC FilonSum (std::vector<double> const& Points,
+                         double const DT,
+                         double& MaxPhaseDeviation) const;
+
+    TVector3DC EndPointsField (TParticleA const& Particle,
+                               TVector3D const& ObservationPoint,
+                               double const Omega) const;
+
+    double EndPointsPowerDensity (TParticleA const& Particle,
+                                  TVector3D const& Obs,
+                                  TVector3D const& Normal,
+                                  bool const HasNormal,
+                                  bool const Directional,
+                                  bool const UseStart,
+                                  bool const UseStop) const;
+
+    int  ForkProcesses (int const NProcesses,
+                        int const NParticles,
+                        size_t const NValues,
+                        int& NParticlesThis);
+
+    void FinishProcess (int const iProcess,
+                        TSpectrumContainer const* Spectrum,
+                        T3DScalarContainer const* Container,
+                        std::string const& Error = "");
+
+    void ReduceProcesses (int const NParticles,
+                          TSpectrumContainer* Spectrum,
+                          T3DScalarContainer* Container);
+
     void DerivativesE (double t, double x[], double dxdt[], TParticleA const&);
     void DerivativesB (double t, double x[], double dxdt[], TParticleA const&);
     void DerivativesEB (double t, double x[], double dxdt[], TParticleA const&);
@@ -463,10 +899,45 @@ class OSCARSSR
     T3DScalarContainer fFlux;
     T3DScalarContainer fPowerDensity;
 
-    // Global thread and GPU settings
+    // Global thread, process, and GPU settings
     int fNThreadsGlobal;
+    int fNProcessesGlobal;
     bool fUseGPUGlobal;
 
+    // Shared memory and process ids for multi-process calculations
+    char*  fProcessShared;
+    size_t fProcessSharedSize;
+    size_t fProcessNValues;
+    std::vector<int> fProcessIDs;
+    std::vector<int> fProcessNParticles;
+
+    // Checkpoint file, frequency, and if the next calculation should resume from it
+    std::string fCheckpointFileName;
+    int  fCheckpointNParticles;
+    bool fCheckpointResume;
+
+    // Analytic mode and a description of how the last calculation was done
+    OSCARSSR_AnalyticMode fAnalyticMode;
+    int fAnalyticNValidation;
+    double fAnalyticTolerance;
+    std::string fLastCalculationPath;
+
+    // Integrator used for spectrum and flux
+    OSCARSSR_Integrator fIntegrator;
+
+    // Convergence mode for spectrum, flux, and power density
+    OSCARSSR_ConvergenceMode fConvergenceMode;
+
+    // Warm start convergence levels from neighbouring points
+    bool fWarmStart;
+
+    // Emission cone half angle in units of 1/gamma for power density culling, 0 for off
+    double fEmissionConeCulling;
+
+    // Line of sight shadowing for power density, not owned
+    TTriangle3DBVH const* fOccluders;
+    bool fOccludersPointsOnTriangles;
+
     // Function pointer for which function to use in the RK4 propogation
     void (OSCARSSR::*fDerivativesFunction)(double, double*, double*, TParticleA const&);
 
@@ -14,6 +14,7 @@
 #include <Python.h>
 
 #include "OSCARSSR.h"
+#include "TSurfacePoints_Parametric.h"
 
 // The python OSCARSSR object
 typedef struct {
@@ -33,9 +34,12 @@ static PyObject* OSCARSSR_Me (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_Random (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_RandomNormal (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_SetSeed (OSCARSSRObject* self, PyObject* arg);
+static PyObject* OSCARSSR_SetCheckpoint (OSCARSSRObject* self, PyObject* args, PyObject* keywds);
+static PyObject* OSCARSSR_ClearCheckpoint (OSCARSSRObject* self);
 static PyObject* OSCARSSR_SetGPUGlobal (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_CheckGPU (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_SetNThreadsGlobal (OSCARSSRObject* self, PyObject* arg);
+static PyObject* OSCARSSR_SetNProcessesGlobal (OSCARSSRObject* self, PyObject* arg);
 static PyObject* OSCARSSR_GetCTStart (OSCARSSRObject* self);
 static PyObject* OSCARSSR_GetCTStop (OSCARSSRObject* self);
 static PyObject* OSCARSSR_SetCTStartStop (OSCARSSRObject* self, PyObject* args);
@@ -81,6 +85,7 @@ static PyObject* OSCARSSR_CorrectTrajectory (OSCARSSRObject* self);
 static PyObject* OSCARSSR_CalculateTrajectory (OSCARSSRObject* self);
 static PyObject* OSCARSSR_GetTrajectory (OSCARSSRObject* self);
 static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* args, PyObject* keywds);
+static PyObject* OSCARSSR_CalculateSpectrumAperture (OSCARSSRObject* self, PyObject* args, PyObject* keywds);
 static PyObject* OSCARSSR_CalculateTotalPower (OSCARSSRObject* self);
 static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject* args, PyObject *keywds);
 static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self, PyObject* args, PyObject *keywds);
@@ -99,6 +104,9 @@ static PyObject* OSCARSSR_PrintGPU (OSCARSSRObject* self);
 static PyObject* OSCARSSR_PrintAll (OSCARSSRObject* self);
 static PyObject* OSCARSSR_Fake (OSCARSSRObject* self, PyObject* args, PyObject *keywds);
 static PyObject* OSCARSSR_GetT3DScalarAsList (T3DScalarContainer const& C);
+static void OSCARSSR_PrintConvolutionValidation (T3DScalarContainer const& Convolution, T3DScalarContainer const& MonteCarlo);
+static void OSCARSSR_PrintConvolutionValidation (TSpectrumContainer const& Convolution, TSpectrumContainer const& MonteCarlo);
+static int OSCARSSR_GetParametricSurface (PyObject* PS, TVector3D const& Rotations, TVector3D const& Translation, int const Normal, TSurfacePoints_Parametric& Surface);
 
 TSpectrumContainer OSCARSSR_GetSpectrumFromList (PyObject* List);
 T3DScalarContainer OSCARSSR_GetT3DScalarContainerFromList (PyObject* List);
@@ -8,6 +8,8 @@
 //
 ////////////////////////////////////////////////////////////////////
 
+#include <vector>
+
 #include "TVector2D.h"
 #include "TOMATH.h"
 #include "TParticleBeamContainer.h"
@@ -22,6 +24,12 @@ class OSCARSTH
     OSCARSTH ();
     ~OSCARSTH ();
 
+    // Ideal undulator types for the analytic flux engine
+    enum OSCARSTH_UndulatorType {
+      kUndulatorType_Planar,
+      kUndulatorType_Helical
+    };
+
     double UndulatorK (double const BFieldMax,
                        double const Period) const;
 
@@ -31,19 +39,33 @@ class OSCARSTH
     double UndulatorPeriod (double const BField,
                             double const K) const;
 
+    double UndulatorBFieldGap (double const Gap,
+                               double const Period,
+                               double const A,
+                               double const B,
+                               double const C = 0) const;
+
     double DipoleCriticalEnergy (double const BField) const;
 
     void DipoleSpectrumEnergy (double const BField, 
                                TSpectrumContainer& Spectrum,
-                               double const Angle) const;
+                               double const Angle,
+                               int const NThreads = 0) const;
 
     void DipoleSpectrumAngle (double const BField, 
                               TSpectrumContainer& Spectrum,
-                              double const Energy_eV) const;
+                              double const Energy_eV,
+                              int const NThreads = 0) const;
 
     void DipoleSpectrumEnergyAngleIntegrated (double const BField, 
                                               TSpectrumContainer& Spectrum) const;
 
+    void DipoleSpectrumGrid (double const BField,
+                             std::vector<double> const& Energies_eV,
+                             std::vector<double> const& Angles,
+                             std::vector<double>& Flux,
+                             int const NThreads = 0) const;
+
     double DipoleSpectrum (double const BField,
                            double const BeamEnergy_GeV,
                            double const Angle,
@@ -61,6 +83,52 @@ class OSCARSTH
                           double const AngleH,
                           double const Energy_eV) const;
 
+    void UndulatorFluxAngles (double const K,
+                              double const Period,
+                              int    const NPeriods,
+                              std::vector<double> const& AnglesH,
+                              std::vector<double> const& AnglesV,
+                              std::vector<double> const& Energies_eV,
+                              std::vector<double>& Flux,
+                              OSCARSTH_UndulatorType const Type = kUndulatorType_Planar,
+                              int const NThreads = 0) const;
+
+    void UndulatorFluxSpectrum (double const K,
+                                double const Period,
+                                int    const NPeriods,
+                                double const AngleH,
+                                double const AngleV,
+                                TSpectrumContainer& Spectrum,
+                                OSCARSTH_UndulatorType const Type = kUndulatorType_Planar,
+                                int const NThreads = 0) const;
+
+    void UndulatorFluxSurface (double         const  K,
+                               double         const  Period,
+                               int            const  NPeriods,
+                               TSurfacePoints const& Surface,
+                               double         const  Energy_eV,
+                               T3DScalarContainer&   FluxContainer,
+                               OSCARSTH_UndulatorType const Type = kUndulatorType_Planar,
+                               int            const  Dimension = 3,
+                               int            const  NThreads = 0) const;
+
+
+    void UndulatorPowerDensityAngles (double const K,
+                                      double const Period,
+                                      int    const NPeriods,
+                                      std::vector<double> const& AnglesH,
+                                      std::vector<double> const& AnglesV,
+                                      std::vector<double>& PowerDensity,
+                                      int const NThreads = 0) const;
+
+    void UndulatorPowerDensitySurface (double         const  K,
+                                       double         const  Period,
+                                       int            const  NPeriods,
+                                       TSurfacePoints const& Surface,
+                                       T3DScalarContainer&   PowerDensityContainer,
+                                       bool           const  Directional = true,
+                                       int            const  Dimension = 3,
+                                       int            const  NThreads = 0) const;
 
     TVector2D UndulatorFluxOnAxisK (double const K,
                                     double const Period,
@@ -79,7 +147,8 @@ class OSCARSTH
                               int const Harmonic) const;
 
     void DipoleBrightness (double const BField,
-                           TSpectrumContainer& SpectrumContainer) const;
+                           TSpectrumContainer& SpectrumContainer,
+                           int const NThreads = 0) const;
 
     double UndulatorEnergyAtHarmonicK (double const K,
                                        double const Period,
@@ -99,6 +168,24 @@ class OSCARSTH
                                     int    const NPeriods,
                                     int    const N) const;
 
+    void UndulatorBrightnessKGrid (std::vector<double> const& K,
+                                   std::vector<int>    const& Harmonics,
+                                   double              const  Period,
+                                   int                 const  NPeriods,
+                                   std::vector<double>&       Energies_eV,
+                                   std::vector<double>&       Brightness,
+                                   int                 const  NThreads = 0) const;
+
+    void UndulatorTuningCurves (std::vector<double> const& K,
+                                std::vector<int>    const& Harmonics,
+                                double              const  Period,
+                                int                 const  NPeriods,
+                                std::vector<double>&       Energies_eV,
+                                std::vector<double>&       Flux,
+                                std::vector<double>&       Brightness,
+                                bool                const  WithBrightness = false,
+                                int                 const  NThreads = 0) const;
+
 
     void WigglerFluxK (double         const  K,
                        double         const  Period,
@@ -136,6 +223,14 @@ class OSCARSTH
                              bool& Done
                             ) const;
 
+    void WigglerFluxKEnergies (double              const  K,
+                               double              const  Period,
+                               int                 const  NPeriods,
+                               TSurfacePoints      const& Surface,
+                               std::vector<double> const& Energies_eV,
+                               std::vector<double>&       Flux,
+                               int                 const  NThreads = 0) const;
+
 
 
 
@@ -164,6 +259,68 @@ class OSCARSTH
     void SetNThreadsGlobal (int const);
 
   private:
+    int GetNThreadsToUse (int const NThreads) const;
+
+    double UndulatorFluxAngle (double const K,
+                               double const Period,
+                               int    const NPeriods,
+                               double const Gamma,
+                               double const AngleH,
+                               double const AngleV,
+                               double const Energy_eV,
+                               OSCARSTH_UndulatorType const Type,
+                               std::vector<double>& JX,
+                               std::vector<double>& JY) const;
+
+    void UndulatorFluxAnglesPoints (double const K,
+                                    double const Period,
+                                    int    const NPeriods,
+                                    std::vector<double> const& AnglesH,
+                                    std::vector<double> const& AnglesV,
+                                    std::vector<double> const& Energies_eV,
+                                    std::vector<double>& Flux,
+                                    OSCARSTH_UndulatorType const Type,
+                                    size_t const iFirst,
+                                    size_t const iLast) const;
+
+    void UndulatorPowerDensityAnglesPoints (double const K,
+                                            double const Period,
+                                            int    const NPeriods,
+                                            std::vector<double> const& AnglesH,
+                                            std::vector<double> const& AnglesV,
+                                            std::vector<double>& PowerDensity,
+                                            size_t const iFirst,
+                                            size_t const iLast) const;
+
+    void DipoleSpectrumGridPoints (double const BField,
+                                   std::vector<double> const& Energies_eV,
+                                   std::vector<double> const& Angles,
+                                   std::vector<double>& Flux,
+                                   size_t const iFirst,
+                                   size_t const iLast) const;
+
+    void WigglerFluxKEnergiesPoints (double              const  K,
+                                     double              const  Period,
+                                     int                 const  NPeriods,
+                                     TSurfacePoints      const& Surface,
+                                     std::vector<double> const& Energies_eV,
+                                     std::vector<double>&       Flux,
+                                     size_t              const  iFirst,
+                                     size_t              const  iLast) const;
+
+    void UndulatorTuningCurvesPoints (std::vector<double> const& K,
+                                      std::vector<double> const& KFactor,
+                                      std::vector<double> const& BesselArg,
+                                      std::vector<int>    const& Harmonics,
+                                      double              const  Period,
+                                      int                 const  NPeriods,
+                                      std::vector<double>&       Energies_eV,
+                                      std::vector<double>&       Flux,
+                                      std::vector<double>&       Brightness,
+                                      bool                const  WithBrightness,
+                                      size_t              const  iFirst,
+                                      size_t              const  iLast) const;
+
     TParticleBeam fParticleBeam;
 
     // Global thread and GPU settings
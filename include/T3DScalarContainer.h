@@ -12,6 +12,7 @@
 
 #include <fstream>
 #include <vector>
+#include <cstdint>
 #include <string>
 #include <stdexcept>
 
@@ -64,10 +65,14 @@ class T3DScalarContainer
 
     void SetNotConverged (size_t const);
     bool AllConverged () const;
+    bool IsConverged (size_t const) const;
 
     void Clear ();
     void AverageFromFilesText (std::vector<std::string> const&, int const Dimension);
     void AverageFromFilesBinary (std::vector<std::string> const&, int const Dimension);
+    void AverageFromFilesChunked (std::vector<std::string> const&,
+                                  int const NThreads = 1,
+                                  std::string const& OutFileName = "");
 
     void WeightAll (double const Weight);
 
@@ -81,6 +86,13 @@ class T3DScalarContainer
     void WriteToFileBinary (std::string const& OutFileName,
                             int const Dimension);
 
+    void WriteToFileChunked (std::string const& OutFileName,
+                             double const Weight,
+                             uint64_t const NParticles) const;
+
+    void WriteCheckpoint (std::ostream&) const;
+    void ReadCheckpoint (std::istream&);
+
   private:
     std::vector<T3DScalar> fValues;
     std::vector<double> fCompensation;
@@ -0,0 +1,79 @@
+#ifndef GUARD_T4DScalarContainer_h
+#define GUARD_T4DScalarContainer_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 11:18:47 UTC 2026
+//
+// T4DScalarContainer
+//
+//   Scalar values at a set of points in space (x, y, z) for each of
+//   a set of energies, eg a flux map at many photon energies.  The
+//   values of a point are contiguous (its spectrum) and a slice at
+//   one energy is a T3DScalarContainer.
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TVector3D.h"
+#include "T3DScalarContainer.h"
+#include "TSpectrumContainer.h"
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+class T4DScalarContainer
+{
+  public:
+    T4DScalarContainer ();
+    ~T4DScalarContainer ();
+
+    void SetEnergies (std::vector<double> const& Energies);
+    void AddPoint (TVector3D const& X);
+    void AddToPoint (size_t const iPoint, size_t const iEnergy, double const V);
+
+    void SetNotConverged (size_t const iPoint);
+    bool AllConverged () const;
+    bool IsConverged (size_t const iPoint) const;
+
+    void Clear ();
+
+    size_t GetNPoints () const;
+    size_t GetNEnergies () const;
+
+    TVector3D const& GetPoint (size_t const iPoint) const;
+    double GetEnergy (size_t const iEnergy) const;
+    std::vector<double> const& GetEnergies () const;
+    double GetValue (size_t const iPoint, size_t const iEnergy) const;
+    double const* GetSpectrumValues (size_t const iPoint) const;
+
+    void GetEnergySlice (size_t const iEnergy, T3DScalarContainer& Slice) const;
+    void GetSpectrum (size_t const iPoint, TSpectrumContainer& Spectrum) const;
+
+    void WriteToFileText (std::string const& OutFileName,
+                          int const Dimension) const;
+
+    void WriteToFileBinary (std::string const& OutFileName,
+                            int const Dimension) const;
+
+  private:
+    std::vector<double>    fEnergies;
+    std::vector<TVector3D> fX;
+
+    // Values of point i at energy k are at [i * NEnergies + k]
+    std::vector<double> fValues;
+    std::vector<char>   fNotConverged;
+};
+
+
+
+
+
+
+
+
+
+
+
+#endif
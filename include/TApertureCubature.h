@@ -0,0 +1,120 @@
+#ifndef GUARD_TApertureCubature_h
+#define GUARD_TApertureCubature_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 11:07:17 UTC 2026
+//
+// TApertureCubature
+//
+//   Adaptive 2D Simpson cubature over a rectangular or circular
+//   aperture of a quantity with many values per point (eg a spectrum).
+//   Each cell is integrated with the 3x3 rule and with the rule on its
+//   four children; cells where the error estimated from the difference
+//   is more than their share of the tolerance are split.  Points are on
+//   a lattice so that they are shared between neighbouring cells and
+//   between a cell and its children.  The points still to be calculated
+//   are handed out in batches, see TSurfaceQuadtree.
+//
+////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "TVector3D.h"
+
+class TApertureCubature
+{
+  public:
+    TApertureCubature ();
+    ~TApertureCubature ();
+
+    void InitRectangle (TVector3D const& Center,
+                        TVector3D const& X1Vector,
+                        TVector3D const& X2Vector,
+                        double const Width1,
+                        double const Width2,
+                        int const MaxDepth);
+
+    void InitCircle (TVector3D const& Center,
+                     TVector3D const& X1Vector,
+                     TVector3D const& X2Vector,
+                     double const Radius,
+                     int const MaxDepth);
+
+    size_t GetPending (std::vector<TVector3D>& Points) const;
+    void SetPending (std::vector<double> const& Values, size_t const NValues);
+    size_t Refine (double const Tolerance);
+
+    std::vector<double> const& GetIntegral () const;
+    std::vector<double> const& GetError () const;
+    double GetArea () const;
+
+    size_t GetNPoints () const;
+    size_t GetNCells () const;
+
+    void Clear ();
+
+    enum TApertureCubature_Shape {
+      kShape_Rectangle,
+      kShape_Circle
+    };
+
+  private:
+    void Init (int const NCells1,
+               int const NCells2,
+               double const Start1,
+               double const Extent1,
+               double const Start2,
+               double const Extent2,
+               int const MaxDepth);
+    size_t AddNode (int const I, int const J);
+    void AddCell (int const I, int const J, int const Size);
+    void Simpson (int const I, int const J, int const Size, std::vector<double>& Sum) const;
+    double GetJacobian (int const I) const;
+
+    // Shape and plane of the aperture.  Parameters are (x1, x2) for the rectangle and
+    // (r, phi) for the circle
+    TApertureCubature_Shape fShape;
+    TVector3D fCenter;
+    TVector3D fX1Vector;
+    TVector3D fX2Vector;
+    double fStart1;
+    double fStart2;
+    double fStep1;
+    double fStep2;
+    double fArea;
+
+    // Lattice: fNI x fNJ points, wrapped in J for the circle
+    int fNI;
+    int fNJ;
+
+    // Points on the lattice and their values (fNValues each)
+    std::map<uint64_t, size_t> fNodeIndex;
+    std::vector<int>    fNodeI;
+    std::vector<int>    fNodeJ;
+    std::vector<size_t> fPending;
+    std::vector<double> fNodeValue;
+    size_t fNValues;
+
+    // Cells being tested: lower corner and size on the lattice
+    std::vector<int> fCellI;
+    std::vector<int> fCellJ;
+    std::vector<int> fCellSize;
+    size_t fNCells;
+
+    // Integral and estimated error of the accepted cells
+    std::vector<double> fIntegral;
+    std::vector<double> fError;
+};
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef GUARD_TEmissionCones_h
+#define GUARD_TEmissionCones_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:10:13 UTC 2026
+//
+// TEmissionCones
+//
+//   The trajectory split into equal segments in time, each with a
+//   bounding sphere for the position and a bounding cone for the
+//   direction of beta.  Used to find which parts of the trajectory
+//   can radiate towards an observation point.
+//
+////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include "TVector3D.h"
+#include "TParticleTrajectoryInterpolated.h"
+
+class TEmissionCones
+{
+  public:
+    TEmissionCones ();
+    ~TEmissionCones ();
+
+    void Build (TParticleTrajectoryInterpolated const& Trajectory,
+                size_t const NSegments,
+                size_t const NSamplesPerSegment);
+
+    size_t GetNSegments () const;
+
+    size_t GetSegment (size_t const iT, size_t const NTPoints) const;
+
+    TVector3D const& GetCenter (size_t const i) const;
+    double GetRadius (size_t const i) const;
+
+    size_t Visible (TVector3D const& Obs,
+                    double const ConeAngle,
+                    std::vector<char>& Mask) const;
+
+    size_t Facing (TVector3D const& Obs,
+                   TVector3D const& Normal,
+                   std::vector<char>& Mask) const;
+
+    void Clear ();
+
+  private:
+    std::vector<TVector3D> fCenter;     // Centre of the bounding sphere
+    std::vector<double>    fRadius;     // Radius of the bounding sphere
+    std::vector<TVector3D> fDirection;  // Unit vector along the mean beta
+    std::vector<double>    fHalfAngle;  // Largest angle of beta from fDirection
+};
+
+
+
+
+
+
+
+
+#endif
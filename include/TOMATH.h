@@ -11,6 +11,8 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <complex>
+#include <cmath>
 
 #include "TVector3D.h"
 
@@ -20,10 +22,52 @@ namespace TOMATH
 // Modified bessel function K
 double BesselK  (double const nu, double const x);
 double BesselK_IntegralToInfty (double const nu, double const x);
+
+// Fast modified bessel functions K for the orders used in synchrotron radiation,
+// relative accuracy better than 1e-13 for all x > 0.  Array versions fill K[i]
+// for N points in x
+double BesselK_1_3 (double const x);
+double BesselK_2_3 (double const x);
+double BesselK_5_3 (double const x);
+double BesselK_5_3_IntegralToInfty (double const x);
+void   BesselK_1_3_2_3 (double const x, double& K_1_3, double& K_2_3);
+void   BesselK_1_3 (double const* x, double* K, size_t const N);
+void   BesselK_2_3 (double const* x, double* K, size_t const N);
+void   BesselK_5_3 (double const* x, double* K, size_t const N);
+void   BesselK_5_3_IntegralToInfty (double const* x, double* K, size_t const N);
+
 double BesselJ0 (double const x);
 double BesselJ1 (double const x);
 double BesselJ  (int    const nu, double const x);
 
+// Bessel J_0 to J_NMax of the same argument in double precision by
+// backward recurrence, J must have room for NMax + 1 values
+void   BesselJ_Sequence (int const NMax, double const x, double* J);
+
+// Filon weights for one interval with a cubic Hermite amplitude and linear phase
+// advancing by Delta, W must have room for 4 values
+void   FilonWeights (double const Delta, std::complex<double>* W);
+
+
+
+
+template <class T> T RombergNext (std::vector<T>& Row, T const& Value, size_t const Depth)
+{
+  // Romberg extrapolation for a sequence of trapezoid estimates where each
+  // halves the step size.  Row holds the previous row of the Romberg table and
+  // is replaced by the row for Value.  At most Depth extrapolations are done.
+  // Returns the most extrapolated value of the new row.
+  std::vector<T> Last;
+  Last.swap(Row);
+
+  Row.push_back(Value);
+  for (size_t k = 1; k <= Last.size() && k <= Depth; ++k) {
+    Row.push_back(Row[k - 1] + (Row[k - 1] - Last[k - 1]) / (pow(4., (double) k) - 1.));
+  }
+
+  return Row.back();
+}
+
 
 
 
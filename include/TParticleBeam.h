@@ -123,6 +123,8 @@ class TParticleBeam : public TParticleA
 
     TVector2D GetEmittance () const;
 
+    TVector2D GetProjectedSigma (double const L) const;
+
     void SetEta (TVector2D const&);
     TVector2D GetEta () const;
 
@@ -9,6 +9,7 @@
 ////////////////////////////////////////////////////////////////////
 
 #include <random>
+#include <iostream>
 
 
 
@@ -24,6 +25,9 @@ class TRandomA
     double Normal ();
     double Uniform ();
 
+    void WriteState (std::ostream&) const;
+    void ReadState (std::istream&);
+
   private:
     std::random_device* fRD;
     std::mt19937* fMT;
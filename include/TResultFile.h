@@ -0,0 +1,98 @@
+#ifndef GUARD_TResultFile_h
+#define GUARD_TResultFile_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 08:22:16 UTC 2026
+//
+// Chunked binary result files.  A file has a header with the
+// point coordinates followed by any number of appended chunks,
+// each with a weight, number of particles, and one value per
+// point.  Files are merged with a bounded-memory, multi-threaded
+// reduction which never has more than one file per thread open.
+//
+// Layout (native byte order):
+//   char[8]  "OSCARSRF"
+//   int32    version
+//   int32    type
+//   int32    number of coordinates per point
+//   int32    reserved
+//   uint64   number of points
+//   double   coordinates [points * coordinates]
+//   chunks:  double weight, uint64 nparticles, double values [points]
+//
+////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class TResultFile
+{
+  public:
+    TResultFile ();
+    ~TResultFile ();
+
+    // Types of results stored
+    enum TResultFile_Type {
+      kResultFile_Spectrum,
+      kResultFile_T3DScalar
+    };
+
+    void Init (TResultFile_Type const Type,
+               int const NCoordinates,
+               std::vector<double> const& Coordinates,
+               std::vector<double> const& Values,
+               double const Weight,
+               uint64_t const NParticles);
+
+    void AppendToFile (std::string const& FileName) const;
+
+    void MergeFromFiles (std::vector<std::string> const& FileNames,
+                         int const NThreads = 1);
+
+    void WriteToFile (std::string const& FileName) const;
+
+    TResultFile_Type GetType () const;
+    int GetNCoordinates () const;
+    size_t GetNPoints () const;
+
+    std::vector<double> const& GetCoordinates () const;
+    std::vector<double> const& GetValues () const;
+    double GetWeight () const;
+    uint64_t GetNParticles () const;
+
+  private:
+    void MergeFromFilesPartial (std::vector<std::string> const& FileNames,
+                                size_t const iFirst,
+                                size_t const iLast,
+                                std::vector<double>& Sum,
+                                std::vector<double>& Compensation,
+                                double& Weight,
+                                uint64_t& NParticles,
+                                std::string& Error) const;
+
+    void ReadHeader (std::istream& is,
+                     TResultFile_Type& Type,
+                     int& NCoordinates,
+                     uint64_t& NPoints) const;
+
+    void WriteHeader (std::ostream& os) const;
+
+    TResultFile_Type fType;
+    int fNCoordinates;
+
+    std::vector<double> fCoordinates;
+    std::vector<double> fValues;
+    double   fWeight;
+    uint64_t fNParticles;
+};
+
+
+
+
+
+
+
+#endif
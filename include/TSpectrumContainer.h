@@ -10,6 +10,8 @@
 
 #include <vector>
 #include <string>
+#include <iostream>
+#include <cstdint>
 
 class TSpectrumContainer
 {
@@ -29,6 +31,7 @@ class TSpectrumContainer
 
     void SetNotConverged (size_t const);
     bool AllConverged () const;
+    bool IsConverged (size_t const) const;
 
     void   Scale       (double const);
     double GetFlux     (size_t const) const;
@@ -39,9 +42,19 @@ class TSpectrumContainer
     void WriteToFileText (std::string const, std::string const Header = "") const;
     void WriteToFileBinary (std::string const, std::string const Header = "") const;
 
+    void WriteToFileChunked (std::string const& OutFileName,
+                             double const Weight,
+                             uint64_t const NParticles) const;
+
+    void WriteCheckpoint (std::ostream&) const;
+    void ReadCheckpoint (std::istream&);
+
     void Clear ();
     void AverageFromFilesText (std::vector<std::string> const&);
     void AverageFromFilesBinary (std::vector<std::string> const&);
+    void AverageFromFilesChunked (std::vector<std::string> const&,
+                                  int const NThreads = 1,
+                                  std::string const& OutFileName = "");
 
   private:
 
@@ -29,6 +29,32 @@ class TSurfacePoints
 
     virtual bool HasNormal () const = 0;
 
+    // Positions and normals of N points starting at iFirst into contiguous arrays
+    // (normals are skipped if NX is 0x0).  Surfaces which store their points in
+    // arrays override this to avoid a GetPoint() call for every point.
+    virtual void GetArrays (size_t const iFirst,
+                            size_t const N,
+                            double* X,
+                            double* Y,
+                            double* Z,
+                            double* NX,
+                            double* NY,
+                            double* NZ) const
+    {
+      for (size_t i = 0; i != N; ++i) {
+        TSurfacePoint const P = this->GetPoint(iFirst + i);
+        X[i] = P.GetX();
+        Y[i] = P.GetY();
+        Z[i] = P.GetZ();
+        if (NX != 0x0) {
+          NX[i] = P.GetNormalX();
+          NY[i] = P.GetNormalY();
+          NZ[i] = P.GetNormalZ();
+        }
+      }
+      return;
+    }
+
 };
 
 #endif
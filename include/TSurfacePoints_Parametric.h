@@ -0,0 +1,109 @@
+#ifndef GUARD_TSurfacePoints_Parametric_h
+#define GUARD_TSurfacePoints_Parametric_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:57:41 UTC 2026
+//
+// Parametric surfaces (rectangle, curved rectangle, cylinder,
+// sphere, torus, cone, disk) on a grid in their u and v parameters,
+// the same as oscars.parametric_surfaces.  Points and normals are
+// generated once and stored in contiguous arrays.
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TSurfacePoints.h"
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+class TSurfacePoints_Parametric : public TSurfacePoints
+{
+  public:
+    TSurfacePoints_Parametric ();
+    TSurfacePoints_Parametric (std::string const& Shape,
+                               std::vector<double> const& Parameters,
+                               double const UStart,
+                               double const UStop,
+                               int    const NU,
+                               double const VStart,
+                               double const VStop,
+                               int    const NV,
+                               TVector3D const& Rotations,
+                               TVector3D const& Translation,
+                               int    const Normal);
+    ~TSurfacePoints_Parametric ();
+
+    void Init (std::string const& Shape,
+               std::vector<double> const& Parameters,
+               double const UStart,
+               double const UStop,
+               int    const NU,
+               double const VStart,
+               double const VStop,
+               int    const NV,
+               TVector3D const& Rotations,
+               TVector3D const& Translation,
+               int    const Normal);
+
+    TSurfacePoint const GetPoint (size_t const) const;
+    size_t GetNPoints () const;
+
+    // The u and v parameters of a point
+    double GetX1 (size_t const) const;
+    double GetX2 (size_t const) const;
+
+    bool HasNormal () const
+    {
+      return true;
+    }
+
+    void GetArrays (size_t const iFirst,
+                    size_t const N,
+                    double* X,
+                    double* Y,
+                    double* Z,
+                    double* NX,
+                    double* NY,
+                    double* NZ) const;
+
+    int GetNU () const;
+    int GetNV () const;
+
+    enum TSurfacePoints_Parametric_Shape {
+      kShape_Rectangle,
+      kShape_CurvedRectangle,
+      kShape_Cylinder,
+      kShape_Sphere,
+      kShape_Torus,
+      kShape_Cone,
+      kShape_Disk
+    };
+
+  private:
+    void Evaluate (double const U, double const V, TVector3D& X, TVector3D& N) const;
+
+    TSurfacePoints_Parametric_Shape fShape;
+    std::vector<double> fParameters;
+
+    double fUStart;
+    double fUStep;
+    int    fNU;
+    double fVStart;
+    double fVStep;
+    int    fNV;
+
+    std::vector<double> fX;
+    std::vector<double> fY;
+    std::vector<double> fZ;
+    std::vector<double> fNX;
+    std::vector<double> fNY;
+    std::vector<double> fNZ;
+};
+
+
+
+
+#endif
@@ -34,6 +34,16 @@ class TSurfacePoints_Rectangle : public TSurfacePoints
 
     double GetElementArea () const;
 
+    int GetNX1 () const;
+    int GetNX2 () const;
+    int GetNormal () const;
+    TVector3D const& GetX1Vector () const;
+    TVector3D const& GetX2Vector () const;
+    TVector3D const& GetStartVector () const;
+    TVector3D GetCenter () const;
+
+    void GetPadded (int const NPadX1, int const NPadX2, TSurfacePoints_Rectangle& Padded) const;
+
     bool HasNormal () const
     {
       return true;
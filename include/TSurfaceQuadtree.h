@@ -0,0 +1,96 @@
+#ifndef GUARD_TSurfaceQuadtree_h
+#define GUARD_TSurfaceQuadtree_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:48:59 UTC 2026
+//
+// TSurfaceQuadtree
+//
+//   Adaptive refinement of the cells of a rectangle.  Each cell of
+//   the coarse grid is split into four while the value at the edge
+//   midpoints and centre differs from the bilinear interpolation of
+//   its corners by more than a tolerance.  Neighbouring leaves differ
+//   by at most one level (2:1 balance).  Points are on a lattice
+//   2^MaxDepth finer than the coarse grid so that they are shared
+//   between neighbouring cells.  The points still to be calculated
+//   are handed out in batches so that any calculation (cpu threads,
+//   gpu) can be used for them.
+//
+////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "TVector3D.h"
+#include "TSurfacePoints_Rectangle.h"
+#include "TSurfacePoints_3D.h"
+#include "T3DScalarContainer.h"
+
+class TSurfaceQuadtree
+{
+  public:
+    TSurfaceQuadtree ();
+    ~TSurfaceQuadtree ();
+
+    void Init (TSurfacePoints_Rectangle const& Surface, int const MaxDepth);
+
+    size_t GetPending (TSurfacePoints_3D& Points) const;
+    void SetPending (T3DScalarContainer const& Values);
+    size_t Refine (double const Tolerance);
+
+    void Fill (T3DScalarContainer& Container, int const Dimension) const;
+    void Resample (int const NX1,
+                   int const NX2,
+                   T3DScalarContainer& Container,
+                   int const Dimension) const;
+
+    size_t GetNPoints () const;
+    size_t GetNCells () const;
+    size_t GetNLeaves () const;
+
+    void Clear ();
+
+  private:
+    size_t AddNode (int const I, int const J);
+    void AddCell (int const I, int const J, int const Size);
+    void Test (int const iCell);
+    bool IsUnbalanced (int const iCell) const;
+    bool HasNode (int const I, int const J) const;
+    double GetValue (int const I, int const J) const;
+    double Interpolate (double const U, double const V) const;
+
+    // Coarse surface and the lattice: fScale lattice steps per coarse step, fNJ
+    // lattice points in X2
+    TSurfacePoints_Rectangle fSurface;
+    int fScale;
+    int fNJ;
+
+    // Points on the lattice
+    std::map<uint64_t, size_t> fNodeIndex;
+    std::vector<int>    fNodeI;
+    std::vector<int>    fNodeJ;
+    std::vector<double> fNodeValue;
+    std::vector<char>   fNodeConverged;
+    std::vector<size_t> fPending;
+
+    // Cells: lower corner and size on the lattice, first child (-1 for leaf)
+    std::vector<int> fCellI;
+    std::vector<int> fCellJ;
+    std::vector<int> fCellSize;
+    std::vector<int> fCellChild;
+
+    // Cells whose midpoints are being calculated
+    std::vector<int> fActive;
+};
+
+
+
+
+
+
+
+
+#endif
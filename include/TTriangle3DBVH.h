@@ -0,0 +1,71 @@
+#ifndef GUARD_TTriangle3DBVH_h
+#define GUARD_TTriangle3DBVH_h
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:40:16 UTC 2026
+//
+// TTriangle3DBVH
+//
+//   Bounding volume hierarchy of axis aligned boxes over a set of
+//   triangles for line of sight (occlusion) tests.  Nodes are
+//   stored in a flat array, children of an inner node are stored
+//   next to each other.
+//
+////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include "TVector3D.h"
+#include "TTriangle3DContainer.h"
+
+class TTriangle3DBVH
+{
+  public:
+    TTriangle3DBVH ();
+    TTriangle3DBVH (TTriangle3DContainer const& Triangles);
+    ~TTriangle3DBVH ();
+
+    void Build (TTriangle3DContainer const& Triangles);
+
+    bool Occluded (TVector3D const& From,
+                   TVector3D const& To,
+                   size_t const Ignore) const;
+
+    size_t GetNTriangles () const;
+    size_t GetNNodes () const;
+
+    void Clear ();
+
+  private:
+    bool IntersectBox (int const iNode,
+                       TVector3D const& From,
+                       TVector3D const& InverseD) const;
+
+    bool IntersectTriangle (size_t const iT,
+                            TVector3D const& From,
+                            TVector3D const& D) const;
+
+    // Nodes: bounding box, first child (-1 for leaf), and range in fIndex
+    std::vector<TVector3D> fNodeMin;
+    std::vector<TVector3D> fNodeMax;
+    std::vector<int>       fNodeChild;
+    std::vector<size_t>    fNodeFirst;
+    std::vector<size_t>    fNodeCount;
+
+    // Triangles as a vertex and two edges, and the original triangle index
+    std::vector<TVector3D> fA;
+    std::vector<TVector3D> fE1;
+    std::vector<TVector3D> fE2;
+    std::vector<size_t>    fIndex;
+};
+
+
+
+
+
+
+
+
+#endif
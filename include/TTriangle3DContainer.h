@@ -11,6 +11,7 @@
 #include "TTriangle3D.h"
 
 #include <vector>
+#include <string>
 #include <iostream>
 #include <fstream>
 
@@ -33,12 +34,36 @@ class TTriangle3DContainer
                       double const Scale);
 
     void WriteSTLFile (std::string const& FileName);
+    void WriteSTLFile (std::string const& FileName,
+                       std::vector<double> const& Values);
+    void WritePLYFile (std::string const& FileName,
+                       std::vector<double> const& Values,
+                       bool const PerVertex);
+
+    // Indexed mesh of unique vertices
+    void WeldVertices (double const Tolerance = 0);
+    size_t GetNVertices () const;
+    TVector3D const& GetVertex (size_t const i) const;
+    TVector3D const& GetVertexNormal (size_t const i) const;
+    size_t GetVertexIndex (size_t const iTriangle, int const iCorner) const;
 
 
 
   private:
+    void ReadSTLBinary (char const* Buffer,
+                        size_t const Size,
+                        double const Scale);
+    bool ReadSTLASCII (char const* Buffer,
+                       size_t const Size,
+                       double const Scale);
+
     std::vector<TTriangle3D> fT;
 
+    // Unique vertices, their normals, and three vertex indices per triangle
+    std::vector<TVector3D> fVertices;
+    std::vector<TVector3D> fVertexNormals;
+    std::vector<size_t>    fFaces;
+
     TVector3D fBBox[2];
     double fScale;
 };
@@ -3,6 +3,9 @@ from math import sin, cos, sqrt, pi
 class PSRectangle:
     """A Parametric surface - rectangle"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'rectangle'
+
     # This shape specific parameters
     L = 1
     W = 1
@@ -29,6 +32,13 @@ class PSRectangle:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return []
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
@@ -55,6 +65,9 @@ class PSRectangle:
 class PSCurvedRectangle:
     """A Parametric surface - curved rectangle"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'curvedrectangle'
+
     # This shape specific parameters
     L = 1
     W = 1
@@ -83,12 +96,23 @@ class PSCurvedRectangle:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return [self.R]
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
-        x = u
+        # Bent along u on a cylinder of radius R (flat for R = 0)
+        if self.R == 0:
+            return [u, v, 0]
+
+        x = self.R * sin(u / self.R)
         y = v
-        z = 0
+        z = self.R * (1 - cos(u / self.R))
         
         return [x, y, z]
     
@@ -97,9 +121,12 @@ class PSCurvedRectangle:
     def normal (self, u, v):
         """Return a unit normal in 3D at this u and v position"""
 
-        xn = 0
+        if self.R == 0:
+            return [0, 0, 1]
+
+        xn = -sin(u / self.R)
         yn = 0
-        zn = 1
+        zn = cos(u / self.R)
         
         return [xn, yn, zn]
 
@@ -109,6 +136,9 @@ class PSCurvedRectangle:
 class PSTorus:
     """A Parametric surface - torus"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'torus'
+
     # This shape specific parameters
     R = 1
     r = 1
@@ -135,6 +165,13 @@ class PSTorus:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return [self.R, self.r]
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
@@ -163,6 +200,9 @@ class PSTorus:
 class PSCylinder:
     """A Parametric surface - cylinder with no top or bottom"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'cylinder'
+
     # This shape specific parameters
     R = 1
     L = 1
@@ -195,6 +235,13 @@ class PSCylinder:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return [self.R]
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
@@ -221,6 +268,9 @@ class PSCylinder:
 class PSSphere:
     """A Parametric surface - sphere"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'sphere'
+
     # This shape specific parameters
     R = 1
 
@@ -244,6 +294,13 @@ class PSSphere:
         self.vstop = vstop
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return [self.R]
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
@@ -270,6 +327,9 @@ class PSSphere:
 class PSDisk:
     """A Parametric surface - Disk"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'disk'
+
     # This shape specific parameters
     r0 = 0
     r1 = 1
@@ -296,6 +356,13 @@ class PSDisk:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return []
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
@@ -318,6 +385,9 @@ class PSDisk:
 class PSCone:
     """A Parametric surface - cylinder with no top or bottom"""
 
+    # Name of the shape for the native (c++) surface
+    shape = 'cone'
+
     # This shape specific parameters
     r0 = 0
     r1 = 1
@@ -352,6 +422,13 @@ class PSCone:
         self.nv = nv
        
     
+    def parameters (self):
+        """Return the shape specific parameters in the order used by the native surface"""
+
+        return [self.r0, self.r1, self.L]
+
+
+
     def position (self, u, v):
         """Return the position in 3D at this u and v"""
 
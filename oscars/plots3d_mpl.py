@@ -13,15 +13,18 @@ def power_density_3d(srs, surface,
                     xticks=None, yticks=None, zticks=None, bbox_inches='tight', max_level=24, quantity='power density'):
     """calculate power density for and plot a parametric surface in 3d"""
 
+    # Surfaces with a native shape are generated in c++, otherwise build the points here
     points = []
+    native = None
+    if hasattr(surface, 'shape') and hasattr(surface, 'parameters'):
+        native = surface
+    else:
+        for u in np.linspace(surface.ustart, surface.ustop, surface.nu):
+            for v in np.linspace(surface.vstart, surface.vstop, surface.nv):
+                points.append([surface.position(u, v), surface.normal(u, v)])
 
 
-    for u in np.linspace(surface.ustart, surface.ustop, surface.nu):
-        for v in np.linspace(surface.vstart, surface.vstop, surface.nv):
-            points.append([surface.position(u, v), surface.normal(u, v)])
-
-
-    power_density = srs.calculate_power_density(points=points, normal=normal, rotations=rotations, translation=translation, nparticles=nparticles, gpu=gpu, nthreads=nthreads, max_level=max_level, quantity=quantity)
+    power_density = srs.calculate_power_density(points=points, surface=native, normal=normal, rotations=rotations, translation=translation, nparticles=nparticles, gpu=gpu, nthreads=nthreads, max_level=max_level, quantity=quantity)
     P = [item[1] for item in power_density]
 
     X2 = []
@@ -128,15 +131,18 @@ def power_density_3ds(srs, surface, ax,
                     alpha=0.4, transparent=True, max_level=-2):
     """calculate power density for and plot a parametric surface in 3d"""
 
+    # Surfaces with a native shape are generated in c++, otherwise build the points here
     points = []
+    native = None
+    if hasattr(surface, 'shape') and hasattr(surface, 'parameters'):
+        native = surface
+    else:
+        for u in np.linspace(surface.ustart, surface.ustop, surface.nu):
+            for v in np.linspace(surface.vstart, surface.vstop, surface.nv):
+                points.append([surface.position(u, v), surface.normal(u, v)])
 
 
-    for u in np.linspace(surface.ustart, surface.ustop, surface.nu):
-        for v in np.linspace(surface.vstart, surface.vstop, surface.nv):
-            points.append([surface.position(u, v), surface.normal(u, v)])
-
-
-    power_density = srs.calculate_power_density(points=points, normal=normal, rotations=rotations, translation=translation, nparticles=nparticles, gpu=gpu, nthreads=nthreads, max_level=max_level)
+    power_density = srs.calculate_power_density(points=points, surface=native, normal=normal, rotations=rotations, translation=translation, nparticles=nparticles, gpu=gpu, nthreads=nthreads, max_level=max_level)
     P = [item[1] for item in power_density]
 
     X2 = []
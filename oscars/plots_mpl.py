@@ -681,25 +681,18 @@ def plot_undulator_flux_onaxis(oth, period, nperiods, harmonics, minimum=0, bfie
     plt.loglog()
 
 
-    # Loop over all harmonics
-    for i in harmonics:
-        
-        R = []
-        for k in np.linspace(K[1], K[0], 300):
-            ev_flux = oth.undulator_flux_onaxis(K=k,
-                                                period=period,
-                                                nperiods=nperiods,
-                                                harmonic=i
-                                               )
-            if ev_flux[1] >= minimum:
-                R.append(ev_flux)
-
-        X = []
-        Y = []
-        for j in range(len(R)):
-            X.append(R[j][0])
-            Y.append(R[j][1])
-        plt.plot(X, Y, label=str(i))
+    # All harmonics and K values in one call
+    E, F = oth.undulator_tuning_curves(period=period,
+                                       nperiods=nperiods,
+                                       harmonics=harmonics,
+                                       K_points=np.linspace(K[1], K[0], 300)
+                                      )
+    E = np.asarray(E)
+    F = np.asarray(F)
+
+    for j, i in enumerate(harmonics):
+        Keep = F[j] >= minimum
+        plt.plot(E[j][Keep], F[j][Keep], label=str(i))
 
     plt.legend(title='Harmonics')
 
@@ -739,25 +732,19 @@ def plot_undulator_brightness(oth, period, nperiods, harmonics, minimum=0, bfiel
     plt.loglog()
 
 
-    # Loop over all harmonics
-    for i in harmonics:
-        
-        R = []
-        for k in np.linspace(K[1], K[0], 300):
-            ev_brightness = oth.undulator_brightness(K=k,
-                                                     period=period,
-                                                     nperiods=nperiods,
-                                                     harmonic=i
-                                                    )
-            if ev_brightness[1] >= minimum:
-                R.append(ev_brightness)
-
-        X = []
-        Y = []
-        for j in range(len(R)):
-            X.append(R[j][0])
-            Y.append(R[j][1])
-        plt.plot(X, Y, label=str(i))
+    # All harmonics and K values in one call
+    E, F, B = oth.undulator_tuning_curves(period=period,
+                                          nperiods=nperiods,
+                                          harmonics=harmonics,
+                                          K_points=np.linspace(K[1], K[0], 300),
+                                          brightness=True
+                                         )
+    E = np.asarray(E)
+    B = np.asarray(B)
+
+    for j, i in enumerate(harmonics):
+        Keep = B[j] >= minimum
+        plt.plot(E[j][Keep], B[j][Keep], label=str(i))
 
     plt.legend(title='Harmonics')
 
@@ -54,6 +54,7 @@ if sys.platform == "linux" or sys.platform == "linux2":
         libraries.append('cudart_static')
         libraries.append('rt')
         extra_objects_sr.append('lib/OSCARSSR_Cuda.o')
+        extra_objects_sr.append('lib/OSCARSTH_Cuda.o')
         extra_objects_th.append('lib/OSCARSTH_Cuda.o')
 
 elif sys.platform == 'darwin':
@@ -71,6 +72,7 @@ elif sys.platform == 'darwin':
         extra_compile_args.append('-DCUDA')
         libraries.append('cudart_static')
         extra_objects_sr.append('lib/OSCARSSR_Cuda.o')
+        extra_objects_sr.append('lib/OSCARSTH_Cuda.o')
         extra_objects_th.append('lib/OSCARSTH_Cuda.o')
 
 elif sys.platform == 'win32':
@@ -99,6 +101,7 @@ moduleOSCARSSR = Extension('oscars.sr',
                       include_dirs = ['include'],
                       sources = ['src/OSCARSSR.cc',
                                  'src/OSCARSSR_Python.cc',
+                                 'src/OSCARSTH.cc',
                                  'src/T3DScalarContainer.cc',
                                  'src/TField3D_Grid.cc',
                                  'src/TField3D_Gaussian.cc',
@@ -114,6 +117,7 @@ moduleOSCARSSR = Extension('oscars.sr',
                                  'src/TParticleTrajectoryInterpolated.cc',
                                  'src/TParticleTrajectoryInterpolatedPoints.cc',
                                  'src/TRandomA.cc',
+                                 'src/TResultFile.cc',
                                  'src/TSpectrumContainer.cc',
                                  'src/TSurfaceOfPoints.cc',
                                  'src/TSurfacePoint.cc',
@@ -129,6 +133,12 @@ moduleOSCARSSR = Extension('oscars.sr',
                                  'src/TTriangle3D.cc',
                                  'src/TTriangle3DContainer.cc',
                                  'src/TDriftVolumeContainer.cc',
+                                 'src/TEmissionCones.cc',
+                                 'src/TTriangle3DBVH.cc',
+                                 'src/TSurfaceQuadtree.cc',
+                                 'src/TSurfacePoints_Parametric.cc',
+                                 'src/TApertureCubature.cc',
+                                 'src/T4DScalarContainer.cc',
                                  'src/OSCARSPY.cc'],
                       extra_compile_args=extra_compile_args,
                       libraries=libraries,
@@ -156,6 +166,7 @@ moduleOSCARSTH = Extension('oscars.th',
                                  'src/TParticleTrajectoryInterpolated.cc',
                                  'src/TParticleTrajectoryInterpolatedPoints.cc',
                                  'src/TRandomA.cc',
+                                 'src/TResultFile.cc',
                                  'src/TSpectrumContainer.cc',
                                  'src/TSurfaceOfPoints.cc',
                                  'src/TSurfacePoint.cc',
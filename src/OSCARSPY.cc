@@ -13,6 +13,7 @@
 #include "OSCARSPY.h"
 
 #include <stdexcept>
+#include <cstring>
 
 namespace OSCARSPY {
 
@@ -244,6 +245,99 @@ PyObject* VectorIntToList (std::vector<int>& V)
 
 
 
+void SequenceToVectorDouble (PyObject* S, std::vector<double>& V)
+{
+  // Get any sequence of numbers as std::vector<double>.  A contiguous
+  // 1D buffer of doubles (eg numpy float64 array) is copied directly.
+
+  V.clear();
+
+  if (PyObject_CheckBuffer(S)) {
+    Py_buffer Buffer;
+    if (PyObject_GetBuffer(S, &Buffer, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+      std::string const Format = Buffer.format == 0x0 ? "B" : Buffer.format;
+      bool const IsDouble = Buffer.ndim == 1 && Buffer.itemsize == sizeof(double) && (Format == "d" || Format == "=d" || Format == "<d" || Format == "@d");
+      if (IsDouble) {
+        V.resize(Buffer.len / sizeof(double));
+        if (V.size() > 0) {
+          std::memcpy(V.data(), Buffer.buf, V.size() * sizeof(double));
+        }
+      }
+      PyBuffer_Release(&Buffer);
+      if (IsDouble) {
+        return;
+      }
+    } else {
+      PyErr_Clear();
+    }
+  }
+
+  PyObject* Fast = PySequence_Fast(S, "not a sequence");
+  if (Fast == 0x0) {
+    PyErr_Clear();
+    throw std::invalid_argument("expected a sequence of numbers");
+  }
+
+  Py_ssize_t const N = PySequence_Fast_GET_SIZE(Fast);
+  V.resize(N);
+  for (Py_ssize_t i = 0; i < N; ++i) {
+    V[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(Fast, i));
+  }
+  Py_DECREF(Fast);
+
+  if (PyErr_Occurred()) {
+    PyErr_Clear();
+    V.clear();
+    throw std::invalid_argument("expected a sequence of numbers");
+  }
+
+  return;
+}
+
+
+
+
+PyObject* VectorAsMemoryView (std::vector<double> const& V, size_t const N0, size_t const N1)
+{
+  // Return V as an N0 x N1 memoryview of doubles (numpy.asarray() will
+  // use it without a copy).  Python 2 gets nested lists instead.
+
+  if (V.size() != N0 * N1) {
+    throw std::length_error("size of vector does not match shape");
+  }
+
+  #if PY_MAJOR_VERSION >= 3
+  PyObject* Bytes = PyByteArray_FromStringAndSize((char const*) V.data(), V.size() * sizeof(double));
+  if (Bytes == 0x0) {
+    return NULL;
+  }
+  PyObject* View = PyMemoryView_FromObject(Bytes);
+  Py_DECREF(Bytes);
+  if (View == 0x0) {
+    return NULL;
+  }
+
+  PyObject* Result = PyObject_CallMethod(View, "cast", "s(nn)", "d", (Py_ssize_t) N0, (Py_ssize_t) N1);
+  Py_DECREF(View);
+
+  return Result;
+  #else
+  PyObject* List = PyList_New(N0);
+  for (size_t i = 0; i != N0; ++i) {
+    PyObject* Row = PyList_New(N1);
+    for (size_t j = 0; j != N1; ++j) {
+      PyList_SET_ITEM(Row, j, PyFloat_FromDouble(V[i * N1 + j]));
+    }
+    PyList_SET_ITEM(List, i, Row);
+  }
+
+  return List;
+  #endif
+}
+
+
+
+
 PyObject* TVector2DAsList (TVector2D const& V)
 {
   // Turn a TVector2D into a list (like a vector)
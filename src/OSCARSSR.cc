@@ -12,22 +12,65 @@
 #include <complex>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <map>
 #include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
 
 #include "TVector3DC.h"
 #include "TField3D_Grid.h"
 #include "TField3D_Gaussian.h"
 #include "TSpectrumContainer.h"
 #include "TSurfacePoints_Rectangle.h"
+#include "TSurfacePoints_3D.h"
+#include "TField3D_IdealUndulator.h"
+#include "TEmissionCones.h"
+#include "OSCARSTH.h"
 
 
 
 // External global random generator
 extern TRandomA* gRandomA;
 
+// Minimum observer distance for the analytic path in units of the undulator length
+static double const kAnalyticFarFieldFactor = 10;
+
+// Number of extrapolations for Richardson convergence mode
+static size_t const kRichardsonDepth = 3;
+
+// Level after which convergence may be accepted when warm starting from a neighbour,
+// and the trajectory level used to predict the level needed from the phase advance
+static int const kWarmStartMinLevel = 7;
+static int const kPlannerProbeLevel = 6;
+
+// Values kept per trajectory point for the Filon integrator: amplitude, phase, and
+// phase derivative
+static size_t const kFilonStride = 5;
+
+// Number of trajectory segments and samples per segment for emission cone culling
+static size_t const kEmissionConeSegments = 128;
+static size_t const kEmissionConeSamples = 8;
+
+// Number of points (each with its two mirror images) checked for automatic symmetry,
+// and the fraction of the largest of them by which they may differ.  This is far below
+// any precision so that a small real asymmetry, eg from the trajectory not being on
+// the centre line, is not mirrored away
+static int    const kSymmetrySamples = 4;
+static double const kSymmetryTolerance = 1e-6;
+
+
 
 
 
@@ -46,6 +89,37 @@ OSCARSSR::OSCARSSR ()
   // Set Global compute settings
   SetUseGPUGlobal(0);   // GPU off by default
   SetNThreadsGlobal(2); // Use N threads for calculations by default
+  SetNProcessesGlobal(1); // Single process by default
+
+  // No shared memory for processes yet
+  fProcessShared = 0x0;
+  fProcessSharedSize = 0;
+  fProcessNValues = 0;
+
+  // No checkpointing by default
+  ClearCheckpoint();
+
+  // Always integrate numerically unless asked otherwise
+  fAnalyticMode = kAnalyticMode_Off;
+  fAnalyticNValidation = 3;
+  fAnalyticTolerance = 0.01;
+  fLastCalculationPath = "";
+
+  // Riemann sum over trajectory points by default
+  fIntegrator = kIntegrator_Riemann;
+
+  // Convergence when successive levels agree by default
+  fConvergenceMode = kConvergenceMode_Level;
+
+  // Every point starts cold by default
+  fWarmStart = false;
+
+  // No emission cone culling by default
+  fEmissionConeCulling = 0;
+
+  // No shadowing by default
+  fOccluders = 0x0;
+  fOccludersPointsOnTriangles = true;
 }
 
 
@@ -714,212 +788,242 @@ int OSCARSSR::GetNThreadsGlobal () const
 
 
 
-void OSCARSSR::SetSeed (int const Seed) const
+void OSCARSSR::SetNProcessesGlobal (int const N)
 {
-  gRandomA->SetSeed(Seed);
+  // Number of local processes to split multi-particle calculations over.  Each
+  // process runs a slice of the particles (with its own threads) and the results
+  // are summed through shared memory.  Not available on windows.
+
+  if (N < 1) {
+    throw std::out_of_range("number of processes must be >= 1");
+  }
+
+#ifdef _WIN32
+  if (N > 1) {
+    throw std::invalid_argument("multiple processes are not supported on this platform");
+  }
+#endif
+
+  fNProcessesGlobal = N;
   return;
 }
 
 
 
 
-double OSCARSSR::GetRandomNormal () const
+int OSCARSSR::GetNProcessesGlobal () const
 {
-  return gRandomA->Normal();
+  return fNProcessesGlobal;
 }
 
 
 
 
-double OSCARSSR::GetRandomUniform () const
+void OSCARSSR::SetAnalyticMode (std::string const& Mode, int const NValidation, double const Tolerance)
 {
-  return gRandomA->Uniform();
+  // Set the analytic mode.  In "auto" mode spectrum, flux, and power density
+  // calculations for a single ideal undulator with a filament beam and a far field
+  // observer are done with the closed-form expressions in OSCARSTH instead of
+  // numerically.  Any other configuration falls back to the numerical calculation.
+  // "off" always integrates numerically.  For power density NValidation points are
+  // also calculated numerically and the largest difference is reported.
+  //
+  // The closed-form expressions are for NPeriods sinusoidal periods only while the
+  // ideal undulator field also has terminating half periods.  These act roughly as
+  // one more period, so the peak differs by about 2/NPeriods.  The analytic path is
+  // only taken when this estimate is at or below Tolerance.
+
+  if (NValidation < 0) {
+    throw std::out_of_range("number of validation points must be >= 0");
+  }
+  if (Tolerance < 0) {
+    throw std::out_of_range("analytic tolerance must be >= 0");
+  }
+
+  std::string ModeUpper = Mode;
+  std::transform(ModeUpper.begin(), ModeUpper.end(), ModeUpper.begin(), ::toupper);
+
+  if (ModeUpper == "OFF") {
+    fAnalyticMode = kAnalyticMode_Off;
+  } else if (ModeUpper == "AUTO") {
+    fAnalyticMode = kAnalyticMode_Auto;
+  } else {
+    throw std::invalid_argument("analytic mode must be off or auto");
+  }
+  fAnalyticNValidation = NValidation;
+  fAnalyticTolerance   = Tolerance;
+
+  return;
 }
 
 
 
 
-void OSCARSSR::CorrectTrajectory ()
+std::string OSCARSSR::GetAnalyticMode () const
 {
-  // Correct the ideal trajectory so that the position and direction at
-  // a specified point is as close as possible to the specified values
+  return fAnalyticMode == kAnalyticMode_Auto ? "auto" : "off";
+}
 
-  TVector3D Direction(0, 0, 1);
-  TVector3D ExitPoint(0, 0, 2);
 
-  TVector3D V0 = Direction.Perp();
-  TVector3D V1 = Direction.Cross(V0);
 
-  TParticleTrajectoryPoints& ParticleTrajectory = fParticle.GetTrajectory();
 
-  // Closest approach to point and direction
-  double MinimumDistance2;
-  size_t MinimumDistanceIndex = 0;
-  for (size_t i = 0; i != ParticleTrajectory.GetNPoints(); ++i) {
-    double const Distance2 = (ParticleTrajectory.GetX(i) - ExitPoint).Mag2();
+std::string const& OSCARSSR::GetLastCalculationPath () const
+{
+  // Which path the last spectrum, flux, or power density calculation took
+  return fLastCalculationPath;
+}
 
-    if (i == 0) {
-      MinimumDistance2 = Distance2;
-    }
 
-    if (Distance2 < MinimumDistance2) {
-      MinimumDistance2 = Distance2;
-      MinimumDistanceIndex = i;
-    }
-  }
-  std::cout << "MinimumDistance " << sqrt(MinimumDistance2) << std::endl;
 
-  this->AddMagneticField(new TField3D_Gaussian(TVector3D(0, 0.0001, 0),
-                                               TVector3D(0, 0, -1.8),
-                                               TVector3D(0, 0, 0.010),
-                                               TVector3D(0, 0, 0),
-                                               "_autocorrector_entry"));
 
-  this->AddMagneticField(new TField3D_Gaussian(TVector3D(0, 0.0001, 0),
-                                               TVector3D(0, 0, +1.8),
-                                               TVector3D(0, 0, 0.010),
-                                               TVector3D(0, 0, 0),
-                                               "_autocorrector_exit"));
+
+void OSCARSSR::SetIntegrator (std::string const& Integrator)
+{
+  // Set the integrator used for the spectrum and flux trajectory integrals.
+  // "riemann" sums the field over all points up to the converged level and needs
+  // the phase step between points to be below pi.  "filon" integrates over the same
+  // points treating amplitude and phase as linear between points, so only the change
+  // in the phase step needs to be below pi.  This allows far
+  // coarser trajectories at high photon energies.  The GPU always uses "riemann".
+
+  std::string IntegratorUpper = Integrator;
+  std::transform(IntegratorUpper.begin(), IntegratorUpper.end(), IntegratorUpper.begin(), ::toupper);
+
+  if (IntegratorUpper == "RIEMANN") {
+    fIntegrator = kIntegrator_Riemann;
+  } else if (IntegratorUpper == "FILON") {
+    fIntegrator = kIntegrator_Filon;
+  } else {
+    throw std::invalid_argument("integrator must be riemann or filon");
+  }
 
   return;
 }
 
 
-void OSCARSSR::CalculateTrajectory ()
-{
-  // Function to calculate the particle trajectory of the member particle fParticle
-
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (fParticle.GetType() == "") {
-    this->SetNewParticle();
-  }
 
-  this->CalculateTrajectory(fParticle);
 
-  return;
+std::string OSCARSSR::GetIntegrator () const
+{
+  return fIntegrator == kIntegrator_Filon ? "filon" : "riemann";
 }
 
 
 
 
 
-void OSCARSSR::CalculateTrajectory (TParticleA& P)
+void OSCARSSR::SetConvergenceMode (std::string const& Mode)
 {
-  // Function to calculate the particle trajectory given initial conditions.
-  // This function uses the internal Trajectory member to store results
-
-  // Check that CTStart is not after T0 of particle
-  if (this->GetCTStart() > P.GetT0()) {
-    std::cerr << "GetCTStart() P.GetT0(): " << this->GetCTStart() << " " << P.GetT0() << std::endl;
-    throw std::out_of_range("start time is greater than T0");
+  // Set how convergence across trajectory levels is decided for spectrum, flux,
+  // and power density.  "level" (default) accepts the sum at a level once it agrees
+  // with the previous level to the requested precision, not before level 9.
+  // "richardson" adds the trajectory end points to make each level a trapezoid sum
+  // and extrapolates the sums with halving step size to zero step size (Romberg).
+  // While the change between levels shrinks by close to the factor 4 of the
+  // trapezoid rule the change between the last two extrapolations is the precision
+  // estimate, otherwise it is not less than the change from the previous level's
+  // extrapolated value.  Only levels which resolve the phase (or the change in
+  // direction for power density) enter the extrapolation.  For the Filon integrator
+  // "level" is always used.
+
+  std::string ModeUpper = Mode;
+  std::transform(ModeUpper.begin(), ModeUpper.end(), ModeUpper.begin(), ::toupper);
+
+  if (ModeUpper == "LEVEL") {
+    fConvergenceMode = kConvergenceMode_Level;
+  } else if (ModeUpper == "RICHARDSON") {
+    fConvergenceMode = kConvergenceMode_Richardson;
+  } else {
+    throw std::invalid_argument("convergence mode must be level or richardson");
   }
 
-  // Check that CTStart and CTStop are not the same (probably not defined if this is the case)
-  if (this->GetCTStart() >= this->GetCTStop()) {
-    throw std::out_of_range("start time is greater than stop time.  check that set_ctstartstop is set");
-  }
+  return;
+}
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (P.GetType() == "") {
-    throw std::out_of_range("particle not initialized.  make sure you have a particle or beam defined");
-  }
 
-  // Clear any current trajectory
-  P.ResetTrajectoryData();
 
-  // Calculate the total DeltaT in seconds
-  double const DeltaT = ((this->GetCTStop() - this->GetCTStart()) / TOSCARSSR::C() / (fNPointsTrajectory - 1));
 
+std::string OSCARSSR::GetConvergenceMode () const
+{
+  return fConvergenceMode == kConvergenceMode_Richardson ? "richardson" : "level";
+}
 
-  // The number of points in the forward and backward direction
-  // UPDATE: Check the details of these numbers
-  size_t NPointsForward  = 1 + (this->GetCTStop() - P.GetT0()) / TOSCARSSR::C() / DeltaT;
-  size_t NPointsBackward = (P.GetT0() - this->GetCTStart()) / TOSCARSSR::C() / DeltaT;
 
 
-  // Number of dimensions of the array to be sent for RK calculation
-  int const N = 6;
 
-  // Arrays to be sent for RK calculation
-  double x[N];
-  double dxdt[N];
 
-  // Initial conditions for the forward propogation
-  x[0] = P.GetX0().GetX();
-  x[1] = P.GetB0().GetX() * TOSCARSSR::C();
-  x[2] = P.GetX0().GetY();
-  x[3] = P.GetB0().GetY() * TOSCARSSR::C();
-  x[4] = P.GetX0().GetZ();
-  x[5] = P.GetB0().GetZ() * TOSCARSSR::C();
+void OSCARSSR::SetWarmStart (bool const WarmStart)
+{
+  // Warm start the level loop of spectrum, flux, and power density calculations.
+  // Convergence is then accepted from one level below the level at which the
+  // previous point in the same thread converged, instead of only after level 8
+  // (never before level 7).  Each point still has to pass the precision and
+  // sampling checks, so the level below the neighbour's is verified against
+  // the one before it.  The Riemann and power density sums of a level include the
+  // points of all lower levels, so every level is still calculated and the gain is
+  // only from the lower acceptance level.  For the Filon integrator the Filon sum
+  // over the inclusive grid is skipped below the lower of this level and the level
+  // predicted from the largest phase advance omega (1 - n.beta) dt along the
+  // trajectory, the field at the points is still calculated.
+
+  fWarmStart = WarmStart;
 
+  return;
+}
 
-  // Grap the particle trajectory object
-  TParticleTrajectoryPoints& ParticleTrajectory = P.GetTrajectory();
-  ParticleTrajectory.Reserve(NPointsForward + NPointsBackward);
 
-  // Set delta T for the trajectory
-  ParticleTrajectory.SetDeltaT(DeltaT);
 
-  // Loop over points in the forward direction
-  for (size_t i = 0; i != NPointsForward; ++i) {
 
-    // This time
-    double t = P.GetT0() / TOSCARSSR::C() + DeltaT * i;
+bool OSCARSSR::GetWarmStart () const
+{
+  return fWarmStart;
+}
 
 
-    // UPDATE: dhidas dhidas dhidas
-    if (fDriftVolumeContainer.IsInside(TVector3D(x[0], x[2], x[4]))) {
-      x[0] += DeltaT * x[1];
-      x[2] += DeltaT * x[3];
-      x[4] += DeltaT * x[5];
-    } else {
-      // Add this point to the trajectory
-      ParticleTrajectory.AddPoint(x[0], x[2], x[4], x[1] / TOSCARSSR::C(), x[3] / TOSCARSSR::C(), x[5] / TOSCARSSR::C(), dxdt[1] / TOSCARSSR::C(), dxdt[3] / TOSCARSSR::C(), dxdt[5] / TOSCARSSR::C(), t);
 
-      // Propogate
-      (this->*fDerivativesFunction)(t, x, dxdt, P);
-      RK4(x, dxdt, N, t, DeltaT, x, P);
-    }
+
+void OSCARSSR::SetEmissionConeCulling (double const ConeAngleGamma)
+{
+  // Cull trajectory segments in power density calculations.  The trajectory is
+  // split into segments, each with a bounding sphere and a cone around the
+  // directions of beta.  For every point on the surface the segments from which the
+  // point is more than ConeAngleGamma / gamma outside of the cone are not summed.
+  // The power radiated at an angle theta to beta falls as (1 + gamma^2 theta^2)^-5/2
+  // or faster, so values of 10 or more lose very little.  0 turns culling off.
+
+  if (ConeAngleGamma < 0) {
+    throw std::invalid_argument("emission cone angle must be >= 0");
   }
 
-  // Reverse trajectory elements for backward propogation
-  ParticleTrajectory.ReverseArrays();
+  fEmissionConeCulling = ConeAngleGamma;
 
-  // Set initial conditions for propogating backwards
-  x[0] =  P.GetX0().GetX();
-  x[1] =  P.GetB0().GetX() * TOSCARSSR::C();
-  x[2] =  P.GetX0().GetY();
-  x[3] =  P.GetB0().GetY() * TOSCARSSR::C();
-  x[4] =  P.GetX0().GetZ();
-  x[5] =  P.GetB0().GetZ() * TOSCARSSR::C();
+  return;
+}
 
-  // Reverse time
-  double const DeltaTReversed = -DeltaT;
 
-  // Loop over all points "before" the initial point
-  for (size_t i = 0; i != NPointsBackward; ++i) {
 
-    // This time
-    double t = P.GetT0() / TOSCARSSR::C() + DeltaTReversed * (i + 1);
 
-    if (fDriftVolumeContainer.IsInside(TVector3D(x[0], x[2], x[4]))) {
-      x[0] += DeltaTReversed * x[1];
-      x[2] += DeltaTReversed * x[3];
-      x[4] += DeltaTReversed * x[5];
-    } else {
-      // Propogate backward in time!
-      (this->*fDerivativesFunction)(t, x, dxdt, P);
-      RK4(x, dxdt, N, t, DeltaTReversed, x, P);
+double OSCARSSR::GetEmissionConeCulling () const
+{
+  return fEmissionConeCulling;
+}
 
-      // Add the point to the trajectory
-      ParticleTrajectory.AddPoint(x[0], x[2], x[4], x[1] / TOSCARSSR::C(), x[3] / TOSCARSSR::C(), x[5] / TOSCARSSR::C(), dxdt[1] / TOSCARSSR::C(), dxdt[3] / TOSCARSSR::C(), dxdt[5] / TOSCARSSR::C(), t);
-    }
-  }
 
-  // Re-Reverse the trajectory to be in the proper time order
-  ParticleTrajectory.ReverseArrays();
 
-  P.SetupTrajectoryInterpolated();
+
+void OSCARSSR::SetOccluders (TTriangle3DBVH const* Occluders, bool const PointsOnTriangles)
+{
+  // Triangles for line of sight shadowing in power density calculations.  For each
+  // point the trajectory segments (see SetEmissionConeCulling) whose centre is
+  // hidden from the point by any of these triangles are not summed.  If
+  // PointsOnTriangles point i of the surface is taken to be on triangle i, which
+  // does not shadow itself.  Otherwise (points on vertices) only intersections at
+  // the point itself are ignored.  The triangles are not owned and must outlive
+  // the calculation, use TOccludersScope to set them for one calculation.  0 turns
+  // shadowing off.
+
+  fOccluders = Occluders;
+  fOccludersPointsOnTriangles = PointsOnTriangles;
 
   return;
 }
@@ -927,755 +1031,871 @@ void OSCARSSR::CalculateTrajectory (TParticleA& P)
 
 
 
-TParticleTrajectoryPoints const& OSCARSSR::GetTrajectory ()
+TTriangle3DBVH const* OSCARSSR::GetOccluders () const
 {
-  // Get the trajectory for *the* current particle in fParticle
-
-  return fParticle.GetTrajectory();
+  return fOccluders;
 }
 
 
 
 
-void OSCARSSR::ClearTrajectory ()
+OSCARSSR::TOccludersScope::TOccludersScope (OSCARSSR& SR, TTriangle3DBVH const* Occluders, bool const PointsOnTriangles)
+  : fSR(SR)
 {
-  fParticle.ResetTrajectoryData();
-  return;
+  // The occluders are only set while this object exists, so a stack local
+  // hierarchy is never left behind in the OSCARSSR object
+  fSR.SetOccluders(Occluders, PointsOnTriangles);
 }
 
 
 
 
-
-void OSCARSSR::SetDerivativesFunction ()
+OSCARSSR::TOccludersScope::~TOccludersScope ()
 {
-  // Set the derivatives function for RK4 depending on what fields exist
-  // I am using a function pointer so that we avoid computations that are not needed (save CPU cycles)
+  fSR.SetOccluders(0x0);
+}
+
 
-  if (fBFieldContainer.GetNFields() == 0 && fEFieldContainer.GetNFields() > 0) {
-    fDerivativesFunction = &OSCARSSR::DerivativesE;
-  } else if (fBFieldContainer.GetNFields() > 0 && fEFieldContainer.GetNFields() == 0) {
-    fDerivativesFunction = &OSCARSSR::DerivativesB;
-  } else {
-    fDerivativesFunction = &OSCARSSR::DerivativesEB;
-  }
 
+
+void OSCARSSR::SetSeed (int const Seed) const
+{
+  gRandomA->SetSeed(Seed);
   return;
 }
 
 
 
 
+double OSCARSSR::GetRandomNormal () const
+{
+  return gRandomA->Normal();
+}
 
 
 
 
-
-void OSCARSSR::DerivativesE (double t, double x[], double dxdt[], TParticleA const& P)
+double OSCARSSR::GetRandomUniform () const
 {
-  // This is a second order differential equation.  It does not account for the loss in energy due to
-  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
+  return gRandomA->Uniform();
+}
 
-  // The values correspond to:
-  // x[0] - x
-  // x[1] - Vx
-  // x[2] - y
-  // x[3] - Vy
-  // x[4] - z
-  // x[5] - Vz
 
-  // BField at this point
-  TVector3D const E = this->GetE(x[0], x[2], x[4]);
 
-  double const QoverMTimesSqrtOneMinusBetaSquared = P.GetQ() / P.GetM() * sqrt(1. - (x[1]*x[1] + x[3]*x[3] + x[5]*x[5]) / (TOSCARSSR::C() * TOSCARSSR::C()));
-  double const BetaDotE = (x[1] * E.GetX() + x[3] * E.GetY() + x[5] * E.GetZ()) / TOSCARSSR::C();
 
-  dxdt[0] = x[1];
-  dxdt[1] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetX() - x[1] * BetaDotE / TOSCARSSR::C());
-  dxdt[2] = x[3];                                          
-  dxdt[3] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetY() - x[3] * BetaDotE / TOSCARSSR::C());
-  dxdt[4] = x[5];                                          
-  dxdt[5] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetZ() - x[5] * BetaDotE / TOSCARSSR::C());
+void OSCARSSR::SetCheckpoint (std::string const& FileName,
+                              int const NParticlesPerCheckpoint,
+                              bool const Resume)
+{
+  // Write a checkpoint of multi-particle calculations every NParticlesPerCheckpoint
+  // particles (and at the end).  The checkpoint contains the accumulated result with
+  // compensation and convergence flags, the number of particles done, and the state of
+  // the random generator.  If Resume is true the next multi-particle calculation will
+  // start from the checkpoint in FileName and continue exactly where it left off.  The
+  // calculation must be called with the same inputs as the original.
+
+  if (NParticlesPerCheckpoint < 0) {
+    throw std::out_of_range("number of particles per checkpoint must be >= 0");
+  }
+
+  fCheckpointFileName   = FileName;
+  fCheckpointNParticles = NParticlesPerCheckpoint;
+  fCheckpointResume     = Resume;
 
   return;
 }
 
 
 
-void OSCARSSR::DerivativesB (double t, double x[], double dxdt[], TParticleA const& P)
+
+void OSCARSSR::ClearCheckpoint ()
 {
-  // This is a second order differential equation.  It does not account for the loss in energy due to
-  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
+  // Turn off checkpointing
+  fCheckpointFileName   = "";
+  fCheckpointNParticles = 0;
+  fCheckpointResume     = false;
 
-  // The values correspond to:
-  // x[0] - x
-  // x[1] - Vx
-  // x[2] - y
-  // x[3] - Vy
-  // x[4] - z
-  // x[5] - Vz
+  return;
+}
 
-  // BField at this point
-  TVector3D const B = this->GetB(x[0], x[2], x[4]);
 
-  double const QoverMGamma = P.GetQoverMGamma();
 
-  dxdt[0] = x[1];
-  dxdt[1] = QoverMGamma * (-x[5] * B.GetY() + x[3] * B.GetZ());
-  dxdt[2] = x[3];                                                                                          
-  dxdt[3] = QoverMGamma * ( x[5] * B.GetX() - x[1] * B.GetZ());
-  dxdt[4] = x[5];                                                                                          
-  dxdt[5] = QoverMGamma * ( x[1] * B.GetY() - x[3] * B.GetX());
 
-  return;
+bool OSCARSSR::CheckpointNow (int const NParticles, int const NParticlesDone) const
+{
+  // Is it time to write a checkpoint
+  if (fCheckpointFileName == "" || fCheckpointNParticles < 1) {
+    return false;
+  }
+
+  return (NParticlesDone % fCheckpointNParticles == 0) || (NParticlesDone == NParticles);
 }
 
 
 
-void OSCARSSR::DerivativesEB (double t, double x[], double dxdt[], TParticleA const& P)
+
+void OSCARSSR::WriteCheckpoint (OSCARSSR_CheckpointType const Type,
+                                int const NParticles,
+                                int const NParticlesDone,
+                                TSpectrumContainer const* Spectrum,
+                                T3DScalarContainer const* Container) const
 {
-  // This is a second order differential equation.  It does not account for the loss in energy due to
-  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
+  // Write the checkpoint file.  It is written to a temporary file which is then renamed
+  // so that an interruption while writing does not destroy the previous checkpoint.
+  // Format: "OSCARSCP", version, type, nparticles, nparticles done, container, random state
 
-  // The values correspond to:
-  // x[0] - x
-  // x[1] - Vx
-  // x[2] - y
-  // x[3] - Vy
-  // x[4] - z
-  // x[5] - Vz
+  std::string const TmpFileName = fCheckpointFileName + ".tmp";
 
-  // BField at this point
-  TVector3D const B = this->GetB(x[0], x[2], x[4]);
-  TVector3D const E = this->GetE(x[0], x[2], x[4]);
+  std::ofstream of(TmpFileName.c_str(), std::ios::binary);
+  if (!of.is_open()) {
+    throw std::invalid_argument("cannot open checkpoint file for writing");
+  }
 
-  double const QoverMTimesSqrtOneMinusBetaSquared = P.GetQ() / P.GetM() * sqrt(1. - (x[1]*x[1] + x[3]*x[3] + x[5]*x[5]) / (TOSCARSSR::C() * TOSCARSSR::C()));
-  double const BetaDotE = (x[1] * E.GetX() + x[3] * E.GetY() + x[5] * E.GetZ()) / TOSCARSSR::C();
+  int32_t const Version = 1;
+  int32_t const T = (int32_t) Type;
+  int32_t const N = (int32_t) NParticles;
+  int32_t const NDone = (int32_t) NParticlesDone;
 
-  dxdt[0] = x[1];
-  dxdt[1] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetX() - x[5] * B.GetY() + x[3] * B.GetZ() - x[1] * BetaDotE / TOSCARSSR::C());
-  dxdt[2] = x[3];                                                                          
-  dxdt[3] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetY() + x[5] * B.GetX() - x[1] * B.GetZ() - x[3] * BetaDotE / TOSCARSSR::C());
-  dxdt[4] = x[5];                                                                          
-  dxdt[5] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetZ() + x[1] * B.GetY() - x[3] * B.GetX() - x[5] * BetaDotE / TOSCARSSR::C());
+  of.write("OSCARSCP", 8);
+  of.write((char*) &Version, sizeof(int32_t));
+  of.write((char*) &T,       sizeof(int32_t));
+  of.write((char*) &N,       sizeof(int32_t));
+  of.write((char*) &NDone,   sizeof(int32_t));
+
+  if (Type == kCheckpoint_Spectrum) {
+    Spectrum->WriteCheckpoint(of);
+  } else {
+    Container->WriteCheckpoint(of);
+  }
 
+  gRandomA->WriteState(of);
+
+  of.close();
+  if (!of) {
+    throw std::length_error("error writing checkpoint file");
+  }
+
+  if (std::rename(TmpFileName.c_str(), fCheckpointFileName.c_str()) != 0) {
+    throw std::invalid_argument("cannot rename temporary checkpoint file");
+  }
 
   return;
 }
 
 
 
-void OSCARSSR::Derivatives (double t, double x[], double dxdt[], TParticleA const& P)
+
+int OSCARSSR::ReadCheckpoint (OSCARSSR_CheckpointType const Type,
+                              int const NParticles,
+                              TSpectrumContainer* Spectrum,
+                              T3DScalarContainer* Container)
 {
-  // This is a second order differential equation.  It does not account for the loss in energy due to
-  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
+  // Read the checkpoint file, restore the container and random state, and return the
+  // number of particles already done.
 
-  // The values correspond to:
-  // x[0] - x
-  // x[1] - Vx
-  // x[2] - y
-  // x[3] - Vy
-  // x[4] - z
-  // x[5] - Vz
+  std::ifstream fi(fCheckpointFileName.c_str(), std::ios::binary);
+  if (!fi.is_open()) {
+    throw std::invalid_argument("cannot open checkpoint file for reading");
+  }
 
-  // BField at this point
-  TVector3D const B = this->GetB(x[0], x[2], x[4]);
+  char Magic[8];
+  int32_t Version = 0;
+  int32_t T = 0;
+  int32_t N = 0;
+  int32_t NDone = 0;
 
-  double const QoverMGamma = P.GetQoverMGamma();
+  fi.read(Magic, 8);
+  fi.read((char*) &Version, sizeof(int32_t));
+  fi.read((char*) &T,       sizeof(int32_t));
+  fi.read((char*) &N,       sizeof(int32_t));
+  fi.read((char*) &NDone,   sizeof(int32_t));
 
-  dxdt[0] = x[1];
-  dxdt[1] = QoverMGamma * (-x[5] * B.GetY() + x[3] * B.GetZ());
-  dxdt[2] = x[3];                                                                                          
-  dxdt[3] = QoverMGamma * ( x[5] * B.GetX() - x[1] * B.GetZ());
-  dxdt[4] = x[5];                                                                                          
-  dxdt[5] = QoverMGamma * ( x[1] * B.GetY() - x[3] * B.GetX());
+  if (!fi || std::strncmp(Magic, "OSCARSCP", 8) != 0 || Version != 1) {
+    throw std::invalid_argument("not a valid checkpoint file");
+  }
+  if (T != (int32_t) Type) {
+    throw std::invalid_argument("checkpoint file is for a different type of calculation");
+  }
+  if (N != NParticles) {
+    throw std::invalid_argument("checkpoint file is for a different number of particles");
+  }
 
-  return;
+  if (Type == kCheckpoint_Spectrum) {
+    TSpectrumContainer S;
+    S.ReadCheckpoint(fi);
+    if (S.GetNPoints() != Spectrum->GetNPoints()) {
+      throw std::invalid_argument("checkpoint file has a different number of points");
+    }
+    *Spectrum = S;
+  } else {
+    T3DScalarContainer C;
+    C.ReadCheckpoint(fi);
+    if (C.GetNPoints() != Container->GetNPoints()) {
+      throw std::invalid_argument("checkpoint file has a different number of points");
+    }
+    *Container = C;
+  }
+
+  gRandomA->ReadState(fi);
+
+  return (int) NDone;
 }
 
 
 
-void OSCARSSR::RK4 (double y[], double dydx[], int n, double x, double h, double yout[], TParticleA const& P)
+
+int OSCARSSR::GetNProcessesToUse (int const NParticles) const
 {
-  // Runge-Kutta 4th order method propogation
-  // UPDATE: syntax
+  // Number of processes to use for a calculation of NParticles.  Checkpointing
+  // requires all particles in one process.
 
-  int i;
-  double xh, hh, h6;
-  double *dym, *dyt, *yt;
+  int const NProcesses = std::min(fNProcessesGlobal, NParticles);
+  if (NProcesses > 1 && fCheckpointFileName != "") {
+    throw std::invalid_argument("checkpoints are not supported with multiple processes");
+  }
 
-  dym = new double[n];
-  dyt = new double[n];
-  yt  = new double[n];
+  return NProcesses < 1 ? 1 : NProcesses;
+}
 
-  hh = h * 0.5;
-  h6 = h / 6.0;
-  xh = x + hh;
 
-  for (i = 0; i < n; ++i) {
-    yt[i] = y[i] + hh * dydx[i];
+
+
+bool OSCARSSR::CheckAnalyticUndulator (int const NParticles,
+                                       std::string const& Polarization,
+                                       int const ReturnQuantity,
+                                       TVector3D& Source,
+                                       TVector3D& XAxis,
+                                       TVector3D& YAxis,
+                                       TVector3D& ZAxis,
+                                       double& K,
+                                       double& Period,
+                                       int& NPeriods,
+                                       double& Length,
+                                       std::string& Reason) const
+{
+  // Check if the current configuration is a single ideal planar undulator seen by
+  // a filament beam so that the closed-form expressions in OSCARSTH apply.  On
+  // success the undulator axes (Z along the beam, Y along the field), source point,
+  // and undulator parameters are filled.  Otherwise Reason says why not.
+
+  if (NParticles != 0) {
+    Reason = "multi-particle calculation";
+    return false;
+  }
+  if (Polarization != "all") {
+    Reason = "polarization not all";
+    return false;
+  }
+  if (ReturnQuantity != 0) {
+    Reason = "return quantity not flux";
+    return false;
+  }
+  if (fEFieldContainer.GetNFields() != 0) {
+    Reason = "electric field present";
+    return false;
+  }
+  if (fDriftVolumeContainer.GetNDriftVolumes() != 0) {
+    Reason = "drift volume present";
+    return false;
+  }
+  if (fBFieldContainer.GetNFields() != 1) {
+    Reason = "not a single magnetic field";
+    return false;
   }
 
-  (this->*fDerivativesFunction)(xh, yt, dyt, P);
-  //this->DerivativesB(xh, yt, dyt, P);
+  TField3D_IdealUndulator const* U = dynamic_cast<TField3D_IdealUndulator const*>(&fBFieldContainer.GetField(0));
+  if (U == 0x0) {
+    Reason = "field is not an ideal undulator";
+    return false;
+  }
+  if (U->GetTaper() != 0) {
+    Reason = "tapered undulator";
+    return false;
+  }
 
-  for (i = 0; i < n; ++i) {
-    yt[i] = y[i] + hh * dyt[i];
+  // Only electrons and positrons are supported by OSCARSTH
+  if (fabs(fParticle.GetM() - TOSCARSSR::Me()) > 1e-6 * TOSCARSSR::Me() || fabs(fabs(fParticle.GetQ()) - TOSCARSSR::Qe()) > 1e-6 * TOSCARSSR::Qe()) {
+    Reason = "particle is not an electron or positron";
+    return false;
   }
 
-  (this->*fDerivativesFunction)(xh, yt, dym, P);
-  //this->DerivativesB(xh, yt, dym, P);
+  // Beam along the period, field transverse to it
+  if (fParticle.GetB0().Mag() == 0 || U->GetField().Mag() == 0 || U->GetPeriod().Mag() == 0) {
+    Reason = "zero beam direction, field, or period";
+    return false;
+  }
+  ZAxis = fParticle.GetB0().UnitVector();
+  YAxis = U->GetField().UnitVector();
+  if (ZAxis.Cross(U->GetPeriod().UnitVector()).Mag() > 1e-9) {
+    Reason = "beam not along undulator axis";
+    return false;
+  }
+  if (fabs(YAxis.Dot(ZAxis)) > 1e-9) {
+    Reason = "field not transverse to undulator axis";
+    return false;
+  }
+  XAxis = YAxis.Cross(ZAxis);
 
-  for (i = 0; i < n; ++i) {
-    yt[i] = y[i] + h * dym[i];
-    dym[i] += dyt[i];
+  Period   = U->GetPeriod().Mag();
+  NPeriods = U->GetNPeriods();
+  Length   = (NPeriods + 2) * Period;
+  K        = OSCARSTH().UndulatorK(U->GetField().Mag(), Period);
+
+  // The terminating fields are not in the closed-form model
+  if (NPeriods < 1 || 2. / (double) NPeriods > fAnalyticTolerance) {
+    Reason = "end fields not negligible (2/nperiods above tolerance)";
+    return false;
   }
 
-  (this->*fDerivativesFunction)(x + h, yt, dyt, P);
-  //this->DerivativesB(x + h, yt, dyt, P);
+  // Source point on the beam axis closest to the undulator center
+  Source = fParticle.GetX0() + ZAxis * ((U->GetCenter() - fParticle.GetX0()).Dot(ZAxis));
 
-  for (i = 0; i < n; ++i) {
-    yout[i] = y[i] + h6 * (dydx[i] + dyt[i] + 2.0 * dym[i]);
+  // Initial conditions must be given outside of the field, otherwise the mean
+  // trajectory is not along the beam direction
+  double const ZCenter = (Source - fParticle.GetX0()).Dot(ZAxis);
+  if (fabs(ZCenter) < Length / 2.) {
+    Reason = "beam starts inside undulator";
+    return false;
   }
-  
-  delete [] dym;
-  delete [] dyt;
-  delete [] yt;
 
-  return;
-}
+  // The trajectory must cover the whole undulator including terminations
+  if (fCTStart >= fCTStop) {
+    Reason = "trajectory start and stop not set";
+    return false;
+  }
+  double const Beta = fParticle.GetB0().Mag();
+  if (Beta * (fCTStart - fParticle.GetT0()) > ZCenter - Length / 2. || Beta * (fCTStop - fParticle.GetT0()) < ZCenter + Length / 2.) {
+    Reason = "trajectory does not cover the undulator";
+    return false;
+  }
 
+  return true;
+}
 
 
 
 
-void OSCARSSR::CalculateSpectrum (TParticleA& Particle,
-                                  TVector3D const& ObservationPoint,
-                                  TSpectrumContainer& Spectrum,
-                                  std::string const& Polarization,
-                                  double const Angle,
-                                  TVector3D const& HorizontalDirection,
-                                  TVector3D const& PropogationDirection,
-                                  double const Precision,
-                                  int    const MaxLevel,
-                                  int    const MaxLevelExtended,
-                                  double const Weight,
-                                  int    const ReturnQuantity)
+bool OSCARSSR::CalculateSpectrumAnalytic (TVector3D const& ObservationPoint,
+                                          TSpectrumContainer& Spectrum,
+                                          std::string const& Polarization,
+                                          int const NParticles,
+                                          int const NThreads,
+                                          int const ReturnQuantity)
 {
-  // Calculates the single particle spectrum at a given observation point
-  // in units of [photons / second / 0.001% BW / mm^2]
-  // Save this in the spectrum container.
-  //
-  // Particle - the Particle.. with a Trajectory structure hopefully
-  // ObservationPoint - Observation Point
-  // Spectrum - Spectrum container
+  // If the analytic mode is on and the configuration allows it calculate the
+  // spectrum from OSCARSTH and return true.  Otherwise record why the numerical
+  // calculation is being used and return false.
 
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
+  if (fAnalyticMode == kAnalyticMode_Off) {
+    fLastCalculationPath = "numerical";
+    return false;
   }
 
+  TVector3D Source;
+  TVector3D XAxis;
+  TVector3D YAxis;
+  TVector3D ZAxis;
+  double K;
+  double Period;
+  int    NPeriods;
+  double Length;
+  std::string Reason;
+
+  if (!this->CheckAnalyticUndulator(NParticles, Polarization, ReturnQuantity, Source, XAxis, YAxis, ZAxis, K, Period, NPeriods, Length, Reason)) {
+    fLastCalculationPath = "numerical: " + Reason;
+    return false;
+  }
 
-  // Extra inpts for calculation
-  bool Done = false;
+  // Observer must be downstream and in the far field
+  TVector3D const R = ObservationPoint - Source;
+  if (R.Dot(ZAxis) <= 0 || R.Mag() < kAnalyticFarFieldFactor * Length) {
+    fLastCalculationPath = "numerical: observer not in far field";
+    return false;
+  }
 
-  this->CalculateSpectrumPoints(Particle,
-                                ObservationPoint,
-                                Spectrum,
-                                0,
-                                1,
-                                Done,
-                                Polarization,
-                                Angle,
-                                HorizontalDirection,
-                                PropogationDirection,
-                                Precision,
-                                MaxLevel,
-                                MaxLevelExtended,
-                                Weight,
-                                ReturnQuantity);
+  double const RX = R.Dot(XAxis);
+  double const RY = R.Dot(YAxis);
+  double const RZ = R.Dot(ZAxis);
+  double const AngleH = atan2(RX, RZ);
+  double const AngleV = atan2(RY, sqrt(RZ * RZ + RX * RX));
 
-  return;
-}
+  size_t const NPoints = Spectrum.GetNPoints();
+  std::vector<double> AnglesH(NPoints, AngleH);
+  std::vector<double> AnglesV(NPoints, AngleV);
+  std::vector<double> Energies_eV(NPoints);
+  for (size_t i = 0; i != NPoints; ++i) {
+    Energies_eV[i] = Spectrum.GetEnergy(i);
+  }
 
+  OSCARSTH TH;
+  TH.SetParticleBeam(fParticle.GetE0(), fParticle.GetCurrent());
 
+  std::vector<double> Flux;
+  TH.UndulatorFluxAngles(K, Period, NPeriods, AnglesH, AnglesV, Energies_eV, Flux, OSCARSTH::kUndulatorType_Planar, NThreads);
 
+  // Convert from per mrad^2 to per mm^2 at the observer
+  double const R2 = R.Mag2();
+  for (size_t i = 0; i != NPoints; ++i) {
+    Spectrum.AddToFlux(i, Flux[i] / R2);
+  }
 
+  fLastCalculationPath = "analytic: ideal undulator without end fields";
+  return true;
+}
 
-void OSCARSSR::CalculateSpectrum (TVector3D const& ObservationPoint,
-                                  TSpectrumContainer& Spectrum,
-                                  std::string const& Polarization,
-                                  double const Angle,
-                                  TVector3D const& HorizontalDirection,
-                                  TVector3D const& PropogationDirection,
-                                  int const NParticles,
-                                  int const NThreads,
-                                  int const GPU,
-                                  int const NGPU,
-                                  std::vector<int> VGPU,
-                                  double const Precision,
-                                  int    const MaxLevel,
-                                  int    const MaxLevelExtended,
-                                  int    const ReturnQuantity)
+
+
+
+bool OSCARSSR::CalculatePowerDensityAnalytic (TSurfacePoints const& Surface,
+                                              T3DScalarContainer& PowerDensityContainer,
+                                              bool const Directional,
+                                              double const Precision,
+                                              int    const MaxLevel,
+                                              int    const MaxLevelExtended,
+                                              int const NParticles,
+                                              int const NThreads,
+                                              int const ReturnQuantity)
 {
-  // Calculate the spectrum at an observaton point.
-  // THIS is the ENTRY POINT typically
+  // If the analytic mode is on and the configuration allows it calculate the
+  // power density on the surface from OSCARSTH and return true.  Otherwise record
+  // why the numerical calculation is being used and return false.  The container
+  // must already hold one point per surface point.  A few points are checked
+  // against the numerical calculation: the analytic maximum and points evenly
+  // spread over the surface.
+
+  if (fAnalyticMode == kAnalyticMode_Off) {
+    fLastCalculationPath = "numerical";
+    return false;
+  }
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (fParticle.GetType() == "") {
-    try {
-      this->SetNewParticle();
-    } catch (std::exception e) {
-      throw std::out_of_range("no beam defined");
-    }
+  if (fOccluders != 0x0) {
+    fLastCalculationPath = "numerical: shadowing";
+    return false;
   }
 
-  // Number of threads to possibly use
-  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
-  if (NThreadsToUse <= 0) {
-    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
+  TVector3D Source;
+  TVector3D XAxis;
+  TVector3D YAxis;
+  TVector3D ZAxis;
+  double K;
+  double Period;
+  int    NPeriods;
+  double Length;
+  std::string Reason;
+
+  if (!this->CheckAnalyticUndulator(NParticles, "all", ReturnQuantity, Source, XAxis, YAxis, ZAxis, K, Period, NPeriods, Length, Reason)) {
+    fLastCalculationPath = "numerical: " + Reason;
+    return false;
   }
 
-  // Should we use the GPU or not?
-  int const NGPUAvailable = this->CheckGPU();
-  bool const UseGPU = GPU == 0 ? false : this->GetUseGPUGlobal() && (NGPUAvailable > 0) ? true : (GPU == 1) && (NGPUAvailable > 0);
+  size_t const NPoints = Surface.GetNPoints();
+  bool const HasNormal = Surface.HasNormal();
+  std::vector<double> AnglesH(NPoints);
+  std::vector<double> AnglesV(NPoints);
+  std::vector<double> Factor(NPoints);
+
+  // Every point must be downstream and in the far field
+  for (size_t i = 0; i != NPoints; ++i) {
+    TVector3D const R = Surface.GetPoint(i).GetPoint() - Source;
+    if (R.Dot(ZAxis) <= 0 || R.Mag() < kAnalyticFarFieldFactor * Length) {
+      fLastCalculationPath = "numerical: observer not in far field";
+      return false;
+    }
 
-  // If use GPU, let's check the GPU vector, or construct one if we must
-  std::vector<int> GPUVector;
-  for (std::vector<int>::const_iterator it = VGPU.begin(); it != VGPU.end(); ++it) {
-    GPUVector.push_back(*it);
-  }
-  if (GPUVector.size() == 0) {
-    for (int i = 0; i < NGPU; ++i) {
-      GPUVector.push_back(i);
+    double const RX = R.Dot(XAxis);
+    double const RY = R.Dot(YAxis);
+    double const RZ = R.Dot(ZAxis);
+    AnglesH[i] = atan2(RX, RZ);
+    AnglesV[i] = atan2(RY, sqrt(RZ * RZ + RX * RX));
+
+    // Incidence on the surface as in the numerical calculation
+    double const Projection = HasNormal ? R.UnitVector().Dot(Surface.GetPoint(i).GetNormal()) : 1;
+    if (Directional) {
+      Factor[i] = Projection > 0 ? Projection / R.Mag2() : 0;
+    } else {
+      Factor[i] = fabs(Projection) / R.Mag2();
     }
   }
-  if (NGPU != -1 && NGPU < (int) GPUVector.size()) {
-    GPUVector.resize(NGPU);
-  }
 
+  OSCARSTH TH;
+  TH.SetParticleBeam(fParticle.GetE0(), fParticle.GetCurrent());
 
-  // Check polarization
-  if (Polarization == "all" ||
-      Polarization == "linear-horizontal" ||
-      Polarization == "linear-vertical"   ||
-      Polarization == "linear"            ||
-      Polarization == "circular-left"     ||
-      Polarization == "circular-right") {
-    // Do nothing
-  } else {
-    throw std::invalid_argument("Polarization requested not recognized");
+  std::vector<double> PowerDensity;
+  TH.UndulatorPowerDensityAngles(K, Period, NPeriods, AnglesH, AnglesV, PowerDensity, NThreads);
+
+  // Convert from per mrad^2 to per mm^2 at each point
+  size_t iMax = 0;
+  for (size_t i = 0; i != NPoints; ++i) {
+    PowerDensity[i] *= Factor[i];
+    if (PowerDensity[i] > PowerDensity[iMax]) {
+      iMax = i;
+    }
   }
 
+  std::ostringstream Path;
+  Path << "analytic: ideal undulator without end fields";
 
-  // Which cpmpute method will we use, gpu, multi-thread, or single-thread
-  if (UseGPU) {
-    // Send to GPU function
-    this->CalculateSpectrumGPU(fParticle,
-                               ObservationPoint,
-                               Spectrum,
-                               Polarization,
-                               Angle,
-                               HorizontalDirection,
-                               PropogationDirection,
-                               NParticles,
-                               GPUVector,
-                               Precision,
-                               MaxLevel,
-                               MaxLevelExtended,
-                               ReturnQuantity);
-  } else {
-    if (NParticles == 0) {
-      if (NThreadsToUse == 1) {
-        this->CalculateSpectrum(fParticle,
-                                ObservationPoint,
-                                Spectrum,
-                                Polarization,
-                                Angle,
-                                HorizontalDirection,
-                                PropogationDirection,
-                                Precision,
-                                MaxLevel,
-                                MaxLevelExtended,
-                                1,
-                                ReturnQuantity);
+  // Validation points calculated numerically
+  size_t const NValidation = std::min((size_t) fAnalyticNValidation, NPoints);
+  if (NValidation > 0) {
+    std::vector<size_t> Indices(1, iMax);
+    for (size_t iv = 1; iv < NValidation; ++iv) {
+      Indices.push_back(((2 * iv - 1) * NPoints) / (2 * (NValidation - 1)));
+    }
+
+    TSurfacePoints_3D ValidationSurface;
+    T3DScalarContainer ValidationContainer;
+    for (size_t iv = 0; iv != Indices.size(); ++iv) {
+      TSurfacePoint const P = Surface.GetPoint(Indices[iv]);
+      if (HasNormal) {
+        ValidationSurface.AddPoint(P.GetPoint(), P.GetNormal());
       } else {
-        this->CalculateSpectrumThreads(fParticle,
-                                       ObservationPoint,
-                                       Spectrum,
-                                       NThreadsToUse,
-                                       Polarization,
-                                       Angle,
-                                       HorizontalDirection,
-                                       PropogationDirection,
-                                       Precision,
-                                       MaxLevel,
-                                       MaxLevelExtended,
-                                       1,
-                                       ReturnQuantity);
+        ValidationSurface.AddPoint(P.GetPoint());
       }
-    } else {
-      // Weight this by the number of particles
-      double const Weight = 1.0 / (double) NParticles;
-
-      // Loop over particles
-      for (int i = 0; i != NParticles; ++i) {
+      ValidationContainer.AddPoint(P.GetPoint(), 0);
+    }
 
-        // Set a new random particle
-        this->SetNewParticle();
-        this->CalculateTrajectory();
+    this->CalculatePowerDensity(fParticle, ValidationSurface, ValidationContainer, Directional, Precision, MaxLevel, MaxLevelExtended, 1, 0);
 
-        if (NThreadsToUse == 1) {
-          this->CalculateSpectrum(fParticle,
-                                  ObservationPoint,
-                                  Spectrum,
-                                  Polarization,
-                                  Angle,
-                                  HorizontalDirection,
-                                  PropogationDirection,
-                                  Precision,
-                                  MaxLevel,
-                                  MaxLevelExtended,
-                                  Weight,
-                                  ReturnQuantity);
-        } else {
-          this->CalculateSpectrumThreads(fParticle,
-                                         ObservationPoint,
-                                         Spectrum,
-                                         NThreadsToUse,
-                                         Polarization,
-                                         Angle,
-                                         HorizontalDirection,
-                                         PropogationDirection,
-                                         Precision,
-                                         MaxLevel,
-                                         MaxLevelExtended,
-                                         Weight,
-                                         ReturnQuantity);
-        }
-      }
+    // Largest difference relative to the maximum
+    double MaxDifference = 0;
+    for (size_t iv = 0; iv != Indices.size(); ++iv) {
+      MaxDifference = std::max(MaxDifference, fabs(ValidationContainer.GetPoint(iv).GetV() - PowerDensity[Indices[iv]]));
     }
+    Path << " (validation: " << Indices.size() << " points, max difference " << std::setprecision(2) << (PowerDensity[iMax] > 0 ? MaxDifference / PowerDensity[iMax] : 0) << " of peak)";
   }
 
+  for (size_t i = 0; i != NPoints; ++i) {
+    PowerDensityContainer.AddToPoint(i, PowerDensity[i]);
+  }
 
-  return;
+  fLastCalculationPath = Path.str();
+  return true;
 }
 
 
 
 
-
-void OSCARSSR::CalculateSpectrumPoints (TParticleA& Particle,
-                                        TVector3D const& ObservationPoint,
-                                        TSpectrumContainer& Spectrum,
-                                        size_t const iThread,
-                                        size_t const NThreads,
-                                        bool& Done,
-                                        std::string const& Polarization,
-                                        double const Angle,
-                                        TVector3D const& HorizontalDirection,
-                                        TVector3D const& PropogationDirection,
-                                        double const Precision,
-                                        int    const MaxLevel,
-                                        int    const MaxLevelExtended,
-                                        double const Weight,
-                                        int    const ReturnQuantity)
+bool OSCARSSR::CalculateFluxAnalytic (TSurfacePoints const& Surface,
+                                      double const Energy_eV,
+                                      T3DScalarContainer& FluxContainer,
+                                      std::string const& Polarization,
+                                      int const NParticles,
+                                      int const NThreads,
+                                      int const ReturnQuantity)
 {
-  // Calculates the single particle spectrum at a given observation point
-  // in units of [photons / second / 0.001% BW / mm^2]
-  // Save this in the spectrum container.
-  //
-  // Particle - the Particle.. with a Trajectory structure hopefully
-  // ObservationPoint - Observation Point
-  // Spectrum - Spectrum container
+  // If the analytic mode is on and the configuration allows it calculate the
+  // flux on the surface from OSCARSTH and return true.  Otherwise record why the
+  // numerical calculation is being used and return false.  The container must
+  // already hold one point per surface point.
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (Particle.GetType() == "") {
-    throw std::out_of_range("no particle defined");
+  if (fAnalyticMode == kAnalyticMode_Off) {
+    fLastCalculationPath = "numerical";
+    return false;
   }
 
-  // Check you are not requesting a level above the maximum
-  if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
-    std::cerr << "WARNING: MaxLevel > TParticleA::kMaxTrajectoryLevel.  Setting MaxLevel to TParticleA::kMaxTrajectoryLevel" << std::endl;
+  TVector3D Source;
+  TVector3D XAxis;
+  TVector3D YAxis;
+  TVector3D ZAxis;
+  double K;
+  double Period;
+  int    NPeriods;
+  double Length;
+  std::string Reason;
+
+  if (!this->CheckAnalyticUndulator(NParticles, Polarization, ReturnQuantity, Source, XAxis, YAxis, ZAxis, K, Period, NPeriods, Length, Reason)) {
+    fLastCalculationPath = "numerical: " + Reason;
+    return false;
   }
 
-  // Set the level to stop at if requested, but not above the hard limit
-  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
-  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
-
-  // Number of points in spectrum
-  int const NSpectrumPoints = Spectrum.GetNPoints();
+  size_t const NPoints = Surface.GetNPoints();
+  std::vector<double> AnglesH(NPoints);
+  std::vector<double> AnglesV(NPoints);
+  std::vector<double> Energies_eV(NPoints, Energy_eV);
+  std::vector<double> R2(NPoints);
+
+  // Every point must be downstream and in the far field
+  for (size_t i = 0; i != NPoints; ++i) {
+    TVector3D const R = Surface.GetPoint(i).GetPoint() - Source;
+    if (R.Dot(ZAxis) <= 0 || R.Mag() < kAnalyticFarFieldFactor * Length) {
+      fLastCalculationPath = "numerical: observer not in far field";
+      return false;
+    }
 
-  // Check input spectrum range numbers
-  if (iThread >= NThreads) {
-    throw std::out_of_range("spectrum thread range is incorrect.  Please report this error.");
+    double const RX = R.Dot(XAxis);
+    double const RY = R.Dot(YAxis);
+    double const RZ = R.Dot(ZAxis);
+    AnglesH[i] = atan2(RX, RZ);
+    AnglesV[i] = atan2(RY, sqrt(RZ * RZ + RX * RX));
+    R2[i] = R.Mag2();
   }
 
-  // Constant C0 for calculation
-  double const C0 = Particle.GetQ() / (TOSCARSSR::FourPi() * TOSCARSSR::C() * TOSCARSSR::Epsilon0() * TOSCARSSR::Sqrt2Pi());
+  OSCARSTH TH;
+  TH.SetParticleBeam(fParticle.GetE0(), fParticle.GetCurrent());
 
-  // Constant for flux calculation at the end
-  double const C2 = TOSCARSSR::FourPi() * Particle.GetCurrent() / (TOSCARSSR::H() * fabs(Particle.GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
+  std::vector<double> Flux;
+  TH.UndulatorFluxAngles(K, Period, NPeriods, AnglesH, AnglesV, Energies_eV, Flux, OSCARSTH::kUndulatorType_Planar, NThreads);
 
-  // Imaginary "i" and complxe 1+0i
-  std::complex<double> const I(0, 1);
-  std::complex<double> const One(1, 0);
+  // Convert from per mrad^2 to per mm^2 at each point
+  for (size_t i = 0; i != NPoints; ++i) {
+    FluxContainer.AddToPoint(i, Flux[i] / R2[i]);
+  }
 
-  // Photon vertical direction and positive and negative helicity
-  TVector3D  const VerticalDirection = PropogationDirection.Cross(HorizontalDirection).UnitVector();
-  TVector3DC const Positive = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) + VerticalDirection * I );
-  TVector3DC const Negative = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) - VerticalDirection * I );
+  fLastCalculationPath = "analytic: ideal undulator without end fields";
+  return true;
+}
 
-  TVector3DC PolarizationVector(0, 0, 0);
-  if (Polarization == "all") {
-    // Do Nothing
-  } else if (Polarization == "linear-horizontal") {
-    PolarizationVector = HorizontalDirection;
-  } else if (Polarization == "linear-vertical") {
-    PolarizationVector = VerticalDirection;
-  } else if (Polarization == "linear") {
-    TVector3D PolarizationAngle = HorizontalDirection;
-    PolarizationAngle.RotateSelf(Angle, PropogationDirection);
-    PolarizationVector = PolarizationAngle;
-  } else if (Polarization == "circular-left") {
-    PolarizationVector = Positive;
-  } else if (Polarization == "circular-right") {
-    PolarizationVector = Negative;
-  } else {
-    // Throw invalid argument if polarization is not recognized
-    throw std::invalid_argument("Polarization requested not recognized");
-  }
 
 
-  // Extended trajectory (not using memory for storage of arrays
-  TParticleTrajectoryInterpolatedPoints TE;
 
-  // Alternative outputs
-  double Result_Precision = -1;
-  int    Result_Level     = -1;
+int OSCARSSR::ForkProcesses (int const NProcesses,
+                             int const NParticles,
+                             size_t const NValues,
+                             int& NParticlesThis)
+{
+  // Fork NProcesses workers which share NParticles between them.  A shared memory
+  // segment is created before forking with one slot per process for NValues results,
+  // convergence flags, a status, and an error message.  Each worker is seeded from
+  // the parent generator so that it has its own stream and results are reproducible
+  // for a given seed.  Returns the process index in a worker (with NParticlesThis
+  // set) and -1 in the parent.
+
+#ifdef _WIN32
+  throw std::invalid_argument("multiple processes are not supported on this platform");
+#else
+
+  // Seeds for each process
+  std::vector<int> Seeds;
+  for (int i = 0; i < NProcesses; ++i) {
+    Seeds.push_back((int) (gRandomA->Uniform() * 2147483646.));
+  }
 
+  // Shared memory: values, status, messages, convergence flags
+  fProcessNValues = NValues;
+  fProcessSharedSize = NProcesses * (NValues * sizeof(double) + sizeof(int32_t) + 256 + NValues);
+  void* Shared = mmap(NULL, fProcessSharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (Shared == MAP_FAILED) {
+    throw std::length_error("cannot allocate shared memory for processes");
+  }
+  fProcessShared = (char*) Shared;
+  std::memset(fProcessShared, 0, fProcessSharedSize);
+
+  fProcessIDs.clear();
+  fProcessNParticles.clear();
+
+  // Flush so that buffered output is not duplicated in the workers
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(NULL);
+
+  for (int i = 0; i < NProcesses; ++i) {
+    int const NThis = NParticles / NProcesses + (i < NParticles % NProcesses ? 1 : 0);
+
+    pid_t const PID = fork();
+    if (PID == 0) {
+      // Worker process: no recursion or checkpoints, own random stream
+      fNProcessesGlobal = 1;
+      this->ClearCheckpoint();
+      gRandomA->SetSeed(Seeds[i]);
+      fProcessIDs.clear();
+
+      NParticlesThis = NThis;
+      return i;
+    }
 
-  // Loop over all points in the spectrum container
-  for (size_t i = iThread; i < NSpectrumPoints; i += NThreads) {
+    if (PID < 0) {
+      // Stop and clean up whatever was started
+      for (size_t j = 0; j != fProcessIDs.size(); ++j) {
+        kill((pid_t) fProcessIDs[j], SIGKILL);
+        waitpid((pid_t) fProcessIDs[j], NULL, 0);
+      }
+      fProcessIDs.clear();
+      fProcessNParticles.clear();
+      munmap(fProcessShared, fProcessSharedSize);
+      fProcessShared = 0x0;
+      throw std::length_error("cannot fork process");
+    }
 
-    // Angular frequency
-    double const Omega = Spectrum.GetAngularFrequency(i);
+    fProcessIDs.push_back((int) PID);
+    fProcessNParticles.push_back(NThis);
+  }
 
-    // Electric field summation in frequency space
-    TVector3DC SumE(0, 0, 0);
+  return -1;
+#endif
+}
 
-    double ThisMag = -1;
-    double LastMag = -1;
-    double ThisPhase = -1;
-    double LastPhase = -1;
-    double MaxDPhase = 0;
-    int    LastLevel = 0;
 
-    for (int iLevel = 0; iLevel <= LevelStopWithExtended; ++iLevel) {
-      LastLevel = iLevel;
 
-      // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
-      TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
-      if (iLevel > LevelStopMemory) {
-        TE = Particle.GetTrajectoryExtendedLevel(iLevel);
-      }
 
+void OSCARSSR::FinishProcess (int const iProcess,
+                              TSpectrumContainer const* Spectrum,
+                              T3DScalarContainer const* Container,
+                              std::string const& Error)
+{
+  // Copy the result of this worker into its slot in shared memory and exit.  If
+  // Error is not empty it is reported to the parent instead.  Does not return.
+
+#ifndef _WIN32
+  size_t const NProcesses = fProcessSharedSize / (fProcessNValues * sizeof(double) + sizeof(int32_t) + 256 + fProcessNValues);
+
+  double*  Values  = (double*) fProcessShared + iProcess * fProcessNValues;
+  int32_t* Status  = (int32_t*) (fProcessShared + NProcesses * fProcessNValues * sizeof(double)) + iProcess;
+  char*    Message = fProcessShared + NProcesses * (fProcessNValues * sizeof(double) + sizeof(int32_t)) + iProcess * 256;
+  char*    NotConverged = fProcessShared + NProcesses * (fProcessNValues * sizeof(double) + sizeof(int32_t) + 256) + iProcess * fProcessNValues;
+
+  if (Error == "" && (Spectrum != 0x0 || Container != 0x0)) {
+    for (size_t i = 0; i != fProcessNValues; ++i) {
+      if (Spectrum != 0x0) {
+        Values[i] = Spectrum->GetFlux(i);
+        NotConverged[i] = Spectrum->IsConverged(i) ? 0 : 1;
+      } else {
+        Values[i] = Container->GetPoint(i).GetV();
+        NotConverged[i] = Container->IsConverged(i) ? 0 : 1;
+      }
+    }
+    *Status = 1;
+  } else {
+    std::strncpy(Message, Error == "" ? "unknown error" : Error.c_str(), 255);
+    *Status = 2;
+  }
 
-      // Number of points in the trajectory
-      size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(NULL);
+  _exit(0);
+#endif
 
+  return;
+}
 
-      MaxDPhase = 0;
-      // Loop over trajectory points
-      for (int iT = 0; iT != NTPoints; ++iT) {
-        TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
 
-        // Get position, Beta, and Acceleration (over c)
-        TVector3D const& X = PP.GetX();
-        TVector3D const& B = PP.GetB();
-        TVector3D const& AoverC = PP.GetAoverC();
-        double    const  Time = iLevel <= LevelStopMemory ? TM.GetT(iT) : TE.GetT(iT);
 
-        // Define R and unit vector in direction of R, and D (distance to observer)
-        TVector3D const R = ObservationPoint - X;
-        TVector3D const N = R.UnitVector();
-        double const D = R.Mag();
 
-        // Exponent in transformed field
-        ThisPhase = -Omega * (Time + D / TOSCARSSR::C());
-        double const PhaseTestValue = fabs(ThisPhase - LastPhase);
-        if (iT != 0 && PhaseTestValue > MaxDPhase) {
-          MaxDPhase = PhaseTestValue;
-        }
-        LastPhase = ThisPhase;
-        std::complex<double> Exponent(0, ThisPhase);
+void OSCARSSR::ReduceProcesses (int const NParticles,
+                                TSpectrumContainer* Spectrum,
+                                T3DScalarContainer* Container)
+{
+  // Wait for all workers and add their results, each weighted by the fraction of
+  // particles it ran, to the container.  Processes are summed in order so the
+  // result does not depend on which finished first.
+
+#ifndef _WIN32
+  size_t const NProcesses = fProcessIDs.size();
+
+  std::string Error = "";
+  for (size_t i = 0; i != NProcesses; ++i) {
+    int WaitStatus = 0;
+    if (waitpid((pid_t) fProcessIDs[i], &WaitStatus, 0) < 0 || !WIFEXITED(WaitStatus)) {
+      Error = "worker process terminated abnormally";
+    }
+  }
 
-        TVector3DC const ThisEw = ( ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
-            + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ) ) * std::exp(Exponent); // NF + FF
+  double const*  Values  = (double const*) fProcessShared;
+  int32_t const* Status  = (int32_t const*) (fProcessShared + NProcesses * fProcessNValues * sizeof(double));
+  char const*    Message = fProcessShared + NProcesses * (fProcessNValues * sizeof(double) + sizeof(int32_t));
+  char const*    NotConverged = fProcessShared + NProcesses * (fProcessNValues * sizeof(double) + sizeof(int32_t) + 256);
 
-        // Add this contribution
-        SumE += ThisEw;
+  for (size_t ip = 0; ip != NProcesses && Error == ""; ++ip) {
+    if (Status[ip] == 2) {
+      Error = std::string(Message + ip * 256);
+    } else if (Status[ip] != 1) {
+      Error = "worker process did not finish";
+    }
+  }
 
+  if (Error == "") {
+    for (size_t ip = 0; ip != NProcesses; ++ip) {
+      double const Weight = (double) fProcessNParticles[ip] / (double) NParticles;
+      for (size_t i = 0; i != fProcessNValues; ++i) {
+        if (Spectrum != 0x0) {
+          Spectrum->AddToFlux(i, Weight * Values[ip * fProcessNValues + i]);
+          if (NotConverged[ip * fProcessNValues + i]) {
+            Spectrum->SetNotConverged(i);
+          }
+        } else {
+          Container->AddToPoint(i, Weight * Values[ip * fProcessNValues + i]);
+          if (NotConverged[ip * fProcessNValues + i]) {
+            Container->SetNotConverged(i);
+          }
+        }
       }
+    }
+  }
 
-      TVector3DC ThisSumE = SumE * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
-      if (PolarizationVector.Mag2() > 0.001) {
-        ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
-      }
-      ThisMag = ThisSumE.Dot( ThisSumE.CC() ).real();
+  munmap(fProcessShared, fProcessSharedSize);
+  fProcessShared = 0x0;
+  fProcessSharedSize = 0;
+  fProcessIDs.clear();
+  fProcessNParticles.clear();
 
-      Result_Precision = fabs(ThisMag - LastMag) / LastMag;
-      if (iLevel > 8 && Result_Precision < Precision && MaxDPhase < TOSCARSSR::Pi()) {
-        Result_Level = iLevel;
-        break;
-      }
+  if (Error != "") {
+    throw std::invalid_argument(Error);
+  }
+#endif
 
-      LastMag = ThisMag;
-    }
+  return;
+}
 
-    if (Result_Level == -1) {
-      Spectrum.SetNotConverged(i);
-    }
 
-    // Multiply by constant factor
-    SumE *= C0 * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
 
-    // Correcr for polarization
-    if (PolarizationVector.Mag2() > 0.001) {
-      SumE = SumE.Dot(PolarizationVector) * PolarizationVector;
-    }
 
-    // Set the flux for this frequency / energy point
-    // Add to container
-    switch (ReturnQuantity) {
-      case 1:
-        Spectrum.AddToFlux(i, Result_Precision * Weight);
-        break;
-      case 2:
-        Spectrum.AddToFlux(i, ((double) Result_Level) * Weight);
-        break;
-      default:
-        Spectrum.AddToFlux(i, C2 *  SumE.Dot( SumE.CC() ).real() * Weight);
-        break;
-    }
-  }
-
-
-  // Set done to true
-  Done = true;
-
-  return;
-}
-
-
-
-
-
-void OSCARSSR::CalculateSpectrumThreads (TParticleA& Particle,
-                                         TVector3D const& Obs,
-                                         TSpectrumContainer& Spectrum,
-                                         int const NThreads,
-                                         std::string const& Polarization,
-                                         double const Angle,
-                                         TVector3D const& HorizontalDirection,
-                                         TVector3D const& PropogationDirection,
-                                         double const Precision,
-                                         int    const MaxLevel,
-                                         int    const MaxLevelExtended,
-                                         double const Weight,
-                                         int    const ReturnQuantity)
+void OSCARSSR::CorrectTrajectory ()
 {
-  // Calculates spectrum for the given particle and observation point
-  // in units of [photons / second / 0.001% BW / mm^2]
-  //
-  // Surface - Observation Point
-
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
-  }
-
-  // Vector container for threads
-  std::vector<std::thread> Threads;
-
-  // Number of points in spectrum
-  size_t const NPoints = Spectrum.GetNPoints();
-
-  // How many threads to start in the first for loop
-  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
-
-  // Keep track of which threads are finished and re-joined
-  bool *Done = new bool[NThreadsActual];
-  bool *Joined = new bool[NThreadsActual];
+  // Correct the ideal trajectory so that the position and direction at
+  // a specified point is as close as possible to the specified values
 
-  // Number per thread plus remainder to be added to first threads
-  size_t const NPerThread = NPoints / NThreadsActual;
-  size_t const NRemainder = NPoints % NThreadsActual;
+  TVector3D Direction(0, 0, 1);
+  TVector3D ExitPoint(0, 0, 2);
 
-  // Start threads and keep in vector
-  for (size_t it = 0; it != NThreadsActual; ++it) {
+  TVector3D V0 = Direction.Perp();
+  TVector3D V1 = Direction.Cross(V0);
 
-    // First and last points for each thread
-    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
-    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+  TParticleTrajectoryPoints& ParticleTrajectory = fParticle.GetTrajectory();
 
-    // Set Done and joined to false for this thread
-    Done[it] = false;
-    Joined[it] = false;
+  // Closest approach to point and direction
+  double MinimumDistance2;
+  size_t MinimumDistanceIndex = 0;
+  for (size_t i = 0; i != ParticleTrajectory.GetNPoints(); ++i) {
+    double const Distance2 = (ParticleTrajectory.GetX(i) - ExitPoint).Mag2();
 
-    // Start thread for these points
-    Threads.push_back(std::thread(&OSCARSSR::CalculateSpectrumPoints,
-                                  this,
-                                  std::ref(Particle),
-                                  std::ref(Obs),
-                                  std::ref(Spectrum),
-                                  it,
-                                  NThreadsActual,
-                                  std::ref(Done[it]),
-                                  std::ref(Polarization),
-                                  Angle,
-                                  std::ref(HorizontalDirection),
-                                  std::ref(PropogationDirection),
-                                  Precision,
-                                  MaxLevel,
-                                  MaxLevelExtended,
-                                  Weight,
-                                  ReturnQuantity));
+    if (i == 0) {
+      MinimumDistance2 = Distance2;
+    }
 
+    if (Distance2 < MinimumDistance2) {
+      MinimumDistance2 = Distance2;
+      MinimumDistanceIndex = i;
+    }
   }
+  std::cout << "MinimumDistance " << sqrt(MinimumDistance2) << std::endl;
 
-  // Are all of the threads finished or not?  Continue loop until all come back.
-  bool AllThreadsFinished = false;
-  size_t NThreadsFinished = 0;
-  while (!AllThreadsFinished) {
+  this->AddMagneticField(new TField3D_Gaussian(TVector3D(0, 0.0001, 0),
+                                               TVector3D(0, 0, -1.8),
+                                               TVector3D(0, 0, 0.010),
+                                               TVector3D(0, 0, 0),
+                                               "_autocorrector_entry"));
 
+  this->AddMagneticField(new TField3D_Gaussian(TVector3D(0, 0.0001, 0),
+                                               TVector3D(0, 0, +1.8),
+                                               TVector3D(0, 0, 0.010),
+                                               TVector3D(0, 0, 0),
+                                               "_autocorrector_exit"));
 
-    // So as to not use the current thread at 100%
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  return;
+}
 
-    // Check all threads
-    for (size_t it = 0; it != NThreadsActual; ++it) {
 
-      if (Done[it] && !Joined[it]) {
-        Threads[it].join();
-        Joined[it] = true;
-        ++NThreadsFinished;
-      }
-    }
+void OSCARSSR::CalculateTrajectory ()
+{
+  // Function to calculate the particle trajectory of the member particle fParticle
 
-    // If the number finished is equal to the number of points total then we're done
-    if (NThreadsFinished == NThreadsActual) {
-      AllThreadsFinished = true;
-    }
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (fParticle.GetType() == "") {
+    this->SetNewParticle();
   }
 
-
-  // Clear all threads
-  Threads.clear();
-
-  // Delete my arrays, I hate new for this purpose
-  delete [] Done;
-  delete [] Joined;
+  this->CalculateTrajectory(fParticle);
 
   return;
 }
@@ -1684,116 +1904,146 @@ void OSCARSSR::CalculateSpectrumThreads (TParticleA& Particle,
 
 
 
-
-void OSCARSSR::CalculateSpectrumGPU (TParticleA& Particle,
-                                     TVector3D const& ObservationPoint,
-                                     TSpectrumContainer& Spectrum,
-                                     std::string const& Polarization,
-                                     double const Angle,
-                                     TVector3D const& HorizontalDirection,
-                                     TVector3D const& PropogationDirection,
-                                     int const NParticles,
-                                     std::vector<int> GPUVector,
-                                     double const Precision,
-                                     int    const MaxLevel,
-                                     int    const MaxLevelExtended,
-                                     int    const ReturnQuantity)
+void OSCARSSR::CalculateTrajectory (TParticleA& P)
 {
-  // If you compile for Cuda use the GPU in this function, else throw
+  // Function to calculate the particle trajectory given initial conditions.
+  // This function uses the internal Trajectory member to store results
 
-  // If GPUVector is empty assume you want to use ALL GPUs available
-  if (GPUVector.size() == 0) {
-    int const NGPUAvailable = this->CheckGPU();
-    for (int i = 0; i < NGPUAvailable; ++i) {
-      GPUVector.push_back(i);
-    }
+  // Check that CTStart is not after T0 of particle
+  if (this->GetCTStart() > P.GetT0()) {
+    std::cerr << "GetCTStart() P.GetT0(): " << this->GetCTStart() << " " << P.GetT0() << std::endl;
+    throw std::out_of_range("start time is greater than T0");
   }
 
-  #ifdef CUDA
-  // Check that the GPU exists
-  if (this->CheckGPU() < 1) {
-    throw std::invalid_argument("You are requesting the GPU, but none were found");
+  // Check that CTStart and CTStop are not the same (probably not defined if this is the case)
+  if (this->GetCTStart() >= this->GetCTStop()) {
+    throw std::out_of_range("start time is greater than stop time.  check that set_ctstartstop is set");
   }
 
-  // Set the level to stop at if requested, but not above the hard limit
-  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
-  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (P.GetType() == "") {
+    throw std::out_of_range("particle not initialized.  make sure you have a particle or beam defined");
+  }
 
+  // Clear any current trajectory
+  P.ResetTrajectoryData();
 
-  return OSCARSSR_Cuda_CalculateSpectrumGPU (*this,
-                                             ObservationPoint,
-                                             Spectrum,
-                                             Polarization,
-                                             Angle,
-                                             HorizontalDirection,
-                                             PropogationDirection,
-                                             NParticles,
-                                             GPUVector,
-                                             Precision,
-                                             LevelStopWithExtended,
-                                             ReturnQuantity);
-  #else
-  throw std::invalid_argument("GPU functionality not compiled into this binary distribution");
-  #endif
+  // Calculate the total DeltaT in seconds
+  double const DeltaT = ((this->GetCTStop() - this->GetCTStart()) / TOSCARSSR::C() / (fNPointsTrajectory - 1));
 
-  return;
-}
 
+  // The number of points in the forward and backward direction
+  // UPDATE: Check the details of these numbers
+  size_t NPointsForward  = 1 + (this->GetCTStop() - P.GetT0()) / TOSCARSSR::C() / DeltaT;
+  size_t NPointsBackward = (P.GetT0() - this->GetCTStart()) / TOSCARSSR::C() / DeltaT;
 
 
+  // Number of dimensions of the array to be sent for RK calculation
+  int const N = 6;
 
+  // Arrays to be sent for RK calculation
+  double x[N];
+  double dxdt[N];
 
+  // Initial conditions for the forward propogation
+  x[0] = P.GetX0().GetX();
+  x[1] = P.GetB0().GetX() * TOSCARSSR::C();
+  x[2] = P.GetX0().GetY();
+  x[3] = P.GetB0().GetY() * TOSCARSSR::C();
+  x[4] = P.GetX0().GetZ();
+  x[5] = P.GetB0().GetZ() * TOSCARSSR::C();
 
 
+  // Grap the particle trajectory object
+  TParticleTrajectoryPoints& ParticleTrajectory = P.GetTrajectory();
+  ParticleTrajectory.Reserve(NPointsForward + NPointsBackward);
 
+  // Set delta T for the trajectory
+  ParticleTrajectory.SetDeltaT(DeltaT);
 
+  // Derivatives at the initial point.  In the loop these are from the previous step
+  (this->*fDerivativesFunction)(P.GetT0() / TOSCARSSR::C(), x, dxdt, P);
 
+  // Loop over points in the forward direction
+  for (size_t i = 0; i != NPointsForward; ++i) {
 
+    // This time
+    double t = P.GetT0() / TOSCARSSR::C() + DeltaT * i;
 
 
+    // UPDATE: dhidas dhidas dhidas
+    if (fDriftVolumeContainer.IsInside(TVector3D(x[0], x[2], x[4]))) {
+      x[0] += DeltaT * x[1];
+      x[2] += DeltaT * x[3];
+      x[4] += DeltaT * x[5];
+    } else {
+      // Add this point to the trajectory
+      ParticleTrajectory.AddPoint(x[0], x[2], x[4], x[1] / TOSCARSSR::C(), x[3] / TOSCARSSR::C(), x[5] / TOSCARSSR::C(), dxdt[1] / TOSCARSSR::C(), dxdt[3] / TOSCARSSR::C(), dxdt[5] / TOSCARSSR::C(), t);
 
+      // Propogate
+      (this->*fDerivativesFunction)(t, x, dxdt, P);
+      RK4(x, dxdt, N, t, DeltaT, x, P);
+    }
+  }
 
+  // Reverse trajectory elements for backward propogation
+  ParticleTrajectory.ReverseArrays();
 
+  // Set initial conditions for propogating backwards
+  x[0] =  P.GetX0().GetX();
+  x[1] =  P.GetB0().GetX() * TOSCARSSR::C();
+  x[2] =  P.GetX0().GetY();
+  x[3] =  P.GetB0().GetY() * TOSCARSSR::C();
+  x[4] =  P.GetX0().GetZ();
+  x[5] =  P.GetB0().GetZ() * TOSCARSSR::C();
 
+  // Reverse time
+  double const DeltaTReversed = -DeltaT;
 
-void OSCARSSR::AddToSpectrum (TSpectrumContainer const& S, double const Weight)
-{
-  // Check if spectrum exists yet or not.  In not, create it
-  if (fSpectrum.GetNPoints() == 0) {
-    for (size_t i = 0; i != S.GetNPoints(); ++i) {
-      fSpectrum.AddPoint(S.GetEnergy(i), S.GetFlux(i) * Weight);
-    }
-  } else if (fSpectrum.GetNPoints() == S.GetNPoints()) {
-    for (size_t i = 0; i != S.GetNPoints(); ++i) {
-      fSpectrum.AddToFlux(i, S.GetFlux(i) * Weight);
+  // Loop over all points "before" the initial point
+  for (size_t i = 0; i != NPointsBackward; ++i) {
+
+    // This time
+    double t = P.GetT0() / TOSCARSSR::C() + DeltaTReversed * (i + 1);
+
+    if (fDriftVolumeContainer.IsInside(TVector3D(x[0], x[2], x[4]))) {
+      x[0] += DeltaTReversed * x[1];
+      x[2] += DeltaTReversed * x[3];
+      x[4] += DeltaTReversed * x[5];
+    } else {
+      // Propogate backward in time!
+      (this->*fDerivativesFunction)(t, x, dxdt, P);
+      RK4(x, dxdt, N, t, DeltaTReversed, x, P);
+
+      // Add the point to the trajectory
+      ParticleTrajectory.AddPoint(x[0], x[2], x[4], x[1] / TOSCARSSR::C(), x[3] / TOSCARSSR::C(), x[5] / TOSCARSSR::C(), dxdt[1] / TOSCARSSR::C(), dxdt[3] / TOSCARSSR::C(), dxdt[5] / TOSCARSSR::C(), t);
     }
-  } else {
-    throw std::out_of_range("spectra dimensions do not match");
   }
 
+  // Re-Reverse the trajectory to be in the proper time order
+  ParticleTrajectory.ReverseArrays();
+
+  P.SetupTrajectoryInterpolated();
+
   return;
 }
 
 
 
 
+TParticleTrajectoryPoints const& OSCARSSR::GetTrajectory ()
+{
+  // Get the trajectory for *the* current particle in fParticle
+
+  return fParticle.GetTrajectory();
+}
+
 
 
-void OSCARSSR::AddToFlux (T3DScalarContainer const& F, double const Weight)
-{
-  // Check if spectrum exists yet or not.  In not, create it
-  if (fFlux.GetNPoints() == 0) {
-    for (size_t i = 0; i != F.GetNPoints(); ++i) {
-      fFlux.AddPoint(F.GetPoint(i).GetX(), F.GetPoint(i).GetV() * Weight);
-    }
-  } else if (fFlux.GetNPoints() == F.GetNPoints()) {
-    for (size_t i = 0; i != F.GetNPoints(); ++i) {
-      fFlux.AddToPoint(i, F.GetPoint(i).GetV() * Weight);
-    }
-  } else {
-    throw std::out_of_range("spectra dimensions do not match");
-  }
 
+void OSCARSSR::ClearTrajectory ()
+{
+  fParticle.ResetTrajectoryData();
   return;
 }
 
@@ -1801,20 +2051,17 @@ void OSCARSSR::AddToFlux (T3DScalarContainer const& F, double const Weight)
 
 
 
-
-void OSCARSSR::AddToPowerDensity (T3DScalarContainer const& P, double const Weight)
+void OSCARSSR::SetDerivativesFunction ()
 {
-  // Check if spectrum exists yet or not.  In not, create it
-  if (fPowerDensity.GetNPoints() == 0) {
-    for (size_t i = 0; i != P.GetNPoints(); ++i) {
-      fPowerDensity.AddPoint(P.GetPoint(i).GetX(), P.GetPoint(i).GetV() * Weight);
-    }
-  } else if (fPowerDensity.GetNPoints() == P.GetNPoints()) {
-    for (size_t i = 0; i != P.GetNPoints(); ++i) {
-      fPowerDensity.AddToPoint(i, P.GetPoint(i).GetV() * Weight);
-    }
+  // Set the derivatives function for RK4 depending on what fields exist
+  // I am using a function pointer so that we avoid computations that are not needed (save CPU cycles)
+
+  if (fBFieldContainer.GetNFields() == 0 && fEFieldContainer.GetNFields() > 0) {
+    fDerivativesFunction = &OSCARSSR::DerivativesE;
+  } else if (fBFieldContainer.GetNFields() > 0 && fEFieldContainer.GetNFields() == 0) {
+    fDerivativesFunction = &OSCARSSR::DerivativesB;
   } else {
-    throw std::out_of_range("spectra dimensions do not match");
+    fDerivativesFunction = &OSCARSSR::DerivativesEB;
   }
 
   return;
@@ -1825,134 +2072,258 @@ void OSCARSSR::AddToPowerDensity (T3DScalarContainer const& P, double const Weig
 
 
 
-TSpectrumContainer const& OSCARSSR::GetSpectrum () const
+
+
+
+void OSCARSSR::DerivativesE (double t, double x[], double dxdt[], TParticleA const& P)
 {
-  return fSpectrum;
-}
+  // This is a second order differential equation.  It does not account for the loss in energy due to
+  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
 
+  // The values correspond to:
+  // x[0] - x
+  // x[1] - Vx
+  // x[2] - y
+  // x[3] - Vy
+  // x[4] - z
+  // x[5] - Vz
 
+  // BField at this point
+  TVector3D const E = this->GetE(x[0], x[2], x[4]);
 
+  double const QoverMTimesSqrtOneMinusBetaSquared = P.GetQ() / P.GetM() * sqrt(1. - (x[1]*x[1] + x[3]*x[3] + x[5]*x[5]) / (TOSCARSSR::C() * TOSCARSSR::C()));
+  double const BetaDotE = (x[1] * E.GetX() + x[3] * E.GetY() + x[5] * E.GetZ()) / TOSCARSSR::C();
 
-void OSCARSSR::ClearSpectrum ()
-{
-  // Clear the contents of the particle beam container
-  fSpectrum.Clear();
+  dxdt[0] = x[1];
+  dxdt[1] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetX() - x[1] * BetaDotE / TOSCARSSR::C());
+  dxdt[2] = x[3];                                          
+  dxdt[3] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetY() - x[3] * BetaDotE / TOSCARSSR::C());
+  dxdt[4] = x[5];                                          
+  dxdt[5] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetZ() - x[5] * BetaDotE / TOSCARSSR::C());
 
   return;
 }
 
 
 
-
-T3DScalarContainer const& OSCARSSR::GetFlux () const
+void OSCARSSR::DerivativesB (double t, double x[], double dxdt[], TParticleA const& P)
 {
-  return fFlux;
-}
+  // This is a second order differential equation.  It does not account for the loss in energy due to
+  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
 
+  // The values correspond to:
+  // x[0] - x
+  // x[1] - Vx
+  // x[2] - y
+  // x[3] - Vy
+  // x[4] - z
+  // x[5] - Vz
 
+  // BField at this point
+  TVector3D const B = this->GetB(x[0], x[2], x[4]);
 
+  double const QoverMGamma = P.GetQoverMGamma();
 
-void OSCARSSR::ClearFlux ()
-{
-  // Clear the contents
-  fFlux.Clear();
+  dxdt[0] = x[1];
+  dxdt[1] = QoverMGamma * (-x[5] * B.GetY() + x[3] * B.GetZ());
+  dxdt[2] = x[3];                                                                                          
+  dxdt[3] = QoverMGamma * ( x[5] * B.GetX() - x[1] * B.GetZ());
+  dxdt[4] = x[5];                                                                                          
+  dxdt[5] = QoverMGamma * ( x[1] * B.GetY() - x[3] * B.GetX());
 
   return;
 }
 
 
 
-
-T3DScalarContainer const& OSCARSSR::GetPowerDensity () const
+void OSCARSSR::DerivativesEB (double t, double x[], double dxdt[], TParticleA const& P)
 {
-  return fPowerDensity;
-}
+  // This is a second order differential equation.  It does not account for the loss in energy due to
+  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
+
+  // The values correspond to:
+  // x[0] - x
+  // x[1] - Vx
+  // x[2] - y
+  // x[3] - Vy
+  // x[4] - z
+  // x[5] - Vz
 
+  // BField at this point
+  TVector3D const B = this->GetB(x[0], x[2], x[4]);
+  TVector3D const E = this->GetE(x[0], x[2], x[4]);
 
+  double const QoverMTimesSqrtOneMinusBetaSquared = P.GetQ() / P.GetM() * sqrt(1. - (x[1]*x[1] + x[3]*x[3] + x[5]*x[5]) / (TOSCARSSR::C() * TOSCARSSR::C()));
+  double const BetaDotE = (x[1] * E.GetX() + x[3] * E.GetY() + x[5] * E.GetZ()) / TOSCARSSR::C();
 
+  dxdt[0] = x[1];
+  dxdt[1] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetX() - x[5] * B.GetY() + x[3] * B.GetZ() - x[1] * BetaDotE / TOSCARSSR::C());
+  dxdt[2] = x[3];                                                                          
+  dxdt[3] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetY() + x[5] * B.GetX() - x[1] * B.GetZ() - x[3] * BetaDotE / TOSCARSSR::C());
+  dxdt[4] = x[5];                                                                          
+  dxdt[5] = QoverMTimesSqrtOneMinusBetaSquared * (E.GetZ() + x[1] * B.GetY() - x[3] * B.GetX() - x[5] * BetaDotE / TOSCARSSR::C());
 
-void OSCARSSR::ClearPowerDensity ()
-{
-  // Clear the contents
-  fPowerDensity.Clear();
 
   return;
 }
 
 
 
+void OSCARSSR::Derivatives (double t, double x[], double dxdt[], TParticleA const& P)
+{
+  // This is a second order differential equation.  It does not account for the loss in energy due to
+  // radiation.  Although 't' is not used it would be easy to implement a time dependent field
 
+  // The values correspond to:
+  // x[0] - x
+  // x[1] - Vx
+  // x[2] - y
+  // x[3] - Vy
+  // x[4] - z
+  // x[5] - Vz
 
+  // BField at this point
+  TVector3D const B = this->GetB(x[0], x[2], x[4]);
 
+  double const QoverMGamma = P.GetQoverMGamma();
 
+  dxdt[0] = x[1];
+  dxdt[1] = QoverMGamma * (-x[5] * B.GetY() + x[3] * B.GetZ());
+  dxdt[2] = x[3];                                                                                          
+  dxdt[3] = QoverMGamma * ( x[5] * B.GetX() - x[1] * B.GetZ());
+  dxdt[4] = x[5];                                                                                          
+  dxdt[5] = QoverMGamma * ( x[1] * B.GetY() - x[3] * B.GetX());
 
+  return;
+}
 
 
 
-
-void OSCARSSR::CalculatePowerDensity (TParticleA& Particle,
-                                      TSurfacePoints const& Surface,
-                                      T3DScalarContainer& PowerDensityContainer,
-                                      bool const Directional,
-                                      double const Precision,
-                                      int    const MaxLevel,
-                                      int    const MaxLevelExtended,
-                                      double const Weight,
-                                      int    const ReturnQuantity)
+void OSCARSSR::RK4 (double y[], double dydx[], int n, double x, double h, double yout[], TParticleA const& P)
 {
-  // Calculates the single particle spectrum at a given observation point
-  // in units of [photons / second / 0.001% BW / mm^2]
-  //
-  // Particle - Particle, contains trajectory (or if not, calculate it)
-  // Surface - Observation Point
-
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
-  }
+  // Runge-Kutta 4th order method propogation
+  // UPDATE: syntax
 
-  // Extra inpts for calculation
-  bool Done = false;
-  size_t const iFirst = 0;
-  size_t const iLast = Surface.GetNPoints() - 1;
+  int i;
+  double xh, hh, h6;
+  double *dym, *dyt, *yt;
 
-  // Calculate the power density
-  CalculatePowerDensityPoints(Particle,
-                              Surface,
-                              PowerDensityContainer,
-                              iFirst,
-                              iLast,
-                              Done,
-                              Directional,
-                              Precision,
-                              MaxLevel,
-                              MaxLevelExtended,
-                              Weight,
-                              ReturnQuantity);
+  dym = new double[n];
+  dyt = new double[n];
+  yt  = new double[n];
 
-  return;
-}
+  hh = h * 0.5;
+  h6 = h / 6.0;
+  xh = x + hh;
 
+  for (i = 0; i < n; ++i) {
+    yt[i] = y[i] + hh * dydx[i];
+  }
 
+  (this->*fDerivativesFunction)(xh, yt, dyt, P);
+  //this->DerivativesB(xh, yt, dyt, P);
 
+  for (i = 0; i < n; ++i) {
+    yt[i] = y[i] + hh * dyt[i];
+  }
 
-void OSCARSSR::CalculatePowerDensity (TSurfacePoints const& Surface,
-                                      T3DScalarContainer& PowerDensityContainer,
-                                      int const Dimension,
-                                      bool const Directional,
-                                      double const Precision,
-                                      int    const MaxLevel,
-                                      int    const MaxLevelExtended,
-                                      int const NParticles,
-                                      int const NThreads,
-                                      int const GPU,
-                                      int const NGPU,
-                                      std::vector<int> VGPU,
-                                      int const ReturnQuantity)
+  (this->*fDerivativesFunction)(xh, yt, dym, P);
+  //this->DerivativesB(xh, yt, dym, P);
+
+  for (i = 0; i < n; ++i) {
+    yt[i] = y[i] + h * dym[i];
+    dym[i] += dyt[i];
+  }
+
+  (this->*fDerivativesFunction)(x + h, yt, dyt, P);
+  //this->DerivativesB(x + h, yt, dyt, P);
+
+  for (i = 0; i < n; ++i) {
+    yout[i] = y[i] + h6 * (dydx[i] + dyt[i] + 2.0 * dym[i]);
+  }
+  
+  delete [] dym;
+  delete [] dyt;
+  delete [] yt;
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateSpectrum (TParticleA& Particle,
+                                  TVector3D const& ObservationPoint,
+                                  TSpectrumContainer& Spectrum,
+                                  std::string const& Polarization,
+                                  double const Angle,
+                                  TVector3D const& HorizontalDirection,
+                                  TVector3D const& PropogationDirection,
+                                  double const Precision,
+                                  int    const MaxLevel,
+                                  int    const MaxLevelExtended,
+                                  double const Weight,
+                                  int    const ReturnQuantity)
 {
-  // Calculates the power density in units of [W / mm^2]
-  // THIS is the ENTRY POINT typically
+  // Calculates the single particle spectrum at a given observation point
+  // in units of [photons / second / 0.001% BW / mm^2]
+  // Save this in the spectrum container.
   //
+  // Particle - the Particle.. with a Trajectory structure hopefully
+  // ObservationPoint - Observation Point
+  // Spectrum - Spectrum container
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+
+  // Extra inpts for calculation
+  bool Done = false;
+
+  this->CalculateSpectrumPoints(Particle,
+                                ObservationPoint,
+                                Spectrum,
+                                0,
+                                1,
+                                Done,
+                                Polarization,
+                                Angle,
+                                HorizontalDirection,
+                                PropogationDirection,
+                                Precision,
+                                MaxLevel,
+                                MaxLevelExtended,
+                                Weight,
+                                ReturnQuantity);
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateSpectrum (TVector3D const& ObservationPoint,
+                                  TSpectrumContainer& Spectrum,
+                                  std::string const& Polarization,
+                                  double const Angle,
+                                  TVector3D const& HorizontalDirection,
+                                  TVector3D const& PropogationDirection,
+                                  int const NParticles,
+                                  int const NThreads,
+                                  int const GPU,
+                                  int const NGPU,
+                                  std::vector<int> VGPU,
+                                  double const Precision,
+                                  int    const MaxLevel,
+                                  int    const MaxLevelExtended,
+                                  int    const ReturnQuantity)
+{
+  // Calculate the spectrum at an observaton point.
+  // THIS is the ENTRY POINT typically
 
   // Check that particle has been set yet.  If fType is "" it has not been set yet
   if (fParticle.GetType() == "") {
@@ -1969,6 +2340,11 @@ void OSCARSSR::CalculatePowerDensity (TSurfacePoints const& Surface,
     throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
   }
 
+  // Take the checkpoint resume request here so it is consumed by this call on every path
+  // (GPU, processes, single particle) and never by a later or nested calculation
+  bool const CheckpointResume = fCheckpointResume;
+  fCheckpointResume = false;
+
   // Should we use the GPU or not?
   int const NGPUAvailable = this->CheckGPU();
   bool const UseGPU = GPU == 0 ? false : this->GetUseGPUGlobal() && (NGPUAvailable > 0) ? true : (GPU == 1) && (NGPUAvailable > 0);
@@ -1988,113 +2364,156 @@ void OSCARSSR::CalculatePowerDensity (TSurfacePoints const& Surface,
   }
 
 
-
-
-  PowerDensityContainer.Clear();
-  // Set the output flux container and with correct dimensions
-  if (Dimension == 3) {
-    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
-      PowerDensityContainer.AddPoint(Surface.GetPoint(i).GetPoint(), 0);
-    }
-  } else if (Dimension == 2) {
-    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
-      PowerDensityContainer.AddPoint( TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), 0);
-    }
-  } else if (Dimension == 1) {
-    // UPDATE: Needs something for 1D
-    if (Surface.GetNPoints() == 1) {
-      PowerDensityContainer.AddPoint( Surface.GetPoint(0).GetPoint(), 0 );
-    } else {
-      TVector3D const x1 = Surface.GetPoint(0).GetPoint();
-      TVector3D const x2 = Surface.GetPoint( Surface.GetNPoints() - 1 ).GetPoint();
-
-      TVector3D const C = x1 + (x2 - x1) / 2;
-      for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
-        double const Sign = i < Surface.GetNPoints() / 2 ? -1. : 1.;
-
-        PowerDensityContainer.AddPoint( TVector3D(Sign * (Surface.GetPoint(i).GetPoint() - C).Mag(), 0, 0), 0 );
-      }
-    }
+  // Check polarization
+  if (Polarization == "all" ||
+      Polarization == "linear-horizontal" ||
+      Polarization == "linear-vertical"   ||
+      Polarization == "linear"            ||
+      Polarization == "circular-left"     ||
+      Polarization == "circular-right") {
+    // Do nothing
   } else {
-    throw std::out_of_range("Wrong dimension");
+    throw std::invalid_argument("Polarization requested not recognized");
   }
 
-
+  // Closed-form result if requested and possible for this configuration
+  if (this->CalculateSpectrumAnalytic(ObservationPoint, Spectrum, Polarization, NParticles, NThreadsToUse, ReturnQuantity)) {
+    return;
+  }
 
 
   // Which cpmpute method will we use, gpu, multi-thread, or single-thread
   if (UseGPU) {
+    if (CheckpointResume) {
+      std::cerr << "WARNING: checkpoint resume is not supported on the GPU.  Calculating from the start" << std::endl;
+    }
     // Send to GPU function
-    CalculatePowerDensityGPU(Surface,
-                             PowerDensityContainer,
-                             NParticles,
-                             GPUVector,
-                             Directional,
-                             Precision,
-                             MaxLevel,
-                             MaxLevelExtended,
-                             ReturnQuantity);
+    this->CalculateSpectrumGPU(fParticle,
+                               ObservationPoint,
+                               Spectrum,
+                               Polarization,
+                               Angle,
+                               HorizontalDirection,
+                               PropogationDirection,
+                               NParticles,
+                               GPUVector,
+                               Precision,
+                               MaxLevel,
+                               MaxLevelExtended,
+                               ReturnQuantity);
   } else {
     if (NParticles == 0) {
       if (NThreadsToUse == 1) {
-        this->CalculatePowerDensity(fParticle,
-                                    Surface,
-                                    PowerDensityContainer,
-                                    Directional,
-                                    Precision,
-                                    MaxLevel,
-                                    MaxLevelExtended,
-                                    1,
-                                    ReturnQuantity);
+        this->CalculateSpectrum(fParticle,
+                                ObservationPoint,
+                                Spectrum,
+                                Polarization,
+                                Angle,
+                                HorizontalDirection,
+                                PropogationDirection,
+                                Precision,
+                                MaxLevel,
+                                MaxLevelExtended,
+                                1,
+                                ReturnQuantity);
       } else {
-        this->CalculatePowerDensityThreads(fParticle,
-                                           Surface,
-                                           PowerDensityContainer,
-                                           NThreadsToUse,
-                                           Directional,
-                                           Precision,
-                                           MaxLevel,
-                                           MaxLevelExtended,
-                                           1,
-                                           ReturnQuantity);
+        this->CalculateSpectrumThreads(fParticle,
+                                       ObservationPoint,
+                                       Spectrum,
+                                       NThreadsToUse,
+                                       Polarization,
+                                       Angle,
+                                       HorizontalDirection,
+                                       PropogationDirection,
+                                       Precision,
+                                       MaxLevel,
+                                       MaxLevelExtended,
+                                       1,
+                                       ReturnQuantity);
+      }
+    } else if (this->GetNProcessesToUse(NParticles) > 1) {
+      // Split the particles over local processes, reduced through shared memory
+      int NParticlesThis = 0;
+      int const iProcess = this->ForkProcesses(this->GetNProcessesToUse(NParticles), NParticles, Spectrum.GetNPoints(), NParticlesThis);
+      if (iProcess >= 0) {
+        TSpectrumContainer ThisSpectrum = Spectrum;
+        try {
+          this->CalculateSpectrum(ObservationPoint,
+                                  ThisSpectrum,
+                                  Polarization,
+                                  Angle,
+                                  HorizontalDirection,
+                                  PropogationDirection,
+                                  NParticlesThis,
+                                  NThreadsToUse,
+                                  0,
+                                  NGPU,
+                                  VGPU,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  ReturnQuantity);
+        } catch (std::exception const& e) {
+          this->FinishProcess(iProcess, 0x0, 0x0, e.what());
+        } catch (...) {
+          // Nothing may escape a forked worker
+          this->FinishProcess(iProcess, 0x0, 0x0, "unknown error");
+        }
+        this->FinishProcess(iProcess, &ThisSpectrum, 0x0);
       }
+      this->ReduceProcesses(NParticles, &Spectrum, 0x0);
     } else {
       // Weight this by the number of particles
       double const Weight = 1.0 / (double) NParticles;
 
+      // Start from a checkpoint if requested
+      int const NParticlesDone = CheckpointResume ? this->ReadCheckpoint(kCheckpoint_Spectrum, NParticles, &Spectrum, 0x0) : 0;
+
       // Loop over particles
-      for (int i = 0; i != NParticles; ++i) {
+      for (int i = NParticlesDone; i < NParticles; ++i) {
 
         // Set a new random particle
         this->SetNewParticle();
         this->CalculateTrajectory();
 
         if (NThreadsToUse == 1) {
-          this->CalculatePowerDensity(fParticle,
-                                      Surface,
-                                      PowerDensityContainer,
-                                      Directional,
-                                      Precision,
-                                      MaxLevel,
-                                      MaxLevelExtended,
-                                      Weight,
-                                      ReturnQuantity);
+          this->CalculateSpectrum(fParticle,
+                                  ObservationPoint,
+                                  Spectrum,
+                                  Polarization,
+                                  Angle,
+                                  HorizontalDirection,
+                                  PropogationDirection,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  Weight,
+                                  ReturnQuantity);
         } else {
-          this->CalculatePowerDensityThreads(fParticle,
-                                             Surface,
-                                             PowerDensityContainer,
-                                             NThreadsToUse,
-                                             Directional,
-                                             Precision,
-                                             MaxLevel,
-                                             MaxLevelExtended,
-                                             Weight,
-                                             ReturnQuantity);
+          this->CalculateSpectrumThreads(fParticle,
+                                         ObservationPoint,
+                                         Spectrum,
+                                         NThreadsToUse,
+                                         Polarization,
+                                         Angle,
+                                         HorizontalDirection,
+                                         PropogationDirection,
+                                         Precision,
+                                         MaxLevel,
+                                         MaxLevelExtended,
+                                         Weight,
+                                         ReturnQuantity);
+        }
+
+        // Write a checkpoint if it is time
+        if (this->CheckpointNow(NParticles, i + 1)) {
+          this->WriteCheckpoint(kCheckpoint_Spectrum, NParticles, i + 1, &Spectrum, 0x0);
         }
       }
     }
   }
 
+
   return;
 }
 
@@ -2102,25 +2521,34 @@ void OSCARSSR::CalculatePowerDensity (TSurfacePoints const& Surface,
 
 
 
-
-
-
-
-void OSCARSSR::CalculatePowerDensityPoints (TParticleA& Particle,
-                                            TSurfacePoints const& Surface,
-                                            T3DScalarContainer& PowerDensityContainer,
-                                            size_t const iFirst,
-                                            size_t const iLast,
-                                            bool& Done,
-                                            bool const Directional,
-                                            double const Precision,
-                                            int    const MaxLevel,
-                                            int    const MaxLevelExtended,
-                                            double const Weight,
-                                            int    const ReturnQuantity)
+void OSCARSSR::CalculateSpectrumPoints (TParticleA& Particle,
+                                        TVector3D const& ObservationPoint,
+                                        TSpectrumContainer& Spectrum,
+                                        size_t const iThread,
+                                        size_t const NThreads,
+                                        bool& Done,
+                                        std::string const& Polarization,
+                                        double const Angle,
+                                        TVector3D const& HorizontalDirection,
+                                        TVector3D const& PropogationDirection,
+                                        double const Precision,
+                                        int    const MaxLevel,
+                                        int    const MaxLevelExtended,
+                                        double const Weight,
+                                        int    const ReturnQuantity)
 {
-  // Calculates the single particle power density in a range of points
-  // in units of [watts / second / mm^2]
+  // Calculates the single particle spectrum at a given observation point
+  // in units of [photons / second / 0.001% BW / mm^2]
+  // Save this in the spectrum container.
+  //
+  // Particle - the Particle.. with a Trajectory structure hopefully
+  // ObservationPoint - Observation Point
+  // Spectrum - Spectrum container
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (Particle.GetType() == "") {
+    throw std::out_of_range("no particle defined");
+  }
 
   // Check you are not requesting a level above the maximum
   if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
@@ -2131,134 +2559,217 @@ void OSCARSSR::CalculatePowerDensityPoints (TParticleA& Particle,
   int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
   int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
 
-  // Variables for parts of the numerator and denominator of power density equation
-  TVector3D Numerator;
-  double Denominator;
+  // Number of points in spectrum
+  int const NSpectrumPoints = Spectrum.GetNPoints();
+
+  // Check input spectrum range numbers
+  if (iThread >= NThreads) {
+    throw std::out_of_range("spectrum thread range is incorrect.  Please report this error.");
+  }
+
+  // Constant C0 for calculation
+  double const C0 = Particle.GetQ() / (TOSCARSSR::FourPi() * TOSCARSSR::C() * TOSCARSSR::Epsilon0() * TOSCARSSR::Sqrt2Pi());
+
+  // Constant for flux calculation at the end
+  double const C2 = TOSCARSSR::FourPi() * Particle.GetCurrent() / (TOSCARSSR::H() * fabs(Particle.GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
+
+  // Imaginary "i" and complxe 1+0i
+  std::complex<double> const I(0, 1);
+  std::complex<double> const One(1, 0);
+
+  // Photon vertical direction and positive and negative helicity
+  TVector3D  const VerticalDirection = PropogationDirection.Cross(HorizontalDirection).UnitVector();
+  TVector3DC const Positive = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) + VerticalDirection * I );
+  TVector3DC const Negative = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) - VerticalDirection * I );
+
+  TVector3DC PolarizationVector(0, 0, 0);
+  if (Polarization == "all") {
+    // Do Nothing
+  } else if (Polarization == "linear-horizontal") {
+    PolarizationVector = HorizontalDirection;
+  } else if (Polarization == "linear-vertical") {
+    PolarizationVector = VerticalDirection;
+  } else if (Polarization == "linear") {
+    TVector3D PolarizationAngle = HorizontalDirection;
+    PolarizationAngle.RotateSelf(Angle, PropogationDirection);
+    PolarizationVector = PolarizationAngle;
+  } else if (Polarization == "circular-left") {
+    PolarizationVector = Positive;
+  } else if (Polarization == "circular-right") {
+    PolarizationVector = Negative;
+  } else {
+    // Throw invalid argument if polarization is not recognized
+    throw std::invalid_argument("Polarization requested not recognized");
+  }
 
-  bool const HasNormal = Surface.HasNormal();
 
   // Extended trajectory (not using memory for storage of arrays
   TParticleTrajectoryInterpolatedPoints TE;
 
-  // Alternative outputs
-  double Result_Precision = -1;
-  int    Result_Level     = -1;
+  // Which integrator to use and interval weights for Filon
+  bool const UseFilon = fIntegrator == kIntegrator_Filon;
+
+  // Richardson extrapolation across levels of the Riemann sum
+  bool const UseRichardson = fConvergenceMode == kConvergenceMode_Richardson && !UseFilon;
+  int  const MinLevel = 8;
+  std::vector<double> FilonPoints;
+
+  // Convergence of the current point
+  TLevelConvergence Convergence;
+
+  // Converged level of the previous point in this thread, for warm starting
+  int NeighbourLevel = -1;
+
 
   // Loop over all points in the spectrum container
-  for (size_t i = iFirst; i <= iLast; ++i) {
+  for (size_t i = iThread; i < NSpectrumPoints; i += NThreads) {
 
-    // Obs point
-    TVector3D const Obs    = Surface.GetPoint(i).GetPoint();
-    TVector3D const Normal = Surface.GetPoint(i).GetNormal();
+    // Angular frequency
+    double const Omega = Spectrum.GetAngularFrequency(i);
+
+    // Electric field summation in frequency space
+    TVector3DC SumE(0, 0, 0);
 
-    double ThisSum = -1;
-    double LastSum = -1;
+    double ThisPhase = -1;
+    double LastPhase = -1;
+    double MaxDPhase = 0;
     int    LastLevel = 0;
 
-    // Summing for this power density
-    double Sum = 0;
+    // The end points make each level sum a trapezoid sum for the extrapolation
+    TVector3DC const EndPoints = UseRichardson ? this->EndPointsField(Particle, ObservationPoint, Omega) : TVector3DC(0, 0, 0);
+
+    // For the Filon integrator the amplitude, phase, and phase derivative of every
+    // point up to the current level are kept in time order (the inclusive grid)
+    TVector3DC SumFilon(0, 0, 0);
+    double MaxPhaseDeviation = 0;
+    FilonPoints.clear();
+
+    // Lowest level after which convergence is accepted.  When warm starting this
+    // follows the level the previous point converged at, and for Filon the sum over
+    // the inclusive grid is only done from the start level on
+    Convergence.Start(MinLevel, NeighbourLevel, fWarmStart);
+    int StartLevel = 0;
+    if (fWarmStart && UseFilon) {
+      // One level below where the neighbour converged, or the predicted level if lower
+      int const PredictedLevel = this->PredictLevel(Particle, ObservationPoint, Omega, LevelStopMemory);
+      StartLevel = NeighbourLevel >= 0 && NeighbourLevel - 2 < PredictedLevel ? NeighbourLevel - 2 : PredictedLevel - 1;
+      StartLevel = StartLevel > 0 ? StartLevel : 0;
+    }
 
     for (int iLevel = 0; iLevel <= LevelStopWithExtended; ++iLevel) {
       LastLevel = iLevel;
 
-      // Keep track of Beta for precision
-      TVector3D Last_Beta(0, 0, 0);
-      double BetaDiffMax = -1;
-
       // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
       TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
       if (iLevel > LevelStopMemory) {
         TE = Particle.GetTrajectoryExtendedLevel(iLevel);
       }
 
+
       // Number of points in the trajectory
       size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
 
+
+      MaxDPhase = 0;
+      if (UseFilon) {
+        // Spread the points of the lower levels, the points of this level go in between
+        this->FilonSpread(FilonPoints, NTPoints);
+      }
+
       // Loop over trajectory points
       for (int iT = 0; iT != NTPoints; ++iT) {
-
         TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
 
         // Get position, Beta, and Acceleration (over c)
         TVector3D const& X = PP.GetX();
         TVector3D const& B = PP.GetB();
         TVector3D const& AoverC = PP.GetAoverC();
+        double    const  Time = iLevel <= LevelStopMemory ? TM.GetT(iT) : TE.GetT(iT);
 
-        double const BetaDiff = (B - Last_Beta).Mag();
-        if (iT > 0 && BetaDiff > BetaDiffMax) {
-          BetaDiffMax = BetaDiff;
-        }
-        Last_Beta = B;
-
-        // Define the three normal vectors.  N1 is in the direction of propogation,
-        // N2 and N3 are in a plane perpendicular to N1
-        TVector3D const N1 = (Obs - X).UnitVector();
-        TVector3D const N2 = N1.Orthogonal().UnitVector();
-        TVector3D const N3 = N1.Cross(N2).UnitVector();
+        // Define R and unit vector in direction of R, and D (distance to observer)
+        TVector3D const R = ObservationPoint - X;
+        TVector3D const N = R.UnitVector();
+        double const D = R.Mag();
 
-        // For computing non-normally incidence
-        double const N1DotNormal = HasNormal ? N1.Dot(Normal) : 1;
-        // UPDATE: URGENT: Check this
-        if (Directional && N1DotNormal <= 0) {
-          continue;
+        // Exponent in transformed field
+        ThisPhase = -Omega * (Time + D / TOSCARSSR::C());
+        double const DPhase = ThisPhase - LastPhase;
+        double const PhaseTestValue = fabs(DPhase);
+        if (iT != 0 && PhaseTestValue > MaxDPhase) {
+          MaxDPhase = PhaseTestValue;
         }
+        std::complex<double> Exponent(0, ThisPhase);
 
-        // Compute Numerator and denominator
-        Numerator = N1.Cross( ( (N1 - B).Cross((AoverC)) ) );
-        Denominator = pow(1 - (B).Dot(N1), 5);
+        TVector3D const Amplitude = ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
+            + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ); // NF + FF
+
+        if (UseFilon) {
+          // Points of this level are every other point of the inclusive grid
+          double* F = &FilonPoints[2 * iT * kFilonStride];
+          F[0] = Amplitude.GetX();
+          F[1] = Amplitude.GetY();
+          F[2] = Amplitude.GetZ();
+          F[3] = ThisPhase;
+          F[4] = -Omega * (1 - N.Dot(B));
+        } else {
+          // Add this contribution
+          SumE += Amplitude * std::exp(Exponent);
+        }
+        LastPhase = ThisPhase;
 
-        // Add contributions from both N2 and N3
-        Sum += pow(Numerator.Dot(N2), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
-        Sum += pow(Numerator.Dot(N3), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
+      }
 
+      // Below the start level the points are only collected
+      if (iLevel < StartLevel) {
+        continue;
       }
 
-      double const ThisSum = Sum * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
+      if (UseFilon) {
+        SumFilon = this->FilonSum(FilonPoints, Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel), MaxPhaseDeviation);
+      }
 
-      Result_Precision = fabs(ThisSum - LastSum) / LastSum;
-      if (iLevel > 8 && Result_Precision < Precision && BetaDiffMax < 2. / (Particle.GetGamma())) {
-        Result_Level = iLevel;
-        break;
-      } else if (iLevel > 8 && ThisSum == LastSum) {
-        // The assumption here is that zero is last and now
-        Result_Level = iLevel;
-        Result_Precision = 0;
+      TVector3DC ThisSumE = UseFilon ? SumFilon : (UseRichardson ? SumE + EndPoints : SumE) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
+      if (PolarizationVector.Mag2() > 0.001) {
+        ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
+      }
+      if (this->FieldLevelConverged(Convergence, ThisSumE, iLevel, MinLevel, StartLevel, (UseFilon ? MaxPhaseDeviation : MaxDPhase) < TOSCARSSR::Pi(), UseRichardson, Precision)) {
         break;
       }
-
-      LastSum = ThisSum;
     }
 
-    // If a point does not converge mark it
-    if (Result_Level == -1) {
-      PowerDensityContainer.SetNotConverged(i);
+    if (Convergence.fLevel == -1) {
+      Spectrum.SetNotConverged(i);
     }
+    NeighbourLevel = Convergence.fLevel;
 
-    Sum *= fabs(Particle.GetQ() * Particle.GetCurrent()) / (16 * TOSCARSSR::Pi2() * TOSCARSSR::Epsilon0() * TOSCARSSR::C()) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
-
-    // m^2 to mm^2
-    Sum /= 1e6;
+    // Multiply by constant factor
+    if (UseFilon) {
+      SumE = SumFilon * C0;
+    } else if (UseRichardson && Convergence.fRombergRowE.size() > 0) {
+      SumE = Convergence.fRombergRowE.back() * C0;
+    } else {
+      SumE *= C0 * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
+    }
 
-    if (!Directional) {
-      if (Sum < 0) {
-        Sum *= -1;
-      }
+    // Correcr for polarization
+    if (PolarizationVector.Mag2() > 0.001) {
+      SumE = SumE.Dot(PolarizationVector) * PolarizationVector;
     }
 
+    // Set the flux for this frequency / energy point
     // Add to container
     switch (ReturnQuantity) {
       case 1:
-        PowerDensityContainer.AddToPoint(i, Result_Precision * Weight);
+        Spectrum.AddToFlux(i, Convergence.fPrecision * Weight);
         break;
       case 2:
-        PowerDensityContainer.AddToPoint(i, ((double) Result_Level) * Weight);
+        Spectrum.AddToFlux(i, ((double) Convergence.fLevel) * Weight);
         break;
       default:
-        PowerDensityContainer.AddToPoint(i, Sum * Weight);
+        Spectrum.AddToFlux(i, C2 *  SumE.Dot( SumE.CC() ).real() * Weight);
         break;
     }
-
-  } // POINTS
+  }
 
 
   // Set done to true
@@ -2270,72 +2781,484 @@ void OSCARSSR::CalculatePowerDensityPoints (TParticleA& Particle,
 
 
 
-void OSCARSSR::CalculatePowerDensityThreads (TParticleA& Particle,
-                                             TSurfacePoints const& Surface,
-                                             T3DScalarContainer& PowerDensityContainer,
-                                             int const NThreads,
-                                             bool const Directional,
-                                             double const Precision,
-                                             int    const MaxLevel,
-                                             int    const MaxLevelExtended,
-                                             double const Weight,
-                                             int    const ReturnQuantity)
+
+int OSCARSSR::PredictLevel (TParticleA& Particle,
+                            TVector3D const& ObservationPoint,
+                            double const Omega,
+                            int const LevelStopMemory)
 {
-  // Calculates the single particle power density on surface
-  // in units of [watts / second / mm^2]
-  //
-  // Surface - Observation Points
+  // Predict the lowest level at which the phase advance between the points of
+  // that level is below pi.  The phase advances at the rate omega (1 - n.beta), the
+  // largest rate is taken from a coarse trajectory level.
 
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
+  int const ProbeLevel = LevelStopMemory < kPlannerProbeLevel ? LevelStopMemory : kPlannerProbeLevel;
+  if (ProbeLevel < 0) {
+    return 0;
   }
 
+  TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(ProbeLevel);
 
+  double MaxRate = 0;
+  for (size_t iT = 0; iT != TM.GetNPoints(); ++iT) {
+    TVector3D const N = (ObservationPoint - TM.GetX(iT)).UnitVector();
+    double const Rate = Omega * (1 - N.Dot(TM.GetB(iT)));
+    if (Rate > MaxRate) {
+      MaxRate = Rate;
+    }
+  }
 
-  // Vector for storing threads to rejoin
-  std::vector<std::thread> Threads;
+  // Phase advance between points of level 0 and the number of halvings needed
+  double const DPhase0 = MaxRate * Particle.GetTrajectoryInterpolated().GetDeltaTThisLevel(0);
+  if (DPhase0 < TOSCARSSR::Pi()) {
+    return 0;
+  }
 
-  // Number of points in spectrum
-  size_t const NPoints = Surface.GetNPoints();
+  return (int) ceil(log2(DPhase0 / TOSCARSSR::Pi()));
+}
 
-  // How many threads to start in the first for loop
-  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
 
-  // Keep track of which threads are finished and re-joined
-  bool *Done = new bool[NThreadsActual];
-  bool *Joined = new bool[NThreadsActual];
 
-  // Number per thread plus remainder to be added to first threads
-  size_t const NPerThread = NPoints / NThreadsActual;
-  size_t const NRemainder = NPoints % NThreadsActual;
 
-  // Start threads and keep in vector
-  for (size_t it = 0; it != NThreadsActual; ++it) {
+void OSCARSSR::FilonInterval (TVector3D const& Amplitude0,
+                              TVector3D const& DAmplitude0,
+                              double    const  Phase0,
+                              double    const  PhaseDot0,
+                              TVector3D const& Amplitude1,
+                              TVector3D const& DAmplitude1,
+                              double    const  Phase1,
+                              double    const  PhaseDot1,
+                              double    const  DT,
+                              TVector3DC& Sum,
+                              double& MaxPhaseDeviation) const
+{
+  // Add the integral of Amplitude(t) exp(i Phase(t)) over one interval of length DT
+  // to Sum.  The linear part of the phase between the end points is integrated
+  // exactly.  What is left, Amplitude(t) times exp(i (deviation of the phase from
+  // linear)), is interpolated with a cubic Hermite polynomial using the phase
+  // derivatives at the end points.  DAmplitude0 and DAmplitude1 are the amplitude
+  // derivatives at the end points times DT.  The largest phase deviation seen is
+  // kept in MaxPhaseDeviation as a check that the interval is short enough.
 
-    // First and last points for each thread
-    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
-    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+  std::complex<double> const I(0, 1);
 
-    // Set Done and joined to false for this thread
-    Done[it] = false;
-    Joined[it] = false;
+  double const DPhase = Phase1 - Phase0;
+  double const Deviation0 = PhaseDot0 * DT - DPhase;
+  double const Deviation1 = PhaseDot1 * DT - DPhase;
+  if (fabs(Deviation0) > MaxPhaseDeviation) {
+    MaxPhaseDeviation = fabs(Deviation0);
+  }
+  if (fabs(Deviation1) > MaxPhaseDeviation) {
+    MaxPhaseDeviation = fabs(Deviation1);
+  }
 
-    // Start thread for these points
-    Threads.push_back(std::thread(&OSCARSSR::CalculatePowerDensityPoints,
-                                  this,
-                                  std::ref(Particle),
-                                  std::ref(Surface),
-                                  std::ref(PowerDensityContainer),
-                                  iFirst,
-                                  iLast,
+  std::complex<double> W[4];
+  TOMATH::FilonWeights(DPhase, W);
+
+  TVector3DC const G = (W[0] + W[1] * I * Deviation0) * Amplitude0 + W[1] * DAmplitude0
+                     + (W[2] + W[3] * I * Deviation1) * Amplitude1 + W[3] * DAmplitude1;
+
+  Sum += DT * (G * std::exp(std::complex<double>(0, Phase0)));
+
+  return;
+}
+
+
+
+
+void OSCARSSR::FilonSpread (std::vector<double>& Points, size_t const NNew) const
+{
+  // Make room for the NNew points of the next level in the inclusive grid held in
+  // Points (kFilonStride values per point, in time order).  The points of level L
+  // fall in between those of the levels below, so the existing points move to the odd
+  // positions and the new point iT goes to position 2 iT.
+
+  size_t const NOld = Points.size() / kFilonStride;
+  if (NNew != NOld + 1) {
+    throw std::length_error("trajectory level does not fit the inclusive grid.  Please report this error.");
+  }
+
+  Points.resize((NOld + NNew) * kFilonStride);
+  for (size_t ip = NOld; ip-- > 0; ) {
+    for (size_t k = 0; k != kFilonStride; ++k) {
+      Points[(2 * ip + 1) * kFilonStride + k] = Points[ip * kFilonStride + k];
+    }
+  }
+
+  return;
+}
+
+
+
+
+TVector3DC OSCARSSR::FilonSum (std::vector<double> const& Points,
+                               double const DT,
+                               double& MaxPhaseDeviation) const
+{
+  // Filon integral over the inclusive grid in Points: amplitude (3), phase, and phase
+  // derivative of each point in time order, spaced by DT.  The amplitude derivatives
+  // are centered differences, one sided at the first and last point.  The half
+  // intervals to the trajectory start and stop, each DT long, use the phase slope at
+  // the end points.  The largest phase deviation from linear within an interval is
+  // returned in MaxPhaseDeviation.
+
+  MaxPhaseDeviation = 0;
+
+  size_t const NPoints = Points.size() / kFilonStride;
+  if (NPoints == 0) {
+    return TVector3DC(0, 0, 0);
+  }
+
+  double const* F = &Points[0];
+
+  if (NPoints == 1) {
+    return (2 * DT) * (TVector3D(F[0], F[1], F[2]) * std::exp(std::complex<double>(0, F[3])));
+  }
+
+  TVector3DC Sum(0, 0, 0);
+  for (size_t ip = 0; ip + 1 != NPoints; ++ip) {
+    double const* P0 = F + ip * kFilonStride;
+    double const* P1 = P0 + kFilonStride;
+
+    TVector3D const A0(P0[0], P0[1], P0[2]);
+    TVector3D const A1(P1[0], P1[1], P1[2]);
+
+    TVector3D DA0;
+    if (ip == 0) {
+      DA0 = A1 - A0;
+    } else {
+      double const* PM = P0 - kFilonStride;
+      DA0 = 0.5 * (A1 - TVector3D(PM[0], PM[1], PM[2]));
+    }
+    TVector3D DA1;
+    if (ip + 2 == NPoints) {
+      DA1 = A1 - A0;
+    } else {
+      double const* PP = P1 + kFilonStride;
+      DA1 = 0.5 * (TVector3D(PP[0], PP[1], PP[2]) - A0);
+    }
+
+    this->FilonInterval(A0, DA0, P0[3], P0[4], A1, DA1, P1[3], P1[4], DT, Sum, MaxPhaseDeviation);
+  }
+
+  // Half intervals to the start and stop times
+  std::complex<double> W[4];
+  double const* PL = F + (NPoints - 1) * kFilonStride;
+  TOMATH::FilonWeights(-F[4] * DT, W);
+  Sum += DT * (TVector3D(F[0], F[1], F[2]) * ((W[0] + W[2]) * std::exp(std::complex<double>(0, F[3]))));
+  TOMATH::FilonWeights(PL[4] * DT, W);
+  Sum += DT * (TVector3D(PL[0], PL[1], PL[2]) * ((W[0] + W[2]) * std::exp(std::complex<double>(0, PL[3]))));
+
+  return Sum;
+}
+
+
+
+
+TVector3DC OSCARSSR::EndPointsField (TParticleA const& Particle,
+                                     TVector3D const& ObservationPoint,
+                                     double const Omega) const
+{
+  // Half the sum of the field terms at the trajectory start and stop times.  The
+  // trajectory levels do not include the end points, so adding this to the sum over
+  // the inclusive grid gives the trapezoid sum the Richardson extrapolation assumes.
+
+  TVector3DC Sum(0, 0, 0);
+  double const Times[2] = { Particle.GetTrajectoryInterpolated().GetTStart(), Particle.GetTrajectoryInterpolated().GetTStop() };
+  for (int iEnd = 0; iEnd != 2; ++iEnd) {
+    TParticleTrajectoryPoint const PP = Particle.GetTrajectoryInterpolated().GetTrajectoryPoint(Times[iEnd]);
+
+    TVector3D const& X = PP.GetX();
+    TVector3D const& B = PP.GetB();
+    TVector3D const& AoverC = PP.GetAoverC();
+
+    TVector3D const R = ObservationPoint - X;
+    TVector3D const N = R.UnitVector();
+    double const D = R.Mag();
+
+    double const Phase = -Omega * (Times[iEnd] + D / TOSCARSSR::C());
+
+    TVector3D const Amplitude = ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
+        + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ); // NF + FF
+
+    Sum += (0.5 * Amplitude) * std::exp(std::complex<double>(0, Phase));
+  }
+
+  return Sum;
+}
+
+
+
+
+double OSCARSSR::EndPointsPowerDensity (TParticleA const& Particle,
+                                        TVector3D const& Obs,
+                                        TVector3D const& Normal,
+                                        bool const HasNormal,
+                                        bool const Directional,
+                                        bool const UseStart,
+                                        bool const UseStop) const
+{
+  // Half the sum of the power density terms at the trajectory start and stop times,
+  // for the trapezoid sum used in the Richardson extrapolation.  An end is left out
+  // if it is not used (for instance culled or shadowed) in the level sums.
+
+  double Sum = 0;
+  double const Times[2] = { Particle.GetTrajectoryInterpolated().GetTStart(), Particle.GetTrajectoryInterpolated().GetTStop() };
+  bool const Use[2] = { UseStart, UseStop };
+  for (int iEnd = 0; iEnd != 2; ++iEnd) {
+    if (!Use[iEnd]) {
+      continue;
+    }
+    TParticleTrajectoryPoint const PP = Particle.GetTrajectoryInterpolated().GetTrajectoryPoint(Times[iEnd]);
+
+    TVector3D const& X = PP.GetX();
+    TVector3D const& B = PP.GetB();
+    TVector3D const& AoverC = PP.GetAoverC();
+
+    TVector3D const N1 = (Obs - X).UnitVector();
+    TVector3D const N2 = N1.Orthogonal().UnitVector();
+    TVector3D const N3 = N1.Cross(N2).UnitVector();
+
+    double const N1DotNormal = HasNormal ? N1.Dot(Normal) : 1;
+    if (Directional && N1DotNormal <= 0) {
+      continue;
+    }
+
+    TVector3D const Numerator = N1.Cross( ( (N1 - B).Cross((AoverC)) ) );
+    double const Denominator = pow(1 - (B).Dot(N1), 5);
+
+    Sum += 0.5 * pow(Numerator.Dot(N2), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
+    Sum += 0.5 * pow(Numerator.Dot(N3), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
+  }
+
+  return Sum;
+}
+
+
+
+
+OSCARSSR::TLevelConvergence::TLevelConvergence ()
+{
+  this->Start(0, -1, false);
+}
+
+
+
+
+void OSCARSSR::TLevelConvergence::Start (int const MinLevel, int const NeighbourLevel, bool const WarmStart)
+{
+  // Start a new point.  Convergence is accepted after MinLevel, or when warm starting
+  // after the level the previous point converged at (with the previous level passed)
+
+  fRombergRow.clear();
+  fRombergRowE.clear();
+  fLastValue = -1;
+  fLastRawChange = -1;
+  fLastLevelPassed = false;
+  fLastLevelSame = false;
+  fPrecision = -1;
+  fLevel = -1;
+
+  fThisMinLevel = MinLevel;
+  if (WarmStart && NeighbourLevel >= 0) {
+    fThisMinLevel = NeighbourLevel - 2 > kWarmStartMinLevel ? NeighbourLevel - 2 : kWarmStartMinLevel;
+    fThisMinLevel = fThisMinLevel < MinLevel ? fThisMinLevel : MinLevel;
+  }
+
+  return;
+}
+
+
+
+
+bool OSCARSSR::PowerDensityLevelConverged (TLevelConvergence& State,
+                                           double const LevelSum,
+                                           int    const iLevel,
+                                           int    const MinLevel,
+                                           bool   const Resolved,
+                                           bool   const UseRichardson,
+                                           double const Precision) const
+{
+  // Check the power density sum of one level (end points included for Richardson,
+  // times the time step) for convergence.  Resolved is if the level resolves the change
+  // in direction.  On convergence the level and precision are set in the state
+
+  double ThisSum = LevelSum;
+  bool Asymptotic = false;
+  if (UseRichardson) {
+    // Extrapolate using only the levels which resolve the change in direction
+    if (!Resolved) {
+      State.fRombergRow.clear();
+    }
+    // The level sums converge as the trapezoid rule should when the change
+    // between levels shrinks by close to a factor 4
+    double const RawChange = State.fRombergRow.empty() ? -1 : fabs(ThisSum - State.fRombergRow[0]);
+    Asymptotic = RawChange > 0 && 3 * RawChange <= State.fLastRawChange && 6 * RawChange >= State.fLastRawChange;
+    State.fLastRawChange = RawChange;
+    ThisSum = TOMATH::RombergNext(State.fRombergRow, ThisSum, kRichardsonDepth);
+  }
+
+  State.fPrecision = fabs(ThisSum - State.fLastValue) / State.fLastValue;
+  if (UseRichardson && State.fRombergRow.size() > 1) {
+    // Error estimate from the last two extrapolations of this level.  Until the
+    // level sums converge as the trapezoid rule should it is not less than the
+    // change from the previous level's extrapolated value
+    double const RowPrecision = fabs(ThisSum - State.fRombergRow[State.fRombergRow.size() - 2]) / fabs(ThisSum);
+    if (Asymptotic || RowPrecision > State.fPrecision) {
+      State.fPrecision = RowPrecision;
+    }
+  }
+  // Below the usual minimum level the previous level must have passed as well
+  bool const LevelPassed = (!UseRichardson || State.fRombergRow.size() > 1) && State.fPrecision < Precision && Resolved;
+  bool const LevelSame = ThisSum == State.fLastValue;
+  if (LevelPassed && (iLevel > MinLevel || (iLevel > State.fThisMinLevel && State.fLastLevelPassed))) {
+    State.fLevel = iLevel;
+    return true;
+  } else if (LevelSame && (iLevel > MinLevel || (iLevel > State.fThisMinLevel && State.fLastLevelSame))) {
+    // The assumption here is that zero is last and now
+    State.fLevel = iLevel;
+    State.fPrecision = 0;
+    return true;
+  }
+  State.fLastLevelPassed = LevelPassed;
+  State.fLastLevelSame = LevelSame;
+
+  State.fLastValue = ThisSum;
+
+  return false;
+}
+
+
+
+
+bool OSCARSSR::FieldLevelConverged (TLevelConvergence& State,
+                                    TVector3DC const& LevelSumE,
+                                    int    const iLevel,
+                                    int    const MinLevel,
+                                    int    const StartLevel,
+                                    bool   const Resolved,
+                                    bool   const UseRichardson,
+                                    double const Precision) const
+{
+  // Check the field sum of one level (polarization applied) for convergence of its
+  // magnitude squared.  Resolved is if the level resolves the phase.  A level is only
+  // accepted after the start level.  On convergence the level and precision are set
+  // in the state
+
+  TVector3DC ThisSumE;
+  ThisSumE = LevelSumE;
+  bool Asymptotic = false;
+  if (UseRichardson) {
+    // Extrapolate using only the levels which resolve the phase
+    if (!Resolved) {
+      State.fRombergRowE.clear();
+    }
+    // The level sums converge as the trapezoid rule should when the change
+    // between levels shrinks by close to a factor 4
+    double const RawChange = State.fRombergRowE.empty() ? -1 : (ThisSumE - State.fRombergRowE[0]).Mag();
+    Asymptotic = RawChange > 0 && 3 * RawChange <= State.fLastRawChange && 6 * RawChange >= State.fLastRawChange;
+    State.fLastRawChange = RawChange;
+    ThisSumE = TOMATH::RombergNext(State.fRombergRowE, ThisSumE, kRichardsonDepth);
+  }
+  double const ThisMag = ThisSumE.Dot( ThisSumE.CC() ).real();
+
+  State.fPrecision = fabs(ThisMag - State.fLastValue) / State.fLastValue;
+  if (UseRichardson && State.fRombergRowE.size() > 1) {
+    // Error estimate from the last two extrapolations of this level.  Until the
+    // level sums converge as the trapezoid rule should it is not less than the
+    // change from the previous level's extrapolated value
+    TVector3DC const& LessExtrapolated = State.fRombergRowE[State.fRombergRowE.size() - 2];
+    double const RowPrecision = fabs(ThisMag - LessExtrapolated.Dot( LessExtrapolated.CC() ).real()) / ThisMag;
+    if (Asymptotic || RowPrecision > State.fPrecision) {
+      State.fPrecision = RowPrecision;
+    }
+  }
+  // Below the usual minimum level the previous level must have passed as well
+  bool const LevelPassed = iLevel > StartLevel && (!UseRichardson || State.fRombergRowE.size() > 1) && State.fPrecision < Precision && Resolved;
+  if (LevelPassed && (iLevel > MinLevel || (iLevel > State.fThisMinLevel && State.fLastLevelPassed))) {
+    State.fLevel = iLevel;
+    return true;
+  }
+  State.fLastLevelPassed = LevelPassed;
+
+  State.fLastValue = ThisMag;
+
+  return false;
+}
+
+
+
+
+void OSCARSSR::CalculateSpectrumThreads (TParticleA& Particle,
+                                         TVector3D const& Obs,
+                                         TSpectrumContainer& Spectrum,
+                                         int const NThreads,
+                                         std::string const& Polarization,
+                                         double const Angle,
+                                         TVector3D const& HorizontalDirection,
+                                         TVector3D const& PropogationDirection,
+                                         double const Precision,
+                                         int    const MaxLevel,
+                                         int    const MaxLevelExtended,
+                                         double const Weight,
+                                         int    const ReturnQuantity)
+{
+  // Calculates spectrum for the given particle and observation point
+  // in units of [photons / second / 0.001% BW / mm^2]
+  //
+  // Surface - Observation Point
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+  // Vector container for threads
+  std::vector<std::thread> Threads;
+
+  // Number of points in spectrum
+  size_t const NPoints = Spectrum.GetNPoints();
+
+  // How many threads to start in the first for loop
+  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
+
+  // Keep track of which threads are finished and re-joined
+  bool *Done = new bool[NThreadsActual];
+  bool *Joined = new bool[NThreadsActual];
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Start threads and keep in vector
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+
+    // First and last points for each thread
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    // Set Done and joined to false for this thread
+    Done[it] = false;
+    Joined[it] = false;
+
+    // Start thread for these points
+    Threads.push_back(std::thread(&OSCARSSR::CalculateSpectrumPoints,
+                                  this,
+                                  std::ref(Particle),
+                                  std::ref(Obs),
+                                  std::ref(Spectrum),
+                                  it,
+                                  NThreadsActual,
                                   std::ref(Done[it]),
-                                  Directional,
+                                  std::ref(Polarization),
+                                  Angle,
+                                  std::ref(HorizontalDirection),
+                                  std::ref(PropogationDirection),
                                   Precision,
                                   MaxLevel,
                                   MaxLevelExtended,
                                   Weight,
                                   ReturnQuantity));
+
   }
 
   // Are all of the threads finished or not?  Continue loop until all come back.
@@ -2343,6 +3266,7 @@ void OSCARSSR::CalculatePowerDensityThreads (TParticleA& Particle,
   size_t NThreadsFinished = 0;
   while (!AllThreadsFinished) {
 
+
     // So as to not use the current thread at 100%
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
@@ -2378,19 +3302,19 @@ void OSCARSSR::CalculatePowerDensityThreads (TParticleA& Particle,
 
 
 
-
-
-
-
-void OSCARSSR::CalculatePowerDensityGPU (TSurfacePoints const& Surface,
-                                         T3DScalarContainer& PowerDensityContainer,
-                                         int const NParticles,
-                                         std::vector<int> GPUVector,
-                                         bool const Directional,
-                                         double const Precision,
-                                         int    const MaxLevel,
-                                         int    const MaxLevelExtended,
-                                         int    const ReturnQuantity)
+void OSCARSSR::CalculateSpectrumGPU (TParticleA& Particle,
+                                     TVector3D const& ObservationPoint,
+                                     TSpectrumContainer& Spectrum,
+                                     std::string const& Polarization,
+                                     double const Angle,
+                                     TVector3D const& HorizontalDirection,
+                                     TVector3D const& PropogationDirection,
+                                     int const NParticles,
+                                     std::vector<int> GPUVector,
+                                     double const Precision,
+                                     int    const MaxLevel,
+                                     int    const MaxLevelExtended,
+                                     int    const ReturnQuantity)
 {
   // If you compile for Cuda use the GPU in this function, else throw
 
@@ -2413,14 +3337,18 @@ void OSCARSSR::CalculatePowerDensityGPU (TSurfacePoints const& Surface,
   int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
 
 
-  return OSCARSSR_Cuda_CalculatePowerDensityGPU (*this,
-                                                 Surface,
-                                                 PowerDensityContainer,
-                                                 NParticles,
-                                                 GPUVector,
-                                                 Precision,
-                                                 LevelStopWithExtended,
-                                                 ReturnQuantity);
+  return OSCARSSR_Cuda_CalculateSpectrumGPU (*this,
+                                             ObservationPoint,
+                                             Spectrum,
+                                             Polarization,
+                                             Angle,
+                                             HorizontalDirection,
+                                             PropogationDirection,
+                                             NParticles,
+                                             GPUVector,
+                                             Precision,
+                                             LevelStopWithExtended,
+                                             ReturnQuantity);
   #else
   throw std::invalid_argument("GPU functionality not compiled into this binary distribution");
   #endif
@@ -2432,123 +3360,187 @@ void OSCARSSR::CalculatePowerDensityGPU (TSurfacePoints const& Surface,
 
 
 
-double OSCARSSR::CalculateTotalPower ()
-{
-  // UPDATE: commet
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (fParticle.GetType() == "") {
-    try {
-      this->SetNewParticle();
-    } catch (std::exception e) {
-      throw std::out_of_range("no beam defined");
-    }
-  }
 
-  return this->CalculateTotalPower(fParticle);
-}
 
 
 
 
 
-double OSCARSSR::CalculateTotalPower (TParticleA& Particle)
-{
-  // Calculate total power out
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (Particle.GetType() == "") {
-    throw std::out_of_range("no particle defined");
-  }
 
-  // Grab the Trajectory
-  TParticleTrajectoryPoints& T = Particle.GetTrajectory();
 
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
-  }
 
 
-  // Number of points in Trajectory
-  size_t const NTPoints = T.GetNPoints();
-
-  // Timestep from trajectory
-  double const DeltaT = T.GetDeltaT();
 
-  // For summing total power
-  double TotalPower = 0;
+void OSCARSSR::CalculateSpectrumEnergySpread (TVector3D const& ObservationPoint,
+                                              TSpectrumContainer& Spectrum,
+                                              std::string const& Polarization,
+                                              double const Angle,
+                                              TVector3D const& HorizontalDirection,
+                                              TVector3D const& PropogationDirection,
+                                              int const NThreads,
+                                              int const GPU,
+                                              int const NGPU,
+                                              std::vector<int> VGPU,
+                                              double const Precision,
+                                              int    const MaxLevel,
+                                              int    const MaxLevelExtended,
+                                              int    const ReturnQuantity)
+{
+  // Calculate the spectrum including the beam energy spread without monte carlo.  A particle
+  // with relative energy deviation d emits (to good approximation for undulators) the ideal
+  // spectrum with the photon energy scaled by (1 + d)^2, so the spectrum is
+  //   S(E) = Integral G(d) S0(E / (1 + d)^2) dd
+  // where G is the gaussian energy distribution.  S0 is interpolated linearly in log(E) on a
+  // grid with spacing SigmaRel / 10 in log(E), so the spacing is proportional to E.  Only the
+  // grid points next to one of the scaled energies are calculated, so a sparse or wide
+  // spectrum only costs a local window around each requested energy.
+  // Emittance is not included here.
+
+  // Number of sigma to integrate over and number of points in the integral
+  double const NSigma = 4;
+  int    const NSteps = 41;
+
+  if (this->GetNParticleBeams() != 1) {
+    throw std::invalid_argument("energy spread convolution requires exactly one particle beam");
+  }
 
+  TParticleBeam& Beam = fParticleBeamContainer.GetParticleBeam(0);
+  double const SigmaRel = Beam.GetSigmaEnergyGeV() / Beam.GetE0();
 
-  // Loop over all points in trajectory
-  for (size_t i = 0; i != NTPoints; ++i) {
-    TVector3D const& B = T.GetB(i);
-    TVector3D const& AoverC = T.GetAoverC(i);
+  // Ideal particle from the beam
+  this->SetNewParticle("", "ideal");
+  this->CalculateTrajectory();
 
-    TotalPower += (AoverC.Mag2() - (B.Cross(AoverC)).Mag2()) * DeltaT;
+  size_t const NPoints = Spectrum.GetNPoints();
 
+  // Nothing to convolve for zero energy spread, precision, or level
+  if (SigmaRel <= 0 || ReturnQuantity != 0 || NPoints == 0) {
+    this->CalculateSpectrum(ObservationPoint,
+                            Spectrum,
+                            Polarization,
+                            Angle,
+                            HorizontalDirection,
+                            PropogationDirection,
+                            0,
+                            NThreads,
+                            GPU,
+                            NGPU,
+                            VGPU,
+                            Precision,
+                            MaxLevel,
+                            MaxLevelExtended,
+                            ReturnQuantity);
+    return;
   }
 
-  // Undulators, Wigglers and their applications, p42
-  TotalPower *= fabs(Particle.GetQ() * Particle.GetCurrent()) * pow(Particle.GetGamma(), 6) / (6 * TOSCARSSR::Pi() * TOSCARSSR::Epsilon0() * TOSCARSSR::C());
+  if (NSigma * SigmaRel >= 0.5) {
+    throw std::out_of_range("energy spread too large for convolution");
+  }
 
+  for (size_t i = 0; i != NPoints; ++i) {
+    if (Spectrum.GetEnergy(i) <= 0) {
+      throw std::out_of_range("energies must be > 0 for energy spread convolution");
+    }
+  }
 
-  return TotalPower;
-}
+  // Gaussian weights and photon energy scale factors
+  std::vector<double> Weights(NSteps);
+  std::vector<double> Scales(NSteps);
+  double WeightSum = 0;
+  for (int k = 0; k != NSteps; ++k) {
+    double const x = -NSigma + 2. * NSigma * k / (double) (NSteps - 1);
+    Weights[k] = exp(-0.5 * x * x);
+    Scales[k] = 1. / pow(1. + x * SigmaRel, 2);
+    WeightSum += Weights[k];
+  }
+  for (int k = 0; k != NSteps; ++k) {
+    Weights[k] /= WeightSum;
+  }
 
+  // Grid point j is at energy exp(j * LogStep).  Find the ones needed on either side of
+  // every scaled energy, in order
+  double const LogStep = SigmaRel / 10.;
+  std::map<long, size_t> GridIndex;
+  for (size_t i = 0; i != NPoints; ++i) {
+    for (int k = 0; k != NSteps; ++k) {
+      long const j = (long) floor(log(Spectrum.GetEnergy(i) * Scales[k]) / LogStep);
+      GridIndex[j] = 0;
+      GridIndex[j + 1] = 0;
+    }
+  }
+  std::vector<double> GridEnergies;
+  for (std::map<long, size_t>::iterator it = GridIndex.begin(); it != GridIndex.end(); ++it) {
+    it->second = GridEnergies.size();
+    GridEnergies.push_back(exp((double) it->first * LogStep));
+  }
 
+  // Ideal spectrum on the needed grid points
+  TSpectrumContainer Ideal(GridEnergies);
+  this->CalculateSpectrum(ObservationPoint,
+                          Ideal,
+                          Polarization,
+                          Angle,
+                          HorizontalDirection,
+                          PropogationDirection,
+                          0,
+                          NThreads,
+                          GPU,
+                          NGPU,
+                          VGPU,
+                          Precision,
+                          MaxLevel,
+                          MaxLevelExtended,
+                          0);
+
+  // Convolve for each requested energy
+  for (size_t i = 0; i != NPoints; ++i) {
+    double const Energy = Spectrum.GetEnergy(i);
 
+    double Sum = 0;
+    bool Converged = true;
+    for (int k = 0; k != NSteps; ++k) {
+      double const x = log(Energy * Scales[k]) / LogStep;
+      long   const j = (long) floor(x);
+      double const f = x - (double) j;
+      size_t const j0 = GridIndex[j];
+      size_t const j1 = GridIndex[j + 1];
+
+      Sum += Weights[k] * ((1. - f) * Ideal.GetFlux(j0) + f * Ideal.GetFlux(j1));
+
+      if (!Ideal.IsConverged(j0) || !Ideal.IsConverged(j1)) {
+        Converged = false;
+      }
+    }
 
+    Spectrum.AddToFlux(i, Sum);
+    if (!Converged) {
+      Spectrum.SetNotConverged(i);
+    }
+  }
 
+  return;
+}
 
 
 
 
-void OSCARSSR::CalculateFlux (TParticleA& Particle,
-                              TSurfacePoints const& Surface,
-                              double const Energy_eV,
-                              T3DScalarContainer& FluxContainer,
-                              std::string const& Polarization,
-                              double const Angle,
-                              TVector3D const& HorizontalDirection,
-                              TVector3D const& PropogationDirection,
-                              double const Precision,
-                              int    const MaxLevel,
-                              int    const MaxLevelExtended,
-                              double const Weight,
-                              int    const ReturnQuantity)
+void OSCARSSR::AddToSpectrum (TSpectrumContainer const& S, double const Weight)
 {
-  // Calculates the single particle flux
-  // in units of [photons / second / 0.001% BW / mm^2]
-
-  // Calculate trajectory if it doesn't exist
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
+  // Check if spectrum exists yet or not.  In not, create it
+  if (fSpectrum.GetNPoints() == 0) {
+    for (size_t i = 0; i != S.GetNPoints(); ++i) {
+      fSpectrum.AddPoint(S.GetEnergy(i), S.GetFlux(i) * Weight);
+    }
+  } else if (fSpectrum.GetNPoints() == S.GetNPoints()) {
+    for (size_t i = 0; i != S.GetNPoints(); ++i) {
+      fSpectrum.AddToFlux(i, S.GetFlux(i) * Weight);
+    }
+  } else {
+    throw std::out_of_range("spectra dimensions do not match");
   }
 
-  // Extra inpts for calculation
-  bool Done = false;
-  size_t const iFirst = 0;
-  size_t const iLast = Surface.GetNPoints() - 1;
-
-  // Calculate the flux
-  CalculateFluxPoints(Particle,
-                      Surface,
-                      Energy_eV,
-                      FluxContainer,
-                      iFirst,
-                      iLast,
-                      Done,
-                      Polarization,
-                      Angle,
-                      HorizontalDirection,
-                      PropogationDirection,
-                      Precision,
-                      MaxLevel,
-                      MaxLevelExtended,
-                      Weight,
-                      ReturnQuantity);
-
   return;
 }
 
@@ -2556,179 +3548,2289 @@ void OSCARSSR::CalculateFlux (TParticleA& Particle,
 
 
 
-void OSCARSSR::CalculateFlux (TSurfacePoints const& Surface,
-                              double const Energy_eV,
-                              T3DScalarContainer& FluxContainer,
-                              std::string const& Polarization,
-                              double const Angle,
-                              TVector3D const& HorizontalDirection,
-                              TVector3D const& PropogationDirection,
-                              int const NParticles,
-                              int const NThreads,
-                              int const GPU,
-                              int const NGPU,
-                              std::vector<int> VGPU,
-                              double const Precision,
-                              int    const MaxLevel,
-                              int    const MaxLevelExtended,
-                              int    const Dimension,
-                              int    const ReturnQuantity)
-{
-  // Calculate flux on surface
-  // THIS is the ENTRY POINT typically
 
-  // Check that particle has been set yet.  If fType is "" it has not been set yet
-  if (fParticle.GetType() == "") {
-    try {
-      this->SetNewParticle();
-    } catch (std::exception e) {
-      throw std::out_of_range("no beam defined");
+void OSCARSSR::AddToFlux (T3DScalarContainer const& F, double const Weight)
+{
+  // Check if spectrum exists yet or not.  In not, create it
+  if (fFlux.GetNPoints() == 0) {
+    for (size_t i = 0; i != F.GetNPoints(); ++i) {
+      fFlux.AddPoint(F.GetPoint(i).GetX(), F.GetPoint(i).GetV() * Weight);
+    }
+  } else if (fFlux.GetNPoints() == F.GetNPoints()) {
+    for (size_t i = 0; i != F.GetNPoints(); ++i) {
+      fFlux.AddToPoint(i, F.GetPoint(i).GetV() * Weight);
     }
+  } else {
+    throw std::out_of_range("spectra dimensions do not match");
   }
 
-  // Number of threads to possibly use
-  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
-  if (NThreadsToUse <= 0) {
-    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
-  }
+  return;
+}
 
-  // Should we use the GPU or not?
-  int const NGPUAvailable = this->CheckGPU();
-  bool const UseGPU = GPU == 0 ? false : this->GetUseGPUGlobal() && (NGPUAvailable > 0) ? true : (GPU == 1) && (NGPUAvailable > 0);
 
-  // If use GPU, let's check the GPU vector, or construct one if we must
-  std::vector<int> GPUVector;
-  for (std::vector<int>::const_iterator it = VGPU.begin(); it != VGPU.end(); ++it) {
-    GPUVector.push_back(*it);
-  }
-  if (GPUVector.size() == 0) {
-    for (int i = 0; i < NGPU; ++i) {
-      GPUVector.push_back(i);
-    }
-  }
-  if (NGPU != -1 && NGPU < (int) GPUVector.size()) {
-    GPUVector.resize(NGPU);
-  }
 
 
-  if (Dimension == 3) {
-    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
-      FluxContainer.AddPoint(Surface.GetPoint(i).GetPoint(), 0);
+
+
+void OSCARSSR::AddToPowerDensity (T3DScalarContainer const& P, double const Weight)
+{
+  // Check if spectrum exists yet or not.  In not, create it
+  if (fPowerDensity.GetNPoints() == 0) {
+    for (size_t i = 0; i != P.GetNPoints(); ++i) {
+      fPowerDensity.AddPoint(P.GetPoint(i).GetX(), P.GetPoint(i).GetV() * Weight);
     }
-  } else if (Dimension == 2) {
-    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
-      FluxContainer.AddPoint( TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), 0);
+  } else if (fPowerDensity.GetNPoints() == P.GetNPoints()) {
+    for (size_t i = 0; i != P.GetNPoints(); ++i) {
+      fPowerDensity.AddToPoint(i, P.GetPoint(i).GetV() * Weight);
     }
   } else {
-    throw std::out_of_range("wROng dimension");
+    throw std::out_of_range("spectra dimensions do not match");
   }
 
-  // Check polarization
-  if (Polarization == "all" ||
-      Polarization == "linear-horizontal" ||
-      Polarization == "linear-vertical"   ||
-      Polarization == "linear"            ||
-      Polarization == "circular-left"     ||
-      Polarization == "circular-right") {
-    // Do nothing
-  } else {
-    throw std::invalid_argument("Polarization requested not recognized");
-  }
+  return;
+}
 
 
-  // Which cpmpute method will we use, gpu, multi-thread, or single-thread
-  if (UseGPU) {
-    // Send to GPU function
-    CalculateFluxGPU(Surface,
-                     Energy_eV,
-                     FluxContainer,
-                     Polarization,
-                     Angle,
-                     HorizontalDirection,
-                     PropogationDirection,
-                     NParticles,
-                     GPUVector,
-                     Precision,
-                     MaxLevel,
-                     MaxLevelExtended,
-                     ReturnQuantity);
-  } else {
-    if (NParticles == 0) {
-      if (NThreadsToUse == 1) {
-        this->CalculateFlux(fParticle,
-                            Surface,
-                            Energy_eV,
-                            FluxContainer,
-                            Polarization,
-                            Angle,
-                            HorizontalDirection,
-                            PropogationDirection,
-                            Precision,
-                            MaxLevel,
-                            MaxLevelExtended,
-                            1,
-                            ReturnQuantity);
-      } else {
-        this->CalculateFluxThreads(fParticle,
-                                   Surface,
-                                   Energy_eV,
-                                   FluxContainer,
-                                   Polarization,
-                                   Angle,
-                                   HorizontalDirection,
-                                   PropogationDirection,
-                                   NThreadsToUse,
-                                   Precision,
-                                   MaxLevel,
-                                   MaxLevelExtended,
-                                   1,
-                                   ReturnQuantity);
-      }
-    } else {
-      // Weight this by the number of particles
-      double const Weight = 1.0 / (double) NParticles;
 
-      // Loop over particles
-      for (int i = 0; i != NParticles; ++i) {
 
-        // Set a new random particle
-        this->SetNewParticle();
-        this->CalculateTrajectory();
 
-        if (NThreadsToUse == 1) {
-          this->CalculateFlux(fParticle,
-                              Surface,
-                              Energy_eV,
-                              FluxContainer,
-                              Polarization,
-                              Angle,
+
+TSpectrumContainer const& OSCARSSR::GetSpectrum () const
+{
+  return fSpectrum;
+}
+
+
+
+
+void OSCARSSR::ClearSpectrum ()
+{
+  // Clear the contents of the particle beam container
+  fSpectrum.Clear();
+
+  return;
+}
+
+
+
+
+T3DScalarContainer const& OSCARSSR::GetFlux () const
+{
+  return fFlux;
+}
+
+
+
+
+void OSCARSSR::ClearFlux ()
+{
+  // Clear the contents
+  fFlux.Clear();
+
+  return;
+}
+
+
+
+
+T3DScalarContainer const& OSCARSSR::GetPowerDensity () const
+{
+  return fPowerDensity;
+}
+
+
+
+
+void OSCARSSR::ClearPowerDensity ()
+{
+  // Clear the contents
+  fPowerDensity.Clear();
+
+  return;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+void OSCARSSR::CalculatePowerDensity (TParticleA& Particle,
+                                      TSurfacePoints const& Surface,
+                                      T3DScalarContainer& PowerDensityContainer,
+                                      bool const Directional,
+                                      double const Precision,
+                                      int    const MaxLevel,
+                                      int    const MaxLevelExtended,
+                                      double const Weight,
+                                      int    const ReturnQuantity)
+{
+  // Calculates the single particle spectrum at a given observation point
+  // in units of [photons / second / 0.001% BW / mm^2]
+  //
+  // Particle - Particle, contains trajectory (or if not, calculate it)
+  // Surface - Observation Point
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+  // Extra inpts for calculation
+  bool Done = false;
+  size_t const iFirst = 0;
+  size_t const iLast = Surface.GetNPoints() - 1;
+
+  // Calculate the power density
+  CalculatePowerDensityPoints(Particle,
+                              Surface,
+                              PowerDensityContainer,
+                              iFirst,
+                              iLast,
+                              Done,
+                              Directional,
+                              Precision,
+                              MaxLevel,
+                              MaxLevelExtended,
+                              Weight,
+                              ReturnQuantity);
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculatePowerDensity (TSurfacePoints const& Surface,
+                                      T3DScalarContainer& PowerDensityContainer,
+                                      int const Dimension,
+                                      bool const Directional,
+                                      double const Precision,
+                                      int    const MaxLevel,
+                                      int    const MaxLevelExtended,
+                                      int const NParticles,
+                                      int const NThreads,
+                                      int const GPU,
+                                      int const NGPU,
+                                      std::vector<int> VGPU,
+                                      int const ReturnQuantity)
+{
+  // Calculates the power density in units of [W / mm^2]
+  // THIS is the ENTRY POINT typically
+  //
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (fParticle.GetType() == "") {
+    try {
+      this->SetNewParticle();
+    } catch (std::exception e) {
+      throw std::out_of_range("no beam defined");
+    }
+  }
+
+  // Number of threads to possibly use
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+  if (NThreadsToUse <= 0) {
+    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
+  }
+
+  // Take the checkpoint resume request here so it is consumed by this call on every path
+  // (GPU, processes, single particle) and never by a later or nested calculation
+  bool const CheckpointResume = fCheckpointResume;
+  fCheckpointResume = false;
+
+  // Should we use the GPU or not?
+  int const NGPUAvailable = this->CheckGPU();
+  bool const UseGPU = GPU == 0 ? false : this->GetUseGPUGlobal() && (NGPUAvailable > 0) ? true : (GPU == 1) && (NGPUAvailable > 0);
+
+  // If use GPU, let's check the GPU vector, or construct one if we must
+  std::vector<int> GPUVector;
+  for (std::vector<int>::const_iterator it = VGPU.begin(); it != VGPU.end(); ++it) {
+    GPUVector.push_back(*it);
+  }
+  if (GPUVector.size() == 0) {
+    for (int i = 0; i < NGPU; ++i) {
+      GPUVector.push_back(i);
+    }
+  }
+  if (NGPU != -1 && NGPU < (int) GPUVector.size()) {
+    GPUVector.resize(NGPU);
+  }
+
+
+
+
+  PowerDensityContainer.Clear();
+  // Set the output flux container and with correct dimensions
+  if (Dimension == 3) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      PowerDensityContainer.AddPoint(Surface.GetPoint(i).GetPoint(), 0);
+    }
+  } else if (Dimension == 2) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      PowerDensityContainer.AddPoint( TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), 0);
+    }
+  } else if (Dimension == 1) {
+    // UPDATE: Needs something for 1D
+    if (Surface.GetNPoints() == 1) {
+      PowerDensityContainer.AddPoint( Surface.GetPoint(0).GetPoint(), 0 );
+    } else {
+      TVector3D const x1 = Surface.GetPoint(0).GetPoint();
+      TVector3D const x2 = Surface.GetPoint( Surface.GetNPoints() - 1 ).GetPoint();
+
+      TVector3D const C = x1 + (x2 - x1) / 2;
+      for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+        double const Sign = i < Surface.GetNPoints() / 2 ? -1. : 1.;
+
+        PowerDensityContainer.AddPoint( TVector3D(Sign * (Surface.GetPoint(i).GetPoint() - C).Mag(), 0, 0), 0 );
+      }
+    }
+  } else {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  // Closed-form result if requested and possible for this configuration
+  if (this->CalculatePowerDensityAnalytic(Surface, PowerDensityContainer, Directional, Precision, MaxLevel, MaxLevelExtended, NParticles, NThreadsToUse, ReturnQuantity)) {
+    return;
+  }
+
+
+
+
+  // Which cpmpute method will we use, gpu, multi-thread, or single-thread.  Shadowing
+  // is only done on the cpu
+  if (UseGPU && fOccluders == 0x0) {
+    if (CheckpointResume) {
+      std::cerr << "WARNING: checkpoint resume is not supported on the GPU.  Calculating from the start" << std::endl;
+    }
+    // Send to GPU function
+    CalculatePowerDensityGPU(Surface,
+                             PowerDensityContainer,
+                             NParticles,
+                             GPUVector,
+                             Directional,
+                             Precision,
+                             MaxLevel,
+                             MaxLevelExtended,
+                             ReturnQuantity);
+  } else {
+    if (NParticles == 0) {
+      if (NThreadsToUse == 1) {
+        this->CalculatePowerDensity(fParticle,
+                                    Surface,
+                                    PowerDensityContainer,
+                                    Directional,
+                                    Precision,
+                                    MaxLevel,
+                                    MaxLevelExtended,
+                                    1,
+                                    ReturnQuantity);
+      } else {
+        this->CalculatePowerDensityThreads(fParticle,
+                                           Surface,
+                                           PowerDensityContainer,
+                                           NThreadsToUse,
+                                           Directional,
+                                           Precision,
+                                           MaxLevel,
+                                           MaxLevelExtended,
+                                           1,
+                                           ReturnQuantity);
+      }
+    } else if (this->GetNProcessesToUse(NParticles) > 1) {
+      // Split the particles over local processes, reduced through shared memory
+      int NParticlesThis = 0;
+      int const iProcess = this->ForkProcesses(this->GetNProcessesToUse(NParticles), NParticles, PowerDensityContainer.GetNPoints(), NParticlesThis);
+      if (iProcess >= 0) {
+        T3DScalarContainer ThisContainer;
+        try {
+          this->CalculatePowerDensity(Surface,
+                                      ThisContainer,
+                                      Dimension,
+                                      Directional,
+                                      Precision,
+                                      MaxLevel,
+                                      MaxLevelExtended,
+                                      NParticlesThis,
+                                      NThreadsToUse,
+                                      0,
+                                      NGPU,
+                                      VGPU,
+                                      ReturnQuantity);
+        } catch (std::exception const& e) {
+          this->FinishProcess(iProcess, 0x0, 0x0, e.what());
+        } catch (...) {
+          // Nothing may escape a forked worker
+          this->FinishProcess(iProcess, 0x0, 0x0, "unknown error");
+        }
+        this->FinishProcess(iProcess, 0x0, &ThisContainer);
+      }
+      this->ReduceProcesses(NParticles, 0x0, &PowerDensityContainer);
+    } else {
+      // Weight this by the number of particles
+      double const Weight = 1.0 / (double) NParticles;
+
+      // Start from a checkpoint if requested
+      int const NParticlesDone = CheckpointResume ? this->ReadCheckpoint(kCheckpoint_PowerDensity, NParticles, 0x0, &PowerDensityContainer) : 0;
+
+      // Loop over particles
+      for (int i = NParticlesDone; i < NParticles; ++i) {
+
+        // Set a new random particle
+        this->SetNewParticle();
+        this->CalculateTrajectory();
+
+        if (NThreadsToUse == 1) {
+          this->CalculatePowerDensity(fParticle,
+                                      Surface,
+                                      PowerDensityContainer,
+                                      Directional,
+                                      Precision,
+                                      MaxLevel,
+                                      MaxLevelExtended,
+                                      Weight,
+                                      ReturnQuantity);
+        } else {
+          this->CalculatePowerDensityThreads(fParticle,
+                                             Surface,
+                                             PowerDensityContainer,
+                                             NThreadsToUse,
+                                             Directional,
+                                             Precision,
+                                             MaxLevel,
+                                             MaxLevelExtended,
+                                             Weight,
+                                             ReturnQuantity);
+        }
+
+        // Write a checkpoint if it is time
+        if (this->CheckpointNow(NParticles, i + 1)) {
+          this->WriteCheckpoint(kCheckpoint_PowerDensity, NParticles, i + 1, 0x0, &PowerDensityContainer);
+        }
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+
+
+
+
+
+
+void OSCARSSR::CalculatePowerDensityPoints (TParticleA& Particle,
+                                            TSurfacePoints const& Surface,
+                                            T3DScalarContainer& PowerDensityContainer,
+                                            size_t const iFirst,
+                                            size_t const iLast,
+                                            bool& Done,
+                                            bool const Directional,
+                                            double const Precision,
+                                            int    const MaxLevel,
+                                            int    const MaxLevelExtended,
+                                            double const Weight,
+                                            int    const ReturnQuantity)
+{
+  // Calculates the single particle power density in a range of points
+  // in units of [watts / second / mm^2]
+
+  // Nothing to do for an empty range (iLast wraps for an empty surface)
+  if (Surface.GetNPoints() == 0 || iLast < iFirst) {
+    Done = true;
+    return;
+  }
+
+  // Check you are not requesting a level above the maximum
+  if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
+    std::cerr << "WARNING: MaxLevel > TParticleA::kMaxTrajectoryLevel.  Setting MaxLevel to TParticleA::kMaxTrajectoryLevel" << std::endl;
+  }
+
+  // Set the level to stop at if requested, but not above the hard limit
+  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
+  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+
+  // Variables for parts of the numerator and denominator of power density equation
+  TVector3D Numerator;
+  double Denominator;
+
+  bool const HasNormal = Surface.HasNormal();
+
+  // Extended trajectory (not using memory for storage of arrays
+  TParticleTrajectoryInterpolatedPoints TE;
+
+  // Richardson extrapolation across levels
+  bool const UseRichardson = fConvergenceMode == kConvergenceMode_Richardson;
+  int  const MinLevel = 8;
+
+  // Convergence of the current point
+  TLevelConvergence Convergence;
+
+  // Converged level of the previous point in this thread, for warm starting
+  int NeighbourLevel = -1;
+
+  // Trajectory segments with their emission cones, and which can reach this point
+  bool const UseCulling = fEmissionConeCulling > 0;
+  bool const UseShadowing = fOccluders != 0x0;
+  bool const UseSegments = UseCulling || UseShadowing;
+  double const ConeAngle = UseCulling ? fEmissionConeCulling / Particle.GetGamma() : -1;
+  TEmissionCones Cones;
+  std::vector<char> Visible;
+  if (UseSegments) {
+    Cones.Build(Particle.GetTrajectoryInterpolated(), kEmissionConeSegments, kEmissionConeSamples);
+  }
+
+  // Positions and normals of this range of points in one call
+  size_t const NThisRange = iLast + 1 - iFirst;
+  std::vector<double> SX(NThisRange);
+  std::vector<double> SY(NThisRange);
+  std::vector<double> SZ(NThisRange);
+  std::vector<double> SNX(NThisRange);
+  std::vector<double> SNY(NThisRange);
+  std::vector<double> SNZ(NThisRange);
+  Surface.GetArrays(iFirst, NThisRange, &SX[0], &SY[0], &SZ[0], &SNX[0], &SNY[0], &SNZ[0]);
+
+  // Loop over all points in the spectrum container
+  for (size_t i = iFirst; i <= iLast; ++i) {
+
+    // Obs point
+    TVector3D const Obs    (SX[i - iFirst],  SY[i - iFirst],  SZ[i - iFirst]);
+    TVector3D const Normal (SNX[i - iFirst], SNY[i - iFirst], SNZ[i - iFirst]);
+
+    int    LastLevel = 0;
+
+    // Summing for this power density
+    double Sum = 0;
+
+    // Lowest level after which convergence is accepted.  When warm starting this
+    // follows the level the previous point converged at
+    Convergence.Start(MinLevel, NeighbourLevel, fWarmStart);
+
+    // Segments which can reach this point: inside the emission cone, in front of
+    // the surface, and not shadowed.  If there are none there is nothing to sum
+    bool AllCulled = false;
+    if (UseSegments) {
+      size_t NVisible = Cones.Visible(Obs, ConeAngle, Visible);
+      if (Directional && HasNormal) {
+        NVisible = Cones.Facing(Obs, Normal, Visible);
+      }
+      if (UseShadowing) {
+        for (size_t iSegment = 0; iSegment != Visible.size(); ++iSegment) {
+          if (Visible[iSegment] && fOccluders->Occluded(Cones.GetCenter(iSegment), Obs, fOccludersPointsOnTriangles ? i : (size_t) -1)) {
+            Visible[iSegment] = 0;
+            --NVisible;
+          }
+        }
+      }
+      AllCulled = NVisible == 0;
+    }
+    if (AllCulled) {
+      Convergence.fLevel = 0;
+      Convergence.fPrecision = 0;
+    }
+
+    // The end points make each level sum a trapezoid sum for the extrapolation
+    double const EndPoints = UseRichardson && !AllCulled ? this->EndPointsPowerDensity(Particle, Obs, Normal, HasNormal, Directional, !UseSegments || Visible.front(), !UseSegments || Visible.back()) : 0;
+
+    for (int iLevel = 0; iLevel <= LevelStopWithExtended && !AllCulled; ++iLevel) {
+      LastLevel = iLevel;
+
+      // Keep track of Beta for precision
+      TVector3D Last_Beta(0, 0, 0);
+      double BetaDiffMax = -1;
+
+      // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
+      TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
+      if (iLevel > LevelStopMemory) {
+        TE = Particle.GetTrajectoryExtendedLevel(iLevel);
+      }
+
+      // Number of points in the trajectory
+      size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
+
+      // Loop over trajectory points
+      for (int iT = 0; iT != NTPoints; ++iT) {
+
+        TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
+
+        // Get position, Beta, and Acceleration (over c)
+        TVector3D const& X = PP.GetX();
+        TVector3D const& B = PP.GetB();
+        TVector3D const& AoverC = PP.GetAoverC();
+
+        double const BetaDiff = (B - Last_Beta).Mag();
+        if (iT > 0 && BetaDiff > BetaDiffMax) {
+          BetaDiffMax = BetaDiff;
+        }
+        Last_Beta = B;
+
+        // Skip segments which cannot radiate towards this point
+        if (UseSegments && !Visible[Cones.GetSegment(iT, NTPoints)]) {
+          continue;
+        }
+
+        // Define the three normal vectors.  N1 is in the direction of propogation,
+        // N2 and N3 are in a plane perpendicular to N1
+        TVector3D const N1 = (Obs - X).UnitVector();
+        TVector3D const N2 = N1.Orthogonal().UnitVector();
+        TVector3D const N3 = N1.Cross(N2).UnitVector();
+
+        // For computing non-normally incidence
+        double const N1DotNormal = HasNormal ? N1.Dot(Normal) : 1;
+        // UPDATE: URGENT: Check this
+        if (Directional && N1DotNormal <= 0) {
+          continue;
+        }
+
+        // Compute Numerator and denominator
+        Numerator = N1.Cross( ( (N1 - B).Cross((AoverC)) ) );
+        Denominator = pow(1 - (B).Dot(N1), 5);
+
+        // Add contributions from both N2 and N3
+        Sum += pow(Numerator.Dot(N2), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
+        Sum += pow(Numerator.Dot(N3), 2) / Denominator / (Obs - X).Mag2() * N1DotNormal;
+
+      }
+
+      double const ThisSum = (UseRichardson ? Sum + EndPoints : Sum) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
+      if (this->PowerDensityLevelConverged(Convergence, ThisSum, iLevel, MinLevel, BetaDiffMax < 2. / (Particle.GetGamma()), UseRichardson, Precision)) {
+        break;
+      }
+    }
+
+    // If a point does not converge mark it
+    if (Convergence.fLevel == -1) {
+      PowerDensityContainer.SetNotConverged(i);
+    }
+    NeighbourLevel = Convergence.fLevel;
+
+    if (UseRichardson && Convergence.fRombergRow.size() > 0) {
+      Sum = Convergence.fRombergRow.back() * fabs(Particle.GetQ() * Particle.GetCurrent()) / (16 * TOSCARSSR::Pi2() * TOSCARSSR::Epsilon0() * TOSCARSSR::C());
+    } else {
+      Sum *= fabs(Particle.GetQ() * Particle.GetCurrent()) / (16 * TOSCARSSR::Pi2() * TOSCARSSR::Epsilon0() * TOSCARSSR::C()) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
+    }
+
+    // m^2 to mm^2
+    Sum /= 1e6;
+
+    if (!Directional) {
+      if (Sum < 0) {
+        Sum *= -1;
+      }
+    }
+
+    // Add to container
+    switch (ReturnQuantity) {
+      case 1:
+        PowerDensityContainer.AddToPoint(i, Convergence.fPrecision * Weight);
+        break;
+      case 2:
+        PowerDensityContainer.AddToPoint(i, ((double) Convergence.fLevel) * Weight);
+        break;
+      default:
+        PowerDensityContainer.AddToPoint(i, Sum * Weight);
+        break;
+    }
+
+  } // POINTS
+
+
+  // Set done to true
+  Done = true;
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculatePowerDensityThreads (TParticleA& Particle,
+                                             TSurfacePoints const& Surface,
+                                             T3DScalarContainer& PowerDensityContainer,
+                                             int const NThreads,
+                                             bool const Directional,
+                                             double const Precision,
+                                             int    const MaxLevel,
+                                             int    const MaxLevelExtended,
+                                             double const Weight,
+                                             int    const ReturnQuantity)
+{
+  // Calculates the single particle power density on surface
+  // in units of [watts / second / mm^2]
+  //
+  // Surface - Observation Points
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+
+
+  // Vector for storing threads to rejoin
+  std::vector<std::thread> Threads;
+
+  // Number of points in spectrum
+  size_t const NPoints = Surface.GetNPoints();
+
+  // How many threads to start in the first for loop
+  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
+
+  // Keep track of which threads are finished and re-joined
+  bool *Done = new bool[NThreadsActual];
+  bool *Joined = new bool[NThreadsActual];
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Start threads and keep in vector
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+
+    // First and last points for each thread
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    // Set Done and joined to false for this thread
+    Done[it] = false;
+    Joined[it] = false;
+
+    // Start thread for these points
+    Threads.push_back(std::thread(&OSCARSSR::CalculatePowerDensityPoints,
+                                  this,
+                                  std::ref(Particle),
+                                  std::ref(Surface),
+                                  std::ref(PowerDensityContainer),
+                                  iFirst,
+                                  iLast,
+                                  std::ref(Done[it]),
+                                  Directional,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  Weight,
+                                  ReturnQuantity));
+  }
+
+  // Are all of the threads finished or not?  Continue loop until all come back.
+  bool AllThreadsFinished = false;
+  size_t NThreadsFinished = 0;
+  while (!AllThreadsFinished) {
+
+    // So as to not use the current thread at 100%
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // Check all threads
+    for (size_t it = 0; it != NThreadsActual; ++it) {
+
+      if (Done[it] && !Joined[it]) {
+        Threads[it].join();
+        Joined[it] = true;
+        ++NThreadsFinished;
+      }
+    }
+
+    // If the number finished is equal to the number of points total then we're done
+    if (NThreadsFinished == NThreadsActual) {
+      AllThreadsFinished = true;
+    }
+  }
+
+
+  // Clear all threads
+  Threads.clear();
+
+  // Delete my arrays, I hate new for this purpose
+  delete [] Done;
+  delete [] Joined;
+
+  return;
+}
+
+
+
+
+
+
+
+
+
+
+void OSCARSSR::CalculatePowerDensityGPU (TSurfacePoints const& Surface,
+                                         T3DScalarContainer& PowerDensityContainer,
+                                         int const NParticles,
+                                         std::vector<int> GPUVector,
+                                         bool const Directional,
+                                         double const Precision,
+                                         int    const MaxLevel,
+                                         int    const MaxLevelExtended,
+                                         int    const ReturnQuantity)
+{
+  // If you compile for Cuda use the GPU in this function, else throw
+
+  // If GPUVector is empty assume you want to use ALL GPUs available
+  if (GPUVector.size() == 0) {
+    int const NGPUAvailable = this->CheckGPU();
+    for (int i = 0; i < NGPUAvailable; ++i) {
+      GPUVector.push_back(i);
+    }
+  }
+
+  #ifdef CUDA
+  // Check that the GPU exists
+  if (this->CheckGPU() < 1) {
+    throw std::invalid_argument("You are requesting the GPU, but none were found");
+  }
+
+  // Set the level to stop at if requested, but not above the hard limit
+  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
+  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+
+
+  return OSCARSSR_Cuda_CalculatePowerDensityGPU (*this,
+                                                 Surface,
+                                                 PowerDensityContainer,
+                                                 NParticles,
+                                                 GPUVector,
+                                                 Precision,
+                                                 LevelStopWithExtended,
+                                                 ReturnQuantity);
+  #else
+  throw std::invalid_argument("GPU functionality not compiled into this binary distribution");
+  #endif
+
+  return;
+}
+
+
+
+
+
+double OSCARSSR::CalculateTotalPower ()
+{
+  // UPDATE: commet
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (fParticle.GetType() == "") {
+    try {
+      this->SetNewParticle();
+    } catch (std::exception e) {
+      throw std::out_of_range("no beam defined");
+    }
+  }
+
+  return this->CalculateTotalPower(fParticle);
+}
+
+
+
+
+
+double OSCARSSR::CalculateTotalPower (TParticleA& Particle)
+{
+  // Calculate total power out
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (Particle.GetType() == "") {
+    throw std::out_of_range("no particle defined");
+  }
+
+  // Grab the Trajectory
+  TParticleTrajectoryPoints& T = Particle.GetTrajectory();
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+
+  // Number of points in Trajectory
+  size_t const NTPoints = T.GetNPoints();
+
+  // Timestep from trajectory
+  double const DeltaT = T.GetDeltaT();
+
+  // For summing total power
+  double TotalPower = 0;
+
+
+  // Loop over all points in trajectory
+  for (size_t i = 0; i != NTPoints; ++i) {
+    TVector3D const& B = T.GetB(i);
+    TVector3D const& AoverC = T.GetAoverC(i);
+
+    TotalPower += (AoverC.Mag2() - (B.Cross(AoverC)).Mag2()) * DeltaT;
+
+  }
+
+  // Undulators, Wigglers and their applications, p42
+  TotalPower *= fabs(Particle.GetQ() * Particle.GetCurrent()) * pow(Particle.GetGamma(), 6) / (6 * TOSCARSSR::Pi() * TOSCARSSR::Epsilon0() * TOSCARSSR::C());
+
+
+  return TotalPower;
+}
+
+
+
+
+
+
+
+
+
+void OSCARSSR::CalculateFlux (TParticleA& Particle,
+                              TSurfacePoints const& Surface,
+                              double const Energy_eV,
+                              T3DScalarContainer& FluxContainer,
+                              std::string const& Polarization,
+                              double const Angle,
+                              TVector3D const& HorizontalDirection,
+                              TVector3D const& PropogationDirection,
+                              double const Precision,
+                              int    const MaxLevel,
+                              int    const MaxLevelExtended,
+                              double const Weight,
+                              int    const ReturnQuantity)
+{
+  // Calculates the single particle flux
+  // in units of [photons / second / 0.001% BW / mm^2]
+
+  // Calculate trajectory if it doesn't exist
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+  // Extra inpts for calculation
+  bool Done = false;
+  size_t const iFirst = 0;
+  size_t const iLast = Surface.GetNPoints() - 1;
+
+  // Calculate the flux
+  CalculateFluxPoints(Particle,
+                      Surface,
+                      Energy_eV,
+                      FluxContainer,
+                      iFirst,
+                      iLast,
+                      Done,
+                      Polarization,
+                      Angle,
+                      HorizontalDirection,
+                      PropogationDirection,
+                      Precision,
+                      MaxLevel,
+                      MaxLevelExtended,
+                      Weight,
+                      ReturnQuantity);
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateFlux (TSurfacePoints const& Surface,
+                              double const Energy_eV,
+                              T3DScalarContainer& FluxContainer,
+                              std::string const& Polarization,
+                              double const Angle,
+                              TVector3D const& HorizontalDirection,
+                              TVector3D const& PropogationDirection,
+                              int const NParticles,
+                              int const NThreads,
+                              int const GPU,
+                              int const NGPU,
+                              std::vector<int> VGPU,
+                              double const Precision,
+                              int    const MaxLevel,
+                              int    const MaxLevelExtended,
+                              int    const Dimension,
+                              int    const ReturnQuantity)
+{
+  // Calculate flux on surface
+  // THIS is the ENTRY POINT typically
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (fParticle.GetType() == "") {
+    try {
+      this->SetNewParticle();
+    } catch (std::exception e) {
+      throw std::out_of_range("no beam defined");
+    }
+  }
+
+  // Number of threads to possibly use
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+  if (NThreadsToUse <= 0) {
+    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
+  }
+
+  // Take the checkpoint resume request here so it is consumed by this call on every path
+  // (GPU, processes, single particle) and never by a later or nested calculation
+  bool const CheckpointResume = fCheckpointResume;
+  fCheckpointResume = false;
+
+  // Should we use the GPU or not?
+  int const NGPUAvailable = this->CheckGPU();
+  bool const UseGPU = GPU == 0 ? false : this->GetUseGPUGlobal() && (NGPUAvailable > 0) ? true : (GPU == 1) && (NGPUAvailable > 0);
+
+  // If use GPU, let's check the GPU vector, or construct one if we must
+  std::vector<int> GPUVector;
+  for (std::vector<int>::const_iterator it = VGPU.begin(); it != VGPU.end(); ++it) {
+    GPUVector.push_back(*it);
+  }
+  if (GPUVector.size() == 0) {
+    for (int i = 0; i < NGPU; ++i) {
+      GPUVector.push_back(i);
+    }
+  }
+  if (NGPU != -1 && NGPU < (int) GPUVector.size()) {
+    GPUVector.resize(NGPU);
+  }
+
+
+  if (Dimension == 3) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      FluxContainer.AddPoint(Surface.GetPoint(i).GetPoint(), 0);
+    }
+  } else if (Dimension == 2) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      FluxContainer.AddPoint( TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), 0);
+    }
+  } else {
+    throw std::out_of_range("wROng dimension");
+  }
+
+  // Check polarization
+  if (Polarization == "all" ||
+      Polarization == "linear-horizontal" ||
+      Polarization == "linear-vertical"   ||
+      Polarization == "linear"            ||
+      Polarization == "circular-left"     ||
+      Polarization == "circular-right") {
+    // Do nothing
+  } else {
+    throw std::invalid_argument("Polarization requested not recognized");
+  }
+
+  // Closed-form result if requested and possible for this configuration
+  if (this->CalculateFluxAnalytic(Surface, Energy_eV, FluxContainer, Polarization, NParticles, NThreadsToUse, ReturnQuantity)) {
+    return;
+  }
+
+
+  // Which cpmpute method will we use, gpu, multi-thread, or single-thread
+  if (UseGPU) {
+    if (CheckpointResume) {
+      std::cerr << "WARNING: checkpoint resume is not supported on the GPU.  Calculating from the start" << std::endl;
+    }
+    // Send to GPU function
+    CalculateFluxGPU(Surface,
+                     Energy_eV,
+                     FluxContainer,
+                     Polarization,
+                     Angle,
+                     HorizontalDirection,
+                     PropogationDirection,
+                     NParticles,
+                     GPUVector,
+                     Precision,
+                     MaxLevel,
+                     MaxLevelExtended,
+                     ReturnQuantity);
+  } else {
+    if (NParticles == 0) {
+      if (NThreadsToUse == 1) {
+        this->CalculateFlux(fParticle,
+                            Surface,
+                            Energy_eV,
+                            FluxContainer,
+                            Polarization,
+                            Angle,
+                            HorizontalDirection,
+                            PropogationDirection,
+                            Precision,
+                            MaxLevel,
+                            MaxLevelExtended,
+                            1,
+                            ReturnQuantity);
+      } else {
+        this->CalculateFluxThreads(fParticle,
+                                   Surface,
+                                   Energy_eV,
+                                   FluxContainer,
+                                   Polarization,
+                                   Angle,
+                                   HorizontalDirection,
+                                   PropogationDirection,
+                                   NThreadsToUse,
+                                   Precision,
+                                   MaxLevel,
+                                   MaxLevelExtended,
+                                   1,
+                                   ReturnQuantity);
+      }
+    } else if (this->GetNProcessesToUse(NParticles) > 1) {
+      // Split the particles over local processes, reduced through shared memory
+      int NParticlesThis = 0;
+      int const iProcess = this->ForkProcesses(this->GetNProcessesToUse(NParticles), NParticles, FluxContainer.GetNPoints(), NParticlesThis);
+      if (iProcess >= 0) {
+        T3DScalarContainer ThisContainer;
+        try {
+          this->CalculateFlux(Surface,
+                              Energy_eV,
+                              ThisContainer,
+                              Polarization,
+                              Angle,
+                              HorizontalDirection,
+                              PropogationDirection,
+                              NParticlesThis,
+                              NThreadsToUse,
+                              0,
+                              NGPU,
+                              VGPU,
+                              Precision,
+                              MaxLevel,
+                              MaxLevelExtended,
+                              Dimension,
+                              ReturnQuantity);
+        } catch (std::exception const& e) {
+          this->FinishProcess(iProcess, 0x0, 0x0, e.what());
+        } catch (...) {
+          // Nothing may escape a forked worker
+          this->FinishProcess(iProcess, 0x0, 0x0, "unknown error");
+        }
+        this->FinishProcess(iProcess, 0x0, &ThisContainer);
+      }
+      this->ReduceProcesses(NParticles, 0x0, &FluxContainer);
+    } else {
+      // Weight this by the number of particles
+      double const Weight = 1.0 / (double) NParticles;
+
+      // Start from a checkpoint if requested
+      int const NParticlesDone = CheckpointResume ? this->ReadCheckpoint(kCheckpoint_Flux, NParticles, 0x0, &FluxContainer) : 0;
+
+      // Loop over particles
+      for (int i = NParticlesDone; i < NParticles; ++i) {
+
+        // Set a new random particle
+        this->SetNewParticle();
+        this->CalculateTrajectory();
+
+        if (NThreadsToUse == 1) {
+          this->CalculateFlux(fParticle,
+                              Surface,
+                              Energy_eV,
+                              FluxContainer,
+                              Polarization,
+                              Angle,
                               HorizontalDirection,
                               PropogationDirection,
                               Precision,
                               MaxLevel,
                               MaxLevelExtended,
-                              Weight,
+                              Weight,
+                              ReturnQuantity);
+        } else {
+          this->CalculateFluxThreads(fParticle,
+                                     Surface,
+                                     Energy_eV,
+                                     FluxContainer,
+                                     Polarization,
+                                     Angle,
+                                     HorizontalDirection,
+                                     PropogationDirection,
+                                     NThreadsToUse,
+                                     Precision,
+                                     MaxLevel,
+                                     MaxLevelExtended,
+                                     Weight,
+                                     ReturnQuantity);
+        }
+
+        // Write a checkpoint if it is time
+        if (this->CheckpointNow(NParticles, i + 1)) {
+          this->WriteCheckpoint(kCheckpoint_Flux, NParticles, i + 1, 0x0, &FluxContainer);
+        }
+      }
+    }
+  }
+
+
+  return;
+}
+
+
+
+
+
+
+void OSCARSSR::CalculateFluxPoints (TParticleA& Particle,
+                                    TSurfacePoints const& Surface,
+                                    double const Energy_eV,
+                                    T3DScalarContainer& FluxContainer,
+                                    size_t const iFirst,
+                                    size_t const iLast,
+                                    bool& Done,
+                                    std::string const& Polarization,
+                                    double const Angle,
+                                    TVector3D const& HorizontalDirection,
+                                    TVector3D const& PropogationDirection,
+                                    double const Precision,
+                                    int    const MaxLevel,
+                                    int    const MaxLevelExtended,
+                                    double const Weight,
+                                    int    const ReturnQuantity)
+{
+  // Calculates the single particle flux at a given observation point
+  // in units of [photons / second / 0.001% BW / mm^2]
+  //
+  // Particle - the Particle.. with a Trajectory structure hopefully
+
+  // Nothing to do for an empty range (iLast wraps for an empty surface)
+  if (Surface.GetNPoints() == 0 || iLast < iFirst) {
+    Done = true;
+    return;
+  }
+
+  // Check number of points
+  //if (NTPoints < 1) {
+  //  throw std::length_error("no points in trajectory.  Is particle or beam defined?");
+  //}
+
+  // Check you are not requesting a level above the maximum
+  if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
+    std::cerr << "WARNING: MaxLevel > TParticleA::kMaxTrajectoryLevel.  Setting MaxLevel to TParticleA::kMaxTrajectoryLevel" << std::endl;
+  }
+
+  // Set the level to stop at if requested, but not above the hard limit
+  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
+  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+
+  // Constant C0 for calculation
+  double const C0 = Particle.GetQ() / (TOSCARSSR::FourPi() * TOSCARSSR::C() * TOSCARSSR::Epsilon0() * TOSCARSSR::Sqrt2Pi());
+
+  // Constant for flux calculation at the end
+  double const C2 = TOSCARSSR::FourPi() * Particle.GetCurrent() / (TOSCARSSR::H() * fabs(Particle.GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
+
+  // Imaginary "i" and complxe 1+0i
+  std::complex<double> const I(0, 1);
+  std::complex<double> const One(1, 0);
+
+  // Photon vertical direction and positive and negative helicity
+  TVector3D const VerticalDirection = PropogationDirection.Cross(HorizontalDirection).UnitVector();
+  TVector3DC const Positive = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) + VerticalDirection * I );
+  TVector3DC const Negative = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) - VerticalDirection * I );
+
+  TVector3DC PolarizationVector(0, 0, 0);
+  if (Polarization == "all") {
+    // Do Nothing
+  } else if (Polarization == "linear-horizontal") {
+    PolarizationVector = HorizontalDirection;
+  } else if (Polarization == "linear-vertical") {
+    PolarizationVector = VerticalDirection;
+  } else if (Polarization == "linear") {
+    TVector3D PolarizationAngle = HorizontalDirection;
+    PolarizationAngle.RotateSelf(Angle, PropogationDirection);
+    PolarizationVector = PolarizationAngle;
+  } else if (Polarization == "circular-left") {
+    PolarizationVector = Positive;
+  } else if (Polarization == "circular-right") {
+    PolarizationVector = Negative;
+  } else {
+    // Throw invalid argument if polarization is not recognized
+    throw std::invalid_argument("Polarization requested not recognized");
+  }
+
+
+  // Angular frequency
+  double const Omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);;
+
+  // Extended trajectory (not using memory for storage of arrays
+  TParticleTrajectoryInterpolatedPoints TE;
+
+  // Which integrator to use and interval weights for Filon
+  bool const UseFilon = fIntegrator == kIntegrator_Filon;
+
+  // Richardson extrapolation across levels of the Riemann sum
+  bool const UseRichardson = fConvergenceMode == kConvergenceMode_Richardson && !UseFilon;
+  int  const MinLevel = 8;
+  std::vector<double> FilonPoints;
+
+  // Convergence of the current point
+  TLevelConvergence Convergence;
+
+  // Converged level of the previous point in this thread, for warm starting
+  int NeighbourLevel = -1;
+
+  // Positions of this range of points in one call
+  size_t const NThisRange = iLast + 1 - iFirst;
+  std::vector<double> SX(NThisRange);
+  std::vector<double> SY(NThisRange);
+  std::vector<double> SZ(NThisRange);
+  Surface.GetArrays(iFirst, NThisRange, &SX[0], &SY[0], &SZ[0], 0x0, 0x0, 0x0);
+
+  // Loop over all points in the spectrum container
+  for (size_t i = iFirst; i <= iLast; ++i) {
+
+    // Obs point
+    TVector3D ObservationPoint(SX[i - iFirst], SY[i - iFirst], SZ[i - iFirst]);
+
+    // Electric field summation in frequency space
+    TVector3DC SumE(0, 0, 0);
+
+    double ThisPhase = -1;
+    double LastPhase = -1;
+    double MaxDPhase = 0;
+    int    LastLevel = 0;
+
+    // The end points make each level sum a trapezoid sum for the extrapolation
+    TVector3DC const EndPoints = UseRichardson ? this->EndPointsField(Particle, ObservationPoint, Omega) : TVector3DC(0, 0, 0);
+
+    // For the Filon integrator the amplitude, phase, and phase derivative of every
+    // point up to the current level are kept in time order (the inclusive grid)
+    TVector3DC SumFilon(0, 0, 0);
+    double MaxPhaseDeviation = 0;
+    FilonPoints.clear();
+
+    // Lowest level after which convergence is accepted.  When warm starting this
+    // follows the level the previous point converged at, and for Filon the sum over
+    // the inclusive grid is only done from the start level on
+    Convergence.Start(MinLevel, NeighbourLevel, fWarmStart);
+    int StartLevel = 0;
+    if (fWarmStart && UseFilon) {
+      // One level below where the neighbour converged, or the predicted level if lower
+      int const PredictedLevel = this->PredictLevel(Particle, ObservationPoint, Omega, LevelStopMemory);
+      StartLevel = NeighbourLevel >= 0 && NeighbourLevel - 2 < PredictedLevel ? NeighbourLevel - 2 : PredictedLevel - 1;
+      StartLevel = StartLevel > 0 ? StartLevel : 0;
+    }
+
+    for (int iLevel = 0; iLevel <= LevelStopWithExtended; ++iLevel) {
+      LastLevel = iLevel;
+
+      // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
+      TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
+      if (iLevel > LevelStopMemory) {
+        TE = Particle.GetTrajectoryExtendedLevel(iLevel);
+      }
+
+      // Number of points in the trajectory
+      size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
+
+
+      MaxDPhase = 0;
+      if (UseFilon) {
+        // Spread the points of the lower levels, the points of this level go in between
+        this->FilonSpread(FilonPoints, NTPoints);
+      }
+
+      // Loop over trajectory points
+      for (int iT = 0; iT != NTPoints; ++iT) {
+
+        TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
+
+        // Get position, Beta, and Acceleration (over c)
+        TVector3D const& X = PP.GetX();
+        TVector3D const& B = PP.GetB();
+        TVector3D const& AoverC = PP.GetAoverC();
+        double    const  Time = iLevel <= LevelStopMemory ? TM.GetT(iT) : TE.GetT(iT);
+
+
+        // Define R and unit vector in direction of R, and D (distance to observer)
+        TVector3D const R = ObservationPoint - X;
+        TVector3D const N = R.UnitVector();
+        double const D = R.Mag();
+
+        // Exponent in transformed field
+        ThisPhase = -Omega * (Time + D / TOSCARSSR::C());
+        double const DPhase = ThisPhase - LastPhase;
+        double const PhaseTestValue = fabs(DPhase);
+        if (iT != 0 && PhaseTestValue > MaxDPhase) {
+          MaxDPhase = PhaseTestValue;
+        }
+        std::complex<double> Exponent(0, ThisPhase);
+
+        TVector3D const Amplitude = ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
+            + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ); // NF + FF
+
+        if (UseFilon) {
+          // Points of this level are every other point of the inclusive grid
+          double* F = &FilonPoints[2 * iT * kFilonStride];
+          F[0] = Amplitude.GetX();
+          F[1] = Amplitude.GetY();
+          F[2] = Amplitude.GetZ();
+          F[3] = ThisPhase;
+          F[4] = -Omega * (1 - N.Dot(B));
+        } else {
+          // Add this contribution
+          SumE += Amplitude * std::exp(Exponent);
+        }
+        LastPhase = ThisPhase;
+
+      }
+
+      // Below the start level the points are only collected
+      if (iLevel < StartLevel) {
+        continue;
+      }
+
+      if (UseFilon) {
+        SumFilon = this->FilonSum(FilonPoints, Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel), MaxPhaseDeviation);
+      }
+
+      TVector3DC ThisSumE = UseFilon ? SumFilon : (UseRichardson ? SumE + EndPoints : SumE) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
+      if (PolarizationVector.Mag2() > 0.001) {
+        ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
+      }
+
+      if (this->FieldLevelConverged(Convergence, ThisSumE, iLevel, MinLevel, StartLevel, (UseFilon ? MaxPhaseDeviation : MaxDPhase) < TOSCARSSR::Pi(), UseRichardson, Precision)) {
+        break;
+      }
+    }
+
+    if (Convergence.fLevel == -1) {
+      FluxContainer.SetNotConverged(i);
+    }
+    NeighbourLevel = Convergence.fLevel;
+
+
+    // Multiply by constant factor
+    if (UseFilon) {
+      SumE = SumFilon * C0;
+    } else if (UseRichardson && Convergence.fRombergRowE.size() > 0) {
+      SumE = Convergence.fRombergRowE.back() * C0;
+    } else {
+      SumE *= C0 * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
+    }
+
+    // Correcr for polarization
+    if (PolarizationVector.Mag2() > 0.001) {
+      SumE = SumE.Dot(PolarizationVector) * PolarizationVector;
+    }
+
+
+    // Add to container
+    switch (ReturnQuantity) {
+      case 1:
+        FluxContainer.AddToPoint(i, Convergence.fPrecision * Weight);
+        break;
+      case 2:
+        FluxContainer.AddToPoint(i, ((double) Convergence.fLevel) * Weight);
+        break;
+      default:
+        FluxContainer.AddToPoint(i, C2 *  SumE.Dot( SumE.CC() ).real() * Weight);
+        break;
+    }
+  } // POINTS
+
+  // Set done to true
+  Done = true;
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateFluxThreads (TParticleA& Particle,
+                                     TSurfacePoints const& Surface,
+                                     double const Energy_eV,
+                                     T3DScalarContainer& FluxContainer,
+                                     std::string const& Polarization,
+                                     double const Angle,
+                                     TVector3D const& HorizontalDirection,
+                                     TVector3D const& PropogationDirection,
+                                     int const NThreads,
+                                     double const Precision,
+                                     int    const MaxLevel,
+                                     int    const MaxLevelExtended,
+                                     double const Weight,
+                                     int    const ReturnQuantity)
+{
+  // Calculates the single particle flux on a surface
+  // in units of [photons / second / 0.001% BW / mm^2]
+  //
+  // Surface - Observation Point
+
+  // Calculate the trajectory only if it doesn't exist yet
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+  // Vector for storing threads to rejoin
+  std::vector<std::thread> Threads;
+
+  // Number of points in spectrum
+  size_t const NPoints = Surface.GetNPoints();
+
+  // How many threads to start in the first for loop
+  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
+
+  // Keep track of which threads are finished and re-joined
+  bool *Done = new bool[NThreadsActual];
+  bool *Joined = new bool[NThreadsActual];
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Start threads and keep in vector
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+
+    // First and last points for each thread
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    // Set Done and joined to false for this thread
+    Done[it] = false;
+    Joined[it] = false;
+
+    // Start thread for these points
+    Threads.push_back(std::thread(&OSCARSSR::CalculateFluxPoints,
+                                  this,
+                                  std::ref(Particle),
+                                  std::ref(Surface),
+                                  Energy_eV,
+                                  std::ref(FluxContainer),
+                                  iFirst,
+                                  iLast,
+                                  std::ref(Done[it]),
+                                  Polarization,
+                                  Angle,
+                                  HorizontalDirection,
+                                  PropogationDirection,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  Weight,
+                                  ReturnQuantity));
+  }
+
+  // Are all of the threads finished or not?  Continue loop until all come back.
+  bool AllThreadsFinished = false;
+  size_t NThreadsFinished = 0;
+  while (!AllThreadsFinished) {
+
+    // So as to not use the current thread at 100%
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // Check all threads
+    for (size_t it = 0; it != NThreadsActual; ++it) {
+
+      if (Done[it] && !Joined[it]) {
+        Threads[it].join();
+        Joined[it] = true;
+        ++NThreadsFinished;
+      }
+    }
+
+    // If the number finished is equal to the number of points total then we're done
+    if (NThreadsFinished == NThreadsActual) {
+      AllThreadsFinished = true;
+    }
+  }
+
+  // Clear all threads
+  Threads.clear();
+
+  // Delete my arrays, I hate new for this purpose
+  delete [] Done;
+  delete [] Joined;
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateFluxCube (TSurfacePoints const& Surface,
+                                  T4DScalarContainer& FluxContainer,
+                                  std::string const& Polarization,
+                                  double const Angle,
+                                  TVector3D const& HorizontalDirection,
+                                  TVector3D const& PropogationDirection,
+                                  int const NParticles,
+                                  int const NThreads,
+                                  double const Precision,
+                                  int    const MaxLevel,
+                                  int    const MaxLevelExtended,
+                                  int    const Dimension)
+{
+  // Calculate the flux on a surface at every energy of FluxContainer (set with
+  // SetEnergies) in one pass over surface and trajectory.  Only the Riemann sum is
+  // used (a warning is given if the Filon integrator is set), see
+  // CalculateFluxCubePoints
+
+  // Check that particle has been set yet.  If fType is "" it has not been set yet
+  if (fParticle.GetType() == "") {
+    try {
+      this->SetNewParticle();
+    } catch (std::exception e) {
+      throw std::out_of_range("no beam defined");
+    }
+  }
+
+  // Number of threads to possibly use
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+  if (NThreadsToUse <= 0) {
+    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
+  }
+
+  if (FluxContainer.GetNEnergies() == 0) {
+    throw std::length_error("no energies given for the flux cube");
+  }
+
+  if (Dimension == 3) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      FluxContainer.AddPoint(Surface.GetPoint(i).GetPoint());
+    }
+  } else if (Dimension == 2) {
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      FluxContainer.AddPoint(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0));
+    }
+  } else {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  // Check polarization
+  if (Polarization == "all" ||
+      Polarization == "linear-horizontal" ||
+      Polarization == "linear-vertical"   ||
+      Polarization == "linear"            ||
+      Polarization == "circular-left"     ||
+      Polarization == "circular-right") {
+    // Do nothing
+  } else {
+    throw std::invalid_argument("Polarization requested not recognized");
+  }
+
+  // The cube has the per energy phase in the Riemann sum only
+  if (fIntegrator == kIntegrator_Filon) {
+    std::cerr << "WARNING: the flux cube does not use the filon integrator.  Using the riemann sum" << std::endl;
+  }
+
+  // Nothing to calculate for an empty surface (the index of the last point would wrap)
+  if (Surface.GetNPoints() == 0) {
+    return;
+  }
+
+  fLastCalculationPath = "numerical";
+
+  if (NParticles == 0) {
+    if (NThreadsToUse == 1) {
+      // Calculate trajectory if it doesn't exist
+      if (fParticle.GetTrajectory().GetNPoints() == 0) {
+        this->CalculateTrajectory(fParticle);
+      }
+
+      bool Done = false;
+      std::vector<size_t> NotConverged;
+      this->CalculateFluxCubePoints(fParticle,
+                                    Surface,
+                                    FluxContainer,
+                                    0,
+                                    Surface.GetNPoints() - 1,
+                                    0,
+                                    1,
+                                    Done,
+                                    NotConverged,
+                                    Polarization,
+                                    Angle,
+                                    HorizontalDirection,
+                                    PropogationDirection,
+                                    Precision,
+                                    MaxLevel,
+                                    MaxLevelExtended,
+                                    1);
+      for (std::vector<size_t>::const_iterator it = NotConverged.begin(); it != NotConverged.end(); ++it) {
+        FluxContainer.SetNotConverged(*it);
+      }
+    } else {
+      this->CalculateFluxCubeThreads(fParticle,
+                                     Surface,
+                                     FluxContainer,
+                                     Polarization,
+                                     Angle,
+                                     HorizontalDirection,
+                                     PropogationDirection,
+                                     NThreadsToUse,
+                                     Precision,
+                                     MaxLevel,
+                                     MaxLevelExtended,
+                                     1);
+    }
+  } else {
+    // Weight this by the number of particles
+    double const Weight = 1.0 / (double) NParticles;
+
+    // Loop over particles
+    for (int i = 0; i < NParticles; ++i) {
+
+      // Set a new random particle
+      this->SetNewParticle();
+      this->CalculateTrajectory();
+
+      if (NThreadsToUse == 1) {
+        bool Done = false;
+        std::vector<size_t> NotConverged;
+        this->CalculateFluxCubePoints(fParticle,
+                                      Surface,
+                                      FluxContainer,
+                                      0,
+                                      Surface.GetNPoints() - 1,
+                                      0,
+                                      1,
+                                      Done,
+                                      NotConverged,
+                                      Polarization,
+                                      Angle,
+                                      HorizontalDirection,
+                                      PropogationDirection,
+                                      Precision,
+                                      MaxLevel,
+                                      MaxLevelExtended,
+                                      Weight);
+        for (std::vector<size_t>::const_iterator it = NotConverged.begin(); it != NotConverged.end(); ++it) {
+          FluxContainer.SetNotConverged(*it);
+        }
+      } else {
+        this->CalculateFluxCubeThreads(fParticle,
+                                       Surface,
+                                       FluxContainer,
+                                       Polarization,
+                                       Angle,
+                                       HorizontalDirection,
+                                       PropogationDirection,
+                                       NThreadsToUse,
+                                       Precision,
+                                       MaxLevel,
+                                       MaxLevelExtended,
+                                       Weight);
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculateFluxCubePoints (TParticleA& Particle,
+                                        TSurfacePoints const& Surface,
+                                        T4DScalarContainer& FluxContainer,
+                                        size_t const iFirst,
+                                        size_t const iLast,
+                                        size_t const iEnergyFirst,
+                                        size_t const EnergyStride,
+                                        bool& Done,
+                                        std::vector<size_t>& NotConverged,
+                                        std::string const& Polarization,
+                                        double const Angle,
+                                        TVector3D const& HorizontalDirection,
+                                        TVector3D const& PropogationDirection,
+                                        double const Precision,
+                                        int    const MaxLevel,
+                                        int    const MaxLevelExtended,
+                                        double const Weight)
+{
+  // Calculates the single particle flux in a range of points at every energy of the
+  // container in units of [photons / second / 0.001% BW / mm^2].
+  //
+  // The sum is that of CalculateFluxPoints with the Riemann sum.  Everything except the
+  // phase, ie R, N, D, and the near and far field amplitude, depends only on the point
+  // and the trajectory sample, so it is calculated once and used for every energy.
+  // Each energy has its own convergence test and stops being summed when it passes.
+  // Only the energies iEnergyFirst, iEnergyFirst + EnergyStride, ... are calculated.
+  // Points with an energy not converged are added to NotConverged rather than set in
+  // the container, since other threads may calculate other energies of the same point
+
+  // Nothing to do for an empty range (iLast wraps for an empty surface)
+  if (Surface.GetNPoints() == 0 || iLast < iFirst) {
+    Done = true;
+    return;
+  }
+
+  // Check you are not requesting a level above the maximum
+  if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
+    std::cerr << "WARNING: MaxLevel > TParticleA::kMaxTrajectoryLevel.  Setting MaxLevel to TParticleA::kMaxTrajectoryLevel" << std::endl;
+  }
+
+  // Set the level to stop at if requested, but not above the hard limit
+  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
+  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+
+  // Constant C0 for calculation
+  double const C0 = Particle.GetQ() / (TOSCARSSR::FourPi() * TOSCARSSR::C() * TOSCARSSR::Epsilon0() * TOSCARSSR::Sqrt2Pi());
+
+  // Constant for flux calculation at the end
+  double const C2 = TOSCARSSR::FourPi() * Particle.GetCurrent() / (TOSCARSSR::H() * fabs(Particle.GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
+
+  // Imaginary "i" and complxe 1+0i
+  std::complex<double> const I(0, 1);
+
+  // Photon vertical direction and positive and negative helicity
+  TVector3D const VerticalDirection = PropogationDirection.Cross(HorizontalDirection).UnitVector();
+  TVector3DC const Positive = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) + VerticalDirection * I );
+  TVector3DC const Negative = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) - VerticalDirection * I );
+
+  TVector3DC PolarizationVector(0, 0, 0);
+  if (Polarization == "all") {
+    // Do Nothing
+  } else if (Polarization == "linear-horizontal") {
+    PolarizationVector = HorizontalDirection;
+  } else if (Polarization == "linear-vertical") {
+    PolarizationVector = VerticalDirection;
+  } else if (Polarization == "linear") {
+    TVector3D PolarizationAngle = HorizontalDirection;
+    PolarizationAngle.RotateSelf(Angle, PropogationDirection);
+    PolarizationVector = PolarizationAngle;
+  } else if (Polarization == "circular-left") {
+    PolarizationVector = Positive;
+  } else if (Polarization == "circular-right") {
+    PolarizationVector = Negative;
+  } else {
+    // Throw invalid argument if polarization is not recognized
+    throw std::invalid_argument("Polarization requested not recognized");
+  }
+
+  // Angular frequency of each energy
+  size_t const NEnergies = FluxContainer.GetNEnergies();
+  std::vector<double> Omega(NEnergies);
+  for (size_t k = 0; k != NEnergies; ++k) {
+    Omega[k] = TOSCARSSR::EvToAngularFrequency(FluxContainer.GetEnergy(k));
+  }
+
+  // Extended trajectory (not using memory for storage of arrays
+  TParticleTrajectoryInterpolatedPoints TE;
+
+  // Richardson extrapolation across levels of the Riemann sum
+  bool const UseRichardson = fConvergenceMode == kConvergenceMode_Richardson;
+  int  const MinLevel = 8;
+
+  // State of each energy
+  std::vector<TVector3DC> SumE(NEnergies);
+  std::vector< std::vector<TVector3DC> > RombergRow(NEnergies);
+  std::vector<TVector3DC> EndPoints(NEnergies);
+  std::vector<double> LastMag(NEnergies);
+  std::vector<double> LastRawChange(NEnergies);
+  std::vector<int>    LastLevel(NEnergies);
+  std::vector<int>    ThisMinLevel(NEnergies);
+  std::vector<char>   LastLevelPassed(NEnergies);
+  std::vector<int>    Result_Level(NEnergies);
+  std::vector<size_t> Active;
+  std::vector<size_t> StillActive;
+
+  // Converged level of each energy at the previous point in this thread, for warm starting
+  std::vector<int> NeighbourLevel(NEnergies, -1);
+
+  // Positions of this range of points in one call
+  size_t const NThisRange = iLast + 1 - iFirst;
+  std::vector<double> SX(NThisRange);
+  std::vector<double> SY(NThisRange);
+  std::vector<double> SZ(NThisRange);
+  Surface.GetArrays(iFirst, NThisRange, &SX[0], &SY[0], &SZ[0], 0x0, 0x0, 0x0);
+
+  // Loop over all points in the container
+  for (size_t i = iFirst; i <= iLast; ++i) {
+
+    // Obs point
+    TVector3D ObservationPoint(SX[i - iFirst], SY[i - iFirst], SZ[i - iFirst]);
+
+    Active.clear();
+    for (size_t k = iEnergyFirst; k < NEnergies; k += EnergyStride) {
+      SumE[k] = TVector3DC(0, 0, 0);
+      RombergRow[k].clear();
+      EndPoints[k] = UseRichardson ? this->EndPointsField(Particle, ObservationPoint, Omega[k]) : TVector3DC(0, 0, 0);
+      LastMag[k] = -1;
+      LastRawChange[k] = -1;
+      LastLevel[k] = 0;
+      LastLevelPassed[k] = 0;
+      Result_Level[k] = -1;
+
+      ThisMinLevel[k] = MinLevel;
+      if (fWarmStart && NeighbourLevel[k] >= 0) {
+        ThisMinLevel[k] = NeighbourLevel[k] - 2 > kWarmStartMinLevel ? NeighbourLevel[k] - 2 : kWarmStartMinLevel;
+        ThisMinLevel[k] = ThisMinLevel[k] < MinLevel ? ThisMinLevel[k] : MinLevel;
+      }
+      Active.push_back(k);
+    }
+
+    // Time of arrival at the observer, the phase is -Omega times this
+    double LastArrival = -1;
+
+    for (int iLevel = 0; iLevel <= LevelStopWithExtended && !Active.empty(); ++iLevel) {
+
+      // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
+      TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
+      if (iLevel > LevelStopMemory) {
+        TE = Particle.GetTrajectoryExtendedLevel(iLevel);
+      }
+
+      // Number of points in the trajectory
+      size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
+
+      // Largest change in arrival time between samples
+      double MaxDArrival = 0;
+
+      // Loop over trajectory points
+      for (size_t iT = 0; iT != NTPoints; ++iT) {
+
+        TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
+
+        // Get position, Beta, and Acceleration (over c)
+        TVector3D const& X = PP.GetX();
+        TVector3D const& B = PP.GetB();
+        TVector3D const& AoverC = PP.GetAoverC();
+        double    const  Time = iLevel <= LevelStopMemory ? TM.GetT(iT) : TE.GetT(iT);
+
+        // Define R and unit vector in direction of R, and D (distance to observer)
+        TVector3D const R = ObservationPoint - X;
+        TVector3D const N = R.UnitVector();
+        double const D = R.Mag();
+
+        double const Arrival = Time + D / TOSCARSSR::C();
+        if (iT != 0 && fabs(Arrival - LastArrival) > MaxDArrival) {
+          MaxDArrival = fabs(Arrival - LastArrival);
+        }
+        LastArrival = Arrival;
+
+        TVector3D const Amplitude = ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
+            + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ); // NF + FF
+
+        // Add this contribution at each energy still being summed
+        for (std::vector<size_t>::const_iterator it = Active.begin(); it != Active.end(); ++it) {
+          SumE[*it] += Amplitude * std::exp(std::complex<double>(0, -Omega[*it] * Arrival));
+        }
+      }
+
+      // Check each energy for convergence at this level
+      StillActive.clear();
+      for (std::vector<size_t>::const_iterator it = Active.begin(); it != Active.end(); ++it) {
+        size_t const k = *it;
+        LastLevel[k] = iLevel;
+
+        double const MaxDPhase = Omega[k] * MaxDArrival;
+
+        TVector3DC ThisSumE = (UseRichardson ? SumE[k] + EndPoints[k] : SumE[k]) * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
+        if (PolarizationVector.Mag2() > 0.001) {
+          ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
+        }
+
+        bool Asymptotic = false;
+        if (UseRichardson) {
+          // Extrapolate using only the levels which resolve the phase
+          if (MaxDPhase >= TOSCARSSR::Pi()) {
+            RombergRow[k].clear();
+          }
+          // The level sums converge as the trapezoid rule should when the change
+          // between levels shrinks by close to a factor 4
+          double const RawChange = RombergRow[k].empty() ? -1 : (ThisSumE - RombergRow[k][0]).Mag();
+          Asymptotic = RawChange > 0 && 3 * RawChange <= LastRawChange[k] && 6 * RawChange >= LastRawChange[k];
+          LastRawChange[k] = RawChange;
+          ThisSumE = TOMATH::RombergNext(RombergRow[k], ThisSumE, kRichardsonDepth);
+        }
+        double const ThisMag = ThisSumE.Dot( ThisSumE.CC() ).real();
+
+        double Result_Precision = fabs(ThisMag - LastMag[k]) / LastMag[k];
+        if (UseRichardson && RombergRow[k].size() > 1) {
+          // Error estimate from the last two extrapolations of this level.  Until the
+          // level sums converge as the trapezoid rule should it is not less than the
+          // change from the previous level's extrapolated value
+          TVector3DC const& LessExtrapolated = RombergRow[k][RombergRow[k].size() - 2];
+          double const RowPrecision = fabs(ThisMag - LessExtrapolated.Dot( LessExtrapolated.CC() ).real()) / ThisMag;
+          if (Asymptotic || RowPrecision > Result_Precision) {
+            Result_Precision = RowPrecision;
+          }
+        }
+        // Below the usual minimum level the previous level must have passed as well
+        bool const LevelPassed = iLevel > 0 && (!UseRichardson || RombergRow[k].size() > 1) && Result_Precision < Precision && MaxDPhase < TOSCARSSR::Pi();
+        if (LevelPassed && (iLevel > MinLevel || (iLevel > ThisMinLevel[k] && LastLevelPassed[k]))) {
+          Result_Level[k] = iLevel;
+          continue;
+        }
+        LastLevelPassed[k] = LevelPassed;
+
+        LastMag[k] = ThisMag;
+        StillActive.push_back(k);
+      }
+      Active.swap(StillActive);
+    }
+
+    if (!Active.empty()) {
+      NotConverged.push_back(i);
+    }
+
+    for (size_t k = iEnergyFirst; k < NEnergies; k += EnergyStride) {
+      NeighbourLevel[k] = Result_Level[k];
+
+      // Multiply by constant factor
+      TVector3DC ThisSumE;
+      if (UseRichardson && RombergRow[k].size() > 0) {
+        ThisSumE = RombergRow[k].back() * C0;
+      } else {
+        ThisSumE = SumE[k];
+        ThisSumE *= C0 * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel[k]);
+      }
+
+      // Correcr for polarization
+      if (PolarizationVector.Mag2() > 0.001) {
+        ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
+      }
+
+      FluxContainer.AddToPoint(i, k, C2 *  ThisSumE.Dot( ThisSumE.CC() ).real() * Weight);
+    }
+  } // POINTS
+
+  // Set done to true
+  Done = true;
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculateFluxCubeThreads (TParticleA& Particle,
+                                         TSurfacePoints const& Surface,
+                                         T4DScalarContainer& FluxContainer,
+                                         std::string const& Polarization,
+                                         double const Angle,
+                                         TVector3D const& HorizontalDirection,
+                                         TVector3D const& PropogationDirection,
+                                         int const NThreads,
+                                         double const Precision,
+                                         int    const MaxLevel,
+                                         int    const MaxLevelExtended,
+                                         double const Weight)
+{
+  // Calculates the single particle flux cube on a surface with the work split over
+  // threads, see CalculateFluxThreads.  With at least as many points as threads each
+  // thread takes a range of points.  With fewer, eg spectra at a few observers, the
+  // threads are shared out over the points as evenly as possible (at most one per
+  // energy).  The threads of a point take every NGroups-th energy, so that high and
+  // low energies are spread evenly over them
+
+  // Calculate the trajectory only if it doesn't exist yet
+  if (Particle.GetTrajectory().GetNPoints() == 0) {
+    this->CalculateTrajectory(Particle);
+  }
+
+  // Vector for storing threads to rejoin
+  std::vector<std::thread> Threads;
+
+  // Number of points and energies
+  size_t const NPoints = Surface.GetNPoints();
+  size_t const NEnergies = FluxContainer.GetNEnergies();
+
+  // First and last point, first energy, and energy stride of each thread
+  std::vector<size_t> First;
+  std::vector<size_t> Last;
+  std::vector<size_t> EnergyFirst;
+  std::vector<size_t> EnergyStride;
+  if (NPoints >= (size_t) NThreads) {
+    // Number per thread plus remainder to be added to first threads
+    size_t const NPerThread = NPoints / NThreads;
+    size_t const NRemainder = NPoints % NThreads;
+    for (size_t it = 0; it != (size_t) NThreads; ++it) {
+      First.push_back(it < NRemainder ? NPerThread * it + it : NPerThread * it + NRemainder);
+      Last.push_back(it < NRemainder ? First.back() + NPerThread : First.back() + NPerThread - 1);
+      EnergyFirst.push_back(0);
+      EnergyStride.push_back(1);
+    }
+  } else {
+    // The first NThreads % NPoints points get one thread more than the others
+    for (size_t i = 0; i != NPoints; ++i) {
+      size_t NGroups = NThreads / NPoints + (i < NThreads % NPoints ? 1 : 0);
+      NGroups = NGroups < NEnergies ? NGroups : NEnergies;
+      for (size_t iGroup = 0; iGroup != NGroups; ++iGroup) {
+        First.push_back(i);
+        Last.push_back(i);
+        EnergyFirst.push_back(iGroup);
+        EnergyStride.push_back(NGroups);
+      }
+    }
+  }
+
+  // How many threads to start in the first for loop
+  size_t const NThreadsActual = First.size();
+
+  // Keep track of which threads are finished and re-joined
+  bool *Done = new bool[NThreadsActual];
+  bool *Joined = new bool[NThreadsActual];
+
+  // Points not converged in each thread.  Threads may share a point, so these are only
+  // set in the container once all threads are joined
+  std::vector< std::vector<size_t> > NotConverged(NThreadsActual);
+
+  // Start threads and keep in vector
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+
+    // Set Done and joined to false for this thread
+    Done[it] = false;
+    Joined[it] = false;
+
+    // Start thread for these points
+    Threads.push_back(std::thread(&OSCARSSR::CalculateFluxCubePoints,
+                                  this,
+                                  std::ref(Particle),
+                                  std::ref(Surface),
+                                  std::ref(FluxContainer),
+                                  First[it],
+                                  Last[it],
+                                  EnergyFirst[it],
+                                  EnergyStride[it],
+                                  std::ref(Done[it]),
+                                  std::ref(NotConverged[it]),
+                                  Polarization,
+                                  Angle,
+                                  HorizontalDirection,
+                                  PropogationDirection,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  Weight));
+  }
+
+  // Are all of the threads finished or not?  Continue loop until all come back.
+  bool AllThreadsFinished = false;
+  size_t NThreadsFinished = 0;
+  while (!AllThreadsFinished) {
+
+    // So as to not use the current thread at 100%
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // Check all threads
+    for (size_t it = 0; it != NThreadsActual; ++it) {
+
+      if (Done[it] && !Joined[it]) {
+        Threads[it].join();
+        Joined[it] = true;
+        ++NThreadsFinished;
+      }
+    }
+
+    // If the number finished is equal to the number of points total then we're done
+    if (NThreadsFinished == NThreadsActual) {
+      AllThreadsFinished = true;
+    }
+  }
+
+  // Clear all threads
+  Threads.clear();
+
+  // Mark the points not converged in any thread
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    for (std::vector<size_t>::const_iterator i = NotConverged[it].begin(); i != NotConverged[it].end(); ++i) {
+      FluxContainer.SetNotConverged(*i);
+    }
+  }
+
+  // Delete my arrays, I hate new for this purpose
+  delete [] Done;
+  delete [] Joined;
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateFluxGPU (TSurfacePoints const& Surface,
+                                 double const Energy_eV,
+                                 T3DScalarContainer& FluxContainer,
+                                 std::string const& Polarization,
+                                 double const Angle,
+                                 TVector3D const& HorizontalDirection,
+                                 TVector3D const& PropogationDirection,
+                                 int const NParticles,
+                                 std::vector<int> GPUVector,
+                                 double const Precision,
+                                 int    const MaxLevel,
+                                 int    const MaxLevelExtended,
+                                 int    const ReturnQuantity)
+{
+  // If you compile for Cuda use the GPU in this function, else throw
+
+  // If GPUVector is empty assume you want to use ALL GPUs available
+  if (GPUVector.size() == 0) {
+    int const NGPUAvailable = this->CheckGPU();
+    for (int i = 0; i < NGPUAvailable; ++i) {
+      GPUVector.push_back(i);
+    }
+  }
+
+  #ifdef CUDA
+  // Check that the GPU exists
+  if (this->CheckGPU() < 1) {
+    throw std::invalid_argument("You are requesting the GPU, but none were found");
+  }
+
+  // Set the level to stop at if requested, but not above the hard limit
+  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
+  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+
+  return OSCARSSR_Cuda_CalculateFluxGPU (*this,
+                                         Surface,
+                                         Energy_eV,
+                                         FluxContainer,
+                                         Polarization,
+                                         Angle,
+                                         HorizontalDirection,
+                                         PropogationDirection,
+                                         NParticles,
+                                         GPUVector,
+                                         Precision,
+                                         LevelStopWithExtended,
+                                         ReturnQuantity);
+  #else
+  throw std::invalid_argument("GPU functionality not compiled into this binary distribution");
+  #endif
+
+  return;
+}
+
+
+
+
+
+void OSCARSSR::CalculateFluxConvolution (TSurfacePoints_Rectangle const& Surface,
+                                         double const Energy_eV,
+                                         T3DScalarContainer& FluxContainer,
+                                         std::string const& Polarization,
+                                         double const Angle,
+                                         TVector3D const& HorizontalDirection,
+                                         TVector3D const& PropogationDirection,
+                                         int const NThreads,
+                                         int const GPU,
+                                         int const NGPU,
+                                         std::vector<int> VGPU,
+                                         double const Precision,
+                                         int    const MaxLevel,
+                                         int    const MaxLevelExtended,
+                                         int    const Dimension,
+                                         int    const ReturnQuantity)
+{
+  // Calculate the flux on a rectangle for a beam with emittance by calculating the
+  // single (ideal) particle flux on a padded rectangle and convolving it with the
+  // gaussian beam profile projected onto the rectangle.  This replaces the multi-particle
+  // calculation for gaussian beams where the single particle pattern is simply displaced
+  // by the offset and angle of each particle.  Energy spread is not included here.
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  // Projected beam size and padding needed
+  TVector2D Sigma;
+  int NPadX1;
+  int NPadX2;
+  this->GetBeamConvolutionParameters(Surface, Sigma, NPadX1, NPadX2);
+
+  // Padded rectangle for the filament calculation
+  TSurfacePoints_Rectangle Padded;
+  Surface.GetPadded(NPadX1, NPadX2, Padded);
+
+  // Ideal particle from the beam
+  this->SetNewParticle("", "ideal");
+  this->CalculateTrajectory();
+
+  // Filament flux on the padded rectangle
+  T3DScalarContainer PaddedContainer;
+  this->CalculateFlux(Padded,
+                      Energy_eV,
+                      PaddedContainer,
+                      Polarization,
+                      Angle,
+                      HorizontalDirection,
+                      PropogationDirection,
+                      0,
+                      NThreads,
+                      GPU,
+                      NGPU,
+                      VGPU,
+                      Precision,
+                      MaxLevel,
+                      MaxLevelExtended,
+                      3,
+                      ReturnQuantity);
+
+  // Convolve into the output container
+  FluxContainer.Clear();
+  this->ConvolveRectangle(Surface, PaddedContainer, FluxContainer, Sigma, NPadX1, NPadX2, Dimension, ReturnQuantity);
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculatePowerDensityConvolution (TSurfacePoints_Rectangle const& Surface,
+                                                 T3DScalarContainer& PowerDensityContainer,
+                                                 int const Dimension,
+                                                 bool const Directional,
+                                                 double const Precision,
+                                                 int    const MaxLevel,
+                                                 int    const MaxLevelExtended,
+                                                 int const NThreads,
+                                                 int const GPU,
+                                                 int const NGPU,
+                                                 std::vector<int> VGPU,
+                                                 int const ReturnQuantity)
+{
+  // Calculate the power density on a rectangle for a beam with emittance by convolution
+  // of the single (ideal) particle power density on a padded rectangle with the gaussian
+  // beam profile projected onto the rectangle.  See CalculateFluxConvolution
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  // Projected beam size and padding needed
+  TVector2D Sigma;
+  int NPadX1;
+  int NPadX2;
+  this->GetBeamConvolutionParameters(Surface, Sigma, NPadX1, NPadX2);
+
+  // Padded rectangle for the filament calculation
+  TSurfacePoints_Rectangle Padded;
+  Surface.GetPadded(NPadX1, NPadX2, Padded);
+
+  // Ideal particle from the beam
+  this->SetNewParticle("", "ideal");
+  this->CalculateTrajectory();
+
+  // Filament power density on the padded rectangle
+  T3DScalarContainer PaddedContainer;
+  this->CalculatePowerDensity(Padded,
+                              PaddedContainer,
+                              3,
+                              Directional,
+                              Precision,
+                              MaxLevel,
+                              MaxLevelExtended,
+                              0,
+                              NThreads,
+                              GPU,
+                              NGPU,
+                              VGPU,
                               ReturnQuantity);
-        } else {
-          this->CalculateFluxThreads(fParticle,
-                                     Surface,
-                                     Energy_eV,
-                                     FluxContainer,
-                                     Polarization,
-                                     Angle,
-                                     HorizontalDirection,
-                                     PropogationDirection,
-                                     NThreadsToUse,
-                                     Precision,
-                                     MaxLevel,
-                                     MaxLevelExtended,
-                                     Weight,
-                                     ReturnQuantity);
-        }
-      }
-    }
-  }
 
+  // Convolve into the output container
+  PowerDensityContainer.Clear();
+  this->ConvolveRectangle(Surface, PaddedContainer, PowerDensityContainer, Sigma, NPadX1, NPadX2, Dimension, ReturnQuantity);
 
   return;
 }
@@ -2736,201 +5838,459 @@ void OSCARSSR::CalculateFlux (TSurfacePoints const& Surface,
 
 
 
+void OSCARSSR::DrawEnsemble (int const NParticles,
+                             int const GPU,
+                             std::vector<TParticleA>& Ensemble)
+{
+  // Draw NParticles random particles, without trajectories, to be used for several
+  // calculations.  These run on the cpu
 
+  Ensemble.clear();
+  if (NParticles <= 0) {
+    return;
+  }
 
-void OSCARSSR::CalculateFluxPoints (TParticleA& Particle,
-                                    TSurfacePoints const& Surface,
-                                    double const Energy_eV,
-                                    T3DScalarContainer& FluxContainer,
-                                    size_t const iFirst,
-                                    size_t const iLast,
-                                    bool& Done,
-                                    std::string const& Polarization,
-                                    double const Angle,
-                                    TVector3D const& HorizontalDirection,
-                                    TVector3D const& PropogationDirection,
-                                    double const Precision,
-                                    int    const MaxLevel,
-                                    int    const MaxLevelExtended,
-                                    double const Weight,
-                                    int    const ReturnQuantity)
+  if (GPU == 1) {
+    std::cerr << "WARNING: a fixed ensemble of particles is calculated on the cpu" << std::endl;
+  }
+
+  fLastCalculationPath = "numerical";
+
+  Ensemble.reserve(NParticles);
+  for (int i = 0; i < NParticles; ++i) {
+    try {
+      this->SetNewParticle();
+    } catch (std::exception e) {
+      throw std::out_of_range("no beam defined");
+    }
+    Ensemble.push_back(fParticle);
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSSR::CalculateFluxAdaptive (TSurfacePoints_Rectangle const& Surface,
+                                      TSurfaceQuadtree& Tree,
+                                      double const Tolerance,
+                                      int const MaxDepth,
+                                      double const Energy_eV,
+                                      std::string const& Polarization,
+                                      double const Angle,
+                                      TVector3D const& HorizontalDirection,
+                                      TVector3D const& PropogationDirection,
+                                      int const NParticles,
+                                      int const NThreads,
+                                      int const GPU,
+                                      int const NGPU,
+                                      std::vector<int> VGPU,
+                                      double const Precision,
+                                      int    const MaxLevel,
+                                      int    const MaxLevelExtended,
+                                      int    const ReturnQuantity)
 {
-  // Calculates the single particle flux at a given observation point
-  // in units of [photons / second / 0.001% BW / mm^2]
+  // Calculate the flux on the coarse grid of Surface and refine the cells where the
+  // flux is not well described by bilinear interpolation of the corners, to a relative
+  // Tolerance of the largest value.  Each round of new points is calculated as one
+  // surface so that threads or gpus are used as for any other surface.  The result is
+  // left in Tree.
   //
-  // Particle - the Particle.. with a Trajectory structure hopefully
+  // With NParticles the ensemble is drawn once and every round uses the same particles
+  // (on the cpu).  A new ensemble each round would add the Monte Carlo noise between
+  // ensembles to the difference between the points of different rounds, and refine on
+  // it.
 
-  // Check number of points
-  //if (NTPoints < 1) {
-  //  throw std::length_error("no points in trajectory.  Is particle or beam defined?");
-  //}
+  std::vector<TParticleA> Ensemble;
+  this->DrawEnsemble(NParticles, GPU, Ensemble);
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
 
-  // Check you are not requesting a level above the maximum
-  if (MaxLevel > TParticleA::kMaxTrajectoryLevel) {
-    std::cerr << "WARNING: MaxLevel > TParticleA::kMaxTrajectoryLevel.  Setting MaxLevel to TParticleA::kMaxTrajectoryLevel" << std::endl;
-  }
+  Tree.Init(Surface, MaxDepth);
+
+  do {
+    TSurfacePoints_3D Points;
+    Tree.GetPending(Points);
+
+    T3DScalarContainer Container;
+    if (Ensemble.empty()) {
+      this->CalculateFlux(Points,
+                          Energy_eV,
+                          Container,
+                          Polarization,
+                          Angle,
+                          HorizontalDirection,
+                          PropogationDirection,
+                          0,
+                          NThreads,
+                          GPU,
+                          NGPU,
+                          VGPU,
+                          Precision,
+                          MaxLevel,
+                          MaxLevelExtended,
+                          3,
+                          ReturnQuantity);
+    } else {
+      for (size_t i = 0; i != Points.GetNPoints(); ++i) {
+        Container.AddPoint(Points.GetPoint(i).GetPoint(), 0);
+      }
+      for (size_t iParticle = 0; iParticle != Ensemble.size(); ++iParticle) {
+        fParticle = Ensemble[iParticle];
+        this->CalculateTrajectory();
+        this->CalculateFluxThreads(fParticle,
+                                   Points,
+                                   Energy_eV,
+                                   Container,
+                                   Polarization,
+                                   Angle,
+                                   HorizontalDirection,
+                                   PropogationDirection,
+                                   NThreadsToUse,
+                                   Precision,
+                                   MaxLevel,
+                                   MaxLevelExtended,
+                                   1.0 / (double) Ensemble.size(),
+                                   ReturnQuantity);
+      }
+    }
+    Tree.SetPending(Container);
+  } while (Tree.Refine(Tolerance) > 0);
 
-  // Set the level to stop at if requested, but not above the hard limit
-  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
-  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+  return;
+}
 
-  // Constant C0 for calculation
-  double const C0 = Particle.GetQ() / (TOSCARSSR::FourPi() * TOSCARSSR::C() * TOSCARSSR::Epsilon0() * TOSCARSSR::Sqrt2Pi());
 
-  // Constant for flux calculation at the end
-  double const C2 = TOSCARSSR::FourPi() * Particle.GetCurrent() / (TOSCARSSR::H() * fabs(Particle.GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
 
-  // Imaginary "i" and complxe 1+0i
-  std::complex<double> const I(0, 1);
-  std::complex<double> const One(1, 0);
 
-  // Photon vertical direction and positive and negative helicity
-  TVector3D const VerticalDirection = PropogationDirection.Cross(HorizontalDirection).UnitVector();
-  TVector3DC const Positive = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) + VerticalDirection * I );
-  TVector3DC const Negative = 1. / sqrt(2) * (TVector3DC(HorizontalDirection) - VerticalDirection * I );
+void OSCARSSR::CalculatePowerDensityAdaptive (TSurfacePoints_Rectangle const& Surface,
+                                              TSurfaceQuadtree& Tree,
+                                              double const Tolerance,
+                                              int const MaxDepth,
+                                              bool const Directional,
+                                              double const Precision,
+                                              int    const MaxLevel,
+                                              int    const MaxLevelExtended,
+                                              int const NParticles,
+                                              int const NThreads,
+                                              int const GPU,
+                                              int const NGPU,
+                                              std::vector<int> VGPU,
+                                              int const ReturnQuantity)
+{
+  // Calculate the power density on the coarse grid of Surface and refine adaptively.
+  // See CalculateFluxAdaptive
 
-  TVector3DC PolarizationVector(0, 0, 0);
-  if (Polarization == "all") {
-    // Do Nothing
-  } else if (Polarization == "linear-horizontal") {
-    PolarizationVector = HorizontalDirection;
-  } else if (Polarization == "linear-vertical") {
-    PolarizationVector = VerticalDirection;
-  } else if (Polarization == "linear") {
-    TVector3D PolarizationAngle = HorizontalDirection;
-    PolarizationAngle.RotateSelf(Angle, PropogationDirection);
-    PolarizationVector = PolarizationAngle;
-  } else if (Polarization == "circular-left") {
-    PolarizationVector = Positive;
-  } else if (Polarization == "circular-right") {
-    PolarizationVector = Negative;
-  } else {
-    // Throw invalid argument if polarization is not recognized
-    throw std::invalid_argument("Polarization requested not recognized");
+  std::vector<TParticleA> Ensemble;
+  this->DrawEnsemble(NParticles, GPU, Ensemble);
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+
+  Tree.Init(Surface, MaxDepth);
+
+  do {
+    TSurfacePoints_3D Points;
+    Tree.GetPending(Points);
+
+    T3DScalarContainer Container;
+    if (Ensemble.empty()) {
+      this->CalculatePowerDensity(Points,
+                                  Container,
+                                  3,
+                                  Directional,
+                                  Precision,
+                                  MaxLevel,
+                                  MaxLevelExtended,
+                                  0,
+                                  NThreads,
+                                  GPU,
+                                  NGPU,
+                                  VGPU,
+                                  ReturnQuantity);
+    } else {
+      for (size_t i = 0; i != Points.GetNPoints(); ++i) {
+        Container.AddPoint(Points.GetPoint(i).GetPoint(), 0);
+      }
+      for (size_t iParticle = 0; iParticle != Ensemble.size(); ++iParticle) {
+        fParticle = Ensemble[iParticle];
+        this->CalculateTrajectory();
+        this->CalculatePowerDensityThreads(fParticle,
+                                           Points,
+                                           Container,
+                                           NThreadsToUse,
+                                           Directional,
+                                           Precision,
+                                           MaxLevel,
+                                           MaxLevelExtended,
+                                           1.0 / (double) Ensemble.size(),
+                                           ReturnQuantity);
+      }
+    }
+    Tree.SetPending(Container);
+  } while (Tree.Refine(Tolerance) > 0);
+
+  return;
+}
+
+
+
+
+int OSCARSSR::CalculateFluxSymmetric (TSurfacePoints_Rectangle const& Surface,
+                                     int const Symmetry,
+                                     double const Energy_eV,
+                                     T3DScalarContainer& FluxContainer,
+                                     std::string const& Polarization,
+                                     double const Angle,
+                                     TVector3D const& HorizontalDirection,
+                                     TVector3D const& PropogationDirection,
+                                     int const NParticles,
+                                     int const NThreads,
+                                     int const GPU,
+                                     int const NGPU,
+                                     std::vector<int> VGPU,
+                                     double const Precision,
+                                     int    const MaxLevel,
+                                     int    const MaxLevelExtended,
+                                     int    const Dimension,
+                                     int    const ReturnQuantity)
+{
+  // Calculate the flux on the fundamental half or quadrant of the rectangle and mirror
+  // it about the centre lines in X1 and/or X2.  For kSymmetry_Auto the symmetry is
+  // taken from a few points and their mirror images calculated with the ideal
+  // particle, which must agree to within kSymmetryTolerance of the largest of them.
+  // Circular polarizations change hand under reflection, so only kSymmetry_Auto,
+  // which checks the values themselves, is allowed for them.  Returns the symmetry
+  // used.
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
   }
 
+  int Mask = Symmetry;
+  if (Symmetry == kSymmetry_Auto) {
+    TSurfacePoints_3D Sample;
+    T3DScalarContainer SampleContainer;
+    this->GetSymmetrySample(Surface, Sample);
+    this->CalculateFlux(Sample, Energy_eV, SampleContainer, Polarization, Angle, HorizontalDirection, PropogationDirection, 0, NThreads, GPU, NGPU, VGPU, Precision, MaxLevel, MaxLevelExtended, 3, 0);
+    Mask = this->CheckSymmetrySample(Surface, SampleContainer, kSymmetryTolerance);
+  } else if (Symmetry < kSymmetry_None || Symmetry > kSymmetry_X1X2) {
+    throw std::invalid_argument("symmetry must be none, x1, x2, x1x2, or auto");
+  } else if (Symmetry != kSymmetry_None && (Polarization == "circular-left" || Polarization == "circular-right")) {
+    throw std::invalid_argument("circular polarization changes hand under reflection.  Use symmetry auto or none");
+  }
 
-  // Angular frequency
-  double const Omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);;
+  TSurfacePoints_3D Points;
+  std::vector<size_t> Index;
+  this->GetSymmetryPoints(Surface, Mask, Points, Index);
 
-  // Extended trajectory (not using memory for storage of arrays
-  TParticleTrajectoryInterpolatedPoints TE;
+  T3DScalarContainer Fundamental;
+  this->CalculateFlux(Points,
+                      Energy_eV,
+                      Fundamental,
+                      Polarization,
+                      Angle,
+                      HorizontalDirection,
+                      PropogationDirection,
+                      NParticles,
+                      NThreads,
+                      GPU,
+                      NGPU,
+                      VGPU,
+                      Precision,
+                      MaxLevel,
+                      MaxLevelExtended,
+                      3,
+                      ReturnQuantity);
 
-  // Alternative outputs
-  double Result_Precision = -1;
-  int    Result_Level     = -1;
+  FluxContainer.Clear();
+  this->FillSymmetric(Surface, Fundamental, Index, FluxContainer, Dimension);
 
-  // Loop over all points in the spectrum container
-  for (size_t i = iFirst; i <= iLast; ++i) {
+  fLastCalculationPath += std::string(" (symmetry: ") + ((Mask & kSymmetry_X1) ? "x1" : "") + ((Mask & kSymmetry_X2) ? "x2" : "") + (Mask == kSymmetry_None ? "none" : "") + ")";
 
-    // Obs point
-    TVector3D ObservationPoint = Surface.GetPoint(i).GetPoint();
+  return Mask;
+}
 
-    // Electric field summation in frequency space
-    TVector3DC SumE(0, 0, 0);
 
-    double ThisMag = -1;
-    double LastMag = -1;
-    double ThisPhase = -1;
-    double LastPhase = -1;
-    double MaxDPhase = 0;
-    int    LastLevel = 0;
 
-    bool PhaseSatisfied = true;
-    for (int iLevel = 0; iLevel <= LevelStopWithExtended; ++iLevel) {
-      LastLevel = iLevel;
 
-      // Grab the Trajectory (using memory arrays) if below level threshold, else set NULL
-      TParticleTrajectoryPoints const& TM = Particle.GetTrajectoryLevel(iLevel <= LevelStopMemory ? iLevel : 0);
-      if (iLevel > LevelStopMemory) {
-        TE = Particle.GetTrajectoryExtendedLevel(iLevel);
-      }
+int OSCARSSR::CalculatePowerDensitySymmetric (TSurfacePoints_Rectangle const& Surface,
+                                             int const Symmetry,
+                                             T3DScalarContainer& PowerDensityContainer,
+                                             int const Dimension,
+                                             bool const Directional,
+                                             double const Precision,
+                                             int    const MaxLevel,
+                                             int    const MaxLevelExtended,
+                                             int const NParticles,
+                                             int const NThreads,
+                                             int const GPU,
+                                             int const NGPU,
+                                             std::vector<int> VGPU,
+                                             int const ReturnQuantity)
+{
+  // Calculate the power density on the fundamental half or quadrant of the rectangle
+  // and mirror it.  See CalculateFluxSymmetric
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  int Mask = Symmetry;
+  if (Symmetry == kSymmetry_Auto) {
+    TSurfacePoints_3D Sample;
+    T3DScalarContainer SampleContainer;
+    this->GetSymmetrySample(Surface, Sample);
+    this->CalculatePowerDensity(Sample, SampleContainer, 3, Directional, Precision, MaxLevel, MaxLevelExtended, 0, NThreads, GPU, NGPU, VGPU, 0);
+    Mask = this->CheckSymmetrySample(Surface, SampleContainer, kSymmetryTolerance);
+  } else if (Symmetry < kSymmetry_None || Symmetry > kSymmetry_X1X2) {
+    throw std::invalid_argument("symmetry must be none, x1, x2, x1x2, or auto");
+  }
+
+  TSurfacePoints_3D Points;
+  std::vector<size_t> Index;
+  this->GetSymmetryPoints(Surface, Mask, Points, Index);
+
+  T3DScalarContainer Fundamental;
+  this->CalculatePowerDensity(Points,
+                              Fundamental,
+                              3,
+                              Directional,
+                              Precision,
+                              MaxLevel,
+                              MaxLevelExtended,
+                              NParticles,
+                              NThreads,
+                              GPU,
+                              NGPU,
+                              VGPU,
+                              ReturnQuantity);
+
+  PowerDensityContainer.Clear();
+  this->FillSymmetric(Surface, Fundamental, Index, PowerDensityContainer, Dimension);
+
+  fLastCalculationPath += std::string(" (symmetry: ") + ((Mask & kSymmetry_X1) ? "x1" : "") + ((Mask & kSymmetry_X2) ? "x2" : "") + (Mask == kSymmetry_None ? "none" : "") + ")";
 
-      // Number of points in the trajectory
-      size_t const NTPoints = iLevel <= LevelStopMemory ? TM.GetNPoints() : TE.GetNPoints();
+  return Mask;
+}
 
 
-      MaxDPhase = 0;
-      // Loop over trajectory points
-      for (int iT = 0; iT != NTPoints; ++iT) {
 
-        TParticleTrajectoryPoint const& PP = (iLevel <= LevelStopMemory ? TM.GetPoint(iT) : TE.GetTrajectoryPoint(iT));
 
-        // Get position, Beta, and Acceleration (over c)
-        TVector3D const& X = PP.GetX();
-        TVector3D const& B = PP.GetB();
-        TVector3D const& AoverC = PP.GetAoverC();
-        double    const  Time = iLevel <= LevelStopMemory ? TM.GetT(iT) : TE.GetT(iT);
+void OSCARSSR::GetSymmetrySample (TSurfacePoints_Rectangle const& Surface,
+                                  TSurfacePoints_3D& Sample) const
+{
+  // Points spread over the lower quadrant of the rectangle, each followed by its
+  // mirror images in X1 and in X2
+
+  int const NX1 = Surface.GetNX1();
+  int const NX2 = Surface.GetNX2();
+  int const K = kSymmetrySamples;
+
+  for (int k = 0; k != K; ++k) {
+    int const i1 = ((2 * k + 1) * (NX1 / 2)) / (2 * K);
+    int const i2 = ((2 * (K - 1 - k) + 1) * (NX2 / 2)) / (2 * K);
+
+    TSurfacePoint const P  = Surface.GetPoint(i1 * NX2 + i2);
+    TSurfacePoint const M1 = Surface.GetPoint((NX1 - 1 - i1) * NX2 + i2);
+    TSurfacePoint const M2 = Surface.GetPoint(i1 * NX2 + (NX2 - 1 - i2));
+    Sample.AddPoint(P.GetPoint(),  P.GetNormal());
+    Sample.AddPoint(M1.GetPoint(), M1.GetNormal());
+    Sample.AddPoint(M2.GetPoint(), M2.GetNormal());
+  }
 
+  return;
+}
 
-        // Define R and unit vector in direction of R, and D (distance to observer)
-        TVector3D const R = ObservationPoint - X;
-        TVector3D const N = R.UnitVector();
-        double const D = R.Mag();
 
-        // Exponent in transformed field
-        ThisPhase = -Omega * (Time + D / TOSCARSSR::C());
-        double const PhaseTestValue = fabs(ThisPhase - LastPhase);
-        if (iT != 0 && PhaseTestValue > MaxDPhase) {
-          MaxDPhase = PhaseTestValue;
-        }
-        LastPhase = ThisPhase;
-        std::complex<double> Exponent(0, ThisPhase);
 
-        TVector3DC const ThisEw = ( ( (1 - (B).Mag2()) * (N - B) ) / ( D * D * (pow(1 - N.Dot(B), 2)) )
-            + ( N.Cross( (N - B).Cross(AoverC) ) ) / ( D * pow(1 - N.Dot(B), 2) ) ) * std::exp(Exponent); // NF + FF
 
-        // Add this contribution
-        SumE += ThisEw;
+int OSCARSSR::CheckSymmetrySample (TSurfacePoints_Rectangle const& Surface,
+                                   T3DScalarContainer const& Sample,
+                                   double const Tolerance) const
+{
+  // Symmetry for which the sample from GetSymmetrySample agrees with its mirror
+  // images to within Tolerance of the largest value.  None if the sample is all zero.
+
+  double Max = 0;
+  double Difference1 = 0;
+  double Difference2 = 0;
+  for (size_t i = 0; i + 2 < Sample.GetNPoints(); i += 3) {
+    double const V  = Sample.GetPoint(i).GetV();
+    double const V1 = Sample.GetPoint(i + 1).GetV();
+    double const V2 = Sample.GetPoint(i + 2).GetV();
+    Max = std::max(Max, std::max(fabs(V), std::max(fabs(V1), fabs(V2))));
+    Difference1 = std::max(Difference1, fabs(V1 - V));
+    Difference2 = std::max(Difference2, fabs(V2 - V));
+  }
 
-      }
+  int Mask = kSymmetry_None;
+  if (Max > 0 && Surface.GetNX1() > 1 && Difference1 <= Tolerance * Max) {
+    Mask |= kSymmetry_X1;
+  }
+  if (Max > 0 && Surface.GetNX2() > 1 && Difference2 <= Tolerance * Max) {
+    Mask |= kSymmetry_X2;
+  }
+
+  return Mask;
+}
 
-      TVector3DC ThisSumE = SumE * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(iLevel);
-      if (PolarizationVector.Mag2() > 0.001) {
-        ThisSumE = ThisSumE.Dot(PolarizationVector) * PolarizationVector;
-      }
 
-      ThisMag = ThisSumE.Dot( ThisSumE.CC() ).real();
 
-      Result_Precision = fabs(ThisMag - LastMag) / LastMag;
-      if (iLevel > 8 && Result_Precision < Precision && MaxDPhase < TOSCARSSR::Pi()) {
-        Result_Level = iLevel;
-        break;
-      }
 
-      LastMag = ThisMag;
+void OSCARSSR::GetSymmetryPoints (TSurfacePoints_Rectangle const& Surface,
+                                  int const Symmetry,
+                                  TSurfacePoints_3D& Points,
+                                  std::vector<size_t>& Index) const
+{
+  // The points of the fundamental region for Symmetry (the first half of the points
+  // in each mirrored direction, including the centre line) and for every point of the
+  // rectangle the index of the point in Points it takes its value from
+
+  int const NX1 = Surface.GetNX1();
+  int const NX2 = Surface.GetNX2();
+  int const NF1 = (Symmetry & kSymmetry_X1) ? (NX1 + 1) / 2 : NX1;
+  int const NF2 = (Symmetry & kSymmetry_X2) ? (NX2 + 1) / 2 : NX2;
+
+  for (int i1 = 0; i1 != NF1; ++i1) {
+    for (int i2 = 0; i2 != NF2; ++i2) {
+      TSurfacePoint const P = Surface.GetPoint(i1 * NX2 + i2);
+      Points.AddPoint(P.GetPoint(), P.GetNormal());
     }
+  }
 
-    if (Result_Level == -1) {
-      FluxContainer.SetNotConverged(i);
+  Index.resize(Surface.GetNPoints());
+  for (int i1 = 0; i1 != NX1; ++i1) {
+    int const j1 = i1 < NF1 ? i1 : NX1 - 1 - i1;
+    for (int i2 = 0; i2 != NX2; ++i2) {
+      int const j2 = i2 < NF2 ? i2 : NX2 - 1 - i2;
+      Index[i1 * NX2 + i2] = (size_t) (j1 * NF2 + j2);
     }
+  }
 
+  return;
+}
 
-    // Multiply by constant factor
-    SumE *= C0 * Particle.GetTrajectoryInterpolated().GetDeltaTInclusiveToLevel(LastLevel);
 
-    // Correcr for polarization
-    if (PolarizationVector.Mag2() > 0.001) {
-      SumE = SumE.Dot(PolarizationVector) * PolarizationVector;
-    }
 
 
-    // Add to container
-    switch (ReturnQuantity) {
-      case 1:
-        FluxContainer.AddToPoint(i, Result_Precision * Weight);
-        break;
-      case 2:
-        FluxContainer.AddToPoint(i, ((double) Result_Level) * Weight);
-        break;
-      default:
-        FluxContainer.AddToPoint(i, C2 *  SumE.Dot( SumE.CC() ).real() * Weight);
-        break;
-    }
-  } // POINTS
+void OSCARSSR::FillSymmetric (TSurfacePoints_Rectangle const& Surface,
+                              T3DScalarContainer const& Fundamental,
+                              std::vector<size_t> const& Index,
+                              T3DScalarContainer& Container,
+                              int const Dimension) const
+{
+  // Fill Container with a value for every point of the rectangle from the fundamental
+  // region
 
-  // Set done to true
-  Done = true;
+  for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+    if (Dimension == 3) {
+      Container.AddPoint(Surface.GetPoint(i).GetPoint(), Fundamental.GetPoint(Index[i]).GetV());
+    } else {
+      Container.AddPoint(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), Fundamental.GetPoint(Index[i]).GetV());
+    }
+    if (!Fundamental.IsConverged(Index[i])) {
+      Container.SetNotConverged(i);
+    }
+  }
 
   return;
 }
@@ -2938,111 +6298,190 @@ void OSCARSSR::CalculateFluxPoints (TParticleA& Particle,
 
 
 
-
-void OSCARSSR::CalculateFluxThreads (TParticleA& Particle,
-                                     TSurfacePoints const& Surface,
-                                     double const Energy_eV,
-                                     T3DScalarContainer& FluxContainer,
-                                     std::string const& Polarization,
-                                     double const Angle,
-                                     TVector3D const& HorizontalDirection,
-                                     TVector3D const& PropogationDirection,
-                                     int const NThreads,
-                                     double const Precision,
-                                     int    const MaxLevel,
-                                     int    const MaxLevelExtended,
-                                     double const Weight,
-                                     int    const ReturnQuantity)
+void OSCARSSR::CalculateSpectrumAperture (TApertureCubature& Aperture,
+                                          double const Tolerance,
+                                          TSpectrumContainer& Spectrum,
+                                          std::string const& Polarization,
+                                          double const Angle,
+                                          TVector3D const& HorizontalDirection,
+                                          TVector3D const& PropogationDirection,
+                                          int const NParticles,
+                                          int const NThreads,
+                                          int const GPU,
+                                          int const NGPU,
+                                          std::vector<int> VGPU,
+                                          double const Precision,
+                                          int    const MaxLevel,
+                                          int    const MaxLevelExtended)
 {
-  // Calculates the single particle flux on a surface
-  // in units of [photons / second / 0.001% BW / mm^2]
+  // Flux through the (already initialized) Aperture at each energy of Spectrum in units
+  // of [photons / second / 0.1% BW].  The full spectrum is calculated at each point of
+  // the cubature, so all energies share the points, and the cells of the aperture are
+  // refined until every energy meets the relative Tolerance.  The result replaces the
+  // flux in Spectrum.
   //
-  // Surface - Observation Point
+  // With NParticles the ensemble is drawn once and used at every point, on the cpu.
+  // Each round calculates the trajectory of each particle once for all of its new
+  // points.  A new ensemble at every point would put Monte Carlo noise between
+  // neighbouring points into the error estimate of the cubature.
+
+  size_t const NEnergies = Spectrum.GetNPoints();
+  std::vector<double> Energies(NEnergies);
+  for (size_t i = 0; i != NEnergies; ++i) {
+    Energies[i] = Spectrum.GetEnergy(i);
+  }
 
-  // Calculate the trajectory only if it doesn't exist yet
-  if (Particle.GetTrajectory().GetNPoints() == 0) {
-    this->CalculateTrajectory(Particle);
+  std::vector<char> NotConverged(NEnergies, 0);
+
+  std::vector<TParticleA> Ensemble;
+  this->DrawEnsemble(NParticles, GPU, Ensemble);
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+
+  do {
+    std::vector<TVector3D> Points;
+    Aperture.GetPending(Points);
+
+    std::vector<TSpectrumContainer> Spectra(Points.size(), TSpectrumContainer(Energies));
+    if (Ensemble.empty()) {
+      for (size_t i = 0; i != Points.size(); ++i) {
+        this->CalculateSpectrum(Points[i],
+                                Spectra[i],
+                                Polarization,
+                                Angle,
+                                HorizontalDirection,
+                                PropogationDirection,
+                                0,
+                                NThreads,
+                                GPU,
+                                NGPU,
+                                VGPU,
+                                Precision,
+                                MaxLevel,
+                                MaxLevelExtended,
+                                0);
+      }
+    } else {
+      double const Weight = 1.0 / (double) Ensemble.size();
+      for (size_t iParticle = 0; iParticle != Ensemble.size(); ++iParticle) {
+        fParticle = Ensemble[iParticle];
+        this->CalculateTrajectory();
+        for (size_t i = 0; i != Points.size(); ++i) {
+          if (NThreadsToUse == 1) {
+            this->CalculateSpectrum(fParticle,
+                                    Points[i],
+                                    Spectra[i],
+                                    Polarization,
+                                    Angle,
+                                    HorizontalDirection,
+                                    PropogationDirection,
+                                    Precision,
+                                    MaxLevel,
+                                    MaxLevelExtended,
+                                    Weight,
+                                    0);
+          } else {
+            this->CalculateSpectrumThreads(fParticle,
+                                           Points[i],
+                                           Spectra[i],
+                                           NThreadsToUse,
+                                           Polarization,
+                                           Angle,
+                                           HorizontalDirection,
+                                           PropogationDirection,
+                                           Precision,
+                                           MaxLevel,
+                                           MaxLevelExtended,
+                                           Weight,
+                                           0);
+          }
+        }
+      }
+    }
+
+    std::vector<double> Values(Points.size() * NEnergies);
+    for (size_t i = 0; i != Points.size(); ++i) {
+      for (size_t iE = 0; iE != NEnergies; ++iE) {
+        Values[i * NEnergies + iE] = Spectra[i].GetFlux(iE);
+        if (!Spectra[i].IsConverged(iE)) {
+          NotConverged[iE] = 1;
+        }
+      }
+    }
+    Aperture.SetPending(Values, NEnergies);
+  } while (Aperture.Refine(Tolerance) > 0);
+
+  // m^2 to mm^2
+  std::vector<double> const& Integral = Aperture.GetIntegral();
+  for (size_t iE = 0; iE != NEnergies; ++iE) {
+    Spectrum.SetFlux(iE, Integral[iE] * 1e6);
+    if (NotConverged[iE]) {
+      Spectrum.SetNotConverged(iE);
+    }
   }
 
-  // Vector for storing threads to rejoin
-  std::vector<std::thread> Threads;
+  std::ostringstream Path;
+  Path << " (aperture: " << Aperture.GetNPoints() << " points)";
+  fLastCalculationPath += Path.str();
 
-  // Number of points in spectrum
-  size_t const NPoints = Surface.GetNPoints();
+  return;
+}
 
-  // How many threads to start in the first for loop
-  size_t const NThreadsActual = NPoints > (size_t) NThreads ? NThreads : NPoints;
 
-  // Keep track of which threads are finished and re-joined
-  bool *Done = new bool[NThreadsActual];
-  bool *Joined = new bool[NThreadsActual];
 
-  // Number per thread plus remainder to be added to first threads
-  size_t const NPerThread = NPoints / NThreadsActual;
-  size_t const NRemainder = NPoints % NThreadsActual;
 
-  // Start threads and keep in vector
-  for (size_t it = 0; it != NThreadsActual; ++it) {
+void OSCARSSR::GetBeamConvolutionParameters (TSurfacePoints_Rectangle const& Surface,
+                                             TVector2D& Sigma,
+                                             int& NPadX1,
+                                             int& NPadX2)
+{
+  // Get the rms beam size [m] projected along the X1 and X2 axes of the rectangle and the
+  // number of points needed to pad the rectangle in each direction.  The beam is propogated
+  // as a drift from its twiss lattice reference to the center of the rectangle.  The
+  // convolution is separable only if the rectangle axes are aligned with the beam
+  // horizontal and vertical directions, which is checked here.
 
-    // First and last points for each thread
-    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
-    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+  // Number of sigma to pad and truncate the convolution kernel at
+  double const NSigma = 4;
 
-    // Set Done and joined to false for this thread
-    Done[it] = false;
-    Joined[it] = false;
+  if (this->GetNParticleBeams() != 1) {
+    throw std::invalid_argument("convolution requires exactly one particle beam");
+  }
 
-    // Start thread for these points
-    Threads.push_back(std::thread(&OSCARSSR::CalculateFluxPoints,
-                                  this,
-                                  std::ref(Particle),
-                                  std::ref(Surface),
-                                  Energy_eV,
-                                  std::ref(FluxContainer),
-                                  iFirst,
-                                  iLast,
-                                  std::ref(Done[it]),
-                                  Polarization,
-                                  Angle,
-                                  HorizontalDirection,
-                                  PropogationDirection,
-                                  Precision,
-                                  MaxLevel,
-                                  MaxLevelExtended,
-                                  Weight,
-                                  ReturnQuantity));
+  TParticleBeam& Beam = fParticleBeamContainer.GetParticleBeam(0);
+
+  if (Beam.GetSigmaEnergyGeV() != 0) {
+    std::cerr << "WARNING in OSCARSSR::GetBeamConvolutionParameters(): energy spread is ignored in convolution" << std::endl;
   }
 
-  // Are all of the threads finished or not?  Continue loop until all come back.
-  bool AllThreadsFinished = false;
-  size_t NThreadsFinished = 0;
-  while (!AllThreadsFinished) {
+  // Distance along the beam from the lattice reference to the rectangle
+  double const L = (Surface.GetCenter() - Beam.GetTwissLatticeReference()).Dot(Beam.GetU0());
+  TVector2D const SigmaHV = Beam.GetProjectedSigma(L);
 
-    // So as to not use the current thread at 100%
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  // Unit vectors of the rectangle axes
+  TVector3D const U1 = Surface.GetX1Vector().UnitVector();
+  TVector3D const U2 = Surface.GetX2Vector().UnitVector();
 
-    // Check all threads
-    for (size_t it = 0; it != NThreadsActual; ++it) {
+  double const H1 = Beam.GetHorizontalDirection().Dot(U1);
+  double const H2 = Beam.GetHorizontalDirection().Dot(U2);
+  double const V1 = Beam.GetVerticalDirection().Dot(U1);
+  double const V2 = Beam.GetVerticalDirection().Dot(U2);
 
-      if (Done[it] && !Joined[it]) {
-        Threads[it].join();
-        Joined[it] = true;
-        ++NThreadsFinished;
-      }
-    }
+  // Covariance of the projected beam in the rectangle frame
+  double const S11 = SigmaHV[0] * SigmaHV[0] * H1 * H1 + SigmaHV[1] * SigmaHV[1] * V1 * V1;
+  double const S22 = SigmaHV[0] * SigmaHV[0] * H2 * H2 + SigmaHV[1] * SigmaHV[1] * V2 * V2;
+  double const S12 = SigmaHV[0] * SigmaHV[0] * H1 * H2 + SigmaHV[1] * SigmaHV[1] * V1 * V2;
 
-    // If the number finished is equal to the number of points total then we're done
-    if (NThreadsFinished == NThreadsActual) {
-      AllThreadsFinished = true;
-    }
+  if (fabs(S12) > 1e-3 * sqrt(S11 * S22) && fabs(S12) > 0) {
+    throw std::invalid_argument("convolution requires rectangle axes aligned with the beam horizontal and vertical directions");
   }
 
-  // Clear all threads
-  Threads.clear();
+  Sigma.SetXY(sqrt(S11), sqrt(S22));
 
-  // Delete my arrays, I hate new for this purpose
-  delete [] Done;
-  delete [] Joined;
+  double const Step1 = Surface.GetX1Vector().Mag();
+  double const Step2 = Surface.GetX2Vector().Mag();
+
+  NPadX1 = Step1 > 0 ? (int) ceil(NSigma * Sigma[0] / Step1) : 0;
+  NPadX2 = Step2 > 0 ? (int) ceil(NSigma * Sigma[1] / Step2) : 0;
 
   return;
 }
@@ -3050,57 +6489,90 @@ void OSCARSSR::CalculateFluxThreads (TParticleA& Particle,
 
 
 
-
-void OSCARSSR::CalculateFluxGPU (TSurfacePoints const& Surface,
-                                 double const Energy_eV,
-                                 T3DScalarContainer& FluxContainer,
-                                 std::string const& Polarization,
-                                 double const Angle,
-                                 TVector3D const& HorizontalDirection,
-                                 TVector3D const& PropogationDirection,
-                                 int const NParticles,
-                                 std::vector<int> GPUVector,
-                                 double const Precision,
-                                 int    const MaxLevel,
-                                 int    const MaxLevelExtended,
-                                 int    const ReturnQuantity)
+void OSCARSSR::ConvolveRectangle (TSurfacePoints_Rectangle const& Surface,
+                                  T3DScalarContainer const& PaddedContainer,
+                                  T3DScalarContainer& Container,
+                                  TVector2D const& Sigma,
+                                  int const NPadX1,
+                                  int const NPadX2,
+                                  int const Dimension,
+                                  int const ReturnQuantity) const
 {
-  // If you compile for Cuda use the GPU in this function, else throw
+  // Separable gaussian convolution of the values on a padded rectangle.  The result
+  // for the points in Surface is added to Container.  Only values (ReturnQuantity 0)
+  // are convolved, precision and level are taken from the center point.  Points are
+  // marked not converged if the center point in the padded container is not converged.
 
-  // If GPUVector is empty assume you want to use ALL GPUs available
-  if (GPUVector.size() == 0) {
-    int const NGPUAvailable = this->CheckGPU();
-    for (int i = 0; i < NGPUAvailable; ++i) {
-      GPUVector.push_back(i);
-    }
+  int const NX1 = Surface.GetNX1();
+  int const NX2 = Surface.GetNX2();
+  int const NPX2 = NX2 + 2 * NPadX2;
+
+  if (PaddedContainer.GetNPoints() != (size_t) ((NX1 + 2 * NPadX1) * NPX2)) {
+    throw std::length_error("padded container does not match surface and padding");
   }
 
-  #ifdef CUDA
-  // Check that the GPU exists
-  if (this->CheckGPU() < 1) {
-    throw std::invalid_argument("You are requesting the GPU, but none were found");
+  // Normalized kernel in each direction
+  std::vector<double> K1(2 * NPadX1 + 1, 1);
+  std::vector<double> K2(2 * NPadX2 + 1, 1);
+  double const Step1 = Surface.GetX1Vector().Mag();
+  double const Step2 = Surface.GetX2Vector().Mag();
+  double Sum1 = 0;
+  double Sum2 = 0;
+  for (int k = -NPadX1; k <= NPadX1; ++k) {
+    double const x = k * Step1 / Sigma[0];
+    K1[k + NPadX1] = NPadX1 > 0 ? exp(-0.5 * x * x) : 1;
+    Sum1 += K1[k + NPadX1];
+  }
+  for (int k = -NPadX2; k <= NPadX2; ++k) {
+    double const x = k * Step2 / Sigma[1];
+    K2[k + NPadX2] = NPadX2 > 0 ? exp(-0.5 * x * x) : 1;
+    Sum2 += K2[k + NPadX2];
+  }
+  for (std::vector<double>::iterator it = K1.begin(); it != K1.end(); ++it) {
+    *it /= Sum1;
+  }
+  for (std::vector<double>::iterator it = K2.begin(); it != K2.end(); ++it) {
+    *it /= Sum2;
   }
 
-  // Set the level to stop at if requested, but not above the hard limit
-  int const LevelStopMemory = MaxLevel >= -1  && MaxLevel <= TParticleA::kMaxTrajectoryLevel ? MaxLevel : TParticleA::kMaxTrajectoryLevel;
-  int const LevelStopWithExtended = MaxLevelExtended > LevelStopMemory ? MaxLevelExtended : LevelStopMemory;
+  // First pass along X1 for the rows of the output, all columns of the padded rectangle
+  std::vector<double> Pass1(NX1 * NPX2, 0);
+  for (int i1 = 0; i1 != NX1; ++i1) {
+    for (int i2 = 0; i2 != NPX2; ++i2) {
+      double Sum = 0;
+      for (int k = -NPadX1; k <= NPadX1; ++k) {
+        Sum += K1[k + NPadX1] * PaddedContainer.GetPoint((i1 + NPadX1 + k) * NPX2 + i2).GetV();
+      }
+      Pass1[i1 * NPX2 + i2] = Sum;
+    }
+  }
 
-  return OSCARSSR_Cuda_CalculateFluxGPU (*this,
-                                         Surface,
-                                         Energy_eV,
-                                         FluxContainer,
-                                         Polarization,
-                                         Angle,
-                                         HorizontalDirection,
-                                         PropogationDirection,
-                                         NParticles,
-                                         GPUVector,
-                                         Precision,
-                                         LevelStopWithExtended,
-                                         ReturnQuantity);
-  #else
-  throw std::invalid_argument("GPU functionality not compiled into this binary distribution");
-  #endif
+  // Second pass along X2 and fill output
+  for (int i1 = 0; i1 != NX1; ++i1) {
+    for (int i2 = 0; i2 != NX2; ++i2) {
+      size_t const i = (size_t) (i1 * NX2 + i2);
+      size_t const ip = (size_t) ((i1 + NPadX1) * NPX2 + i2 + NPadX2);
+
+      double Value = 0;
+      if (ReturnQuantity == 0) {
+        for (int k = -NPadX2; k <= NPadX2; ++k) {
+          Value += K2[k + NPadX2] * Pass1[i1 * NPX2 + i2 + NPadX2 + k];
+        }
+      } else {
+        Value = PaddedContainer.GetPoint(ip).GetV();
+      }
+
+      if (Dimension == 3) {
+        Container.AddPoint(Surface.GetPoint(i).GetPoint(), Value);
+      } else {
+        Container.AddPoint(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), Value);
+      }
+
+      if (!PaddedContainer.IsConverged(ip)) {
+        Container.SetNotConverged(Container.GetNPoints() - 1);
+      }
+    }
+  }
 
   return;
 }
@@ -3108,7 +6580,6 @@ void OSCARSSR::CalculateFluxGPU (TSurfacePoints const& Surface,
 
 
 
-
 void OSCARSSR::CalculateElectricFieldTimeDomain (TVector3D const& Observer, T3DScalarContainer& XYZT)
 {
   // Check that particle has been set yet.  If fType is "" it has not been set yet
@@ -865,11 +865,7 @@ extern "C" void OSCARSSR_Cuda_CalculateFluxGPU (OSCARSSR& OSR,
   *h_c2    = TOSCARSSR::FourPi() * OSR.GetCurrentParticle().GetCurrent() / (TOSCARSSR::H() * fabs(OSR.GetCurrentParticle().GetQ()) * TOSCARSSR::Mu0() * TOSCARSSR::C()) * 1e-6 * 0.001;
   *h_c     = TOSCARSSR::C();
   *h_omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);
-  for (size_t i = 0; i < *h_ns; ++i) {
-    h_sx[i] = Surface.GetPoint(i).GetX();
-    h_sy[i] = Surface.GetPoint(i).GetY();
-    h_sz[i] = Surface.GetPoint(i).GetZ();
-  }
+  Surface.GetArrays(0, (size_t) *h_ns, h_sx, h_sy, h_sz, 0x0, 0x0, 0x0);
 
   // Copy constants to first device (async)
   int const d0 = GPUsToUse[0];
@@ -2979,14 +2975,7 @@ extern "C" void OSCARSSR_Cuda_CalculatePowerDensityGPU (OSCARSSR& OSR,
     cudaMemcpyAsync(d_ifirst[i], &(h_ifirst[i]), sizeof(int), cudaMemcpyHostToDevice);
   }
 
-  for (size_t i = 0; i < *h_ns; ++i) {
-    h_sx[i] = Surface.GetPoint(i).GetX();
-    h_sy[i] = Surface.GetPoint(i).GetY();
-    h_sz[i] = Surface.GetPoint(i).GetZ();
-    h_nx[i] = Surface.GetPoint(i).GetNormalX();
-    h_ny[i] = Surface.GetPoint(i).GetNormalY();
-    h_nz[i] = Surface.GetPoint(i).GetNormalZ();
-  }
+  Surface.GetArrays(0, (size_t) *h_ns, h_sx, h_sy, h_sz, h_nx, h_ny, h_nz);
 
   // Copy constants to first device (async)
   int const d0 = GPUsToUse[0];
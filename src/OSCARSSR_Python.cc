@@ -20,6 +20,8 @@
 
 #include "TSurfacePoints_Rectangle.h"
 #include "TSurfacePoints_3D.h"
+#include "TSurfacePoints_Parametric.h"
+#include "TSurfaceQuadtree.h"
 #include "T3DScalarContainer.h"
 #include "TFieldPythonFunction.h"
 #include "TField3D_Gaussian.h"
@@ -64,17 +66,20 @@ static PyObject* OSCARSSR_new (PyTypeObject* type, PyObject* args, PyObject* key
   // Grab the values
   int NThreads = 0;
   int GPU = 0;
+  int NProcesses = 0;
 
   // Input variables and parsing
   static const char *kwlist[] = {"nthreads",
                                  "gpu",
+                                 "nprocesses",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|ii",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|iii",
                                    const_cast<char **>(kwlist),
                                    &NThreads,
-                                   &GPU)) {
-    PyErr_SetString(PyExc_ValueError, "allowed inputs are currentl: 'nthreads', 'gpu'");
+                                   &GPU,
+                                   &NProcesses)) {
+    PyErr_SetString(PyExc_ValueError, "allowed inputs are currentl: 'nthreads', 'gpu', 'nprocesses'");
     return NULL;
   }
 
@@ -90,6 +95,14 @@ static PyObject* OSCARSSR_new (PyTypeObject* type, PyObject* args, PyObject* key
   if (NThreads > 0) {
     self->obj->SetNThreadsGlobal(NThreads);
   }
+  if (NProcesses > 0) {
+    try {
+      self->obj->SetNProcessesGlobal(NProcesses);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
   if (GPU != 0 && GPU != 1) {
     PyErr_SetString(PyExc_ValueError, "global gpu settign must be 0 or 1");
     return NULL;
@@ -265,6 +278,90 @@ static PyObject* OSCARSSR_SetSeed (OSCARSSRObject* self, PyObject* arg)
 
 
 
+const char* DOC_OSCARSSR_SetCheckpoint = R"docstring(
+set_checkpoint(ofile, nparticles [, resume])
+
+Periodically write a checkpoint during multi-particle calculations (spectrum, flux, and power density).  The checkpoint contains the partial result, the number of particles done, and the state of the random number generator.  If a job is interrupted it can be continued from the checkpoint by calling set_checkpoint with resume=1 and then calling the same calculation with the same inputs.  The resumed result is identical to that of an uninterrupted run.
+
+Parameters
+----------
+ofile : str
+    Checkpoint file name
+
+nparticles : int
+    Write a checkpoint every nparticles particles (and at the end)
+
+resume : int
+    If 1 the next multi-particle calculation will start from the checkpoint in ofile.  The request is used up by the next calculation of any kind (on the GPU it is ignored with a warning)
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetCheckpoint (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Set the checkpoint file and frequency
+
+  char const* FileName = "";
+  int         NParticles = 0;
+  int         Resume = 0;
+
+  static const char *kwlist[] = {"ofile",
+                                 "nparticles",
+                                 "resume",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "si|i",
+                                   const_cast<char **>(kwlist),
+                                   &FileName,
+                                   &NParticles,
+                                   &Resume)) {
+    return NULL;
+  }
+
+  if (std::string(FileName) == "") {
+    PyErr_SetString(PyExc_ValueError, "'ofile' must not be empty");
+    return NULL;
+  }
+
+  if (NParticles < 1) {
+    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1");
+    return NULL;
+  }
+
+  self->obj->SetCheckpoint(FileName, NParticles, Resume == 1);
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
+const char* DOC_OSCARSSR_ClearCheckpoint = R"docstring(
+clear_checkpoint()
+
+Turn off checkpointing of multi-particle calculations
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_ClearCheckpoint (OSCARSSRObject* self)
+{
+  // Turn off checkpointing
+
+  self->obj->ClearCheckpoint();
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
 const char* DOC_OSCARSSR_SetGPUGlobal = R"docstring(
 set_gpu_global(gpu)
 
@@ -359,76 +456,104 @@ static PyObject* OSCARSSR_SetNThreadsGlobal (OSCARSSRObject* self, PyObject* arg
 
 
 
+const char* DOC_OSCARSSR_SetNProcessesGlobal = R"docstring(
+set_nprocesses_global(nprocesses)
 
+Set the number of local processes to use for multi-particle calculations (spectrum, flux, and power density with nparticles > 0).  The particles are split between forked worker processes, each with its own random stream seeded from the current generator, and each using the number of threads requested.  Results are summed in shared memory.  The GPU takes precedence over this.  Not available on windows or together with checkpoints.
 
-
-
-
-
-const char* DOC_OSCARSSR_GetCTStart = R"docstring(
-get_ctstart()
-
-Gets the start time for particle propogation.  The *time* is in units of [m].
+Parameters
+----------
+nprocesses : int
+    Number of processes to use for multi-particle calculations (default is 1)
 
 Returns
 -------
-time, float
+None
 )docstring";
-static PyObject* OSCARSSR_GetCTStart (OSCARSSRObject* self)
+static PyObject* OSCARSSR_SetNProcessesGlobal (OSCARSSRObject* self, PyObject* arg)
 {
-  // Get the start time in [m] for calculation
-  return Py_BuildValue("d", self->obj->GetCTStart());
+  // Grab the value from input
+  int const NProcesses = (int) PyLong_AsLong(arg);
+
+  try {
+    self->obj->SetNProcessesGlobal(NProcesses);
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
 
 
-const char* DOC_OSCARSSR_GetCTStop = R"docstring(
-get_ctstop()
 
-Gets the stop time for particle propogation.  The *time* is in units of [m].
 
-Returns
--------
-time : float
-)docstring";
-static PyObject* OSCARSSR_GetCTStop (OSCARSSRObject* self)
-{
-  // Get the CTStop variable from OSCARSSR
-  return Py_BuildValue("d", self->obj->GetCTStop());
-}
 
 
 
-const char* DOC_OSCARSSR_SetCTStartStop = R"docstring(
-set_ctstartstop(start, stop)
 
-Set the start and stop times for the trajectory calculation.  Start time must be less than or equal to the T0 defined in the initial conditions for the particle beam.  Similarly, stop time must be greater than that T0.  This also sets a default value for the number of points used in the trajectory calculation.
+
+
+
+
+const char* DOC_OSCARSSR_SetAnalyticMode = R"docstring(
+set_analytic_mode(mode [, nvalidation, tolerance])
+
+Set the analytic mode for spectrum, flux, and power density calculations.  In *auto* mode, when the only field is a single untapered ideal undulator (add_bfield_undulator), the beam is a filament (nparticles=0) along the undulator axis starting outside of it and the trajectory covers it, polarization is 'all', and every observation point is downstream at a distance of at least 10 times the undulator length, the result is calculated with the closed-form expressions of oscars.th instead of integrating the trajectory (Bessel series for flux, the Kim angular distribution for power density).  In all other cases the numerical calculation is done.  Use get_last_calculation_path() to see which path was taken.
+
+This is an approximation.  The closed-form expressions describe nperiods sinusoidal periods without the terminating half periods of add_bfield_undulator.  The terminations act roughly as one extra period, so the analytic peak is lower by about 2/nperiods and the line is slightly wider.  The analytic path is only taken when 2/nperiods is at or below *tolerance*.
 
 Parameters
 ----------
-start : float
-    Start time
+mode : str
+    'off' (default) or 'auto'
 
-stop : float
-    Stop time
+nvalidation : int
+    Number of points of an analytic power density which are also calculated numerically.  The largest difference relative to the peak is reported in get_last_calculation_path().  Default is 3, 0 turns this off
+
+tolerance : float
+    Largest accepted relative error from the missing end fields, estimated as 2/nperiods.  Default is 0.01 (200 periods or more)
 
 Returns
 -------
 None
 )docstring";
-static PyObject* OSCARSSR_SetCTStartStop (OSCARSSRObject* self, PyObject* args)
+static PyObject* OSCARSSR_SetAnalyticMode (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Set the start and stop times for OSCARSSR in [m]
+  // Set the analytic mode
 
-  // Grab the values
-  double Start, Stop;
-  if (!PyArg_ParseTuple(args, "dd", &Start, &Stop)) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format");
+  char const* Mode = "";
+  int         NValidation = 3;
+  double      Tolerance = 0.01;
+
+  static const char *kwlist[] = {"mode",
+                                 "nvalidation",
+                                 "tolerance",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|id",
+                                   const_cast<char **>(kwlist),
+                                   &Mode,
+                                   &NValidation,
+                                   &Tolerance)) {
     return NULL;
   }
 
-  // Set the object variable
-  self->obj->SetCTStartStop(Start, Stop);
+  try {
+    self->obj->SetAnalyticMode(Mode, NValidation, Tolerance);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -439,61 +564,59 @@ static PyObject* OSCARSSR_SetCTStartStop (OSCARSSRObject* self, PyObject* args)
 
 
 
-const char* DOC_OSCARSSR_GetNPointsTrajectory = R"docstring(
-get_npoints_trajectory()
 
-Get the number of points to be used for the trajectory calculation
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_GetAnalyticMode = R"docstring(
+get_analytic_mode()
+
+Get the analytic mode
 
 Returns
 -------
-npoints : int
+mode : str
+    'off' or 'auto'
 )docstring";
-static PyObject* OSCARSSR_GetNPointsTrajectory (OSCARSSRObject* self)
+static PyObject* OSCARSSR_GetAnalyticMode (OSCARSSRObject* self)
 {
-  // Get the numper of points for trajectory calculaton
-  return PyLong_FromSize_t(self->obj->GetNPointsTrajectory());
+  // Get the analytic mode
+  return Py_BuildValue("s", self->obj->GetAnalyticMode().c_str());
 }
 
 
 
-const char* DOC_OSCARSSR_SetNPointsTrajectory = R"docstring(
-set_npoints_trajectory(npoints)
 
-Sets the number of points to be used in the trajectory calculation.  Only call this function **after** set_ctstartstop().
 
-Parameters
-----------
-npoints : int
-    Number of points
 
-Returns
--------
-None
 
-example:
 
-   .. code-block:: py
 
-      # First set the start and stop times
-      osr.set_ctstartstop(0, 2)
 
-      # Use 12345 points in the trajectory calculations
-      osr.set_npoints_trajectory(12345)
+
+
+
+const char* DOC_OSCARSSR_GetLastCalculationPath = R"docstring(
+get_last_calculation_path()
+
+Get a description of how the last spectrum, flux, or power density calculation was done.  This starts with 'analytic: ideal undulator without end fields' when the closed-form expressions were used (followed by the validation result for power density), 'numerical' when the analytic mode is off, and 'numerical: <reason>' when the analytic mode is auto but the configuration did not allow it.
+
+Returns
+-------
+path : str
 )docstring";
-static PyObject* OSCARSSR_SetNPointsTrajectory (OSCARSSRObject* self, PyObject* arg)
+static PyObject* OSCARSSR_GetLastCalculationPath (OSCARSSRObject* self)
 {
-  // Set the number of points for trajectory calculation
+  // Get the path taken in the last calculation
+  return Py_BuildValue("s", self->obj->GetLastCalculationPath().c_str());
+}
 
-  // Grab the value from input
-  size_t N = PyLong_AsSsize_t(arg);
 
-  // Set the object variable
-  self->obj->SetNPointsTrajectory(N);
 
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
 
 
 
@@ -501,29 +624,45 @@ static PyObject* OSCARSSR_SetNPointsTrajectory (OSCARSSRObject* self, PyObject*
 
 
 
-const char* DOC_OSCARSSR_SetNPointsPerMeterTrajectory = R"docstring(
-set_npoints_per_meter_trajectory(npoints)
 
-Sets the number of points per meter to be used in the trajectory calculation.
+
+
+
+const char* DOC_OSCARSSR_SetIntegrator = R"docstring(
+set_integrator(integrator)
+
+Set the integrator used for the trajectory integral in spectrum and flux calculations.  *riemann* (default) sums the field over all trajectory points and refines until the phase advance between points is below pi, which at high photon energies can require very fine trajectories.  *filon* treats the amplitude and phase as linear between trajectory points and integrates each interval exactly, so only the change in phase advance between intervals needs to be below pi.  This allows far coarser trajectory sampling for the same accuracy at high photon energies.  GPU calculations always use *riemann*.
 
 Parameters
 ----------
-npoints : int
-    Number of points per neter
+integrator : str
+    'riemann' or 'filon'
 
 Returns
 -------
 None
 )docstring";
-static PyObject* OSCARSSR_SetNPointsPerMeterTrajectory (OSCARSSRObject* self, PyObject* arg)
+static PyObject* OSCARSSR_SetIntegrator (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Set the number of points for trajectory calculation
+  // Set the integrator for spectrum and flux
 
-  // Grab the value from input
-  size_t N = PyLong_AsSsize_t(arg);
+  char const* Integrator = "";
 
-  // Set the object variable
-  self->obj->SetNPointsPerMeterTrajectory(N);
+  static const char *kwlist[] = {"integrator",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+                                   const_cast<char **>(kwlist),
+                                   &Integrator)) {
+    return NULL;
+  }
+
+  try {
+    self->obj->SetIntegrator(Integrator);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -536,153 +675,74 @@ static PyObject* OSCARSSR_SetNPointsPerMeterTrajectory (OSCARSSRObject* self, Py
 
 
 
-const char* DOC_OSCARSSR_AddMagneticField = R"docstring(
-add_bfield_file([, ifile, bifile, iformat, rotations, translation, scale, name])
 
-Add a magnetic field from a text file *ifile* according to the format *iformat*.
 
-Currently OSCARS accepts the following file formats for iformat
-    * 'OSCARS'
-    * 'OSCARS1D [plus format string]'
-    * 'SPECTRA'
-    * 'SRW'
 
-For the OSCARS1D format you must also include the order of the data columns, which would typically look something like: 'OSCARS1D Z Bx By Bz'.  You may use X or Y instead of Z and the order and number of B[xyz] does not matter.  This mode also accepts non-uniformly distributed data.
 
-Optionally you can rotate and translate the field in space.  You can use an input *scale* list to scale the input (which must be in SI units of [m] for distances/positions and [T] for magnetic field values.
 
-The rotation is performed first in the order: :math:`\theta_x, \theta_y, \theta_z`
 
-*scale* is a list of less than or equal length to the number of elements in *iformat* when OSCARS1D is selected.  This will scale the input values of the i-th column before any rotation or translation.  This is useful if your data file is not in [T] and [m]
+const char* DOC_OSCARSSR_GetIntegrator = R"docstring(
+get_integrator()
 
-Parameters
-----------
-ifile : str
-    Name of input file
+Get the integrator used for spectrum and flux calculations
 
-bifile : str
-    Name of binary input file
+Returns
+-------
+integrator : str
+    'riemann' or 'filon'
+)docstring";
+static PyObject* OSCARSSR_GetIntegrator (OSCARSSRObject* self)
+{
+  // Get the integrator
+  return Py_BuildValue("s", self->obj->GetIntegrator().c_str());
+}
 
-iformat : str
-    Format of the input file.  Must be specified with ifile, but not with bifile
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
 
-scale : list, optional
-    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
 
-name : str
-    Name of this magnetic field
 
-Returns
--------
-None
 
-Examples
---------
-Add a magnetic field from a data file where the data is in columns in the order Z Bx By Bz
 
-    >>> osr.add_bfield_file(ifile='file.txt', iformat='OSCARS1D Z Bx By Bz')
-)docstring";
-static PyObject* OSCARSSR_AddMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a magnetic field from a file.
-  // UPDATE: add binary file reading
 
 
-  // Grab the values
-  char const* FileNameText     = "";
-  char const* FileNameBinary   = "";
-  char const* FileFormat       = "";
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Scaling     = PyList_New(0);
-  char const* Name             = "";
 
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
-  std::vector<double> Scaling;
 
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"ifile",
-                                 "bifile",
-                                 "iformat",
-                                 "rotations",
-                                 "translation",
-                                 "scale",
-                                 "name",
-                                 NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|sssOOOs",
-                                   const_cast<char **>(kwlist),
-                                   &FileNameText,
-                                   &FileNameBinary,
-                                   &FileFormat,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &List_Scaling,
-                                   &Name)) {
-    return NULL;
-  }
+const char* DOC_OSCARSSR_SetConvergenceMode = R"docstring(
+set_convergence_mode(mode)
 
-  // Check that ifile and bifile both not input
-  if (std::strlen(FileNameText) != 0 && std::strlen(FileNameBinary) != 0) {
-    PyErr_SetString(PyExc_ValueError, "cannot specify both 'ifile' and 'bifile'");
-    return NULL;
-  }
+Set how convergence is decided in spectrum, flux, and power density calculations.  The trajectory is refined in levels, each doubling the number of points.  In *level* mode (default) the result is accepted once two successive levels agree to the requested precision, but not before level 9.  In *richardson* mode the trajectory end points are added to make each level a trapezoid sum and the sums with halving step size are extrapolated to zero step size (Romberg).  While the change between levels shrinks by close to the factor 4 of the trapezoid rule the change between the last two extrapolations is used as the precision estimate, otherwise it is not less than the change from the previous level's extrapolated value.  This stops several levels earlier than *level* mode when the trajectory starts or stops inside the field.  When the field vanishes at both ends the level sums already converge very quickly and both modes stop at about the same level.  Only levels which resolve the phase (or the change in direction for power density) are used in the extrapolation.  With the *filon* integrator *level* mode is always used.
 
-  // Check that filename and format exist
-  if (std::strlen(FileNameText) != 0 && std::strlen(FileFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
-    return NULL;
-  }
+Parameters
+----------
+mode : str
+    'level' or 'richardson'
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
-    try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
-      return NULL;
-    }
-  }
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetConvergenceMode (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Set the convergence mode
 
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
-    try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
-      return NULL;
-    }
-  }
+  char const* Mode = "";
 
-  // Get any scaling factors
-  // UPDATE: Check against fileformat number of strings
-  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
-    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
-  }
+  static const char *kwlist[] = {"mode",
+                                 NULL};
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+                                   const_cast<char **>(kwlist),
+                                   &Mode)) {
     return NULL;
   }
 
-  // Add the magnetic field to the OSCARSSR object
   try {
-    if (std::strlen(FileNameBinary) != 0) {
-      self->obj->AddMagneticField(FileNameBinary, "BINARY", Rotations, Translation, Scaling, Name);
-    } else {
-      self->obj->AddMagneticField(FileNameText, FileFormat, Rotations, Translation, Scaling, Name);
-    }
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check 'ifile' and 'iformat' are correct");
+    self->obj->SetConvergenceMode(Mode);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
   }
 
@@ -697,160 +757,72 @@ static PyObject* OSCARSSR_AddMagneticField (OSCARSSRObject* self, PyObject* args
 
 
 
-const char* DOC_OSCARSSR_AddMagneticFieldInterpolated = R"docstring(
-add_bfield_interpolated(mapping, iformat, parameter [, rotations, translation, scale, name])
-
-Add field given a paramater and a mapping between known parameters and field data files where the field is interpolated from the known data points.
 
-Parameters
-----------
-mapping : list [[float, str], [float, str], ...]
-    List of parameters and associated filenames [[p1, file1], [p2, file2], ...]
 
-iformat : str
-    Which input format to use (see add_bfield_file() for formats)
 
-parameter : float
-    Value of parameter you are interested in
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
 
-scale : list, optional
-    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
+const char* DOC_OSCARSSR_GetConvergenceMode = R"docstring(
+get_convergence_mode()
 
-name : str
-    Name of this magnetic field
+Get the convergence mode for spectrum, flux, and power density calculations
 
 Returns
 -------
-None
-
-Examples
---------
-Undulator gap interpolation between known magnetic measurement points
-
-    >>> file_list = [
-    ...     [10.9, 'file_10.9.dat'],
-    ...     [11.0, 'file_11.0.dat'],
-    ...     [13.2, 'file_13.2.dat'],
-    ...     [16.9, 'file_16.9.dat']
-    ... ]
-    >>> osr.add_bfield_interpolated(mapping=file_list, iformat='OSCARS1D Z Bx By Bz', parameter=12.123)
+mode : str
+    'level' or 'richardson'
 )docstring";
-static PyObject* OSCARSSR_AddMagneticFieldInterpolated (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_GetConvergenceMode (OSCARSSRObject* self)
 {
-  // Add a magnetic field from a file.
-  // UPDATE: add binary file reading
+  // Get the convergence mode
+  return Py_BuildValue("s", self->obj->GetConvergenceMode().c_str());
+}
 
-  // Grab the values
-  PyObject*   List_Mapping     = PyList_New(0);
-  char const* FileFormat       = "";
-  double      Parameter        = 0;
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Scaling     = PyList_New(0);
-  char const* Name             = "";
 
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
-  std::vector<double> Scaling;
 
-  // Mapping that is passed in for field interpolation
-  std::vector<std::pair<double, std::string> > Mapping;
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"mapping",
-                                 "iformat",
-                                 "parameter",
-                                 "rotations",
-                                 "translation",
-                                 "scale",
-                                 "name",
-                                 NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Osd|OOOs",
-                                   const_cast<char **>(kwlist),
-                                   &List_Mapping,
-                                   &FileFormat,
-                                   &Parameter,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &List_Scaling,
-                                   &Name)) {
-    return NULL;
-  }
 
-  // Grab mapping from input
-  if (PyList_Size(List_Mapping) != 0) {
-    double ParameterValue;
-    for (int i = 0; i != PyList_Size(List_Mapping); ++i) {
-      PyObject* ThisPair = PyList_GetItem(List_Mapping, i);
-      if (PyList_Size(ThisPair) != 2) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'mapping'");
-        return NULL;
-      }
 
-      ParameterValue = PyFloat_AsDouble(PyList_GetItem(ThisPair, 0));
-      std::string const FileName = OSCARSPY::GetAsString(PyList_GetItem(ThisPair, 1));
 
-      Mapping.push_back(std::make_pair(ParameterValue, FileName));
-    }
-  }
 
 
-  // Check that filename and format exist
-  if (std::strlen(FileFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
-    return NULL;
-  }
 
-  // Parameter value is what it is...
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
-    try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
-      return NULL;
-    }
-  }
 
 
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
-    try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
-      return NULL;
-    }
-  }
+const char* DOC_OSCARSSR_SetWarmStart = R"docstring(
+set_warm_start(warm_start)
 
-  // Get any scaling factors
-  // UPDATE: Check against fileformat number of strings
-  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
-    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
-  }
+Warm start the trajectory levels in spectrum, flux, and power density calculations.  Normally every point starts at level 0 and cannot be accepted before level 9.  With warm start on, a point may be accepted from one level below the level at which the previous point (of the same thread) converged, but never before level 7.  It still has to agree with the level before it to the requested precision and pass the sampling checks.  The sum at each level includes the trajectory points of all lower levels, so every level is still calculated and the time saved comes only from accepting a point at a lower level.  For the *filon* integrator the filon sum is also skipped below the lower of that level and the level predicted from the largest phase advance along the trajectory.
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
-    return NULL;
-  }
+Parameters
+----------
+warm_start : int
+    1 (or True) for on, 0 (or False) for off (default)
 
-  // Add the magnetic field to the OSCARSSR object
-  try {
-    self->obj->AddMagneticFieldInterpolated(Mapping, FileFormat, Parameter, Rotations, Translation, Scaling, Name);
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check filenames and 'iformat' are correct");
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetWarmStart (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Set warm start for convergence levels
+
+  int WarmStart = 0;
+
+  static const char *kwlist[] = {"warm_start",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "i",
+                                   const_cast<char **>(kwlist),
+                                   &WarmStart)) {
     return NULL;
   }
 
+  self->obj->SetWarmStart(WarmStart != 0);
+
   // Must return python object None in a special way
   Py_INCREF(Py_None);
   return Py_None;
@@ -862,69 +834,76 @@ static PyObject* OSCARSSR_AddMagneticFieldInterpolated (OSCARSSRObject* self, Py
 
 
 
-const char* DOC_OSCARSSR_AddMagneticFieldFunction = R"docstring(
-add_bfield_function(func [, name])
 
-Adds field in the form of a user defined python function.  The input for this function must be (x, y, z, t) and return [Fx, Fy, Fz]
 
-Parameters
-----------
 
-function : func
-    A python function with input [x, y, z, t] and return of [Fx, Fy, Fz]
 
-name : str
-    Name of this field
 
-Returns
--------
-None
 
-Examples
---------
-Create a function in python and use it as a field in OSCARS
+const char* DOC_OSCARSSR_GetWarmStart = R"docstring(
+get_warm_start()
 
-    >>> def myfunc(x, y, z, t):
-    ...     "Do not forget to write a docstring"
-    ...     if z > 0:
-    ...         return 1
-    ...     return 0
-    >>> osr.add_bfield_function(myfunc)
+Get the warm start setting for convergence levels
+
+Returns
+-------
+warm_start : int
+    1 for on, 0 for off
 )docstring";
-static PyObject* OSCARSSR_AddMagneticFieldFunction (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_GetWarmStart (OSCARSSRObject* self)
 {
-  // Add a python function as a magnetic field object
+  // Get the warm start setting
+  return Py_BuildValue("i", self->obj->GetWarmStart() ? 1 : 0);
+}
 
-  // Variables for function and name
-  PyObject* Function;
-  char const* Name = "";
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"function",
-                                 "name",
+
+
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_SetEmissionConeCulling = R"docstring(
+set_emission_cone_culling(cone_angle)
+
+Cull trajectory segments in power density calculations.  The trajectory is split into segments, each with a bounding sphere for the position and a cone around the directions of beta.  For every point on the surface, segments from which the point is more than *cone_angle* / gamma outside of that cone are not summed.  This is useful for large surfaces such as absorbers and masks where most of the surface only sees part of the trajectory.  The power radiated at an angle theta from beta falls as (1 + gamma^2 theta^2)^(-5/2) or faster, so values of 10 or more lose very little.
+
+Parameters
+----------
+cone_angle : float
+    Cone half angle in units of 1/gamma.  0 turns culling off (default)
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetEmissionConeCulling (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Set the emission cone angle for power density culling
+
+  double ConeAngle = 0;
+
+  static const char *kwlist[] = {"cone_angle",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|s",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "d",
                                    const_cast<char **>(kwlist),
-                                   &Function,
-                                   &Name)) {
+                                   &ConeAngle)) {
     return NULL;
   }
 
-  // Increment ref to function for python
-  Py_INCREF(Function);
-
-  // Add the function as a field to the OSCARSSR object
   try {
-    self->obj->AddMagneticField( (TField*) new TFieldPythonFunction(Function, Name));
+    self->obj->SetEmissionConeCulling(ConeAngle);
   } catch (std::invalid_argument e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
   }
 
-  // Decrement reference to function for python
-  Py_DECREF(Function);
-
   // Must return python object None in a special way
   Py_INCREF(Py_None);
   return Py_None;
@@ -936,126 +915,104 @@ static PyObject* OSCARSSR_AddMagneticFieldFunction (OSCARSSRObject* self, PyObje
 
 
 
-const char* DOC_OSCARSSR_AddMagneticFieldGaussian = R"docstring(
-add_bfield_gaussian(bfield, sigma [, rotations, translation, name])
-
-Add a gaussian field in 3D with the peak field magnitude and direction given by *bfield*, centered about a point with a given sigma in each coordinate.  If any component of *sigma* is less than or equal to zero it is ignored (ie. spatial extent is infinite).
 
-The functional form for this is :math:`\exp(-(x - x_0)^2 / \sigma_x^2)`
 
 
-Parameters
-----------
-bfield : list
-    A list representing the peak field [Fx, Fy, Fz]
 
-sigma : list
-    A list representing the sigma in each coordinate :math:`[\sigma_x, \sigma_y, \sigma_z]`
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+const char* DOC_OSCARSSR_GetEmissionConeCulling = R"docstring(
+get_emission_cone_culling()
 
-name : str
-    Name of this field
+Get the emission cone angle used for power density culling
 
 Returns
 -------
-None
+cone_angle : float
+    Cone half angle in units of 1/gamma, 0 when culling is off
+)docstring";
+static PyObject* OSCARSSR_GetEmissionConeCulling (OSCARSSRObject* self)
+{
+  // Get the emission cone culling angle
+  return Py_BuildValue("d", self->obj->GetEmissionConeCulling());
+}
 
-Examples
---------
-Add a field of 0.5 [T] in the X-direction centered at X=0, Y=0, Z=0 [m], with a sigma of 0.1 [m] in the Z-direction
 
-    >>> osr.add_bfield_gaussian(bfield=[1, 0, 0], sigma=[0, 0, 0.10])
 
-Add a field of 1 [T] in the Y-direction centered at X=1, Y=1, Z=1 [m], with a sigma of 0.05 in the Z-direction
 
-    >>> osr.add_bfield_gaussian(bfield=[0, 1, 0], sigma=[0, 0, 0.05], translation=[1, 1, 1])
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_GetCTStart = R"docstring(
+get_ctstart()
+
+Gets the start time for particle propogation.  The *time* is in units of [m].
+
+Returns
+-------
+time, float
 )docstring";
-static PyObject* OSCARSSR_AddMagneticFieldGaussian (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_GetCTStart (OSCARSSRObject* self)
 {
-  // Add a magnetic field that is a gaussian
+  // Get the start time in [m] for calculation
+  return Py_BuildValue("d", self->obj->GetCTStart());
+}
 
-  // Lists and variables
-  PyObject* List_BField       = PyList_New(0);
-  PyObject* List_Translation  = PyList_New(0);
-  PyObject* List_Rotations    = PyList_New(0);
-  PyObject* List_Sigma        = PyList_New(0);
-  const char* Name            = "";
 
-  TVector3D BField(0, 0, 0);
-  TVector3D Sigma(0, 0, 0);
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
 
+const char* DOC_OSCARSSR_GetCTStop = R"docstring(
+get_ctstop()
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"bfield",
-                                 "sigma",
-                                 "rotations",
-                                 "translation",
-                                 "name",
-                                 NULL};
+Gets the stop time for particle propogation.  The *time* is in units of [m].
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OOs",
-                                   const_cast<char **>(kwlist),
-                                   &List_BField,
-                                   &List_Sigma,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &Name)) {
-    return NULL;
-  }
+Returns
+-------
+time : float
+)docstring";
+static PyObject* OSCARSSR_GetCTStop (OSCARSSRObject* self)
+{
+  // Get the CTStop variable from OSCARSSR
+  return Py_BuildValue("d", self->obj->GetCTStop());
+}
 
 
 
-  // Check BField
-  try {
-    BField = OSCARSPY::ListAsTVector3D(List_BField);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
-    return NULL;
-  }
+const char* DOC_OSCARSSR_SetCTStartStop = R"docstring(
+set_ctstartstop(start, stop)
 
-  // Check Width
-  try {
-    Sigma = OSCARSPY::ListAsTVector3D(List_Sigma);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
-    return NULL;
-  }
+Set the start and stop times for the trajectory calculation.  Start time must be less than or equal to the T0 defined in the initial conditions for the particle beam.  Similarly, stop time must be greater than that T0.  This also sets a default value for the number of points used in the trajectory calculation.
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
-    try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
-      return NULL;
-    }
-  }
+Parameters
+----------
+start : float
+    Start time
 
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
-    try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
-      return NULL;
-    }
-  }
+stop : float
+    Stop time
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetCTStartStop (OSCARSSRObject* self, PyObject* args)
+{
+  // Set the start and stop times for OSCARSSR in [m]
+
+  // Grab the values
+  double Start, Stop;
+  if (!PyArg_ParseTuple(args, "dd", &Start, &Stop)) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format");
     return NULL;
   }
 
-  // Add field
-  self->obj->AddMagneticField( (TField*) new TField3D_Gaussian(BField, Translation, Sigma, Rotations, Name));
+  // Set the object variable
+  self->obj->SetCTStartStop(Start, Stop);
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1066,131 +1023,91 @@ static PyObject* OSCARSSR_AddMagneticFieldGaussian (OSCARSSRObject* self, PyObje
 
 
 
+const char* DOC_OSCARSSR_GetNPointsTrajectory = R"docstring(
+get_npoints_trajectory()
 
+Get the number of points to be used for the trajectory calculation
 
-const char* DOC_OSCARSSR_AddMagneticFieldUniform = R"docstring(
-add_bfield_uniform(bfield [, width, rotations, translation, name])
-
-Add a uniform field in a given range or for all space.  The *bfield* is given as a 3D vector representing the field magnitude and direction.  *width* is an optional parameters, if not present the field permeates all space.  If a component of the 3D list *width* is less than or equal to zero, that coordinate will be ignored when calculating the field.
+Returns
+-------
+npoints : int
+)docstring";
+static PyObject* OSCARSSR_GetNPointsTrajectory (OSCARSSRObject* self)
+{
+  // Get the numper of points for trajectory calculaton
+  return PyLong_FromSize_t(self->obj->GetNPointsTrajectory());
+}
 
-Parameters
-----------
-bfield : list
-    A list representing the field [Fx, Fy, Fz]
 
-width : list
-    A list representing the spetial extent of the field [Wx, Wy, Wz]
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+const char* DOC_OSCARSSR_SetNPointsTrajectory = R"docstring(
+set_npoints_trajectory(npoints)
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+Sets the number of points to be used in the trajectory calculation.  Only call this function **after** set_ctstartstop().
 
-name : str
-    Name of this field
+Parameters
+----------
+npoints : int
+    Number of points
 
 Returns
 -------
 None
 
-Examples
---------
-Add a field of 0.0001 [T] in the X-direction for all space
-
-    >>> osr.add_bfield_uniform(bfield=[0.0001, 0, 0])
-
-Add a field of 0.0005 [T] in the Y-direction with a width in the Z-direction of 1.5 [m] (the other directions are ignored) centered at X=0, Y=0, Z=0.75 [m].
+example:
 
-    >>> osr.add_bfield_uniform(bfield=[0, 1, 0], width=[0, 0, 1.5], translation=[0, 0, 0.75])
+   .. code-block:: py
 
-Add a field of 1 [T] in the X-direction in a volume of dimensions 1m x 1m x 1m.
+      # First set the start and stop times
+      osr.set_ctstartstop(0, 2)
 
-    >>> osr.add_bfield_uniform(bfield=[1, 0, 0], width=[1, 1, 1])
+      # Use 12345 points in the trajectory calculations
+      osr.set_npoints_trajectory(12345)
 )docstring";
-static PyObject* OSCARSSR_AddMagneticFieldUniform (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_SetNPointsTrajectory (OSCARSSRObject* self, PyObject* arg)
 {
-  // Add a uniform field with a given width in a given direction, or for all space
-
-  // Lists and vectors
-  PyObject*   List_Field       = PyList_New(0);
-  PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Width       = PyList_New(0);
-  char const* Name             = "";
+  // Set the number of points for trajectory calculation
 
-  TVector3D Field(0, 0, 0);
-  TVector3D Width (0, 0, 0);
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
+  // Grab the value from input
+  size_t N = PyLong_AsSsize_t(arg);
 
+  // Set the object variable
+  self->obj->SetNPointsTrajectory(N);
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"bfield",
-                                 "width",
-                                 "rotations",
-                                 "translation",
-                                 "name",
-                                 NULL};
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOOs",
-                                   const_cast<char **>(kwlist),
-                                   &List_Field,
-                                   &List_Width,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &Name
-                                   )) {
-    return NULL;
-  }
 
 
-  // Check Field
-  try {
-    Field = OSCARSPY::ListAsTVector3D(List_Field);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
-    return NULL;
-  }
 
-  // Check Width
-  if (PyList_Size(List_Width) != 0) {
-    try {
-      Width = OSCARSPY::ListAsTVector3D(List_Width);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
-      return NULL;
-    }
-  }
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
-    try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
-      return NULL;
-    }
-  }
 
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
-    try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
-      return NULL;
-    }
-  }
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
-    return NULL;
-  }
+const char* DOC_OSCARSSR_SetNPointsPerMeterTrajectory = R"docstring(
+set_npoints_per_meter_trajectory(npoints)
 
-  // Add the field
-  self->obj->AddMagneticField((TField*) new TField3D_UniformBox(Field, Width, Translation, Rotations, Name));
+Sets the number of points per meter to be used in the trajectory calculation.
+
+Parameters
+----------
+npoints : int
+    Number of points per neter
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_SetNPointsPerMeterTrajectory (OSCARSSRObject* self, PyObject* arg)
+{
+  // Set the number of points for trajectory calculation
+
+  // Grab the value from input
+  size_t N = PyLong_AsSsize_t(arg);
+
+  // Set the object variable
+  self->obj->SetNPointsPerMeterTrajectory(N);
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1200,24 +1117,38 @@ static PyObject* OSCARSSR_AddMagneticFieldUniform (OSCARSSRObject* self, PyObjec
 
 
 
-const char* DOC_OSCARSSR_AddMagneticFieldIdealUndulator = R"docstring(
-add_bfield_undulator(bfield, period, nperiods [, phase, rotations, translation, taper, name])
 
-Adds an ideal sinusoidal undulator field with a given maximum bfield amplitude, period, and number of periods.  Optionally one can specify the phase offset (in [rad]), rotations and translation.  The number of periods given is the full number of fields not counting the terminating fields.
+
+
+const char* DOC_OSCARSSR_AddMagneticField = R"docstring(
+add_bfield_file([, ifile, bifile, iformat, rotations, translation, scale, name])
+
+Add a magnetic field from a text file *ifile* according to the format *iformat*.
+
+Currently OSCARS accepts the following file formats for iformat
+    * 'OSCARS'
+    * 'OSCARS1D [plus format string]'
+    * 'SPECTRA'
+    * 'SRW'
+
+For the OSCARS1D format you must also include the order of the data columns, which would typically look something like: 'OSCARS1D Z Bx By Bz'.  You may use X or Y instead of Z and the order and number of B[xyz] does not matter.  This mode also accepts non-uniformly distributed data.
+
+Optionally you can rotate and translate the field in space.  You can use an input *scale* list to scale the input (which must be in SI units of [m] for distances/positions and [T] for magnetic field values.
+
+The rotation is performed first in the order: :math:`\theta_x, \theta_y, \theta_z`
+
+*scale* is a list of less than or equal length to the number of elements in *iformat* when OSCARS1D is selected.  This will scale the input values of the i-th column before any rotation or translation.  This is useful if your data file is not in [T] and [m]
 
 Parameters
 ----------
-bfield : list
-    A list representing the peak field [Bx, By, Bz] in [T]
-
-period : list
-    Length of one period
+ifile : str
+    Name of input file
 
-nperiods : int
-    Number of periods
+bifile : str
+    Name of binary input file
 
-phase : float
-    Phase offset in [rad]
+iformat : str
+    Format of the input file.  Must be specified with ifile, but not with bifile
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -1225,11 +1156,11 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
-taper : float
-    The fractional change of the bfield per meter along the magnetic axis
+scale : list, optional
+    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
 
 name : str
-    Name of this field
+    Name of this magnetic field
 
 Returns
 -------
@@ -1237,68 +1168,61 @@ None
 
 Examples
 --------
-Add an idealized undulator with 41 periods having a period of 0.050 [m] with a maximum field of 1 [T] in the y-direction where the magnetic axis is along the z-axis
+Add a magnetic field from a data file where the data is in columns in the order Z Bx By Bz
 
-    >>> osr.add_bfield_undulator(bfield=[0, 1, 0], period=[0, 0, 0.050], nperiods=41)
+    >>> osr.add_bfield_file(ifile='file.txt', iformat='OSCARS1D Z Bx By Bz')
 )docstring";
-static PyObject* OSCARSSR_AddMagneticFieldIdealUndulator (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a magnetic field for undulator
+  // Add a magnetic field from a file.
+  // UPDATE: add binary file reading
 
-  // Lists and variables
-  PyObject*   List_Field       = PyList_New(0);
-  PyObject*   List_Period      = PyList_New(0);
+
+  // Grab the values
+  char const* FileNameText     = "";
+  char const* FileNameBinary   = "";
+  char const* FileFormat       = "";
   PyObject*   List_Rotations   = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
-  int         NPeriods         = 0;
-  double      Phase            = 0;
-  double      Taper            = 0;
+  PyObject*   List_Scaling     = PyList_New(0);
   char const* Name             = "";
 
-  TVector3D Field(0, 0, 0);
-  TVector3D Period(0, 0, 0);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
+  std::vector<double> Scaling;
+
 
   // Input variables and parsing
-  static const char *kwlist[] = {"bfield",
-                                 "period",
-                                 "nperiods",
-                                 "phase",
+  static const char *kwlist[] = {"ifile",
+                                 "bifile",
+                                 "iformat",
                                  "rotations",
                                  "translation",
-                                 "taper",
+                                 "scale",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|dOOds",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|sssOOOs",
                                    const_cast<char **>(kwlist),
-                                   &List_Field,
-                                   &List_Period,
-                                   &NPeriods,
-                                   &Phase,
+                                   &FileNameText,
+                                   &FileNameBinary,
+                                   &FileFormat,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &Taper,
-                                   &Name
-                                   )) {
+                                   &List_Scaling,
+                                   &Name)) {
     return NULL;
   }
 
-
-  // Check Field
-  try {
-    Field = OSCARSPY::ListAsTVector3D(List_Field);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
+  // Check that ifile and bifile both not input
+  if (std::strlen(FileNameText) != 0 && std::strlen(FileNameBinary) != 0) {
+    PyErr_SetString(PyExc_ValueError, "cannot specify both 'ifile' and 'bifile'");
     return NULL;
   }
 
-  // Check Period
-  try {
-    Period = OSCARSPY::ListAsTVector3D(List_Period);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'period'");
+  // Check that filename and format exist
+  if (std::strlen(FileNameText) != 0 && std::strlen(FileFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
     return NULL;
   }
 
@@ -1322,21 +1246,29 @@ static PyObject* OSCARSSR_AddMagneticFieldIdealUndulator (OSCARSSRObject* self,
     }
   }
 
+  // Get any scaling factors
+  // UPDATE: Check against fileformat number of strings
+  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
+    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
+  }
+
   // Name check
   if (std::string(Name).size() > 0 && Name[0] == '_') {
     PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-
-  // Rotate field and sigma
-  // UPDATE: check this
-  Field.RotateSelfXYZ(Rotations);
-  Period.RotateSelfXYZ(Rotations);
-
-
-  // Add field
-  self->obj->AddMagneticField( (TField*) new TField3D_IdealUndulator(Field, Period, NPeriods, Translation, Phase, Taper, Name));
+  // Add the magnetic field to the OSCARSSR object
+  try {
+    if (std::strlen(FileNameBinary) != 0) {
+      self->obj->AddMagneticField(FileNameBinary, "BINARY", Rotations, Translation, Scaling, Name);
+    } else {
+      self->obj->AddMagneticField(FileNameText, FileFormat, Rotations, Translation, Scaling, Name);
+    }
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check 'ifile' and 'iformat' are correct");
+    return NULL;
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1349,28 +1281,21 @@ static PyObject* OSCARSSR_AddMagneticFieldIdealUndulator (OSCARSSRObject* self,
 
 
 
-const char* DOC_OSCARSSR_AddMagneticFieldQuadrupole = R"docstring(
-add_bfield_quadrupole(K, width [, rotations, translation, name])
-
-Adds a quadrupole field in a given volume according to:
-
-.. math::
-
-    Bx = K * y
-
-    By = K * x
-
-    Bz = 0
+const char* DOC_OSCARSSR_AddMagneticFieldInterpolated = R"docstring(
+add_bfield_interpolated(mapping, iformat, parameter [, rotations, translation, scale, name])
 
-For other directions or rotated skew quad fields one can use the *rotations* parameter
+Add field given a paramater and a mapping between known parameters and field data files where the field is interpolated from the known data points.
 
 Parameters
 ----------
-K : float
-    Quadrupole strength given in [T/m]
+mapping : list [[float, str], [float, str], ...]
+    List of parameters and associated filenames [[p1, file1], [p2, file2], ...]
 
-width : float
-    length in z direction (quadrupole axis direction)
+iformat : str
+    Which input format to use (see add_bfield_file() for formats)
+
+parameter : float
+    Value of parameter you are interested in
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -1378,47 +1303,96 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
+scale : list, optional
+    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
+
 name : str
-    Name of this field
+    Name of this magnetic field
 
 Returns
 -------
 None
-)docstring";
-static PyObject* OSCARSSR_AddMagneticFieldQuadrupole (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a magnetic field for undulator
 
-  // UPDATE: Add axis [x, y, z] to be like others
-  // Lists and variables
-  double K = 0;
-  double Width = 0;
+Examples
+--------
+Undulator gap interpolation between known magnetic measurement points
+
+    >>> file_list = [
+    ...     [10.9, 'file_10.9.dat'],
+    ...     [11.0, 'file_11.0.dat'],
+    ...     [13.2, 'file_13.2.dat'],
+    ...     [16.9, 'file_16.9.dat']
+    ... ]
+    >>> osr.add_bfield_interpolated(mapping=file_list, iformat='OSCARS1D Z Bx By Bz', parameter=12.123)
+)docstring";
+static PyObject* OSCARSSR_AddMagneticFieldInterpolated (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add a magnetic field from a file.
+  // UPDATE: add binary file reading
+
+  // Grab the values
+  PyObject*   List_Mapping     = PyList_New(0);
+  char const* FileFormat       = "";
+  double      Parameter        = 0;
   PyObject*   List_Rotations   = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
+  PyObject*   List_Scaling     = PyList_New(0);
   char const* Name             = "";
 
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
+  std::vector<double> Scaling;
+
+  // Mapping that is passed in for field interpolation
+  std::vector<std::pair<double, std::string> > Mapping;
 
   // Input variables and parsing
-  static const char *kwlist[] = {"K",
-                                 "width",
+  static const char *kwlist[] = {"mapping",
+                                 "iformat",
+                                 "parameter",
                                  "rotations",
                                  "translation",
+                                 "scale",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dd|OOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Osd|OOOs",
                                    const_cast<char **>(kwlist),
-                                   &K,
-                                   &Width,
+                                   &List_Mapping,
+                                   &FileFormat,
+                                   &Parameter,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &Name
-                                   )) {
+                                   &List_Scaling,
+                                   &Name)) {
+    return NULL;
+  }
+
+  // Grab mapping from input
+  if (PyList_Size(List_Mapping) != 0) {
+    double ParameterValue;
+    for (int i = 0; i != PyList_Size(List_Mapping); ++i) {
+      PyObject* ThisPair = PyList_GetItem(List_Mapping, i);
+      if (PyList_Size(ThisPair) != 2) {
+        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'mapping'");
+        return NULL;
+      }
+
+      ParameterValue = PyFloat_AsDouble(PyList_GetItem(ThisPair, 0));
+      std::string const FileName = OSCARSPY::GetAsString(PyList_GetItem(ThisPair, 1));
+
+      Mapping.push_back(std::make_pair(ParameterValue, FileName));
+    }
+  }
+
+
+  // Check that filename and format exist
+  if (std::strlen(FileFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
     return NULL;
   }
 
+  // Parameter value is what it is...
 
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
@@ -1430,6 +1404,7 @@ static PyObject* OSCARSSR_AddMagneticFieldQuadrupole (OSCARSSRObject* self, PyOb
     }
   }
 
+
   // Check for Translation in the input
   if (PyList_Size(List_Translation) != 0) {
     try {
@@ -1440,14 +1415,25 @@ static PyObject* OSCARSSR_AddMagneticFieldQuadrupole (OSCARSSRObject* self, PyOb
     }
   }
 
+  // Get any scaling factors
+  // UPDATE: Check against fileformat number of strings
+  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
+    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
+  }
+
   // Name check
   if (std::string(Name).size() > 0 && Name[0] == '_') {
     PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-  // Add field
-  self->obj->AddMagneticField( (TField*) new TField3D_Quadrupole(K, Width, Rotations, Translation, Name));
+  // Add the magnetic field to the OSCARSSR object
+  try {
+    self->obj->AddMagneticFieldInterpolated(Mapping, FileFormat, Parameter, Rotations, Translation, Scaling, Name);
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check filenames and 'iformat' are correct");
+    return NULL;
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1456,39 +1442,72 @@ static PyObject* OSCARSSR_AddMagneticFieldQuadrupole (OSCARSSRObject* self, PyOb
 
 
 
-const char* DOC_OSCARSSR_RemoveMagneticField = R"docstring(
-remove_bfield(name)
 
-Remove all fields with the given name
+
+
+
+const char* DOC_OSCARSSR_AddMagneticFieldFunction = R"docstring(
+add_bfield_function(func [, name])
+
+Adds field in the form of a user defined python function.  The input for this function must be (x, y, z, t) and return [Fx, Fy, Fz]
 
 Parameters
 ----------
+
+function : func
+    A python function with input [x, y, z, t] and return of [Fx, Fy, Fz]
+
 name : str
-    Name of field to remove
+    Name of this field
 
 Returns
 -------
 None
+
+Examples
+--------
+Create a function in python and use it as a field in OSCARS
+
+    >>> def myfunc(x, y, z, t):
+    ...     "Do not forget to write a docstring"
+    ...     if z > 0:
+    ...         return 1
+    ...     return 0
+    >>> osr.add_bfield_function(myfunc)
 )docstring";
-static PyObject* OSCARSSR_RemoveMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticFieldFunction (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Remove magnetic field
+  // Add a python function as a magnetic field object
 
+  // Variables for function and name
+  PyObject* Function;
   char const* Name = "";
 
   // Input variables and parsing
-  static const char *kwlist[] = {"name",
+  static const char *kwlist[] = {"function",
+                                 "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|s",
                                    const_cast<char **>(kwlist),
-                                   &Name
-                                   )) {
+                                   &Function,
+                                   &Name)) {
     return NULL;
   }
 
-  // Remove fields with name name
-  self->obj->RemoveMagneticField(Name);
+  // Increment ref to function for python
+  Py_INCREF(Function);
+
+  // Add the function as a field to the OSCARSSR object
+  try {
+    self->obj->AddMagneticField( (TField*) new TFieldPythonFunction(Function, Name));
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Decrement reference to function for python
+  Py_DECREF(Function);
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1498,108 +1517,129 @@ static PyObject* OSCARSSR_RemoveMagneticField (OSCARSSRObject* self, PyObject* a
 
 
 
-const char* DOC_OSCARSSR_GetBField = R"docstring(
-get_bfield(x)
 
-Get the 3D field at any point in space.  This is the sum of all fields added to this OSCARS object.
+
+
+const char* DOC_OSCARSSR_AddMagneticFieldGaussian = R"docstring(
+add_bfield_gaussian(bfield, sigma [, rotations, translation, name])
+
+Add a gaussian field in 3D with the peak field magnitude and direction given by *bfield*, centered about a point with a given sigma in each coordinate.  If any component of *sigma* is less than or equal to zero it is ignored (ie. spatial extent is infinite).
+
+The functional form for this is :math:`\exp(-(x - x_0)^2 / \sigma_x^2)`
+
 
 Parameters
 ----------
-x : list
-    A 3D list representing a point in space [x, y, z]
+bfield : list
+    A list representing the peak field [Fx, Fy, Fz]
+
+sigma : list
+    A list representing the sigma in each coordinate :math:`[\sigma_x, \sigma_y, \sigma_z]`
+
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+name : str
+    Name of this field
 
 Returns
 -------
-bfield : [float, float, float]
-    list representing the field [Fx, Fy, Fz]
+None
+
+Examples
+--------
+Add a field of 0.5 [T] in the X-direction centered at X=0, Y=0, Z=0 [m], with a sigma of 0.1 [m] in the Z-direction
+
+    >>> osr.add_bfield_gaussian(bfield=[1, 0, 0], sigma=[0, 0, 0.10])
+
+Add a field of 1 [T] in the Y-direction centered at X=1, Y=1, Z=1 [m], with a sigma of 0.05 in the Z-direction
+
+    >>> osr.add_bfield_gaussian(bfield=[0, 1, 0], sigma=[0, 0, 0.05], translation=[1, 1, 1])
 )docstring";
-static PyObject* OSCARSSR_GetBField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticFieldGaussian (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Get the magnetic field at a point as a 3D list [Bx, By, Bz]
+  // Add a magnetic field that is a gaussian
 
-  // Python list object
-  PyObject* List = 0x0;//PyList_New(0);;
+  // Lists and variables
+  PyObject* List_BField       = PyList_New(0);
+  PyObject* List_Translation  = PyList_New(0);
+  PyObject* List_Rotations    = PyList_New(0);
+  PyObject* List_Sigma        = PyList_New(0);
+  const char* Name            = "";
 
-  static const char *kwlist[] = {"x",
+  TVector3D BField(0, 0, 0);
+  TVector3D Sigma(0, 0, 0);
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
+
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"bfield",
+                                 "sigma",
+                                 "rotations",
+                                 "translation",
+                                 "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OOs",
                                    const_cast<char **>(kwlist),
-                                   &List)) {
+                                   &List_BField,
+                                   &List_Sigma,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &Name)) {
     return NULL;
   }
 
-  // Grab the values
-  TVector3D X;
+
+
+  // Check BField
   try {
-    X = OSCARSPY::ListAsTVector3D(List);
+    BField = OSCARSPY::ListAsTVector3D(List_BField);
   } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in input");
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
     return NULL;
   }
 
-  // Set the object variable
-  TVector3D const B = self->obj->GetB(X);
-
-  // Create a python list
-  PyObject *PList = OSCARSPY::TVector3DAsList(B);
-
-  // Return the python list
-  return PList;
-}
-
-
+  // Check Width
+  try {
+    Sigma = OSCARSPY::ListAsTVector3D(List_Sigma);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
+    return NULL;
+  }
 
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
 
-const char* DOC_OSCARSSR_ClearMagneticFields = R"docstring(
-clear_bfields()
-
-Remove all of the existing magnetic fields
-
-Parameters
-----------
-None
-
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_ClearMagneticFields (OSCARSSRObject* self)
-{
-  // Clear all magnetic fields in the OSCARSSR object
-  self->obj->ClearMagneticFields();
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
-
-
-
-
-const char* DOC_OSCARSSR_PrintMagneticFields = R"docstring(
-print_bfields()
-
-Print information about all magnetic fields to standard out
-
-Parameters
-----------
-None
-
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_PrintMagneticFields (OSCARSSRObject* self)
-{
-  // Print all magnetic stored in OSCARSSR
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
 
-  // Out string stream for printing beam information
-  std::ostringstream ostream;
-  ostream << "*Magnetic Fields*\n";
-  ostream << self->obj->GetBFieldContainer() << std::endl;
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+    return NULL;
+  }
 
-  OSCARSPY::PyPrint_stdout(ostream.str());
+  // Add field
+  self->obj->AddMagneticField( (TField*) new TField3D_Gaussian(BField, Translation, Sigma, Rotations, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1612,38 +1652,18 @@ static PyObject* OSCARSSR_PrintMagneticFields (OSCARSSRObject* self)
 
 
 
+const char* DOC_OSCARSSR_AddMagneticFieldUniform = R"docstring(
+add_bfield_uniform(bfield [, width, rotations, translation, name])
 
-
-
-
-
-
-const char* DOC_OSCARSSR_AddElectricField = R"docstring(
-add_efield_file(ifile, iformat [, rotations, translation, scale, name])
-
-Add a electric field from a text file *ifile* according to the format *iformat*.
-
-Currently OSCARS accepts the following file formats for iformat
-    * 'OSCARS'
-    * 'OSCARS1D [plus format string]'
-    * 'SPECTRA'
-    * 'SRW'
-
-For the OSCARS1D format you must also include the order of the data columns, which would typically look something like: 'OSCARS1D Z Ex Ey Ez'.  You may use X or Y instead of Z and the order and number of E[xyz] does not matter.  This mode also accepts non-uniformly distributed data.
-
-Optionally you can rotate and translate the field in space.  You can use an input *scale* list to scale the input (which must be in SI units of [m] for distances/positions and [V/m] for electric field values.
-
-The rotation is performed first in the order: :math:`\theta_x, \theta_y, \theta_z`
-
-*scale* is a list of less than or equal length to the number of elements in *iformat* when OSCARS1D is selected.  This will scale the input values of the i-th column before any rotation or translation.  This is useful if your data file is not in [V/m] and [m]
+Add a uniform field in a given range or for all space.  The *bfield* is given as a 3D vector representing the field magnitude and direction.  *width* is an optional parameters, if not present the field permeates all space.  If a component of the 3D list *width* is less than or equal to zero, that coordinate will be ignored when calculating the field.
 
 Parameters
 ----------
-ifile : str
-    Name of input file
+bfield : list
+    A list representing the field [Fx, Fy, Fz]
 
-iformat : str
-    Format of the input file
+width : list
+    A list representing the spetial extent of the field [Wx, Wy, Wz]
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -1651,9 +1671,6 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
-scale : list, optional
-    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
-
 name : str
     Name of this field
 
@@ -1663,55 +1680,73 @@ None
 
 Examples
 --------
-Add a field from a data file where the data is in columns in the order Z Ex Ey Ez
+Add a field of 0.0001 [T] in the X-direction for all space
 
-    >>> osr.add_bfield_file(ifile='file.txt', iformat='OSCARS1D Z Bx By Bz')
+    >>> osr.add_bfield_uniform(bfield=[0.0001, 0, 0])
+
+Add a field of 0.0005 [T] in the Y-direction with a width in the Z-direction of 1.5 [m] (the other directions are ignored) centered at X=0, Y=0, Z=0.75 [m].
+
+    >>> osr.add_bfield_uniform(bfield=[0, 1, 0], width=[0, 0, 1.5], translation=[0, 0, 0.75])
+
+Add a field of 1 [T] in the X-direction in a volume of dimensions 1m x 1m x 1m.
+
+    >>> osr.add_bfield_uniform(bfield=[1, 0, 0], width=[1, 1, 1])
 )docstring";
-static PyObject* OSCARSSR_AddElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticFieldUniform (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a field from a file.
-  // UPDATE: add binary file reading
-
+  // Add a uniform field with a given width in a given direction, or for all space
 
-  // Grab the values
-  char const* FileName = "";
-  char const* FileFormat = "";
-  PyObject*   List_Rotations   = PyList_New(0);
+  // Lists and vectors
+  PyObject*   List_Field       = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Scaling     = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Width       = PyList_New(0);
   char const* Name             = "";
 
+  TVector3D Field(0, 0, 0);
+  TVector3D Width (0, 0, 0);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
-  std::vector<double> Scaling;
 
 
   // Input variables and parsing
-  static const char *kwlist[] = {"ifile",
-                                 "iformat",
+  static const char *kwlist[] = {"bfield",
+                                 "width",
                                  "rotations",
                                  "translation",
-                                 "scale",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "ss|OOOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOOs",
                                    const_cast<char **>(kwlist),
-                                   &FileName,
-                                   &FileFormat,
+                                   &List_Field,
+                                   &List_Width,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &List_Scaling,
-                                   &Name)) {
+                                   &Name
+                                   )) {
     return NULL;
   }
 
-  // Check that filename and format exist
-  if (std::strlen(FileName) == 0 || std::strlen(FileFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'ifile' or 'iformat' is blank");
+
+  // Check Field
+  try {
+    Field = OSCARSPY::ListAsTVector3D(List_Field);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
     return NULL;
   }
 
+  // Check Width
+  if (PyList_Size(List_Width) != 0) {
+    try {
+      Width = OSCARSPY::ListAsTVector3D(List_Width);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
+      return NULL;
+    }
+  }
+
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
     try {
@@ -1722,7 +1757,6 @@ static PyObject* OSCARSSR_AddElectricField (OSCARSSRObject* self, PyObject* args
     }
   }
 
-
   // Check for Translation in the input
   if (PyList_Size(List_Translation) != 0) {
     try {
@@ -1733,25 +1767,14 @@ static PyObject* OSCARSSR_AddElectricField (OSCARSSRObject* self, PyObject* args
     }
   }
 
-  // Get any scaling factors
-  // UPDATE: Check against fileformat number of strings
-  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
-    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
-  }
-
   // Name check
   if (std::string(Name).size() > 0 && Name[0] == '_') {
     PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-  // Add the magnetic field to the OSCARSSR object
-  try {
-    self->obj->AddElectricField(FileName, FileFormat, Rotations, Translation, Scaling, Name);
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Could not import electric field.  Check 'ifile' and 'iformat' are correct");
-    return NULL;
-  }
+  // Add the field
+  self->obj->AddMagneticField((TField*) new TField3D_UniformBox(Field, Width, Translation, Rotations, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1761,24 +1784,24 @@ static PyObject* OSCARSSR_AddElectricField (OSCARSSRObject* self, PyObject* args
 
 
 
+const char* DOC_OSCARSSR_AddMagneticFieldIdealUndulator = R"docstring(
+add_bfield_undulator(bfield, period, nperiods [, phase, rotations, translation, taper, name])
 
-
-
-const char* DOC_OSCARSSR_AddElectricFieldInterpolated = R"docstring(
-add_efield_interpolated(mapping, iformat, parameter [, rotations, translation, scale, name])
-
-Add field given a paramater and a mapping between known parameters and field data files where the field is interpolated from the known data points.
+Adds an ideal sinusoidal undulator field with a given maximum bfield amplitude, period, and number of periods.  Optionally one can specify the phase offset (in [rad]), rotations and translation.  The number of periods given is the full number of fields not counting the terminating fields.
 
 Parameters
 ----------
-mapping : list [[float, str], [float, str], ...]
-    List of parameters and associated filenames [[p1, file1], [p2, file2], ...]
+bfield : list
+    A list representing the peak field [Bx, By, Bz] in [T]
 
-iformat : str
-    Which input format to use (see add_efield_file() for formats)
+period : list
+    Length of one period
 
-parameter : float
-    Value of parameter you are interested in
+nperiods : int
+    Number of periods
+
+phase : float
+    Phase offset in [rad]
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -1786,8 +1809,8 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
-scale : list, optional
-    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
+taper : float
+    The fractional change of the bfield per meter along the magnetic axis
 
 name : str
     Name of this field
@@ -1798,76 +1821,70 @@ None
 
 Examples
 --------
-See add_bfield_interpolated() for examples
+Add an idealized undulator with 41 periods having a period of 0.050 [m] with a maximum field of 1 [T] in the y-direction where the magnetic axis is along the z-axis
+
+    >>> osr.add_bfield_undulator(bfield=[0, 1, 0], period=[0, 0, 0.050], nperiods=41)
 )docstring";
-static PyObject* OSCARSSR_AddElectricFieldInterpolated (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticFieldIdealUndulator (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a magnetic field from a file.
-  // UPDATE: add binary file reading
+  // Add a magnetic field for undulator
 
-  // Grab the values
-  PyObject*   List_Mapping     = PyList_New(0);
-  char const* FileFormat       = "";
-  double      Parameter        = 0;
+  // Lists and variables
+  PyObject*   List_Field       = PyList_New(0);
+  PyObject*   List_Period      = PyList_New(0);
   PyObject*   List_Rotations   = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Scaling     = PyList_New(0);
+  int         NPeriods         = 0;
+  double      Phase            = 0;
+  double      Taper            = 0;
   char const* Name             = "";
 
+  TVector3D Field(0, 0, 0);
+  TVector3D Period(0, 0, 0);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
-  std::vector<double> Scaling;
-
-  // Mapping that is passed in for field interpolation
-  std::vector<std::pair<double, std::string> > Mapping;
 
   // Input variables and parsing
-  static const char *kwlist[] = {"mapping",
-                                 "iformat",
-                                 "parameter",
+  static const char *kwlist[] = {"bfield",
+                                 "period",
+                                 "nperiods",
+                                 "phase",
                                  "rotations",
                                  "translation",
-                                 "scale",
+                                 "taper",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Osd|OOOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|dOOds",
                                    const_cast<char **>(kwlist),
-                                   &List_Mapping,
-                                   &FileFormat,
-                                   &Parameter,
+                                   &List_Field,
+                                   &List_Period,
+                                   &NPeriods,
+                                   &Phase,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &List_Scaling,
-                                   &Name)) {
-    return NULL;
-  }
-
-  // Grab mapping from input
-  if (PyList_Size(List_Mapping) != 0) {
-    double ParameterValue;
-    for (int i = 0; i != PyList_Size(List_Mapping); ++i) {
-      PyObject* ThisPair = PyList_GetItem(List_Mapping, i);
-      if (PyList_Size(ThisPair) != 2) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'mapping'");
-        return NULL;
-      }
-
-      ParameterValue = PyFloat_AsDouble(PyList_GetItem(ThisPair, 0));
-      std::string const FileName = OSCARSPY::GetAsString(PyList_GetItem(ThisPair, 1));
-
-      Mapping.push_back(std::make_pair(ParameterValue, FileName));
-    }
+                                   &Taper,
+                                   &Name
+                                   )) {
+    return NULL;
   }
 
 
-  // Check that filename and format exist
-  if (std::strlen(FileFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
+  // Check Field
+  try {
+    Field = OSCARSPY::ListAsTVector3D(List_Field);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
     return NULL;
   }
 
-  // Parameter value is what it is...
+  // Check Period
+  try {
+    Period = OSCARSPY::ListAsTVector3D(List_Period);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'period'");
+    return NULL;
+  }
 
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
@@ -1879,7 +1896,6 @@ static PyObject* OSCARSSR_AddElectricFieldInterpolated (OSCARSSRObject* self, Py
     }
   }
 
-
   // Check for Translation in the input
   if (PyList_Size(List_Translation) != 0) {
     try {
@@ -1890,25 +1906,21 @@ static PyObject* OSCARSSR_AddElectricFieldInterpolated (OSCARSSRObject* self, Py
     }
   }
 
-  // Get any scaling factors
-  // UPDATE: Check against fileformat number of strings
-  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
-    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
-  }
-
   // Name check
   if (std::string(Name).size() > 0 && Name[0] == '_') {
     PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-  // Add the magnetic field to the OSCARSSR object
-  try {
-    self->obj->AddElectricFieldInterpolated(Mapping, FileFormat, Parameter, Rotations, Translation, Scaling, Name);
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check filenames and 'iformat' are correct");
-    return NULL;
-  }
+
+  // Rotate field and sigma
+  // UPDATE: check this
+  Field.RotateSelfXYZ(Rotations);
+  Period.RotateSelfXYZ(Rotations);
+
+
+  // Add field
+  self->obj->AddMagneticField( (TField*) new TField3D_IdealUndulator(Field, Period, NPeriods, Translation, Phase, Taper, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -1921,95 +1933,28 @@ static PyObject* OSCARSSR_AddElectricFieldInterpolated (OSCARSSRObject* self, Py
 
 
 
-const char* DOC_OSCARSSR_AddElectricFieldFunction = R"docstring(
-add_efield_function(func [, name])
-
-Adds field in the form of a user defined python function.  The input for this function must be (x, y, z, t) and return [Fx, Fy, Fz]
-
-Parameters
-----------
-
-function : func
-    A python function with input [x, y, z, t] and return of [Fx, Fy, Fz]
-
-name : str
-    Name of this field
-
-Returns
--------
-None
-
-Examples
---------
-Create a function in python and use it as a field in OSCARS
-
-    >>> def myfunc(x, y, z, t):
-    ...     "Do not forget to write a docstring"
-    ...     if z > 0:
-    ...         return 1
-    ...     return 0
-    >>> osr.add_efield_function(myfunc)
-)docstring";
-static PyObject* OSCARSSR_AddElectricFieldFunction (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a python function as an electric field object
-
-  // Variables for function and name
-  PyObject* Function;
-  char const* Name = "";
-
-  // Input variables and parsing
-  static const char *kwlist[] = {"function",
-                                 "name",
-                                 NULL};
-
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|s",
-                                   const_cast<char **>(kwlist),
-                                   &Function,
-                                   &Name)) {
-    return NULL;
-  }
-
-
-  // Increment ref to function for python
-  Py_INCREF(Function);
-
-  // Add the function as a field to the OSCARSSR object
-  try {
-    self->obj->AddElectricField( (TField*) new TFieldPythonFunction(Function, Name));
-  } catch (std::invalid_argument e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
-    return NULL;
-  }
-
-  // Decrement reference to function for python
-  Py_DECREF(Function);
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
-
-
-
+const char* DOC_OSCARSSR_AddMagneticFieldQuadrupole = R"docstring(
+add_bfield_quadrupole(K, width [, rotations, translation, name])
 
+Adds a quadrupole field in a given volume according to:
 
+.. math::
 
+    Bx = K * y
 
-const char* DOC_OSCARSSR_AddElectricFieldGaussian = R"docstring(
-add_efield_gaussian(efield, sigma [, rotations, translation])
+    By = K * x
 
-Add a gaussian field in 3D with the peak field magnitude and direction given by *efield*, centered about a point with a given sigma in each coordinate.  If any component of *sigma* is less than or equal to zero it is ignored (ie. spatial extent is infinite).
+    Bz = 0
 
-The functional form for this is :math:`\exp(-(x - x_0)^2 / \sigma_x^2)`
+For other directions or rotated skew quad fields one can use the *rotations* parameter
 
 Parameters
 ----------
-efield : list
-    A list representing the peak field [Fx, Fy, Fz]
+K : float
+    Quadrupole strength given in [T/m]
 
-sigma : list
-    A list representing the sigma in each coordinate :math:`[\sigma_x, \sigma_y, \sigma_z]`
+width : float
+    length in z direction (quadrupole axis direction)
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -2017,72 +1962,47 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
+name : str
+    Name of this field
+
 Returns
 -------
 None
-
-Examples
---------
-Add a field of 0.5 [V/m] in the X-direction centered at X=0, Y=0, Z=0 [m], with a sigma of 0.1 [m] in the Z-direction
-
-    >>> osr.add_efield_gaussian(efield=[1, 0, 0], sigma=[0, 0, 0.10])
-
-Add a field of 1 [V/m] in the Y-direction centered at X=1, Y=1, Z=1 [m], with a sigma of 0.05 in the Z-direction
-
-    >>> osr.add_efield_gaussian(efield=[0, 1, 0], sigma=[0, 0, 0.05], translation=[1, 1, 1])
 )docstring";
-static PyObject* OSCARSSR_AddElectricFieldGaussian (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddMagneticFieldQuadrupole (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add an electric field that is a gaussian
+  // Add a magnetic field for undulator
 
+  // UPDATE: Add axis [x, y, z] to be like others
   // Lists and variables
-  PyObject* List_Field       = PyList_New(0);
-  PyObject* List_Translation  = PyList_New(0);
-  PyObject* List_Rotations    = PyList_New(0);
-  PyObject* List_Sigma        = PyList_New(0);
-  const char* Name            = "";
+  double K = 0;
+  double Width = 0;
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Translation = PyList_New(0);
+  char const* Name             = "";
 
-  TVector3D Field(0, 0, 0);
-  TVector3D Sigma(0, 0, 0);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
 
-
   // Input variables and parsing
-  static const char *kwlist[] = {"efield",
-                                 "sigma",
+  static const char *kwlist[] = {"K",
+                                 "width",
                                  "rotations",
                                  "translation",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dd|OOs",
                                    const_cast<char **>(kwlist),
-                                   &List_Field,
-                                   &List_Sigma,
+                                   &K,
+                                   &Width,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &Name)) {
-    return NULL;
-  }
-
-
-
-  // Check Field
-  try {
-    Field = OSCARSPY::ListAsTVector3D(List_Field);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'efield'");
+                                   &Name
+                                   )) {
     return NULL;
   }
 
-  // Check Width
-  try {
-    Sigma = OSCARSPY::ListAsTVector3D(List_Sigma);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
-    return NULL;
-  }
 
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
@@ -2111,7 +2031,7 @@ static PyObject* OSCARSSR_AddElectricFieldGaussian (OSCARSSRObject* self, PyObje
   }
 
   // Add field
-  self->obj->AddElectricField( (TField*) new TField3D_Gaussian(Field, Translation, Sigma, Rotations, Name));
+  self->obj->AddMagneticField( (TField*) new TField3D_Quadrupole(K, Width, Rotations, Translation, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2120,133 +2040,118 @@ static PyObject* OSCARSSR_AddElectricFieldGaussian (OSCARSSRObject* self, PyObje
 
 
 
+const char* DOC_OSCARSSR_RemoveMagneticField = R"docstring(
+remove_bfield(name)
 
-
-
-
-const char* DOC_OSCARSSR_AddElectricFieldUniform = R"docstring(
-add_efield_uniform(efield [, width, rotations, translation, name])
-
-Add a uniform field in a given range or for all space.  The *efield* is given as a 3D vector representing the field magnitude and direction.  *width* is an optional parameters, if not present the field permeates all space.  If a component of the 3D list *width* is less than or equal to zero, that coordinate will be ignored when calculating the field.
+Remove all fields with the given name
 
 Parameters
 ----------
-efield : list
-    A list representing the field [Fx, Fy, Fz]
-
-width : list
-    A list representing the spetial extent of the field [Wx, Wy, Wz]
-
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
-
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
-
 name : str
-    Name of this field
+    Name of field to remove
 
 Returns
 -------
 None
+)docstring";
+static PyObject* OSCARSSR_RemoveMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Remove magnetic field
 
-Examples
---------
-Add a field of 0.0001 [V/m] in the X-direction for all space
+  char const* Name = "";
 
-    >>> osr.add_efield_uniform(efield=[0.0001, 0, 0])
+  // Input variables and parsing
+  static const char *kwlist[] = {"name",
+                                 NULL};
 
-Add a field of 0.0005 [V/m] in the Y-direction with a width in the Z-direction of 1.5 [m] (the other directions are ignored) centered at X=0, Y=0, Z=0.75 [m].
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+                                   const_cast<char **>(kwlist),
+                                   &Name
+                                   )) {
+    return NULL;
+  }
 
-    >>> osr.add_efield_uniform(efield=[0, 1, 0], width=[0, 0, 1.5], translation=[0, 0, 0.75])
+  // Remove fields with name name
+  self->obj->RemoveMagneticField(Name);
 
-Add a field of 1 [V/m] in the X-direction in a volume of dimensions 1m x 1m x 1m.
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-    >>> osr.add_efield_uniform(efield=[1, 0, 0], width=[1, 1, 1])
-)docstring";
-static PyObject* OSCARSSR_AddElectricFieldUniform (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a uniform field with a given width in a given direction, or for all space
 
-  // Lists and vectors
-  PyObject*   List_Field       = PyList_New(0);
-  PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Width       = PyList_New(0);
-  char const* Name             = "";
 
-  TVector3D Field(0, 0, 0);
-  TVector3D Width (0, 0, 0);
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
 
+const char* DOC_OSCARSSR_GetBField = R"docstring(
+get_bfield(x)
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"efield",
-                                 "width",
-                                 "rotations",
-                                 "translation",
-                                 "name",
+Get the 3D field at any point in space.  This is the sum of all fields added to this OSCARS object.
+
+Parameters
+----------
+x : list
+    A 3D list representing a point in space [x, y, z]
+
+Returns
+-------
+bfield : [float, float, float]
+    list representing the field [Fx, Fy, Fz]
+)docstring";
+static PyObject* OSCARSSR_GetBField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Get the magnetic field at a point as a 3D list [Bx, By, Bz]
+
+  // Python list object
+  PyObject* List = 0x0;//PyList_New(0);;
+
+  static const char *kwlist[] = {"x",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O",
                                    const_cast<char **>(kwlist),
-                                   &List_Field,
-                                   &List_Width,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &Name
-                                   )) {
+                                   &List)) {
     return NULL;
   }
 
-
-  // Check Field
+  // Grab the values
+  TVector3D X;
   try {
-    Field = OSCARSPY::ListAsTVector3D(List_Field);
+    X = OSCARSPY::ListAsTVector3D(List);
   } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'efield'");
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in input");
     return NULL;
   }
 
-  // Check Width
-  if (PyList_Size(List_Width) != 0) {
-    try {
-      Width = OSCARSPY::ListAsTVector3D(List_Width);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
-      return NULL;
-    }
-  }
+  // Set the object variable
+  TVector3D const B = self->obj->GetB(X);
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
-    try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
-      return NULL;
-    }
-  }
+  // Create a python list
+  PyObject *PList = OSCARSPY::TVector3DAsList(B);
 
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
-    try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
-      return NULL;
-    }
-  }
+  // Return the python list
+  return PList;
+}
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
-    return NULL;
-  }
 
-  // Add the field
-  self->obj->AddElectricField((TField*) new TField3D_UniformBox(Field, Width, Translation, Rotations, Name));
+
+
+const char* DOC_OSCARSSR_ClearMagneticFields = R"docstring(
+clear_bfields()
+
+Remove all of the existing magnetic fields
+
+Parameters
+----------
+None
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_ClearMagneticFields (OSCARSSRObject* self)
+{
+  // Clear all magnetic fields in the OSCARSSR object
+  self->obj->ClearMagneticFields();
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2256,30 +2161,73 @@ static PyObject* OSCARSSR_AddElectricFieldUniform (OSCARSSRObject* self, PyObjec
 
 
 
+const char* DOC_OSCARSSR_PrintMagneticFields = R"docstring(
+print_bfields()
 
+Print information about all magnetic fields to standard out
 
+Parameters
+----------
+None
 
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_PrintMagneticFields (OSCARSSRObject* self)
+{
+  // Print all magnetic stored in OSCARSSR
 
+  // Out string stream for printing beam information
+  std::ostringstream ostream;
+  ostream << "*Magnetic Fields*\n";
+  ostream << self->obj->GetBFieldContainer() << std::endl;
 
+  OSCARSPY::PyPrint_stdout(ostream.str());
 
-const char* DOC_OSCARSSR_AddElectricFieldIdealUndulator = R"docstring(
-add_efield_undulator(efield, period, nperiods [, phase, rotations, translation, taper])
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-Adds an ideal sinusoidal undulator field with a given maximum efield amplitude, period, and number of periods.  Optionally one can specify the phase offset (in [rad]), rotations and translation.  The number of periods given is the full number of fields not counting the terminating fields.
 
-Parameters
-----------
-efield : list
-    A list representing the peak field [Fx, Fy, Fz] in [V/m]
 
-period : list
-    Length of one period
 
-nperiods : int
-    Number of periods
 
-phase : float
-    Phase offset in [rad]
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_AddElectricField = R"docstring(
+add_efield_file(ifile, iformat [, rotations, translation, scale, name])
+
+Add a electric field from a text file *ifile* according to the format *iformat*.
+
+Currently OSCARS accepts the following file formats for iformat
+    * 'OSCARS'
+    * 'OSCARS1D [plus format string]'
+    * 'SPECTRA'
+    * 'SRW'
+
+For the OSCARS1D format you must also include the order of the data columns, which would typically look something like: 'OSCARS1D Z Ex Ey Ez'.  You may use X or Y instead of Z and the order and number of E[xyz] does not matter.  This mode also accepts non-uniformly distributed data.
+
+Optionally you can rotate and translate the field in space.  You can use an input *scale* list to scale the input (which must be in SI units of [m] for distances/positions and [V/m] for electric field values.
+
+The rotation is performed first in the order: :math:`\theta_x, \theta_y, \theta_z`
+
+*scale* is a list of less than or equal length to the number of elements in *iformat* when OSCARS1D is selected.  This will scale the input values of the i-th column before any rotation or translation.  This is useful if your data file is not in [V/m] and [m]
+
+Parameters
+----------
+ifile : str
+    Name of input file
+
+iformat : str
+    Format of the input file
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -2287,8 +2235,8 @@ rotations : list, optional
 translation : list, optional
     3-element list representing a translation in space [x, y, z]
 
-taper : float
-    The fractional change of the efield per meter along the magnetic axis
+scale : list, optional
+    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
 
 name : str
     Name of this field
@@ -2299,68 +2247,52 @@ None
 
 Examples
 --------
-Add an idealized undulator with 41 periods having a period of 0.050 [m] with a maximum field of 1 [T] in the y-direction where the magnetic axis is along the z-axis
+Add a field from a data file where the data is in columns in the order Z Ex Ey Ez
 
-    >>> osr.add_efield_undulator(efield=[0, 1, 0], period=[0, 0, 0.050], nperiods=41)
+    >>> osr.add_bfield_file(ifile='file.txt', iformat='OSCARS1D Z Bx By Bz')
 )docstring";
-static PyObject* OSCARSSR_AddElectricFieldIdealUndulator (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add an electric field undulator to OSCARSSR
+  // Add a field from a file.
+  // UPDATE: add binary file reading
 
-  // Lists and variables
-  PyObject*   List_Field       = PyList_New(0);
-  PyObject*   List_Period      = PyList_New(0);
+
+  // Grab the values
+  char const* FileName = "";
+  char const* FileFormat = "";
   PyObject*   List_Rotations   = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
-  int         NPeriods         = 0;
-  double      Phase            = 0;
-  double      Taper            = 0;
+  PyObject*   List_Scaling     = PyList_New(0);
   char const* Name             = "";
 
-  TVector3D Field(0, 0, 0);
-  TVector3D Period(0, 0, 0);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
+  std::vector<double> Scaling;
+
 
   // Input variables and parsing
-  static const char *kwlist[] = {"efield",
-                                 "period",
-                                 "nperiods",
-                                 "phase",
+  static const char *kwlist[] = {"ifile",
+                                 "iformat",
                                  "rotations",
                                  "translation",
-                                 "taper",
+                                 "scale",
                                  "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|dOOds",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "ss|OOOs",
                                    const_cast<char **>(kwlist),
-                                   &List_Field,
-                                   &List_Period,
-                                   &NPeriods,
-                                   &Phase,
+                                   &FileName,
+                                   &FileFormat,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &Taper,
-                                   &Name
-                                   )) {
+                                   &List_Scaling,
+                                   &Name)) {
     return NULL;
   }
 
-
-  // Check Field
-  try {
-    Field = OSCARSPY::ListAsTVector3D(List_Field);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
-    return NULL;
-  }
-
-  // Check Period
-  try {
-    Period = OSCARSPY::ListAsTVector3D(List_Period);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'period'");
+  // Check that filename and format exist
+  if (std::strlen(FileName) == 0 || std::strlen(FileFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'ifile' or 'iformat' is blank");
     return NULL;
   }
 
@@ -2374,6 +2306,7 @@ static PyObject* OSCARSSR_AddElectricFieldIdealUndulator (OSCARSSRObject* self,
     }
   }
 
+
   // Check for Translation in the input
   if (PyList_Size(List_Translation) != 0) {
     try {
@@ -2384,21 +2317,25 @@ static PyObject* OSCARSSR_AddElectricFieldIdealUndulator (OSCARSSRObject* self,
     }
   }
 
+  // Get any scaling factors
+  // UPDATE: Check against fileformat number of strings
+  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
+    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
+  }
+
   // Name check
   if (std::string(Name).size() > 0 && Name[0] == '_') {
     PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-
-  // Rotate field and sigma
-  // UPDATE: check this
-  Field.RotateSelfXYZ(Rotations);
-  Period.RotateSelfXYZ(Rotations);
-
-
-  // Add field
-  self->obj->AddElectricField( (TField*) new TField3D_IdealUndulator(Field, Period, NPeriods, Translation, Phase, Taper, Name));
+  // Add the magnetic field to the OSCARSSR object
+  try {
+    self->obj->AddElectricField(FileName, FileFormat, Rotations, Translation, Scaling, Name);
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "Could not import electric field.  Check 'ifile' and 'iformat' are correct");
+    return NULL;
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2411,118 +2348,226 @@ static PyObject* OSCARSSR_AddElectricFieldIdealUndulator (OSCARSSRObject* self,
 
 
 
-const char* DOC_OSCARSSR_RemoveElectricField = R"docstring(
-remove_efield(name)
+const char* DOC_OSCARSSR_AddElectricFieldInterpolated = R"docstring(
+add_efield_interpolated(mapping, iformat, parameter [, rotations, translation, scale, name])
 
-Remove all fields with the given name
+Add field given a paramater and a mapping between known parameters and field data files where the field is interpolated from the known data points.
 
 Parameters
 ----------
+mapping : list [[float, str], [float, str], ...]
+    List of parameters and associated filenames [[p1, file1], [p2, file2], ...]
+
+iformat : str
+    Which input format to use (see add_efield_file() for formats)
+
+parameter : float
+    Value of parameter you are interested in
+
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+scale : list, optional
+    List of scale factors to be used for multiplying the inputs in the order of iformat (equal in length or less than the number of input parameters)
+
 name : str
-    Name of field to remove
+    Name of this field
 
 Returns
 -------
 None
+
+Examples
+--------
+See add_bfield_interpolated() for examples
 )docstring";
-static PyObject* OSCARSSR_RemoveElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddElectricFieldInterpolated (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Remove magnetic field
+  // Add a magnetic field from a file.
+  // UPDATE: add binary file reading
 
+  // Grab the values
+  PyObject*   List_Mapping     = PyList_New(0);
+  char const* FileFormat       = "";
+  double      Parameter        = 0;
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Translation = PyList_New(0);
+  PyObject*   List_Scaling     = PyList_New(0);
   char const* Name             = "";
 
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
+  std::vector<double> Scaling;
+
+  // Mapping that is passed in for field interpolation
+  std::vector<std::pair<double, std::string> > Mapping;
+
   // Input variables and parsing
-  static const char *kwlist[] = {"name",
+  static const char *kwlist[] = {"mapping",
+                                 "iformat",
+                                 "parameter",
+                                 "rotations",
+                                 "translation",
+                                 "scale",
+                                 "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "Osd|OOOs",
                                    const_cast<char **>(kwlist),
-                                   &Name
-                                   )) {
+                                   &List_Mapping,
+                                   &FileFormat,
+                                   &Parameter,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &List_Scaling,
+                                   &Name)) {
     return NULL;
   }
 
-  // Remove fields with name name
-  self->obj->RemoveElectricField(Name);
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
+  // Grab mapping from input
+  if (PyList_Size(List_Mapping) != 0) {
+    double ParameterValue;
+    for (int i = 0; i != PyList_Size(List_Mapping); ++i) {
+      PyObject* ThisPair = PyList_GetItem(List_Mapping, i);
+      if (PyList_Size(ThisPair) != 2) {
+        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'mapping'");
+        return NULL;
+      }
 
+      ParameterValue = PyFloat_AsDouble(PyList_GetItem(ThisPair, 0));
+      std::string const FileName = OSCARSPY::GetAsString(PyList_GetItem(ThisPair, 1));
 
+      Mapping.push_back(std::make_pair(ParameterValue, FileName));
+    }
+  }
 
 
-const char* DOC_OSCARSSR_GetEField = R"docstring(
-get_efield(x)
+  // Check that filename and format exist
+  if (std::strlen(FileFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'iformat' is blank");
+    return NULL;
+  }
 
-Get the 3D field at any point in space.  This is the sum of all fields added to this OSCARS object.
+  // Parameter value is what it is...
 
-Parameters
-----------
-x : list
-    A 3D list representing a point in space [x, y, z]
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
 
-Returns
--------
-bfield : [float, float, float]
-    list representing the field [Fx, Fy, Fz]
-)docstring";
-static PyObject* OSCARSSR_GetEField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Get the magnetic field at a point as a 3D list [Ex, Ey, Ez]
 
-  // Python list object
-  PyObject* List = PyList_New(0);
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
 
-  static const char *kwlist[] = {"x",
-                                 NULL};
+  // Get any scaling factors
+  // UPDATE: Check against fileformat number of strings
+  for (int i = 0; i < PyList_Size(List_Scaling); ++i) {
+    Scaling.push_back(PyFloat_AsDouble(PyList_GetItem(List_Scaling, i)));
+  }
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O",
-                                   const_cast<char **>(kwlist),
-                                   &List)) {
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
     return NULL;
   }
 
-  // Grab the values
-  TVector3D X;
+  // Add the magnetic field to the OSCARSSR object
   try {
-    X = OSCARSPY::ListAsTVector3D(List);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in input");
+    self->obj->AddElectricFieldInterpolated(Mapping, FileFormat, Parameter, Rotations, Translation, Scaling, Name);
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "Could not import magnetic field.  Check filenames and 'iformat' are correct");
     return NULL;
   }
 
-  // Set the object variable
-  TVector3D const F = self->obj->GetE(X);
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-  // Create a python list
-  PyObject *PList = OSCARSPY::TVector3DAsList(F);
 
-  // Return the python list
-  return PList;
-}
 
 
 
 
-const char* DOC_OSCARSSR_ClearElectricFields = R"docstring(
-clear_efields()
 
-Remove all of the existing electric fields.
+const char* DOC_OSCARSSR_AddElectricFieldFunction = R"docstring(
+add_efield_function(func [, name])
+
+Adds field in the form of a user defined python function.  The input for this function must be (x, y, z, t) and return [Fx, Fy, Fz]
 
 Parameters
 ----------
-None
+
+function : func
+    A python function with input [x, y, z, t] and return of [Fx, Fy, Fz]
+
+name : str
+    Name of this field
 
 Returns
 -------
 None
+
+Examples
+--------
+Create a function in python and use it as a field in OSCARS
+
+    >>> def myfunc(x, y, z, t):
+    ...     "Do not forget to write a docstring"
+    ...     if z > 0:
+    ...         return 1
+    ...     return 0
+    >>> osr.add_efield_function(myfunc)
 )docstring";
-static PyObject* OSCARSSR_ClearElectricFields (OSCARSSRObject* self)
+static PyObject* OSCARSSR_AddElectricFieldFunction (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Clear all magnetic fields in the OSCARSSR object
-  self->obj->ClearElectricFields();
+  // Add a python function as an electric field object
+
+  // Variables for function and name
+  PyObject* Function;
+  char const* Name = "";
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"function",
+                                 "name",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|s",
+                                   const_cast<char **>(kwlist),
+                                   &Function,
+                                   &Name)) {
+    return NULL;
+  }
+
+
+  // Increment ref to function for python
+  Py_INCREF(Function);
+
+  // Add the function as a field to the OSCARSSR object
+  try {
+    self->obj->AddElectricField( (TField*) new TFieldPythonFunction(Function, Name));
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Decrement reference to function for python
+  Py_DECREF(Function);
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2532,208 +2577,125 @@ static PyObject* OSCARSSR_ClearElectricFields (OSCARSSRObject* self)
 
 
 
-const char* DOC_OSCARSSR_PrintElectricFields = R"docstring(
-print_efields()
-
-Print information about all electric fields to the standard out
-
-Parameters
-----------
-None
-
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_PrintElectricFields (OSCARSSRObject* self)
-{
-  // Print all magnetic stored in OSCARSSR
-
-  // Out string stream for printing beam information
-  std::ostringstream ostream;
-  ostream << "*Electric Fields*\n";
-  ostream << self->obj->GetEFieldContainer() << std::endl;
-
-  OSCARSPY::PyPrint_stdout(ostream.str());
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
-
-
-
-
-
-
 
 
 
+const char* DOC_OSCARSSR_AddElectricFieldGaussian = R"docstring(
+add_efield_gaussian(efield, sigma [, rotations, translation])
 
+Add a gaussian field in 3D with the peak field magnitude and direction given by *efield*, centered about a point with a given sigma in each coordinate.  If any component of *sigma* is less than or equal to zero it is ignored (ie. spatial extent is infinite).
 
-
-
-
-
-
-const char* DOC_OSCARSSR_WriteMagneticField = R"docstring(
-write_bfield(oformat [, ofile, bofile, xlim, nx, ylim, ny, zlim, nz, comment, version])
-
-Write the field to ofile in the format described in oformat.  You must specify at least one limits and one number of points (e.g. zlim and nz).  All output is in SI units.
-
-The formats (*oformat*) available are:
-* OSCARS
-* OSCARS1D
-* SPECTRA
-* SRW
-
-For OSCARS1D you also must specify what you want in the output.  One spatial dimension must be specified along with at least one field dimension (in any order you like).  For examples theses are all valid: 'OSCARS1D Z Fx Fy Fz', 'OSCARS1D Fy Fx Z Fz'.
+The functional form for this is :math:`\exp(-(x - x_0)^2 / \sigma_x^2)`
 
 Parameters
 ----------
+efield : list
+    A list representing the peak field [Fx, Fy, Fz]
 
-oformat : str
-    Format of output file
-
-ofile : str
-    Name of output file
+sigma : list
+    A list representing the sigma in each coordinate :math:`[\sigma_x, \sigma_y, \sigma_z]`
 
-bofile : str
-    Name of binary output file
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-xlim : list
-    [min, max] for x dimension
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
-ylim : list
-    [min, max] for y dimension
+Returns
+-------
+None
 
-zlim : list
-    [min, max] for z dimension
+Examples
+--------
+Add a field of 0.5 [V/m] in the X-direction centered at X=0, Y=0, Z=0 [m], with a sigma of 0.1 [m] in the Z-direction
 
-comment : str
-    Comment string to be added to file header.  LF and CR are removed.
+    >>> osr.add_efield_gaussian(efield=[1, 0, 0], sigma=[0, 0, 0.10])
 
-version : int
-    Which version of output format (you should use the default unless you have good reason)
+Add a field of 1 [V/m] in the Y-direction centered at X=1, Y=1, Z=1 [m], with a sigma of 0.05 in the Z-direction
 
-Returns
--------
-None
+    >>> osr.add_efield_gaussian(efield=[0, 1, 0], sigma=[0, 0, 0.05], translation=[1, 1, 1])
 )docstring";
-static PyObject* OSCARSSR_WriteMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddElectricFieldGaussian (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a magnetic field that is a gaussian
-
-  const char* OutFileName       = "";
-  const char* OutFileNameBinary = "";
-  const char* OutFormat         = "";
-  const char* Comment           = "";
+  // Add an electric field that is a gaussian
 
   // Lists and variables
-  PyObject* List_XLim = PyList_New(0);
-  PyObject* List_YLim = PyList_New(0);
-  PyObject* List_ZLim = PyList_New(0);
-
-  int NX = 0;
-  int NY = 0;
-  int NZ = 0;
-
-  TVector2D XLim;
-  TVector2D YLim;
-  TVector2D ZLim;
+  PyObject* List_Field       = PyList_New(0);
+  PyObject* List_Translation  = PyList_New(0);
+  PyObject* List_Rotations    = PyList_New(0);
+  PyObject* List_Sigma        = PyList_New(0);
+  const char* Name            = "";
 
-  int Version = 0;
+  TVector3D Field(0, 0, 0);
+  TVector3D Sigma(0, 0, 0);
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
 
   // Input variables and parsing
-  static const char *kwlist[] = {"oformat",
-                                 "ofile",
-                                 "bofile",
-                                 "xlim",
-                                 "nx",
-                                 "ylim",
-                                 "ny",
-                                 "zlim",
-                                 "nz",
-                                 "comment",
-                                 "version",
+  static const char *kwlist[] = {"efield",
+                                 "sigma",
+                                 "rotations",
+                                 "translation",
+                                 "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|ssOiOiOisi",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OOs",
                                    const_cast<char **>(kwlist),
-                                   &OutFormat,
-                                   &OutFileName,
-                                   &OutFileNameBinary,
-                                   &List_XLim,
-                                   &NX,
-                                   &List_YLim,
-                                   &NY,
-                                   &List_ZLim,
-                                   &NZ,
-                                   &Comment,
-                                   &Version)) {
+                                   &List_Field,
+                                   &List_Sigma,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &Name)) {
     return NULL;
   }
 
-  // Initial values for limits are all 0
-  XLim.SetXY(0, 0);
-  YLim.SetXY(0, 0);
-  ZLim.SetXY(0, 0);
 
 
-  // Check that filename and format exist
-  if (std::strlen(OutFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'oformat' is blank");
+  // Check Field
+  try {
+    Field = OSCARSPY::ListAsTVector3D(List_Field);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'efield'");
     return NULL;
   }
 
-  // Check for XLim in the input
-  if (PyList_Size(List_XLim) != 0) {
-    try {
-      XLim = OSCARSPY::ListAsTVector2D(List_XLim);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'xlim'");
-      return NULL;
-    }
+  // Check Width
+  try {
+    Sigma = OSCARSPY::ListAsTVector3D(List_Sigma);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
+    return NULL;
   }
 
-  // Check for YLim in the input
-  if (PyList_Size(List_YLim) != 0) {
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
     try {
-      YLim = OSCARSPY::ListAsTVector2D(List_YLim);
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'ylim'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
       return NULL;
     }
   }
 
-  // Check for ZLim in the input
-  if (PyList_Size(List_ZLim) != 0) {
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
     try {
-      ZLim = OSCARSPY::ListAsTVector2D(List_ZLim);
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'zlim'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
       return NULL;
     }
   }
 
-  if (std::strlen(OutFileName) > 0) {
-    try {
-      self->obj->WriteField("B", OutFileName, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment);
-    } catch (...) {
-      PyErr_SetString(PyExc_ValueError, "could not write output file");
-      return NULL;
-    }
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+    return NULL;
   }
 
-  if (std::strlen(OutFileNameBinary) > 0) {
-    try {
-      self->obj->WriteFieldBinary("B", OutFileNameBinary, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment, Version);
-    } catch (...) {
-      PyErr_SetString(PyExc_ValueError, "could not write output file");
-      return NULL;
-    }
-  }
+  // Add field
+  self->obj->AddElectricField( (TField*) new TField3D_Gaussian(Field, Translation, Sigma, Rotations, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2743,164 +2705,132 @@ static PyObject* OSCARSSR_WriteMagneticField (OSCARSSRObject* self, PyObject* ar
 
 
 
-const char* DOC_OSCARSSR_WriteElectricField = R"docstring(
-write_efield(oformat [, ofile, bofile, xlim, nx, ylim, ny, zlim, nz, comment, version])
 
-Write the field to ofile in the format described in oformat.  You must specify at least one limits and one number of points (e.g. zlim and nz).  All output is in SI units.
 
-The formats (*oformat*) available are:
-* OSCARS
-* OSCARS1D
-* SPECTRA
-* SRW
 
-For OSCARS1D you also must specify what you want in the output.  One spatial dimension must be specified along with at least one field dimension (in any order you like).  For examples theses are all valid: 'OSCARS1D Z Fx Fy Fz', 'OSCARS1D Fy Fx Z Fz'.
+const char* DOC_OSCARSSR_AddElectricFieldUniform = R"docstring(
+add_efield_uniform(efield [, width, rotations, translation, name])
+
+Add a uniform field in a given range or for all space.  The *efield* is given as a 3D vector representing the field magnitude and direction.  *width* is an optional parameters, if not present the field permeates all space.  If a component of the 3D list *width* is less than or equal to zero, that coordinate will be ignored when calculating the field.
 
 Parameters
 ----------
+efield : list
+    A list representing the field [Fx, Fy, Fz]
 
-oformat : str
-    Format of output file
-
-ofile : str
-    Name of output file
+width : list
+    A list representing the spetial extent of the field [Wx, Wy, Wz]
 
-bofile : str
-    Name of binary output file
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-xlim : list
-    [min, max] for x dimension
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
-ylim : list
-    [min, max] for y dimension
+name : str
+    Name of this field
 
-zlim : list
-    [min, max] for z dimension
+Returns
+-------
+None
 
-comment : str
-    Comment string to be added to file header.  LF and CR are removed.
+Examples
+--------
+Add a field of 0.0001 [V/m] in the X-direction for all space
 
-version : int
-    Which version of output format (you should use the default unless you have good reason)
+    >>> osr.add_efield_uniform(efield=[0.0001, 0, 0])
 
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_WriteElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a magnetic field that is a gaussian
+Add a field of 0.0005 [V/m] in the Y-direction with a width in the Z-direction of 1.5 [m] (the other directions are ignored) centered at X=0, Y=0, Z=0.75 [m].
 
-  const char* OutFileName       = "";
-  const char* OutFileNameBinary = "";
-  const char* OutFormat         = "";
-  const char* Comment           = "";
+    >>> osr.add_efield_uniform(efield=[0, 1, 0], width=[0, 0, 1.5], translation=[0, 0, 0.75])
 
-  // Lists and variables
-  PyObject* List_XLim = PyList_New(0);
-  PyObject* List_YLim = PyList_New(0);
-  PyObject* List_ZLim = PyList_New(0);
+Add a field of 1 [V/m] in the X-direction in a volume of dimensions 1m x 1m x 1m.
 
-  int NX = 0;
-  int NY = 0;
-  int NZ = 0;
+    >>> osr.add_efield_uniform(efield=[1, 0, 0], width=[1, 1, 1])
+)docstring";
+static PyObject* OSCARSSR_AddElectricFieldUniform (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add a uniform field with a given width in a given direction, or for all space
 
-  TVector2D XLim;
-  TVector2D YLim;
-  TVector2D ZLim;
+  // Lists and vectors
+  PyObject*   List_Field       = PyList_New(0);
+  PyObject*   List_Translation = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Width       = PyList_New(0);
+  char const* Name             = "";
 
-  int Version = 0;
+  TVector3D Field(0, 0, 0);
+  TVector3D Width (0, 0, 0);
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
 
   // Input variables and parsing
-  static const char *kwlist[] = {"oformat",
-                                 "ofile",
-                                 "bofile",
-                                 "xlim",
-                                 "nx",
-                                 "ylim",
-                                 "ny",
-                                 "zlim",
-                                 "nz",
-                                 "comment",
-                                 "version",
+  static const char *kwlist[] = {"efield",
+                                 "width",
+                                 "rotations",
+                                 "translation",
+                                 "name",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|ssOiOiOisi",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOOs",
                                    const_cast<char **>(kwlist),
-                                   &OutFormat,
-                                   &OutFileName,
-                                   &OutFileNameBinary,
-                                   &List_XLim,
-                                   &NX,
-                                   &List_YLim,
-                                   &NY,
-                                   &List_ZLim,
-                                   &NZ,
-                                   &Comment,
-                                   &Version)) {
+                                   &List_Field,
+                                   &List_Width,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &Name
+                                   )) {
     return NULL;
   }
 
-  // Initial values for limits are all 0
-  XLim.SetXY(0, 0);
-  YLim.SetXY(0, 0);
-  ZLim.SetXY(0, 0);
-
 
-  // Check that filename and format exist
-  if (std::strlen(OutFormat) == 0) {
-    PyErr_SetString(PyExc_ValueError, "'oformat' is blank");
+  // Check Field
+  try {
+    Field = OSCARSPY::ListAsTVector3D(List_Field);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'efield'");
     return NULL;
   }
 
-  // Check for XLim in the input
-  if (PyList_Size(List_XLim) != 0) {
+  // Check Width
+  if (PyList_Size(List_Width) != 0) {
     try {
-      XLim = OSCARSPY::ListAsTVector2D(List_XLim);
+      Width = OSCARSPY::ListAsTVector3D(List_Width);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'xlim'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
       return NULL;
     }
   }
 
-  // Check for YLim in the input
-  if (PyList_Size(List_YLim) != 0) {
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
     try {
-      YLim = OSCARSPY::ListAsTVector2D(List_YLim);
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'ylim'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
       return NULL;
     }
   }
 
-  // Check for ZLim in the input
-  if (PyList_Size(List_ZLim) != 0) {
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
     try {
-      ZLim = OSCARSPY::ListAsTVector2D(List_ZLim);
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'zlim'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
       return NULL;
     }
   }
 
-  if (std::strlen(OutFileName) > 0) {
-    try {
-      self->obj->WriteField("E", OutFileName, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment);
-    } catch (...) {
-      PyErr_SetString(PyExc_ValueError, "could not write output file");
-      return NULL;
-    }
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+    return NULL;
   }
 
-  if (std::strlen(OutFileNameBinary) > 0) {
-    try {
-      self->obj->WriteFieldBinary("E", OutFileNameBinary, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment, Version);
-    } catch (...) {
-      PyErr_SetString(PyExc_ValueError, "could not write output file");
-      return NULL;
-    }
-  }
+  // Add the field
+  self->obj->AddElectricField((TField*) new TField3D_UniformBox(Field, Width, Translation, Rotations, Name));
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -2916,33 +2846,148 @@ static PyObject* OSCARSSR_WriteElectricField (OSCARSSRObject* self, PyObject* ar
 
 
 
+const char* DOC_OSCARSSR_AddElectricFieldIdealUndulator = R"docstring(
+add_efield_undulator(efield, period, nperiods [, phase, rotations, translation, taper])
 
+Adds an ideal sinusoidal undulator field with a given maximum efield amplitude, period, and number of periods.  Optionally one can specify the phase offset (in [rad]), rotations and translation.  The number of periods given is the full number of fields not counting the terminating fields.
 
+Parameters
+----------
+efield : list
+    A list representing the peak field [Fx, Fy, Fz] in [V/m]
 
+period : list
+    Length of one period
 
+nperiods : int
+    Number of periods
 
+phase : float
+    Phase offset in [rad]
 
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
+taper : float
+    The fractional change of the efield per meter along the magnetic axis
 
+name : str
+    Name of this field
 
+Returns
+-------
+None
 
+Examples
+--------
+Add an idealized undulator with 41 periods having a period of 0.050 [m] with a maximum field of 1 [T] in the y-direction where the magnetic axis is along the z-axis
 
+    >>> osr.add_efield_undulator(efield=[0, 1, 0], period=[0, 0, 0.050], nperiods=41)
+)docstring";
+static PyObject* OSCARSSR_AddElectricFieldIdealUndulator (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add an electric field undulator to OSCARSSR
 
+  // Lists and variables
+  PyObject*   List_Field       = PyList_New(0);
+  PyObject*   List_Period      = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Translation = PyList_New(0);
+  int         NPeriods         = 0;
+  double      Phase            = 0;
+  double      Taper            = 0;
+  char const* Name             = "";
 
+  TVector3D Field(0, 0, 0);
+  TVector3D Period(0, 0, 0);
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
+  // Input variables and parsing
+  static const char *kwlist[] = {"efield",
+                                 "period",
+                                 "nperiods",
+                                 "phase",
+                                 "rotations",
+                                 "translation",
+                                 "taper",
+                                 "name",
+                                 NULL};
 
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOi|dOOds",
+                                   const_cast<char **>(kwlist),
+                                   &List_Field,
+                                   &List_Period,
+                                   &NPeriods,
+                                   &Phase,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &Taper,
+                                   &Name
+                                   )) {
+    return NULL;
+  }
 
 
+  // Check Field
+  try {
+    Field = OSCARSPY::ListAsTVector3D(List_Field);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield'");
+    return NULL;
+  }
 
+  // Check Period
+  try {
+    Period = OSCARSPY::ListAsTVector3D(List_Period);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'period'");
+    return NULL;
+  }
 
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
 
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
 
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+    return NULL;
+  }
 
 
+  // Rotate field and sigma
+  // UPDATE: check this
+  Field.RotateSelfXYZ(Rotations);
+  Period.RotateSelfXYZ(Rotations);
 
 
+  // Add field
+  self->obj->AddElectricField( (TField*) new TField3D_IdealUndulator(Field, Period, NPeriods, Translation, Phase, Taper, Name));
 
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
 
 
@@ -2950,573 +2995,496 @@ static PyObject* OSCARSSR_WriteElectricField (OSCARSSRObject* self, PyObject* ar
 
 
 
+const char* DOC_OSCARSSR_RemoveElectricField = R"docstring(
+remove_efield(name)
 
+Remove all fields with the given name
 
+Parameters
+----------
+name : str
+    Name of field to remove
 
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_RemoveElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Remove magnetic field
 
+  char const* Name             = "";
 
+  // Input variables and parsing
+  static const char *kwlist[] = {"name",
+                                 NULL};
 
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+                                   const_cast<char **>(kwlist),
+                                   &Name
+                                   )) {
+    return NULL;
+  }
 
+  // Remove fields with name name
+  self->obj->RemoveElectricField(Name);
 
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
 
 
 
-const char* DOC_OSCARSSR_SetParticleBeam = R"docstring(
-set_particle_beam([, type, name, energy_GeV, d0, x0, beam, sigma_energy_GeV, t0, current, weight, rotations, translation, horizontal_direction, beta, alpha, gamma, emittance, eta, lattice_reference, mass, charge])
+const char* DOC_OSCARSSR_GetEField = R"docstring(
+get_efield(x)
 
-This function is the same as add_particle_beam(), but it clears all particle beams before the 'add'.
+Get the 3D field at any point in space.  This is the sum of all fields added to this OSCARS object.
+
+Parameters
+----------
+x : list
+    A 3D list representing a point in space [x, y, z]
+
+Returns
+-------
+bfield : [float, float, float]
+    list representing the field [Fx, Fy, Fz]
 )docstring";
-static PyObject* OSCARSSR_SetParticleBeam (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_GetEField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Clear all particle beams, add this beam, and set a new particle
+  // Get the magnetic field at a point as a 3D list [Ex, Ey, Ez]
 
-  self->obj->ClearParticleBeams();
+  // Python list object
+  PyObject* List = PyList_New(0);
 
-  PyObject* ret = OSCARSSR_AddParticleBeam(self, args, keywds);
-  if (ret == NULL) {
-    return ret;
+  static const char *kwlist[] = {"x",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O",
+                                   const_cast<char **>(kwlist),
+                                   &List)) {
+    return NULL;
   }
 
-  self->obj->SetNewParticle("", "ideal");
+  // Grab the values
+  TVector3D X;
+  try {
+    X = OSCARSPY::ListAsTVector3D(List);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in input");
+    return NULL;
+  }
 
-  return ret;
-}
+  // Set the object variable
+  TVector3D const F = self->obj->GetE(X);
 
+  // Create a python list
+  PyObject *PList = OSCARSPY::TVector3DAsList(F);
+
+  // Return the python list
+  return PList;
+}
 
 
 
-const char* DOC_OSCARSSR_AddParticleBeam = R"docstring(
-add_particle_beam([, type, name, energy_GeV, d0, x0, beam, sigma_energy_GeV, t0, current, weight, rotations, translation, horizontal_direction, beta, alpha, gamma, emittance, eta, lattice_reference, mass, charge])
 
-Add a particle beam to the OSCARS object with a name given by *name*.  There is no limit to the number of different particle beams one can add.  They are added with a *weight* which is by default 1.  The weight is used in random sampling when asking for a new particle, for example in oscars.sr.set_new_particle().  If the *beam* parameter is given you only need to specify *name* and *x0*.
+const char* DOC_OSCARSSR_ClearElectricFields = R"docstring(
+clear_efields()
 
-Supported particle types for *type* are:
-    * electron
-    * positron
-    * muon
-    * anti-muon
-    * proton
-    * anti-proton
-    * pi+
-    * pi-
+Remove all of the existing electric fields.
 
 Parameters
 ----------
+None
 
-type : str
-    One of the built-in types of particle beams, or 'custom'.  If you use custom you must also specify *mass* and *charge*.
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_ClearElectricFields (OSCARSSRObject* self)
+{
+  // Clear all magnetic fields in the OSCARSSR object
+  self->obj->ClearElectricFields();
 
-name : str
-    User identified of this beam
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-energy_GeV : float
-    Beam energy in [GeV]
 
-d0 : list
-    Vector [float, float, float] representing the default direction of the beam at the initial position.  The normalization of this vector does not matter.
 
-x0 : list
-    Coordinates of the initial position in [m] [x, y, z]
 
-beam : str
-    Name of predefined beam
+const char* DOC_OSCARSSR_PrintElectricFields = R"docstring(
+print_efields()
 
-sigma_energy_GeV : float
-    Beam energy spread in [GeV]
+Print information about all electric fields to the standard out
 
-t0 : float
-    Initial time in [m] at the initial_position.  Time here is in terms of ct.
+Parameters
+----------
+None
 
-current : float
-    Beam current in [A].  If this parameter is 0, the current defaults to the single particle charge
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_PrintElectricFields (OSCARSSRObject* self)
+{
+  // Print all magnetic stored in OSCARSSR
 
-weight : float
-    Weight to give this beam for random sampling when there are multiple beams
+  // Out string stream for printing beam information
+  std::ostringstream ostream;
+  ostream << "*Electric Fields*\n";
+  ostream << self->obj->GetEFieldContainer() << std::endl;
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+  OSCARSPY::PyPrint_stdout(ostream.str());
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-horizontal_direction : list
-    A list representing the *horizontal* beam direction.  This must be perpendicular to the beam *direction*.  The vertical direction is defined internally as :math:`[direction] \times [horizontal\_direction]`.
 
-beta : list
-    Values of the horizontal and vertical beta funtion at the point *lattice_center* [beta_x, beta_y]
 
-alpha : list
-    Values of the horizontal and vertical alpha funtion at the point *lattice_center* [alpha_x, alpha_y]
 
-gamma : list
-    Values of the horizontal and vertical gamma funtion at the point *lattice_center* [gamma_x, gamma_y]
 
-emittance : list
-    values of the horizontal and vertical emittance [emittance_x, emittance_y]
 
-eta : list
-    Values of the horizontal and vertical dispersion at the point *lattice_center* [eta_x, eta_y].  Currently eta_y is ignored and dispersion is only used in oscars.th calculations
 
-lattice_reference : list
-    Coordinates of the lattice center [x, y, z] (must be on-axis with respect to the beam)
 
-mass : float
-    mass of a *custom* particle.  This is only used if *type* = 'custom'.  Must be non-zero.
 
-charge : float
-    Charge of a *custom* particle.  This is only used if *type* = 'custom'.  Must be non-zero.
 
-Returns
--------
-None
 
-Currently the predefined beam types are:
-* NSLSII
-* NSLSII-ShortStraight
-* NSLSII-LongStraight
 
-Examples
---------
-Add an electron beam with 0.500 [A] current at an initial position of [0, 0, 0] in the Y direction with energy of 3 [GeV]
 
-    >>> osr.add_particle_beam(type='electron', name='beam_0', x0=[0, 0, 0], d0=[0, 1, 0], energy_GeV=3, current=0.500)
 
-Add a positron beam with 0.500 [A] current at an initial position of [-2, 0, 0] in the direction given by theta in the X-Y plane with energy of 3 [GeV]
 
-    >>> from math import sin, cos
-    >>> theta = 0.25 * osr.pi()
-    >>> osr.add_particle_beam(type='positron', name='beam_0', x0=[-2, 0, 0], d0=[sin(theta), cos(theta), 0], energy_GeV=3, current=0.500)
 
-Add a predefined beam for the NSLSII short straight section
+const char* DOC_OSCARSSR_WriteMagneticField = R"docstring(
+write_bfield(oformat [, ofile, bofile, xlim, nx, ylim, ny, zlim, nz, comment, version])
 
-    >>> osr.add_particle_beam(beam='NSLSII-ShortStraight', name='beam_0', x0=[-2, 0, 0])
-)docstring";
-static PyObject* OSCARSSR_AddParticleBeam (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Add a particle beam to the experiment
+Write the field to ofile in the format described in oformat.  You must specify at least one limits and one number of points (e.g. zlim and nz).  All output is in SI units.
 
-  // Lists and variables some with initial values
-  char const* Type                       = "electron";
-  char const* Name                       = "";
-  double      Energy_GeV                 = 0;
-  double      Sigma_Energy_GeV           = 0;
-  double      T0                         = 0;
-  double      Current                    = 0;
-  double      Weight                     = 1;
-  double      Mass                       = 0;
-  double      Charge                     = 0;
-  char const* Beam                       = "";
-  PyObject*   List_Position              = 0x0;
-  PyObject*   List_Direction             = 0x0;
-  PyObject*   List_Rotations             = 0x0;
-  PyObject*   List_Translation           = 0x0;
-  PyObject*   List_Horizontal_Direction  = 0x0;
-  PyObject*   List_Beta                  = 0x0;
-  PyObject*   List_Alpha                 = 0x0;
-  PyObject*   List_Gamma                 = 0x0;
-  PyObject*   List_Emittance             = 0x0;
-  PyObject*   List_Eta                   = 0x0;
-  PyObject*   List_Lattice_Reference     = 0x0;
+The formats (*oformat*) available are:
+* OSCARS
+* OSCARS1D
+* SPECTRA
+* SRW
 
-  TVector3D Position(0, 0, 0);
-  TVector3D Direction(0, 0, 1);
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
-  TVector3D Horizontal_Direction;
-  TVector2D Beta(0, 0);
-  TVector2D Alpha(0, 0);
-  TVector2D Gamma(0, 0);
-  TVector2D Emittance(0, 0);
-  TVector3D Lattice_Reference(0, 0, 0);
-  TVector2D Eta(0, 0);
+For OSCARS1D you also must specify what you want in the output.  One spatial dimension must be specified along with at least one field dimension (in any order you like).  For examples theses are all valid: 'OSCARS1D Z Fx Fy Fz', 'OSCARS1D Fy Fx Z Fz'.
 
+Parameters
+----------
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"type",
-                                 "name",
-                                 "energy_GeV",
-                                 "d0",
-                                 "x0",
-                                 "beam",
-                                 "sigma_energy_GeV",
-                                 "t0",
-                                 "current",
-                                 "weight",
-                                 "rotations",
-                                 "translation",
-                                 "horizontal_direction",
-                                 "beta",
-                                 "alpha",
-                                 "gamma",
-                                 "emittance",
-                                 "eta",
-                                 "lattice_reference",
-                                 "mass",
-                                 "charge",
-                                 NULL};
+oformat : str
+    Format of output file
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|ssdOOsddddOOOOOOOOOdd",
-                                   const_cast<char **>(kwlist),
-                                   &Type,
-                                   &Name,
-                                   &Energy_GeV,
-                                   &List_Direction,
-                                   &List_Position,
-                                   &Beam,
-                                   &Sigma_Energy_GeV,
-                                   &T0,
-                                   &Current,
-                                   &Weight,
-                                   &List_Rotations,
-                                   &List_Translation,
-                                   &List_Horizontal_Direction,
-                                   &List_Beta,
-                                   &List_Alpha,
-                                   &List_Gamma,
-                                   &List_Emittance,
-                                   &List_Eta,
-                                   &List_Lattice_Reference,
-                                   &Mass,
-                                   &Charge)) {
-    return NULL;
-  }
+ofile : str
+    Name of output file
 
+bofile : str
+    Name of binary output file
 
-  // Are you asking for one of the predefined beams?
-  bool const HasPredefinedBeam = std::strlen(Beam) != 0 ? true : false;
+xlim : list
+    [min, max] for x dimension
 
-  TParticleBeam* ThisBeam = 0x0;
+ylim : list
+    [min, max] for y dimension
 
-  // Check if beam is defined (for predefined beams)
-  if (HasPredefinedBeam) {
-    try {
-      ThisBeam = &(self->obj->AddParticleBeam(Beam, Name, Weight));
-    } catch (...) {
-      PyErr_SetString(PyExc_ValueError, "Error in predefined beam name / definition");
-      return NULL;
-    }
-  }
+zlim : list
+    [min, max] for z dimension
 
+comment : str
+    Comment string to be added to file header.  LF and CR are removed.
 
+version : int
+    Which version of output format (you should use the default unless you have good reason)
 
-  // Initial position
-  if (List_Position != 0x0) {
-    try {
-      Position = OSCARSPY::ListAsTVector3D(List_Position);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0'");
-      return NULL;
-    }
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_WriteMagneticField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add a magnetic field that is a gaussian
+
+  const char* OutFileName       = "";
+  const char* OutFileNameBinary = "";
+  const char* OutFormat         = "";
+  const char* Comment           = "";
+
+  // Lists and variables
+  PyObject* List_XLim = PyList_New(0);
+  PyObject* List_YLim = PyList_New(0);
+  PyObject* List_ZLim = PyList_New(0);
+
+  int NX = 0;
+  int NY = 0;
+  int NZ = 0;
+
+  TVector2D XLim;
+  TVector2D YLim;
+  TVector2D ZLim;
+
+  int Version = 0;
+
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"oformat",
+                                 "ofile",
+                                 "bofile",
+                                 "xlim",
+                                 "nx",
+                                 "ylim",
+                                 "ny",
+                                 "zlim",
+                                 "nz",
+                                 "comment",
+                                 "version",
+                                 NULL};
 
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|ssOiOiOisi",
+                                   const_cast<char **>(kwlist),
+                                   &OutFormat,
+                                   &OutFileName,
+                                   &OutFileNameBinary,
+                                   &List_XLim,
+                                   &NX,
+                                   &List_YLim,
+                                   &NY,
+                                   &List_ZLim,
+                                   &NZ,
+                                   &Comment,
+                                   &Version)) {
+    return NULL;
   }
 
-  // Energy check
-  if (Energy_GeV < 0) {
-    PyErr_SetString(PyExc_ValueError, "We do not currently support negative energy beams.  Please change 'energy_GeV' to >= 0");
+  // Initial values for limits are all 0
+  XLim.SetXY(0, 0);
+  YLim.SetXY(0, 0);
+  ZLim.SetXY(0, 0);
+
+
+  // Check that filename and format exist
+  if (std::strlen(OutFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'oformat' is blank");
     return NULL;
   }
 
-  // Initial direction
-  if (List_Direction != 0x0) {
+  // Check for XLim in the input
+  if (PyList_Size(List_XLim) != 0) {
     try {
-      Direction = OSCARSPY::ListAsTVector3D(List_Direction);
+      XLim = OSCARSPY::ListAsTVector2D(List_XLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'd0'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'xlim'");
       return NULL;
     }
   }
 
-  // Check for Rotations in the input
-  if (List_Rotations != 0x0) {
+  // Check for YLim in the input
+  if (PyList_Size(List_YLim) != 0) {
     try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+      YLim = OSCARSPY::ListAsTVector2D(List_YLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'ylim'");
       return NULL;
     }
   }
 
-
-  // Check for Translation in the input
-  if (List_Translation != 0x0) {
+  // Check for ZLim in the input
+  if (PyList_Size(List_ZLim) != 0) {
     try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+      ZLim = OSCARSPY::ListAsTVector2D(List_ZLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'zlim'");
       return NULL;
     }
   }
 
-
-  // Check for Horizontal_Direction in the input
-  if (List_Horizontal_Direction != 0x0) {
+  if (std::strlen(OutFileName) > 0) {
     try {
-      Horizontal_Direction = OSCARSPY::ListAsTVector3D(List_Horizontal_Direction);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'horizontal_direction'");
+      self->obj->WriteField("B", OutFileName, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment);
+    } catch (...) {
+      PyErr_SetString(PyExc_ValueError, "could not write output file");
       return NULL;
     }
-  } else {
-    Horizontal_Direction = -Direction.Orthogonal();
   }
-  Horizontal_Direction = Horizontal_Direction.UnitVector();
-
-
-  // Rotate beam parameters
-  Position.RotateSelfXYZ(Rotations);
-  Direction.RotateSelfXYZ(Rotations);
-  Position += Translation;
 
-  // Add the particle beam
-  if (std::strlen(Beam) == 0) {
+  if (std::strlen(OutFileNameBinary) > 0) {
     try {
-      if (std::string(Type) == "custom") {
-        if (Mass == 0 || Charge == 0) {
-          PyErr_SetString(PyExc_ValueError, "'mass' or 'charge' is zero");
-          return NULL;
-        }
-        // UPDATE: for custom beams
-        ThisBeam = &(self->obj->AddParticleBeam(Type, Name, Position, Direction, Energy_GeV, T0, Current, Weight, Charge, Mass));
-      } else {
-        ThisBeam = &(self->obj->AddParticleBeam(Type, Name, Position, Direction, Energy_GeV, T0, Current, Weight));
-      }
-    } catch (std::invalid_argument e) {
-      PyErr_SetString(PyExc_ValueError, "invalid argument in adding particle beam.  possibly 'name' already exists");
+      self->obj->WriteFieldBinary("B", OutFileNameBinary, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment, Version);
+    } catch (...) {
+      PyErr_SetString(PyExc_ValueError, "could not write output file");
       return NULL;
     }
   }
 
-  // Change predefined beam accordingly
-  if (HasPredefinedBeam) {
-    if (List_Direction != 0x0) {
-      ThisBeam->SetU0(Direction);
-    }
-    ThisBeam->SetX0(Position);
-  }
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-  // Set horizontal direction
-  ThisBeam->SetHorizontalDirection(Horizontal_Direction);
 
-  // UPDATE
-  // Check for Emittance in the input
-  if (List_Emittance != 0x0) {
-    try {
-      Emittance = OSCARSPY::ListAsTVector2D(List_Emittance);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'emittance'");
-      return NULL;
-    }
 
-    // Set emittance and beam distribution
-    ThisBeam->SetEmittance(Emittance);
-    ThisBeam->SetBeamDistribution(TParticleBeam::kBeamDistribution_Gaussian);
-  } else {
-    // Beam distribution to filament
-    ThisBeam->SetBeamDistribution(TParticleBeam::kBeamDistribution_Filament);
-  }
 
-  // Check for no beam
-  if (ThisBeam == 0x0) {
-    // UPDATE: add specific throw
-    std::cerr << "ERROR: No beam at checkpoint" << std::endl;
-    throw;
-  }
-
-  if (Sigma_Energy_GeV == 0) {
-    // Do nothing.  zero energy diff is alright
-  } else if (Sigma_Energy_GeV < 0) {
-    PyErr_SetString(PyExc_ValueError, "'sigma_energy_GeV' cannot be less than zero");
-    return NULL;
-  } else {
-    ThisBeam->SetSigmaEnergyGeV(Sigma_Energy_GeV);
-  }
-
-  // Check for beta, alpha, gammain the input
-  int HasBAG = 0x0;
-  if (List_Beta != 0x0) {
-    try {
-      Beta = OSCARSPY::ListAsTVector2D(List_Beta);
-      HasBAG |= 0x4;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'beta'");
-      return NULL;
-    }
-  }
-  if (List_Alpha != 0x0) {
-    try {
-      Alpha = OSCARSPY::ListAsTVector2D(List_Alpha);
-      HasBAG |= 0x2;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'alpha'");
-      return NULL;
-    }
-  }
-  if (List_Gamma != 0x0) {
-    try {
-      Gamma = OSCARSPY::ListAsTVector2D(List_Gamma);
-      HasBAG |= 0x1;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
-      return NULL;
-    }
-  }
-
-  // Check for Lattice reference in the input
-  bool HasReferencePoint = false;
-  if (List_Lattice_Reference != 0x0) {
-    try {
-      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
-      HasReferencePoint = true;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
-      return NULL;
-    }
-  }
-  ThisBeam->SetTwissLatticeReference(Lattice_Reference);
-
-  // Set correct twiss parameters
-  switch (HasBAG) {
-    case 0x7:
-      ThisBeam->SetTwissParameters(Beta, Alpha, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x6:
-      ThisBeam->SetTwissBetaAlpha(Beta, Alpha, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x5:
-      ThisBeam->SetTwissBetaGamma(Beta, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x3:
-      ThisBeam->SetTwissAlphaGamma(Alpha, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x4:
-      ThisBeam->SetTwissBetaAlpha(Beta, TVector2D(0, 0), Lattice_Reference, HasReferencePoint);
-      break;
-    default:
-      break;
-  }
-
-  if (List_Eta != 0x0) {
-    try {
-      Eta = OSCARSPY::ListAsTVector2D(List_Eta);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
-      return NULL;
-    }
-  }
-  ThisBeam->SetEta(Eta);
-
-
-  if (T0 != 0) {
-    ThisBeam->SetT0(T0);
-  }
-
-  // Should set weight on input
-  //self->obj->GetParticleBeam(Name).SetWeight(Weight);
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
+const char* DOC_OSCARSSR_WriteElectricField = R"docstring(
+write_efield(oformat [, ofile, bofile, xlim, nx, ylim, ny, zlim, nz, comment, version])
 
+Write the field to ofile in the format described in oformat.  You must specify at least one limits and one number of points (e.g. zlim and nz).  All output is in SI units.
 
+The formats (*oformat*) available are:
+* OSCARS
+* OSCARS1D
+* SPECTRA
+* SRW
 
+For OSCARS1D you also must specify what you want in the output.  One spatial dimension must be specified along with at least one field dimension (in any order you like).  For examples theses are all valid: 'OSCARS1D Z Fx Fy Fz', 'OSCARS1D Fy Fx Z Fz'.
 
+Parameters
+----------
 
-const char* DOC_OSCARSSR_SetParticleBeamSize = R"docstring(
-add_particle_beam_size(sigma, sigmap [, beam, lattice_reference, eta=0])
+oformat : str
+    Format of output file
 
-Set the beamsize of a particular beam (if the name is given) or all beams (if no name is given) at a reference point called lattice_reference.  If lattice_reference is not given the reference point is assumed to be 'x0' from the beam in question.  This function translates the sizes into twiss parameters.  If eta (dispersion) is not given it is assumed to be zero.
+ofile : str
+    Name of output file
 
-Parameters
-----------
+bofile : str
+    Name of binary output file
 
-sigma : list[2]
-    One sigma for the spatial distribution in the horizontal and vertical directions [sigma_h, sigma_v].
+xlim : list
+    [min, max] for x dimension
 
-sigmap : list[2]
-    One sigma for the angular distribution in the horizontal and vertical directions [sigmap_h, sigmap_v].
+ylim : list
+    [min, max] for y dimension
 
-beam : str
-    Name of the beam for which these paramters apply.
+zlim : list
+    [min, max] for z dimension
 
-lattice_reference : list[3]
-    3D coordinate of there reference point for the known beam dimensions.
+comment : str
+    Comment string to be added to file header.  LF and CR are removed.
 
-eta : float
-    The dispersion term.  Assumed to be zero if not given.
+version : int
+    Which version of output format (you should use the default unless you have good reason)
 
 Returns
 -------
 None
-
 )docstring";
-static PyObject* OSCARSSR_SetParticleBeamSize (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_WriteElectricField (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a particle beam to the experiment
+  // Add a magnetic field that is a gaussian
 
-  // Lists and variables some with initial values
-  PyObject*   List_Sigma                 = PyList_New(0);
-  PyObject*   List_SigmaP                = PyList_New(0);
-  char const* Beam                       = "";
-  PyObject*   List_Lattice_Reference     = PyList_New(0);
-  double      Eta                        = 0;
+  const char* OutFileName       = "";
+  const char* OutFileNameBinary = "";
+  const char* OutFormat         = "";
+  const char* Comment           = "";
 
-  TVector2D Sigma(0, 0);
-  TVector2D SigmaP(0, 0);
-  TVector3D Lattice_Reference(0, 0, 0);
+  // Lists and variables
+  PyObject* List_XLim = PyList_New(0);
+  PyObject* List_YLim = PyList_New(0);
+  PyObject* List_ZLim = PyList_New(0);
+
+  int NX = 0;
+  int NY = 0;
+  int NZ = 0;
+
+  TVector2D XLim;
+  TVector2D YLim;
+  TVector2D ZLim;
+
+  int Version = 0;
 
 
   // Input variables and parsing
-  static const char *kwlist[] = {"sigma",
-                                 "sigmap",
-                                 "beam",
-                                 "lattice_reference",
-                                 "eta",
+  static const char *kwlist[] = {"oformat",
+                                 "ofile",
+                                 "bofile",
+                                 "xlim",
+                                 "nx",
+                                 "ylim",
+                                 "ny",
+                                 "zlim",
+                                 "nz",
+                                 "comment",
+                                 "version",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|sOd",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|ssOiOiOisi",
                                    const_cast<char **>(kwlist),
-                                   &List_Sigma,
-                                   &List_SigmaP,
-                                   &Beam,
-                                   &List_Lattice_Reference,
-                                   &Eta)) {
+                                   &OutFormat,
+                                   &OutFileName,
+                                   &OutFileNameBinary,
+                                   &List_XLim,
+                                   &NX,
+                                   &List_YLim,
+                                   &NY,
+                                   &List_ZLim,
+                                   &NZ,
+                                   &Comment,
+                                   &Version)) {
     return NULL;
   }
 
+  // Initial values for limits are all 0
+  XLim.SetXY(0, 0);
+  YLim.SetXY(0, 0);
+  ZLim.SetXY(0, 0);
+
 
-  // Check for Lattice reference in the input
-  if (PyList_Size(List_Sigma) != 0) {
+  // Check that filename and format exist
+  if (std::strlen(OutFormat) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'oformat' is blank");
+    return NULL;
+  }
+
+  // Check for XLim in the input
+  if (PyList_Size(List_XLim) != 0) {
     try {
-      Sigma = OSCARSPY::ListAsTVector2D(List_Sigma);
+      XLim = OSCARSPY::ListAsTVector2D(List_XLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'xlim'");
       return NULL;
     }
   }
 
-  // Check for Lattice reference in the input
-  if (PyList_Size(List_SigmaP) != 0) {
+  // Check for YLim in the input
+  if (PyList_Size(List_YLim) != 0) {
     try {
-      SigmaP = OSCARSPY::ListAsTVector2D(List_SigmaP);
+      YLim = OSCARSPY::ListAsTVector2D(List_YLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigmap'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'ylim'");
       return NULL;
     }
   }
 
-  // Check for Lattice reference in the input
-  if (PyList_Size(List_Lattice_Reference) != 0) {
+  // Check for ZLim in the input
+  if (PyList_Size(List_ZLim) != 0) {
     try {
-      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
+      ZLim = OSCARSPY::ListAsTVector2D(List_ZLim);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'zlim'");
       return NULL;
     }
   }
 
-  //self->obj->SetBeamSize(Beam, Sigma, SigmaP, Lattice_Reference, Eta);
+  if (std::strlen(OutFileName) > 0) {
+    try {
+      self->obj->WriteField("E", OutFileName, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment);
+    } catch (...) {
+      PyErr_SetString(PyExc_ValueError, "could not write output file");
+      return NULL;
+    }
+  }
+
+  if (std::strlen(OutFileNameBinary) > 0) {
+    try {
+      self->obj->WriteFieldBinary("E", OutFileNameBinary, OutFormat, XLim, NX, YLim, NY, ZLim, NZ, Comment, Version);
+    } catch (...) {
+      PyErr_SetString(PyExc_ValueError, "could not write output file");
+      return NULL;
+    }
+  }
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -3528,60 +3496,20 @@ static PyObject* OSCARSSR_SetParticleBeamSize (OSCARSSRObject* self, PyObject* a
 
 
 
-const char* DOC_OSCARSSR_ClearParticleBeams = R"docstring(
-clear_particle_beams()
 
-Remove all of the existing particle beams
 
-Parameters
-----------
-None
 
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_ClearParticleBeams (OSCARSSRObject* self)
-{
-  // Clear the contents of the particle beam container in OSCARSSR
 
-  self->obj->ClearParticleBeams();
 
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
 
 
 
 
-const char* DOC_OSCARSSR_PrintParticleBeams = R"docstring(
-print_particle_beams()
 
-Print information for all internal particle beams
 
-Parameters
-----------
-None
-
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_PrintParticleBeams (OSCARSSRObject* self)
-{
-  // Print all particle beams stored in OSCARSSR
 
-  // Out string stream for printing beam information
-  std::ostringstream ostream;
-  ostream << self->obj->GetParticleBeamContainer() << std::endl;
 
-  OSCARSPY::PyPrint_stdout(ostream.str());
 
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
 
 
 
@@ -3589,136 +3517,23 @@ static PyObject* OSCARSSR_PrintParticleBeams (OSCARSSRObject* self)
 
 
 
-const char* DOC_OSCARSSR_SetTwissParameters = R"docstring(
-set_twiss_parameters(, [beam, beta, alpha, gamma, lattice_reference])
 
-Set the twiss parameters for a given beam (if a beam name is given) or for all beams (if no name is given).  You should only set 2 of the three [beta, alpha, gamma] as they are not independent.
 
-Parameters
-----------
-beam : str
-    Name of the beam for which to set the twiss parameters
 
-beta : list[2]
-    [horizontal, vertical]
 
-alpha : list[2]
-    [horizontal, vertical]
 
-gamma : list[2]
-    [horizontal, vertical]
 
-lattice_reference : list[3]
-    Location of the values of the twiss parameters.  These must be places on the beam axis (though it is not checked).
 
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_SetTwissParameters (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Set the twiss parameters for a given beam or for all beams
 
-  // Lists and variables some with initial values
-  char const* Beam                       = "";
-  PyObject*   List_Beta                  = PyList_New(0);
-  PyObject*   List_Alpha                 = PyList_New(0);
-  PyObject*   List_Gamma                 = PyList_New(0);
-  PyObject*   List_Lattice_Reference     = PyList_New(0);
 
-  TVector2D Beta(0, 0);
-  TVector2D Alpha(0, 0);
-  TVector2D Gamma(0, 0);
-  TVector3D Lattice_Reference(0, 0, 0);
 
 
-  // Input variables and parsing
-  static const char *kwlist[] = {"beam",
-                                 "beta",
-                                 "alpha",
-                                 "gamma",
-                                 "lattice_reference",
-                                 NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|sOOOO",
-                                   const_cast<char **>(kwlist),
-                                   &Beam,
-                                   &List_Beta,
-                                   &List_Alpha,
-                                   &List_Gamma,
-                                   &List_Lattice_Reference
-                                  )) {
-    return NULL;
-  }
 
 
-  // Check for beta, alpha, gammain the input
-  int HasBAG = 0x0;
-  if (PyList_Size(List_Beta) != 0) {
-    try {
-      Beta = OSCARSPY::ListAsTVector2D(List_Beta);
-      HasBAG |= 0x4;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'beta'");
-      return NULL;
-    }
-  }
-  if (PyList_Size(List_Alpha) != 0) {
-    try {
-      Alpha = OSCARSPY::ListAsTVector2D(List_Alpha);
-      HasBAG |= 0x2;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'alpha'");
-      return NULL;
-    }
-  }
-  if (PyList_Size(List_Gamma) != 0) {
-    try {
-      Gamma = OSCARSPY::ListAsTVector2D(List_Gamma);
-      HasBAG |= 0x1;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
-      return NULL;
-    }
-  }
 
-  // Check for Lattice reference in the input
-  bool HasReferencePoint = false;
-  if (PyList_Size(List_Lattice_Reference) != 0) {
-    try {
-      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
-      HasReferencePoint = true;
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
-      return NULL;
-    }
-  }
 
-  // Set correct twiss parameters
-  switch (HasBAG) {
-    case 0x7:
-      self->obj->SetTwissParameters(Beam, Beta, Alpha, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x6:
-      self->obj->GetParticleBeam(Beam).SetTwissBetaAlpha(Beta, Alpha, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x5:
-      self->obj->GetParticleBeam(Beam).SetTwissBetaGamma(Beta, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x3:
-      self->obj->GetParticleBeam(Beam).SetTwissAlphaGamma(Alpha, Gamma, Lattice_Reference, HasReferencePoint);
-      break;
-    case 0x4:
-      self->obj->GetParticleBeam(Beam).SetTwissBetaAlpha(Beta, TVector2D(0, 0), Lattice_Reference, HasReferencePoint);
-      break;
-    default:
-      break;
-  }
 
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
 
 
 
@@ -3731,218 +3546,273 @@ static PyObject* OSCARSSR_SetTwissParameters (OSCARSSRObject* self, PyObject* ar
 
 
 
+const char* DOC_OSCARSSR_SetParticleBeam = R"docstring(
+set_particle_beam([, type, name, energy_GeV, d0, x0, beam, sigma_energy_GeV, t0, current, weight, rotations, translation, horizontal_direction, beta, alpha, gamma, emittance, eta, lattice_reference, mass, charge])
 
+This function is the same as add_particle_beam(), but it clears all particle beams before the 'add'.
+)docstring";
+static PyObject* OSCARSSR_SetParticleBeam (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Clear all particle beams, add this beam, and set a new particle
 
+  self->obj->ClearParticleBeams();
 
+  PyObject* ret = OSCARSSR_AddParticleBeam(self, args, keywds);
+  if (ret == NULL) {
+    return ret;
+  }
 
+  self->obj->SetNewParticle("", "ideal");
 
+  return ret;
+}
 
 
 
 
+const char* DOC_OSCARSSR_AddParticleBeam = R"docstring(
+add_particle_beam([, type, name, energy_GeV, d0, x0, beam, sigma_energy_GeV, t0, current, weight, rotations, translation, horizontal_direction, beta, alpha, gamma, emittance, eta, lattice_reference, mass, charge])
 
-const char* DOC_OSCARSSR_SetNewParticle = R"docstring(
-set_new_particle([, beam, particle])
+Add a particle beam to the OSCARS object with a name given by *name*.  There is no limit to the number of different particle beams one can add.  They are added with a *weight* which is by default 1.  The weight is used in random sampling when asking for a new particle, for example in oscars.sr.set_new_particle().  If the *beam* parameter is given you only need to specify *name* and *x0*.
 
-If no arguments are given sets the current internal particle to a random new particle.  The randomization is based on the weights given for each beam.  This also sets the initial conditions for the particle used in trajectory calculations based on the beam parameters within the randomly sepected beam.  You can specify which beam you want a random particle from using the *beam* parameter.  The *particle* parameter can be 'ideal' if you want the ideal initial conditions for a particle without randomization.
+Supported particle types for *type* are:
+    * electron
+    * positron
+    * muon
+    * anti-muon
+    * proton
+    * anti-proton
+    * pi+
+    * pi-
 
 Parameters
 ----------
 
-beam : str
-    The name of the beam from which to get a particle from
+type : str
+    One of the built-in types of particle beams, or 'custom'.  If you use custom you must also specify *mass* and *charge*.
 
-particle : str
-    'ideal' or 'random', for random, you may omit this.
+name : str
+    User identified of this beam
 
-Returns
--------
-None
-)docstring";
-static PyObject* OSCARSSR_SetNewParticle (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
-{
-  // Set a new particle within the OSCARSSR object
+energy_GeV : float
+    Beam energy in [GeV]
 
-  char const* Beam_IN = "";
-  char const* Particle_IN = "";
+d0 : list
+    Vector [float, float, float] representing the default direction of the beam at the initial position.  The normalization of this vector does not matter.
 
-  static const char *kwlist[] = {"beam",
-                                 "particle",
-                                 NULL};
+x0 : list
+    Coordinates of the initial position in [m] [x, y, z]
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|ss",
-                                   const_cast<char **>(kwlist),
-                                   &Beam_IN,
-                                   &Particle_IN)) {
-    return NULL;
-  }
+beam : str
+    Name of predefined beam
 
-  // Check if a beam is at least defined
-  if (self->obj->GetNParticleBeams() < 1) {
-    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
-    return NULL;
-  }
+sigma_energy_GeV : float
+    Beam energy spread in [GeV]
 
-  std::string Beam = Beam_IN;
-  std::string Particle = Particle_IN;
+t0 : float
+    Initial time in [m] at the initial_position.  Time here is in terms of ct.
 
-  std::transform(Beam.begin(), Beam.end(), Beam.begin(), ::tolower);
-  std::transform(Particle.begin(), Particle.end(), Particle.begin(), ::tolower);
+current : float
+    Beam current in [A].  If this parameter is 0, the current defaults to the single particle charge
 
-  if (Particle != "" && !(Particle == "ideal" || Particle == "random")) {
-    PyErr_SetString(PyExc_ValueError, "'particle' must be 'ideal' or 'random'");
-    return NULL;
-  }
+weight : float
+    Weight to give this beam for random sampling when there are multiple beams
 
-  try {
-    if ((Beam) == "" && (Particle) == "") {
-      self->obj->SetNewParticle();
-    } else if (Beam != "" && Particle != "") {
-      self->obj->SetNewParticle(Beam, Particle);
-    } else if (Beam == "" && Particle != "") {
-      self->obj->SetNewParticle(Beam, Particle);
-    } else if (Beam != "" && Particle == "") {
-      self->obj->SetNewParticle(Beam, Particle);
-    }
-  } catch (std::out_of_range e) {
-    PyErr_SetString(PyExc_ValueError, "'beam' name not found");
-    return NULL;
-  }
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
+horizontal_direction : list
+    A list representing the *horizontal* beam direction.  This must be perpendicular to the beam *direction*.  The vertical direction is defined internally as :math:`[direction] \times [horizontal\_direction]`.
 
+beta : list
+    Values of the horizontal and vertical beta funtion at the point *lattice_center* [beta_x, beta_y]
 
+alpha : list
+    Values of the horizontal and vertical alpha funtion at the point *lattice_center* [alpha_x, alpha_y]
 
+gamma : list
+    Values of the horizontal and vertical gamma funtion at the point *lattice_center* [gamma_x, gamma_y]
 
-const char* DOC_OSCARSSR_GetParticleX0 = R"docstring(
-get_particle_x0()
-
-Get the initial position for the current particle in [m]
-
-Returns
--------
-x0 : [float, float, float]
-    Initial particle position
-)docstring";
-static PyObject* OSCARSSR_GetParticleX0 (OSCARSSRObject* self)
-{
-  // Get the particle position at particle t0
-  return OSCARSPY::TVector3DAsList( self->obj->GetCurrentParticle().GetX0() );
-}
-
-
-
-
-const char* DOC_OSCARSSR_GetParticleBeta0 = R"docstring(
-get_particle_beta0()
-
-Get the initial :math:`\vec \beta` for the current particle
-
-Returns
--------
-b0 : [float, float, float]
-    Initial beta of particle
-)docstring";
-static PyObject* OSCARSSR_GetParticleBeta0 (OSCARSSRObject* self)
-{
-  // Get the particle beta at particle t0
-  return OSCARSPY::TVector3DAsList( self->obj->GetCurrentParticle().GetB0() );
-}
-
+emittance : list
+    values of the horizontal and vertical emittance [emittance_x, emittance_y]
 
+eta : list
+    Values of the horizontal and vertical dispersion at the point *lattice_center* [eta_x, eta_y].  Currently eta_y is ignored and dispersion is only used in oscars.th calculations
 
+lattice_reference : list
+    Coordinates of the lattice center [x, y, z] (must be on-axis with respect to the beam)
 
-const char* DOC_OSCARSSR_GetParticleE0 = R"docstring(
-get_particle_e0()
+mass : float
+    mass of a *custom* particle.  This is only used if *type* = 'custom'.  Must be non-zero.
 
-Get the initial energy for the current particle in [GeV]
+charge : float
+    Charge of a *custom* particle.  This is only used if *type* = 'custom'.  Must be non-zero.
 
 Returns
 -------
-e0 : float
-    Initial energy of current particle
-)docstring";
-static PyObject* OSCARSSR_GetParticleE0 (OSCARSSRObject* self)
-{
-  // Get the particle beta at particle t0
-  return Py_BuildValue("f", (self->obj->GetCurrentParticle().GetE0()));
-}
-
-
-
-
-
+None
 
-const char* DOC_OSCARSSR_AddDriftVolume_Box = R"docstring(
-add_drift_box(width, [, rotations, translation, name])
+Currently the predefined beam types are:
+* NSLSII
+* NSLSII-ShortStraight
+* NSLSII-LongStraight
 
-Add a drift volume box.  The particle will drift with constant velocity inside of this volume and the points inside of the volume will not be recorded in the trajectory.  If a dimension of the box is <= 0 that axis is ignored.
+Examples
+--------
+Add an electron beam with 0.500 [A] current at an initial position of [0, 0, 0] in the Y direction with energy of 3 [GeV]
 
-Parameters
-----------
-width: list
-    Width of the drift box in x, y, and z
+    >>> osr.add_particle_beam(type='electron', name='beam_0', x0=[0, 0, 0], d0=[0, 1, 0], energy_GeV=3, current=0.500)
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+Add a positron beam with 0.500 [A] current at an initial position of [-2, 0, 0] in the direction given by theta in the X-Y plane with energy of 3 [GeV]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+    >>> from math import sin, cos
+    >>> theta = 0.25 * osr.pi()
+    >>> osr.add_particle_beam(type='positron', name='beam_0', x0=[-2, 0, 0], d0=[sin(theta), cos(theta), 0], energy_GeV=3, current=0.500)
 
-name : str
-    Name of the drift volume
+Add a predefined beam for the NSLSII short straight section
 
-Returns
--------
-None
+    >>> osr.add_particle_beam(beam='NSLSII-ShortStraight', name='beam_0', x0=[-2, 0, 0])
 )docstring";
-static PyObject* OSCARSSR_AddDriftVolume_Box (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_AddParticleBeam (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a magnetic field from a file.
-  // UPDATE: add binary file reading
-
+  // Add a particle beam to the experiment
 
-  // Grab the values
-  PyObject*   List_Width       = PyList_New(0);
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Translation = PyList_New(0);
-  char const* Name             = "";
+  // Lists and variables some with initial values
+  char const* Type                       = "electron";
+  char const* Name                       = "";
+  double      Energy_GeV                 = 0;
+  double      Sigma_Energy_GeV           = 0;
+  double      T0                         = 0;
+  double      Current                    = 0;
+  double      Weight                     = 1;
+  double      Mass                       = 0;
+  double      Charge                     = 0;
+  char const* Beam                       = "";
+  PyObject*   List_Position              = 0x0;
+  PyObject*   List_Direction             = 0x0;
+  PyObject*   List_Rotations             = 0x0;
+  PyObject*   List_Translation           = 0x0;
+  PyObject*   List_Horizontal_Direction  = 0x0;
+  PyObject*   List_Beta                  = 0x0;
+  PyObject*   List_Alpha                 = 0x0;
+  PyObject*   List_Gamma                 = 0x0;
+  PyObject*   List_Emittance             = 0x0;
+  PyObject*   List_Eta                   = 0x0;
+  PyObject*   List_Lattice_Reference     = 0x0;
 
-  TVector3D Width(0, 0, 0);
+  TVector3D Position(0, 0, 0);
+  TVector3D Direction(0, 0, 1);
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
+  TVector3D Horizontal_Direction;
+  TVector2D Beta(0, 0);
+  TVector2D Alpha(0, 0);
+  TVector2D Gamma(0, 0);
+  TVector2D Emittance(0, 0);
+  TVector3D Lattice_Reference(0, 0, 0);
+  TVector2D Eta(0, 0);
 
 
   // Input variables and parsing
-  static const char *kwlist[] = {"width",
+  static const char *kwlist[] = {"type",
+                                 "name",
+                                 "energy_GeV",
+                                 "d0",
+                                 "x0",
+                                 "beam",
+                                 "sigma_energy_GeV",
+                                 "t0",
+                                 "current",
+                                 "weight",
                                  "rotations",
                                  "translation",
-                                 "name",
+                                 "horizontal_direction",
+                                 "beta",
+                                 "alpha",
+                                 "gamma",
+                                 "emittance",
+                                 "eta",
+                                 "lattice_reference",
+                                 "mass",
+                                 "charge",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOs",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|ssdOOsddddOOOOOOOOOdd",
                                    const_cast<char **>(kwlist),
-                                   &List_Width,
+                                   &Type,
+                                   &Name,
+                                   &Energy_GeV,
+                                   &List_Direction,
+                                   &List_Position,
+                                   &Beam,
+                                   &Sigma_Energy_GeV,
+                                   &T0,
+                                   &Current,
+                                   &Weight,
                                    &List_Rotations,
                                    &List_Translation,
-                                   &Name)) {
+                                   &List_Horizontal_Direction,
+                                   &List_Beta,
+                                   &List_Alpha,
+                                   &List_Gamma,
+                                   &List_Emittance,
+                                   &List_Eta,
+                                   &List_Lattice_Reference,
+                                   &Mass,
+                                   &Charge)) {
     return NULL;
   }
 
-  // Get width
-  try {
-    Width = OSCARSPY::ListAsTVector3D(List_Width);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
+
+  // Are you asking for one of the predefined beams?
+  bool const HasPredefinedBeam = std::strlen(Beam) != 0 ? true : false;
+
+  TParticleBeam* ThisBeam = 0x0;
+
+  // Check if beam is defined (for predefined beams)
+  if (HasPredefinedBeam) {
+    try {
+      ThisBeam = &(self->obj->AddParticleBeam(Beam, Name, Weight));
+    } catch (...) {
+      PyErr_SetString(PyExc_ValueError, "Error in predefined beam name / definition");
+      return NULL;
+    }
+  }
+
+
+
+  // Initial position
+  if (List_Position != 0x0) {
+    try {
+      Position = OSCARSPY::ListAsTVector3D(List_Position);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0'");
+      return NULL;
+    }
+
+  }
+
+  // Energy check
+  if (Energy_GeV < 0) {
+    PyErr_SetString(PyExc_ValueError, "We do not currently support negative energy beams.  Please change 'energy_GeV' to >= 0");
     return NULL;
   }
 
+  // Initial direction
+  if (List_Direction != 0x0) {
+    try {
+      Direction = OSCARSPY::ListAsTVector3D(List_Direction);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'd0'");
+      return NULL;
+    }
+  }
+
   // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
+  if (List_Rotations != 0x0) {
     try {
       Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
     } catch (std::length_error e) {
@@ -3951,8 +3821,9 @@ static PyObject* OSCARSSR_AddDriftVolume_Box (OSCARSSRObject* self, PyObject* ar
     }
   }
 
+
   // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
+  if (List_Translation != 0x0) {
     try {
       Translation = OSCARSPY::ListAsTVector3D(List_Translation);
     } catch (std::length_error e) {
@@ -3961,64 +3832,275 @@ static PyObject* OSCARSSR_AddDriftVolume_Box (OSCARSSRObject* self, PyObject* ar
     }
   }
 
-  // Name check
-  if (std::string(Name).size() > 0 && Name[0] == '_') {
-    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
-    return NULL;
-  }
 
-  // Add the drift box to the OSCARSSR object
-  try {
-    self->obj->AddDriftVolume( new TDriftBox(Width, Translation, Rotations, Name) );
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Could not add drift volume.");
-    return NULL;
+  // Check for Horizontal_Direction in the input
+  if (List_Horizontal_Direction != 0x0) {
+    try {
+      Horizontal_Direction = OSCARSPY::ListAsTVector3D(List_Horizontal_Direction);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'horizontal_direction'");
+      return NULL;
+    }
+  } else {
+    Horizontal_Direction = -Direction.Orthogonal();
   }
-
-  // Must return python object None in a special way
-  Py_INCREF(Py_None);
-  return Py_None;
-}
-
-
-
+  Horizontal_Direction = Horizontal_Direction.UnitVector();
 
 
+  // Rotate beam parameters
+  Position.RotateSelfXYZ(Rotations);
+  Direction.RotateSelfXYZ(Rotations);
+  Position += Translation;
+
+  // Add the particle beam
+  if (std::strlen(Beam) == 0) {
+    try {
+      if (std::string(Type) == "custom") {
+        if (Mass == 0 || Charge == 0) {
+          PyErr_SetString(PyExc_ValueError, "'mass' or 'charge' is zero");
+          return NULL;
+        }
+        // UPDATE: for custom beams
+        ThisBeam = &(self->obj->AddParticleBeam(Type, Name, Position, Direction, Energy_GeV, T0, Current, Weight, Charge, Mass));
+      } else {
+        ThisBeam = &(self->obj->AddParticleBeam(Type, Name, Position, Direction, Energy_GeV, T0, Current, Weight));
+      }
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, "invalid argument in adding particle beam.  possibly 'name' already exists");
+      return NULL;
+    }
+  }
+
+  // Change predefined beam accordingly
+  if (HasPredefinedBeam) {
+    if (List_Direction != 0x0) {
+      ThisBeam->SetU0(Direction);
+    }
+    ThisBeam->SetX0(Position);
+  }
+
+  // Set horizontal direction
+  ThisBeam->SetHorizontalDirection(Horizontal_Direction);
+
+  // UPDATE
+  // Check for Emittance in the input
+  if (List_Emittance != 0x0) {
+    try {
+      Emittance = OSCARSPY::ListAsTVector2D(List_Emittance);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'emittance'");
+      return NULL;
+    }
+
+    // Set emittance and beam distribution
+    ThisBeam->SetEmittance(Emittance);
+    ThisBeam->SetBeamDistribution(TParticleBeam::kBeamDistribution_Gaussian);
+  } else {
+    // Beam distribution to filament
+    ThisBeam->SetBeamDistribution(TParticleBeam::kBeamDistribution_Filament);
+  }
+
+  // Check for no beam
+  if (ThisBeam == 0x0) {
+    // UPDATE: add specific throw
+    std::cerr << "ERROR: No beam at checkpoint" << std::endl;
+    throw;
+  }
+
+  if (Sigma_Energy_GeV == 0) {
+    // Do nothing.  zero energy diff is alright
+  } else if (Sigma_Energy_GeV < 0) {
+    PyErr_SetString(PyExc_ValueError, "'sigma_energy_GeV' cannot be less than zero");
+    return NULL;
+  } else {
+    ThisBeam->SetSigmaEnergyGeV(Sigma_Energy_GeV);
+  }
+
+  // Check for beta, alpha, gammain the input
+  int HasBAG = 0x0;
+  if (List_Beta != 0x0) {
+    try {
+      Beta = OSCARSPY::ListAsTVector2D(List_Beta);
+      HasBAG |= 0x4;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'beta'");
+      return NULL;
+    }
+  }
+  if (List_Alpha != 0x0) {
+    try {
+      Alpha = OSCARSPY::ListAsTVector2D(List_Alpha);
+      HasBAG |= 0x2;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'alpha'");
+      return NULL;
+    }
+  }
+  if (List_Gamma != 0x0) {
+    try {
+      Gamma = OSCARSPY::ListAsTVector2D(List_Gamma);
+      HasBAG |= 0x1;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
+      return NULL;
+    }
+  }
+
+  // Check for Lattice reference in the input
+  bool HasReferencePoint = false;
+  if (List_Lattice_Reference != 0x0) {
+    try {
+      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
+      HasReferencePoint = true;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
+      return NULL;
+    }
+  }
+  ThisBeam->SetTwissLatticeReference(Lattice_Reference);
+
+  // Set correct twiss parameters
+  switch (HasBAG) {
+    case 0x7:
+      ThisBeam->SetTwissParameters(Beta, Alpha, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x6:
+      ThisBeam->SetTwissBetaAlpha(Beta, Alpha, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x5:
+      ThisBeam->SetTwissBetaGamma(Beta, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x3:
+      ThisBeam->SetTwissAlphaGamma(Alpha, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x4:
+      ThisBeam->SetTwissBetaAlpha(Beta, TVector2D(0, 0), Lattice_Reference, HasReferencePoint);
+      break;
+    default:
+      break;
+  }
+
+  if (List_Eta != 0x0) {
+    try {
+      Eta = OSCARSPY::ListAsTVector2D(List_Eta);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
+      return NULL;
+    }
+  }
+  ThisBeam->SetEta(Eta);
+
+
+  if (T0 != 0) {
+    ThisBeam->SetT0(T0);
+  }
+
+  // Should set weight on input
+  //self->obj->GetParticleBeam(Name).SetWeight(Weight);
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
 
-const char* DOC_OSCARSSR_RemoveDriftVolume = R"docstring(
-remove_drift(name)
 
-Remove all drift volumes with the given name
+
+
+
+const char* DOC_OSCARSSR_SetParticleBeamSize = R"docstring(
+add_particle_beam_size(sigma, sigmap [, beam, lattice_reference, eta=0])
+
+Set the beamsize of a particular beam (if the name is given) or all beams (if no name is given) at a reference point called lattice_reference.  If lattice_reference is not given the reference point is assumed to be 'x0' from the beam in question.  This function translates the sizes into twiss parameters.  If eta (dispersion) is not given it is assumed to be zero.
 
 Parameters
 ----------
-name : str
-    Name of the drift volume
+
+sigma : list[2]
+    One sigma for the spatial distribution in the horizontal and vertical directions [sigma_h, sigma_v].
+
+sigmap : list[2]
+    One sigma for the angular distribution in the horizontal and vertical directions [sigmap_h, sigmap_v].
+
+beam : str
+    Name of the beam for which these paramters apply.
+
+lattice_reference : list[3]
+    3D coordinate of there reference point for the known beam dimensions.
+
+eta : float
+    The dispersion term.  Assumed to be zero if not given.
 
 Returns
 -------
 None
+
 )docstring";
-static PyObject* OSCARSSR_RemoveDriftVolume (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_SetParticleBeamSize (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Add a magnetic field from a file.
-  // UPDATE: add binary file reading
+  // Add a particle beam to the experiment
 
+  // Lists and variables some with initial values
+  PyObject*   List_Sigma                 = PyList_New(0);
+  PyObject*   List_SigmaP                = PyList_New(0);
+  char const* Beam                       = "";
+  PyObject*   List_Lattice_Reference     = PyList_New(0);
+  double      Eta                        = 0;
+
+  TVector2D Sigma(0, 0);
+  TVector2D SigmaP(0, 0);
+  TVector3D Lattice_Reference(0, 0, 0);
 
-  // Grab the values
-  char const* Name             = "";
 
   // Input variables and parsing
-  static const char *kwlist[] = {"name",
+  static const char *kwlist[] = {"sigma",
+                                 "sigmap",
+                                 "beam",
+                                 "lattice_reference",
+                                 "eta",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|sOd",
                                    const_cast<char **>(kwlist),
-                                   &Name)) {
+                                   &List_Sigma,
+                                   &List_SigmaP,
+                                   &Beam,
+                                   &List_Lattice_Reference,
+                                   &Eta)) {
     return NULL;
   }
 
-  self->obj->RemoveDriftVolume(Name);
+
+  // Check for Lattice reference in the input
+  if (PyList_Size(List_Sigma) != 0) {
+    try {
+      Sigma = OSCARSPY::ListAsTVector2D(List_Sigma);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigma'");
+      return NULL;
+    }
+  }
+
+  // Check for Lattice reference in the input
+  if (PyList_Size(List_SigmaP) != 0) {
+    try {
+      SigmaP = OSCARSPY::ListAsTVector2D(List_SigmaP);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'sigmap'");
+      return NULL;
+    }
+  }
+
+  // Check for Lattice reference in the input
+  if (PyList_Size(List_Lattice_Reference) != 0) {
+    try {
+      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
+      return NULL;
+    }
+  }
+
+  //self->obj->SetBeamSize(Beam, Sigma, SigmaP, Lattice_Reference, Eta);
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -4030,10 +4112,10 @@ static PyObject* OSCARSSR_RemoveDriftVolume (OSCARSSRObject* self, PyObject* arg
 
 
 
-const char* DOC_OSCARSSR_ClearDriftVolumes = R"docstring(
-clear_drifts()
+const char* DOC_OSCARSSR_ClearParticleBeams = R"docstring(
+clear_particle_beams()
 
-Remove all drift volumes
+Remove all of the existing particle beams
 
 Parameters
 ----------
@@ -4043,11 +4125,11 @@ Returns
 -------
 None
 )docstring";
-static PyObject* OSCARSSR_ClearDriftVolumes (OSCARSSRObject* self)
+static PyObject* OSCARSSR_ClearParticleBeams (OSCARSSRObject* self)
 {
-  // Print all magnetic stored in OSCARSSR
+  // Clear the contents of the particle beam container in OSCARSSR
 
-  self->obj->ClearDriftVolumes();
+  self->obj->ClearParticleBeams();
 
   // Must return python object None in a special way
   Py_INCREF(Py_None);
@@ -4057,15 +4139,10 @@ static PyObject* OSCARSSR_ClearDriftVolumes (OSCARSSRObject* self)
 
 
 
+const char* DOC_OSCARSSR_PrintParticleBeams = R"docstring(
+print_particle_beams()
 
-
-
-
-
-const char* DOC_OSCARSSR_PrintDriftVolumes = R"docstring(
-print_drifts()
-
-Print information about all drift volumes to the standard out
+Print information for all internal particle beams
 
 Parameters
 ----------
@@ -4075,14 +4152,13 @@ Returns
 -------
 None
 )docstring";
-static PyObject* OSCARSSR_PrintDriftVolumes (OSCARSSRObject* self)
+static PyObject* OSCARSSR_PrintParticleBeams (OSCARSSRObject* self)
 {
-  // Print all magnetic stored in OSCARSSR
+  // Print all particle beams stored in OSCARSSR
 
   // Out string stream for printing beam information
   std::ostringstream ostream;
-  ostream << "*Drift Volumes*\n";
-  ostream << self->obj->GetDriftVolumeContainer() << std::endl;
+  ostream << self->obj->GetParticleBeamContainer() << std::endl;
 
   OSCARSPY::PyPrint_stdout(ostream.str());
 
@@ -4097,143 +4173,1776 @@ static PyObject* OSCARSSR_PrintDriftVolumes (OSCARSSRObject* self)
 
 
 
+const char* DOC_OSCARSSR_SetTwissParameters = R"docstring(
+set_twiss_parameters(, [beam, beta, alpha, gamma, lattice_reference])
 
+Set the twiss parameters for a given beam (if a beam name is given) or for all beams (if no name is given).  You should only set 2 of the three [beta, alpha, gamma] as they are not independent.
 
-const char* DOC_OSCARSSR_CorrectTrajectory= R"docstring(
-correct_trajectory()
+Parameters
+----------
+beam : str
+    Name of the beam for which to set the twiss parameters
 
-Correct the trajectory to desired position and direction and specified point based on corrector kicks at specified locations.
+beta : list[2]
+    [horizontal, vertical]
 
-This function will add magnetic fields to the sr object with names that begin with an underscore.
+alpha : list[2]
+    [horizontal, vertical]
 
-Parameters
-----------
-None
+gamma : list[2]
+    [horizontal, vertical]
+
+lattice_reference : list[3]
+    Location of the values of the twiss parameters.  These must be places on the beam axis (though it is not checked).
 
 Returns
 -------
-trajectory : list
-    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+None
 )docstring";
-static PyObject* OSCARSSR_CorrectTrajectory (OSCARSSRObject* self)
+static PyObject* OSCARSSR_SetTwissParameters (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Get the CTStop variable from OSCARSSR
+  // Set the twiss parameters for a given beam or for all beams
 
-  try {
-    self->obj->CorrectTrajectory();
-  } catch (...) {
-    // UPDATE: Do I need t catch something?
-    throw;
+  // Lists and variables some with initial values
+  char const* Beam                       = "";
+  PyObject*   List_Beta                  = PyList_New(0);
+  PyObject*   List_Alpha                 = PyList_New(0);
+  PyObject*   List_Gamma                 = PyList_New(0);
+  PyObject*   List_Lattice_Reference     = PyList_New(0);
+
+  TVector2D Beta(0, 0);
+  TVector2D Alpha(0, 0);
+  TVector2D Gamma(0, 0);
+  TVector3D Lattice_Reference(0, 0, 0);
+
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"beam",
+                                 "beta",
+                                 "alpha",
+                                 "gamma",
+                                 "lattice_reference",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|sOOOO",
+                                   const_cast<char **>(kwlist),
+                                   &Beam,
+                                   &List_Beta,
+                                   &List_Alpha,
+                                   &List_Gamma,
+                                   &List_Lattice_Reference
+                                  )) {
+    return NULL;
   }
-  // Return the trajectory
-  return OSCARSSR_GetTrajectory(self);
+
+
+  // Check for beta, alpha, gammain the input
+  int HasBAG = 0x0;
+  if (PyList_Size(List_Beta) != 0) {
+    try {
+      Beta = OSCARSPY::ListAsTVector2D(List_Beta);
+      HasBAG |= 0x4;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'beta'");
+      return NULL;
+    }
+  }
+  if (PyList_Size(List_Alpha) != 0) {
+    try {
+      Alpha = OSCARSPY::ListAsTVector2D(List_Alpha);
+      HasBAG |= 0x2;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'alpha'");
+      return NULL;
+    }
+  }
+  if (PyList_Size(List_Gamma) != 0) {
+    try {
+      Gamma = OSCARSPY::ListAsTVector2D(List_Gamma);
+      HasBAG |= 0x1;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gamma'");
+      return NULL;
+    }
+  }
+
+  // Check for Lattice reference in the input
+  bool HasReferencePoint = false;
+  if (PyList_Size(List_Lattice_Reference) != 0) {
+    try {
+      Lattice_Reference = OSCARSPY::ListAsTVector3D(List_Lattice_Reference);
+      HasReferencePoint = true;
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'lattice_reference'");
+      return NULL;
+    }
+  }
+
+  // Set correct twiss parameters
+  switch (HasBAG) {
+    case 0x7:
+      self->obj->SetTwissParameters(Beam, Beta, Alpha, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x6:
+      self->obj->GetParticleBeam(Beam).SetTwissBetaAlpha(Beta, Alpha, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x5:
+      self->obj->GetParticleBeam(Beam).SetTwissBetaGamma(Beta, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x3:
+      self->obj->GetParticleBeam(Beam).SetTwissAlphaGamma(Alpha, Gamma, Lattice_Reference, HasReferencePoint);
+      break;
+    case 0x4:
+      self->obj->GetParticleBeam(Beam).SetTwissBetaAlpha(Beta, TVector2D(0, 0), Lattice_Reference, HasReferencePoint);
+      break;
+    default:
+      break;
+  }
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
 
 
 
 
-const char* DOC_OSCARSSR_CalculateTrajectory = R"docstring(
-calculate_trajectory()
 
-Calculates the trajectory for the current internal particle.  This calculates the trajectory in 3D from the time set by oscars.sr.set_ctstart() to the time set by oscars.sr.set_ctstop() beginning at the *t0* given by the particle beam from which this particle comes from.  It first does a forward propogation to the stop time, then a backward propogation to the start time.
 
-It is not necessary to call this method before other calculations such as spectrum, power density, or flux calculation methods.
 
-If you have a current particle loaded using *SetNewParticle* this method will calculate the trajectory for that particle.  If no particle is defined one will be randomly selected based on the beam weights and beam parameters.
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_SetNewParticle = R"docstring(
+set_new_particle([, beam, particle])
+
+If no arguments are given sets the current internal particle to a random new particle.  The randomization is based on the weights given for each beam.  This also sets the initial conditions for the particle used in trajectory calculations based on the beam parameters within the randomly sepected beam.  You can specify which beam you want a random particle from using the *beam* parameter.  The *particle* parameter can be 'ideal' if you want the ideal initial conditions for a particle without randomization.
 
 Parameters
 ----------
-None
+
+beam : str
+    The name of the beam from which to get a particle from
+
+particle : str
+    'ideal' or 'random', for random, you may omit this.
 
 Returns
 -------
-trajectory : list
-    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+None
 )docstring";
-static PyObject* OSCARSSR_CalculateTrajectory (OSCARSSRObject* self)
+static PyObject* OSCARSSR_SetNewParticle (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
 {
-  // Get the CTStop variable from OSCARSSR
+  // Set a new particle within the OSCARSSR object
 
-  try {
-    self->obj->CalculateTrajectory();
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
+  char const* Beam_IN = "";
+  char const* Particle_IN = "";
+
+  static const char *kwlist[] = {"beam",
+                                 "particle",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|ss",
+                                   const_cast<char **>(kwlist),
+                                   &Beam_IN,
+                                   &Particle_IN)) {
+    return NULL;
+  }
+
+  // Check if a beam is at least defined
+  if (self->obj->GetNParticleBeams() < 1) {
+    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
     return NULL;
+  }
+
+  std::string Beam = Beam_IN;
+  std::string Particle = Particle_IN;
+
+  std::transform(Beam.begin(), Beam.end(), Beam.begin(), ::tolower);
+  std::transform(Particle.begin(), Particle.end(), Particle.begin(), ::tolower);
+
+  if (Particle != "" && !(Particle == "ideal" || Particle == "random")) {
+    PyErr_SetString(PyExc_ValueError, "'particle' must be 'ideal' or 'random'");
+    return NULL;
+  }
+
+  try {
+    if ((Beam) == "" && (Particle) == "") {
+      self->obj->SetNewParticle();
+    } else if (Beam != "" && Particle != "") {
+      self->obj->SetNewParticle(Beam, Particle);
+    } else if (Beam == "" && Particle != "") {
+      self->obj->SetNewParticle(Beam, Particle);
+    } else if (Beam != "" && Particle == "") {
+      self->obj->SetNewParticle(Beam, Particle);
+    }
   } catch (std::out_of_range e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
+    PyErr_SetString(PyExc_ValueError, "'beam' name not found");
     return NULL;
   }
 
-  // Return the trajectory
-  return OSCARSSR_GetTrajectory(self);
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
 
 
 
 
-const char* DOC_OSCARSSR_GetTrajectory = R"docstring(
-get_trajectory()
-
-Get the current trajectory.  If the trajectory has not been calculated this will return an empty list.  The format of the returned list consists of a list of lists giving you the position and beta (v/c) of the particle at each position.  For a trajectory returnned is of the form: [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+const char* DOC_OSCARSSR_GetParticleX0 = R"docstring(
+get_particle_x0()
 
-Parameters
-----------
-None
+Get the initial position for the current particle in [m]
 
 Returns
 -------
-trajectory : list
-    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+x0 : [float, float, float]
+    Initial particle position
 )docstring";
-static PyObject* OSCARSSR_GetTrajectory (OSCARSSRObject* self)
+static PyObject* OSCARSSR_GetParticleX0 (OSCARSSRObject* self)
 {
-  // Get the Trajectory as 2 3D lists [[x, y, z], [BetaX, BetaY, BetaZ]]
-
+  // Get the particle position at particle t0
+  return OSCARSPY::TVector3DAsList( self->obj->GetCurrentParticle().GetX0() );
+}
+
+
+
+
+const char* DOC_OSCARSSR_GetParticleBeta0 = R"docstring(
+get_particle_beta0()
+
+Get the initial :math:`\vec \beta` for the current particle
+
+Returns
+-------
+b0 : [float, float, float]
+    Initial beta of particle
+)docstring";
+static PyObject* OSCARSSR_GetParticleBeta0 (OSCARSSRObject* self)
+{
+  // Get the particle beta at particle t0
+  return OSCARSPY::TVector3DAsList( self->obj->GetCurrentParticle().GetB0() );
+}
+
+
+
+
+const char* DOC_OSCARSSR_GetParticleE0 = R"docstring(
+get_particle_e0()
+
+Get the initial energy for the current particle in [GeV]
+
+Returns
+-------
+e0 : float
+    Initial energy of current particle
+)docstring";
+static PyObject* OSCARSSR_GetParticleE0 (OSCARSSRObject* self)
+{
+  // Get the particle beta at particle t0
+  return Py_BuildValue("f", (self->obj->GetCurrentParticle().GetE0()));
+}
+
+
+
+
+
+
+const char* DOC_OSCARSSR_AddDriftVolume_Box = R"docstring(
+add_drift_box(width, [, rotations, translation, name])
+
+Add a drift volume box.  The particle will drift with constant velocity inside of this volume and the points inside of the volume will not be recorded in the trajectory.  If a dimension of the box is <= 0 that axis is ignored.
+
+Parameters
+----------
+width: list
+    Width of the drift box in x, y, and z
+
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+name : str
+    Name of the drift volume
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_AddDriftVolume_Box (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add a magnetic field from a file.
+  // UPDATE: add binary file reading
+
+
+  // Grab the values
+  PyObject*   List_Width       = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Translation = PyList_New(0);
+  char const* Name             = "";
+
+  TVector3D Width(0, 0, 0);
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
+
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"width",
+                                 "rotations",
+                                 "translation",
+                                 "name",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOs",
+                                   const_cast<char **>(kwlist),
+                                   &List_Width,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &Name)) {
+    return NULL;
+  }
+
+  // Get width
+  try {
+    Width = OSCARSPY::ListAsTVector3D(List_Width);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'width'");
+    return NULL;
+  }
+
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
+
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+  // Name check
+  if (std::string(Name).size() > 0 && Name[0] == '_') {
+    PyErr_SetString(PyExc_ValueError, "'name' cannot begin with '_'.  This is reserved for internal use.  Please pick a different name");
+    return NULL;
+  }
+
+  // Add the drift box to the OSCARSSR object
+  try {
+    self->obj->AddDriftVolume( new TDriftBox(Width, Translation, Rotations, Name) );
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "Could not add drift volume.");
+    return NULL;
+  }
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
+
+
+const char* DOC_OSCARSSR_RemoveDriftVolume = R"docstring(
+remove_drift(name)
+
+Remove all drift volumes with the given name
+
+Parameters
+----------
+name : str
+    Name of the drift volume
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_RemoveDriftVolume (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Add a magnetic field from a file.
+  // UPDATE: add binary file reading
+
+
+  // Grab the values
+  char const* Name             = "";
+
+  // Input variables and parsing
+  static const char *kwlist[] = {"name",
+                                 NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s",
+                                   const_cast<char **>(kwlist),
+                                   &Name)) {
+    return NULL;
+  }
+
+  self->obj->RemoveDriftVolume(Name);
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
+
+
+const char* DOC_OSCARSSR_ClearDriftVolumes = R"docstring(
+clear_drifts()
+
+Remove all drift volumes
+
+Parameters
+----------
+None
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_ClearDriftVolumes (OSCARSSRObject* self)
+{
+  // Print all magnetic stored in OSCARSSR
+
+  self->obj->ClearDriftVolumes();
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_PrintDriftVolumes = R"docstring(
+print_drifts()
+
+Print information about all drift volumes to the standard out
+
+Parameters
+----------
+None
+
+Returns
+-------
+None
+)docstring";
+static PyObject* OSCARSSR_PrintDriftVolumes (OSCARSSRObject* self)
+{
+  // Print all magnetic stored in OSCARSSR
+
+  // Out string stream for printing beam information
+  std::ostringstream ostream;
+  ostream << "*Drift Volumes*\n";
+  ostream << self->obj->GetDriftVolumeContainer() << std::endl;
+
+  OSCARSPY::PyPrint_stdout(ostream.str());
+
+  // Must return python object None in a special way
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_CorrectTrajectory= R"docstring(
+correct_trajectory()
+
+Correct the trajectory to desired position and direction and specified point based on corrector kicks at specified locations.
+
+This function will add magnetic fields to the sr object with names that begin with an underscore.
+
+Parameters
+----------
+None
+
+Returns
+-------
+trajectory : list
+    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+)docstring";
+static PyObject* OSCARSSR_CorrectTrajectory (OSCARSSRObject* self)
+{
+  // Get the CTStop variable from OSCARSSR
+
+  try {
+    self->obj->CorrectTrajectory();
+  } catch (...) {
+    // UPDATE: Do I need t catch something?
+    throw;
+  }
+  // Return the trajectory
+  return OSCARSSR_GetTrajectory(self);
+}
+
+
+
+
+
+const char* DOC_OSCARSSR_CalculateTrajectory = R"docstring(
+calculate_trajectory()
+
+Calculates the trajectory for the current internal particle.  This calculates the trajectory in 3D from the time set by oscars.sr.set_ctstart() to the time set by oscars.sr.set_ctstop() beginning at the *t0* given by the particle beam from which this particle comes from.  It first does a forward propogation to the stop time, then a backward propogation to the start time.
+
+It is not necessary to call this method before other calculations such as spectrum, power density, or flux calculation methods.
+
+If you have a current particle loaded using *SetNewParticle* this method will calculate the trajectory for that particle.  If no particle is defined one will be randomly selected based on the beam weights and beam parameters.
+
+Parameters
+----------
+None
+
+Returns
+-------
+trajectory : list
+    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+)docstring";
+static PyObject* OSCARSSR_CalculateTrajectory (OSCARSSRObject* self)
+{
+  // Get the CTStop variable from OSCARSSR
+
+  try {
+    self->obj->CalculateTrajectory();
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Return the trajectory
+  return OSCARSSR_GetTrajectory(self);
+}
+
+
+
+
+
+const char* DOC_OSCARSSR_GetTrajectory = R"docstring(
+get_trajectory()
+
+Get the current trajectory.  If the trajectory has not been calculated this will return an empty list.  The format of the returned list consists of a list of lists giving you the position and beta (v/c) of the particle at each position.  For a trajectory returnned is of the form: [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+
+Parameters
+----------
+None
+
+Returns
+-------
+trajectory : list
+    A list of points of the form [[[x, y, z], [Beta_x, Beta_y, Beta_z]], ...]
+)docstring";
+static PyObject* OSCARSSR_GetTrajectory (OSCARSSRObject* self)
+{
+  // Get the Trajectory as 2 3D lists [[x, y, z], [BetaX, BetaY, BetaZ]]
+
   // Create a python list
   PyObject *PList = PyList_New(0);
 
-  // Grab trajectory
-  TParticleTrajectoryPoints const& T = self->obj->GetTrajectory();
+  // Grab trajectory
+  TParticleTrajectoryPoints const& T = self->obj->GetTrajectory();
+
+  // Number of points in trajectory calculation
+  size_t NTPoints = T.GetNPoints();
+
+  PyObject* Value;
+
+  // Loop over all points in trajectory
+  for (size_t iT = 0; iT != NTPoints; ++iT) {
+    // Create a python list for X and Beta
+    PyObject *PList2 = PyList_New(0);
+
+    // Add position and Beta to list
+    Value = Py_BuildValue("f", T.GetT(iT));
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
+
+    Value = OSCARSPY::TVector3DAsList(T.GetX(iT));
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
+
+    Value = OSCARSPY::TVector3DAsList(T.GetB(iT));
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
+
+    Value = OSCARSPY::TVector3DAsList(T.GetA(iT));
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
+
+    PyList_Append(PList, PList2);
+    Py_DECREF(PList2);
+  }
+
+  // Return the python list
+  return PList;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_CalculateSpectrum = R"docstring(
+calculate_spectrum(obs [, npoints, energy_range_eV, energy_points_eV, points_eV, polarization, angle, horizontal_direction, propogation_direction, precision, max_level, nparticles, nthreads, gpu, ngpu, quantity, ofile, bofile, energy_spread_mode, cofile])
+
+Calculate the spectrum given a point in space, the range in energy, and the number of points.  The calculation uses the current particle and its initial conditions.  If the trajectory has not been calculated it is calculated first.  The units of this calculation are [:math:`photons / mm^2 / 0.1% bw / s`]
+
+Previously to calling this function you must define a particle beam and define start and stop times at very minimum.
+
+You **must** provide either (*npoints* and *energy_range_eV*) or *points_eV*.
+
+Parameters
+----------
+obs : list
+    Point [x, y, z] where you wish to calculate the spectrum
+
+npoints : int
+    Number of points to calculate in the given energy range
+
+energy_range_eV : list
+    energy range [min, max] in eV as a list of length 2
+
+points_eV : list
+    A list of points to calculate the flux at ie [12.3, 45.6, 78.9, 123.4]
+
+polarization : str
+    Which polarization mode to calculate.  Can be 'all', 'linear-horizontal', 'linear-vertical', 'circular-left', 'circular-right', or 'linear' (if linear you must specify the angle parameter)
+
+horizontal_direction : list
+    The direction you consider to be horizontal.  Should be perpendicular to the photon beam propogation direction
+
+vertical_direction : list
+    Same as horizontal_direction but the vertical direction
+
+precision : float
+    Calculation precision parameter (typically 0.01 which is 1%)
+
+max_level: int
+    Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
+
+max_level_extended: int
+    Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+
+angle : float
+    Only used if polarization='linear' is specified.  The 'angle' is that from the horizontal_direction for the polarization directino you are interested in
+
+nparticles : int
+    The number of particles you wish to run for a multi-particle simulation
+
+nthreads : int
+    Number of threads to use
+
+gpu : int
+    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
+
+ngpu : int or list
+    If ngpu is an int, use that number of gpus (if available).
+    If ngpu is a list, the list should be a list of gpus you wish to use
+
+quantity: str
+    Quantity to return.
+    Available are:
+        'flux'        (default)
+        'precision' - Estimated precision for each point
+        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+energy_spread_mode : str
+    How the beam energy spread is included.
+    Available are:
+        'montecarlo'  (default) - Average over 'nparticles' random particles
+        'convolution' - Calculate the ideal particle spectrum once, on a grid spaced proportionally to the energy around each requested energy, and average it over the gaussian energy distribution with the photon energy scaled by (1 + dE/E)**2 for each energy deviation.  This is a good approximation for undulators.  Requires one beam.  Emittance is ignored.  Energies must be > 0.
+        'validate'    - Return the 'convolution' result and print its difference with respect to a 'montecarlo' calculation using 'nparticles'
+
+cofile : str
+    Chunked result file name.  The spectrum is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_spectra(cifiles=[...])
+
+Returns
+-------
+spectrum : list
+    A list of 2D lists, each of which is a pair representing the energy [eV] and flux [:math:`photons / mm^2 / 0.1% bw / s`] at that energy.  eg [[energy_0, flux_0], [energy_1, flux_1], ...]
+
+Examples
+--------
+Calculate the spectrum at a point 30 [m] downstream (assuming beam direction is in the Z direction) in the energy range 100 to 1000 [eV] with 900 points.
+
+    >>> osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 1000], npoints=900)
+)docstring";
+static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Calculate the spectrum given an observation point, and energy range
+
+
+  PyObject*   List_Obs                  = PyList_New(0);
+  int         NPoints                   = 0;
+  PyObject*   List_EnergyRange_eV       = PyList_New(0);
+  PyObject*   List_Points_eV            = PyList_New(0);
+  char const* Polarization              = "all";
+  double      Angle                     = 0;
+  PyObject*   List_HorizontalDirection  = PyList_New(0);
+  PyObject*   List_PropogationDirection = PyList_New(0);
+  double      Precision                 = 0.01;
+  int         MaxLevel                  = -2;
+  int         MaxLevelExtended          = 0;
+  int         NParticles                = 0;
+  int         NThreads                  = 0;
+  int         GPU                       = -1;
+  PyObject*   NGPU = 0x0;
+  char const* ReturnQuantityChars       = "flux";
+  const char* OutFileNameText           = "";
+  const char* OutFileNameBinary         = "";
+  char const* EnergySpreadModeChars     = "montecarlo";
+  const char* OutFileNameChunked        = "";
+
+  // Input variable list
+  static const char *kwlist[] = {"obs",
+                                 "npoints",
+                                 "energy_range_eV",
+                                 "energy_points_eV",
+                                 "points_eV", // UPDATE: REMOVE in v2
+                                 "polarization",
+                                 "angle",
+                                 "horizontal_direction",
+                                 "propogation_direction",
+                                 "precision",
+                                 "max_level",
+                                 "max_level_extended",
+                                 "nparticles",
+                                 "nthreads",
+                                 "gpu",
+                                 "ngpu",
+                                 "quantity",
+                                 "ofile",
+                                 "bofile",
+                                 "energy_spread_mode",
+                                 "cofile",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|iOOOsdOOdiiiiiOsssss",
+                                   const_cast<char **>(kwlist),
+                                   &List_Obs,
+                                   &NPoints,
+                                   &List_EnergyRange_eV,
+                                   &List_Points_eV,
+                                   &List_Points_eV,
+                                   &Polarization,
+                                   &Angle,
+                                   &List_HorizontalDirection,
+                                   &List_PropogationDirection,
+                                   &Precision,
+                                   &MaxLevel,
+                                   &MaxLevelExtended,
+                                   &NParticles,
+                                   &NThreads,
+                                   &GPU,
+                                   &NGPU,
+                                   &ReturnQuantityChars,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary,
+                                   &EnergySpreadModeChars,
+                                   &OutFileNameChunked)) {
+    return NULL;
+  }
+
+  // Check if a beam is at least defined
+  //if (self->obj->GetNParticleBeams() < 1) {
+  //  PyErr_SetString(PyExc_ValueError, "No particle beam defined");
+  //  return NULL;
+  //}
+
+
+  // Check number of particles
+  if (NParticles < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
+    return NULL;
+  }
+
+
+  // Add all values to a vector
+  std::vector<double> VPoints_eV;
+  for (int i = 0; i < PyList_Size(List_Points_eV); ++i) {
+    VPoints_eV.push_back(PyFloat_AsDouble(PyList_GetItem(List_Points_eV, i)));
+  }
+
+  double EStart = 0;
+  double EStop = 0;
+
+  if (PyList_Size(List_EnergyRange_eV) != 0) {
+    if (PyList_Size(List_EnergyRange_eV) == 2) {
+      EStart = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 0));
+      EStop  = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 1));
+    } else {
+      PyErr_SetString(PyExc_ValueError, "'energy_range_eV' must be a list of length 2");
+      return NULL;
+    }
+  }
+
+
+
+
+  // Observation point
+  TVector3D Obs(0, 0, 0);
+  try {
+    Obs = OSCARSPY::ListAsTVector3D(List_Obs);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'obs'");
+    return NULL;
+  }
+
+
+  // Check for HorizontalDirection in the input
+  TVector3D HorizontalDirection(0, 0, 0);
+  if (PyList_Size(List_HorizontalDirection) != 0) {
+    try {
+      HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+
+  // Check for PropogationDirection in the input
+  TVector3D PropogationDirection(0, 0, 0);
+  if (PyList_Size(List_PropogationDirection) != 0) {
+    try {
+      PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+
+
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
+
+
+  // Check GPU parameter
+  if (GPU != 0 && GPU != 1 && GPU != -1) {
+    PyErr_SetString(PyExc_ValueError, "'gpu' must be 0 or 1");
+    return NULL;
+  }
+
+
+  // Check you are not trying to use threads and GPU
+  if (NThreads > 0 && GPU == 1) {
+    PyErr_SetString(PyExc_ValueError, "gpu is 1 and nthreads > 0.  Both are not currently allowed.");
+    return NULL;
+  }
+
+  // Container for spectrum
+  TSpectrumContainer SpectrumContainer;
+
+  if (VPoints_eV.size() == 0) {
+    // Check NPoints parameter and set minimum if still zero
+    if (NPoints < 1) {
+      NPoints = fabs(EStop - EStart) + 1 > 100 ? abs((int) (EStop - EStart) + 1) : 100;
+    }
+    SpectrumContainer.Init(NPoints, EStart, EStop);
+  } else {
+    SpectrumContainer.Init(VPoints_eV);
+  }
+
+  // Check ngpu input
+  int NumberOfGPUs = -1;
+  std::vector<int> GPUVector;
+  if (NGPU != 0x0) {
+    if (PyLong_Check(NGPU)) {
+      NumberOfGPUs = (int) PyLong_AsLong(NGPU);
+    } else if (PyList_Check(NGPU)) {
+      OSCARSPY::ListToVectorInt(NGPU, GPUVector);
+    }
+  }
+
+
+  int ReturnQuantity = 0;
+  std::string ReturnQuantityStr = ReturnQuantityChars;
+  std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
+  if (ReturnQuantityStr == "FLUX") {
+    ReturnQuantity = 0;
+  } else if (ReturnQuantityStr == "PRECISION") {
+    ReturnQuantity = 1;
+  } else if (ReturnQuantityStr == "LEVEL") {
+    ReturnQuantity = 2;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'flux', 'precision', 'level', or blank");
+    return NULL;
+  }
+
+  // How to include the beam energy spread
+  int EnergySpreadMode = 0;
+  std::string EnergySpreadModeStr = EnergySpreadModeChars;
+  std::transform(EnergySpreadModeStr.begin(), EnergySpreadModeStr.end(), EnergySpreadModeStr.begin(), ::toupper);
+  if (EnergySpreadModeStr == "MONTECARLO") {
+    EnergySpreadMode = 0;
+  } else if (EnergySpreadModeStr == "CONVOLUTION") {
+    EnergySpreadMode = 1;
+  } else if (EnergySpreadModeStr == "VALIDATE") {
+    EnergySpreadMode = 2;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'energy_spread_mode' must be: 'montecarlo', 'convolution', or 'validate'");
+    return NULL;
+  }
+  if (EnergySpreadMode == 2 && NParticles < 1) {
+    PyErr_SetString(PyExc_ValueError, "'energy_spread_mode' 'validate' requires 'nparticles' >= 1");
+    return NULL;
+  }
+
+  // Actually calculate the spectrum
+  try {
+    if (EnergySpreadMode == 0) {
+      self->obj->CalculateSpectrum(Obs,
+                                   SpectrumContainer,
+                                   Polarization,
+                                   Angle,
+                                   HorizontalDirection,
+                                   PropogationDirection,
+                                   NParticles,
+                                   NThreads,
+                                   GPU,
+                                   NumberOfGPUs,
+                                   GPUVector,
+                                   Precision,
+                                   MaxLevel,
+                                   MaxLevelExtended,
+                                   ReturnQuantity);
+    } else {
+      // Copy of the empty container in case we validate
+      TSpectrumContainer MonteCarloContainer = SpectrumContainer;
+
+      self->obj->CalculateSpectrumEnergySpread(Obs,
+                                               SpectrumContainer,
+                                               Polarization,
+                                               Angle,
+                                               HorizontalDirection,
+                                               PropogationDirection,
+                                               NThreads,
+                                               GPU,
+                                               NumberOfGPUs,
+                                               GPUVector,
+                                               Precision,
+                                               MaxLevel,
+                                               MaxLevelExtended,
+                                               ReturnQuantity);
+
+      // Compare to the monte carlo calculation if requested
+      if (EnergySpreadMode == 2) {
+        self->obj->CalculateSpectrum(Obs,
+                                     MonteCarloContainer,
+                                     Polarization,
+                                     Angle,
+                                     HorizontalDirection,
+                                     PropogationDirection,
+                                     NParticles,
+                                     NThreads,
+                                     GPU,
+                                     NumberOfGPUs,
+                                     GPUVector,
+                                     Precision,
+                                     MaxLevel,
+                                     MaxLevelExtended,
+                                     ReturnQuantity);
+        OSCARSSR_PrintConvolutionValidation(SpectrumContainer, MonteCarloContainer);
+      }
+    }
+
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  if (!SpectrumContainer.AllConverged()) {
+    OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
+  }
+
+
+  if (std::string(OutFileNameText) != "") {
+    SpectrumContainer.WriteToFileText(OutFileNameText);
+  }
+
+  if (std::string(OutFileNameBinary) != "") {
+    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
+  }
+
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      SpectrumContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+
+  // Return the spectrum
+  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_CalculateSpectra = R"docstring(
+calculate_spectra(obs [, npoints, energy_range_eV, energy_points_eV, polarization, angle, horizontal_direction, propogation_direction, precision, max_level, max_level_extended, nparticles, nthreads, ofile, bofile])
+
+Calculate the spectrum at each of a list of observation points in one call, eg for a pinhole scan or beam position monitor.  All (point, energy) pairs are calculated in one batch on the threads, sharing the trajectory levels, and everything except the phase is calculated once per point for all energies.  If there are fewer points than threads the energies of each point are shared between threads.  The Riemann sum is always used: if the *filon* integrator is set (see set_integrator()) it is ignored here and a warning is printed.  The units are [:math:`photons / mm^2 / 0.1% bw / s`]
+
+You **must** provide either (*npoints* and *energy_range_eV*) or *energy_points_eV*.
+
+Parameters
+----------
+obs : list
+    List of points [[x, y, z], ...] where you wish to calculate the spectrum
+
+npoints : int
+    Number of points to calculate in the given energy range
+
+energy_range_eV : list
+    energy range [min, max] in eV as a list of length 2
+
+energy_points_eV : list
+    A list of points to calculate the flux at ie [12.3, 45.6, 78.9, 123.4]
+
+polarization : str
+    Which polarization mode to calculate.  Can be 'all', 'linear-horizontal', 'linear-vertical', 'circular-left', 'circular-right', or 'linear' (if linear you must specify the angle parameter)
+
+angle : float
+    Only used if polarization='linear' is specified.  The 'angle' is that from the horizontal_direction for the polarization directino you are interested in
+
+horizontal_direction : list
+    The direction you consider to be horizontal.  Should be perpendicular to the photon beam propogation direction
+
+propogation_direction : list
+    Propogation direction of photon beam
+
+precision : float
+    Calculation precision parameter (typically 0.01 which is 1%)
+
+max_level: int
+    Maximum "level" to use for trajectory in the calculation
+
+max_level_extended: int
+    Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+
+nparticles : int
+    The number of particles you wish to run for a multi-particle simulation
+
+nthreads : int
+    Number of threads to use
+
+ofile : str
+    Output file name.  The first line is the energies, then one line per point with its position and the flux at each energy
+
+bofile : str
+    Binary output file name, see calculate_flux_cube()
+
+Returns
+-------
+(energy_eV, flux) : tuple(list, memoryview)
+    The photon energies [eV] and the flux as a 2D array of doubles of shape (len(obs), len(energy_eV)): row i is the spectrum at obs[i].  Use numpy.asarray() to get a numpy array without a copy, or .tolist() for nested lists
+
+Examples
+--------
+Spectra at three points 30 [m] downstream
+
+    >>> osr.calculate_spectra(obs=[[0, 0, 30], [0.001, 0, 30], [0, 0.001, 30]], energy_range_eV=[100, 1000], npoints=900)
+)docstring";
+static PyObject* OSCARSSR_CalculateSpectra (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Calculate the spectrum at each of a list of observation points
+
+  PyObject*   List_Obs                  = PyList_New(0);
+  int         NPoints                   = 0;
+  PyObject*   List_EnergyRange_eV       = PyList_New(0);
+  PyObject*   List_Points_eV            = PyList_New(0);
+  char const* Polarization              = "all";
+  double      Angle                     = 0;
+  PyObject*   List_HorizontalDirection  = PyList_New(0);
+  PyObject*   List_PropogationDirection = PyList_New(0);
+  double      Precision                 = 0.01;
+  int         MaxLevel                  = -2;
+  int         MaxLevelExtended          = 0;
+  int         NParticles                = 0;
+  int         NThreads                  = 0;
+  const char* OutFileNameText           = "";
+  const char* OutFileNameBinary         = "";
+
+  // Input variable list
+  static const char *kwlist[] = {"obs",
+                                 "npoints",
+                                 "energy_range_eV",
+                                 "energy_points_eV",
+                                 "polarization",
+                                 "angle",
+                                 "horizontal_direction",
+                                 "propogation_direction",
+                                 "precision",
+                                 "max_level",
+                                 "max_level_extended",
+                                 "nparticles",
+                                 "nthreads",
+                                 "ofile",
+                                 "bofile",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|iOOsdOOdiiiiss",
+                                   const_cast<char **>(kwlist),
+                                   &List_Obs,
+                                   &NPoints,
+                                   &List_EnergyRange_eV,
+                                   &List_Points_eV,
+                                   &Polarization,
+                                   &Angle,
+                                   &List_HorizontalDirection,
+                                   &List_PropogationDirection,
+                                   &Precision,
+                                   &MaxLevel,
+                                   &MaxLevelExtended,
+                                   &NParticles,
+                                   &NThreads,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary)) {
+    return NULL;
+  }
+
+  // Check number of particles
+  if (NParticles < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
+    return NULL;
+  }
+
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
+
+  // Observation points
+  TSurfacePoints_3D Surface;
+  if (!PyList_Check(List_Obs) || PyList_Size(List_Obs) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'obs' must be a list of points [[x, y, z], ...]");
+    return NULL;
+  }
+  for (int i = 0; i < PyList_Size(List_Obs); ++i) {
+    try {
+      Surface.AddPoint(OSCARSPY::ListAsTVector3D(PyList_GetItem(List_Obs, i)));
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'obs'");
+      return NULL;
+    }
+  }
+
+  // Energies, the same as calculate_spectrum()
+  TSpectrumContainer EnergyPoints;
+  if (PyList_Size(List_Points_eV) != 0) {
+    std::vector<double> VPoints_eV;
+    for (int i = 0; i < PyList_Size(List_Points_eV); ++i) {
+      VPoints_eV.push_back(PyFloat_AsDouble(PyList_GetItem(List_Points_eV, i)));
+    }
+    EnergyPoints.Init(VPoints_eV);
+  } else if (PyList_Size(List_EnergyRange_eV) == 2) {
+    double const EStart = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 0));
+    double const EStop  = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 1));
+
+    // Check NPoints parameter and set minimum if still zero
+    if (NPoints < 1) {
+      NPoints = fabs(EStop - EStart) + 1 > 100 ? abs((int) (EStop - EStart) + 1) : 100;
+    }
+    EnergyPoints.Init(NPoints, EStart, EStop);
+  } else {
+    PyErr_SetString(PyExc_ValueError, "must specify 'energy_range_eV' [float, float] or 'energy_points_eV'");
+    return NULL;
+  }
+
+  std::vector<double> Energies;
+  for (size_t i = 0; i != EnergyPoints.GetNPoints(); ++i) {
+    Energies.push_back(EnergyPoints.GetEnergy(i));
+  }
+
+  // Check for HorizontalDirection in the input
+  TVector3D HorizontalDirection(0, 0, 0);
+  if (PyList_Size(List_HorizontalDirection) != 0) {
+    try {
+      HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'horizontal_direction'");
+      return NULL;
+    }
+  }
+
+  // Check for PropogationDirection in the input
+  TVector3D PropogationDirection(0, 0, 0);
+  if (PyList_Size(List_PropogationDirection) != 0) {
+    try {
+      PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'propogation_direction'");
+      return NULL;
+    }
+  }
+
+  // Container for points and flux at each energy
+  T4DScalarContainer FluxContainer;
+  FluxContainer.SetEnergies(Energies);
+
+  try {
+    self->obj->CalculateFluxCube(Surface,
+                                 FluxContainer,
+                                 Polarization,
+                                 Angle,
+                                 HorizontalDirection,
+                                 PropogationDirection,
+                                 NParticles,
+                                 NThreads,
+                                 Precision,
+                                 MaxLevel,
+                                 MaxLevelExtended,
+                                 3);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  if (!FluxContainer.AllConverged()) {
+    OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
+  }
+
+  // Text output
+  if (std::string(OutFileNameText) != "") {
+    FluxContainer.WriteToFileText(OutFileNameText, 3);
+  }
+
+  // Binary output
+  if (std::string(OutFileNameBinary) != "") {
+    FluxContainer.WriteToFileBinary(OutFileNameBinary, 3);
+  }
+
+  // Flux of each point (row) at each energy (column), contiguous per point
+  std::vector<double> Flux;
+  Flux.reserve(FluxContainer.GetNPoints() * FluxContainer.GetNEnergies());
+  for (size_t i = 0; i != FluxContainer.GetNPoints(); ++i) {
+    double const* Values = FluxContainer.GetSpectrumValues(i);
+    Flux.insert(Flux.end(), Values, Values + FluxContainer.GetNEnergies());
+  }
+
+  PyObject* PyFlux = OSCARSPY::VectorAsMemoryView(Flux, FluxContainer.GetNPoints(), FluxContainer.GetNEnergies());
+  if (PyFlux == NULL) {
+    return NULL;
+  }
+
+  PyObject* PyEnergies = PyList_New(0);
+  for (size_t i = 0; i != FluxContainer.GetNEnergies(); ++i) {
+    PyObject* Value = Py_BuildValue("f", FluxContainer.GetEnergy(i));
+    PyList_Append(PyEnergies, Value);
+    Py_DECREF(Value);
+  }
+
+  // Tuple steals the references
+  PyObject* Result = PyTuple_New(2);
+  PyTuple_SET_ITEM(Result, 0, PyEnergies);
+  PyTuple_SET_ITEM(Result, 1, PyFlux);
+
+  return Result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+const char* DOC_OSCARSSR_CalculateSpectrumAperture = R"docstring(
+calculate_spectrum_aperture([shape, width, radius, plane, rotations, translation, npoints, energy_range_eV, energy_points_eV, polarization, angle, horizontal_direction, propogation_direction, tolerance, max_depth, precision, max_level, max_level_extended, nparticles, nthreads, gpu, ngpu, ofile, bofile])
+
+Calculate the flux through a rectangular or circular aperture as a function of energy.  The units of this calculation are [:math:`photons / 0.1% bw / s`]
+
+The spectrum is calculated at points in the aperture chosen by adaptive cubature: each cell of the aperture is split until the error of its integral, estimated from the 3x3 Simpson rule on the cell and on its four children, is within its share of *tolerance* for every energy.  All energies share the points, so this needs far fewer points than a flux map at each energy.  With *nparticles* one set of random particles is drawn and used at every point of the aperture, on the cpu.
+
+The aperture is defined in *plane* (eg 'XY') centered on the origin, then rotated and translated as in calculate_flux_rectangle().
+
+You **must** provide either (*npoints* and *energy_range_eV*) or *energy_points_eV*.
+
+Parameters
+----------
+shape : str
+    'rectangle' (default) or 'circle'
+
+width : list
+    Widths [w1, w2] of the rectangle in the directions of the plane
 
-  // Number of points in trajectory calculation
-  size_t NTPoints = T.GetNPoints();
+radius : float
+    Radius of the circle
 
-  PyObject* Value;
+plane : str
+    Plane the aperture starts in (default 'XY')
 
-  // Loop over all points in trajectory
-  for (size_t iT = 0; iT != NTPoints; ++iT) {
-    // Create a python list for X and Beta
-    PyObject *PList2 = PyList_New(0);
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-    // Add position and Beta to list
-    Value = Py_BuildValue("f", T.GetT(iT));
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
-    Value = OSCARSPY::TVector3DAsList(T.GetX(iT));
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+npoints : int
+    Number of points to calculate in the given energy range
+
+energy_range_eV : list
+    energy range [min, max] in eV as a list of length 2
+
+energy_points_eV : list
+    A list of points to calculate the flux at ie [12.3, 45.6, 78.9, 123.4]
+
+polarization : str
+    Which polarization mode to calculate.  Can be 'all', 'linear-horizontal', 'linear-vertical', 'circular-left', 'circular-right', or 'linear' (if linear you must specify the angle parameter)
+
+angle : float
+    Only used if polarization='linear' is specified.  The 'angle' is that from the horizontal_direction for the polarization directino you are interested in
+
+horizontal_direction : list
+    The direction you consider to be horizontal.  Should be perpendicular to the photon beam propogation direction
+
+propogation_direction : list
+    The photon beam propogation direction
+
+tolerance : float
+    Relative tolerance of the integral at each energy (default 0.01).  Energies with less than 1e-3 of the largest flux are held to the absolute tolerance of the largest
+
+max_depth : int
+    Maximum number of times a coarse cell is split (default 4)
+
+precision : float
+    Calculation precision parameter (typically 0.01 which is 1%)
+
+max_level: int
+    Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
+
+max_level_extended: int
+    Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+
+nparticles : int
+    The number of particles you wish to run for a multi-particle simulation.  The same particles are used at every point of the aperture
+
+nthreads : int
+    Number of threads to use
+
+gpu : int
+    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
+
+ngpu : int or list
+    If ngpu is an int, use that number of gpus (if available).
+    If ngpu is a list, the list should be a list of gpus you wish to use
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+Returns
+-------
+spectrum : list
+    A list of 2D lists, each of which is a pair representing the energy [eV] and flux [:math:`photons / 0.1% bw / s`] through the aperture at that energy.  eg [[energy_0, flux_0], [energy_1, flux_1], ...]
+
+Examples
+--------
+Flux through a 1 x 0.5 [mm] slit 30 [m] downstream in the energy range 100 to 1000 [eV]
+
+    >>> osr.calculate_spectrum_aperture(width=[0.001, 0.0005], translation=[0, 0, 30], energy_range_eV=[100, 1000], npoints=900)
+)docstring";
+static PyObject* OSCARSSR_CalculateSpectrumAperture (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+{
+  // Calculate the flux through an aperture versus energy
+
+  char const* ShapeChars                = "rectangle";
+  PyObject*   List_Width                = PyList_New(0);
+  double      Radius                    = 0;
+  char const* SurfacePlane              = "XY";
+  PyObject*   List_Rotations            = PyList_New(0);
+  PyObject*   List_Translation          = PyList_New(0);
+  int         NPoints                   = 0;
+  PyObject*   List_EnergyRange_eV       = PyList_New(0);
+  PyObject*   List_Points_eV            = PyList_New(0);
+  char const* Polarization              = "all";
+  double      Angle                     = 0;
+  PyObject*   List_HorizontalDirection  = PyList_New(0);
+  PyObject*   List_PropogationDirection = PyList_New(0);
+  double      Tolerance                 = 0.01;
+  int         MaxDepth                  = 4;
+  double      Precision                 = 0.01;
+  int         MaxLevel                  = -2;
+  int         MaxLevelExtended          = 0;
+  int         NParticles                = 0;
+  int         NThreads                  = 0;
+  int         GPU                       = -1;
+  PyObject*   NGPU = 0x0;
+  const char* OutFileNameText           = "";
+  const char* OutFileNameBinary         = "";
+
+  // Input variable list
+  static const char *kwlist[] = {"shape",
+                                 "width",
+                                 "radius",
+                                 "plane",
+                                 "rotations",
+                                 "translation",
+                                 "npoints",
+                                 "energy_range_eV",
+                                 "energy_points_eV",
+                                 "polarization",
+                                 "angle",
+                                 "horizontal_direction",
+                                 "propogation_direction",
+                                 "tolerance",
+                                 "max_depth",
+                                 "precision",
+                                 "max_level",
+                                 "max_level_extended",
+                                 "nparticles",
+                                 "nthreads",
+                                 "gpu",
+                                 "ngpu",
+                                 "ofile",
+                                 "bofile",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|sOdsOOiOOsdOOdidiiiiiOss",
+                                   const_cast<char **>(kwlist),
+                                   &ShapeChars,
+                                   &List_Width,
+                                   &Radius,
+                                   &SurfacePlane,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &NPoints,
+                                   &List_EnergyRange_eV,
+                                   &List_Points_eV,
+                                   &Polarization,
+                                   &Angle,
+                                   &List_HorizontalDirection,
+                                   &List_PropogationDirection,
+                                   &Tolerance,
+                                   &MaxDepth,
+                                   &Precision,
+                                   &MaxLevel,
+                                   &MaxLevelExtended,
+                                   &NParticles,
+                                   &NThreads,
+                                   &GPU,
+                                   &NGPU,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary)) {
+    return NULL;
+  }
+
+  // Check if a beam is at least defined
+  if (self->obj->GetNParticleBeams() < 1) {
+    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
+    return NULL;
+  }
+
+  // Check number of particles
+  if (NParticles < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
+    return NULL;
+  }
+
+  // Check tolerance
+  if (Tolerance <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'tolerance' must be > 0");
+    return NULL;
+  }
+
+  // Add all values to a vector
+  std::vector<double> VPoints_eV;
+  for (int i = 0; i < PyList_Size(List_Points_eV); ++i) {
+    VPoints_eV.push_back(PyFloat_AsDouble(PyList_GetItem(List_Points_eV, i)));
+  }
+
+  double EStart = 0;
+  double EStop = 0;
+
+  if (PyList_Size(List_EnergyRange_eV) != 0) {
+    if (PyList_Size(List_EnergyRange_eV) == 2) {
+      EStart = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 0));
+      EStop  = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 1));
+    } else {
+      PyErr_SetString(PyExc_ValueError, "'energy_range_eV' must be a list of length 2");
+      return NULL;
+    }
+  } else if (VPoints_eV.size() == 0) {
+    PyErr_SetString(PyExc_ValueError, "must specify 'energy_range_eV' or 'energy_points_eV'");
+    return NULL;
+  }
+
+  // Vectors for rotations and translations.  Default to 0
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
+
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
+
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+  // Check for HorizontalDirection in the input
+  TVector3D HorizontalDirection(0, 0, 0);
+  if (PyList_Size(List_HorizontalDirection) != 0) {
+    try {
+      HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'horizontal_direction'");
+      return NULL;
+    }
+  }
+
+  // Check for PropogationDirection in the input
+  TVector3D PropogationDirection(0, 0, 0);
+  if (PyList_Size(List_PropogationDirection) != 0) {
+    try {
+      PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'propogation_direction'");
+      return NULL;
+    }
+  }
+
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
+
+  // Check GPU parameter
+  if (GPU != 0 && GPU != 1 && GPU != -1) {
+    PyErr_SetString(PyExc_ValueError, "'gpu' must be 0 or 1");
+    return NULL;
+  }
+
+  // Check you are not trying to use threads and GPU
+  if (NThreads > 0 && GPU == 1) {
+    PyErr_SetString(PyExc_ValueError, "gpu is 1 and nthreads > 0.  Both are not currently allowed.");
+    return NULL;
+  }
+
+  // Check ngpu input
+  int NumberOfGPUs = -1;
+  std::vector<int> GPUVector;
+  if (NGPU != 0x0) {
+    if (PyLong_Check(NGPU)) {
+      NumberOfGPUs = (int) PyLong_AsLong(NGPU);
+    } else if (PyList_Check(NGPU)) {
+      OSCARSPY::ListToVectorInt(NGPU, GPUVector);
+    }
+  }
+
+  // The aperture, oriented as a rectangle surface would be
+  std::string ShapeStr = ShapeChars;
+  std::transform(ShapeStr.begin(), ShapeStr.end(), ShapeStr.begin(), ::toupper);
+
+  TApertureCubature Aperture;
+  try {
+    if (ShapeStr == "RECTANGLE") {
+      if (PyList_Size(List_Width) != 2) {
+        PyErr_SetString(PyExc_ValueError, "'width' must be a list of length 2");
+        return NULL;
+      }
+      double const Width_X1 = PyFloat_AsDouble(PyList_GetItem(List_Width, 0));
+      double const Width_X2 = PyFloat_AsDouble(PyList_GetItem(List_Width, 1));
+
+      TSurfacePoints_Rectangle const Surface(SurfacePlane, 2, 2, Width_X1, Width_X2, Rotations, Translation, 1);
+      Aperture.InitRectangle(Surface.GetCenter(), Surface.GetX1Vector(), Surface.GetX2Vector(), Width_X1, Width_X2, MaxDepth);
+    } else if (ShapeStr == "CIRCLE") {
+      TSurfacePoints_Rectangle const Surface(SurfacePlane, 2, 2, 1, 1, Rotations, Translation, 1);
+      Aperture.InitCircle(Surface.GetCenter(), Surface.GetX1Vector(), Surface.GetX2Vector(), Radius, MaxDepth);
+    } else {
+      PyErr_SetString(PyExc_ValueError, "'shape' must be 'rectangle' or 'circle'");
+      return NULL;
+    }
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
 
-    Value = OSCARSPY::TVector3DAsList(T.GetB(iT));
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+  // Container for spectrum
+  TSpectrumContainer SpectrumContainer;
 
-    Value = OSCARSPY::TVector3DAsList(T.GetA(iT));
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+  if (VPoints_eV.size() == 0) {
+    // Check NPoints parameter and set minimum if still zero
+    if (NPoints < 1) {
+      NPoints = fabs(EStop - EStart) + 1 > 100 ? abs((int) (EStop - EStart) + 1) : 100;
+    }
+    SpectrumContainer.Init(NPoints, EStart, EStop);
+  } else {
+    SpectrumContainer.Init(VPoints_eV);
+  }
 
-    PyList_Append(PList, PList2);
-    Py_DECREF(PList2);
+  // Actually calculate the spectrum
+  try {
+    self->obj->CalculateSpectrumAperture(Aperture,
+                                         Tolerance,
+                                         SpectrumContainer,
+                                         Polarization,
+                                         Angle,
+                                         HorizontalDirection,
+                                         PropogationDirection,
+                                         NParticles,
+                                         NThreads,
+                                         GPU,
+                                         NumberOfGPUs,
+                                         GPUVector,
+                                         Precision,
+                                         MaxLevel,
+                                         MaxLevelExtended);
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
   }
 
-  // Return the python list
-  return PList;
-}
+  if (!SpectrumContainer.AllConverged()) {
+    OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
+  }
 
+  if (std::string(OutFileNameText) != "") {
+    SpectrumContainer.WriteToFileText(OutFileNameText);
+  }
 
+  if (std::string(OutFileNameBinary) != "") {
+    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
+  }
 
+  // Return the spectrum
+  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
+}
 
 
 
@@ -4250,51 +5959,85 @@ static PyObject* OSCARSSR_GetTrajectory (OSCARSSRObject* self)
 
 
 
+const char* DOC_OSCARSSR_CalculateTotalPower = R"docstring(
+calculate_total_power()
 
+Calculate the total radiated power based on the current particle and that particle's beam current.
 
+See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
 
+Returns
+-------
+power : float
+    Total power in [W]
+)docstring";
+static PyObject* OSCARSSR_CalculateTotalPower (OSCARSSRObject* self)
+{
+  // Calculate the total power radiated by the current particle
 
+  double Power = 0;
 
+  // Check if a beam is at least defined
+  if (self->obj->GetNParticleBeams() < 1) {
+    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
+    return NULL;
+  }
 
+  // Return the total power
+  // UPDATE: This does not fail when no beam defined
+  try {
+    Power = self->obj->CalculateTotalPower();
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
 
+  return Py_BuildValue("f", Power);
+}
 
 
 
 
 
 
-const char* DOC_OSCARSSR_CalculateSpectrum = R"docstring(
-calculate_spectrum(obs [, npoints, energy_range_eV, energy_points_eV, points_eV, polarization, angle, horizontal_direction, propogation_direction, precision, max_level, nparticles, nthreads, gpu, ngpu, quantity, ofile, bofile])
 
-Calculate the spectrum given a point in space, the range in energy, and the number of points.  The calculation uses the current particle and its initial conditions.  If the trajectory has not been calculated it is calculated first.  The units of this calculation are [:math:`photons / mm^2 / 0.1% bw / s`]
+const char* DOC_OSCARSSR_CalculatePowerDensity = R"docstring(
+calculate_power_density([points, normal, rotations, translation, nparticles, gpu, nthreads, precision, max_level, max_level_extended, quantity, ofile, surface])
 
-Previously to calling this function you must define a particle beam and define start and stop times at very minimum.
+Calculate the power density for each point in the list *points*, or on the parametric *surface*.
 
-You **must** provide either (*npoints* and *energy_range_eV*) or *points_eV*.
+See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
 Parameters
 ----------
-obs : list
-    Point [x, y, z] where you wish to calculate the spectrum
 
-npoints : int
-    Number of points to calculate in the given energy range
+points : list
+    A list of points, each point containing a position in 3D (as a list) and a normal vector at that position (also as a 3D list): [[[x, y, z], [nx. ny. nz]], [...], ...]
 
-energy_range_eV : list
-    energy range [min, max] in eV as a list of length 2
+surface : object
+    A parametric surface from oscars.parametric_surfaces (eg PSCylinder) used instead of *points*.  The points are generated in c++ on the surface grid of nu x nv points (u being the outer index) which is much faster than building the list of points in python.
 
-points_eV : list
-    A list of points to calculate the flux at ie [12.3, 45.6, 78.9, 123.4]
+normal : int
+    -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
-polarization : str
-    Which polarization mode to calculate.  Can be 'all', 'linear-horizontal', 'linear-vertical', 'circular-left', 'circular-right', or 'linear' (if linear you must specify the angle parameter)
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-horizontal_direction : list
-    The direction you consider to be horizontal.  Should be perpendicular to the photon beam propogation direction
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
-vertical_direction : list
-    Same as horizontal_direction but the vertical direction
+nparticles : int
+    Number of particles to use for multi-particle calculations
+
+gpu : int
+    Use the gpu or not (0 or 1)
+
+nthreads : int
+    Number of threads to use
 
 precision : float
     Calculation precision parameter (typically 0.01 which is 1%)
@@ -4302,194 +6045,177 @@ precision : float
 max_level: int
     Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
 
+
 max_level_extended: int
     Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
 
-angle : float
-    Only used if polarization='linear' is specified.  The 'angle' is that from the horizontal_direction for the polarization directino you are interested in
-
-nparticles : int
-    The number of particles you wish to run for a multi-particle simulation
-
-nthreads : int
-    Number of threads to use
-
-gpu : int
-    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
-
-ngpu : int or list
-    If ngpu is an int, use that number of gpus (if available).
-    If ngpu is a list, the list should be a list of gpus you wish to use
-
 quantity: str
     Quantity to return.
     Available are:
-        'flux'        (default)
+        'power density' (default)
         'precision' - Estimated precision for each point
         'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
 
 ofile : str
     Output file name
 
-bofile : str
-    Binary output file name
-
 Returns
 -------
-spectrum : list
-    A list of 2D lists, each of which is a pair representing the energy [eV] and flux [:math:`photons / mm^2 / 0.1% bw / s`] at that energy.  eg [[energy_0, flux_0], [energy_1, flux_1], ...]
-
-Examples
---------
-Calculate the spectrum at a point 30 [m] downstream (assuming beam direction is in the Z direction) in the energy range 100 to 1000 [eV] with 900 points.
-
-    >>> osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 1000], npoints=900)
+power_density : list
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], pd_0], [[x1_1, x2_1, x3_1], pd_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
 )docstring";
-static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* args, PyObject* keywds)
+static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
-  // Calculate the spectrum given an observation point, and energy range
-
+  // Calculate the power density given a list of points
 
-  PyObject*   List_Obs                  = PyList_New(0);
-  int         NPoints                   = 0;
-  PyObject*   List_EnergyRange_eV       = PyList_New(0);
-  PyObject*   List_Points_eV            = PyList_New(0);
-  char const* Polarization              = "all";
-  double      Angle                     = 0;
-  PyObject*   List_HorizontalDirection  = PyList_New(0);
-  PyObject*   List_PropogationDirection = PyList_New(0);
-  double      Precision                 = 0.01;
-  int         MaxLevel                  = -2;
-  int         MaxLevelExtended          = 0;
-  int         NParticles                = 0;
-  int         NThreads                  = 0;
-  int         GPU                       = -1;
+  PyObject*   List_Translation = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Points      = PyList_New(0);
+  PyObject*   PS_Surface       = 0x0;
+  int         NormalDirection = 0;
+  int const   Dim = 3;
+  int         NParticles = 0;
+  int         GPU = -1;
   PyObject*   NGPU = 0x0;
-  char const* ReturnQuantityChars       = "flux";
-  const char* OutFileNameText           = "";
-  const char* OutFileNameBinary         = "";
+  int         NThreads = 0;
+  double      Precision = 0.01;
+  int         MaxLevel = -2;
+  int         MaxLevelExtended = 0;
+  char const* ReturnQuantityChars = "power density";
+  char const* OutFileName = "";
 
-  // Input variable list
-  static const char *kwlist[] = {"obs",
-                                 "npoints",
-                                 "energy_range_eV",
-                                 "energy_points_eV",
-                                 "points_eV", // UPDATE: REMOVE in v2
-                                 "polarization",
-                                 "angle",
-                                 "horizontal_direction",
-                                 "propogation_direction",
-                                 "precision",
-                                 "max_level",
-                                 "max_level_extended",
+
+  static const char *kwlist[] = {"points",
+                                 "normal",
+                                 "rotations",
+                                 "translation",
                                  "nparticles",
-                                 "nthreads",
                                  "gpu",
                                  "ngpu",
+                                 "nthreads",
+                                 "precision",
+                                 "max_level",
+                                 "max_level_extended",
                                  "quantity",
                                  "ofile",
-                                 "bofile",
+                                 "surface",
                                  NULL};
 
-  // Parse inputs
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|iOOOsdOOdiiiiiOsss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OiOOiiOidiissO",
                                    const_cast<char **>(kwlist),
-                                   &List_Obs,
-                                   &NPoints,
-                                   &List_EnergyRange_eV,
-                                   &List_Points_eV,
-                                   &List_Points_eV,
-                                   &Polarization,
-                                   &Angle,
-                                   &List_HorizontalDirection,
-                                   &List_PropogationDirection,
-                                   &Precision,
-                                   &MaxLevel,
-                                   &MaxLevelExtended,
+                                   &List_Points,
+                                   &NormalDirection,
+                                   &List_Rotations,
+                                   &List_Translation,
                                    &NParticles,
-                                   &NThreads,
                                    &GPU,
                                    &NGPU,
+                                   &NThreads,
+                                   &Precision,
+                                   &MaxLevel,
+                                   &MaxLevelExtended,
                                    &ReturnQuantityChars,
-                                   &OutFileNameText,
-                                   &OutFileNameBinary)) {
-    return NULL;
-  }
-
-  // Check if a beam is at least defined
-  //if (self->obj->GetNParticleBeams() < 1) {
-  //  PyErr_SetString(PyExc_ValueError, "No particle beam defined");
-  //  return NULL;
-  //}
-
-
-  // Check number of particles
-  if (NParticles < 0) {
-    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
+                                   &OutFileName,
+                                   &PS_Surface)) {
     return NULL;
   }
-
-
-  // Add all values to a vector
-  std::vector<double> VPoints_eV;
-  for (int i = 0; i < PyList_Size(List_Points_eV); ++i) {
-    VPoints_eV.push_back(PyFloat_AsDouble(PyList_GetItem(List_Points_eV, i)));
+
+  // Check if a beam is at least defined
+  if (self->obj->GetNParticleBeams() < 1) {
+    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
+    return NULL;
   }
 
-  double EStart = 0;
-  double EStop = 0;
 
-  if (PyList_Size(List_EnergyRange_eV) != 0) {
-    if (PyList_Size(List_EnergyRange_eV) == 2) {
-      EStart = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 0));
-      EStop  = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 1));
-    } else {
-      PyErr_SetString(PyExc_ValueError, "'energy_range_eV' must be a list of length 2");
-      return NULL;
-    }
+  // Check requested dimension
+  if (Dim != 2 && Dim != 3) {
+    PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
+    return NULL;
   }
 
 
+  // Vectors for rotations and translations.  Default to 0
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
 
-  // Observation point
-  TVector3D Obs(0, 0, 0);
-  try {
-    Obs = OSCARSPY::ListAsTVector3D(List_Obs);
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'obs'");
-    return NULL;
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
   }
 
 
-  // Check for HorizontalDirection in the input
-  TVector3D HorizontalDirection(0, 0, 0);
-  if (PyList_Size(List_HorizontalDirection) != 0) {
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
     try {
-      HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
     } catch (std::length_error e) {
       PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
       return NULL;
     }
   }
 
+  // Need exactly one of points or surface
+  if (PS_Surface == Py_None) {
+    PS_Surface = 0x0;
+  }
+  if ((PyList_Size(List_Points) == 0) == (PS_Surface == 0x0)) {
+    PyErr_SetString(PyExc_ValueError, "must specify one of 'points' or 'surface'");
+    return NULL;
+  }
 
-  // Check for PropogationDirection in the input
-  TVector3D PropogationDirection(0, 0, 0);
-  if (PyList_Size(List_PropogationDirection) != 0) {
-    try {
-      PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
-    } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+  // Parametric surface generated in c++
+  TSurfacePoints_Parametric ParametricSurface;
+  if (PS_Surface != 0x0) {
+    if (OSCARSSR_GetParametricSurface(PS_Surface, Rotations, Translation, NormalDirection, ParametricSurface) != 0) {
       return NULL;
     }
   }
 
+  // Look for arbitrary shape 3D points
+  TSurfacePoints_3D Surface;
+  for (int i = 0; i < PyList_Size(List_Points); ++i) {
+    PyObject* LXN = PyList_GetItem(List_Points, i);
+    TVector3D X;
+    TVector3D N;
+    if (PyList_Size(LXN) == 2) {
+
+      try {
+        X = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 0));
+        N = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 1));
+      } catch (std::length_error e) {
+        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points': Point or Normal does not have 3 elements");
+        return NULL;
+      }
+
+      // Rotate point and normal
+      X.RotateSelfXYZ(Rotations);
+      N.RotateSelfXYZ(Rotations);
 
+      // Invert the normal?
+      if (NormalDirection == -1) {
+        N *= -1;
+      }
 
-  // Check NThreads parameter
-  if (NThreads < 0) {
-    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+      // Translate point, normal does not get translated
+      X += Translation;
+
+      Surface.AddPoint(X, N);
+    } else {
+      // input format error
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points'");
+      return NULL;
+    }
+  }
+
+  // Check number of particles
+  if (NParticles < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
     return NULL;
   }
 
@@ -4500,6 +6226,11 @@ static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* arg
     return NULL;
   }
 
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
 
   // Check you are not trying to use threads and GPU
   if (NThreads > 0 && GPU == 1) {
@@ -4507,19 +6238,6 @@ static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* arg
     return NULL;
   }
 
-  // Container for spectrum
-  TSpectrumContainer SpectrumContainer;
-
-  if (VPoints_eV.size() == 0) {
-    // Check NPoints parameter and set minimum if still zero
-    if (NPoints < 1) {
-      NPoints = fabs(EStop - EStart) + 1 > 100 ? abs((int) (EStop - EStart) + 1) : 100;
-    }
-    SpectrumContainer.Init(NPoints, EStart, EStop);
-  } else {
-    SpectrumContainer.Init(VPoints_eV);
-  }
-
   // Check ngpu input
   int NumberOfGPUs = -1;
   std::vector<int> GPUVector;
@@ -4535,35 +6253,44 @@ static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* arg
   int ReturnQuantity = 0;
   std::string ReturnQuantityStr = ReturnQuantityChars;
   std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
-  if (ReturnQuantityStr == "FLUX") {
+  if (ReturnQuantityStr == "POWER DENSITY" || ReturnQuantityStr == "POWERDENSITY") {
     ReturnQuantity = 0;
   } else if (ReturnQuantityStr == "PRECISION") {
     ReturnQuantity = 1;
   } else if (ReturnQuantityStr == "LEVEL") {
     ReturnQuantity = 2;
   } else {
-    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'flux', 'precision', 'level', or blank");
+    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'power density', 'precision', 'level', or blank");
     return NULL;
   }
 
+  // Container for Point plus scalar
+  T3DScalarContainer PowerDensityContainer;
+
+
   // Actually calculate the spectrum
-  try {
-    self->obj->CalculateSpectrum(Obs,
-                                 SpectrumContainer,
-                                 Polarization,
-                                 Angle,
-                                 HorizontalDirection,
-                                 PropogationDirection,
-                                 NParticles,
-                                 NThreads,
-                                 GPU,
-                                 NumberOfGPUs,
-                                 GPUVector,
-                                 Precision,
-                                 MaxLevel,
-                                 MaxLevelExtended,
-                                 ReturnQuantity);
+  bool const Directional = NormalDirection == 0 ? false : true;
+
+  // Surface to use
+  TSurfacePoints const* SurfacePoints = &Surface;
+  if (PS_Surface != 0x0) {
+    SurfacePoints = &ParametricSurface;
+  }
 
+  try {
+    self->obj->CalculatePowerDensity(*SurfacePoints,
+                                     PowerDensityContainer,
+                                     Dim,
+                                     Directional,
+                                     Precision,
+                                     MaxLevel,
+                                     MaxLevelExtended,
+                                     NParticles,
+                                     NThreads,
+                                     GPU,
+                                     NumberOfGPUs,
+                                     GPUVector,
+                                     ReturnQuantity);
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -4575,111 +6302,111 @@ static PyObject* OSCARSSR_CalculateSpectrum (OSCARSSRObject* self, PyObject* arg
     return NULL;
   }
 
-  if (!SpectrumContainer.AllConverged()) {
+  // If not converged print warning
+  if (!PowerDensityContainer.AllConverged()) {
     OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
   }
 
+  // Write the output file if requested
+  // Text output
+  //if (std::string(OutFileNameText) != "") {
+  //  PowerDensityContainer.WriteToFileText(OutFileNameText, Dim);
+  //}
 
-  if (std::string(OutFileNameText) != "") {
-    SpectrumContainer.WriteToFileText(OutFileNameText);
-  }
-
-  if (std::string(OutFileNameBinary) != "") {
-    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
-  }
-
-  // Return the spectrum
-  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
-}
-
-
-
-
+  // Binary output
+  //if (std::string(OutFileNameBinary) != "") {
+  //  PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
+  //}
 
 
+  // Build the output list of: [[[x, y, z], PowerDensity], [...]]
+  // Create a python list
+  PyObject *PList = PyList_New(0);
 
+  // UPDATE: URGENT: PD output ofile, bofile
+  size_t const NPoints = PowerDensityContainer.GetNPoints();
 
+  PyObject* Value;
 
+  for (size_t i = 0; i != NPoints; ++i) {
+    T3DScalar P = PowerDensityContainer.GetPoint(i);
 
+    // Inner list for each point
+    PyObject *PList2 = PyList_New(0);
 
 
+    // Add position and value to list
+    Value = OSCARSPY::TVector3DAsList(P.GetX());
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
 
+    Value = Py_BuildValue("f", P.GetV());
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
 
+    PyList_Append(PList, PList2);
+    Py_DECREF(PList2);
 
+  }
 
-const char* DOC_OSCARSSR_CalculateTotalPower = R"docstring(
-calculate_total_power()
+  return PList;
+}
 
-Calculate the total radiated power based on the current particle and that particle's beam current.
 
-See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
 
-Returns
--------
-power : float
-    Total power in [W]
-)docstring";
-static PyObject* OSCARSSR_CalculateTotalPower (OSCARSSRObject* self)
-{
-  // Calculate the total power radiated by the current particle
 
-  double Power = 0;
 
-  // Check if a beam is at least defined
-  if (self->obj->GetNParticleBeams() < 1) {
-    PyErr_SetString(PyExc_ValueError, "No particle beam defined");
-    return NULL;
-  }
 
-  // Return the total power
-  // UPDATE: This does not fail when no beam defined
-  try {
-    Power = self->obj->CalculateTotalPower();
-  } catch (std::length_error e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
-    return NULL;
-  } catch (std::out_of_range e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
-    return NULL;
-  }
 
-  return Py_BuildValue("f", Power);
-}
+const char* DOC_OSCARSSR_CalculatePowerDensityRectangle = R"docstring(
+calculate_power_density_rectangle(npoints [, plane, width, x0x1x2, rotations, translation, ofile, bofile, normal, nparticles, gpu, ngpu, nthreads, precision, max_level, max_level_extended, dim, quantity, emittance_mode, cofile, adaptive, max_depth, resample, symmetry])
 
+Calculate the power density in a rectangle either defined by three points, or by defining the plane the rectangle is in and the width, and then rotating and translating it to where it needs be.  The simplest is outlined in the first example below.  By default (dim=2) this returns a list whose position coordinates are in the local coordinate space x1 and x2 (*ie* they do not include the rotations and translation).  if dim=3 the coordinates in the return list are in absolute 3D space.
 
+See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
+You **must** specify either both (*plane* and *width*) or *x0x1x2*
 
+Parameters
+----------
+npoints: int
+    number of in each dimension for surface
 
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
 
+width : list
+    Width of rectangle in X1 and X2: [w1, w2]
 
-const char* DOC_OSCARSSR_CalculatePowerDensity = R"docstring(
-calculate_power_density(points [, normal, rotations, translation, nparticles, gpu, nthreads, precision, max_level, max_level_extended, quantity, ofile])
+x0x1x2 : list
+    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram (vectors 0->1, and 0->2)
 
-Calculate the power density for each point in the list *points*.
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-See the :doc:`MathematicalNotes` section for the expression used in this calculation.
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
 
-Parameters
-----------
+ofile : str
+    Output file name
 
-points : list
-    A list of points, each point containing a position in 3D (as a list) and a normal vector at that position (also as a 3D list): [[[x, y, z], [nx. ny. nz]], [...], ...]
+bofile : str
+    Binary output file name
 
 normal : int
     -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
-
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
-
 nparticles : int
     Number of particles to use for multi-particle calculations
 
 gpu : int
-    Use the gpu or not (0 or 1)
+    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
+
+ngpu : int or list
+    If ngpu is an int, use that number of gpus (if available).
+    If ngpu is a list, the list should be a list of gpus you wish to use
+
 
 nthreads : int
     Number of threads to use
@@ -4690,10 +6417,12 @@ precision : float
 max_level: int
     Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
 
-
 max_level_extended: int
     Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
 
+dim : int
+    Defaults to 2 where output is in the local plane coordinates X1 and X2.  If you want the return to be given in 3D set dim=3 which will return with X, Y, and Z in absolute coordinates.
+
 quantity: str
     Quantity to return.
     Available are:
@@ -4701,38 +6430,98 @@ quantity: str
         'precision' - Estimated precision for each point
         'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
 
-ofile : str
-    Output file name
+emittance_mode : str
+    How the beam emittance is included.
+    Available are:
+        'montecarlo'  (default) - Average over 'nparticles' random particles
+        'convolution' - Calculate the single particle power density once on a padded rectangle and convolve with the gaussian beam size projected onto the rectangle from the beam twiss parameters and emittance.  Requires one beam and a rectangle aligned with the beam horizontal and vertical directions.  Energy spread is ignored.
+        'validate'    - Return the 'convolution' result and print its difference with respect to a 'montecarlo' calculation using 'nparticles'
+
+cofile : str
+    Chunked result file name.  The result is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_power_density(cifiles=[...])
+
+adaptive : float
+    If > 0 'npoints' is a coarse grid and each cell is split in four, up to 'max_depth' times, wherever the power density at the edge midpoints and centre of the cell differs from the bilinear interpolation of its corners by more than this fraction of the maximum.  Neighbouring cells differ by at most one split.  The coarse grid must be fine enough to see every feature.  With 'nparticles' one set of random particles is drawn and used for every round of refinement, on the cpu.  Not available with emittance_mode other than 'montecarlo'.  Default is 0 (uniform grid)
+
+max_depth : int
+    Maximum number of times a coarse cell is split for 'adaptive'.  Default is 4
+
+resample : list [int, int]
+    For 'adaptive', return (and write) a uniform grid of [n1, n2] points interpolated from the refined cells instead of the calculated points.  The interpolation is continuous across cells of different size
+
+symmetry : str
+    Mirror symmetry of the result about the centre lines of the rectangle.  Only the fundamental half or quadrant (including the centre lines) is calculated and mirrored to the rest.
+    Available are:
+        'none' (default)
+        'x1'   - symmetric in X1
+        'x2'   - symmetric in X2
+        'x1x2' - symmetric in both
+        'auto' - take the symmetry from 4 points and their mirror images calculated with the ideal particle, which must agree to within 1e-6 of the largest of them.  Small real asymmetries, such as from a trajectory off the centre line, are not mirrored away.  The symmetry used is reported in get_last_calculation_path()
+    Not available with 'adaptive' or emittance_mode other than 'montecarlo'.  For multi-particle calculations the beam must be symmetric too
 
 Returns
 -------
 power_density : list
-    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], pd_0], [[x1_1, x2_1, x3_1], pd_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
+    A list, each element of which is a pair representing the position (2D relative or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[x1_0, x2_0], pd_0, [x1_1, x2_1], pd_1],  ...]
+    For 'adaptive' without 'resample' these are all calculated points, the coarse grid first, in the order they were calculated
+
+Examples
+--------
+Calculate the power density within a simple rectangle 1 [cm] x 1 [cm], 30 [m] downstream
+
+    >>> osr.calculate_power_density(plane='XY', width=[0.01, 0.01], npoints=[51, 51], translation=[0, 0, 30])
+
+Calculate the power density within a simple rectangle 1 [cm] x 1 [cm], 30 [m] downstream defined using the three-point method
+
+    >>> osr.calculate_power_density(x0x1x2=[[-0.005, -0.005, 30], [+0.005, -0.005, 30], [-0.005, +0.005, 30]], npoints=[51, 51])
+
+Calculate the power density on a flat surface close to and parallel to the beam direction (beam in z-direction)
+
+    >>> power_density = osr.calculate_power_density(plane='XZ', width=[0.008, 2], npoints=[51, 101], normal=-1)
 )docstring";
-static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
-  // Calculate the power density given a list of points
+  // Calculate the spectrum given an observation point, and energy range
 
+  char const* SurfacePlane = "";
+  size_t      NX1 = 0;
+  size_t      NX2 = 0;
+  double      Width_X1 = 0;
+  double      Width_X2 = 0;
+  PyObject*   List_NPoints     = PyList_New(0);
+  PyObject*   List_Width       = PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
   PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Points      = PyList_New(0);
+  PyObject*   List_X0X1X2      = PyList_New(0);
   int         NormalDirection = 0;
-  int const   Dim = 3;
   int         NParticles = 0;
   int         GPU = -1;
   PyObject*   NGPU = 0x0;
   int         NThreads = 0;
+  int         Dim = 2;
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
   char const* ReturnQuantityChars = "power density";
-  char const* OutFileName = "";
+  const char* OutFileNameText = "";
+  const char* OutFileNameBinary = "";
+  char const* EmittanceModeChars = "montecarlo";
+  const char* OutFileNameChunked = "";
+  double      Adaptive = 0;
+  int         MaxDepth = 4;
+  PyObject*   List_Resample    = PyList_New(0);
+  char const* SymmetryChars = "none";
 
 
-  static const char *kwlist[] = {"points",
-                                 "normal",
+  static const char *kwlist[] = {"npoints",
+                                 "plane",
+                                 "width",
+                                 "x0x1x2",
                                  "rotations",
                                  "translation",
+                                 "ofile",
+                                 "bofile",
+                                 "normal",
                                  "nparticles",
                                  "gpu",
                                  "ngpu",
@@ -4740,16 +6529,27 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
+                                 "dim",
                                  "quantity",
-                                 "ofile",
-                                 NULL};
+                                 "emittance_mode",
+                                 "cofile",
+                                 "adaptive",
+                                 "max_depth",
+                                 "resample",
+                                 "symmetry",
+                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|iOOiiOidiiss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|sOOOOssiiiOidiiisssdiOs",
                                    const_cast<char **>(kwlist),
-                                   &List_Points,
-                                   &NormalDirection,
+                                   &List_NPoints,
+                                   &SurfacePlane,
+                                   &List_Width,
+                                   &List_X0X1X2,
                                    &List_Rotations,
                                    &List_Translation,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary,
+                                   &NormalDirection,
                                    &NParticles,
                                    &GPU,
                                    &NGPU,
@@ -4757,8 +6557,14 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
+                                   &Dim,
                                    &ReturnQuantityChars,
-                                   &OutFileName)) {
+                                   &EmittanceModeChars,
+                                   &OutFileNameChunked,
+                                   &Adaptive,
+                                   &MaxDepth,
+                                   &List_Resample,
+                                   &SymmetryChars)) {
     return NULL;
   }
 
@@ -4776,11 +6582,29 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
   }
 
 
+  // The rectangular surface object we'll use
+  TSurfacePoints_Rectangle Surface;
+
+  if (PyList_Size(List_NPoints) == 2) {
+    // NPoints in [m]
+    NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
+    NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'npoints' must be [int, int]");
+    return NULL;
+  }
+
+
+
+  if (NX1 <= 0 || NX2 <= 0) {
+    PyErr_SetString(PyExc_ValueError, "an entry in 'npoints' is <= 0");
+    return NULL;
+  }
+
   // Vectors for rotations and translations.  Default to 0
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
 
-
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
     try {
@@ -4802,42 +6626,56 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
     }
   }
 
-  // Look for arbitrary shape 3D points
-  TSurfacePoints_3D Surface;
-  for (int i = 0; i < PyList_Size(List_Points); ++i) {
-    PyObject* LXN = PyList_GetItem(List_Points, i);
-    TVector3D X;
-    TVector3D N;
-    if (PyList_Size(LXN) == 2) {
+  if (PyList_Size(List_Width) == 2) {
+    // Width in [m]
+    Width_X1 = PyFloat_AsDouble(PyList_GetItem(List_Width, 0));
+    Width_X2 = PyFloat_AsDouble(PyList_GetItem(List_Width, 1));
+  }
 
-      try {
-        X = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 0));
-        N = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 1));
-      } catch (std::length_error e) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points': Point or Normal does not have 3 elements");
-        return NULL;
-      }
 
-      // Rotate point and normal
-      X.RotateSelfXYZ(Rotations);
-      N.RotateSelfXYZ(Rotations);
 
-      // Invert the normal?
-      if (NormalDirection == -1) {
-        N *= -1;
-      }
+  // If you are requesting a simple surface plane, check that you have widths
+  if (std::strlen(SurfacePlane) != 0 && Width_X1 > 0 && Width_X2 > 0) {
+    try {
+      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width_X1, Width_X2, Rotations, Translation, NormalDirection);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
 
-      // Translate point, normal does not get translated
-      X += Translation;
 
-      Surface.AddPoint(X, N);
+
+  // If X0X1X2 defined
+  std::vector<TVector3D> X0X1X2;
+
+  if (PyList_Size(List_X0X1X2) != 0) {
+    if (PyList_Size(List_X0X1X2) == 3) {
+      for (int i = 0; i != 3; ++i) {
+        PyObject* List_X = PyList_GetItem(List_X0X1X2, i);
+
+        try {
+          X0X1X2.push_back(OSCARSPY::ListAsTVector3D(List_X));
+        } catch (std::length_error e) {
+          PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0x1x2'");
+          return NULL;
+        }
+      }
     } else {
-      // input format error
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points'");
+      PyErr_SetString(PyExc_ValueError, "'x0x1x2' must have 3 XYZ points defined correctly");
       return NULL;
     }
+
+    for (std::vector<TVector3D>::iterator it = X0X1X2.begin(); it != X0X1X2.end(); ++it) {
+      it->RotateSelfXYZ(Rotations);
+      *it += Translation;
+    }
+
+    // UPDATE: Check for orthogonality
+    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
   }
 
+
   // Check number of particles
   if (NParticles < 0) {
     PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
@@ -4874,7 +6712,6 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
     }
   }
 
-
   int ReturnQuantity = 0;
   std::string ReturnQuantityStr = ReturnQuantityChars;
   std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
@@ -4889,27 +6726,163 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
     return NULL;
   }
 
+  // How to include the beam emittance
+  int EmittanceMode = 0;
+  std::string EmittanceModeStr = EmittanceModeChars;
+  std::transform(EmittanceModeStr.begin(), EmittanceModeStr.end(), EmittanceModeStr.begin(), ::toupper);
+  if (EmittanceModeStr == "MONTECARLO") {
+    EmittanceMode = 0;
+  } else if (EmittanceModeStr == "CONVOLUTION") {
+    EmittanceMode = 1;
+  } else if (EmittanceModeStr == "VALIDATE") {
+    EmittanceMode = 2;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'emittance_mode' must be: 'montecarlo', 'convolution', or 'validate'");
+    return NULL;
+  }
+  if (EmittanceMode == 2 && NParticles < 1) {
+    PyErr_SetString(PyExc_ValueError, "'emittance_mode' 'validate' requires 'nparticles' >= 1");
+    return NULL;
+  }
+
+  // Adaptive refinement and the optional uniform grid to resample to
+  int NResampleX1 = 0;
+  int NResampleX2 = 0;
+  if (Adaptive < 0) {
+    PyErr_SetString(PyExc_ValueError, "'adaptive' must be >= 0");
+    return NULL;
+  }
+  if (Adaptive > 0 && EmittanceMode != 0) {
+    PyErr_SetString(PyExc_ValueError, "'adaptive' is only available with 'emittance_mode' 'montecarlo'");
+    return NULL;
+  }
+  if (PyList_Size(List_Resample) != 0) {
+    if (PyList_Size(List_Resample) != 2) {
+      PyErr_SetString(PyExc_ValueError, "'resample' must be [int, int]");
+      return NULL;
+    }
+    NResampleX1 = (int) PyLong_AsLong(PyList_GetItem(List_Resample, 0));
+    NResampleX2 = (int) PyLong_AsLong(PyList_GetItem(List_Resample, 1));
+    if (NResampleX1 < 1 || NResampleX2 < 1) {
+      PyErr_SetString(PyExc_ValueError, "an entry in 'resample' is < 1");
+      return NULL;
+    }
+  }
+
+  // Mirror symmetry
+  int Symmetry = OSCARSSR::kSymmetry_None;
+  std::string SymmetryStr = SymmetryChars;
+  std::transform(SymmetryStr.begin(), SymmetryStr.end(), SymmetryStr.begin(), ::toupper);
+  if (SymmetryStr == "NONE") {
+    Symmetry = OSCARSSR::kSymmetry_None;
+  } else if (SymmetryStr == "X1") {
+    Symmetry = OSCARSSR::kSymmetry_X1;
+  } else if (SymmetryStr == "X2") {
+    Symmetry = OSCARSSR::kSymmetry_X2;
+  } else if (SymmetryStr == "X1X2") {
+    Symmetry = OSCARSSR::kSymmetry_X1X2;
+  } else if (SymmetryStr == "AUTO") {
+    Symmetry = OSCARSSR::kSymmetry_Auto;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'symmetry' must be: 'none', 'x1', 'x2', 'x1x2', or 'auto'");
+    return NULL;
+  }
+  if (Symmetry != OSCARSSR::kSymmetry_None && (Adaptive > 0 || EmittanceMode != 0)) {
+    PyErr_SetString(PyExc_ValueError, "'symmetry' is not available with 'adaptive' or 'emittance_mode' other than 'montecarlo'");
+    return NULL;
+  }
+
+
   // Container for Point plus scalar
   T3DScalarContainer PowerDensityContainer;
 
-
   // Actually calculate the spectrum
   bool const Directional = NormalDirection == 0 ? false : true;
-
   try {
-    self->obj->CalculatePowerDensity(Surface,
-                                     PowerDensityContainer,
-                                     Dim,
-                                     Directional,
-                                     Precision,
-                                     MaxLevel,
-                                     MaxLevelExtended,
-                                     NParticles,
-                                     NThreads,
-                                     GPU,
-                                     NumberOfGPUs,
-                                     GPUVector,
-                                     ReturnQuantity);
+    if (Adaptive > 0) {
+      TSurfaceQuadtree Tree;
+      self->obj->CalculatePowerDensityAdaptive(Surface,
+                                               Tree,
+                                               Adaptive,
+                                               MaxDepth,
+                                               Directional,
+                                               Precision,
+                                               MaxLevel,
+                                               MaxLevelExtended,
+                                               NParticles,
+                                               NThreads,
+                                               GPU,
+                                               NumberOfGPUs,
+                                               GPUVector,
+                                               ReturnQuantity);
+      if (NResampleX1 > 0) {
+        Tree.Resample(NResampleX1, NResampleX2, PowerDensityContainer, Dim);
+      } else {
+        Tree.Fill(PowerDensityContainer, Dim);
+      }
+    } else if (Symmetry != OSCARSSR::kSymmetry_None) {
+      self->obj->CalculatePowerDensitySymmetric(Surface,
+                                                Symmetry,
+                                                PowerDensityContainer,
+                                                Dim,
+                                                Directional,
+                                                Precision,
+                                                MaxLevel,
+                                                MaxLevelExtended,
+                                                NParticles,
+                                                NThreads,
+                                                GPU,
+                                                NumberOfGPUs,
+                                                GPUVector,
+                                                ReturnQuantity);
+    } else if (EmittanceMode == 0) {
+      self->obj->CalculatePowerDensity(Surface,
+                                       PowerDensityContainer,
+                                       Dim,
+                                       Directional,
+                                       Precision,
+                                       MaxLevel,
+                                       MaxLevelExtended,
+                                       NParticles,
+                                       NThreads,
+                                       GPU,
+                                       NumberOfGPUs,
+                                       GPUVector,
+                                       ReturnQuantity);
+    } else {
+      self->obj->CalculatePowerDensityConvolution(Surface,
+                                                  PowerDensityContainer,
+                                                  Dim,
+                                                  Directional,
+                                                  Precision,
+                                                  MaxLevel,
+                                                  MaxLevelExtended,
+                                                  NThreads,
+                                                  GPU,
+                                                  NumberOfGPUs,
+                                                  GPUVector,
+                                                  ReturnQuantity);
+
+      // Compare to the monte carlo calculation if requested
+      if (EmittanceMode == 2) {
+        T3DScalarContainer MonteCarloContainer;
+        self->obj->CalculatePowerDensity(Surface,
+                                         MonteCarloContainer,
+                                         Dim,
+                                         Directional,
+                                         Precision,
+                                         MaxLevel,
+                                         MaxLevelExtended,
+                                         NParticles,
+                                         NThreads,
+                                         GPU,
+                                         NumberOfGPUs,
+                                         GPUVector,
+                                         ReturnQuantity);
+        OSCARSSR_PrintConvolutionValidation(PowerDensityContainer, MonteCarloContainer);
+      }
+    }
+
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -4928,14 +6901,27 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
 
   // Write the output file if requested
   // Text output
-  //if (std::string(OutFileNameText) != "") {
-  //  PowerDensityContainer.WriteToFileText(OutFileNameText, Dim);
-  //}
+  if (std::string(OutFileNameText) != "") {
+    PowerDensityContainer.WriteToFileText(OutFileNameText, Dim);
+  }
 
   // Binary output
-  //if (std::string(OutFileNameBinary) != "") {
-  //  PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
-  //}
+  if (std::string(OutFileNameBinary) != "") {
+    PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
+  }
+
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      PowerDensityContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
 
 
   // Build the output list of: [[[x, y, z], PowerDensity], [...]]
@@ -4959,17 +6945,26 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
     PyList_Append(PList2, Value);
     Py_DECREF(Value);
 
-    Value = Py_BuildValue("f", P.GetV());
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+    Value = Py_BuildValue("f", P.GetV());
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
+
+    PyList_Append(PList, PList2);
+    Py_DECREF(PList2);
+
+  }
+
+  return PList;
+}
+
+
+
+
+
+
 
-    PyList_Append(PList, PList2);
-    Py_DECREF(PList2);
 
-  }
 
-  return PList;
-}
 
 
 
@@ -4978,10 +6973,13 @@ static PyObject* OSCARSSR_CalculatePowerDensity (OSCARSSRObject* self, PyObject*
 
 
 
-const char* DOC_OSCARSSR_CalculatePowerDensityRectangle = R"docstring(
-calculate_power_density_rectangle(npoints [, plane, width, x0x1x2, rotations, translation, ofile, bofile, normal, nparticles, gpu, ngpu, nthreads, precision, max_level, max_level_extended, dim, quantity])
 
-Calculate the power density in a rectangle either defined by three points, or by defining the plane the rectangle is in and the width, and then rotating and translating it to where it needs be.  The simplest is outlined in the first example below.  By default (dim=2) this returns a list whose position coordinates are in the local coordinate space x1 and x2 (*ie* they do not include the rotations and translation).  if dim=3 the coordinates in the return list are in absolute 3D space.
+
+
+const char* DOC_OSCARSSR_CalculatePowerDensitySTL = R"docstring(
+calculate_power_density_stl(ifiles [, rotations, translation, ofile, bofile, stlofile, normal, scale, nparticles, gpu, ngpu, nthreads, precision, max_level, max_level_extended, quantity, cofile, shadowing, evaluate, plyofile, weld_tolerance])
+
+Calculate the power density on surfaces described in STL format (binary or ASCII) input files
 
 See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
@@ -4989,17 +6987,11 @@ You **must** specify either both (*plane* and *width*) or *x0x1x2*
 
 Parameters
 ----------
-npoints: int
-    number of in each dimension for surface
-
-plane : str
-    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
-
-width : list
-    Width of rectangle in X1 and X2: [w1, w2]
+ifiles : list[str]
+    A list of STL files to import.  All files are read into one assembly.
 
-x0x1x2 : list
-    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram (vectors 0->1, and 0->2)
+ifile : str
+    A single STL file to import
 
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
@@ -5013,9 +7005,18 @@ ofile : str
 bofile : str
     Binary output file name
 
+stlofile : str
+    STL output file name.  The attribute bytes of each triangle hold a colour from blue (lowest power density) to red (highest) in the VisCAM/SolidView convention
+
+plyofile : str
+    PLY output file name.  ASCII PLY of the welded mesh with the power density and a colour from blue to red for each vertex (evaluate='vertex') or each face
+
 normal : int
     -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
+scale : float
+    What to scale the dimensions by.  Default input is in meters.
+
 nparticles : int
     Number of particles to use for multi-particle calculations
 
@@ -5039,9 +7040,6 @@ max_level: int
 max_level_extended: int
     Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
 
-dim : int
-    Defaults to 2 where output is in the local plane coordinates X1 and X2.  If you want the return to be given in 3D set dim=3 which will return with X, Y, and Z in absolute coordinates.
-
 quantity: str
     Quantity to return.
     Available are:
@@ -5049,62 +7047,69 @@ quantity: str
         'precision' - Estimated precision for each point
         'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
 
+cofile : str
+    Chunked result file name.  The result is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_power_density(cifiles=[...])
+
+shadowing : int
+    1 to account for line of sight: trajectory segments hidden from a triangle by any other triangle of the assembly do not contribute to it.  A bounding volume hierarchy over the triangles is used for the tests.  Triangles no trajectory segment can reach are not calculated.  Not available on the gpu.  Default is 0.  See also set_emission_cone_culling()
+
+evaluate : str
+    'face' (default) to calculate at the centre of every triangle.  'vertex' to weld duplicate vertices into an indexed mesh and calculate once at every unique vertex, with the area weighted normal of the triangles sharing it.  For smooth shading this is about half the number of points
+
+weld_tolerance : float
+    Vertices within this distance of an earlier vertex are welded to the closest one.  Default is 0, only identical vertices are welded
+
 Returns
 -------
 power_density : list
-    A list, each element of which is a pair representing the position (2D relative or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[x1_0, x2_0], pd_0, [x1_1, x2_1], pd_1],  ...]
+    This return list is NOT the same as other power density calculations.  The return format is as follows:
+    [ [[[T0x, T0y, T0z], [T1x, T1y, T1z], [T2x, T2y, T2z]], PD], [...], ...]
+    where the Ts are the triangle vertices, and PD is the power density in the center of that triangle.
+    For evaluate='vertex' PD is a list of the power density at each of the three vertices [PD0, PD1, PD2]
 
 Examples
 --------
-Calculate the power density within a simple rectangle 1 [cm] x 1 [cm], 30 [m] downstream
-
-    >>> osr.calculate_power_density(plane='XY', width=[0.01, 0.01], npoints=[51, 51], translation=[0, 0, 30])
-
-Calculate the power density within a simple rectangle 1 [cm] x 1 [cm], 30 [m] downstream defined using the three-point method
-
-    >>> osr.calculate_power_density(x0x1x2=[[-0.005, -0.005, 30], [+0.005, -0.005, 30], [-0.005, +0.005, 30]], npoints=[51, 51])
-
-Calculate the power density on a flat surface close to and parallel to the beam direction (beam in z-direction)
-
-    >>> power_density = osr.calculate_power_density(plane='XZ', width=[0.008, 2], npoints=[51, 101], normal=-1)
+coming
 )docstring";
-static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
   // Calculate the spectrum given an observation point, and energy range
 
-  char const* SurfacePlane = "";
-  size_t      NX1 = 0;
-  size_t      NX2 = 0;
-  double      Width_X1 = 0;
-  double      Width_X2 = 0;
-  PyObject*   List_NPoints     = PyList_New(0);
-  PyObject*   List_Width       = PyList_New(0);
+  PyObject*   List_Files = PyList_New(0);
+  const char* InFileName = "";
   PyObject*   List_Translation = PyList_New(0);
   PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_X0X1X2      = PyList_New(0);
-  int         NormalDirection = 0;
+  int         NormalDirection = -1;    // Default to -1 for STL
+  double      Scale = 1;
   int         NParticles = 0;
   int         GPU = -1;
   PyObject*   NGPU = 0x0;
   int         NThreads = 0;
-  int         Dim = 2;
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
   char const* ReturnQuantityChars = "power density";
   const char* OutFileNameText = "";
   const char* OutFileNameBinary = "";
+  const char* OutFileNameChunked = "";
+  const char* OutFileNameSTL = "";
+  int         Shadowing = 0;
+  char const* EvaluateChars = "face";
+  const char* OutFileNamePLY = "";
+  double      WeldTolerance = 0;
 
+  int const Dim = 3;
 
-  static const char *kwlist[] = {"npoints",
-                                 "plane",
-                                 "width",
-                                 "x0x1x2",
+
+  static const char *kwlist[] = {"ifiles",
+                                 "ifile",
                                  "rotations",
                                  "translation",
                                  "ofile",
                                  "bofile",
+                                 "stlofile",
                                  "normal",
+                                 "scale",
                                  "nparticles",
                                  "gpu",
                                  "ngpu",
@@ -5112,21 +7117,25 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
-                                 "dim",
                                  "quantity",
+                                 "cofile",
+                                 "shadowing",
+                                 "evaluate",
+                                 "plyofile",
+                                 "weld_tolerance",
                                   NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|sOOOOssiiiOidiiis",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OsOOsssidiiOidiiisissd",
                                    const_cast<char **>(kwlist),
-                                   &List_NPoints,
-                                   &SurfacePlane,
-                                   &List_Width,
-                                   &List_X0X1X2,
+                                   &List_Files,
+                                   &InFileName,
                                    &List_Rotations,
                                    &List_Translation,
                                    &OutFileNameText,
                                    &OutFileNameBinary,
+                                   &OutFileNameSTL,
                                    &NormalDirection,
+                                   &Scale,
                                    &NParticles,
                                    &GPU,
                                    &NGPU,
@@ -5134,8 +7143,12 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
-                                   &Dim,
-                                   &ReturnQuantityChars)) {
+                                   &ReturnQuantityChars,
+                                   &OutFileNameChunked,
+                                   &Shadowing,
+                                   &EvaluateChars,
+                                   &OutFileNamePLY,
+                                   &WeldTolerance)) {
     return NULL;
   }
 
@@ -5146,31 +7159,6 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
   }
 
 
-  // Check requested dimension
-  if (Dim != 2 && Dim != 3) {
-    PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
-    return NULL;
-  }
-
-
-  // The rectangular surface object we'll use
-  TSurfacePoints_Rectangle Surface;
-
-  if (PyList_Size(List_NPoints) == 2) {
-    // NPoints in [m]
-    NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
-    NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
-  } else {
-    PyErr_SetString(PyExc_ValueError, "'npoints' must be [int, int]");
-    return NULL;
-  }
-
-
-
-  if (NX1 <= 0 || NX2 <= 0) {
-    PyErr_SetString(PyExc_ValueError, "an entry in 'npoints' is <= 0");
-    return NULL;
-  }
 
   // Vectors for rotations and translations.  Default to 0
   TVector3D Rotations(0, 0, 0);
@@ -5197,54 +7185,6 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
     }
   }
 
-  if (PyList_Size(List_Width) == 2) {
-    // Width in [m]
-    Width_X1 = PyFloat_AsDouble(PyList_GetItem(List_Width, 0));
-    Width_X2 = PyFloat_AsDouble(PyList_GetItem(List_Width, 1));
-  }
-
-
-
-  // If you are requesting a simple surface plane, check that you have widths
-  if (std::strlen(SurfacePlane) != 0 && Width_X1 > 0 && Width_X2 > 0) {
-    try {
-      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width_X1, Width_X2, Rotations, Translation, NormalDirection);
-    } catch (std::invalid_argument e) {
-      PyErr_SetString(PyExc_ValueError, e.what());
-      return NULL;
-    }
-  }
-
-
-
-  // If X0X1X2 defined
-  std::vector<TVector3D> X0X1X2;
-
-  if (PyList_Size(List_X0X1X2) != 0) {
-    if (PyList_Size(List_X0X1X2) == 3) {
-      for (int i = 0; i != 3; ++i) {
-        PyObject* List_X = PyList_GetItem(List_X0X1X2, i);
-
-        try {
-          X0X1X2.push_back(OSCARSPY::ListAsTVector3D(List_X));
-        } catch (std::length_error e) {
-          PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0x1x2'");
-          return NULL;
-        }
-      }
-    } else {
-      PyErr_SetString(PyExc_ValueError, "'x0x1x2' must have 3 XYZ points defined correctly");
-      return NULL;
-    }
-
-    for (std::vector<TVector3D>::iterator it = X0X1X2.begin(); it != X0X1X2.end(); ++it) {
-      it->RotateSelfXYZ(Rotations);
-      *it += Translation;
-    }
-
-    // UPDATE: Check for orthogonality
-    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
-  }
 
 
   // Check number of particles
@@ -5297,12 +7237,87 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
     return NULL;
   }
 
+  // Evaluate at triangle centres or at unique vertices
+  std::string EvaluateStr = EvaluateChars;
+  std::transform(EvaluateStr.begin(), EvaluateStr.end(), EvaluateStr.begin(), ::toupper);
+  bool PerVertex = false;
+  if (EvaluateStr == "FACE") {
+    PerVertex = false;
+  } else if (EvaluateStr == "VERTEX") {
+    PerVertex = true;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'evaluate' must be 'face' or 'vertex'");
+    return NULL;
+  }
+
+  if (WeldTolerance < 0) {
+    PyErr_SetString(PyExc_ValueError, "'weld_tolerance' must be >= 0");
+    return NULL;
+  }
+
+  // Shadowing is done on the cpu only
+  if (Shadowing != 0 && GPU == 1) {
+    PyErr_SetString(PyExc_ValueError, "shadowing is not available on the gpu");
+    return NULL;
+  }
+
+  // Files to read, all into the same container
+  std::vector<std::string> FileNames;
+  for (int i = 0; i < PyList_Size(List_Files); ++i) {
+    FileNames.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_Files, i)) );
+  }
+  if (std::string(InFileName) != "") {
+    FileNames.push_back(InFileName);
+  }
+
+  TTriangle3DContainer STLContainer;
+  for (size_t i = 0; i != FileNames.size(); ++i) {
+    try {
+      STLContainer.ReadSTLFile(FileNames[i], Scale);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+  STLContainer.RotateSelfXYZ(Rotations);
+  STLContainer.TranslateSelf(Translation);
+
+  // Indexed mesh for vertex evaluation and PLY output
+  if (PerVertex || std::string(OutFileNamePLY) != "") {
+    STLContainer.WeldVertices(WeldTolerance);
+  }
+
+
+  TSurfacePoints_3D Surface;
+
+  if (PerVertex) {
+    for (size_t iv = 0; iv != STLContainer.GetNVertices(); ++iv) {
+      TVector3D const& Normal = STLContainer.GetVertexNormal(iv);
+      Surface.AddPoint(STLContainer.GetVertex(iv), NormalDirection < 0 ? -Normal : Normal);
+    }
+  } else {
+    for (size_t istl = 0; istl != STLContainer.GetNPoints(); ++istl) {
+      TVector3D Center = STLContainer.GetPoint(istl).GetCenter();
+      if (NormalDirection < 0) {
+        Surface.AddPoint(Center, -STLContainer.GetPoint(istl).GetNormal());
+      } else {
+        Surface.AddPoint(Center, STLContainer.GetPoint(istl).GetNormal());
+      }
+    }
+  }
 
   // Container for Point plus scalar
   T3DScalarContainer PowerDensityContainer;
 
-  // Actually calculate the spectrum
+  // Hierarchy over the triangles for shadowing
+  TTriangle3DBVH Occluders;
+  if (Shadowing != 0) {
+    Occluders.Build(STLContainer);
+  }
+
+  // Actually calculate the spectrum.  The occluders are only set for this calculation
   bool const Directional = NormalDirection == 0 ? false : true;
+  OSCARSSR::TOccludersScope OccludersScope(*self->obj, Shadowing != 0 ? &Occluders : 0x0, !PerVertex);
   try {
     self->obj->CalculatePowerDensity(Surface,
                                      PowerDensityContainer,
@@ -5329,11 +7344,6 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
     return NULL;
   }
 
-  // If not converged print warning
-  if (!PowerDensityContainer.AllConverged()) {
-    OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
-  }
-
   // Write the output file if requested
   // Text output
   if (std::string(OutFileNameText) != "") {
@@ -5345,29 +7355,86 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
     PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
   }
 
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      PowerDensityContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+
+  // Value for every triangle, the mean of its vertices when evaluated at vertices
+  size_t const NTriangles = STLContainer.GetNPoints();
+  std::vector<double> Values(PowerDensityContainer.GetNPoints());
+  for (size_t i = 0; i != Values.size(); ++i) {
+    Values[i] = PowerDensityContainer.GetPoint(i).GetV();
+  }
+  std::vector<double> FaceValues(NTriangles);
+  for (size_t i = 0; i != NTriangles; ++i) {
+    if (PerVertex) {
+      FaceValues[i] = (Values[STLContainer.GetVertexIndex(i, 0)] + Values[STLContainer.GetVertexIndex(i, 1)] + Values[STLContainer.GetVertexIndex(i, 2)]) / 3.;
+    } else {
+      FaceValues[i] = Values[i];
+    }
+  }
+
+  try {
+    if (std::string(OutFileNameSTL) != "") {
+      STLContainer.WriteSTLFile(OutFileNameSTL, FaceValues);
+    }
+    if (std::string(OutFileNamePLY) != "") {
+      STLContainer.WritePLYFile(OutFileNamePLY, PerVertex ? Values : FaceValues, PerVertex);
+    }
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+      
+
 
   // Build the output list of: [[[x, y, z], PowerDensity], [...]]
   // Create a python list
   PyObject *PList = PyList_New(0);
 
-  // UPDATE: URGENT: PD output ofile, bofile
-  size_t const NPoints = PowerDensityContainer.GetNPoints();
-
   PyObject* Value;
 
-  for (size_t i = 0; i != NPoints; ++i) {
-    T3DScalar P = PowerDensityContainer.GetPoint(i);
+  for (size_t i = 0; i != NTriangles; ++i) {
+    TTriangle3D T = STLContainer.GetPoint(i);
 
     // Inner list for each point
     PyObject *PList2 = PyList_New(0);
 
+    PyObject *PListT = PyList_New(0);
 
-    // Add position and value to list
-    Value = OSCARSPY::TVector3DAsList(P.GetX());
-    PyList_Append(PList2, Value);
+    Value = OSCARSPY::TVector3DAsList(T[0]);
+    PyList_Append(PListT, Value);
+    Py_DECREF(Value);
+
+    Value = OSCARSPY::TVector3DAsList(T[1]);
+    PyList_Append(PListT, Value);
+    Py_DECREF(Value);
+
+    Value = OSCARSPY::TVector3DAsList(T[2]);
+    PyList_Append(PListT, Value);
     Py_DECREF(Value);
 
-    Value = Py_BuildValue("f", P.GetV());
+    // Add position and value to list
+    PyList_Append(PList2, PListT);
+    Py_DECREF(PListT);
+
+    if (PerVertex) {
+      Value = Py_BuildValue("[fff]", Values[STLContainer.GetVertexIndex(i, 0)], Values[STLContainer.GetVertexIndex(i, 1)], Values[STLContainer.GetVertexIndex(i, 2)]);
+    } else {
+      Value = Py_BuildValue("f", Values[i]);
+    }
     PyList_Append(PList2, Value);
     Py_DECREF(Value);
 
@@ -5398,25 +7465,24 @@ static PyObject* OSCARSSR_CalculatePowerDensityRectangle (OSCARSSRObject* self,
 
 
 
-const char* DOC_OSCARSSR_CalculatePowerDensitySTL = R"docstring(
-calculate_power_density_stl(ifiles [, rotations, translation, ofile, bofile, stlofile, normal, scale, nparticles, gpu, ngpu, nthreads, precision, max_level, max_level_extended, quantity])
-
-Calculate the power density on surfaces described in STL format input files
+const char* DOC_OSCARSSR_CalculatePowerDensityLine = R"docstring(
+calculate_power_density_line(x1, x2, normal_direction, npoints [, ofile, bofile, normal, nparticles, gpu, nthreads, precision, max_level, cofile])
 
 See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
-You **must** specify either both (*plane* and *width*) or *x0x1x2*
-
 Parameters
 ----------
-ifiles : list[str]
-    A list of STL files to import.
+x1 : list[3]
+    Point in space to start [x0, y0, z0]
 
-rotations : list, optional
-    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+x2 : list[3]
+    Point in space to end [x1, y1, z1]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+normal_direction : list[3]
+    Direction of the normal vector for power density calculation.  Typically this is 
+
+npoints: int
+    number of in each dimension for surface
 
 ofile : str
     Output file name
@@ -5424,25 +7490,14 @@ ofile : str
 bofile : str
     Binary output file name
 
-stlofile : str
-    STL output file name.  Will include RGB color information in the attribute byte count, maybe
-
 normal : int
     -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
-scale : float
-    What to scale the dimensions by.  Default input is in meters.
-
 nparticles : int
     Number of particles to use for multi-particle calculations
 
 gpu : int
-    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
-
-ngpu : int or list
-    If ngpu is an int, use that number of gpus (if available).
-    If ngpu is a list, the list should be a list of gpus you wish to use
-
+    Use the gpu or not (0 or 1)
 
 nthreads : int
     Number of threads to use
@@ -5451,92 +7506,73 @@ precision : float
     Calculation precision parameter (typically 0.01 which is 1%)
 
 max_level: int
-    Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
+    Maximum "level" to us for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
 
 max_level_extended: int
     Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
 
-quantity: str
-    Quantity to return.
-    Available are:
-        'power density' (default)
-        'precision' - Estimated precision for each point
-        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
+cofile : str
+    Chunked result file name.  The result is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_power_density(cifiles=[...])
 
 Returns
 -------
-power_density : list
-    This return list is NOT the same as other power density calculations.  The return format is as follows:
-    [ [[[T0x, T0y, T0z], [T1x, T1y, T1z], [T2x, T2y, T2z]], PD], [...], ...]
-    where the Ts are the triangle vertices, and PD is the power density in the center of that triangle.
+power_density_1d : list
+    A list, each element of which is a pair representing the length along the line specified and power density [:math:`W / mm^2`] at that position.  eg [[x0, p0], [x1, p1], ...]
 
-Examples
---------
-coming
 )docstring";
-static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
   // Calculate the spectrum given an observation point, and energy range
 
-  PyObject*   List_Files = PyList_New(0);
-  const char* InFileName = "";
-  PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Rotations   = PyList_New(0);
-  int         NormalDirection = -1;    // Default to -1 for STL
-  double      Scale = 1;
+  int         NPoints         = 0;
+  PyObject*   List_x1       = PyList_New(0);
+  PyObject*   List_x2         = PyList_New(0);
+  int         NormalDirection = 0;
   int         NParticles = 0;
   int         GPU = -1;
-  PyObject*   NGPU = 0x0;
   int         NThreads = 0;
+  const char* OutFileNameText = "";
+  const char* OutFileNameBinary = "";
+  const char* OutFileNameChunked = "";
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
-  char const* ReturnQuantityChars = "power density";
-  const char* OutFileNameText = "";
-  const char* OutFileNameBinary = "";
-  const char* OutFileNameSTL = "";
-
-  int const Dim = 3;
+  int         Dim = 1;
 
 
-  static const char *kwlist[] = {"ifiles",
-                                 "ifile",
-                                 "rotations",
-                                 "translation",
+  static const char *kwlist[] = {"x1",
+                                 "x2",
+                                 "npoints",
                                  "ofile",
                                  "bofile",
-                                 "stlofile",
                                  "normal",
-                                 "scale",
                                  "nparticles",
                                  "gpu",
-                                 "ngpu",
                                  "nthreads",
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
-                                 "quantity",
+                                 "dim",
+                                 "cofile",
                                   NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OsOOsssidiiOidiii",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|issiiiidiiis",
                                    const_cast<char **>(kwlist),
-                                   &List_Files,
-                                   &InFileName,
-                                   &List_Rotations,
-                                   &List_Translation,
+                                   &List_x1,
+                                   &List_x2,
+                                   &NPoints,
                                    &OutFileNameText,
                                    &OutFileNameBinary,
-                                   &OutFileNameSTL,
                                    &NormalDirection,
-                                   &Scale,
                                    &NParticles,
                                    &GPU,
-                                   &NGPU,
                                    &NThreads,
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
-                                   &ReturnQuantityChars)) {
+                                   &Dim,
+                                   &OutFileNameChunked
+                                   )) {
     return NULL;
   }
 
@@ -5547,33 +7583,45 @@ static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObje
   }
 
 
+  // Check requested dimension
+  if (Dim != 1 && Dim != 3) {
+    PyErr_SetString(PyExc_ValueError, "'dim' must be 1 or 3");
+    return NULL;
+  }
 
-  // Vectors for rotations and translations.  Default to 0
-  TVector3D Rotations(0, 0, 0);
-  TVector3D Translation(0, 0, 0);
 
-  // Check for Rotations in the input
-  if (PyList_Size(List_Rotations) != 0) {
+  if (NPoints < 2) {
+    PyErr_SetString(PyExc_ValueError, "'npoints' must be >= 2");
+    return NULL;
+  }
+
+
+
+  // Vectors for from and to
+  TVector3D x1(0, 0, 0);
+  TVector3D x2(0, 0, 0);
+
+  // Check for from in the input
+  if (PyList_Size(List_x1) != 0) {
     try {
-      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+      x1 = OSCARSPY::ListAsTVector3D(List_x1);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x1'");
       return NULL;
     }
   }
 
-
-  // Check for Translation in the input
-  if (PyList_Size(List_Translation) != 0) {
+  // Check for to in the input
+  if (PyList_Size(List_x2) != 0) {
     try {
-      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+      x2 = OSCARSPY::ListAsTVector3D(List_x2);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x2'");
       return NULL;
     }
   }
 
-
+  TVector3D const Step = (x2 - x1) / (NPoints - 1);
 
   // Check number of particles
   if (NParticles < 0) {
@@ -5600,51 +7648,9 @@ static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObje
     return NULL;
   }
 
-  // Check ngpu input
-  int NumberOfGPUs = -1;
-  std::vector<int> GPUVector;
-  if (NGPU != 0x0) {
-    if (PyLong_Check(NGPU)) {
-      NumberOfGPUs = (int) PyLong_AsLong(NGPU);
-    } else if (PyList_Check(NGPU)) {
-      OSCARSPY::ListToVectorInt(NGPU, GPUVector);
-    }
-  }
-
-  int ReturnQuantity = 0;
-  std::string ReturnQuantityStr = ReturnQuantityChars;
-  std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
-  if (ReturnQuantityStr == "POWER DENSITY" || ReturnQuantityStr == "POWERDENSITY") {
-    ReturnQuantity = 0;
-  } else if (ReturnQuantityStr == "PRECISION") {
-    ReturnQuantity = 1;
-  } else if (ReturnQuantityStr == "LEVEL") {
-    ReturnQuantity = 2;
-  } else {
-    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'power density', 'precision', 'level', or blank");
-    return NULL;
-  }
-
-  TTriangle3DContainer STLContainer;
-  try {
-    STLContainer.ReadSTLFile(InFileName, Scale);
-  } catch (...) {
-    PyErr_SetString(PyExc_ValueError, "Cannot read STL file");
-    return NULL;
-  }
-  STLContainer.RotateSelfXYZ(Rotations);
-  STLContainer.TranslateSelf(Translation);
-
-
   TSurfacePoints_3D Surface;
-
-  for (size_t istl = 0; istl != STLContainer.GetNPoints(); ++istl) {
-    TVector3D Center = STLContainer.GetPoint(istl).GetCenter();
-    if (NormalDirection < 0) {
-      Surface.AddPoint(Center, -STLContainer.GetPoint(istl).GetNormal());
-    } else {
-      Surface.AddPoint(Center, STLContainer.GetPoint(istl).GetNormal());
-    }
+  for (int i = 0; i != NPoints; ++i) {
+    Surface.AddPoint(x1 + i * Step);
   }
 
   // Container for Point plus scalar
@@ -5653,20 +7659,7 @@ static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObje
   // Actually calculate the spectrum
   bool const Directional = NormalDirection == 0 ? false : true;
   try {
-    self->obj->CalculatePowerDensity(Surface,
-                                     PowerDensityContainer,
-                                     Dim,
-                                     Directional,
-                                     Precision,
-                                     MaxLevel,
-                                     MaxLevelExtended,
-                                     NParticles,
-                                     NThreads,
-                                     GPU,
-                                     NumberOfGPUs,
-                                     GPUVector,
-                                     ReturnQuantity);
-
+    self->obj->CalculatePowerDensity(Surface, PowerDensityContainer, Dim, Directional, Precision, MaxLevel, MaxLevelExtended, NParticles, NThreads, GPU);
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -5689,45 +7682,37 @@ static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObje
     PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
   }
 
-  if (std::string(OutFileNameSTL) != "") {
-    STLContainer.WriteSTLFile(OutFileNameSTL);
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      PowerDensityContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
   }
-      
 
 
   // Build the output list of: [[[x, y, z], PowerDensity], [...]]
   // Create a python list
   PyObject *PList = PyList_New(0);
 
-  // UPDATE: URGENT: PD output ofile, bofile
-  size_t const NPoints = PowerDensityContainer.GetNPoints();
-
   PyObject* Value;
 
   for (size_t i = 0; i != NPoints; ++i) {
     T3DScalar P = PowerDensityContainer.GetPoint(i);
-    TTriangle3D T = STLContainer.GetPoint(i);
 
     // Inner list for each point
     PyObject *PList2 = PyList_New(0);
 
-    PyObject *PListT = PyList_New(0);
-
-    Value = OSCARSPY::TVector3DAsList(T[0]);
-    PyList_Append(PListT, Value);
-    Py_DECREF(Value);
-
-    Value = OSCARSPY::TVector3DAsList(T[1]);
-    PyList_Append(PListT, Value);
-    Py_DECREF(Value);
-
-    Value = OSCARSPY::TVector3DAsList(T[2]);
-    PyList_Append(PListT, Value);
-    Py_DECREF(Value);
 
     // Add position and value to list
-    PyList_Append(PList2, PListT);
-    Py_DECREF(PListT);
+    Value = OSCARSPY::TVector3DAsList(P.GetX());
+    PyList_Append(PList2, Value);
+    Py_DECREF(Value);
 
     Value = Py_BuildValue("f", P.GetV());
     PyList_Append(PList2, Value);
@@ -5760,43 +7745,44 @@ static PyObject* OSCARSSR_CalculatePowerDensitySTL (OSCARSSRObject* self, PyObje
 
 
 
-const char* DOC_OSCARSSR_CalculatePowerDensityLine = R"docstring(
-calculate_power_density_line(x1, x2, normal_direction, npoints [, ofile, bofile, normal, nparticles, gpu, nthreads, precision, max_level])
+const char* DOC_OSCARSSR_CalculateFlux = R"docstring(
+calculate_flux(energy_eV, points [, normal, rotations, translation, nparticles, nthreads, gpu, ngpu, precision, max_level, max_level_extended, ofile, bofile, quantity, cofile])
+
+Calculates the flux at a given set of points
 
 See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
 Parameters
 ----------
-x1 : list[3]
-    Point in space to start [x0, y0, z0]
-
-x2 : list[3]
-    Point in space to end [x1, y1, z1]
-
-normal_direction : list[3]
-    Direction of the normal vector for power density calculation.  Typically this is 
 
-npoints: int
-    number of in each dimension for surface
-
-ofile : str
-    Output file name
+energy_eV : float
+    Photon energy of interest
 
-bofile : str
-    Binary output file name
+points : list
+    A list of points, each point containing a position in 3D (as a list) and a normal vector at that position (also as a 3D list): [[[x, y, z], [nx. ny. nz]], [...], ...]
 
 normal : int
     -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
 nparticles : int
     Number of particles to use for multi-particle calculations
 
-gpu : int
-    Use the gpu or not (0 or 1)
-
 nthreads : int
     Number of threads to use
 
+gpu : int
+    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
+
+ngpu : int or list
+    If ngpu is an int, use that number of gpus (if available).
+    If ngpu is a list, the list should be a list of gpus you wish to use
+
 precision : float
     Calculation precision parameter (typically 0.01 which is 1%)
 
@@ -5804,64 +7790,88 @@ max_level: int
     Maximum "level" to us for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
 
 max_level_extended: int
-    Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+    Maximum "level" to us for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+quantity: str
+    Quantity to return.
+    Available are:
+        'power density' (default)
+        'precision' - Estimated precision for each point
+        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
+
+cofile : str
+    Chunked result file name.  The result is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_flux(cifiles=[...])
 
 Returns
 -------
-power_density_1d : list
-    A list, each element of which is a pair representing the length along the line specified and power density [:math:`W / mm^2`] at that position.  eg [[x0, p0], [x1, p1], ...]
-
+power_density : list
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], pd_0], [[x1_1, x2_1, x3_1], pd_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
 )docstring";
-static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
-  // Calculate the spectrum given an observation point, and energy range
+  // Calculate the flux on a surface given an energy and list of points in 3D
 
-  int         NPoints         = 0;
-  PyObject*   List_x1       = PyList_New(0);
-  PyObject*   List_x2         = PyList_New(0);
+  double      Energy_eV = 0;
+  PyObject*   List_Translation = PyList_New(0);
+  PyObject*   List_Rotations   = PyList_New(0);
+  PyObject*   List_Points      = PyList_New(0);
   int         NormalDirection = 0;
+  int         Dim = 3;
   int         NParticles = 0;
-  int         GPU = -1;
   int         NThreads = 0;
-  const char* OutFileNameText = "";
-  const char* OutFileNameBinary = "";
+  int         GPU = -1;
+  PyObject*   NGPU = 0x0;
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
-  int         Dim = 1;
+  char const* OutFileNameText = "";
+  char const* OutFileNameBinary = "";
+  char const* OutFileNameChunked = "";
+  char const* ReturnQuantityChars = "flux";
 
 
-  static const char *kwlist[] = {"x1",
-                                 "x2",
-                                 "npoints",
-                                 "ofile",
-                                 "bofile",
+  static const char *kwlist[] = {"energy_eV",
+                                 "points",
                                  "normal",
+                                 "rotations",
+                                 "translation",
                                  "nparticles",
-                                 "gpu",
                                  "nthreads",
+                                 "gpu",
+                                 "ngpu",
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
-                                 "dim",
-                                  NULL};
+                                 "ofile",
+                                 "bofile",
+                                 "quantity",
+                                 "cofile",
+                                 NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|issiiiidiii",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|dOiOOiiiOdiissss",
                                    const_cast<char **>(kwlist),
-                                   &List_x1,
-                                   &List_x2,
-                                   &NPoints,
-                                   &OutFileNameText,
-                                   &OutFileNameBinary,
+                                   &Energy_eV,
+                                   &List_Points,
                                    &NormalDirection,
+                                   &List_Rotations,
+                                   &List_Translation,
                                    &NParticles,
-                                   &GPU,
                                    &NThreads,
+                                   &GPU,
+                                   &NGPU,
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
-                                   &Dim
-                                   )) {
+                                   &OutFileNameText,
+                                   &OutFileNameBinary,
+                                   &ReturnQuantityChars,
+                                   &OutFileNameChunked)) {
     return NULL;
   }
 
@@ -5873,44 +7883,68 @@ static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObj
 
 
   // Check requested dimension
-  if (Dim != 1 && Dim != 3) {
-    PyErr_SetString(PyExc_ValueError, "'dim' must be 1 or 3");
-    return NULL;
-  }
-
-
-  if (NPoints < 2) {
-    PyErr_SetString(PyExc_ValueError, "'npoints' must be >= 2");
+  if (Dim != 2 && Dim != 3) {
+    PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
     return NULL;
   }
 
 
+  // Vectors for rotations and translations.  Default to 0
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
-  // Vectors for from and to
-  TVector3D x1(0, 0, 0);
-  TVector3D x2(0, 0, 0);
 
-  // Check for from in the input
-  if (PyList_Size(List_x1) != 0) {
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
     try {
-      x1 = OSCARSPY::ListAsTVector3D(List_x1);
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x1'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
       return NULL;
     }
   }
 
-  // Check for to in the input
-  if (PyList_Size(List_x2) != 0) {
+
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
     try {
-      x2 = OSCARSPY::ListAsTVector3D(List_x2);
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x2'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
       return NULL;
     }
   }
 
-  TVector3D const Step = (x2 - x1) / (NPoints - 1);
+  // Look for arbitrary shape 3D points
+  TSurfacePoints_3D Surface;
+  for (int i = 0; i < PyList_Size(List_Points); ++i) {
+    PyObject* LXN = PyList_GetItem(List_Points, i);
+    TVector3D X;
+    TVector3D N;
+    if (PyList_Size(LXN) == 2) {
+
+      try {
+        X = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 0));
+        N = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 1));
+      } catch (std::length_error e) {
+        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points': Point or Normal does not have 3 elements");
+        return NULL;
+      }
+
+      // Rotate point and normal
+      X.RotateSelfXYZ(Rotations);
+      N.RotateSelfXYZ(Rotations);
+
+      // Translate point, normal does not get translated
+      X += Translation;
+
+      Surface.AddPoint(X, N);
+    } else {
+      // input format error
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points'");
+      return NULL;
+    }
+  }
 
   // Check number of particles
   if (NParticles < 0) {
@@ -5918,6 +7952,11 @@ static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObj
     return NULL;
   }
 
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
 
   // Check GPU parameter
   if (GPU != 0 && GPU != 1 && GPU != -1) {
@@ -5925,30 +7964,45 @@ static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObj
     return NULL;
   }
 
-  // Check NThreads parameter
-  if (NThreads < 0) {
-    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
-    return NULL;
-  }
-
   // Check you are not trying to use threads and GPU
   if (NThreads > 0 && GPU == 1) {
     PyErr_SetString(PyExc_ValueError, "gpu is 1 and nthreads > 0.  Both are not currently allowed.");
     return NULL;
   }
 
-  TSurfacePoints_3D Surface;
-  for (int i = 0; i != NPoints; ++i) {
-    Surface.AddPoint(x1 + i * Step);
+  // Check ngpu input
+  int NumberOfGPUs = -1;
+  std::vector<int> GPUVector;
+  if (NGPU != 0x0) {
+    if (PyLong_Check(NGPU)) {
+      NumberOfGPUs = (int) PyLong_AsLong(NGPU);
+    } else if (PyList_Check(NGPU)) {
+      OSCARSPY::ListToVectorInt(NGPU, GPUVector);
+    }
+  }
+
+  int ReturnQuantity = 0;
+  std::string ReturnQuantityStr = ReturnQuantityChars;
+  std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
+  if (ReturnQuantityStr == "FLUX") {
+    ReturnQuantity = 0;
+  } else if (ReturnQuantityStr == "PRECISION") {
+    ReturnQuantity = 1;
+  } else if (ReturnQuantityStr == "LEVEL") {
+    ReturnQuantity = 2;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'flux', 'precision', 'level', or blank");
+    return NULL;
   }
 
+
   // Container for Point plus scalar
-  T3DScalarContainer PowerDensityContainer;
+  T3DScalarContainer FluxContainer;
 
-  // Actually calculate the spectrum
-  bool const Directional = NormalDirection == 0 ? false : true;
   try {
-    self->obj->CalculatePowerDensity(Surface, PowerDensityContainer, Dim, Directional, Precision, MaxLevel, MaxLevelExtended, NParticles, NThreads, GPU);
+    throw;
+    // UPDATE: Must fix single flux to accept polarizaton and angle
+    self->obj->CalculateFlux(Surface, Energy_eV, FluxContainer, "all", 0, TVector3D(1, 0, 0), TVector3D(0, 1, 0), NParticles, NThreads, GPU, NumberOfGPUs, GPUVector, Precision, MaxLevel, MaxLevelExtended, Dim, ReturnQuantity);
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -5960,26 +8014,44 @@ static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObj
     return NULL;
   }
 
+  if (!FluxContainer.AllConverged()) {
+    OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
+  }
+
   // Write the output file if requested
   // Text output
   if (std::string(OutFileNameText) != "") {
-    PowerDensityContainer.WriteToFileText(OutFileNameText, Dim);
+    FluxContainer.WriteToFileText(OutFileNameText, Dim);
   }
 
   // Binary output
   if (std::string(OutFileNameBinary) != "") {
-    PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
+    FluxContainer.WriteToFileBinary(OutFileNameBinary, Dim);
   }
 
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      FluxContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
 
-  // Build the output list of: [[[x, y, z], PowerDensity], [...]]
+  // Build the output list of: [[[x, y, z], Flux], [...]]
   // Create a python list
   PyObject *PList = PyList_New(0);
 
+  size_t const NPoints = FluxContainer.GetNPoints();
+
   PyObject* Value;
 
   for (size_t i = 0; i != NPoints; ++i) {
-    T3DScalar P = PowerDensityContainer.GetPoint(i);
+    T3DScalar P = FluxContainer.GetPoint(i);
 
     // Inner list for each point
     PyObject *PList2 = PyList_New(0);
@@ -6012,42 +8084,58 @@ static PyObject* OSCARSSR_CalculatePowerDensityLine (OSCARSSRObject* self, PyObj
 
 
 
+const char* DOC_OSCARSSR_CalculateFluxRectangle = R"docstring(
+calculate_flux_rectangle(energy_eV, npoints [, plane, normal, dim, width, rotations, translation, x0x1x2, polarization, angle, horizontal_direction, propogation_direction, nparticles, nthreads, gpu, ngpu, precision, max_level, max_level_extended, quantity, ofile, bofile, emittance_mode, cofile, adaptive, max_depth, resample, symmetry])
 
+Calculate the flux density in a rectangle either defined by three points, or by defining the plane the rectangle is in and the width, and then rotating and translating it to where it needs be.  The simplest is outlined in the first example below.  By default (dim=2) this returns a list whose position coordinates are in the local coordinate space x1 and x2 (*ie* they do not include the rotations and translation).  if dim=3 the coordinates in the return list are in absolute 3D space.
 
-
-
-
-
-
-
-
-const char* DOC_OSCARSSR_CalculateFlux = R"docstring(
-calculate_flux(energy_eV, points [, normal, rotations, translation, nparticles, nthreads, gpu, ngpu, precision, max_level, max_level_extended, ofile, bofile, quantity])
-
-Calculates the flux at a given set of points
+You **must** specify either both (*plane* and *width*) or *x0x1x2*
 
 See the :doc:`MathematicalNotes` section for the expression used in this calculation.
 
 Parameters
 ----------
-
 energy_eV : float
     Photon energy of interest
 
-points : list
-    A list of points, each point containing a position in 3D (as a list) and a normal vector at that position (also as a 3D list): [[[x, y, z], [nx. ny. nz]], [...], ...]
+npoints : list [int, int]
+    Number of points in X1 and X2 dimension [n1, n2]
+
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
 
 normal : int
     -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
 
+dim : int
+    Defaults to 2 where output is in the local plane coordinates X1 and X2.  If you want the return to be given in 3D set dim=3 which will return with X, Y, and Z in absolute coordinates.
+
+width : list
+    Width of rectangle in X1 and X2: [w1, w2]
+
 rotations : list, optional
     3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
 
-translation : list, optional
-    3-element list representing a translation in space [x, y, z]
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+x0x1x2 : list
+    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram (vectors 0->1, and 0->2)
+
+polarization : str
+    Which polarization mode to calculate.  Can be 'all', 'linear-horizontal', 'linear-vertical', 'circular-left', 'circular-right', or 'linear' (if linear you must specify the angle parameter)
+
+angle : float
+    Only used if polarization='linear' is specified.  The 'angle' is that from the horizontal_direction for the polarization directino you are interested in
+
+horizontal_direction : list
+    The direction you consider to be horizontal.  Should be perpendicular to the photon beam propogation direction
+
+propogation_direction : list
+    Propogation direction of photon beam
 
 nparticles : int
-    Number of particles to use for multi-particle calculations
+    The number of particles you wish to run for a multi-particle simulation
 
 nthreads : int
     Number of threads to use
@@ -6063,10 +8151,17 @@ precision : float
     Calculation precision parameter (typically 0.01 which is 1%)
 
 max_level: int
-    Maximum "level" to us for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
+    Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
 
 max_level_extended: int
-    Maximum "level" to us for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+    Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
+
+quantity: str
+    Quantity to return.
+    Available are:
+        'flux'        (default)
+        'precision' - Estimated precision for each point
+        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
 
 ofile : str
     Output file name
@@ -6074,28 +8169,62 @@ ofile : str
 bofile : str
     Binary output file name
 
-quantity: str
-    Quantity to return.
+emittance_mode : str
+    How the beam emittance is included.
     Available are:
-        'power density' (default)
-        'precision' - Estimated precision for each point
-        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
+        'montecarlo'  (default) - Average over 'nparticles' random particles
+        'convolution' - Calculate the single particle flux once on a padded rectangle and convolve with the gaussian beam size projected onto the rectangle from the beam twiss parameters and emittance.  Requires one beam and a rectangle aligned with the beam horizontal and vertical directions.  Energy spread is ignored.
+        'validate'    - Return the 'convolution' result and print its difference with respect to a 'montecarlo' calculation using 'nparticles'
+
+cofile : str
+    Chunked result file name.  The result is appended to this file as a new chunk weighted by 'nparticles' (or 1 for a single particle).  Files are merged with average_flux(cifiles=[...])
+
+adaptive : float
+    If > 0 'npoints' is a coarse grid and each cell is split in four, up to 'max_depth' times, wherever the flux at the edge midpoints and centre of the cell differs from the bilinear interpolation of its corners by more than this fraction of the maximum.  Neighbouring cells differ by at most one split.  The coarse grid must be fine enough to see every feature.  With 'nparticles' one set of random particles is drawn and used for every round of refinement, on the cpu.  Not available with emittance_mode other than 'montecarlo'.  Default is 0 (uniform grid)
+
+max_depth : int
+    Maximum number of times a coarse cell is split for 'adaptive'.  Default is 4
+
+resample : list [int, int]
+    For 'adaptive', return (and write) a uniform grid of [n1, n2] points interpolated from the refined cells instead of the calculated points.  The interpolation is continuous across cells of different size
+
+symmetry : str
+    Mirror symmetry of the result about the centre lines of the rectangle.  Only the fundamental half or quadrant (including the centre lines) is calculated and mirrored to the rest.
+    Available are:
+        'none' (default)
+        'x1'   - symmetric in X1
+        'x2'   - symmetric in X2
+        'x1x2' - symmetric in both
+        'auto' - take the symmetry from 4 points and their mirror images calculated with the ideal particle, which must agree to within 1e-6 of the largest of them.  Small real asymmetries, such as from a trajectory off the centre line, are not mirrored away.  The symmetry used is reported in get_last_calculation_path()
+    Not available with 'adaptive' or emittance_mode other than 'montecarlo'.  For multi-particle calculations the beam must be symmetric too.  Circular polarizations change hand under reflection, so only 'auto' is allowed for them
 
 Returns
 -------
-power_density : list
-    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and power density [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], pd_0], [[x1_1, x2_1, x3_1], pd_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
+flux : list
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and flux [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], f_0], [[x1_1, x2_1, x3_1], f_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
+    For 'adaptive' without 'resample' these are all calculated points, the coarse grid first, in the order they were calculated
 )docstring";
-static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
-  // Calculate the flux on a surface given an energy and list of points in 3D
+  // Calculate the spectrum given an observation point, and energy range
 
-  double      Energy_eV = 0;
+  char const* SurfacePlane = "";
+  size_t      NX1 = 0;
+  size_t      NX2 = 0;
+  double      Width_X1 = 0;
+  double      Width_X2 = 0;
+  PyObject*   List_NPoints= PyList_New(0);
+  PyObject*   List_Width= PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
-  PyObject*   List_Rotations   = PyList_New(0);
-  PyObject*   List_Points      = PyList_New(0);
+  PyObject*   List_Rotations = PyList_New(0);
+  PyObject*   List_X0X1X2 = PyList_New(0);
   int         NormalDirection = 0;
-  int         Dim = 3;
+  int         Dim = 2;
+  double      Energy_eV = 0;
+  char const* Polarization = "all";
+  double      Angle = 0;
+  PyObject*   List_HorizontalDirection = PyList_New(0);
+  PyObject*   List_PropogationDirection = PyList_New(0);
   int         NParticles = 0;
   int         NThreads = 0;
   int         GPU = -1;
@@ -6103,16 +8232,30 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
+  char const* ReturnQuantityChars = "flux";
   char const* OutFileNameText = "";
   char const* OutFileNameBinary = "";
-  char const* ReturnQuantityChars = "flux";
+  char const* EmittanceModeChars = "montecarlo";
+  const char* OutFileNameChunked = "";
+  double      Adaptive = 0;
+  int         MaxDepth = 4;
+  PyObject*   List_Resample = PyList_New(0);
+  char const* SymmetryChars = "none";
 
 
   static const char *kwlist[] = {"energy_eV",
-                                 "points",
+                                 "npoints",
+                                 "plane",
                                  "normal",
+                                 "dim",
+                                 "width",
                                  "rotations",
                                  "translation",
+                                 "x0x1x2",
+                                 "polarization",
+                                 "angle",
+                                 "horizontal_direction",
+                                 "propogation_direction",
                                  "nparticles",
                                  "nthreads",
                                  "gpu",
@@ -6120,18 +8263,32 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
+                                 "quantity",
                                  "ofile",
                                  "bofile",
-                                 "quantity",
+                                 "emittance_mode",
+                                 "cofile",
+                                 "adaptive",
+                                 "max_depth",
+                                 "resample",
+                                 "symmetry",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|dOiOOiiiOdiisss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dO|siiOOOOsdOOiiiOdiisssssdiOs",
                                    const_cast<char **>(kwlist),
                                    &Energy_eV,
-                                   &List_Points,
+                                   &List_NPoints,
+                                   &SurfacePlane,
                                    &NormalDirection,
+                                   &Dim,
+                                   &List_Width,
                                    &List_Rotations,
                                    &List_Translation,
+                                   &List_X0X1X2,
+                                   &Polarization,
+                                   &Angle,
+                                   &List_HorizontalDirection,
+                                   &List_PropogationDirection,
                                    &NParticles,
                                    &NThreads,
                                    &GPU,
@@ -6139,9 +8296,15 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
+                                   &ReturnQuantityChars,
                                    &OutFileNameText,
                                    &OutFileNameBinary,
-                                   &ReturnQuantityChars)) {
+                                   &EmittanceModeChars,
+                                   &OutFileNameChunked,
+                                   &Adaptive,
+                                   &MaxDepth,
+                                   &List_Resample,
+                                   &SymmetryChars)) {
     return NULL;
   }
 
@@ -6159,11 +8322,29 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
   }
 
 
+  // The rectangular surface object we'll use
+  TSurfacePoints_Rectangle Surface;
+
+  if (PyList_Size(List_NPoints) == 2) {
+    // NPoints in [m]
+    NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
+    NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'npoints' must be [int, int]");
+    return NULL;
+  }
+
+
+
+  if (NX1 <= 0 || NX2 <= 0) {
+    PyErr_SetString(PyExc_ValueError, "an entry in 'npoints' is <= 0");
+    return NULL;
+  }
+
   // Vectors for rotations and translations.  Default to 0
   TVector3D Rotations(0, 0, 0);
   TVector3D Translation(0, 0, 0);
 
-
   // Check for Rotations in the input
   if (PyList_Size(List_Rotations) != 0) {
     try {
@@ -6185,37 +8366,86 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
     }
   }
 
-  // Look for arbitrary shape 3D points
-  TSurfacePoints_3D Surface;
-  for (int i = 0; i < PyList_Size(List_Points); ++i) {
-    PyObject* LXN = PyList_GetItem(List_Points, i);
-    TVector3D X;
-    TVector3D N;
-    if (PyList_Size(LXN) == 2) {
+  if (PyList_Size(List_Width) == 2) {
+    // Width in [m]
+    Width_X1 = PyFloat_AsDouble(PyList_GetItem(List_Width, 0));
+    Width_X2 = PyFloat_AsDouble(PyList_GetItem(List_Width, 1));
+  }
 
-      try {
-        X = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 0));
-        N = OSCARSPY::ListAsTVector3D(PyList_GetItem(LXN, 1));
-      } catch (std::length_error e) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points': Point or Normal does not have 3 elements");
-        return NULL;
-      }
+  // Check normal
+  if (abs(NormalDirection) > 1) {
+    PyErr_SetString(PyExc_ValueError, "'normal' must be -1, 0, or 1");
+    return NULL;
+  }
 
-      // Rotate point and normal
-      X.RotateSelfXYZ(Rotations);
-      N.RotateSelfXYZ(Rotations);
 
-      // Translate point, normal does not get translated
-      X += Translation;
+  // If you are requesting a simple surface plane, check that you have widths
+  if (std::strlen(SurfacePlane) != 0 && Width_X1 > 0 && Width_X2 > 0) {
+    try {
+      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width_X1, Width_X2, Rotations, Translation, NormalDirection);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
 
-      Surface.AddPoint(X, N);
+
+
+  // If X0X1X2 defined
+  std::vector<TVector3D> X0X1X2;
+
+  if (PyList_Size(List_X0X1X2) != 0) {
+    if (PyList_Size(List_X0X1X2) == 3) {
+      for (int i = 0; i != 3; ++i) {
+        PyObject* List_X = PyList_GetItem(List_X0X1X2, i);
+
+        try {
+          X0X1X2.push_back(OSCARSPY::ListAsTVector3D(List_X));
+        } catch (std::length_error e) {
+          PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0x1x2'");
+          return NULL;
+        }
+      }
     } else {
-      // input format error
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'points'");
+      PyErr_SetString(PyExc_ValueError, "'x0x1x2' must have 3 XYZ points defined correctly");
+      return NULL;
+    }
+
+    for (std::vector<TVector3D>::iterator it = X0X1X2.begin(); it != X0X1X2.end(); ++it) {
+      it->RotateSelfXYZ(Rotations);
+      *it += Translation;
+    }
+
+    // UPDATE: Check for orthogonality
+    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
+  }
+
+
+
+  // Check for HorizontalDirection in the input
+  TVector3D HorizontalDirection(0, 0, 0);
+  if (PyList_Size(List_HorizontalDirection) != 0) {
+    try {
+      HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+
+  // Check for PropogationDirection in the input
+  TVector3D PropogationDirection(0, 0, 0);
+  if (PyList_Size(List_PropogationDirection) != 0) {
+    try {
+      PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
       return NULL;
     }
   }
 
+
   // Check number of particles
   if (NParticles < 0) {
     PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
@@ -6265,14 +8495,184 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
     return NULL;
   }
 
+  // How to include the beam emittance
+  int EmittanceMode = 0;
+  std::string EmittanceModeStr = EmittanceModeChars;
+  std::transform(EmittanceModeStr.begin(), EmittanceModeStr.end(), EmittanceModeStr.begin(), ::toupper);
+  if (EmittanceModeStr == "MONTECARLO") {
+    EmittanceMode = 0;
+  } else if (EmittanceModeStr == "CONVOLUTION") {
+    EmittanceMode = 1;
+  } else if (EmittanceModeStr == "VALIDATE") {
+    EmittanceMode = 2;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'emittance_mode' must be: 'montecarlo', 'convolution', or 'validate'");
+    return NULL;
+  }
+  if (EmittanceMode == 2 && NParticles < 1) {
+    PyErr_SetString(PyExc_ValueError, "'emittance_mode' 'validate' requires 'nparticles' >= 1");
+    return NULL;
+  }
+
+  // Adaptive refinement and the optional uniform grid to resample to
+  int NResampleX1 = 0;
+  int NResampleX2 = 0;
+  if (Adaptive < 0) {
+    PyErr_SetString(PyExc_ValueError, "'adaptive' must be >= 0");
+    return NULL;
+  }
+  if (Adaptive > 0 && EmittanceMode != 0) {
+    PyErr_SetString(PyExc_ValueError, "'adaptive' is only available with 'emittance_mode' 'montecarlo'");
+    return NULL;
+  }
+  if (PyList_Size(List_Resample) != 0) {
+    if (PyList_Size(List_Resample) != 2) {
+      PyErr_SetString(PyExc_ValueError, "'resample' must be [int, int]");
+      return NULL;
+    }
+    NResampleX1 = (int) PyLong_AsLong(PyList_GetItem(List_Resample, 0));
+    NResampleX2 = (int) PyLong_AsLong(PyList_GetItem(List_Resample, 1));
+    if (NResampleX1 < 1 || NResampleX2 < 1) {
+      PyErr_SetString(PyExc_ValueError, "an entry in 'resample' is < 1");
+      return NULL;
+    }
+  }
+
+  // Mirror symmetry
+  int Symmetry = OSCARSSR::kSymmetry_None;
+  std::string SymmetryStr = SymmetryChars;
+  std::transform(SymmetryStr.begin(), SymmetryStr.end(), SymmetryStr.begin(), ::toupper);
+  if (SymmetryStr == "NONE") {
+    Symmetry = OSCARSSR::kSymmetry_None;
+  } else if (SymmetryStr == "X1") {
+    Symmetry = OSCARSSR::kSymmetry_X1;
+  } else if (SymmetryStr == "X2") {
+    Symmetry = OSCARSSR::kSymmetry_X2;
+  } else if (SymmetryStr == "X1X2") {
+    Symmetry = OSCARSSR::kSymmetry_X1X2;
+  } else if (SymmetryStr == "AUTO") {
+    Symmetry = OSCARSSR::kSymmetry_Auto;
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'symmetry' must be: 'none', 'x1', 'x2', 'x1x2', or 'auto'");
+    return NULL;
+  }
+  if (Symmetry != OSCARSSR::kSymmetry_None && (Adaptive > 0 || EmittanceMode != 0)) {
+    PyErr_SetString(PyExc_ValueError, "'symmetry' is not available with 'adaptive' or 'emittance_mode' other than 'montecarlo'");
+    return NULL;
+  }
+
 
   // Container for Point plus scalar
   T3DScalarContainer FluxContainer;
 
+  // UPDATE: Needed, directional?
+  //bool const Directional = NormalDirection == 0 ? false : true;
+
   try {
-    throw;
-    // UPDATE: Must fix single flux to accept polarizaton and angle
-    self->obj->CalculateFlux(Surface, Energy_eV, FluxContainer, "all", 0, TVector3D(1, 0, 0), TVector3D(0, 1, 0), NParticles, NThreads, GPU, NumberOfGPUs, GPUVector, Precision, MaxLevel, MaxLevelExtended, Dim, ReturnQuantity);
+    if (Adaptive > 0) {
+      TSurfaceQuadtree Tree;
+      self->obj->CalculateFluxAdaptive(Surface,
+                                       Tree,
+                                       Adaptive,
+                                       MaxDepth,
+                                       Energy_eV,
+                                       Polarization,
+                                       Angle,
+                                       HorizontalDirection,
+                                       PropogationDirection,
+                                       NParticles,
+                                       NThreads,
+                                       GPU,
+                                       NumberOfGPUs,
+                                       GPUVector,
+                                       Precision,
+                                       MaxLevel,
+                                       MaxLevelExtended,
+                                       ReturnQuantity);
+      if (NResampleX1 > 0) {
+        Tree.Resample(NResampleX1, NResampleX2, FluxContainer, Dim);
+      } else {
+        Tree.Fill(FluxContainer, Dim);
+      }
+    } else if (Symmetry != OSCARSSR::kSymmetry_None) {
+      self->obj->CalculateFluxSymmetric(Surface,
+                                        Symmetry,
+                                        Energy_eV,
+                                        FluxContainer,
+                                        Polarization,
+                                        Angle,
+                                        HorizontalDirection,
+                                        PropogationDirection,
+                                        NParticles,
+                                        NThreads,
+                                        GPU,
+                                        NumberOfGPUs,
+                                        GPUVector,
+                                        Precision,
+                                        MaxLevel,
+                                        MaxLevelExtended,
+                                        Dim,
+                                        ReturnQuantity);
+    } else if (EmittanceMode == 0) {
+      self->obj->CalculateFlux(Surface,
+                               Energy_eV,
+                               FluxContainer,
+                               Polarization,
+                               Angle,
+                               HorizontalDirection,
+                               PropogationDirection,
+                               NParticles,
+                               NThreads,
+                               GPU,
+                               NumberOfGPUs,
+                               GPUVector,
+                               Precision,
+                               MaxLevel,
+                               MaxLevelExtended,
+                               Dim,
+                               ReturnQuantity);
+    } else {
+      self->obj->CalculateFluxConvolution(Surface,
+                                          Energy_eV,
+                                          FluxContainer,
+                                          Polarization,
+                                          Angle,
+                                          HorizontalDirection,
+                                          PropogationDirection,
+                                          NThreads,
+                                          GPU,
+                                          NumberOfGPUs,
+                                          GPUVector,
+                                          Precision,
+                                          MaxLevel,
+                                          MaxLevelExtended,
+                                          Dim,
+                                          ReturnQuantity);
+
+      // Compare to the monte carlo calculation if requested
+      if (EmittanceMode == 2) {
+        T3DScalarContainer MonteCarloContainer;
+        self->obj->CalculateFlux(Surface,
+                                 Energy_eV,
+                                 MonteCarloContainer,
+                                 Polarization,
+                                 Angle,
+                                 HorizontalDirection,
+                                 PropogationDirection,
+                                 NParticles,
+                                 NThreads,
+                                 GPU,
+                                 NumberOfGPUs,
+                                 GPUVector,
+                                 Precision,
+                                 MaxLevel,
+                                 MaxLevelExtended,
+                                 Dim,
+                                 ReturnQuantity);
+        OSCARSSR_PrintConvolutionValidation(FluxContainer, MonteCarloContainer);
+      }
+    }
+
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -6294,10 +8694,24 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
     FluxContainer.WriteToFileText(OutFileNameText, Dim);
   }
 
-  // Binary output
-  if (std::string(OutFileNameBinary) != "") {
-    FluxContainer.WriteToFileBinary(OutFileNameBinary, Dim);
-  }
+  // Binary output
+  if (std::string(OutFileNameBinary) != "") {
+    FluxContainer.WriteToFileBinary(OutFileNameBinary, Dim);
+  }
+
+  // Append as a chunk weighted by the number of particles
+  if (std::string(OutFileNameChunked) != "") {
+    try {
+      FluxContainer.WriteToFileChunked(OutFileNameChunked, NParticles > 0 ? NParticles : 1, NParticles);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  }
+
 
   // Build the output list of: [[[x, y, z], Flux], [...]]
   // Create a python list
@@ -6306,7 +8720,6 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
   size_t const NPoints = FluxContainer.GetNPoints();
 
   PyObject* Value;
-
   for (size_t i = 0; i != NPoints; ++i) {
     T3DScalar P = FluxContainer.GetPoint(i);
 
@@ -6341,28 +8754,31 @@ static PyObject* OSCARSSR_CalculateFlux (OSCARSSRObject* self, PyObject* args, P
 
 
 
-const char* DOC_OSCARSSR_CalculateFluxRectangle = R"docstring(
-calculate_flux_rectangle(energy_eV, npoints [, plane, normal, dim, width, rotations, translation, x0x1x2, polarization, angle, horizontal_direction, propogation_direction, nparticles, nthreads, gpu, ngpu, precision, max_level, max_level_extended, quantity, ofile, bofile])
 
-Calculate the flux density in a rectangle either defined by three points, or by defining the plane the rectangle is in and the width, and then rotating and translating it to where it needs be.  The simplest is outlined in the first example below.  By default (dim=2) this returns a list whose position coordinates are in the local coordinate space x1 and x2 (*ie* they do not include the rotations and translation).  if dim=3 the coordinates in the return list are in absolute 3D space.
 
-You **must** specify either both (*plane* and *width*) or *x0x1x2*
+const char* DOC_OSCARSSR_CalculateFluxCube = R"docstring(
+calculate_flux_cube(npoints [, energy_range_eV, nenergies, energy_points_eV, plane, dim, width, rotations, translation, x0x1x2, polarization, angle, horizontal_direction, propogation_direction, nparticles, nthreads, precision, max_level, max_level_extended, ofile, bofile])
 
-See the :doc:`MathematicalNotes` section for the expression used in this calculation.
+Calculate the flux density in a rectangle at many photon energies at once.  The rectangle is defined as in calculate_flux_rectangle().  Everything in the calculation except the phase depends only on the point and the trajectory, so it is calculated once for all energies, which is much faster than one calculate_flux_rectangle() per energy.  The trajectory level is chosen for each energy separately.  The Riemann sum is always used: if the *filon* integrator is set (see set_integrator()) it is ignored for the cube and a warning is printed.
+
+You **must** specify either both (*plane* and *width*) or *x0x1x2*, and either *energy_range_eV* and *nenergies* or *energy_points_eV*
 
 Parameters
 ----------
-energy_eV : float
-    Photon energy of interest
-
 npoints : list [int, int]
     Number of points in X1 and X2 dimension [n1, n2]
 
-plane : str
-    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
+energy_range_eV : list [float, float]
+    First and last photon energy [eV]
 
-normal : int
-    -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given. 
+nenergies : int
+    Number of energies, equally spaced in energy_range_eV
+
+energy_points_eV : list
+    List of photon energies [eV] (instead of energy_range_eV)
+
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY)
 
 dim : int
     Defaults to 2 where output is in the local plane coordinates X1 and X2.  If you want the return to be given in 3D set dim=3 which will return with X, Y, and Z in absolute coordinates.
@@ -6397,43 +8813,29 @@ nparticles : int
 nthreads : int
     Number of threads to use
 
-gpu : int
-    Use the gpu or not (0 or 1).  If 1 will attempt to use ALL gpus available.  This is overridden if you use the input 'ngpu'
-
-ngpu : int or list
-    If ngpu is an int, use that number of gpus (if available).
-    If ngpu is a list, the list should be a list of gpus you wish to use
-
 precision : float
     Calculation precision parameter (typically 0.01 which is 1%)
 
 max_level: int
-    Maximum "level" to use for trajectory in the calculation.  Level N corresponds to a total of 2**(N+2) trajectory points.  You cannot go beyond the internal maximum.  You are not guaranteed precision parameter is met if this is used.
+    Maximum "level" to use for trajectory in the calculation
 
 max_level_extended: int
     Maximum "level" to use for trajectory in the calculation.  If set to higher than max_level the computation will proceed beyond max_level without creating trajectory arrays in memory (but it will be slower)
 
-quantity: str
-    Quantity to return.
-    Available are:
-        'flux'        (default)
-        'precision' - Estimated precision for each point
-        'level'     - Trajectory level reached (npoints = 2**(n+1) - 1), if return is -1 the requested precision was not reached
-
 ofile : str
-    Output file name
+    Output file name.  The first line is the energies, then one line per point with its position and the flux at each energy
 
 bofile : str
-    Binary output file name
+    Binary output file name.  Number of points and of energies (uint64), the energies, then for each point its position and the flux at each energy (float)
 
 Returns
 -------
 flux : list
-    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and flux [:math:`W / mm^2`] at that position.  eg [[[x1_0, x2_0, x3_0], f_0], [[x1_1, x2_1, x3_1], f_1]],  ...].  The position is always given as a list of length 3.  For the default (dim=2) the third element is always zero.
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and a list of the flux [:math:`photons / s / mm^2 / 0.1\%bw`] at each energy.  eg [[[x1_0, x2_0, x3_0], [f_0_0, f_0_1, ...]], ...].  A map at one energy is [[p[0], p[1][k]] for p in flux]
 )docstring";
-static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
+static PyObject* OSCARSSR_CalculateFluxCube (OSCARSSRObject* self, PyObject* args, PyObject *keywds)
 {
-  // Calculate the spectrum given an observation point, and energy range
+  // Calculate the flux in a rectangle at many energies
 
   char const* SurfacePlane = "";
   size_t      NX1 = 0;
@@ -6441,33 +8843,32 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
   double      Width_X1 = 0;
   double      Width_X2 = 0;
   PyObject*   List_NPoints= PyList_New(0);
+  PyObject*   List_EnergyRange_eV = PyList_New(0);
+  int         NEnergies = 0;
+  PyObject*   List_Points_eV = PyList_New(0);
   PyObject*   List_Width= PyList_New(0);
   PyObject*   List_Translation = PyList_New(0);
   PyObject*   List_Rotations = PyList_New(0);
   PyObject*   List_X0X1X2 = PyList_New(0);
-  int         NormalDirection = 0;
   int         Dim = 2;
-  double      Energy_eV = 0;
   char const* Polarization = "all";
   double      Angle = 0;
   PyObject*   List_HorizontalDirection = PyList_New(0);
   PyObject*   List_PropogationDirection = PyList_New(0);
   int         NParticles = 0;
   int         NThreads = 0;
-  int         GPU = -1;
-  PyObject*   NGPU = 0x0;
   double      Precision = 0.01;
   int         MaxLevel = -2;
   int         MaxLevelExtended = 0;
-  char const* ReturnQuantityChars = "flux";
   char const* OutFileNameText = "";
   char const* OutFileNameBinary = "";
 
 
-  static const char *kwlist[] = {"energy_eV",
-                                 "npoints",
+  static const char *kwlist[] = {"npoints",
+                                 "energy_range_eV",
+                                 "nenergies",
+                                 "energy_points_eV",
                                  "plane",
-                                 "normal",
                                  "dim",
                                  "width",
                                  "rotations",
@@ -6479,22 +8880,20 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
                                  "propogation_direction",
                                  "nparticles",
                                  "nthreads",
-                                 "gpu",
-                                 "ngpu",
                                  "precision",
                                  "max_level",
                                  "max_level_extended",
-                                 "quantity",
                                  "ofile",
                                  "bofile",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dO|siiOOOOsdOOiiiOdiisss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OiOsiOOOOsdOOiidiiss",
                                    const_cast<char **>(kwlist),
-                                   &Energy_eV,
                                    &List_NPoints,
+                                   &List_EnergyRange_eV,
+                                   &NEnergies,
+                                   &List_Points_eV,
                                    &SurfacePlane,
-                                   &NormalDirection,
                                    &Dim,
                                    &List_Width,
                                    &List_Rotations,
@@ -6506,12 +8905,9 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
                                    &List_PropogationDirection,
                                    &NParticles,
                                    &NThreads,
-                                   &GPU,
-                                   &NGPU,
                                    &Precision,
                                    &MaxLevel,
                                    &MaxLevelExtended,
-                                   &ReturnQuantityChars,
                                    &OutFileNameText,
                                    &OutFileNameBinary)) {
     return NULL;
@@ -6523,19 +8919,37 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     return NULL;
   }
 
-
   // Check requested dimension
   if (Dim != 2 && Dim != 3) {
     PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
     return NULL;
   }
 
+  // Energies, either equally spaced in a range or given
+  std::vector<double> Energies;
+  if (PyList_Size(List_Points_eV) != 0) {
+    for (int i = 0; i < PyList_Size(List_Points_eV); ++i) {
+      Energies.push_back(PyFloat_AsDouble(PyList_GetItem(List_Points_eV, i)));
+    }
+  } else if (PyList_Size(List_EnergyRange_eV) == 2) {
+    if (NEnergies < 1) {
+      PyErr_SetString(PyExc_ValueError, "'nenergies' must be >= 1");
+      return NULL;
+    }
+    double const EStart = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 0));
+    double const EStop  = PyFloat_AsDouble(PyList_GetItem(List_EnergyRange_eV, 1));
+    for (int i = 0; i < NEnergies; ++i) {
+      Energies.push_back(NEnergies == 1 ? EStart : EStart + (EStop - EStart) * (double) i / (double) (NEnergies - 1));
+    }
+  } else {
+    PyErr_SetString(PyExc_ValueError, "must specify 'energy_range_eV' [float, float] with 'nenergies', or 'energy_points_eV'");
+    return NULL;
+  }
 
   // The rectangular surface object we'll use
   TSurfacePoints_Rectangle Surface;
 
   if (PyList_Size(List_NPoints) == 2) {
-    // NPoints in [m]
     NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
     NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
   } else {
@@ -6543,8 +8957,6 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     return NULL;
   }
 
-
-
   if (NX1 <= 0 || NX2 <= 0) {
     PyErr_SetString(PyExc_ValueError, "an entry in 'npoints' is <= 0");
     return NULL;
@@ -6564,7 +8976,6 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     }
   }
 
-
   // Check for Translation in the input
   if (PyList_Size(List_Translation) != 0) {
     try {
@@ -6581,25 +8992,16 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     Width_X2 = PyFloat_AsDouble(PyList_GetItem(List_Width, 1));
   }
 
-  // Check normal
-  if (abs(NormalDirection) > 1) {
-    PyErr_SetString(PyExc_ValueError, "'normal' must be -1, 0, or 1");
-    return NULL;
-  }
-
-
   // If you are requesting a simple surface plane, check that you have widths
   if (std::strlen(SurfacePlane) != 0 && Width_X1 > 0 && Width_X2 > 0) {
     try {
-      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width_X1, Width_X2, Rotations, Translation, NormalDirection);
+      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width_X1, Width_X2, Rotations, Translation, 0);
     } catch (std::invalid_argument e) {
       PyErr_SetString(PyExc_ValueError, e.what());
       return NULL;
     }
   }
 
-
-
   // If X0X1X2 defined
   std::vector<TVector3D> X0X1X2;
 
@@ -6625,11 +9027,13 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
       *it += Translation;
     }
 
-    // UPDATE: Check for orthogonality
-    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
+    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], 0);
   }
 
-
+  if (Surface.GetNPoints() == 0) {
+    PyErr_SetString(PyExc_ValueError, "must specify 'plane' and 'width', or 'x0x1x2'");
+    return NULL;
+  }
 
   // Check for HorizontalDirection in the input
   TVector3D HorizontalDirection(0, 0, 0);
@@ -6637,24 +9041,22 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     try {
       HorizontalDirection = OSCARSPY::ListAsTVector3D(List_HorizontalDirection);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'horizontal_direction'");
       return NULL;
     }
   }
 
-
   // Check for PropogationDirection in the input
   TVector3D PropogationDirection(0, 0, 0);
   if (PyList_Size(List_PropogationDirection) != 0) {
     try {
       PropogationDirection = OSCARSPY::ListAsTVector3D(List_PropogationDirection);
     } catch (std::length_error e) {
-      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'propogation_direction'");
       return NULL;
     }
   }
 
-
   // Check number of particles
   if (NParticles < 0) {
     PyErr_SetString(PyExc_ValueError, "'nparticles' must be >= 1 (sort of)");
@@ -6667,69 +9069,23 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     return NULL;
   }
 
-  // Check GPU parameter
-  if (GPU != 0 && GPU != 1 && GPU != -1) {
-    PyErr_SetString(PyExc_ValueError, "'gpu' must be 0 or 1");
-    return NULL;
-  }
-
-  // Check you are not trying to use threads and GPU
-  if (NThreads > 0 && GPU == 1) {
-    PyErr_SetString(PyExc_ValueError, "gpu is 1 and nthreads > 0.  Both are not currently allowed.");
-    return NULL;
-  }
-
-  // Check ngpu input
-  int NumberOfGPUs = -1;
-  std::vector<int> GPUVector;
-  if (NGPU != 0x0) {
-    if (PyLong_Check(NGPU)) {
-      NumberOfGPUs = (int) PyLong_AsLong(NGPU);
-    } else if (PyList_Check(NGPU)) {
-      OSCARSPY::ListToVectorInt(NGPU, GPUVector);
-    }
-  }
-
-  int ReturnQuantity = 0;
-  std::string ReturnQuantityStr = ReturnQuantityChars;
-  std::transform(ReturnQuantityStr.begin(), ReturnQuantityStr.end(), ReturnQuantityStr.begin(), ::toupper);
-  if (ReturnQuantityStr == "FLUX") {
-    ReturnQuantity = 0;
-  } else if (ReturnQuantityStr == "PRECISION") {
-    ReturnQuantity = 1;
-  } else if (ReturnQuantityStr == "LEVEL") {
-    ReturnQuantity = 2;
-  } else {
-    PyErr_SetString(PyExc_ValueError, "'quantity' must be: 'flux', 'precision', 'level', or blank");
-    return NULL;
-  }
-
-
-  // Container for Point plus scalar
-  T3DScalarContainer FluxContainer;
-
-  // UPDATE: Needed, directional?
-  //bool const Directional = NormalDirection == 0 ? false : true;
+  // Container for points and flux at each energy
+  T4DScalarContainer FluxContainer;
+  FluxContainer.SetEnergies(Energies);
 
   try {
-    self->obj->CalculateFlux(Surface,
-                             Energy_eV,
-                             FluxContainer,
-                             Polarization,
-                             Angle,
-                             HorizontalDirection,
-                             PropogationDirection,
-                             NParticles,
-                             NThreads,
-                             GPU,
-                             NumberOfGPUs,
-                             GPUVector,
-                             Precision,
-                             MaxLevel,
-                             MaxLevelExtended,
-                             Dim,
-                             ReturnQuantity);
-
+    self->obj->CalculateFluxCube(Surface,
+                                 FluxContainer,
+                                 Polarization,
+                                 Angle,
+                                 HorizontalDirection,
+                                 PropogationDirection,
+                                 NParticles,
+                                 NThreads,
+                                 Precision,
+                                 MaxLevel,
+                                 MaxLevelExtended,
+                                 Dim);
   } catch (std::length_error e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
@@ -6745,7 +9101,6 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     OSCARSPY::PyPrint_stderr("Not all points converged to desired precision.  Can try increasing 'max_level_extended'\n");
   }
 
-  // Write the output file if requested
   // Text output
   if (std::string(OutFileNameText) != "") {
     FluxContainer.WriteToFileText(OutFileNameText, Dim);
@@ -6756,33 +9111,35 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
     FluxContainer.WriteToFileBinary(OutFileNameBinary, Dim);
   }
 
-
-  // Build the output list of: [[[x, y, z], Flux], [...]]
-  // Create a python list
+  // Build the output list of: [[[x, y, z], [Flux_0, Flux_1, ...]], [...]]
   PyObject *PList = PyList_New(0);
 
   size_t const NPoints = FluxContainer.GetNPoints();
+  size_t const NE = FluxContainer.GetNEnergies();
 
   PyObject* Value;
   for (size_t i = 0; i != NPoints; ++i) {
-    T3DScalar P = FluxContainer.GetPoint(i);
 
     // Inner list for each point
     PyObject *PList2 = PyList_New(0);
 
-
-    // Add position and value to list
-    Value = OSCARSPY::TVector3DAsList(P.GetX());
+    // Add position and values to list
+    Value = OSCARSPY::TVector3DAsList(FluxContainer.GetPoint(i));
     PyList_Append(PList2, Value);
     Py_DECREF(Value);
 
-    Value = Py_BuildValue("f", P.GetV());
-    PyList_Append(PList2, Value);
-    Py_DECREF(Value);
+    double const* V = FluxContainer.GetSpectrumValues(i);
+    PyObject *PList3 = PyList_New(0);
+    for (size_t k = 0; k != NE; ++k) {
+      Value = Py_BuildValue("f", V[k]);
+      PyList_Append(PList3, Value);
+      Py_DECREF(Value);
+    }
+    PyList_Append(PList2, PList3);
+    Py_DECREF(PList3);
 
     PyList_Append(PList, PList2);
     Py_DECREF(PList2);
-
   }
 
   return PList;
@@ -6801,7 +9158,7 @@ static PyObject* OSCARSSR_CalculateFluxRectangle (OSCARSSRObject* self, PyObject
 
 
 const char* DOC_OSCARSSR_AverageSpectra = R"docstring(
-average_spectra([, ifiles, bifiles, ofile, bofile])
+average_spectra([, ifiles, bifiles, cifiles, ofile, bofile, cofile, nthreads])
 
 Average spectra from different files.  The input files must have the same format.
 
@@ -6813,12 +9170,21 @@ ifiles : list
 bifiles : list
     The binary input file names as strings: ['f0.dat', 'f1.dat', ...]
 
+cifiles : list
+    The chunked result file names as strings: ['f0.orf', 'f1.orf', ...].  All chunks in all files are averaged weighted by their weights.
+
 ofile : str
     The output file name
 
 bofile : str
     The binary output file name
 
+cofile : str
+    The chunked result output file name (only with cifiles).  The merged result is written as a single chunk.
+
+nthreads : int
+    Number of threads to use when merging chunked result files
+
 Returns
 -------
 spectrum : list
@@ -6830,50 +9196,76 @@ static PyObject* OSCARSSR_AverageSpectra (OSCARSSRObject* self, PyObject* args,
 
   PyObject*   List_InFileNamesText = PyList_New(0);
   PyObject*   List_InFileNamesBinary = PyList_New(0);
+  PyObject*   List_InFileNamesChunked = PyList_New(0);
   char const* OutFileNameText = "";
   char const* OutFileNameBinary = "";
+  char const* OutFileNameChunked = "";
+  int         NThreads = 1;
 
 
   static const char *kwlist[] = {"ifiles",
                                  "bifiles",
+                                 "cifiles",
                                  "ofile",
                                  "bofile",
+                                 "cofile",
+                                 "nthreads",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OOss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OOOsssi",
                                    const_cast<char **>(kwlist),
                                    &List_InFileNamesText,
                                    &List_InFileNamesBinary,
+                                   &List_InFileNamesChunked,
                                    &OutFileNameText,
-                                   &OutFileNameBinary)) {
+                                   &OutFileNameBinary,
+                                   &OutFileNameChunked,
+                                   &NThreads)) {
     return NULL;
   }
 
-  // Grab the number of input files for both text and binary lists
+  // Grab the number of input files for text, binary, and chunked lists
   size_t const NFilesText = PyList_Size(List_InFileNamesText);
   size_t const NFilesBinary = PyList_Size(List_InFileNamesBinary);
+  size_t const NFilesChunked = PyList_Size(List_InFileNamesChunked);
 
-  // Doesn't allow for both binary and text input at the same time
-  if (NFilesText != 0 && NFilesBinary !=0) {
-    PyErr_SetString(PyExc_ValueError, "either text or binary files may be added, but not both.");
+  // Only one type of input file at a time
+  if ((NFilesText != 0) + (NFilesBinary != 0) + (NFilesChunked != 0) > 1) {
+    PyErr_SetString(PyExc_ValueError, "only one of text, binary, or chunked files may be added.");
     return NULL;
   }
 
   // Check that there is at least one file
-  if (NFilesText + NFilesBinary < 1) {
+  if (NFilesText + NFilesBinary + NFilesChunked < 1) {
     PyErr_SetString(PyExc_ValueError, "No files given.  You need at least one file as input in a list.");
     return NULL;
   }
 
+  // Chunked output is only written when merging chunked files
+  if (std::string(OutFileNameChunked) != "" && NFilesChunked == 0) {
+    PyErr_SetString(PyExc_ValueError, "cofile may only be used with cifiles");
+    return NULL;
+  }
+
+  // Check number of threads
+  if (NThreads < 1) {
+    PyErr_SetString(PyExc_ValueError, "nthreads must be > 0");
+    return NULL;
+  }
+
   // Add file names to vector
   std::vector<std::string> FileNames;
   std::vector<std::string> FileNamesBinary;
+  std::vector<std::string> FileNamesChunked;
   for (size_t i = 0; i != NFilesText; ++i) {
     FileNames.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_InFileNamesText, i)) );
   }
   for (size_t i = 0; i != NFilesBinary; ++i) {
     FileNamesBinary.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_InFileNamesBinary, i)) );
   }
+  for (size_t i = 0; i != NFilesChunked; ++i) {
+    FileNamesChunked.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_InFileNamesChunked, i)) );
+  }
 
   // Container for flux average
   TSpectrumContainer Container;
@@ -6884,7 +9276,7 @@ static PyObject* OSCARSSR_AverageSpectra (OSCARSSRObject* self, PyObject* args,
     return NULL;
   }
 
-  // Either they are text files or binary files
+  // Either they are text files, chunked files, or binary files
   if (NFilesText > 0) {
     try {
       Container.AverageFromFilesText(FileNames);
@@ -6892,6 +9284,16 @@ static PyObject* OSCARSSR_AverageSpectra (OSCARSSRObject* self, PyObject* args,
       PyErr_SetString(PyExc_ValueError, e.what());
       return NULL;
     }
+  } else if (NFilesChunked > 0) {
+    try {
+      Container.AverageFromFilesChunked(FileNamesChunked, NThreads, OutFileNameChunked);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
   } else {
     try {
       Container.AverageFromFilesBinary(FileNamesBinary);
@@ -7003,7 +9405,7 @@ static PyObject* OSCARSSR_GetSpectrum (OSCARSSRObject* self)
 
 
 const char* DOC_OSCARSSR_AverageT3DScalars_Flux = R"docstring(
-average_flux([, ifiles, bifiles, ofile, bofile, dim])
+average_flux([, ifiles, bifiles, cifiles, ofile, bofile, cofile, dim, nthreads])
 
 Average from different files and output to specified file.  The input files must have the same format.
 
@@ -7015,22 +9417,31 @@ ifiles : list
 bifiles : list
     The binary input file names as strings: ['f0.dat', 'f1.dat', ...]
 
+cifiles : list
+    The chunked result file names as strings: ['f0.orf', 'f1.orf', ...].  All chunks in all files are averaged weighted by their weights.
+
 ofile : str
     The output file name
 
 bofile : str
     The binary output file name
 
+cofile : str
+    The chunked result output file name (only with cifiles).  The merged result is written as a single chunk.
+
 dim : int
     in 2 or 3 dimensions (default is 2)
 
+nthreads : int
+    Number of threads to use when merging chunked result files
+
 Returns
 -------
 flux : list
     A list, each element of which is a pair representing the position (x) and value (v) at that position.  eg [[[x1_0, x2_0, x3_0], v_0], [[x1_1, x2_1, x3_1], v_1]],  ...].  The position is always given as a list of length 3.
 )docstring";
 const char* DOC_OSCARSSR_AverageT3DScalars_PowerDensity = R"docstring(
-average_power_density([, ifiles, bifiles, ofile, bofile, dim])
+average_power_density([, ifiles, bifiles, cifiles, ofile, bofile, cofile, dim, nthreads])
 
 Average from different files and output to specified file.  The input files must have the same format.
 
@@ -7042,15 +9453,24 @@ ifiles : list
 bifiles : list
     The binary input file names as strings: ['f0.dat', 'f1.dat', ...]
 
+cifiles : list
+    The chunked result file names as strings: ['f0.orf', 'f1.orf', ...].  All chunks in all files are averaged weighted by their weights.
+
 ofile : str
     The output file name
 
 bofile : str
     The binary output file name
 
+cofile : str
+    The chunked result output file name (only with cifiles).  The merged result is written as a single chunk.
+
 dim : int
     in 2 or 3 dimensions (default is 2)
 
+nthreads : int
+    Number of threads to use when merging chunked result files
+
 Returns
 -------
 power_density : list
@@ -7062,44 +9482,66 @@ static PyObject* OSCARSSR_AverageT3DScalars (OSCARSSRObject* self, PyObject* arg
 
   PyObject*   List_InFileNamesText = PyList_New(0);
   PyObject*   List_InFileNamesBinary = PyList_New(0);
+  PyObject*   List_InFileNamesChunked = PyList_New(0);
   int         Dim = 2;
+  int         NThreads = 1;
   char const* OutFileNameText = "";
   char const* OutFileNameBinary = "";
+  char const* OutFileNameChunked = "";
 
 
   static const char *kwlist[] = {"ifiles",
                                  "bifiles",
+                                 "cifiles",
                                  "ofile",
                                  "bofile",
+                                 "cofile",
                                  "dim",
+                                 "nthreads",
                                  NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OOssi",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "|OOOsssii",
                                    const_cast<char **>(kwlist),
                                    &List_InFileNamesText,
                                    &List_InFileNamesBinary,
+                                   &List_InFileNamesChunked,
                                    &OutFileNameText,
                                    &OutFileNameBinary,
-                                   &Dim)) {
+                                   &OutFileNameChunked,
+                                   &Dim,
+                                   &NThreads)) {
     return NULL;
   }
 
-  // Grab the number of input files for both text and binary lists
+  // Grab the number of input files for text, binary, and chunked lists
   size_t const NFilesText = PyList_Size(List_InFileNamesText);
   size_t const NFilesBinary = PyList_Size(List_InFileNamesBinary);
+  size_t const NFilesChunked = PyList_Size(List_InFileNamesChunked);
 
-  // Doesn't allow for both binary and text input at the same time
-  if (NFilesText != 0 && NFilesBinary !=0) {
-    PyErr_SetString(PyExc_ValueError, "either text or binary files may be added, but not both.");
+  // Only one type of input file at a time
+  if ((NFilesText != 0) + (NFilesBinary != 0) + (NFilesChunked != 0) > 1) {
+    PyErr_SetString(PyExc_ValueError, "only one of text, binary, or chunked files may be added.");
     return NULL;
   }
 
   // Check that there is at least one file
-  if (NFilesText + NFilesBinary < 1) {
+  if (NFilesText + NFilesBinary + NFilesChunked < 1) {
     PyErr_SetString(PyExc_ValueError, "No files given.  You need at least one file as input in a list.");
     return NULL;
   }
 
+  // Chunked output is only written when merging chunked files
+  if (std::string(OutFileNameChunked) != "" && NFilesChunked == 0) {
+    PyErr_SetString(PyExc_ValueError, "cofile may only be used with cifiles");
+    return NULL;
+  }
+
+  // Check number of threads
+  if (NThreads < 1) {
+    PyErr_SetString(PyExc_ValueError, "nthreads must be > 0");
+    return NULL;
+  }
+
   // Add file names to vector
   std::vector<std::string> FileNames;
   for (size_t i = 0; i != NFilesText; ++i) {
@@ -7108,15 +9550,20 @@ static PyObject* OSCARSSR_AverageT3DScalars (OSCARSSRObject* self, PyObject* arg
   for (size_t i = 0; i != NFilesBinary; ++i) {
     FileNames.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_InFileNamesBinary, i)) );
   }
+  for (size_t i = 0; i != NFilesChunked; ++i) {
+    FileNames.push_back( OSCARSPY::GetAsString(PyList_GetItem(List_InFileNamesChunked, i)) );
+  }
 
 
   // Container for flux average
   T3DScalarContainer Container;
 
-  // Either they are text files or binary files
+  // Either they are text files, chunked files, or binary files
   try {
     if (NFilesText > 0) {
       Container.AverageFromFilesText(FileNames, Dim);
+    } else if (NFilesChunked > 0) {
+      Container.AverageFromFilesChunked(FileNames, NThreads, OutFileNameChunked);
     } else {
       Container.AverageFromFilesBinary(FileNames, Dim);
     }
@@ -7514,7 +9961,8 @@ static PyObject* OSCARSSR_PrintNThreads (OSCARSSRObject* self)
   // Out string stream for printing beam information
   std::ostringstream ostream;
   ostream << "*NThreads Globals*\n";
-  ostream << "Number of Threads to use: " << NThreads << "\n" << std::endl;
+  ostream << "Number of Threads to use: " << NThreads << "\n";
+  ostream << "Number of Processes to use: " << self->obj->GetNProcessesGlobal() << "\n" << std::endl;
 
   OSCARSPY::PyPrint_stdout(ostream.str());
 
@@ -7587,9 +10035,23 @@ static PyMethodDef OSCARSSR_methods_fake[] = {
   {"rand",                              (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_Random},
   {"norm",                              (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_RandomNormal},
   {"set_seed",                          (PyCFunction) OSCARSSR_Fake, METH_O,                       DOC_OSCARSSR_SetSeed},
+  {"set_checkpoint",                    (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetCheckpoint},
+  {"clear_checkpoint",                  (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_ClearCheckpoint},
   {"set_gpu_global",                    (PyCFunction) OSCARSSR_Fake, METH_O,                       DOC_OSCARSSR_SetGPUGlobal},
   {"check_gpu",                         (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_CheckGPU},
   {"set_nthreads_global",               (PyCFunction) OSCARSSR_Fake, METH_O,                       DOC_OSCARSSR_SetNThreadsGlobal},
+  {"set_nprocesses_global",             (PyCFunction) OSCARSSR_Fake, METH_O,                       DOC_OSCARSSR_SetNProcessesGlobal},
+  {"set_analytic_mode",                 (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetAnalyticMode},
+  {"get_analytic_mode",                 (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetAnalyticMode},
+  {"get_last_calculation_path",         (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetLastCalculationPath},
+  {"set_integrator",                    (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetIntegrator},
+  {"get_integrator",                    (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetIntegrator},
+  {"set_convergence_mode",              (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetConvergenceMode},
+  {"get_convergence_mode",              (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetConvergenceMode},
+  {"set_warm_start",                    (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetWarmStart},
+  {"get_warm_start",                    (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetWarmStart},
+  {"set_emission_cone_culling",         (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetEmissionConeCulling},
+  {"get_emission_cone_culling",         (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetEmissionConeCulling},
                                                                                                                             
   {"get_ctstart",                       (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetCTStart},
   {"get_ctstop",                        (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetCTStop},
@@ -7649,6 +10111,8 @@ static PyMethodDef OSCARSSR_methods_fake[] = {
   {"get_trajectory",                    (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_GetTrajectory},
 
   {"calculate_spectrum",                (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectrum},
+  {"calculate_spectra",                 (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectra},
+  {"calculate_spectrum_aperture",       (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectrumAperture},
 
   {"calculate_total_power",             (PyCFunction) OSCARSSR_Fake, METH_NOARGS,                  DOC_OSCARSSR_CalculateTotalPower},
   {"calculate_power_density",           (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculatePowerDensity},
@@ -7658,6 +10122,7 @@ static PyMethodDef OSCARSSR_methods_fake[] = {
 
   {"calculate_flux",                    (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFlux},
   {"calculate_flux_rectangle",          (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFluxRectangle},
+  {"calculate_flux_cube",               (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFluxCube},
 
   {"average_spectra",                   (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_AverageSpectra},
   {"add_to_spectrum",                   (PyCFunction) OSCARSSR_Fake, METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_AddToSpectrum},
@@ -7693,9 +10158,23 @@ static PyMethodDef OSCARSSR_methods[] = {
   {"rand",                              (PyCFunction) OSCARSSR_Random,                          METH_NOARGS,                  DOC_OSCARSSR_Random},
   {"norm",                              (PyCFunction) OSCARSSR_RandomNormal,                    METH_NOARGS,                  DOC_OSCARSSR_RandomNormal},
   {"set_seed",                          (PyCFunction) OSCARSSR_SetSeed,                         METH_O,                       DOC_OSCARSSR_SetSeed},
+  {"set_checkpoint",                    (PyCFunction) OSCARSSR_SetCheckpoint,                   METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetCheckpoint},
+  {"clear_checkpoint",                  (PyCFunction) OSCARSSR_ClearCheckpoint,                 METH_NOARGS,                  DOC_OSCARSSR_ClearCheckpoint},
   {"set_gpu_global",                    (PyCFunction) OSCARSSR_SetGPUGlobal,                    METH_O,                       DOC_OSCARSSR_SetGPUGlobal},
   {"check_gpu",                         (PyCFunction) OSCARSSR_CheckGPU,                        METH_NOARGS,                  DOC_OSCARSSR_CheckGPU},
   {"set_nthreads_global",               (PyCFunction) OSCARSSR_SetNThreadsGlobal,               METH_O,                       DOC_OSCARSSR_SetNThreadsGlobal},
+  {"set_nprocesses_global",             (PyCFunction) OSCARSSR_SetNProcessesGlobal,             METH_O,                       DOC_OSCARSSR_SetNProcessesGlobal},
+  {"set_analytic_mode",                 (PyCFunction) OSCARSSR_SetAnalyticMode,                 METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetAnalyticMode},
+  {"get_analytic_mode",                 (PyCFunction) OSCARSSR_GetAnalyticMode,                 METH_NOARGS,                  DOC_OSCARSSR_GetAnalyticMode},
+  {"get_last_calculation_path",         (PyCFunction) OSCARSSR_GetLastCalculationPath,          METH_NOARGS,                  DOC_OSCARSSR_GetLastCalculationPath},
+  {"set_integrator",                    (PyCFunction) OSCARSSR_SetIntegrator,                   METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetIntegrator},
+  {"get_integrator",                    (PyCFunction) OSCARSSR_GetIntegrator,                   METH_NOARGS,                  DOC_OSCARSSR_GetIntegrator},
+  {"set_convergence_mode",              (PyCFunction) OSCARSSR_SetConvergenceMode,              METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetConvergenceMode},
+  {"get_convergence_mode",              (PyCFunction) OSCARSSR_GetConvergenceMode,              METH_NOARGS,                  DOC_OSCARSSR_GetConvergenceMode},
+  {"set_warm_start",                    (PyCFunction) OSCARSSR_SetWarmStart,                    METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetWarmStart},
+  {"get_warm_start",                    (PyCFunction) OSCARSSR_GetWarmStart,                    METH_NOARGS,                  DOC_OSCARSSR_GetWarmStart},
+  {"set_emission_cone_culling",         (PyCFunction) OSCARSSR_SetEmissionConeCulling,          METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_SetEmissionConeCulling},
+  {"get_emission_cone_culling",         (PyCFunction) OSCARSSR_GetEmissionConeCulling,          METH_NOARGS,                  DOC_OSCARSSR_GetEmissionConeCulling},
                                                                                                                             
   {"get_ctstart",                       (PyCFunction) OSCARSSR_GetCTStart,                      METH_NOARGS,                  DOC_OSCARSSR_GetCTStart},
   {"get_ctstop",                        (PyCFunction) OSCARSSR_GetCTStop,                       METH_NOARGS,                  DOC_OSCARSSR_GetCTStop},
@@ -7755,6 +10234,8 @@ static PyMethodDef OSCARSSR_methods[] = {
   {"get_trajectory",                    (PyCFunction) OSCARSSR_GetTrajectory,                   METH_NOARGS,                  DOC_OSCARSSR_GetTrajectory},
 
   {"calculate_spectrum",                (PyCFunction) OSCARSSR_CalculateSpectrum,               METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectrum},
+  {"calculate_spectra",                 (PyCFunction) OSCARSSR_CalculateSpectra,                METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectra},
+  {"calculate_spectrum_aperture",       (PyCFunction) OSCARSSR_CalculateSpectrumAperture,       METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateSpectrumAperture},
 
   {"calculate_total_power",             (PyCFunction) OSCARSSR_CalculateTotalPower,             METH_NOARGS,                  DOC_OSCARSSR_CalculateTotalPower},
   {"calculate_power_density",           (PyCFunction) OSCARSSR_CalculatePowerDensity,           METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculatePowerDensity},
@@ -7764,6 +10245,7 @@ static PyMethodDef OSCARSSR_methods[] = {
 
   {"calculate_flux",                    (PyCFunction) OSCARSSR_CalculateFlux,                   METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFlux},
   {"calculate_flux_rectangle",          (PyCFunction) OSCARSSR_CalculateFluxRectangle,          METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFluxRectangle},
+  {"calculate_flux_cube",               (PyCFunction) OSCARSSR_CalculateFluxCube,               METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_CalculateFluxCube},
 
   {"average_spectra",                   (PyCFunction) OSCARSSR_AverageSpectra,                  METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_AverageSpectra},
   {"add_to_spectrum",                   (PyCFunction) OSCARSSR_AddToSpectrum,                   METH_VARARGS | METH_KEYWORDS, DOC_OSCARSSR_AddToSpectrum},
@@ -8000,3 +10482,147 @@ static PyObject* OSCARSSR_GetT3DScalarAsList (T3DScalarContainer const& C)
 
 
 
+static void OSCARSSR_PrintConvolutionValidation (T3DScalarContainer const& Convolution, T3DScalarContainer const& MonteCarlo)
+{
+  // Print the difference between the convolution and monte carlo results relative to the
+  // maximum of the monte carlo result
+
+  size_t const NPoints = Convolution.GetNPoints();
+  if (MonteCarlo.GetNPoints() != NPoints) {
+    throw std::length_error("convolution and monte carlo results have different number of points");
+  }
+
+  double Max = 0;
+  double MaxDiff = 0;
+  double SumDiff2 = 0;
+  for (size_t i = 0; i != NPoints; ++i) {
+    double const Diff = Convolution.GetPoint(i).GetV() - MonteCarlo.GetPoint(i).GetV();
+    Max = std::max(Max, fabs(MonteCarlo.GetPoint(i).GetV()));
+    MaxDiff = std::max(MaxDiff, fabs(Diff));
+    SumDiff2 += Diff * Diff;
+  }
+
+  double const RMSDiff = NPoints > 0 ? sqrt(SumDiff2 / (double) NPoints) : 0;
+
+  std::ostringstream ostream;
+  ostream << "Convolution vs Monte Carlo relative to maximum: max |difference| = " << (Max > 0 ? MaxDiff / Max : 0)
+          << "  rms difference = " << (Max > 0 ? RMSDiff / Max : 0) << "\n";
+  OSCARSPY::PyPrint_stdout(ostream.str());
+
+  return;
+}
+
+
+
+
+
+
+static void OSCARSSR_PrintConvolutionValidation (TSpectrumContainer const& Convolution, TSpectrumContainer const& MonteCarlo)
+{
+  // Print the difference between the convolution and monte carlo spectra relative to the
+  // maximum of the monte carlo spectrum
+
+  size_t const NPoints = Convolution.GetNPoints();
+  if (MonteCarlo.GetNPoints() != NPoints) {
+    throw std::length_error("convolution and monte carlo results have different number of points");
+  }
+
+  double Max = 0;
+  double MaxDiff = 0;
+  double SumDiff2 = 0;
+  for (size_t i = 0; i != NPoints; ++i) {
+    double const Diff = Convolution.GetFlux(i) - MonteCarlo.GetFlux(i);
+    Max = std::max(Max, fabs(MonteCarlo.GetFlux(i)));
+    MaxDiff = std::max(MaxDiff, fabs(Diff));
+    SumDiff2 += Diff * Diff;
+  }
+
+  double const RMSDiff = NPoints > 0 ? sqrt(SumDiff2 / (double) NPoints) : 0;
+
+  std::ostringstream ostream;
+  ostream << "Convolution vs Monte Carlo relative to maximum: max |difference| = " << (Max > 0 ? MaxDiff / Max : 0)
+          << "  rms difference = " << (Max > 0 ? RMSDiff / Max : 0) << "\n";
+  OSCARSPY::PyPrint_stdout(ostream.str());
+
+  return;
+}
+
+
+
+
+static int OSCARSSR_GetParametricSurface (PyObject* PS, TVector3D const& Rotations, TVector3D const& Translation, int const Normal, TSurfacePoints_Parametric& Surface)
+{
+  // Build the native surface from a parametric surface object of oscars.parametric_surfaces
+  // using its shape, parameters(), and u, v grid.  Returns 0 on success, otherwise
+  // sets the python error and returns -1
+
+  char const* Names[6] = {"ustart", "ustop", "nu", "vstart", "vstop", "nv"};
+  double Values[6];
+  for (int i = 0; i != 6; ++i) {
+    PyObject* Value = PyObject_GetAttrString(PS, Names[i]);
+    if (Value == 0x0) {
+      PyErr_Clear();
+      PyErr_SetString(PyExc_ValueError, ("'surface' is missing attribute: " + std::string(Names[i])).c_str());
+      return -1;
+    }
+    Values[i] = PyFloat_AsDouble(Value);
+    Py_DECREF(Value);
+    if (PyErr_Occurred()) {
+      PyErr_Clear();
+      PyErr_SetString(PyExc_ValueError, ("'surface' attribute is not a number: " + std::string(Names[i])).c_str());
+      return -1;
+    }
+  }
+
+  PyObject* Shape = PyObject_GetAttrString(PS, "shape");
+  if (Shape == 0x0) {
+    PyErr_Clear();
+    PyErr_SetString(PyExc_ValueError, "'surface' is missing attribute: shape");
+    return -1;
+  }
+  char const* ShapeChars = OSCARSPY::GetAsString(Shape);
+  if (ShapeChars == 0x0) {
+    Py_DECREF(Shape);
+    PyErr_Clear();
+    PyErr_SetString(PyExc_ValueError, "'surface' attribute shape is not a string");
+    return -1;
+  }
+  std::string const ShapeStr = ShapeChars;
+  Py_DECREF(Shape);
+
+  std::vector<double> Parameters;
+  PyObject* ParameterList = PyObject_CallMethod(PS, "parameters", NULL);
+  if (ParameterList == 0x0) {
+    PyErr_Clear();
+    PyErr_SetString(PyExc_ValueError, "'surface' has no method parameters()");
+    return -1;
+  }
+
+  try {
+    OSCARSPY::SequenceToVectorDouble(ParameterList, Parameters);
+  } catch (std::invalid_argument e) {
+    Py_DECREF(ParameterList);
+    PyErr_SetString(PyExc_ValueError, "'surface' parameters() must return a list of numbers");
+    return -1;
+  }
+  Py_DECREF(ParameterList);
+
+  try {
+    Surface.Init(ShapeStr,
+                 Parameters,
+                 Values[0],
+                 Values[1],
+                 (int) Values[2],
+                 Values[3],
+                 Values[4],
+                 (int) Values[5],
+                 Rotations,
+                 Translation,
+                 Normal);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return -1;
+  }
+
+  return 0;
+}
@@ -13,6 +13,8 @@
 #include <cmath>
 #include <iomanip>
 #include <complex>
+#include <thread>
+#include <algorithm>
 
 #include "TOSCARSSR.h"
 #include "TOMATH.h"
@@ -66,6 +68,19 @@ double OSCARSTH::UndulatorPeriod (double const BFieldMax, double const K) const
 
 
 
+
+double OSCARSTH::UndulatorBFieldGap (double const Gap, double const Period, double const A, double const B, double const C) const
+{
+  // Return the peak field [T] for a given gap [m] and period [m] from the
+  // common fit B = A exp(B (gap/period) + C (gap/period)^2), A in [T]
+
+  double const g = Gap / Period;
+
+  return A * exp(B * g + C * g * g);
+}
+
+
+
 double OSCARSTH::DipoleCriticalEnergy (double const BField) const
 {
 
@@ -82,14 +97,21 @@ double OSCARSTH::DipoleCriticalEnergy (double const BField) const
 
 void OSCARSTH::DipoleSpectrumEnergy (double const BField, 
                                      TSpectrumContainer& Spectrum,
-                                     double const Angle) const
+                                     double const Angle,
+                                     int const NThreads) const
 {
-  // Beam energy from internal beam
-  double const BeamEnergy_GeV =  fParticleBeam.GetE0();
+  // Energies to calculate at
+  std::vector<double> Energies_eV(Spectrum.GetNPoints());
+  for (size_t i = 0; i < Spectrum.GetNPoints(); ++i) {
+    Energies_eV[i] = Spectrum.GetEnergy(i);
+  }
 
   // Calculate flux for each point
+  std::vector<double> Flux;
+  this->DipoleSpectrumGrid(BField, Energies_eV, std::vector<double>(1, Angle), Flux, NThreads);
+
   for (size_t i = 0; i < Spectrum.GetNPoints(); ++i) {
-    Spectrum.SetFlux(i, DipoleSpectrum(BField, BeamEnergy_GeV, Angle, Spectrum.GetEnergy(i)));
+    Spectrum.SetFlux(i, Flux[i]);
   }
 
   return;
@@ -100,16 +122,21 @@ void OSCARSTH::DipoleSpectrumEnergy (double const BField,
 
 void OSCARSTH::DipoleSpectrumAngle (double const BField, 
                                     TSpectrumContainer& Spectrum,
-                                    double const Energy_eV) const
+                                    double const Energy_eV,
+                                    int const NThreads) const
 {
-  // Beam energy from internal beam
-  double const BeamEnergy_GeV =  fParticleBeam.GetE0();
+  // Here Spectrum.GetEnergy is really getting the angle
+  std::vector<double> Angles(Spectrum.GetNPoints());
+  for (size_t i = 0; i < Spectrum.GetNPoints(); ++i) {
+    Angles[i] = Spectrum.GetEnergy(i);
+  }
 
   // Calculate flux for each point
-  for (size_t i = 0; i < Spectrum.GetNPoints(); ++i) {
+  std::vector<double> Flux;
+  this->DipoleSpectrumGrid(BField, std::vector<double>(1, Energy_eV), Angles, Flux, NThreads);
 
-    // Here Spectrum.GetEnergy is really getting the angle
-    Spectrum.SetFlux(i, DipoleSpectrum(BField, BeamEnergy_GeV, Spectrum.GetEnergy(i), Energy_eV));
+  for (size_t i = 0; i < Spectrum.GetNPoints(); ++i) {
+    Spectrum.SetFlux(i, Flux[i]);
   }
 
   return;
@@ -137,45 +164,37 @@ void OSCARSTH::DipoleSpectrumEnergyAngleIntegrated (double const BField,
 
 double OSCARSTH::DipoleSpectrum (double const BField, double const BeamEnergy_GeV, double const Angle, double const Energy_eV) const
 {
+  // Flux from a dipole at a vertical angle [photons / s / mrad^2 / 0.1%bw]
 
-  double const R = BeamEnergy_GeV  * 1e9 / (BField * TOSCARSSR::C());
   double const Q = TOSCARSSR::Qe();
   double const Me = TOSCARSSR::Me();
-  long double const v5 = Me * Me;
-  double const v6 = (BeamEnergy_GeV * 1e9) * (BeamEnergy_GeV * 1e9);
-  double const v7 = v5 / v6;
-  //long double const v1 = ((TOSCARSSR::Me() * TOSCARSSR::Me()) * (TOSCARSSR::C() * TOSCARSSR::C() * TOSCARSSR::C() * TOSCARSSR::C())) / ((BeamEnergy_GeV * TOSCARSSR::Qe() * (1e-9)) * (BeamEnergy_GeV * TOSCARSSR::Qe() * (1e-9)));
-  double const v2 = 1 - v7;
-  double const v3 = sqrt(v2);
-  double const v = TOSCARSSR::C() * v3;
-  long double const gamma = BeamEnergy_GeV / TOSCARSSR::kgToGeV( TOSCARSSR::Me());
-  //long double const beta_sqr = 1 - (1 / (gamma * gamma));
-  //long double const beta = sqrt(beta_sqr);
-  double const w0 = v / R;
-  double const w01 = TOSCARSSR::AngularFrequencyToEv(w0);
-  long double const wc1 = gamma * gamma * gamma;
-  double const wc2 = 1.5 * wc1;
-  double const wc3 = wc2 * w01;
-  double const wc4 = TOSCARSSR::EvToAngularFrequency(wc3);
-  double const w = TOSCARSSR::EvToAngularFrequency(Energy_eV);
-  double const psi = Angle;
-  double const xi = (1./2.) * (w / wc4) * sqrt(1 + (gamma*gamma) * (psi*psi)) * sqrt(1 + (gamma*gamma) * (psi*psi)) * sqrt(1 + (gamma*gamma) * (psi*psi));
-  double const K2 = TOMATH::BesselK( 2./3. , xi);
-  double const myK2 = K2 * K2;
-  double const K1 = TOMATH::BesselK( 1. /3. , xi);
-  double const myK1 = K1 * K1;
-  double const pi = TOSCARSSR::Pi();
-  double const Epsilon0 = TOSCARSSR::Epsilon0();
   double const c = TOSCARSSR::C();
-  //double const d2I1 = (3./4.) * ((Q*Q*gamma*gamma) / (4. * (pi*pi*pi) * Epsilon0 * c));
-  double const d2I2 = myK2 + (((gamma*gamma*psi*psi) / (1 + (gamma*gamma*psi*psi))) * myK1);
-  double const d2I3 = ((w / wc4) * (w / wc4)) * ((1 + (gamma*gamma)*(psi*psi))*(1 + (gamma*gamma)*(psi*psi)));
-  //double const d2I = d2I1 * d2I2 * d2I3;
-  double const Hbar = TOSCARSSR::Hbar();
-  double const alpha = (Q*Q) / (4. * (pi*pi*pi) * Epsilon0 * c * Hbar);
+
+  // Radius, speed, and critical frequency for this beam and field
+  double const R = BeamEnergy_GeV  * 1e9 / (BField * c);
+  double const v7 = (Me * Me) / ((BeamEnergy_GeV * 1e9) * (BeamEnergy_GeV * 1e9));
+  double const v = c * sqrt(1 - v7);
+  double const gamma = BeamEnergy_GeV / TOSCARSSR::kgToGeV(Me);
+  double const gamma2 = gamma * gamma;
+  double const wc = 1.5 * gamma2 * gamma * v / R;
+
+  // Frequency ratio and angular dependence
+  double const y = TOSCARSSR::EvToAngularFrequency(Energy_eV) / wc;
+  double const GammaPsi2 = gamma2 * Angle * Angle;
+  double const OnePlusGammaPsi2 = 1 + GammaPsi2;
+  double const xi = 0.5 * y * OnePlusGammaPsi2 * sqrt(OnePlusGammaPsi2);
+
+  double K1;
+  double K2;
+  TOMATH::BesselK_1_3_2_3(xi, K1, K2);
+
+  double const pi = TOSCARSSR::Pi();
+  double const alpha = (Q*Q) / (4. * (pi*pi*pi) * TOSCARSSR::Epsilon0() * c * TOSCARSSR::Hbar());
   double const I = 0.5;
-  double const d = (3./4.) * (alpha) * (gamma*gamma) * (I / Q) * (0.001) * d2I3 * d2I2;
-  double const d2N = d * (1e-6);
+
+  double const d2I2 = K2 * K2 + GammaPsi2 / OnePlusGammaPsi2 * K1 * K1;
+  double const d2I3 = (y * y) * (OnePlusGammaPsi2 * OnePlusGammaPsi2);
+  double const d2N = (3./4.) * alpha * gamma2 * (I / Q) * 0.001 * 1e-6 * d2I3 * d2I2;
 
   return d2N;
 }
@@ -193,7 +212,119 @@ double OSCARSTH::DipoleSpectrumAngleIntegrated (double const BField, double cons
   double const OmegaC = 3. * Gamma * Gamma * Gamma * TOSCARSSR::C() / (2. * BeamEnergy_GeV * 1e9 * TOSCARSSR::Qe() / (TOSCARSSR::Qe() * TOSCARSSR::C() * fabs(BField)));
   double const Omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);
   double const y = Omega / OmegaC;
-  return sqrt(3.0) / TOSCARSSR::TwoPi() * TOSCARSSR::Alpha() * Gamma * 0.001 * y * fParticleBeam.GetCurrent() / TOSCARSSR::Qe() * TOMATH::BesselK_IntegralToInfty(5./3., y) * 0.001;
+  return sqrt(3.0) / TOSCARSSR::TwoPi() * TOSCARSSR::Alpha() * Gamma * 0.001 * y * fParticleBeam.GetCurrent() / TOSCARSSR::Qe() * TOMATH::BesselK_5_3_IntegralToInfty(y) * 0.001;
+}
+
+
+
+
+
+void OSCARSTH::DipoleSpectrumGrid (double const BField,
+                                   std::vector<double> const& Energies_eV,
+                                   std::vector<double> const& Angles,
+                                   std::vector<double>& Flux,
+                                   int const NThreads) const
+{
+  // Flux from a dipole for every combination of vertical angle and
+  // photon energy [photons / s / mrad^2 / 0.1%bw].  The result is
+  // stored angle-major: Flux[iAngle * Energies_eV.size() + iEnergy]
+
+  size_t const NPoints = Energies_eV.size() * Angles.size();
+  Flux.assign(NPoints, 0);
+  if (NPoints == 0) {
+    return;
+  }
+
+  // Number of threads to use, never more than one per point
+  size_t const NThreadsToUse = (size_t) this->GetNThreadsToUse(NThreads);
+  size_t const NThreadsActual = NPoints > NThreadsToUse ? NThreadsToUse : NPoints;
+
+  if (NThreadsActual == 1) {
+    this->DipoleSpectrumGridPoints(BField, Energies_eV, Angles, Flux, 0, NPoints - 1);
+    return;
+  }
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Each thread writes only its own range of Flux
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&OSCARSTH::DipoleSpectrumGridPoints,
+                                  this,
+                                  BField,
+                                  std::cref(Energies_eV),
+                                  std::cref(Angles),
+                                  std::ref(Flux),
+                                  iFirst,
+                                  iLast));
+  }
+
+  for (size_t it = 0; it != Threads.size(); ++it) {
+    Threads[it].join();
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::DipoleSpectrumGridPoints (double const BField,
+                                         std::vector<double> const& Energies_eV,
+                                         std::vector<double> const& Angles,
+                                         std::vector<double>& Flux,
+                                         size_t const iFirst,
+                                         size_t const iLast) const
+{
+  // Same calculation as DipoleSpectrum() for the flat indices iFirst
+  // to iLast inclusive, with everything depending only on the beam and
+  // field calculated once
+
+  double const BeamEnergy_GeV = fParticleBeam.GetE0();
+
+  double const Q = TOSCARSSR::Qe();
+  double const Me = TOSCARSSR::Me();
+  double const c = TOSCARSSR::C();
+
+  // Radius, speed, and critical frequency for this beam and field
+  double const R = BeamEnergy_GeV  * 1e9 / (BField * c);
+  double const v7 = (Me * Me) / ((BeamEnergy_GeV * 1e9) * (BeamEnergy_GeV * 1e9));
+  double const v = c * sqrt(1 - v7);
+  double const gamma = BeamEnergy_GeV / TOSCARSSR::kgToGeV(Me);
+  double const gamma2 = gamma * gamma;
+  double const wc = 1.5 * gamma2 * gamma * v / R;
+
+  double const pi = TOSCARSSR::Pi();
+  double const alpha = (Q*Q) / (4. * (pi*pi*pi) * TOSCARSSR::Epsilon0() * c * TOSCARSSR::Hbar());
+  double const I = 0.5;
+  double const Prefactor = (3./4.) * alpha * gamma2 * (I / Q) * 0.001 * 1e-6;
+
+  size_t const NEnergies = Energies_eV.size();
+
+  double K1;
+  double K2;
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    double const Angle = Angles[i / NEnergies];
+    double const y = TOSCARSSR::EvToAngularFrequency(Energies_eV[i % NEnergies]) / wc;
+
+    double const GammaPsi2 = gamma2 * Angle * Angle;
+    double const OnePlusGammaPsi2 = 1 + GammaPsi2;
+    double const xi = 0.5 * y * OnePlusGammaPsi2 * sqrt(OnePlusGammaPsi2);
+
+    TOMATH::BesselK_1_3_2_3(xi, K1, K2);
+
+    double const d2I2 = K2 * K2 + GammaPsi2 / OnePlusGammaPsi2 * K1 * K1;
+    double const d2I3 = (y * y) * (OnePlusGammaPsi2 * OnePlusGammaPsi2);
+
+    Flux[i] = Prefactor * d2I3 * d2I2;
+  }
+
+  return;
 }
 
 
@@ -203,26 +334,501 @@ double OSCARSTH::DipoleSpectrumAngleIntegrated (double const BField, double cons
 double OSCARSTH::UndulatorFlux (double const BField, double const Period, double const NPeriods, double const BeamEnergy, double const AngleV, double const AngleH,  double const Energy_eV) const
 {
   // Return the flux at a given energy and horizontal and vertical angle [photons/s/mrad^2/0.1%bw]
-  return 0;
-
-  // Print input fields as a check
-  std::cout << "BField:       " << BField << std::endl;
-  std::cout << "Period:       " << Period << std::endl;
-  std::cout << "NPeriods:     " << NPeriods << std::endl;
-  std::cout << "BeamEnergy:   " << BeamEnergy << std::endl;
-  std::cout << "AngleV:       " << AngleV << std::endl;
-  std::cout << "AngleH:       " << AngleH << std::endl;
-  std::cout << "Energy_eV:    " << Energy_eV << std::endl;
-
-  // The undulator K
+  // for a planar undulator.  Current is taken from the internal beam.
+
+  // The undulator K and gamma for the given beam energy
   double const K = this->UndulatorK(BField, Period);
-  std::cout << "K:            " << K << std::endl;
+  double const Gamma = BeamEnergy / TOSCARSSR::kgToGeV(TOSCARSSR::Me());
+
+  std::vector<double> JX;
+  std::vector<double> JY;
+  return this->UndulatorFluxAngle(K, Period, (int) NPeriods, Gamma, AngleH, AngleV, Energy_eV, kUndulatorType_Planar, JX, JY);
+}
+
+
+
+
+
+static inline double BesselJFromSequence (std::vector<double> const& J, int const n)
+{
+  // J_n from a sequence J_0...J_N, using J_-n = (-1)^n J_n
+  return n >= 0 ? J[n] : ((-n) % 2 == 0 ? J[-n] : -J[-n]);
+}
+
+
+
+
+double OSCARSTH::UndulatorFluxAngle (double const K,
+                                     double const Period,
+                                     int    const NPeriods,
+                                     double const Gamma,
+                                     double const AngleH,
+                                     double const AngleV,
+                                     double const Energy_eV,
+                                     OSCARSTH_UndulatorType const Type,
+                                     std::vector<double>& JX,
+                                     std::vector<double>& JY) const
+{
+  // Flux [photons/s/mrad^2/0.1%bw] from an ideal undulator with the field
+  // along the vertical for a planar device.  The far-field radiation
+  // integral over one period is expanded in harmonics n with Bessel sums
+  // and multiplied by the line shape of N periods.  Harmonics within one
+  // of the nearest to omega / omega_1(theta) are included.
+  //
+  // JX, JY are work space for the Bessel sequences so they can be reused
+  // from one call to the next.
+
+  double const Gamma2 = Gamma * Gamma;
+  double const K2 = K * K;
+  double const Theta2 = AngleH * AngleH + AngleV * AngleV;
+
+  // Fundamental frequency at this angle and ratio to it
+  double const D = (Type == kUndulatorType_Helical ? 1. + K2 : 1. + K2 / 2.) + Gamma2 * Theta2;
+  double const OmegaU = TOSCARSSR::TwoPi() * TOSCARSSR::C() / Period;
+  double const Omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);
+  double const Nu = Omega * D / (2. * Gamma2 * OmegaU);
+
+  if (Nu <= 0) {
+    return 0;
+  }
+
+  int const NFirst = (int) floor(Nu) - 1 > 1 ? (int) floor(Nu) - 1 : 1;
+  int const NLast  = (int) ceil(Nu) + 1;
+
+  double Sum = 0;
+  for (int n = NFirst; n <= NLast; ++n) {
+
+    // Line shape for N periods, N^2 on resonance
+    double const PiDelta = TOSCARSSR::Pi() * (Nu - n);
+    double const LineShape = fabs(NPeriods * PiDelta) < 1e-6 ? (double) NPeriods * NPeriods : pow(sin(NPeriods * PiDelta) / PiDelta, 2);
+
+    double B2 = 0;
+    if (Type == kUndulatorType_Helical) {
+      double const Theta = sqrt(Theta2);
+      double const X = 2. * n * Gamma * Theta * K / D;
+
+      JX.resize(n + 2);
+      TOMATH::BesselJ_Sequence(n + 1, X, JX.data());
+
+      B2 = pow(Gamma * Theta * JX[n] - 0.5 * K * (JX[n - 1] + JX[n + 1]), 2) + 0.25 * K2 * pow(JX[n - 1] - JX[n + 1], 2);
+    } else {
+      // Arguments for the horizontal oscillation and the longitudinal one at 2 omega_u
+      double const X = 2. * n * Gamma * AngleH * K / D;
+      double const Y = n * K2 / (4. * D);
+
+      // J_m(Y) is negligible above M
+      int const M = (int) Y + 10 + (int) sqrt(20. * Y);
+      int const PMax = n + 2 * M + 1;
+
+      JX.resize(PMax + 1);
+      JY.resize(M + 1);
+      TOMATH::BesselJ_Sequence(PMax, X, JX.data());
+      TOMATH::BesselJ_Sequence(M, Y, JY.data());
+
+      double S0 = 0;
+      double S1 = 0;
+      for (int m = -M; m <= M; ++m) {
+        double const Jm = BesselJFromSequence(JY, m);
+        int    const p  = n + 2 * m;
+        S0 += Jm * BesselJFromSequence(JX, p);
+        S1 += Jm * (BesselJFromSequence(JX, p - 1) + BesselJFromSequence(JX, p + 1));
+      }
+      S1 *= 0.5;
+
+      B2 = pow(Gamma * AngleH * S0 - K * S1, 2) + pow(Gamma * AngleV * S0, 2);
+    }
+
+    Sum += B2 * LineShape;
+  }
+
+  return TOSCARSSR::Alpha() * fParticleBeam.GetCurrent() / TOSCARSSR::Qe() * 0.001 * 1e-6 * pow(Omega / (OmegaU * Gamma), 2) * Sum;
+}
+
+
+
+
+void OSCARSTH::UndulatorFluxAngles (double const K,
+                                    double const Period,
+                                    int    const NPeriods,
+                                    std::vector<double> const& AnglesH,
+                                    std::vector<double> const& AnglesV,
+                                    std::vector<double> const& Energies_eV,
+                                    std::vector<double>& Flux,
+                                    OSCARSTH_UndulatorType const Type,
+                                    int const NThreads) const
+{
+  // Flux [photons/s/mrad^2/0.1%bw] from an ideal undulator for each
+  // (AngleH[i], AngleV[i], Energies_eV[i]) using the internal beam
+
+  if (AnglesH.size() != AnglesV.size() || AnglesH.size() != Energies_eV.size()) {
+    throw std::length_error("angle and energy vectors must be the same size");
+  }
+  if (Period <= 0 || NPeriods <= 0) {
+    throw std::out_of_range("period and number of periods must be > 0");
+  }
+  if (fParticleBeam.GetGamma() == 0 || fParticleBeam.GetCurrent() == 0) {
+    throw std::invalid_argument("Beam definition incorrect for this calculation: Check energy, current");
+  }
+
+  size_t const NPoints = Energies_eV.size();
+  Flux.assign(NPoints, 0);
+  if (NPoints == 0) {
+    return;
+  }
+
+  // Number of threads to use, never more than one per point
+  size_t const NThreadsToUse = (size_t) this->GetNThreadsToUse(NThreads);
+  size_t const NThreadsActual = NPoints > NThreadsToUse ? NThreadsToUse : NPoints;
+
+  if (NThreadsActual == 1) {
+    this->UndulatorFluxAnglesPoints(K, Period, NPeriods, AnglesH, AnglesV, Energies_eV, Flux, Type, 0, NPoints - 1);
+    return;
+  }
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Each thread writes only its own range of Flux
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&OSCARSTH::UndulatorFluxAnglesPoints,
+                                  this,
+                                  K,
+                                  Period,
+                                  NPeriods,
+                                  std::cref(AnglesH),
+                                  std::cref(AnglesV),
+                                  std::cref(Energies_eV),
+                                  std::ref(Flux),
+                                  Type,
+                                  iFirst,
+                                  iLast));
+  }
+
+  for (size_t it = 0; it != Threads.size(); ++it) {
+    Threads[it].join();
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorFluxAnglesPoints (double const K,
+                                          double const Period,
+                                          int    const NPeriods,
+                                          std::vector<double> const& AnglesH,
+                                          std::vector<double> const& AnglesV,
+                                          std::vector<double> const& Energies_eV,
+                                          std::vector<double>& Flux,
+                                          OSCARSTH_UndulatorType const Type,
+                                          size_t const iFirst,
+                                          size_t const iLast) const
+{
+  // Flux for the indices iFirst to iLast inclusive, Bessel work space is
+  // kept for the whole range
+
+  double const Gamma = fParticleBeam.GetGamma();
+
+  std::vector<double> JX;
+  std::vector<double> JY;
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    Flux[i] = this->UndulatorFluxAngle(K, Period, NPeriods, Gamma, AnglesH[i], AnglesV[i], Energies_eV[i], Type, JX, JY);
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorFluxSpectrum (double const K,
+                                      double const Period,
+                                      int    const NPeriods,
+                                      double const AngleH,
+                                      double const AngleV,
+                                      TSpectrumContainer& Spectrum,
+                                      OSCARSTH_UndulatorType const Type,
+                                      int const NThreads) const
+{
+  // Undulator spectrum [photons/s/mrad^2/0.1%bw] at the given angles for
+  // the energies in Spectrum
+
+  size_t const NPoints = Spectrum.GetNPoints();
+
+  std::vector<double> Energies_eV(NPoints);
+  for (size_t i = 0; i < NPoints; ++i) {
+    Energies_eV[i] = Spectrum.GetEnergy(i);
+  }
+
+  std::vector<double> Flux;
+  this->UndulatorFluxAngles(K, Period, NPeriods, std::vector<double>(NPoints, AngleH), std::vector<double>(NPoints, AngleV), Energies_eV, Flux, Type, NThreads);
+
+  for (size_t i = 0; i < NPoints; ++i) {
+    Spectrum.SetFlux(i, Flux[i]);
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorFluxSurface (double         const  K,
+                                     double         const  Period,
+                                     int            const  NPeriods,
+                                     TSurfacePoints const& Surface,
+                                     double         const  Energy_eV,
+                                     T3DScalarContainer&   FluxContainer,
+                                     OSCARSTH_UndulatorType const Type,
+                                     int            const  Dimension,
+                                     int            const  NThreads) const
+{
+  // Undulator flux [photons/s/mm^2/0.1%bw] on a surface for an undulator
+  // centered at the origin along +z, as for the numerical flux calculation
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("wrong dimension");
+  }
+
+  size_t const NPoints = Surface.GetNPoints();
+
+  // Angles to each point
+  std::vector<double> AnglesH(NPoints);
+  std::vector<double> AnglesV(NPoints);
+  std::vector<double> InverseR2(NPoints);
+  for (size_t i = 0; i != NPoints; ++i) {
+    TVector3D const ObservationPoint = Surface.GetPoint(i).GetPoint();
+    double const X0 = ObservationPoint.GetX();
+    double const Y0 = ObservationPoint.GetY();
+    double const Z0 = ObservationPoint.GetZ();
+
+    if (ObservationPoint.Mag2() == 0) {
+      throw std::out_of_range("observation point at the origin");
+    }
+
+    AnglesH[i] = atan2(X0, Z0);
+    AnglesV[i] = atan2(Y0, sqrt(Z0*Z0 + X0*X0));
+    InverseR2[i] = 1. / ObservationPoint.Mag2();
+  }
+
+  std::vector<double> Flux;
+  this->UndulatorFluxAngles(K, Period, NPeriods, AnglesH, AnglesV, std::vector<double>(NPoints, Energy_eV), Flux, Type, NThreads);
+
+  // Per mrad^2 to per mm^2 at the point
+  for (size_t i = 0; i != NPoints; ++i) {
+    if (Dimension == 3) {
+      FluxContainer.AddPoint(Surface.GetPoint(i).GetPoint(), Flux[i] * InverseR2[i]);
+    } else {
+      FluxContainer.AddPoint(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), Flux[i] * InverseR2[i]);
+    }
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorPowerDensityAngles (double const K,
+                                            double const Period,
+                                            int    const NPeriods,
+                                            std::vector<double> const& AnglesH,
+                                            std::vector<double> const& AnglesV,
+                                            std::vector<double>& PowerDensity,
+                                            int const NThreads) const
+{
+  // Angular power density [W/mrad^2] from an ideal planar undulator or
+  // wiggler with the field vertical for each (AngleH[i], AngleV[i]) using
+  // the internal beam.  This is the period averaged distribution of
+  // K.-J. Kim, NIM A246 (1986) 67, valid for any K.
+
+  if (AnglesH.size() != AnglesV.size()) {
+    throw std::length_error("angle vectors must be the same size");
+  }
+  if (Period <= 0 || NPeriods <= 0) {
+    throw std::out_of_range("period and number of periods must be > 0");
+  }
+  if (fParticleBeam.GetGamma() == 0 || fParticleBeam.GetCurrent() == 0) {
+    throw std::invalid_argument("Beam definition incorrect for this calculation: Check energy, current");
+  }
+
+  size_t const NPoints = AnglesH.size();
+  PowerDensity.assign(NPoints, 0);
+  if (NPoints == 0) {
+    return;
+  }
+
+  // Number of threads to use, never more than one per point
+  size_t const NThreadsToUse = (size_t) this->GetNThreadsToUse(NThreads);
+  size_t const NThreadsActual = NPoints > NThreadsToUse ? NThreadsToUse : NPoints;
+
+  if (NThreadsActual == 1) {
+    this->UndulatorPowerDensityAnglesPoints(K, Period, NPeriods, AnglesH, AnglesV, PowerDensity, 0, NPoints - 1);
+    return;
+  }
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Each thread writes only its own range of PowerDensity
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&OSCARSTH::UndulatorPowerDensityAnglesPoints,
+                                  this,
+                                  K,
+                                  Period,
+                                  NPeriods,
+                                  std::cref(AnglesH),
+                                  std::cref(AnglesV),
+                                  std::ref(PowerDensity),
+                                  iFirst,
+                                  iLast));
+  }
+
+  for (size_t it = 0; it != Threads.size(); ++it) {
+    Threads[it].join();
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorPowerDensityAnglesPoints (double const K,
+                                                  double const Period,
+                                                  int    const NPeriods,
+                                                  std::vector<double> const& AnglesH,
+                                                  std::vector<double> const& AnglesV,
+                                                  std::vector<double>& PowerDensity,
+                                                  size_t const iFirst,
+                                                  size_t const iLast) const
+{
+  // Power density for the indices iFirst to iLast inclusive.  With total
+  // power P = e^3 gamma^2 B^2 L I / (12 pi epsilon0 m^2 c^2) the distribution is
+  //   dP/dOmega = P 3 gamma^2 / pi^2 Int
+  //   Int = Integral_-pi^pi sin^2(a) [1/D^3 - 4 (gx - K cos(a))^2 / D^5] da
+  //   D = 1 + gy^2 + (gx - K cos(a))^2
+  // with gx and gy the horizontal and vertical angles times gamma.  The
+  // integrand is even and periodic in a so the trapezoid rule on [0, pi]
+  // converges quickly.  The number of steps grows with K to resolve the
+  // peaks of width ~1/K.
+
+  double const Gamma   = fParticleBeam.GetGamma();
+  double const Current = fParticleBeam.GetCurrent();
+
+  double const BField = this->UndulatorBField(K, Period);
+  double const Length = NPeriods * Period;
+  double const Me = TOSCARSSR::Me();
+  double const C  = TOSCARSSR::C();
+
+  double const PowerTotal = pow(TOSCARSSR::Qe(), 3) * Gamma * Gamma * BField * BField * Length * Current / (12. * TOSCARSSR::Pi() * TOSCARSSR::Epsilon0() * Me * Me * C * C);
+
+  // [W/rad^2] to [W/mrad^2], 2 for the half interval
+  double const C0 = PowerTotal * 3. * Gamma * Gamma / TOSCARSSR::Pi2() * 2. * 1e-6;
+
+  // Integration nodes and weights, trapezoid on [0, pi]
+  int const NSteps = 64 + (int) (16. * K);
+  double const Step = TOSCARSSR::Pi() / NSteps;
+  std::vector<double> KCos(NSteps + 1);
+  std::vector<double> WSin2(NSteps + 1);
+  for (int j = 0; j <= NSteps; ++j) {
+    double const a = Step * j;
+    KCos[j]  = K * cos(a);
+    WSin2[j] = Step * pow(sin(a), 2) * (j == 0 || j == NSteps ? 0.5 : 1.);
+  }
+
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    double const gx = Gamma * AnglesH[i];
+    double const gy = Gamma * AnglesV[i];
+    double const D0 = 1. + gy * gy;
+
+    double Sum = 0;
+    for (int j = 0; j <= NSteps; ++j) {
+      double const u  = gx - KCos[j];
+      double const D  = D0 + u * u;
+      double const D3 = D * D * D;
+      Sum += WSin2[j] * (1. - 4. * u * u / (D * D)) / D3;
+    }
+
+    PowerDensity[i] = C0 * Sum;
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorPowerDensitySurface (double         const  K,
+                                             double         const  Period,
+                                             int            const  NPeriods,
+                                             TSurfacePoints const& Surface,
+                                             T3DScalarContainer&   PowerDensityContainer,
+                                             bool           const  Directional,
+                                             int            const  Dimension,
+                                             int            const  NThreads) const
+{
+  // Power density [W/mm^2] on a surface for an undulator centered at the
+  // origin along +z with the field vertical, as for the numerical power
+  // density calculation.  If the surface has normals the incidence angle
+  // is included and for Directional only the front face is illuminated.
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("wrong dimension");
+  }
+
+  size_t const NPoints = Surface.GetNPoints();
+  bool const HasNormal = Surface.HasNormal();
+
+  // Angles to each point and the projection on the surface
+  std::vector<double> AnglesH(NPoints);
+  std::vector<double> AnglesV(NPoints);
+  std::vector<double> Factor(NPoints);
+  for (size_t i = 0; i != NPoints; ++i) {
+    TVector3D const ObservationPoint = Surface.GetPoint(i).GetPoint();
+    double const X0 = ObservationPoint.GetX();
+    double const Y0 = ObservationPoint.GetY();
+    double const Z0 = ObservationPoint.GetZ();
 
-  // This is a complex number
-  std::complex<double> const I(0, 1);
-  std::cout << "I:            " << I << std::endl;
+    if (ObservationPoint.Mag2() == 0) {
+      throw std::out_of_range("observation point at the origin");
+    }
 
-  return 0;
+    AnglesH[i] = atan2(X0, Z0);
+    AnglesV[i] = atan2(Y0, sqrt(Z0*Z0 + X0*X0));
+
+    double const Projection = HasNormal ? ObservationPoint.UnitVector().Dot(Surface.GetPoint(i).GetNormal()) : 1;
+    if (Directional) {
+      Factor[i] = Projection > 0 ? Projection / ObservationPoint.Mag2() : 0;
+    } else {
+      Factor[i] = fabs(Projection) / ObservationPoint.Mag2();
+    }
+  }
+
+  std::vector<double> PowerDensity;
+  this->UndulatorPowerDensityAngles(K, Period, NPeriods, AnglesH, AnglesV, PowerDensity, NThreads);
+
+  // Per mrad^2 to per mm^2 at the point
+  for (size_t i = 0; i != NPoints; ++i) {
+    if (Dimension == 3) {
+      PowerDensityContainer.AddPoint(Surface.GetPoint(i).GetPoint(), PowerDensity[i] * Factor[i]);
+    } else {
+      PowerDensityContainer.AddPoint(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0), PowerDensity[i] * Factor[i]);
+    }
+  }
+
+  return;
 }
 
 
@@ -240,43 +846,12 @@ TVector2D OSCARSTH::UndulatorFluxOnAxisK (double const K, double const Period, d
 {
   // Return the on-axis flux for this K value and harmonic
 
-  double const BeamEnergyGeV = fParticleBeam.GetE0();
-
-  double const n = Harmonic;
-  double const nu = (n + 1.) / 2.;
-  double const nu2 = (n - 1.) / 2.;
-  double const JB = (n * K * K) / (4. + (2. * K * K));
-  //double const E = BeamEnergyGeV * 1e9;
-  double const gamma = BeamEnergyGeV / TOSCARSSR::kgToGeV( TOSCARSSR::Me());
-  double const JBessel1 = TOMATH::BesselJ(nu, JB);
-  double const JBessel3 = TOMATH::BesselJ(nu2, JB);
-  double const Q = TOSCARSSR::Qe();
-  double const c = TOSCARSSR::C();
-  //double const Me_eV = TOSCARSSR::kgToGeV(TOSCARSSR::Me()) * 1e9;
-  double const pi = TOSCARSSR::Pi();
-  //double const K_1 = Q * 1. * Period;
-  //double const K_2 = 2. * pi * Me_eV * c * c;
-  //double const K_0 = K_1 / K_2;
-  double const z1 = n * K;
-  double const z2 = 1. + ((K * K)/2.);
-  double const z3 = z1 / z2;
-  double const h0 = z3 * gamma * (JBessel1 - JBessel3);
-  double const Epsilon0 = TOSCARSSR::Epsilon0();
-  double const Hbar = TOSCARSSR::Hbar();
-  double const alpha = (Q*Q) / (4. * pi * Epsilon0 * c * Hbar);
-  double const I = 0.5;
-  double const N = NPeriods;
-  double const Nsq = N * N;
-  double const h0squrd = h0 * h0;
-  double const h001 = alpha * (I / Q) * Nsq * h0squrd;
-  double const h002 = h001 * 0.001;
-  double const h00 = h002 * 1e-6;
-  double const w1 = 2. * n * c * gamma * gamma;
-  double const w2 = Period * (1. + ((K * K)/ 2.));
-  double const wn = w1 / w2;
-  double const omega_1 = TOSCARSSR::FrequencyToEv(wn);
+  std::vector<double> Energies_eV;
+  std::vector<double> Flux;
+  std::vector<double> Brightness;
+  this->UndulatorTuningCurves(std::vector<double>(1, K), std::vector<int>(1, Harmonic), Period, (int) NPeriods, Energies_eV, Flux, Brightness, false, 1);
 
-  return TVector2D(omega_1, h00);
+  return TVector2D(Energies_eV[0], Flux[0]);
 }
 
 
@@ -303,19 +878,27 @@ TVector2D OSCARSTH::UndulatorFluxOnAxisB (double const BField, double const Peri
 
 double OSCARSTH::UndulatorFluxWeak (double const K, double const Period, double const NPeriods, double const BeamEnergyGeV, int const Harmonic) const
 {
-  // Return the on-axis flux for this K value and harmonic
-  return 0;
-
-  std::cout << "K             " << K << std::endl;
-  std::cout << "Period:       " << Period << std::endl;
-  std::cout << "NPeriods:     " << NPeriods << std::endl;
-  std::cout << "BeamEnergyGeV:   " << BeamEnergyGeV << std::endl;
-  std::cout << "Harmonic      " << Harmonic << std::endl;
+  // Return the on-axis flux [photons/s/mrad^2/0.1%bw] for this K value and
+  // harmonic to leading order in K (K << 1).  Only odd harmonics radiate
+  // on-axis, the n-th going as K^(2n).  Period does not enter at this order.
 
+  if (Harmonic <= 0 || Harmonic % 2 == 0) {
+    return 0;
+  }
 
   double const Gamma = BeamEnergyGeV / TOSCARSSR::kgToGeV( TOSCARSSR::Me());
 
-  return Gamma;
+  // J_(n-1)/2 (n K^2 / 4) to leading order
+  int    const nu = (Harmonic - 1) / 2;
+  double const Y = Harmonic * K * K / 4.;
+  double JJ = 1;
+  for (int i = 1; i <= nu; ++i) {
+    JJ *= Y / 2. / (double) i;
+  }
+
+  double const Fn = Harmonic * Harmonic * K * K * JJ * JJ;
+
+  return TOSCARSSR::Alpha() * NPeriods * NPeriods * Gamma * Gamma * fParticleBeam.GetCurrent() / TOSCARSSR::Qe() * 0.001 * 1e-6 * Fn;
 }
 
 
@@ -323,7 +906,8 @@ double OSCARSTH::UndulatorFluxWeak (double const K, double const Period, double
 
 
 void OSCARSTH::DipoleBrightness (double const BField,
-                                 TSpectrumContainer& SpectrumContainer) const
+                                 TSpectrumContainer& SpectrumContainer,
+                                 int const NThreads) const
 {
 
   // Beam energy from internal beam
@@ -345,11 +929,33 @@ void OSCARSTH::DipoleBrightness (double const BField,
   double const alpha_y = Alpha.GetY();
   double const gamma_y = (1. + alpha_y*alpha_y) / beta_y;
 
-  for (size_t i = 0; i != SpectrumContainer.GetNPoints(); ++i) {
-    double const dfdt = this->DipoleSpectrumAngleIntegrated(BField, BeamEnergy_GeV, SpectrumContainer.GetEnergy(i));
-    double const df2dtdp = this->DipoleSpectrum(BField, BeamEnergy_GeV, 0, SpectrumContainer.GetEnergy(i));
+  size_t const NPoints = SpectrumContainer.GetNPoints();
+  std::vector<double> Energies_eV(NPoints);
+  for (size_t i = 0; i != NPoints; ++i) {
+    Energies_eV[i] = SpectrumContainer.GetEnergy(i);
+  }
 
-    double const sigma_psi = dfdt / (df2dtdp * sqrt(TOSCARSSR::TwoPi()));
+  // On-axis flux for all energies
+  std::vector<double> df2dtdp;
+  this->DipoleSpectrumGrid(BField, Energies_eV, std::vector<double>(1, 0), df2dtdp, NThreads);
+
+  // Angle integrated flux for all energies, as in DipoleSpectrumAngleIntegrated()
+  double const Gamma = BeamEnergy_GeV / TOSCARSSR::kgToGeV( TOSCARSSR::Me());
+  double const OmegaC = 3. * Gamma * Gamma * Gamma * TOSCARSSR::C() / (2. * BeamEnergy_GeV * 1e9 * TOSCARSSR::Qe() / (TOSCARSSR::Qe() * TOSCARSSR::C() * fabs(BField)));
+  double const C0 = sqrt(3.0) / TOSCARSSR::TwoPi() * TOSCARSSR::Alpha() * Gamma * 0.001;
+  double const Current = fParticleBeam.GetCurrent();
+
+  std::vector<double> y(NPoints);
+  std::vector<double> G(NPoints);
+  for (size_t i = 0; i != NPoints; ++i) {
+    y[i] = TOSCARSSR::EvToAngularFrequency(Energies_eV[i]) / OmegaC;
+  }
+  TOMATH::BesselK_5_3_IntegralToInfty(y.data(), G.data(), NPoints);
+
+  for (size_t i = 0; i != NPoints; ++i) {
+    double const dfdt = C0 * y[i] * Current / TOSCARSSR::Qe() * G[i] * 0.001;
+
+    double const sigma_psi = dfdt / (df2dtdp[i] * sqrt(TOSCARSSR::TwoPi()));
 
 
     double const sigma_r = lam / (TOSCARSSR::FourPi() * sigma_psi);
@@ -358,7 +964,7 @@ void OSCARSTH::DipoleBrightness (double const BField,
     double const Sigma_x = sqrt(epsilon_x * beta_x + pow(eta_x * sigma_E, 2) + sigma_r*sigma_r);
     double const Sigma_y = sqrt(epsilon_y * beta_y + (epsilon_y*epsilon_y + epsilon_y * gamma_y * sigma_r*sigma_r) / (sigma_psi*sigma_psi));
 
-    SpectrumContainer.SetFlux(i, df2dtdp / (TOSCARSSR::TwoPi() * Sigma_x * Sigma_y) / 1e6);
+    SpectrumContainer.SetFlux(i, df2dtdp[i] / (TOSCARSSR::TwoPi() * Sigma_x * Sigma_y) / 1e6);
   }
   return;
 }
@@ -425,66 +1031,245 @@ TVector2D OSCARSTH::UndulatorBrightnessK (double const K,
     return TVector2D(0, 0);
   }
 
-  // Properties from beam
-  double    const Gamma          = fParticleBeam.GetGamma();
-  TVector2D const Beta           = fParticleBeam.GetTwissBeta();
-  TVector2D const Emittance      = fParticleBeam.GetEmittance();
-  double    const Current        = fParticleBeam.GetCurrent();
+  std::vector<double> Energies_eV;
+  std::vector<double> Brightness;
+  this->UndulatorBrightnessKGrid(std::vector<double>(1, K), std::vector<int>(1, N), Period, NPeriods, Energies_eV, Brightness, 1);
 
-  // Check that we can do this calculation, else reject
-  if (Gamma == 0 || Beta[0] == 0 || Beta[1] == 0 || Emittance[0] == 0 || Emittance[1] == 0 || Current == 0) {
-    throw std::invalid_argument("Beam definition incorrect for this calculation: Check energy, current, beta, emittance");
-  }
+  return TVector2D(Energies_eV[0], Brightness[0]);
+}
 
-  double const sigx = sqrt(Emittance[0] * Beta[0]);
-  double const sigy = sqrt(Emittance[1] * Beta[1]);
 
-  double const sigxp = sqrt(Emittance[0] / Beta[0]);
-  double const sigyp = sqrt(Emittance[1] / Beta[1]);
 
-  double const K2 = K * K;
 
-  double const Lambda = Period / (2 * Gamma * Gamma) * (1. + K2 / 2.) / (double) N;
-  double const Energy_eV = UndulatorEnergyAtHarmonicK(K, Period, N);
 
-  double const Fn = K2 * N * N / pow(1. + K2 / 2., 2) * pow(
-      TOMATH::BesselJ( (N - 1) / 2, N * K2 / (4 * (1. + 0.5 * K2))) - TOMATH::BesselJ( (N + 1) / 2, N * K2 / (4 * (1. + 0.5 * K2))),
-      2);
 
-  double const Qn = (1. + K2 / 2.) * Fn / (double) N;
+TVector2D OSCARSTH::UndulatorBrightnessB (double const BField,
+                                          double const Period,
+                                          int    const NPeriods,
+                                          int    const Harmonic
+                                          ) const
+{
+  // Return the on-axis theoretical brightness for a planar undulator
 
-  double const Fu = TOSCARSSR::Pi() * TOSCARSSR::Alpha() * NPeriods * 0.001 * Current / TOSCARSSR::Qe() * Qn;
+  return UndulatorBrightnessK(this->UndulatorK(BField, Period), Period, NPeriods, Harmonic);
+}
 
 
-  double const sigr = 1 / TOSCARSSR::FourPi() * sqrt(Lambda * Period * NPeriods);
-  double const sigrp = sqrt(Lambda / (Period * NPeriods));
-  double const SigmaX = sqrt(sigx * sigx + sigr * sigr);
-  double const SigmaY = sqrt(sigy * sigy + sigr * sigr);
-  double const SigmaXP = sqrt(sigxp * sigxp + sigrp * sigrp);
-  double const SigmaYP = sqrt(sigyp * sigyp + sigrp * sigrp);
 
-  return TVector2D(Energy_eV, Fu / (4 * TOSCARSSR::Pi2() * SigmaX * SigmaY * SigmaXP * SigmaYP) * 1.e-12);
-}
 
 
 
 
+void OSCARSTH::UndulatorBrightnessKGrid (std::vector<double> const& K,
+                                         std::vector<int>    const& Harmonics,
+                                         double              const  Period,
+                                         int                 const  NPeriods,
+                                         std::vector<double>&       Energies_eV,
+                                         std::vector<double>&       Brightness,
+                                         int                 const  NThreads) const
+{
+  // On-axis theoretical photon energy and brightness for a planar
+  // undulator for every combination of harmonic and K.  Results are
+  // stored harmonic-major: Brightness[iHarmonic * K.size() + iK].
+  // Even harmonics give zero for both.
 
+  std::vector<double> Flux;
+  this->UndulatorTuningCurves(K, Harmonics, Period, NPeriods, Energies_eV, Flux, Brightness, true, NThreads);
 
-TVector2D OSCARSTH::UndulatorBrightnessB (double const BField,
-                                          double const Period,
-                                          int    const NPeriods,
-                                          int    const Harmonic
-                                          ) const
+  return;
+}
+
+
+
+
+void OSCARSTH::UndulatorTuningCurves (std::vector<double> const& K,
+                                      std::vector<int>    const& Harmonics,
+                                      double              const  Period,
+                                      int                 const  NPeriods,
+                                      std::vector<double>&       Energies_eV,
+                                      std::vector<double>&       Flux,
+                                      std::vector<double>&       Brightness,
+                                      bool                const  WithBrightness,
+                                      int                 const  NThreads) const
 {
-  // Return the on-axis theoretical brightness for a planar undulator
+  // Tuning curves for a planar undulator: on-axis photon energy, on-axis
+  // flux [photons/s/mrad^2/0.1%bw], and optionally brightness for every
+  // combination of harmonic and K.  Results are stored harmonic-major:
+  // Flux[iHarmonic * K.size() + iK].  Even harmonics give zero.  The
+  // Bessel functions are shared between flux and brightness and both
+  // orders needed come from a single recurrence.  If WithBrightness is
+  // false Brightness is left empty.
+  //
+  // The Bessel argument is N K^2 / (4 (1 + K^2 / 2)).  The K dependent
+  // part and 1 + K^2 / 2 are calculated once per K and shared by all
+  // harmonics, only the multiplication by N is done per point.  The
+  // sequence itself depends on N through the argument and is evaluated
+  // per point.
+
+  // Harmonic numbers start at 1
+  for (size_t i = 0; i != Harmonics.size(); ++i) {
+    if (Harmonics[i] < 1) {
+      throw std::out_of_range("harmonic must be >= 1");
+    }
+  }
 
-  return UndulatorBrightnessK(this->UndulatorK(BField, Period), Period, NPeriods, Harmonic);
+  // Check that we can do this calculation, else reject
+  if (fParticleBeam.GetGamma() == 0) {
+    throw std::invalid_argument("Beam definition incorrect for this calculation: Check energy");
+  }
+  if (WithBrightness) {
+    TVector2D const Beta      = fParticleBeam.GetTwissBeta();
+    TVector2D const Emittance = fParticleBeam.GetEmittance();
+    if (Beta[0] == 0 || Beta[1] == 0 || Emittance[0] == 0 || Emittance[1] == 0 || fParticleBeam.GetCurrent() == 0) {
+      throw std::invalid_argument("Beam definition incorrect for this calculation: Check energy, current, beta, emittance");
+    }
+  }
+
+  size_t const NPoints = K.size() * Harmonics.size();
+  Energies_eV.assign(NPoints, 0);
+  Flux.assign(NPoints, 0);
+  Brightness.assign(WithBrightness ? NPoints : 0, 0);
+  if (NPoints == 0) {
+    return;
+  }
+
+  // Quantities depending only on K, shared by all harmonics
+  std::vector<double> KFactor(K.size());
+  std::vector<double> BesselArg(K.size());
+  for (size_t i = 0; i != K.size(); ++i) {
+    double const K2 = K[i] * K[i];
+    KFactor[i]   = 1. + K2 / 2.;
+    BesselArg[i] = K2 / (4 * KFactor[i]);
+  }
+
+  // Number of threads to use, never more than one per point
+  size_t const NThreadsToUse = (size_t) this->GetNThreadsToUse(NThreads);
+  size_t const NThreadsActual = NPoints > NThreadsToUse ? NThreadsToUse : NPoints;
+
+  if (NThreadsActual == 1) {
+    this->UndulatorTuningCurvesPoints(K, KFactor, BesselArg, Harmonics, Period, NPeriods, Energies_eV, Flux, Brightness, WithBrightness, 0, NPoints - 1);
+    return;
+  }
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Each thread writes only its own range of the outputs
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&OSCARSTH::UndulatorTuningCurvesPoints,
+                                  this,
+                                  std::cref(K),
+                                  std::cref(KFactor),
+                                  std::cref(BesselArg),
+                                  std::cref(Harmonics),
+                                  Period,
+                                  NPeriods,
+                                  std::ref(Energies_eV),
+                                  std::ref(Flux),
+                                  std::ref(Brightness),
+                                  WithBrightness,
+                                  iFirst,
+                                  iLast));
+  }
+
+  for (size_t it = 0; it != Threads.size(); ++it) {
+    Threads[it].join();
+  }
+
+  return;
 }
 
 
 
 
+void OSCARSTH::UndulatorTuningCurvesPoints (std::vector<double> const& K,
+                                            std::vector<double> const& KFactor,
+                                            std::vector<double> const& BesselArg,
+                                            std::vector<int>    const& Harmonics,
+                                            double              const  Period,
+                                            int                 const  NPeriods,
+                                            std::vector<double>&       Energies_eV,
+                                            std::vector<double>&       Flux,
+                                            std::vector<double>&       Brightness,
+                                            bool                const  WithBrightness,
+                                            size_t              const  iFirst,
+                                            size_t              const  iLast) const
+{
+  // Tuning curves for the flat indices iFirst to iLast inclusive with the
+  // beam sizes and divergences calculated once.  KFactor and BesselArg
+  // hold 1 + K^2 / 2 and K^2 / (4 (1 + K^2 / 2)) for each K
+
+  // Properties from beam
+  double    const Gamma          = fParticleBeam.GetGamma();
+  TVector2D const Beta           = fParticleBeam.GetTwissBeta();
+  TVector2D const Emittance      = fParticleBeam.GetEmittance();
+  double    const Current        = fParticleBeam.GetCurrent();
+
+  double const sigx  = WithBrightness ? sqrt(Emittance[0] * Beta[0]) : 0;
+  double const sigy  = WithBrightness ? sqrt(Emittance[1] * Beta[1]) : 0;
+  double const sigxp = WithBrightness ? sqrt(Emittance[0] / Beta[0]) : 0;
+  double const sigyp = WithBrightness ? sqrt(Emittance[1] / Beta[1]) : 0;
+
+  // Flux [photons/s/mrad^2/0.1%bw] and brightness constants
+  double const CF = TOSCARSSR::Alpha() * Current / TOSCARSSR::Qe() * NPeriods * NPeriods * Gamma * Gamma * 1e-9;
+  double const C0 = TOSCARSSR::Pi() * TOSCARSSR::Alpha() * NPeriods * 0.001 * Current / TOSCARSSR::Qe();
+  double const C1 = 4 * TOSCARSSR::Pi2();
+
+  size_t const NK = K.size();
+
+  // Bessel values for orders 0 to (N + 1) / 2 of the highest harmonic here
+  int MaxOrder = 0;
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    MaxOrder = std::max(MaxOrder, (Harmonics[i / NK] + 1) / 2);
+  }
+  std::vector<double> J(MaxOrder + 1);
+
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    int    const N  = Harmonics[i / NK];
+    size_t const iK = i % NK;
+    double const K2 = K[iK] * K[iK];
+
+    if (N % 2 == 0) {
+      continue;
+    }
+
+    double const Lambda = Period / (2 * Gamma * Gamma) * KFactor[iK] / (double) N;
+    Energies_eV[i] = TOSCARSSR::FrequencyToEv(TOSCARSSR::C() / Lambda);
+
+    // Both orders from one recurrence
+    TOMATH::BesselJ_Sequence((N + 1) / 2, N * BesselArg[iK], &J[0]);
+
+    double const Fn = K2 * N * N / (KFactor[iK] * KFactor[iK]) * pow(J[(N - 1) / 2] - J[(N + 1) / 2], 2);
+
+    Flux[i] = CF * Fn;
+
+    if (!WithBrightness) {
+      continue;
+    }
+
+    double const Qn = KFactor[iK] * Fn / (double) N;
+
+    double const Fu = C0 * Qn;
+
+    double const sigr = 1 / TOSCARSSR::FourPi() * sqrt(Lambda * Period * NPeriods);
+    double const sigrp = sqrt(Lambda / (Period * NPeriods));
+    double const SigmaX = sqrt(sigx * sigx + sigr * sigr);
+    double const SigmaY = sqrt(sigy * sigy + sigr * sigr);
+    double const SigmaXP = sqrt(sigxp * sigxp + sigrp * sigrp);
+    double const SigmaYP = sqrt(sigyp * sigyp + sigrp * sigrp);
+
+    Brightness[i] = Fu / (C1 * SigmaX * SigmaY * SigmaXP * SigmaYP) * 1.e-12;
+  }
+
+  return;
+}
+
+
 
 
 
@@ -561,8 +1346,11 @@ void OSCARSTH::WigglerFluxK (double         const  K,
     if (NThreadsToUse == 1) {
       this->WigglerFluxK(K, Period, NPeriods, Surface, Energy_eV, FluxContainer);
     } else {
-      //this->CalculateFluxThreads(fParticle,
-      //                           1);
+      std::vector<double> Flux;
+      this->WigglerFluxKEnergies(K, Period, NPeriods, Surface, std::vector<double>(1, Energy_eV), Flux, NThreadsToUse);
+      for (size_t i = 0; i != Flux.size(); ++i) {
+        FluxContainer.AddToPoint(i, Flux[i]);
+      }
     }
   } else if (UseGPU == 1) {
     //this->CalculateFluxGPU(fParticle,
@@ -610,53 +1398,157 @@ void OSCARSTH::WigglerFluxKPoints (double         const  K,
 {
   // Calculate flux for the points given in surface/flux container
 
+  std::vector<double> Flux(Surface.GetNPoints(), 0);
+  this->WigglerFluxKEnergiesPoints(K, Period, NPeriods, Surface, std::vector<double>(1, Energy_eV), Flux, iFirst, iLast);
+
+  // All point to flux container
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    FluxContainer.AddToPoint(i, Flux[i]);
+  }
+
+  // Set done to true before returnning
+  Done = true;
+
+  return;
+}
+
+
+
+
+void OSCARSTH::WigglerFluxKEnergies (double              const  K,
+                                     double              const  Period,
+                                     int                 const  NPeriods,
+                                     TSurfacePoints      const& Surface,
+                                     std::vector<double> const& Energies_eV,
+                                     std::vector<double>&       Flux,
+                                     int                 const  NThreads) const
+{
+  // Wiggler flux [photons/s/mrad^2/0.1%bw] on a surface for several photon
+  // energies at once.  Results are stored point-major:
+  // Flux[iPoint * Energies_eV.size() + iEnergy].  The points are split over
+  // threads, each evaluating all energies for its points.
+
+  size_t const NPoints = Surface.GetNPoints();
+  Flux.assign(NPoints * Energies_eV.size(), 0);
+  if (Flux.size() == 0) {
+    return;
+  }
+
+  // Number of threads to use, never more than one per point
+  size_t const NThreadsToUse = (size_t) this->GetNThreadsToUse(NThreads);
+  size_t const NThreadsActual = NPoints > NThreadsToUse ? NThreadsToUse : NPoints;
+
+  if (NThreadsActual == 1) {
+    this->WigglerFluxKEnergiesPoints(K, Period, NPeriods, Surface, Energies_eV, Flux, 0, NPoints - 1);
+    return;
+  }
+
+  // Number per thread plus remainder to be added to first threads
+  size_t const NPerThread = NPoints / NThreadsActual;
+  size_t const NRemainder = NPoints % NThreadsActual;
+
+  // Each thread writes only its own range of the outputs
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&OSCARSTH::WigglerFluxKEnergiesPoints,
+                                  this,
+                                  K,
+                                  Period,
+                                  NPeriods,
+                                  std::cref(Surface),
+                                  std::cref(Energies_eV),
+                                  std::ref(Flux),
+                                  iFirst,
+                                  iLast));
+  }
+
+  for (size_t it = 0; it != Threads.size(); ++it) {
+    Threads[it].join();
+  }
+
+  return;
+}
+
+
+
+
+void OSCARSTH::WigglerFluxKEnergiesPoints (double              const  K,
+                                           double              const  Period,
+                                           int                 const  NPeriods,
+                                           TSurfacePoints      const& Surface,
+                                           std::vector<double> const& Energies_eV,
+                                           std::vector<double>&       Flux,
+                                           size_t              const  iFirst,
+                                           size_t              const  iLast) const
+{
+  // Wiggler flux for the points iFirst to iLast inclusive and all energies.
+  // The geometry of each point is calculated once and the Bessel functions
+  // for all energies are evaluated together with the array versions.
 
   double const Gamma = fParticleBeam.GetE0() / TOSCARSSR::kgToGeV( TOSCARSSR::Me());
   double const Gamma2 = Gamma*Gamma;
   double const C0 = 3. * TOSCARSSR::Qe() * TOSCARSSR::Qe() / (16. * TOSCARSSR::Pi3() * TOSCARSSR::Epsilon0() * TOSCARSSR::C()) * Gamma2;
 
   double const K2 = K * K;
+  double const omega_c0 = TOSCARSSR::TwoPi() * TOSCARSSR::C() * 2. * Gamma2 / Period;
+
+  // Energy dependent quantities and work space
+  size_t const NE = Energies_eV.size();
+  std::vector<double> Omega(NE);
+  for (size_t ie = 0; ie != NE; ++ie) {
+    Omega[ie] = TOSCARSSR::EvToAngularFrequency(Energies_eV[ie]);
+  }
+  std::vector<double> Xi(NE);
+  std::vector<double> K_1_3(NE);
+  std::vector<double> K_2_3(NE);
 
   // Loop over all points in the surface container
   for (size_t i = iFirst; i <= iLast; ++i) {
 
     // Obs point
-    TVector3D const& ObservationPoint = Surface.GetPoint(i).GetPoint();
+    TVector3D const ObservationPoint = Surface.GetPoint(i).GetPoint();
     double const X0 = ObservationPoint.GetX();
     double const Y0 = ObservationPoint.GetY();
     double const Z0 = ObservationPoint.GetZ();
     double const ThetaX = atan2(X0, Z0);
     double const ThetaY = atan2(Y0, sqrt(Z0*Z0 + X0*X0));
 
-    double const omega = TOSCARSSR::EvToAngularFrequency(Energy_eV);
     double const omega1 = TOSCARSSR::TwoPi() * TOSCARSSR::C() / Period * 2. * Gamma2 / (1. + K2 / 2. + Gamma2 * pow(ObservationPoint.GetTheta(), 2));
 
     double const alpha = Gamma * ThetaX / K;
     double const A = 1. + K2 / 2. + Gamma2 *(ThetaX*ThetaX + ThetaY*ThetaY);
-    double const Delta = omega / omega1 * (TOSCARSSR::Pi() + 2. * asin(alpha) + 3. * K2 / A * alpha * sqrt(1. - alpha*alpha));
+    double const Phase = TOSCARSSR::Pi() + 2. * asin(alpha) + 3. * K2 / A * alpha * sqrt(1. - alpha*alpha);
 
-    double const omega_c0 = TOSCARSSR::TwoPi() * TOSCARSSR::C() * 2. * Gamma2 / Period;
     double const omega_c = omega_c0 * sqrt(1. - alpha*alpha);
-    double const y = omega / omega_c;
     double const X = Gamma * ThetaY;
-    double const Xi = 0.5 * y * pow(1. + X*X, 1.5);
+    double const X2Factor = X*X/(1. + X*X);
+    double const XiFactor = pow(1. + X*X, 1.5);
+    double const YFactor  = pow(1. + X*X, 2);
+
+    for (size_t ie = 0; ie != NE; ++ie) {
+      Xi[ie] = 0.5 * (Omega[ie] / omega_c) * XiFactor;
+    }
+    TOMATH::BesselK_1_3(&Xi[0], &K_1_3[0], NE);
+    TOMATH::BesselK_2_3(&Xi[0], &K_2_3[0], NE);
 
-    double const SinFactor = pow(sin(NPeriods * TOSCARSSR::Pi() * omega / omega1), 2) / pow(sin(TOSCARSSR::Pi() * omega / omega1), 2);
+    for (size_t ie = 0; ie != NE; ++ie) {
+      double const omega = Omega[ie];
+      double const y = omega / omega_c;
+      double const Delta = omega / omega1 * Phase;
 
-    double const AxMag2 = 4. * pow(sin(Delta/2.), 2) * pow(TOMATH::BesselK(2./3., Xi), 2) * SinFactor;
-    double const AyMag2 = 4. * pow(cos(Delta/2.), 2) * X*X/(1. + X*X) * pow(TOMATH::BesselK(1./3., Xi), 2) * SinFactor;
+      double const SinFactor = pow(sin(NPeriods * TOSCARSSR::Pi() * omega / omega1), 2) / pow(sin(TOSCARSSR::Pi() * omega / omega1), 2);
 
-    // Flux in terms of intensity per rad^2 ==> nphotons / mrad^2 / s / 0.1%bw
-    //double const ThisFlux = C0 * y*y * pow(1. + X*X, 2) * AxMag2;
-    double const ThisFlux = C0 * y*y * pow(1. + X*X, 2) * (AxMag2 + AyMag2);
+      double const AxMag2 = 4. * pow(sin(Delta/2.), 2) * pow(K_2_3[ie], 2) * SinFactor;
+      double const AyMag2 = 4. * pow(cos(Delta/2.), 2) * X2Factor * pow(K_1_3[ie], 2) * SinFactor;
 
-    // All point to flux container
-    FluxContainer.AddToPoint(i, ThisFlux);
+      // Flux in terms of intensity per rad^2 ==> nphotons / mrad^2 / s / 0.1%bw
+      Flux[i * NE + ie] = C0 * y*y * YFactor * (AxMag2 + AyMag2);
+    }
   }
 
-  // Set done to true before returnning
-  Done = true;
-
   return;
 }
 
@@ -691,8 +1583,17 @@ TParticleBeam& OSCARSTH::SetParticleBeam (double const Energy_GeV,
 
   fParticleBeam = TParticleBeam("electron", Name, Energy_GeV, Current);
   fParticleBeam.SetWeight(1);
+
+  // Direction and speed along z as for predefined beams, sets gamma
+  double const Gamma = fParticleBeam.GetE0() / TOSCARSSR::kgToGeV(fParticleBeam.GetM());
+  fParticleBeam.SetU0(TVector3D(0, 0, 1));
+  fParticleBeam.SetB0(fParticleBeam.GetU0() * sqrt(1.0 - 1.0 / (Gamma * Gamma)));
+  fParticleBeam.SetT0(0);
+  fParticleBeam.SetX0(TVector3D(0, 0, 0));
   fParticleBeam.SetEmittance(Emittance);
-  fParticleBeam.SetTwissBetaAlpha(Beta, TVector2D(0, 0));
+  if (Beta[0] != 0 || Beta[1] != 0) {
+    fParticleBeam.SetTwissBetaAlpha(Beta, TVector2D(0, 0));
+  }
   fParticleBeam.SetSigmaEnergyGeV(SigmaEnergyGeV);
   fParticleBeam.SetEta(Eta);
 
@@ -783,3 +1684,17 @@ void OSCARSTH::SetNThreadsGlobal (int const N)
 
 
 
+int OSCARSTH::GetNThreadsToUse (int const NThreads) const
+{
+  // Number of threads to use for a calculation, NThreads < 1 means use the global setting
+  int const NThreadsToUse = NThreads < 1 ? fNThreadsGlobal : NThreads;
+  if (NThreadsToUse <= 0) {
+    throw std::out_of_range("NThreads or NThreadsGlobal must be >= 1");
+  }
+
+  return NThreadsToUse;
+}
+
+
+
+
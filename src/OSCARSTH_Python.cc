@@ -247,7 +247,7 @@ static PyObject* OSCARSTH_UndulatorPeriod (OSCARSTHObject* self, PyObject* args,
 
 
 const char* DOC_OSCARSTH_DipoleSpectrum = R"docstring(
-dipole_spectrum(bfield [, energy_range_eV, energy_points_eV, energy_eV, angle_integrated, angle_range, angle_points, angle, npoints, minimum, ofile, bofile])
+dipole_spectrum(bfield [, energy_range_eV, energy_points_eV, energy_eV, angle_integrated, angle_range, angle_points, angle, npoints, minimum, ofile, bofile, nthreads])
 
 Get the spectrum from ideal dipole field.  One can calculate the spectrum as a function of photon energy at a given angle or the angular dependence for a particular energy.
 
@@ -286,6 +286,9 @@ ofile : str
 bofile : str
     Binary output file name
 
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
 Returns
 -------
 flux : list
@@ -322,6 +325,7 @@ static PyObject* OSCARSTH_DipoleSpectrum (OSCARSTHObject* self, PyObject* args,
   int         NPoints              = 0;
   const char* OutFileNameText      = "";
   const char* OutFileNameBinary    = "";
+  int         NThreads             = 0;
 
   // Input variable list
   static const char *kwlist[] = {"bfield",
@@ -335,10 +339,11 @@ static PyObject* OSCARSTH_DipoleSpectrum (OSCARSTHObject* self, PyObject* args,
                                  "npoints",
                                  "ofile",
                                  "bofile",
+                                 "nthreads",
                                  NULL};
 
   // Parse inputs
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "d|OOdpOOdiss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "d|OOdpOOdissi",
                                    const_cast<char **>(kwlist),
                                    &BField,
                                    &List_EnergyRange_eV,
@@ -350,7 +355,8 @@ static PyObject* OSCARSTH_DipoleSpectrum (OSCARSTHObject* self, PyObject* args,
                                    &Angle,
                                    &NPoints,
                                    &OutFileNameText,
-                                   &OutFileNameBinary)) {
+                                   &OutFileNameBinary,
+                                   &NThreads)) {
     return NULL;
   }
 
@@ -395,31 +401,45 @@ static PyObject* OSCARSTH_DipoleSpectrum (OSCARSTHObject* self, PyObject* args,
   }
 
   // Select on inputs and calculate
-  if (PyList_Size(List_EnergyRange_eV) != 0 && NPoints > 0) {
-    TVector2D const EnergyRange_eV = OSCARSPY::ListAsTVector2D(List_EnergyRange_eV);
-    SpectrumContainer.Init(NPoints, EnergyRange_eV[0], EnergyRange_eV[1]);
-    if (AngleIntegrated) {
-      self->obj->DipoleSpectrumEnergyAngleIntegrated(BField, SpectrumContainer);
-    } else {
-      self->obj->DipoleSpectrumEnergy(BField, SpectrumContainer, Angle);
-    }
-  } else if (PyList_Size(List_EnergyPoints_eV) != 0) {
-    SpectrumContainer.Init(VEnergyPoints_eV);
-  } else if (PyList_Size(List_AngleRange) != 0 && NPoints > 0) {
-    TVector2D const AngleRange = OSCARSPY::ListAsTVector2D(List_AngleRange);
-    SpectrumContainer.Init(NPoints, AngleRange[0], AngleRange[1]);
-    self->obj->DipoleSpectrumAngle(BField, SpectrumContainer, Energy_eV);
-  } else if (PyList_Size(List_AnglePoints) != 0 && Energy_eV > 0) {
-    SpectrumContainer.Init(VAnglePoints);
-  } else if (Energy_eV > 0 && (NPoints == 0 || NPoints == 1)) {
-    SpectrumContainer.Init(1, Energy_eV, Energy_eV);
-    if (AngleIntegrated) {
-      self->obj->DipoleSpectrumEnergyAngleIntegrated(BField, SpectrumContainer);
+  try {
+    if (PyList_Size(List_EnergyRange_eV) != 0 && NPoints > 0) {
+      TVector2D const EnergyRange_eV = OSCARSPY::ListAsTVector2D(List_EnergyRange_eV);
+      SpectrumContainer.Init(NPoints, EnergyRange_eV[0], EnergyRange_eV[1]);
+      if (AngleIntegrated) {
+        self->obj->DipoleSpectrumEnergyAngleIntegrated(BField, SpectrumContainer);
+      } else {
+        self->obj->DipoleSpectrumEnergy(BField, SpectrumContainer, Angle, NThreads);
+      }
+    } else if (PyList_Size(List_EnergyPoints_eV) != 0) {
+      SpectrumContainer.Init(VEnergyPoints_eV);
+      if (AngleIntegrated) {
+        self->obj->DipoleSpectrumEnergyAngleIntegrated(BField, SpectrumContainer);
+      } else {
+        self->obj->DipoleSpectrumEnergy(BField, SpectrumContainer, Angle, NThreads);
+      }
+    } else if (PyList_Size(List_AngleRange) != 0 && NPoints > 0) {
+      TVector2D const AngleRange = OSCARSPY::ListAsTVector2D(List_AngleRange);
+      SpectrumContainer.Init(NPoints, AngleRange[0], AngleRange[1]);
+      self->obj->DipoleSpectrumAngle(BField, SpectrumContainer, Energy_eV, NThreads);
+    } else if (PyList_Size(List_AnglePoints) != 0 && Energy_eV > 0) {
+      SpectrumContainer.Init(VAnglePoints);
+      self->obj->DipoleSpectrumAngle(BField, SpectrumContainer, Energy_eV, NThreads);
+    } else if (Energy_eV > 0 && (NPoints == 0 || NPoints == 1)) {
+      SpectrumContainer.Init(1, Energy_eV, Energy_eV);
+      if (AngleIntegrated) {
+        self->obj->DipoleSpectrumEnergyAngleIntegrated(BField, SpectrumContainer);
+      } else {
+        self->obj->DipoleSpectrumEnergy(BField, SpectrumContainer, Angle, NThreads);
+      }
     } else {
-      self->obj->DipoleSpectrumEnergy(BField, SpectrumContainer, Angle);
+      PyErr_SetString(PyExc_ValueError, "Incorrect combination of or missing input parameters.  Please see documentation for this function");
+      return NULL;
     }
-  } else {
-    PyErr_SetString(PyExc_ValueError, "Incorrect combination of or missing input parameters.  Please see documentation for this function");
+  } catch (std::length_error e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'energy_range_eV' or 'angle_range'");
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
   }
 
@@ -464,6 +484,109 @@ static PyObject* OSCARSTH_DipoleSpectrum (OSCARSTHObject* self, PyObject* args,
 
 
 
+const char* DOC_OSCARSTH_DipoleSpectrumGrid = R"docstring(
+dipole_spectrum_grid(bfield, energies_eV, angles [, nthreads])
+
+Get the spectrum from ideal dipole field for every combination of vertical angle and photon energy.  Quantities depending only on the beam and field are calculated once and the grid is split over threads.
+
+Parameters
+----------
+bfield : float
+    Magnetic field of the dipole in [T]
+
+energies_eV : list
+    Photon energies in [eV].  Any sequence of numbers, including a numpy array
+
+angles : list
+    Vertical angles in [rad].  Any sequence of numbers, including a numpy array
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+Returns
+-------
+flux : memoryview
+    2D array of doubles of shape (len(angles), len(energies_eV)) in [photons / s / mrad^2 / 0.1\%bw].  Use numpy.asarray() to get a numpy array without a copy, or .tolist() for nested lists
+
+Examples
+--------
+Calculate the spectrum for 1000 energies at 101 vertical angles
+
+    >>> import numpy as np
+    >>> flux = np.asarray(oth.dipole_spectrum_grid(bfield=0.4, energies_eV=np.linspace(10, 30000, 1000), angles=np.linspace(-0.0005, 0.0005, 101)))
+)docstring";
+static PyObject* OSCARSTH_DipoleSpectrumGrid (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return the dipole flux on an angle x energy grid
+
+  double    BField       = 0;
+  PyObject* Seq_Energies = 0x0;
+  PyObject* Seq_Angles   = 0x0;
+  int       NThreads     = 0;
+
+  // Input variable list
+  static const char *kwlist[] = {"bfield",
+                                 "energies_eV",
+                                 "angles",
+                                 "nthreads",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dOO|i",
+                                   const_cast<char **>(kwlist),
+                                   &BField,
+                                   &Seq_Energies,
+                                   &Seq_Angles,
+                                   &NThreads)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Must have a bfield
+  if (fabs(BField) == 0) {
+    PyErr_SetString(PyExc_ValueError, "'bfield' must not be zero");
+    return NULL;
+  }
+
+  std::vector<double> Energies_eV;
+  std::vector<double> Angles;
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_Energies, Energies_eV);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'energies_eV'");
+    return NULL;
+  }
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_Angles, Angles);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'angles'");
+    return NULL;
+  }
+  if (Energies_eV.size() == 0 || Angles.size() == 0) {
+    PyErr_SetString(PyExc_ValueError, "'energies_eV' and 'angles' must not be empty");
+    return NULL;
+  }
+
+  std::vector<double> Flux;
+  try {
+    self->obj->DipoleSpectrumGrid(BField, Energies_eV, Angles, Flux, NThreads);
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  return OSCARSPY::VectorAsMemoryView(Flux, Angles.size(), Energies_eV.size());
+}
+
+
+
+
+
 /*
 const char* DOC_OSCARSTH_DipoleSpectrumPoint = "Get the spectrum from ideal dipole field.";
 static PyObject* OSCARSTH_DipoleSpectrumPoint (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
@@ -610,7 +733,33 @@ static PyObject* OSCARSTH_DipoleCriticalWavelength (OSCARSTHObject* self, PyObje
 
 
 
-const char* DOC_OSCARSTH_DipoleBrightness = "Not Implemented";
+const char* DOC_OSCARSTH_DipoleBrightness = R"docstring(
+dipole_brightness(bfield [, energy_eV, energy_range_eV, npoints, nthreads])
+
+Get the brightness from an ideal dipole field as a function of photon energy.  You must have previously defined a beam, including the beta and emittance values.
+
+Parameters
+----------
+bfield : float
+    Magnetic field of the dipole in [T]
+
+energy_eV : float
+    Photon energy of interest
+
+energy_range_eV : list
+    [min, max] photon energy of interest in [eV]
+
+npoints : int
+    Number of points for energy_range_eV
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+Returns
+-------
+brightness : list
+    A list of brightness values for given points [[e0, b0], [e1, b1], ...]
+)docstring";
 static PyObject* OSCARSTH_DipoleBrightness (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
 {
   // Return a list of points corresponding to the flux in a given energy range for a given vertical angle.
@@ -621,19 +770,22 @@ static PyObject* OSCARSTH_DipoleBrightness (OSCARSTHObject* self, PyObject* args
   double Energy_eV = 0;
   PyObject* List_EnergyRange_eV = 0x0;
   int    NPoints = 0;
+  int    NThreads = 0;
 
   // Input variables and parsing
   static const char *kwlist[] = {"bfield",
                                  "energy_eV",
                                  "energy_range_eV",
                                  "npoints",
+                                 "nthreads",
                                  NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "d|dOi",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "d|dOii",
                                                  const_cast<char **>(kwlist),
                                                  &BField,
                                                  &Energy_eV,
                                                  &List_EnergyRange_eV,
-                                                 &NPoints)) {
+                                                 &NPoints,
+                                                 &NThreads)) {
     return NULL;
   }
 
@@ -656,7 +808,12 @@ static PyObject* OSCARSTH_DipoleBrightness (OSCARSTHObject* self, PyObject* args
   }
 
 
-  self->obj->DipoleBrightness(BField, SpectrumContainer);
+  try {
+    self->obj->DipoleBrightness(BField, SpectrumContainer, NThreads);
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
 
   // Return the spectrum
   return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
@@ -911,7 +1068,7 @@ static PyObject* OSCARSTH_UndulatorFluxOnAxis (OSCARSTHObject* self, PyObject* a
 
 
 const char* DOC_OSCARSTH_UndulatorBrightness = R"docstring(
-undulator_brightness(period, nperiods, harmonic, [, bfield_range, K_range, npoints, bfield_points, K_points, minimum, ofile, bofile])
+undulator_brightness(period, nperiods, harmonic, [, bfield_range, K_range, npoints, bfield_points, K_points, minimum, ofile, bofile, nthreads])
 
 Get the brightness for an ideal undulator given K for a specific harmonic.  Should specify either K or bfield, but not both.  You must have previously defined a beam, including the beta and emittance values.
 
@@ -950,6 +1107,9 @@ ofile : str
 bofile : str
     Binary output file name
 
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
 Returns
 -------
 [energy_eV, brightness]s : list[[float, float], ...]
@@ -981,33 +1141,1193 @@ static PyObject* OSCARSTH_UndulatorBrightness (OSCARSTHObject* self, PyObject* a
   double      Minimum           = 0;
   const char* OutFileNameText   = "";
   const char* OutFileNameBinary = "";
+  int         NThreads          = 0;
+
+  // Input variable list
+  static const char *kwlist[] = {"period",
+                                 "nperiods",
+                                 "harmonic",
+                                 "bfield_range",
+                                 "K_range",
+                                 "npoints",
+                                 "bfield_points",
+                                 "K_points",
+                                 "minimum",
+                                 "ofile",
+                                 "bofile",
+                                 "nthreads",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dii|OOiOOdssi",
+                                   const_cast<char **>(kwlist),
+                                   &Period,
+                                   &NPeriods,
+                                   &Harmonic,
+                                   &List_BFieldRange,
+                                   &List_KRange,
+                                   &NPoints,
+                                   &List_BFieldPoints,
+                                   &List_KPoints,
+                                   &Minimum,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary,
+                                   &NThreads)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Check harmonic number is > 0
+  if (Harmonic <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'harmonic' must be > 0");
+    return NULL;
+  }
+
+  // Check period
+  if (Period <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
+    return NULL;
+  }
+
+  // Check nperiods
+  if (NPeriods <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'nperiod' must be > 0");
+    return NULL;
+  }
+
+  // Check not overlapping definitions
+  int const SizeSumLists =  PyList_Size(List_BFieldRange)
+                            + PyList_Size(List_KRange)
+                            + PyList_Size(List_BFieldPoints)
+                            + PyList_Size(List_KPoints);
+  if (!(PyList_Size(List_BFieldRange)  == SizeSumLists ||
+        PyList_Size(List_KRange)       == SizeSumLists ||
+        PyList_Size(List_BFieldPoints) == SizeSumLists ||
+        PyList_Size(List_KPoints)      == SizeSumLists)) {
+    PyErr_SetString(PyExc_ValueError, "May only specify one of: 'bfield_range', 'K_range', 'bfield_points', 'K_points'");
+    return NULL;
+  }
+
+  // Container for spectrum
+  TSpectrumContainer SpectrumContainer;
+
+  TVector2D Range;
+  std::vector<double> Points;
+
+  // K values for all requested points
+  std::vector<double> KPoints;
+
+  // Init container based on inputs
+  if (PyList_Size(List_BFieldRange) > 0 && NPoints > 1) {
+    try {
+      Range = OSCARSPY::ListAsTVector2D(List_BFieldRange);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield_range'");
+      return NULL;
+    }
+
+    // Add each point
+    for (int i = 0; i < NPoints; ++i) {
+      double BField = Range[0] + (Range[1] - Range[0]) / (double) (NPoints - 1) * (double) i;
+      KPoints.push_back(self->obj->UndulatorK(BField, Period));
+    }
+
+  } else if (PyList_Size(List_KRange) > 0 && NPoints > 1) {
+    try {
+      Range = OSCARSPY::ListAsTVector2D(List_KRange);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'K_range'");
+      return NULL;
+    }
+
+    // Add each point
+    for (int i = 0; i < NPoints; ++i) {
+      KPoints.push_back(Range[0] + (Range[1] - Range[0]) / (double) (NPoints - 1) * (double) i);
+    }
+
+  } else if (PyList_Size(List_BFieldPoints) > 0) {
+    for (int i = 0; i < PyList_Size(List_BFieldPoints); ++i) {
+      Points.push_back(PyFloat_AsDouble(PyList_GetItem(List_BFieldPoints, i)));
+    }
+
+    // Add each point
+    for (size_t i = 0; i < Points.size(); ++i) {
+      KPoints.push_back(self->obj->UndulatorK(Points[i], Period));
+    }
+
+  } else if (PyList_Size(List_KPoints) > 0) {
+    for (int i = 0; i < PyList_Size(List_KPoints); ++i) {
+      KPoints.push_back(PyFloat_AsDouble(PyList_GetItem(List_KPoints, i)));
+    }
+
+  } else {
+    PyErr_SetString(PyExc_ValueError, "Incorrect input format in input, possibly check that npoints > 1?");
+    return NULL;
+  }
+
+  // Calculate all points at once
+  std::vector<double> Energies_eV;
+  std::vector<double> Brightness;
+  try {
+    self->obj->UndulatorBrightnessKGrid(KPoints, std::vector<int>(1, Harmonic), Period, NPeriods, Energies_eV, Brightness, NThreads);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  for (size_t i = 0; i < KPoints.size(); ++i) {
+    if (Brightness[i] >= Minimum) {
+      SpectrumContainer.AddPoint(Energies_eV[i], Brightness[i]);
+    }
+  }
+
+  // Don't need to hold on to this any longer
+  Points.clear();
+
+  // Write to file if output is requested
+  if (std::string(OutFileNameText) != "") {
+    SpectrumContainer.WriteToFileText(OutFileNameText);
+  }
+  if (std::string(OutFileNameBinary) != "") {
+    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
+  }
+
+  // Return the spectrum
+  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
+}
+
+
+
+
+
+const char* DOC_OSCARSTH_UndulatorBrightnessGrid = R"docstring(
+undulator_brightness_grid(period, nperiods, harmonics [, K_points, bfield_points, nthreads])
+
+Get the photon energy and brightness for an ideal undulator for every combination of harmonic and K (or bfield).  Beam sizes and divergences are calculated once and the grid is split over threads.  Specify either K_points or bfield_points, but not both.  You must have previously defined a beam, including the beta and emittance values.
+
+Parameters
+----------
+period : float
+    Undulator period length [m]
+
+nperiods : int
+    Number of periods
+
+harmonics : list
+    Harmonic numbers of interest, each >= 1.  Even harmonics give zero energy and brightness
+
+K_points : list
+    K values.  Any sequence of numbers, including a numpy array
+
+bfield_points : list
+    bfield values [T].  Any sequence of numbers, including a numpy array
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+Returns
+-------
+(energy_eV, brightness) : tuple(memoryview, memoryview)
+    Photon energy [eV] and brightness [photons/s/0.1%bw/mrad^2/mm^2], each a 2D array of doubles of shape (len(harmonics), len(K_points)).  Use numpy.asarray() to get numpy arrays without a copy, or .tolist() for nested lists
+
+Examples
+--------
+Brightness tuning curves for harmonics 1 to 9 for 500 K values
+
+    >>> import numpy as np
+    >>> e, b = oth.undulator_brightness_grid(period=0.020, nperiods=150, harmonics=[1, 3, 5, 7, 9], K_points=np.linspace(0.1, 2, 500))
+    >>> e = np.asarray(e)
+    >>> b = np.asarray(b)
+)docstring";
+static PyObject* OSCARSTH_UndulatorBrightnessGrid (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return the undulator photon energy and brightness on a harmonic x K grid
+
+  double    Period            = 0;
+  int       NPeriods          = 0;
+  PyObject* Seq_Harmonics     = 0x0;
+  PyObject* Seq_KPoints       = 0x0;
+  PyObject* Seq_BFieldPoints  = 0x0;
+  int       NThreads          = 0;
+
+  // Input variable list
+  static const char *kwlist[] = {"period",
+                                 "nperiods",
+                                 "harmonics",
+                                 "K_points",
+                                 "bfield_points",
+                                 "nthreads",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "diO|OOi",
+                                   const_cast<char **>(kwlist),
+                                   &Period,
+                                   &NPeriods,
+                                   &Seq_Harmonics,
+                                   &Seq_KPoints,
+                                   &Seq_BFieldPoints,
+                                   &NThreads)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Check period
+  if (Period <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
+    return NULL;
+  }
+
+  // Check nperiods
+  if (NPeriods <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'nperiod' must be > 0");
+    return NULL;
+  }
+
+  // Check not overlapping definitions
+  if ((Seq_KPoints == 0x0) == (Seq_BFieldPoints == 0x0)) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one of: 'K_points', 'bfield_points'");
+    return NULL;
+  }
+
+  std::vector<double> HarmonicsD;
+  std::vector<double> KPoints;
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_Harmonics, HarmonicsD);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'harmonics'");
+    return NULL;
+  }
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_KPoints != 0x0 ? Seq_KPoints : Seq_BFieldPoints, KPoints);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'K_points' or 'bfield_points'");
+    return NULL;
+  }
+  if (HarmonicsD.size() == 0 || KPoints.size() == 0) {
+    PyErr_SetString(PyExc_ValueError, "'harmonics' and points must not be empty");
+    return NULL;
+  }
+
+  // Harmonic numbers must be positive integers
+  std::vector<int> Harmonics(HarmonicsD.size());
+  for (size_t i = 0; i != HarmonicsD.size(); ++i) {
+    Harmonics[i] = (int) HarmonicsD[i];
+    if (Harmonics[i] <= 0 || (double) Harmonics[i] != HarmonicsD[i]) {
+      PyErr_SetString(PyExc_ValueError, "'harmonics' must be integers > 0");
+      return NULL;
+    }
+  }
+
+  // Convert bfield to K if needed
+  if (Seq_BFieldPoints != 0x0) {
+    for (size_t i = 0; i != KPoints.size(); ++i) {
+      KPoints[i] = self->obj->UndulatorK(KPoints[i], Period);
+    }
+  }
+
+  std::vector<double> Energies_eV;
+  std::vector<double> Brightness;
+  try {
+    self->obj->UndulatorBrightnessKGrid(KPoints, Harmonics, Period, NPeriods, Energies_eV, Brightness, NThreads);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  PyObject* PyEnergies = OSCARSPY::VectorAsMemoryView(Energies_eV, Harmonics.size(), KPoints.size());
+  if (PyEnergies == NULL) {
+    return NULL;
+  }
+  PyObject* PyBrightness = OSCARSPY::VectorAsMemoryView(Brightness, Harmonics.size(), KPoints.size());
+  if (PyBrightness == NULL) {
+    Py_DECREF(PyEnergies);
+    return NULL;
+  }
+
+  // Tuple steals the references
+  PyObject* Result = PyTuple_New(2);
+  PyTuple_SET_ITEM(Result, 0, PyEnergies);
+  PyTuple_SET_ITEM(Result, 1, PyBrightness);
+
+  return Result;
+}
+
+
+
+
+
+const char* DOC_OSCARSTH_UndulatorTuningCurves = R"docstring(
+undulator_tuning_curves(period, nperiods, harmonics [, K_points, bfield_points, gap_points, gap_model, brightness, nthreads])
+
+Get the tuning curves of an ideal planar undulator in one call: the on-axis photon energy, the on-axis flux, and optionally the brightness for every combination of harmonic and K (or bfield, or gap).  The grid is split over threads and the Bessel functions are calculated once per point for both flux and brightness.  Specify exactly one of K_points, bfield_points, or gap_points.  For gap_points the peak field is B = a exp(b (gap/period) + c (gap/period)^2) with gap_model=[a, b, c] (or [a, b]).  You must have previously defined a beam, including the beta and emittance values if brightness is requested.
+
+Parameters
+----------
+period : float
+    Undulator period length [m]
+
+nperiods : int
+    Number of periods
+
+harmonics : list
+    Harmonic numbers of interest, each >= 1.  Even harmonics give zero
+
+K_points : list
+    K values.  Any sequence of numbers, including a numpy array
+
+bfield_points : list
+    bfield values [T].  Any sequence of numbers, including a numpy array
+
+gap_points : list
+    Gap values [m].  Requires gap_model
+
+gap_model : list
+    [a, b, c] coefficients of the bfield model, a in [T]
+
+brightness : bool
+    Also calculate the brightness.  Default is False
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+Returns
+-------
+(energy_eV, flux [, brightness]) : tuple(memoryview, ...)
+    Photon energy [eV], on-axis flux [photons/s/0.1%bw/mrad^2], and brightness [photons/s/0.1%bw/mrad^2/mm^2], each a 2D array of doubles of shape (len(harmonics), len(points)).  Use numpy.asarray() to get numpy arrays without a copy, or .tolist() for nested lists
+
+Examples
+--------
+Flux and brightness tuning curves for harmonics 1 to 9 for gaps from 5 to 20 mm
+
+    >>> import numpy as np
+    >>> e, f, b = oth.undulator_tuning_curves(period=0.020, nperiods=150, harmonics=[1, 3, 5, 7, 9], gap_points=np.linspace(0.005, 0.020, 500), gap_model=[3.33, -5.47, 1.8], brightness=True)
+)docstring";
+static PyObject* OSCARSTH_UndulatorTuningCurves (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return the undulator photon energy, on-axis flux, and brightness on a harmonic x K grid
+
+  double    Period            = 0;
+  int       NPeriods          = 0;
+  PyObject* Seq_Harmonics     = 0x0;
+  PyObject* Seq_KPoints       = 0x0;
+  PyObject* Seq_BFieldPoints  = 0x0;
+  PyObject* Seq_GapPoints     = 0x0;
+  PyObject* Seq_GapModel      = 0x0;
+  int       WithBrightness    = 0;
+  int       NThreads          = 0;
+
+  // Input variable list
+  static const char *kwlist[] = {"period",
+                                 "nperiods",
+                                 "harmonics",
+                                 "K_points",
+                                 "bfield_points",
+                                 "gap_points",
+                                 "gap_model",
+                                 "brightness",
+                                 "nthreads",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "diO|OOOOii",
+                                   const_cast<char **>(kwlist),
+                                   &Period,
+                                   &NPeriods,
+                                   &Seq_Harmonics,
+                                   &Seq_KPoints,
+                                   &Seq_BFieldPoints,
+                                   &Seq_GapPoints,
+                                   &Seq_GapModel,
+                                   &WithBrightness,
+                                   &NThreads)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Check period
+  if (Period <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
+    return NULL;
+  }
+
+  // Check nperiods
+  if (NPeriods <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'nperiod' must be > 0");
+    return NULL;
+  }
+
+  // Check not overlapping definitions
+  if ((Seq_KPoints != 0x0) + (Seq_BFieldPoints != 0x0) + (Seq_GapPoints != 0x0) != 1) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one of: 'K_points', 'bfield_points', 'gap_points'");
+    return NULL;
+  }
+  if ((Seq_GapPoints != 0x0) != (Seq_GapModel != 0x0)) {
+    PyErr_SetString(PyExc_ValueError, "'gap_points' and 'gap_model' must be used together");
+    return NULL;
+  }
+
+  std::vector<double> HarmonicsD;
+  std::vector<double> KPoints;
+  std::vector<double> GapModel;
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_Harmonics, HarmonicsD);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'harmonics'");
+    return NULL;
+  }
+  try {
+    OSCARSPY::SequenceToVectorDouble(Seq_KPoints != 0x0 ? Seq_KPoints : Seq_BFieldPoints != 0x0 ? Seq_BFieldPoints : Seq_GapPoints, KPoints);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, "Incorrect format in 'K_points', 'bfield_points', or 'gap_points'");
+    return NULL;
+  }
+  if (Seq_GapModel != 0x0) {
+    try {
+      OSCARSPY::SequenceToVectorDouble(Seq_GapModel, GapModel);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'gap_model'");
+      return NULL;
+    }
+    if (GapModel.size() == 2) {
+      GapModel.push_back(0);
+    }
+    if (GapModel.size() != 3) {
+      PyErr_SetString(PyExc_ValueError, "'gap_model' must be [a, b] or [a, b, c]");
+      return NULL;
+    }
+  }
+  if (HarmonicsD.size() == 0 || KPoints.size() == 0) {
+    PyErr_SetString(PyExc_ValueError, "'harmonics' and points must not be empty");
+    return NULL;
+  }
+
+  // Harmonic numbers must be positive integers
+  std::vector<int> Harmonics(HarmonicsD.size());
+  for (size_t i = 0; i != HarmonicsD.size(); ++i) {
+    Harmonics[i] = (int) HarmonicsD[i];
+    if (Harmonics[i] <= 0 || (double) Harmonics[i] != HarmonicsD[i]) {
+      PyErr_SetString(PyExc_ValueError, "'harmonics' must be integers > 0");
+      return NULL;
+    }
+  }
+
+  // Convert gap to bfield and bfield to K if needed
+  if (Seq_GapPoints != 0x0) {
+    for (size_t i = 0; i != KPoints.size(); ++i) {
+      KPoints[i] = self->obj->UndulatorBFieldGap(KPoints[i], Period, GapModel[0], GapModel[1], GapModel[2]);
+    }
+  }
+  if (Seq_KPoints == 0x0) {
+    for (size_t i = 0; i != KPoints.size(); ++i) {
+      KPoints[i] = self->obj->UndulatorK(KPoints[i], Period);
+    }
+  }
+
+  std::vector<double> Energies_eV;
+  std::vector<double> Flux;
+  std::vector<double> Brightness;
+  try {
+    self->obj->UndulatorTuningCurves(KPoints, Harmonics, Period, NPeriods, Energies_eV, Flux, Brightness, WithBrightness != 0, NThreads);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Tuple steals the references
+  PyObject* Result = PyTuple_New(WithBrightness ? 3 : 2);
+
+  PyObject* PyEnergies = OSCARSPY::VectorAsMemoryView(Energies_eV, Harmonics.size(), KPoints.size());
+  if (PyEnergies == NULL) {
+    Py_DECREF(Result);
+    return NULL;
+  }
+  PyTuple_SET_ITEM(Result, 0, PyEnergies);
+
+  PyObject* PyFlux = OSCARSPY::VectorAsMemoryView(Flux, Harmonics.size(), KPoints.size());
+  if (PyFlux == NULL) {
+    Py_DECREF(Result);
+    return NULL;
+  }
+  PyTuple_SET_ITEM(Result, 1, PyFlux);
+
+  if (WithBrightness) {
+    PyObject* PyBrightness = OSCARSPY::VectorAsMemoryView(Brightness, Harmonics.size(), KPoints.size());
+    if (PyBrightness == NULL) {
+      Py_DECREF(Result);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(Result, 2, PyBrightness);
+  }
+
+  return Result;
+}
+
+
+
+
+
+const char* DOC_OSCARSTH_UndulatorFlux = R"docstring(
+undulator_flux(period, nperiods [, K, bfield, energy_range_eV, energy_points_eV, energy_eV, npoints, angle_h, angle_v, helical, nthreads, ofile, bofile])
+
+Get the spectrum from an ideal planar or helical undulator at a given horizontal and vertical angle.  This is an analytic calculation, a sum over harmonics of the single period radiation integral written with Bessel functions times the line shape for nperiods.  It is meant as a fast path for ideal devices and as a check of calculate_spectrum().  Should specify either K or bfield, but not both.  You *must* have previously defined a beam.
+
+Parameters
+----------
+period : float
+    Undulator period length [m]
+
+nperiods : int
+    Number of periods
+
+K : float
+    Undulator deflection parameter (for a helical device, in each plane)
+
+bfield : float
+    Peak magnetic field [T]
+
+energy_range_eV : list
+    [min, max] photon energy of interest in [eV]
+
+energy_points_eV : list
+    List of energy points in [eV]
+
+energy_eV : float
+    Photon energy of interest
+
+npoints : int
+    Number of points for energy_range_eV
+
+angle_h : float
+    Horizontal angle [rad]
+
+angle_v : float
+    Vertical angle [rad]
+
+helical : bool
+    Helical undulator if True, else planar with the field in the vertical direction
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+Returns
+-------
+flux : list
+    A list of flux values for given points [[e0, f0], [e1, f1], ...] in [photons / s / mrad^2 / 0.1\%bw]
+
+Examples
+--------
+Spectrum 20 [urad] off axis horizontally for a 20 [mm] period, 100 period undulator
+
+    >>> oth.undulator_flux(period=0.020, nperiods=100, K=1.5, energy_range_eV=[100, 10000], npoints=1000, angle_h=20e-6)
+)docstring";
+static PyObject* OSCARSTH_UndulatorFlux (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return a list of points corresponding to the flux in a given energy range for a given angle
+
+  double      Period               = 0;
+  int         NPeriods             = 0;
+  double      K                    = 0;
+  double      BField               = 0;
+  PyObject*   List_EnergyRange_eV  = PyList_New(0);
+  PyObject*   List_EnergyPoints_eV = PyList_New(0);
+  double      Energy_eV            = 0;
+  int         NPoints              = 0;
+  double      AngleH               = 0;
+  double      AngleV               = 0;
+  int         Helical              = 0;
+  int         NThreads             = 0;
+  const char* OutFileNameText      = "";
+  const char* OutFileNameBinary    = "";
+
+  // Input variable list
+  static const char *kwlist[] = {"period",
+                                 "nperiods",
+                                 "K",
+                                 "bfield",
+                                 "energy_range_eV",
+                                 "energy_points_eV",
+                                 "energy_eV",
+                                 "npoints",
+                                 "angle_h",
+                                 "angle_v",
+                                 "helical",
+                                 "nthreads",
+                                 "ofile",
+                                 "bofile",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "di|ddOOdiddpiss",
+                                   const_cast<char **>(kwlist),
+                                   &Period,
+                                   &NPeriods,
+                                   &K,
+                                   &BField,
+                                   &List_EnergyRange_eV,
+                                   &List_EnergyPoints_eV,
+                                   &Energy_eV,
+                                   &NPoints,
+                                   &AngleH,
+                                   &AngleV,
+                                   &Helical,
+                                   &NThreads,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Check period
+  if (Period <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
+    return NULL;
+  }
+
+  // Check nperiods
+  if (NPeriods <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'nperiod' must be > 0");
+    return NULL;
+  }
+
+  // Check BField and K
+  if (!((BField != 0) ^ (K != 0))) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one and only one of: 'bfield' or 'K'");
+    return NULL;
+  }
+  if (BField != 0) {
+    K = self->obj->UndulatorK(BField, Period);
+  }
+
+  // Container for spectrum
+  TSpectrumContainer SpectrumContainer;
+
+  if (PyList_Size(List_EnergyRange_eV) != 0 && NPoints > 0) {
+    TVector2D EnergyRange_eV;
+    try {
+      EnergyRange_eV = OSCARSPY::ListAsTVector2D(List_EnergyRange_eV);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'energy_range_eV'");
+      return NULL;
+    }
+    SpectrumContainer.Init(NPoints, EnergyRange_eV[0], EnergyRange_eV[1]);
+  } else if (PyList_Size(List_EnergyPoints_eV) != 0) {
+    std::vector<double> VEnergyPoints_eV;
+    for (int i = 0; i < PyList_Size(List_EnergyPoints_eV); ++i) {
+      VEnergyPoints_eV.push_back(PyFloat_AsDouble(PyList_GetItem(List_EnergyPoints_eV, i)));
+    }
+    SpectrumContainer.Init(VEnergyPoints_eV);
+  } else if (Energy_eV > 0) {
+    SpectrumContainer.Init(1, Energy_eV, Energy_eV);
+  } else {
+    PyErr_SetString(PyExc_ValueError, "Incorrect combination of or missing input parameters.  Please see documentation for this function");
+    return NULL;
+  }
+
+  try {
+    self->obj->UndulatorFluxSpectrum(K, Period, NPeriods, AngleH, AngleV, SpectrumContainer, Helical ? OSCARSTH::kUndulatorType_Helical : OSCARSTH::kUndulatorType_Planar, NThreads);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Write to file if output is requested
+  if (std::string(OutFileNameText) != "") {
+    SpectrumContainer.WriteToFileText(OutFileNameText);
+  }
+  if (std::string(OutFileNameBinary) != "") {
+    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
+  }
+
+  // Return the spectrum
+  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
+}
+
+
+
+
+
+const char* DOC_OSCARSTH_UndulatorFluxRectangle = R"docstring(
+undulator_flux_rectangle(plane, energy_eV, period, nperiods, npoints, width [, x0x1x2, bfield, K, rotations, translation, normal, dim, helical, nthreads, ofile, bofile])
+
+Get the flux on a rectangular surface for an ideal planar or helical undulator centered at the origin along +z.  This uses the same analytic engine as undulator_flux() and is meant as a fast path for ideal devices and as a check of calculate_flux_rectangle().  Should specify either K or bfield, but not both.  You *must* have previously defined a beam.
+
+Parameters
+----------
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
+
+energy_eV : float
+    Photon energy of interest
+
+period : float
+    Undulator period length [m]
+
+nperiods : int
+    Number of periods
+
+npoints : list
+    [int, int] Number of points in X1 and X2 dimension [n1, n2]
+
+width : list
+    [float, float] Width of rectangular surface in X1 and X2 [w1, w2]
+
+x0x1x2 : list
+    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram.  Use instead of plane and width
+
+bfield : float
+    Peak magnetic field [T]
+
+K : float
+    Undulator deflection parameter (for a helical device, in each plane)
+
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+normal : int
+    -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given.
+
+dim : int
+    Defaults to 2 for a 2-dimensional output.  Can be 3 for 3-dimensional output
+
+helical : bool
+    Helical undulator if True, else planar with the field in the vertical direction
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+Returns
+-------
+flux : list
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and flux [photons/s/mm^2/0.1%bw] at that position: [[[x1_0, x2_0, x3_0], f_0], [[x1_1, x2_1, x3_1], f_1], ...]
+
+Examples
+--------
+Flux at 30 [m] on the 3rd harmonic
+
+    >>> oth.undulator_flux_rectangle(plane='XY', energy_eV=6033, period=0.020, nperiods=100, K=1.5, npoints=[51, 51], width=[0.01, 0.01], translation=[0, 0, 30])
+)docstring";
+static PyObject* OSCARSTH_UndulatorFluxRectangle (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return a list of points corresponding to the flux on a surface at a given energy
+
+  // Require 2 arguments
+  char const*  SurfacePlane      = "";
+  double       Energy_eV         = 0;
+  double       Period            = 0;
+  int          NPeriods          = 0;
+  PyObject*    List_NPoints      = PyList_New(0);
+  PyObject*    List_Width        = PyList_New(0);
+  PyObject*    List_X0X1X2       = PyList_New(0);
+  double       BField            = 0;
+  double       K                 = 0;
+  PyObject*    List_Rotations    = PyList_New(0);
+  PyObject*    List_Translation  = PyList_New(0);
+  int          NormalDirection   = 0;
+  int          Dim               = 2;
+  int          NThreads          = 0;
+  int          Helical           = 0;
+  const char*  OutFileNameText   = "";
+  const char*  OutFileNameBinary = "";
+
+  size_t NX1 = 0;
+  size_t NX2 = 0;
+
+  // Input variable list
+  static const char *kwlist[] = {
+                                 "plane",
+                                 "energy_eV",
+                                 "period",
+                                 "nperiods",
+                                 "npoints",
+                                 "width",
+                                 "x0x1x2",
+                                 "bfield",
+                                 "K",
+                                 "rotations",
+                                 "translation",
+                                 "normal",
+                                 "dim",
+                                 "helical",
+                                 "nthreads",
+                                 "ofile",
+                                 "bofile",
+                                 NULL};
+
+  // Parse inputs
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "sddiO|OOddOOiipiss",
+                                   const_cast<char **>(kwlist),
+                                   &SurfacePlane,
+                                   &Energy_eV,
+                                   &Period,
+                                   &NPeriods,
+                                   &List_NPoints,
+                                   &List_Width,
+                                   &List_X0X1X2,
+                                   &BField,
+                                   &K,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &NormalDirection,
+                                   &Dim,
+                                   &Helical,
+                                   &NThreads,
+                                   &OutFileNameText,
+                                   &OutFileNameBinary)) {
+    return NULL;
+  }
+
+  // CHeck if beam is ok
+  if (!self->obj->CheckBeam()) {
+    PyErr_SetString(PyExc_ValueError, "particle beam not correctly defined");
+    return NULL;
+  }
+
+  // Check period
+  if (Period <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
+    return NULL;
+  }
+
+  // Check nperiods
+  if (NPeriods <= 0) {
+    PyErr_SetString(PyExc_ValueError, "'nperiod' must be > 0");
+    return NULL;
+  }
+
+  TVector2D Width;
+  try {
+    Width = OSCARSPY::ListAsTVector2D(List_Width);
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "'width' has incorrect format");
+    return NULL;
+  }
+
+  if (PyList_Size(List_NPoints) == 2) {
+    // NPoints in [m]
+    NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
+    NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'npoints' must be [int, int]");
+    return NULL;
+  }
+
+  // Check BField and K
+  if (!((BField != 0) ^ (K != 0))) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one and only one of: 'bfield' or 'K'");
+    return NULL;
+  }
+
+  // Vectors for rotations and translations.  Default to 0
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
+
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
+
+
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
+
+  // Check normal
+  if (abs(NormalDirection) > 1) {
+    PyErr_SetString(PyExc_ValueError, "'normal' must be -1, 0, or 1");
+    return NULL;
+  }
+
+  // Check dim
+  if (Dim != 2 && Dim != 3) {
+    PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
+    return NULL;
+  }
+
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
+
+
+  // The rectangular surface object we'll use
+  TSurfacePoints_Rectangle Surface;
+
+  // If you are requesting a simple surface plane, check that you have widths
+  if (std::strlen(SurfacePlane) != 0 && Width[0] > 0 && Width[1] > 0) {
+    try {
+      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width[0], Width[1], Rotations, Translation, NormalDirection);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  } else if (PyList_Size(List_X0X1X2) != 0) {
+    std::vector<TVector3D> X0X1X2;
+    if (PyList_Size(List_X0X1X2) == 3) {
+      for (int i = 0; i != 3; ++i) {
+        PyObject* List_X = PyList_GetItem(List_X0X1X2, i);
+
+        try {
+          X0X1X2.push_back(OSCARSPY::ListAsTVector3D(List_X));
+        } catch (std::length_error e) {
+          PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0x1x2'");
+          return NULL;
+        }
+      }
+    } else {
+      PyErr_SetString(PyExc_ValueError, "'x0x1x2' must have 3 XYZ points defined correctly");
+      return NULL;
+    }
+
+    for (std::vector<TVector3D>::iterator it = X0X1X2.begin(); it != X0X1X2.end(); ++it) {
+      it->RotateSelfXYZ(Rotations);
+      *it += Translation;
+    }
+
+    // UPDATE: Check for orthogonality
+    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
+  }
+
+  // Container for Flux
+  T3DScalarContainer FluxContainer;
+
+  if (BField != 0) {
+    K = self->obj->UndulatorK(BField, Period);
+  }
+
+  try {
+    self->obj->UndulatorFluxSurface(K, Period, NPeriods, Surface, Energy_eV, FluxContainer, Helical ? OSCARSTH::kUndulatorType_Helical : OSCARSTH::kUndulatorType_Planar, Dim, NThreads);
+  } catch (std::invalid_argument e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
+  }
+
+  // Write to file if output is requested
+  if (std::string(OutFileNameText) != "") {
+    FluxContainer.WriteToFileText(OutFileNameText, Dim);
+  }
+  if (std::string(OutFileNameBinary) != "") {
+    FluxContainer.WriteToFileBinary(OutFileNameBinary, Dim);
+  }
+
+  // Build the output list of: [[[x, y, z], Flux], [...]]
+  // Create a python list
+  PyObject *PList = PyList_New(0);
+
+  size_t const NPoints = FluxContainer.GetNPoints();
+
+  for (size_t i = 0; i != NPoints; ++i) {
+    T3DScalar P = FluxContainer.GetPoint(i);
+
+    // Inner list for each point
+    PyObject *PList2 = PyList_New(0);
+
+
+    // Add position and value to list
+    PyList_Append(PList2, OSCARSPY::TVector3DAsList(P.GetX()));
+    PyList_Append(PList2, Py_BuildValue("f", P.GetV()));
+    PyList_Append(PList, PList2);
+
+  }
+
+  return PList;
+}
+
+
+
+
+
+
+const char* DOC_OSCARSTH_UndulatorPowerDensityRectangle = R"docstring(
+undulator_power_density_rectangle(plane, period, nperiods, npoints, width [, x0x1x2, bfield, K, rotations, translation, normal, dim, directional, nthreads, ofile, bofile])
+
+Get the power density on a rectangular surface for an ideal planar undulator or wiggler centered at the origin along +z with the field in the vertical direction.  This uses the period averaged angular distribution of K.-J. Kim, valid for any K, including the incidence angle on the surface.  It is meant as a fast path for ideal devices and as a check of calculate_power_density_rectangle().  Should specify either K or bfield, but not both.  You *must* have previously defined a beam.
+
+Parameters
+----------
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
+
+period : float
+    Undulator period length [m]
+
+nperiods : int
+    Number of periods
+
+npoints : list
+    [int, int] Number of points in X1 and X2 dimension [n1, n2]
+
+width : list
+    [float, float] Width of rectangular surface in X1 and X2 [w1, w2]
+
+x0x1x2 : list
+    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram.  Use instead of plane and width
+
+bfield : float
+    Peak magnetic field [T]
+
+K : float
+    Undulator deflection parameter
+
+rotations : list, optional
+    3-element list representing rotations around x, y, and z axes: [:math:`\theta_x, \theta_y, \theta_z`]
+
+translation : list, optional
+    3-element list representing a translation in space [x, y, z]
+
+normal : int
+    -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given.
+
+dim : int
+    Defaults to 2 for a 2-dimensional output.  Can be 3 for 3-dimensional output
+
+directional : bool
+    If True (default) only radiation hitting the front of the surface (along the normal) is counted
+
+nthreads : int
+    Number of threads to use.  Default is the global setting
+
+ofile : str
+    Output file name
+
+bofile : str
+    Binary output file name
+
+Returns
+-------
+power_density : list
+    A list, each element of which is a pair representing the position (2D relative (default) or 3D absolute) and power density [W/mm^2] at that position: [[[x1_0, x2_0, x3_0], p_0], [[x1_1, x2_1, x3_1], p_1], ...]
+
+Examples
+--------
+Power density at 30 [m]
+
+    >>> oth.undulator_power_density_rectangle(plane='XY', period=0.020, nperiods=100, K=1.5, npoints=[51, 51], width=[0.01, 0.01], translation=[0, 0, 30])
+)docstring";
+static PyObject* OSCARSTH_UndulatorPowerDensityRectangle (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
+{
+  // Return a list of points corresponding to the power density on a surface
+
+  // Require 2 arguments
+  char const*  SurfacePlane      = "";
+  double       Period            = 0;
+  int          NPeriods          = 0;
+  PyObject*    List_NPoints      = PyList_New(0);
+  PyObject*    List_Width        = PyList_New(0);
+  PyObject*    List_X0X1X2       = PyList_New(0);
+  double       BField            = 0;
+  double       K                 = 0;
+  PyObject*    List_Rotations    = PyList_New(0);
+  PyObject*    List_Translation  = PyList_New(0);
+  int          NormalDirection   = 0;
+  int          Dim               = 2;
+  int          NThreads          = 0;
+  int          Directional       = 1;
+  const char*  OutFileNameText   = "";
+  const char*  OutFileNameBinary = "";
+
+  size_t NX1 = 0;
+  size_t NX2 = 0;
 
   // Input variable list
-  static const char *kwlist[] = {"period",
+  static const char *kwlist[] = {
+                                 "plane",
+                                 "period",
                                  "nperiods",
-                                 "harmonic",
-                                 "bfield_range",
-                                 "K_range",
                                  "npoints",
-                                 "bfield_points",
-                                 "K_points",
-                                 "minimum",
+                                 "width",
+                                 "x0x1x2",
+                                 "bfield",
+                                 "K",
+                                 "rotations",
+                                 "translation",
+                                 "normal",
+                                 "dim",
+                                 "directional",
+                                 "nthreads",
                                  "ofile",
                                  "bofile",
                                  NULL};
 
   // Parse inputs
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "dii|OOiOOdss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "sdiO|OOddOOiipiss",
                                    const_cast<char **>(kwlist),
+                                   &SurfacePlane,
                                    &Period,
                                    &NPeriods,
-                                   &Harmonic,
-                                   &List_BFieldRange,
-                                   &List_KRange,
-                                   &NPoints,
-                                   &List_BFieldPoints,
-                                   &List_KPoints,
-                                   &Minimum,
+                                   &List_NPoints,
+                                   &List_Width,
+                                   &List_X0X1X2,
+                                   &BField,
+                                   &K,
+                                   &List_Rotations,
+                                   &List_Translation,
+                                   &NormalDirection,
+                                   &Dim,
+                                   &Directional,
+                                   &NThreads,
                                    &OutFileNameText,
                                    &OutFileNameBinary)) {
     return NULL;
@@ -1019,12 +2339,6 @@ static PyObject* OSCARSTH_UndulatorBrightness (OSCARSTHObject* self, PyObject* a
     return NULL;
   }
 
-  // Check harmonic number is > 0
-  if (Harmonic <= 0) {
-    PyErr_SetString(PyExc_ValueError, "'harmonic' must be > 0");
-    return NULL;
-  }
-
   // Check period
   if (Period <= 0) {
     PyErr_SetString(PyExc_ValueError, "'period' must be > 0");
@@ -1037,115 +2351,164 @@ static PyObject* OSCARSTH_UndulatorBrightness (OSCARSTHObject* self, PyObject* a
     return NULL;
   }
 
-  // Check not overlapping definitions
-  int const SizeSumLists =  PyList_Size(List_BFieldRange)
-                            + PyList_Size(List_KRange)
-                            + PyList_Size(List_BFieldPoints)
-                            + PyList_Size(List_KPoints);
-  if (!(PyList_Size(List_BFieldRange)  == SizeSumLists ||
-        PyList_Size(List_KRange)       == SizeSumLists ||
-        PyList_Size(List_BFieldPoints) == SizeSumLists ||
-        PyList_Size(List_KPoints)      == SizeSumLists)) {
-    PyErr_SetString(PyExc_ValueError, "May only specify one of: 'bfield_range', 'K_range', 'bfield_points', 'K_points'");
+  TVector2D Width;
+  try {
+    Width = OSCARSPY::ListAsTVector2D(List_Width);
+  } catch (...) {
+    PyErr_SetString(PyExc_ValueError, "'width' has incorrect format");
     return NULL;
   }
 
-  // Container for spectrum
-  TSpectrumContainer SpectrumContainer;
+  if (PyList_Size(List_NPoints) == 2) {
+    // NPoints in [m]
+    NX1 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 0));
+    NX2 = PyLong_AsSsize_t(PyList_GetItem(List_NPoints, 1));
+  } else {
+    PyErr_SetString(PyExc_ValueError, "'npoints' must be [int, int]");
+    return NULL;
+  }
 
-  TVector2D Range;
-  std::vector<double> Points;
+  // Check BField and K
+  if (!((BField != 0) ^ (K != 0))) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one and only one of: 'bfield' or 'K'");
+    return NULL;
+  }
 
-  // Init container based on inputs
-  try {
-    if (PyList_Size(List_BFieldRange) > 0 && NPoints > 1) {
-      try {
-        Range = OSCARSPY::ListAsTVector2D(List_BFieldRange);
-      } catch (std::length_error e) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'bfield_range'");
-        return NULL;
-      }
+  // Vectors for rotations and translations.  Default to 0
+  TVector3D Rotations(0, 0, 0);
+  TVector3D Translation(0, 0, 0);
 
-      // Add each point
-      for (int i = 0; i < NPoints; ++i) {
-        double BField = Range[0] + (Range[1] - Range[0]) / (double) (NPoints - 1) * (double) i;
-        TVector2D const Result = self->obj->UndulatorBrightnessB(BField, Period, NPeriods, Harmonic);
-        if (Result[1] >= Minimum) {
-          SpectrumContainer.AddPoint(Result[0], Result[1]);
-        }
-      }
+  // Check for Rotations in the input
+  if (PyList_Size(List_Rotations) != 0) {
+    try {
+      Rotations = OSCARSPY::ListAsTVector3D(List_Rotations);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'rotations'");
+      return NULL;
+    }
+  }
 
-    } else if (PyList_Size(List_KRange) > 0 && NPoints > 1) {
-      try {
-        Range = OSCARSPY::ListAsTVector2D(List_KRange);
-      } catch (std::length_error e) {
-        PyErr_SetString(PyExc_ValueError, "Incorrect format in 'K_range'");
-        return NULL;
-      }
 
-      // Add each point
-      for (int i = 0; i < NPoints; ++i) {
-        double K = Range[0] + (Range[1] - Range[0]) / (double) (NPoints - 1) * (double) i;
-        TVector2D const Result = self->obj->UndulatorBrightnessK(K, Period, NPeriods, Harmonic);
-        if (Result[1] >= Minimum) {
-          SpectrumContainer.AddPoint(Result[0], Result[1]);
-        }
-      }
+  // Check for Translation in the input
+  if (PyList_Size(List_Translation) != 0) {
+    try {
+      Translation = OSCARSPY::ListAsTVector3D(List_Translation);
+    } catch (std::length_error e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'translation'");
+      return NULL;
+    }
+  }
 
-    } else if (PyList_Size(List_BFieldPoints) > 0) {
-      for (int i = 0; i < PyList_Size(List_BFieldPoints); ++i) {
-        Points.push_back(PyFloat_AsDouble(PyList_GetItem(List_BFieldPoints, i)));
-      }
+  // Check normal
+  if (abs(NormalDirection) > 1) {
+    PyErr_SetString(PyExc_ValueError, "'normal' must be -1, 0, or 1");
+    return NULL;
+  }
 
-      // Add each point
-      for (size_t i = 0; i < Points.size(); ++i) {
-        TVector2D const Result = self->obj->UndulatorBrightnessB(Points[i], Period, NPeriods, Harmonic);
-        if (Result[1] >= Minimum) {
-          SpectrumContainer.AddPoint(Result[0], Result[1]);
-        }
-      }
+  // Check dim
+  if (Dim != 2 && Dim != 3) {
+    PyErr_SetString(PyExc_ValueError, "'dim' must be 2 or 3");
+    return NULL;
+  }
 
-    } else if (PyList_Size(List_KPoints) > 0) {
-      for (int i = 0; i < PyList_Size(List_KPoints); ++i) {
-        Points.push_back(PyFloat_AsDouble(PyList_GetItem(List_KPoints, i)));
-      }
+  // Check NThreads parameter
+  if (NThreads < 0) {
+    PyErr_SetString(PyExc_ValueError, "'nthreads' must be > 0");
+    return NULL;
+  }
 
-      // Add each point
-      for (size_t i = 0; i < Points.size(); ++i) {
-        TVector2D const Result = self->obj->UndulatorBrightnessK(Points[i], Period, NPeriods, Harmonic);
-        if (Result[1] >= Minimum) {
-          SpectrumContainer.AddPoint(Result[0], Result[1]);
+
+  // The rectangular surface object we'll use
+  TSurfacePoints_Rectangle Surface;
+
+  // If you are requesting a simple surface plane, check that you have widths
+  if (std::strlen(SurfacePlane) != 0 && Width[0] > 0 && Width[1] > 0) {
+    try {
+      Surface.Init(SurfacePlane, (int) NX1, (int) NX2, Width[0], Width[1], Rotations, Translation, NormalDirection);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+  } else if (PyList_Size(List_X0X1X2) != 0) {
+    std::vector<TVector3D> X0X1X2;
+    if (PyList_Size(List_X0X1X2) == 3) {
+      for (int i = 0; i != 3; ++i) {
+        PyObject* List_X = PyList_GetItem(List_X0X1X2, i);
+
+        try {
+          X0X1X2.push_back(OSCARSPY::ListAsTVector3D(List_X));
+        } catch (std::length_error e) {
+          PyErr_SetString(PyExc_ValueError, "Incorrect format in 'x0x1x2'");
+          return NULL;
         }
       }
-
     } else {
-      PyErr_SetString(PyExc_ValueError, "Incorrect input format in input, possibly check that npoints > 1?");
+      PyErr_SetString(PyExc_ValueError, "'x0x1x2' must have 3 XYZ points defined correctly");
       return NULL;
     }
+
+    for (std::vector<TVector3D>::iterator it = X0X1X2.begin(); it != X0X1X2.end(); ++it) {
+      it->RotateSelfXYZ(Rotations);
+      *it += Translation;
+    }
+
+    // UPDATE: Check for orthogonality
+    Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
+  }
+
+  // Container for power density
+  T3DScalarContainer PowerDensityContainer;
+
+  if (BField != 0) {
+    K = self->obj->UndulatorK(BField, Period);
+  }
+
+  try {
+    self->obj->UndulatorPowerDensitySurface(K, Period, NPeriods, Surface, PowerDensityContainer, Directional != 0, Dim, NThreads);
   } catch (std::invalid_argument e) {
     PyErr_SetString(PyExc_ValueError, e.what());
     return NULL;
+  } catch (std::out_of_range e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return NULL;
   }
 
-  // Don't need to hold on to this any longer
-  Points.clear();
-
   // Write to file if output is requested
   if (std::string(OutFileNameText) != "") {
-    SpectrumContainer.WriteToFileText(OutFileNameText);
+    PowerDensityContainer.WriteToFileText(OutFileNameText, Dim);
   }
   if (std::string(OutFileNameBinary) != "") {
-    SpectrumContainer.WriteToFileBinary(OutFileNameBinary);
+    PowerDensityContainer.WriteToFileBinary(OutFileNameBinary, Dim);
   }
 
-  // Return the spectrum
-  return OSCARSPY::GetSpectrumAsList(SpectrumContainer);
+  // Build the output list of: [[[x, y, z], PowerDensity], [...]]
+  // Create a python list
+  PyObject *PList = PyList_New(0);
+
+  size_t const NPoints = PowerDensityContainer.GetNPoints();
+
+  for (size_t i = 0; i != NPoints; ++i) {
+    T3DScalar P = PowerDensityContainer.GetPoint(i);
+
+    // Inner list for each point
+    PyObject *PList2 = PyList_New(0);
+
+
+    // Add position and value to list
+    PyList_Append(PList2, OSCARSPY::TVector3DAsList(P.GetX()));
+    PyList_Append(PList2, Py_BuildValue("f", P.GetV()));
+    PyList_Append(PList, PList2);
+
+  }
+
+  return PList;
 }
 
 
 
 
 
+
 const char* DOC_OSCARSTH_UndulatorEnergyHarmonic = R"docstring(
 undulator_energy_harmonic(period, harmonic [, K, bfield])
 
@@ -1476,38 +2839,56 @@ static PyObject* OSCARSTH_WigglerSpectrum (OSCARSTHObject* self, PyObject* args,
 
 
 const char* DOC_OSCARSTH_WigglerFluxRectangle = R"docstring(
-wiggler_flux_rectangle(plane, energy_eV, period, nperiods, width, npoints [, bfield, K, ofile, bofile])
+wiggler_flux(plane, energy_eV, period, nperiods, npoints, width [, x0x1x2, bfield, K, rotations, translation, normal, dim, nthreads, gpu, ofile, bofile, energies_eV])
 
-Get the flux for an ideal wiggler according to R. P. Walker XXX XXX.  Should specify either K or bfield, but not both.  You *must* have previously defined a beam.
+Get the flux for an ideal wiggler according to R. P. Walker XXX XXX.  Should specify either K or bfield, but not both, and either energy_eV or energies_eV, but not both.  You *must* have previously defined a beam.
 
 Parameters
 ----------
+plane : str
+    The plane to start in (XY, XZ, YZ, YX, ZX, ZY).  The normal to the surface is defined using the right handed cross product (ie the last three have opposite normal vectors from the first three)
+
+energy_eV : float
+    Photon energy of interest [eV]
+
 period : float
     Magnetic period length [m]
 
 nperiods : int
     Number of periods
 
-harmonic : int
-    Harmonic number of interest
+npoints : list
+    [int, int] Number of points in X1 and X2 dimension
 
-bfield_range : list
-    [min, max] of bfield range of interest
+width : list
+    [float, float] Width of rectangular surface [m]
 
-K_range : list
-    [min, max] of K range of interest
+x0x1x2 : list
+    List of three points [[x0, y0, z0], [x1, y1, z1], [x2, y2, z2]] defining a parallelogram
 
-npoints : int
-    number of points to use when bfield_range or K_range is specified
+bfield : float
+    Peak magnetic field [T]
 
-bfield_points : list
-    List of bfield points to calculate flux at
+K : float
+    Deflection parameter
 
-K_points : list
-    List of K points to calculate flux at
+rotations : list, optional
+    [ax, ay, az] rotations in [rad] about the X, Y, and Z axes
 
-minimum : float
-    Any flux below the minimum will not be included in the return list
+translation : list, optional
+    [x, y, z] translation of the surface [m]
+
+normal : int
+    -1 if you wish to reverse the normal vector, 0 if you wish to ignore the +/- direction in computations, 1 if you with to use the direction of the normal vector as given.
+
+dim : int
+    Return 2D or 3D coordinates
+
+nthreads : int
+    Number of threads to use
+
+gpu : int
+    Use the gpu or not (0 or 1)
 
 ofile : str
     Output file name
@@ -1515,20 +2896,23 @@ ofile : str
 bofile : str
     Binary output file name
 
+energies_eV : list
+    Photon energies [eV].  Any sequence of numbers, including a numpy array.  All energies are calculated in one pass over the surface
+
 Returns
 -------
-[energy_eV, flux]s : list[[float, float], ...]
-    Photon energy [eV] and flux [photons/s/0.1%bw/mrad^2] for the given parameters
+flux : list
+    A list of flux values and their positions [[[x, y, z], flux], ...] in [photons/s/0.1%bw/mrad^2]
+
+(points, flux) : tuple(list, memoryview)
+    When energies_eV is given: the points [[x, y, z], ...] and a 2D array of doubles of shape (npoints, len(energies_eV)).  Use numpy.asarray() to get a numpy array without a copy
 
 Examples
 --------
-Get the harmonic peak spectrum for a undulator with a period of 0.050 [m] having 41 periods and a bfield ranging from 0.05 to 0.8 [T] from the 1st harmonic
-
-    >>> oth.undulator_flux_onaxis(period=0.050, nperiods=41, harmonic=1, bfield_range=[0.05, 0.8], npoints=1000)
-
-Get the photon energy and flux for a undulator with a period of 0.050 [m] having 41 periods and K value of 1.8674577 from the 1st harmonic
+Flux on a 51 x 51 grid at 30 [m] for 100 photon energies
 
-    >>> oth.undulator_flux_onaxis(period=0.050, nperiods=41, harmonic=1, K=1.8674577)
+    >>> import numpy as np
+    >>> points, flux = oth.wiggler_flux(plane='XY', period=0.100, nperiods=30, bfield=1.5, npoints=[51, 51], width=[0.1, 0.02], translation=[0, 0, 30], energies_eV=np.linspace(1000, 50000, 100))
 )docstring";
 static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject* args, PyObject* keywds)
 {
@@ -1553,6 +2937,7 @@ static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject*
   int          GPU               = -1;
   const char*  OutFileNameText   = "";
   const char*  OutFileNameBinary = "";
+  PyObject*    Seq_Energies      = 0x0;
 
   size_t NX1 = 0;
   size_t NX2 = 0;
@@ -1576,10 +2961,11 @@ static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject*
                                  "gpu",
                                  "ofile",
                                  "bofile",
+                                 "energies_eV",
                                  NULL};
 
   // Parse inputs
-  if (!PyArg_ParseTupleAndKeywords(args, keywds, "sddiO|OOddOOiiiiss",
+  if (!PyArg_ParseTupleAndKeywords(args, keywds, "s|ddiOOOddOOiiiissO",
                                    const_cast<char **>(kwlist),
                                    &SurfacePlane,
                                    &Energy_eV,
@@ -1597,7 +2983,8 @@ static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject*
                                    &NThreads,
                                    &GPU,
                                    &OutFileNameText,
-                                   &OutFileNameBinary)) {
+                                   &OutFileNameBinary,
+                                   &Seq_Energies)) {
     return NULL;
   }
 
@@ -1619,6 +3006,21 @@ static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject*
     return NULL;
   }
 
+  // One energy or a list of energies
+  std::vector<double> Energies_eV;
+  if (Seq_Energies != 0x0) {
+    try {
+      OSCARSPY::SequenceToVectorDouble(Seq_Energies, Energies_eV);
+    } catch (std::invalid_argument e) {
+      PyErr_SetString(PyExc_ValueError, "Incorrect format in 'energies_eV'");
+      return NULL;
+    }
+  }
+  if ((Energy_eV > 0) == (Energies_eV.size() > 0)) {
+    PyErr_SetString(PyExc_ValueError, "Must specify one and only one of: 'energy_eV' or 'energies_eV'");
+    return NULL;
+  }
+
   TVector2D Width;
   try {
     Width = OSCARSPY::ListAsTVector2D(List_Width);
@@ -1738,6 +3140,36 @@ static PyObject* OSCARSTH_WigglerFluxRectangle (OSCARSTHObject* self, PyObject*
     Surface.Init((int) NX1, (int) NX2, X0X1X2[0], X0X1X2[1], X0X1X2[2], NormalDirection);
   }
 
+  // All energies in one pass, returning the points and a (points x energies) array
+  if (Energies_eV.size() > 0) {
+    std::vector<double> Flux;
+    try {
+      self->obj->WigglerFluxKEnergies(BField != 0 ? self->obj->UndulatorK(BField, Period) : K, Period, NPeriods, Surface, Energies_eV, Flux, NThreads);
+    } catch (std::out_of_range e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    PyObject* PyFlux = OSCARSPY::VectorAsMemoryView(Flux, Surface.GetNPoints(), Energies_eV.size());
+    if (PyFlux == NULL) {
+      return NULL;
+    }
+
+    PyObject* PyPoints = PyList_New(0);
+    for (size_t i = 0; i != Surface.GetNPoints(); ++i) {
+      PyObject* PyPoint = Dim == 2 ? OSCARSPY::TVector3DAsList(TVector3D(Surface.GetX1(i), Surface.GetX2(i), 0)) : OSCARSPY::TVector3DAsList(Surface.GetPoint(i).GetPoint());
+      PyList_Append(PyPoints, PyPoint);
+      Py_DECREF(PyPoint);
+    }
+
+    // Tuple steals the references
+    PyObject* Result = PyTuple_New(2);
+    PyTuple_SET_ITEM(Result, 0, PyPoints);
+    PyTuple_SET_ITEM(Result, 1, PyFlux);
+
+    return Result;
+  }
+
   // Container for Flux
   T3DScalarContainer FluxContainer;
 
@@ -2203,6 +3635,9 @@ static PyObject* OSCARSTH_SetParticleBeam (OSCARSTHObject* self, PyObject* args,
     } catch (std::invalid_argument e) {
       PyErr_SetString(PyExc_ValueError, "invalid argument in adding particle beam.  possibly 'name' already exists");
       return NULL;
+    } catch (std::out_of_range e) {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
     }
   }
 
@@ -2422,6 +3857,7 @@ static PyMethodDef OSCARSTH_methods[] = {
   {"undulator_period",                           (PyCFunction) OSCARSTH_UndulatorPeriod,                         METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorPeriod},
 
   {"dipole_spectrum",                            (PyCFunction) OSCARSTH_DipoleSpectrum,                          METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrum},
+  {"dipole_spectrum_grid",                       (PyCFunction) OSCARSTH_DipoleSpectrumGrid,                      METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrumGrid},
   //{"dipole_spectrum_point",                      (PyCFunction) OSCARSTH_DipoleSpectrumPoint,                       METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrumPoint},
   {"dipole_critical_energy",                     (PyCFunction) OSCARSTH_DipoleCriticalEnergy,                    METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleCriticalEnergy},
   {"dipole_critical_wavelength",                 (PyCFunction) OSCARSTH_DipoleCriticalWavelength,                METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleCriticalWavelength},
@@ -2429,6 +3865,11 @@ static PyMethodDef OSCARSTH_methods[] = {
 
   {"undulator_flux_onaxis",                      (PyCFunction) OSCARSTH_UndulatorFluxOnAxis,                     METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFluxOnAxis},
   {"undulator_brightness",                       (PyCFunction) OSCARSTH_UndulatorBrightness,                     METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorBrightness},
+  {"undulator_brightness_grid",                  (PyCFunction) OSCARSTH_UndulatorBrightnessGrid,                 METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorBrightnessGrid},
+  {"undulator_tuning_curves",                    (PyCFunction) OSCARSTH_UndulatorTuningCurves,                   METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorTuningCurves},
+  {"undulator_flux",                             (PyCFunction) OSCARSTH_UndulatorFlux,                           METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFlux},
+  {"undulator_flux_rectangle",                   (PyCFunction) OSCARSTH_UndulatorFluxRectangle,                  METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFluxRectangle},
+  {"undulator_power_density_rectangle",          (PyCFunction) OSCARSTH_UndulatorPowerDensityRectangle,          METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorPowerDensityRectangle},
   {"undulator_energy_harmonic",                  (PyCFunction) OSCARSTH_UndulatorEnergyHarmonic,                 METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorEnergyHarmonic},
 
   {"wiggler_spectrum",                           (PyCFunction) OSCARSTH_WigglerSpectrum,                         METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_WigglerSpectrum},
@@ -2457,6 +3898,7 @@ static PyMethodDef OSCARSTH_methods_fake[] = {
   {"undulator_period",                           (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorPeriod},
 
   {"dipole_spectrum",                            (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrum},
+  {"dipole_spectrum_grid",                       (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrumGrid},
   //{"dipole_spectrum_point",                      (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleSpectrumPoint},
   {"dipole_critical_energy",                     (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleCriticalEnergy},
   {"dipole_critical_wavelength",                 (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_DipoleCriticalWavelength},
@@ -2464,6 +3906,11 @@ static PyMethodDef OSCARSTH_methods_fake[] = {
 
   {"undulator_flux_onaxis",                      (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFluxOnAxis},
   {"undulator_brightness",                       (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorBrightness},
+  {"undulator_brightness_grid",                  (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorBrightnessGrid},
+  {"undulator_tuning_curves",                    (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorTuningCurves},
+  {"undulator_flux",                             (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFlux},
+  {"undulator_flux_rectangle",                   (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorFluxRectangle},
+  {"undulator_power_density_rectangle",          (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorPowerDensityRectangle},
   {"undulator_energy_harmonic",                  (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_UndulatorEnergyHarmonic},
 
   {"wiggler_spectrum",                           (PyCFunction) OSCARSTH_Fake, METH_VARARGS | METH_KEYWORDS,                  DOC_OSCARSTH_WigglerSpectrum},
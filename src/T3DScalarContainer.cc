@@ -1,5 +1,9 @@
 #include "T3DScalarContainer.h"
 
+#include "TResultFile.h"
+
+#include <cstdint>
+
 
 
 T3DScalarContainer::T3DScalarContainer ()
@@ -71,6 +75,22 @@ void T3DScalarContainer::SetNotConverged (size_t const i)
 
 
 
+bool T3DScalarContainer::IsConverged (size_t const i) const
+{
+  // Is the converged bit for this point clear
+
+  size_t const VectorIndex = i / (8 * sizeof(int));
+  if (VectorIndex >= fNotConverged.size()) {
+    throw std::length_error("T3DScalarContainer::IsConverged index out of range");
+  }
+
+  int const Bit = (0x1 << (i % (8 * sizeof(int))));
+
+  return (fNotConverged[VectorIndex] & Bit) == 0x0;
+}
+
+
+
 bool T3DScalarContainer::AllConverged () const
 {
   for (std::vector<int>::const_iterator it = fNotConverged.begin(); it != fNotConverged.end(); ++it) {
@@ -492,6 +512,139 @@ T3DScalar const& T3DScalarContainer::GetPoint (size_t const i) const
 
 
 
+void T3DScalarContainer::WriteToFileChunked (std::string const& OutFileName,
+                                             double const Weight,
+                                             uint64_t const NParticles) const
+{
+  // Append the values as a new chunk to a chunked result file (see TResultFile).
+  // The Weight is used when averaging chunks, typically the number of particles.
+
+  std::vector<double> Coordinates;
+  std::vector<double> Values;
+  Coordinates.reserve(3 * fValues.size());
+  Values.reserve(fValues.size());
+
+  for (std::vector<T3DScalar>::const_iterator it = fValues.begin(); it != fValues.end(); ++it) {
+    Coordinates.push_back(it->GetX().GetX());
+    Coordinates.push_back(it->GetX().GetY());
+    Coordinates.push_back(it->GetX().GetZ());
+    Values.push_back(it->GetV());
+  }
+
+  TResultFile R;
+  R.Init(TResultFile::kResultFile_T3DScalar, 3, Coordinates, Values, Weight, NParticles);
+  R.AppendToFile(OutFileName);
+
+  return;
+}
+
+
+
+
+void T3DScalarContainer::AverageFromFilesChunked (std::vector<std::string> const& Files,
+                                                  int const NThreads,
+                                                  std::string const& OutFileName)
+{
+  // Weighted average of all chunks in all chunked result files.  Files are read one at a
+  // time per thread in bounded memory.  If OutFileName is given the merged result is
+  // written there as a single chunk carrying the total weight and number of particles.
+
+  this->Clear();
+
+  TResultFile R;
+  R.MergeFromFiles(Files, NThreads);
+
+  if (R.GetType() != TResultFile::kResultFile_T3DScalar) {
+    throw std::invalid_argument("result files are not of T3DScalar type");
+  }
+
+  std::vector<double> const& Coordinates = R.GetCoordinates();
+  std::vector<double> const& Values = R.GetValues();
+  for (size_t i = 0; i != Values.size(); ++i) {
+    this->AddPoint(TVector3D(Coordinates[3 * i], Coordinates[3 * i + 1], Coordinates[3 * i + 2]), Values[i]);
+  }
 
+  if (OutFileName != "") {
+    R.WriteToFile(OutFileName);
+  }
+
+  return;
+}
 
 
+
+
+void T3DScalarContainer::WriteCheckpoint (std::ostream& os) const
+{
+  // Write the full state of this container in binary (values, compensation, and
+  // not-converged flags) so that it can be restored exactly with ReadCheckpoint
+
+  uint64_t const NPoints = (uint64_t) fValues.size();
+  uint64_t const NWords  = (uint64_t) fNotConverged.size();
+
+  os.write((char*) &NPoints, sizeof(uint64_t));
+  os.write((char*) &NWords,  sizeof(uint64_t));
+
+  double X[5];
+  for (size_t i = 0; i != fValues.size(); ++i) {
+    X[0] = fValues[i].GetX().GetX();
+    X[1] = fValues[i].GetX().GetY();
+    X[2] = fValues[i].GetX().GetZ();
+    X[3] = fValues[i].GetV();
+    X[4] = fCompensation[i];
+    os.write((char*) X, 5 * sizeof(double));
+  }
+
+  for (size_t i = 0; i != fNotConverged.size(); ++i) {
+    int32_t const W = (int32_t) fNotConverged[i];
+    os.write((char*) &W, sizeof(int32_t));
+  }
+
+  if (!os) {
+    throw std::length_error("T3DScalarContainer::WriteCheckpoint cannot write checkpoint");
+  }
+
+  return;
+}
+
+
+
+
+void T3DScalarContainer::ReadCheckpoint (std::istream& is)
+{
+  // Read the full state of this container as written by WriteCheckpoint.  Existing
+  // contents are replaced
+
+  this->Clear();
+
+  uint64_t NPoints = 0;
+  uint64_t NWords  = 0;
+
+  is.read((char*) &NPoints, sizeof(uint64_t));
+  is.read((char*) &NWords,  sizeof(uint64_t));
+  if (!is) {
+    throw std::length_error("T3DScalarContainer::ReadCheckpoint cannot read checkpoint");
+  }
+
+  fValues.reserve(NPoints);
+  fCompensation.reserve(NPoints);
+
+  double X[5];
+  for (uint64_t i = 0; i != NPoints; ++i) {
+    is.read((char*) X, 5 * sizeof(double));
+    fValues.push_back(T3DScalar(TVector3D(X[0], X[1], X[2]), X[3]));
+    fCompensation.push_back(X[4]);
+  }
+
+  int32_t W;
+  for (uint64_t i = 0; i != NWords; ++i) {
+    is.read((char*) &W, sizeof(int32_t));
+    fNotConverged.push_back((int) W);
+  }
+
+  if (!is) {
+    throw std::length_error("T3DScalarContainer::ReadCheckpoint cannot read checkpoint");
+  }
+
+  return;
+}
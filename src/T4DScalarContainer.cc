@@ -0,0 +1,346 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 11:18:47 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "T4DScalarContainer.h"
+
+#include <fstream>
+#include <cstdint>
+
+
+
+T4DScalarContainer::T4DScalarContainer ()
+{
+  // Default constructor
+}
+
+
+
+
+T4DScalarContainer::~T4DScalarContainer ()
+{
+  // Destruction!!!
+}
+
+
+
+
+void T4DScalarContainer::SetEnergies (std::vector<double> const& Energies)
+{
+  // Set the energies.  Must be done before any point is added
+
+  if (fX.size() != 0) {
+    throw std::length_error("T4DScalarContainer::SetEnergies points already added");
+  }
+
+  fEnergies = Energies;
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::AddPoint (TVector3D const& X)
+{
+  // Add a point with zero value at every energy
+
+  fX.push_back(X);
+  fValues.resize(fValues.size() + fEnergies.size(), 0);
+  fNotConverged.push_back(0);
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::AddToPoint (size_t const iPoint, size_t const iEnergy, double const V)
+{
+  // Add to the value of a point at one energy
+
+  if (iPoint >= fX.size() || iEnergy >= fEnergies.size()) {
+    throw std::length_error("T4DScalarContainer::AddToPoint index out of range");
+  }
+
+  fValues[iPoint * fEnergies.size() + iEnergy] += V;
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::SetNotConverged (size_t const iPoint)
+{
+  // Mark a point where at least one energy did not converge.  One flag per point so
+  // that threads calculating different points do not share one
+
+  if (iPoint >= fX.size()) {
+    throw std::length_error("T4DScalarContainer::SetNotConverged index out of range");
+  }
+
+  fNotConverged[iPoint] = 1;
+
+  return;
+}
+
+
+
+
+bool T4DScalarContainer::IsConverged (size_t const iPoint) const
+{
+  // Did every energy of this point converge
+
+  if (iPoint >= fX.size()) {
+    throw std::length_error("T4DScalarContainer::IsConverged index out of range");
+  }
+
+  return fNotConverged[iPoint] == 0;
+}
+
+
+
+
+bool T4DScalarContainer::AllConverged () const
+{
+  for (std::vector<char>::const_iterator it = fNotConverged.begin(); it != fNotConverged.end(); ++it) {
+    if (*it != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+
+void T4DScalarContainer::Clear ()
+{
+  // Clear all contents from the container
+
+  fEnergies.clear();
+  fX.clear();
+  fValues.clear();
+  fNotConverged.clear();
+
+  return;
+}
+
+
+
+
+size_t T4DScalarContainer::GetNPoints () const
+{
+  // Number of points in space
+  return fX.size();
+}
+
+
+
+
+size_t T4DScalarContainer::GetNEnergies () const
+{
+  // Number of energies
+  return fEnergies.size();
+}
+
+
+
+
+TVector3D const& T4DScalarContainer::GetPoint (size_t const iPoint) const
+{
+  // Position of a point
+
+  if (iPoint >= fX.size()) {
+    throw std::length_error("T4DScalarContainer::GetPoint index out of range");
+  }
+
+  return fX[iPoint];
+}
+
+
+
+
+double T4DScalarContainer::GetEnergy (size_t const iEnergy) const
+{
+  // One energy
+
+  if (iEnergy >= fEnergies.size()) {
+    throw std::length_error("T4DScalarContainer::GetEnergy index out of range");
+  }
+
+  return fEnergies[iEnergy];
+}
+
+
+
+
+std::vector<double> const& T4DScalarContainer::GetEnergies () const
+{
+  // All energies
+  return fEnergies;
+}
+
+
+
+
+double T4DScalarContainer::GetValue (size_t const iPoint, size_t const iEnergy) const
+{
+  // Value of a point at one energy
+
+  if (iPoint >= fX.size() || iEnergy >= fEnergies.size()) {
+    throw std::length_error("T4DScalarContainer::GetValue index out of range");
+  }
+
+  return fValues[iPoint * fEnergies.size() + iEnergy];
+}
+
+
+
+
+double const* T4DScalarContainer::GetSpectrumValues (size_t const iPoint) const
+{
+  // Values of a point at all energies, GetNEnergies() of them
+
+  if (iPoint >= fX.size()) {
+    throw std::length_error("T4DScalarContainer::GetSpectrumValues index out of range");
+  }
+
+  return &fValues[iPoint * fEnergies.size()];
+}
+
+
+
+
+void T4DScalarContainer::GetEnergySlice (size_t const iEnergy, T3DScalarContainer& Slice) const
+{
+  // Fill (an empty) Slice with the values of all points at one energy
+
+  if (iEnergy >= fEnergies.size()) {
+    throw std::length_error("T4DScalarContainer::GetEnergySlice index out of range");
+  }
+
+  size_t const NEnergies = fEnergies.size();
+  for (size_t i = 0; i != fX.size(); ++i) {
+    Slice.AddPoint(fX[i], fValues[i * NEnergies + iEnergy]);
+    if (fNotConverged[i]) {
+      Slice.SetNotConverged(Slice.GetNPoints() - 1);
+    }
+  }
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::GetSpectrum (size_t const iPoint, TSpectrumContainer& Spectrum) const
+{
+  // Fill Spectrum with the values of one point at all energies
+
+  Spectrum.Init(fEnergies);
+
+  double const* V = this->GetSpectrumValues(iPoint);
+  for (size_t k = 0; k != fEnergies.size(); ++k) {
+    Spectrum.SetFlux(k, V[k]);
+  }
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::WriteToFileText (std::string const& OutFileName,
+                                          int const Dimension) const
+{
+  // Write to file in text format.  The first line is the energies, then one line per
+  // point with its position (x1 x2 for Dimension 2, or x y z) and values at each energy
+
+  std::ofstream of(OutFileName.c_str());
+  if (!of.is_open()) {
+    throw std::ofstream::failure("cannot open output file");
+  }
+  of << std::scientific;
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("incorrect dimensions");
+  }
+
+  size_t const NEnergies = fEnergies.size();
+  for (size_t k = 0; k != NEnergies; ++k) {
+    of << (k == 0 ? "" : " ") << fEnergies[k];
+  }
+  of << "\n";
+
+  for (size_t i = 0; i != fX.size(); ++i) {
+    if (Dimension == 2) {
+      of << fX[i].GetX() << " " << fX[i].GetY();
+    } else {
+      of << fX[i].GetX() << " " << fX[i].GetY() << " " << fX[i].GetZ();
+    }
+    for (size_t k = 0; k != NEnergies; ++k) {
+      of << " " << fValues[i * NEnergies + k];
+    }
+    of << "\n";
+  }
+
+  of.close();
+
+  return;
+}
+
+
+
+
+void T4DScalarContainer::WriteToFileBinary (std::string const& OutFileName,
+                                            int const Dimension) const
+{
+  // Write in simple binary format: the number of points and energies (uint64_t), the
+  // energies, then for each point its position (2 or 3 values) and values at each
+  // energy, all as float
+
+  std::ofstream of(OutFileName.c_str(), std::ios::binary);
+  if (!of.is_open()) {
+    throw std::ofstream::failure("cannot open output file");
+  }
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("incorrect dimensions");
+  }
+
+  uint64_t const NPoints = (uint64_t) fX.size();
+  uint64_t const NEnergies = (uint64_t) fEnergies.size();
+  of.write((char*) &NPoints, sizeof(uint64_t));
+  of.write((char*) &NEnergies, sizeof(uint64_t));
+
+  float V = 0;
+  for (size_t k = 0; k != NEnergies; ++k) {
+    V = (float) fEnergies[k];
+    of.write((char*) &V, sizeof(float));
+  }
+
+  for (size_t i = 0; i != fX.size(); ++i) {
+    V = (float) fX[i].GetX();
+    of.write((char*) &V, sizeof(float));
+    V = (float) fX[i].GetY();
+    of.write((char*) &V, sizeof(float));
+    if (Dimension == 3) {
+      V = (float) fX[i].GetZ();
+      of.write((char*) &V, sizeof(float));
+    }
+    for (size_t k = 0; k != NEnergies; ++k) {
+      V = (float) fValues[i * NEnergies + k];
+      of.write((char*) &V, sizeof(float));
+    }
+  }
+
+  of.close();
+
+  return;
+}
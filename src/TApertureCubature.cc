@@ -0,0 +1,482 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 11:07:17 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TApertureCubature.h"
+#include "TOSCARSSR.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Largest depth of refinement, which keeps the lattice index in an int
+static int const kMaxDepth = 16;
+
+// Coarse cells of the rectangle (x1, x2) and circle (r, phi)
+static int const kRectangleCells1 = 2;
+static int const kRectangleCells2 = 2;
+static int const kCircleCells1    = 2;
+static int const kCircleCells2    = 8;
+
+// Values smaller than this fraction of the largest are held to the absolute tolerance
+// of the largest, so that nearly empty values (eg between harmonics) do not drive
+// the refinement
+static double const kFloor = 1e-3;
+
+
+
+TApertureCubature::TApertureCubature ()
+{
+  // Default constructor
+  fShape = kShape_Rectangle;
+  fStart1 = 0;
+  fStart2 = 0;
+  fStep1 = 0;
+  fStep2 = 0;
+  fArea = 0;
+  fNI = 0;
+  fNJ = 0;
+  fNValues = 0;
+  fNCells = 0;
+}
+
+
+
+
+TApertureCubature::~TApertureCubature ()
+{
+  // Destruction!
+}
+
+
+
+
+void TApertureCubature::InitRectangle (TVector3D const& Center,
+                                       TVector3D const& X1Vector,
+                                       TVector3D const& X2Vector,
+                                       double const Width1,
+                                       double const Width2,
+                                       int const MaxDepth)
+{
+  // Rectangle of Width1 along X1Vector and Width2 along X2Vector centered on Center.
+  // Cells are split at most MaxDepth times.
+
+  if (Width1 <= 0 || Width2 <= 0) {
+    throw std::invalid_argument("aperture width must be > 0");
+  }
+
+  fShape = kShape_Rectangle;
+  fCenter = Center;
+  fX1Vector = X1Vector.UnitVector();
+  fX2Vector = X2Vector.UnitVector();
+  fArea = Width1 * Width2;
+
+  this->Init(kRectangleCells1, kRectangleCells2, -Width1 / 2., Width1, -Width2 / 2., Width2, MaxDepth);
+
+  return;
+}
+
+
+
+
+void TApertureCubature::InitCircle (TVector3D const& Center,
+                                    TVector3D const& X1Vector,
+                                    TVector3D const& X2Vector,
+                                    double const Radius,
+                                    int const MaxDepth)
+{
+  // Circle of Radius centered on Center in the plane of X1Vector and X2Vector.  The
+  // angle phi is measured from X1Vector.  Cells are split at most MaxDepth times.
+
+  if (Radius <= 0) {
+    throw std::invalid_argument("aperture radius must be > 0");
+  }
+
+  fShape = kShape_Circle;
+  fCenter = Center;
+  fX1Vector = X1Vector.UnitVector();
+  fX2Vector = X2Vector.UnitVector();
+  fArea = TOSCARSSR::Pi() * Radius * Radius;
+
+  this->Init(kCircleCells1, kCircleCells2, 0, Radius, 0, TOSCARSSR::TwoPi(), MaxDepth);
+
+  return;
+}
+
+
+
+
+void TApertureCubature::Init (int const NCells1,
+                              int const NCells2,
+                              double const Start1,
+                              double const Extent1,
+                              double const Start2,
+                              double const Extent2,
+                              int const MaxDepth)
+{
+  // Set up the lattice for NCells1 x NCells2 coarse cells covering Extent1 and Extent2
+  // of the parameters from Start1 and Start2.  Each coarse cell is 4 * 2^MaxDepth
+  // lattice steps on a side so that the children of the smallest cells can still be
+  // tested.  All coarse cells are to be tested.
+
+  if (MaxDepth < 0 || MaxDepth > kMaxDepth) {
+    throw std::invalid_argument("aperture refinement depth must be between 0 and 16");
+  }
+
+  this->Clear();
+
+  int const Scale = 4 << MaxDepth;
+  fNI = NCells1 * Scale + 1;
+  fNJ = fShape == kShape_Circle ? NCells2 * Scale : NCells2 * Scale + 1;
+
+  fStart1 = Start1;
+  fStart2 = Start2;
+  fStep1 = Extent1 / (double) (NCells1 * Scale);
+  fStep2 = Extent2 / (double) (NCells2 * Scale);
+
+  for (int i1 = 0; i1 != NCells1; ++i1) {
+    for (int i2 = 0; i2 != NCells2; ++i2) {
+      this->AddCell(i1 * Scale, i2 * Scale, Scale);
+    }
+  }
+
+  return;
+}
+
+
+
+
+size_t TApertureCubature::GetPending (std::vector<TVector3D>& Points) const
+{
+  // Positions of the points still to be calculated.  Returns the number of points
+
+  Points.clear();
+  Points.reserve(fPending.size());
+
+  for (std::vector<size_t>::const_iterator it = fPending.begin(); it != fPending.end(); ++it) {
+    double const P1 = fStart1 + fStep1 * (double) fNodeI[*it];
+    double const P2 = fStart2 + fStep2 * (double) fNodeJ[*it];
+
+    if (fShape == kShape_Circle) {
+      Points.push_back(fCenter + (P1 * cos(P2)) * fX1Vector + (P1 * sin(P2)) * fX2Vector);
+    } else {
+      Points.push_back(fCenter + P1 * fX1Vector + P2 * fX2Vector);
+    }
+  }
+
+  return Points.size();
+}
+
+
+
+
+void TApertureCubature::SetPending (std::vector<double> const& Values, size_t const NValues)
+{
+  // Set the values of the pending points, NValues for each point in the order of
+  // GetPending()
+
+  if (fNValues == 0) {
+    fNValues = NValues;
+    fIntegral.assign(fNValues, 0);
+    fError.assign(fNValues, 0);
+  }
+
+  if (NValues != fNValues || Values.size() != fPending.size() * fNValues) {
+    throw std::length_error("number of values does not match the pending points");
+  }
+
+  fNodeValue.resize(fNodeI.size() * fNValues, 0);
+
+  for (size_t i = 0; i != fPending.size(); ++i) {
+    std::copy(Values.begin() + i * fNValues, Values.begin() + (i + 1) * fNValues, fNodeValue.begin() + fPending[i] * fNValues);
+  }
+  fPending.clear();
+
+  return;
+}
+
+
+
+
+size_t TApertureCubature::Refine (double const Tolerance)
+{
+  // Test the cells.  The error of the children's sum is estimated as 1/15 of its
+  // difference to the rule on the cell.  If the estimated errors of all cells add up to
+  // less than Tolerance times the integral for every value the integral is done.
+  // Otherwise a cell passes if for every value its error is within Tolerance times the
+  // integral times the fraction of the aperture area in the cell.  Cells which pass, or
+  // can not be split any further, add the children's sum to the integral; the others
+  // are replaced by their children.  Returns the number of new points to calculate.
+
+  if (fNCells == 0) {
+    return 0;
+  }
+
+  fNodeValue.resize(fNodeI.size() * fNValues, 0);
+
+  // Rule on each cell and on its children
+  std::vector<double> Parent(fNCells * fNValues);
+  std::vector<double> Children(fNCells * fNValues, 0);
+  std::vector<double> Sum;
+  std::vector<double> Total = fIntegral;
+  for (size_t iCell = 0; iCell != fNCells; ++iCell) {
+    int const I = fCellI[iCell];
+    int const J = fCellJ[iCell];
+    int const H = fCellSize[iCell] / 2;
+
+    this->Simpson(I, J, 2 * H, Sum);
+    std::copy(Sum.begin(), Sum.end(), Parent.begin() + iCell * fNValues);
+
+    for (int iChild = 0; iChild != 4; ++iChild) {
+      this->Simpson(I + (iChild / 2) * H, J + (iChild % 2) * H, H, Sum);
+      for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+        Children[iCell * fNValues + iValue] += Sum[iValue];
+      }
+    }
+
+    for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+      Total[iValue] += Children[iCell * fNValues + iValue];
+    }
+  }
+
+  // Scale of each value for the tolerance
+  double MaxTotal = 0;
+  for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+    MaxTotal = std::max(MaxTotal, fabs(Total[iValue]));
+  }
+  std::vector<double> Scale(fNValues);
+  for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+    Scale[iValue] = Tolerance * std::max(fabs(Total[iValue]), kFloor * MaxTotal);
+  }
+
+  // Estimated errors
+  std::vector<double> Error(fNCells * fNValues);
+  std::vector<double> TotalError = fError;
+  for (size_t i = 0; i != Error.size(); ++i) {
+    Error[i] = fabs(Parent[i] - Children[i]) / 15.;
+    TotalError[i % fNValues] += Error[i];
+  }
+  bool AllConverged = true;
+  for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+    if (TotalError[iValue] > Scale[iValue]) {
+      AllConverged = false;
+      break;
+    }
+  }
+
+  // Accept or split
+  std::vector<int> const CellI = fCellI;
+  std::vector<int> const CellJ = fCellJ;
+  std::vector<int> const CellSize = fCellSize;
+  size_t const NCells = fNCells;
+  fCellI.clear();
+  fCellJ.clear();
+  fCellSize.clear();
+  fNCells = 0;
+
+  for (size_t iCell = 0; iCell != NCells; ++iCell) {
+    int const H = CellSize[iCell] / 2;
+    double const CellArea = (2 * H * fStep1) * (2 * H * fStep2) * this->GetJacobian(CellI[iCell] + H);
+    double const Fraction = CellArea / fArea;
+
+    bool Converged = AllConverged;
+    if (!Converged) {
+      Converged = true;
+      for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+        if (Error[iCell * fNValues + iValue] > Scale[iValue] * Fraction) {
+          Converged = false;
+          break;
+        }
+      }
+    }
+
+    if (Converged || H < 4) {
+      for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+        fIntegral[iValue] += Children[iCell * fNValues + iValue];
+        fError[iValue] += Error[iCell * fNValues + iValue];
+      }
+    } else {
+      this->AddCell(CellI[iCell],     CellJ[iCell],     H);
+      this->AddCell(CellI[iCell] + H, CellJ[iCell],     H);
+      this->AddCell(CellI[iCell],     CellJ[iCell] + H, H);
+      this->AddCell(CellI[iCell] + H, CellJ[iCell] + H, H);
+    }
+  }
+
+  // New cells whose points all have zero weight can be tested straight away
+  if (fPending.empty() && fNCells > 0) {
+    return this->Refine(Tolerance);
+  }
+
+  return fPending.size();
+}
+
+
+
+
+std::vector<double> const& TApertureCubature::GetIntegral () const
+{
+  // Integral over the aperture of each value (once Refine() returns 0)
+  return fIntegral;
+}
+
+
+
+
+std::vector<double> const& TApertureCubature::GetError () const
+{
+  // Estimated error of the integral of each value
+  return fError;
+}
+
+
+
+
+double TApertureCubature::GetArea () const
+{
+  // Area of the aperture
+  return fArea;
+}
+
+
+
+
+size_t TApertureCubature::GetNPoints () const
+{
+  // Number of points on the lattice
+  return fNodeI.size();
+}
+
+
+
+
+size_t TApertureCubature::GetNCells () const
+{
+  // Number of cells still being tested
+  return fNCells;
+}
+
+
+
+
+void TApertureCubature::Clear ()
+{
+  // Clear all points and cells
+  fNodeIndex.clear();
+  fNodeI.clear();
+  fNodeJ.clear();
+  fPending.clear();
+  fNodeValue.clear();
+  fNValues = 0;
+
+  fCellI.clear();
+  fCellJ.clear();
+  fCellSize.clear();
+  fNCells = 0;
+
+  fIntegral.clear();
+  fError.clear();
+
+  return;
+}
+
+
+
+
+size_t TApertureCubature::AddNode (int const I, int const J)
+{
+  // Add the lattice point I, J if it does not exist yet and return its index.  New
+  // points are pending except those at the centre of the circle, which have zero
+  // weight.  J is periodic for the circle.
+
+  int const JJ = fShape == kShape_Circle ? J % fNJ : J;
+  uint64_t const Key = (uint64_t) I * (uint64_t) (fNJ + 1) + (uint64_t) JJ;
+
+  std::map<uint64_t, size_t>::const_iterator it = fNodeIndex.find(Key);
+  if (it != fNodeIndex.end()) {
+    return it->second;
+  }
+
+  size_t const Index = fNodeI.size();
+  fNodeIndex[Key] = Index;
+  fNodeI.push_back(I);
+  fNodeJ.push_back(JJ);
+
+  if (this->GetJacobian(I) != 0) {
+    fPending.push_back(Index);
+  }
+
+  return Index;
+}
+
+
+
+
+void TApertureCubature::AddCell (int const I, int const J, int const Size)
+{
+  // Add a cell to be tested and the 5x5 points needed for it and its children
+
+  int const Q = Size / 4;
+  for (int a = 0; a != 5; ++a) {
+    for (int b = 0; b != 5; ++b) {
+      this->AddNode(I + a * Q, J + b * Q);
+    }
+  }
+
+  fCellI.push_back(I);
+  fCellJ.push_back(J);
+  fCellSize.push_back(Size);
+  ++fNCells;
+
+  return;
+}
+
+
+
+
+void TApertureCubature::Simpson (int const I, int const J, int const Size, std::vector<double>& Sum) const
+{
+  // 3x3 Simpson rule on the cell with lower corner I, J and Size lattice steps
+
+  static double const Weight[3] = {1, 4, 1};
+
+  Sum.assign(fNValues, 0);
+
+  int const H = Size / 2;
+  double const Factor = (Size * fStep1) * (Size * fStep2) / 36.;
+
+  for (int a = 0; a != 3; ++a) {
+    double const Jacobian = this->GetJacobian(I + a * H);
+    if (Jacobian == 0) {
+      continue;
+    }
+    for (int b = 0; b != 3; ++b) {
+      int const JJ = fShape == kShape_Circle ? (J + b * H) % fNJ : J + b * H;
+      uint64_t const Key = (uint64_t) (I + a * H) * (uint64_t) (fNJ + 1) + (uint64_t) JJ;
+      size_t const Index = fNodeIndex.find(Key)->second;
+
+      double const W = Weight[a] * Weight[b] * Jacobian * Factor;
+      for (size_t iValue = 0; iValue != fNValues; ++iValue) {
+        Sum[iValue] += W * fNodeValue[Index * fNValues + iValue];
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+
+double TApertureCubature::GetJacobian (int const I) const
+{
+  // Area element factor at lattice coordinate I: r for the circle, 1 for the rectangle
+  if (fShape == kShape_Circle) {
+    return fStart1 + fStep1 * (double) I;
+  }
+  return 1;
+}
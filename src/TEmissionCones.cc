@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:10:13 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TEmissionCones.h"
+
+#include <cmath>
+
+
+
+TEmissionCones::TEmissionCones ()
+{
+  // Default constructor
+}
+
+
+
+
+TEmissionCones::~TEmissionCones ()
+{
+  // Destruction!
+}
+
+
+
+
+void TEmissionCones::Build (TParticleTrajectoryInterpolated const& Trajectory,
+                            size_t const NSegments,
+                            size_t const NSamplesPerSegment)
+{
+  // Split the interpolated trajectory into NSegments equal segments in time and
+  // find the bounding sphere and cone of each from NSamplesPerSegment + 1 points
+  // including the end points.  The sphere radius and cone half angle are enlarged
+  // by half of the largest step between samples to cover the trajectory between
+  // them.
+
+  this->Clear();
+
+  if (NSegments < 1 || NSamplesPerSegment < 1) {
+    return;
+  }
+
+  fCenter.reserve(NSegments);
+  fRadius.reserve(NSegments);
+  fDirection.reserve(NSegments);
+  fHalfAngle.reserve(NSegments);
+
+  double const TStart = Trajectory.GetTStart();
+  double const SegmentDT = (Trajectory.GetTStop() - TStart) / (double) NSegments;
+  double const SampleDT  = SegmentDT / (double) NSamplesPerSegment;
+
+  std::vector<TParticleTrajectoryPoint> Samples(NSamplesPerSegment + 1);
+
+  for (size_t iSegment = 0; iSegment != NSegments; ++iSegment) {
+    double const T0 = TStart + SegmentDT * (double) iSegment;
+
+    TVector3D Center(0, 0, 0);
+    TVector3D Direction(0, 0, 0);
+    for (size_t iS = 0; iS <= NSamplesPerSegment; ++iS) {
+      Samples[iS] = Trajectory.GetTrajectoryPoint(T0 + SampleDT * (double) iS);
+      Center += Samples[iS].GetX();
+      Direction += Samples[iS].GetB();
+    }
+    Center /= (double) Samples.size();
+    Direction = Direction.UnitVector();
+
+    double Radius = 0;
+    double HalfAngle = 0;
+    double MaxStep = 0;
+    double MaxTurn = 0;
+    for (size_t iS = 0; iS <= NSamplesPerSegment; ++iS) {
+      TVector3D const& X = Samples[iS].GetX();
+      TVector3D const& B = Samples[iS].GetB();
+
+      double const R = (X - Center).Mag();
+      if (R > Radius) {
+        Radius = R;
+      }
+
+      double const Angle = atan2(Direction.Cross(B).Mag(), Direction.Dot(B));
+      if (Angle > HalfAngle) {
+        HalfAngle = Angle;
+      }
+
+      if (iS > 0) {
+        TVector3D const& LastB = Samples[iS - 1].GetB();
+        double const Step = (X - Samples[iS - 1].GetX()).Mag();
+        double const Turn = atan2(LastB.Cross(B).Mag(), LastB.Dot(B));
+        if (Step > MaxStep) {
+          MaxStep = Step;
+        }
+        if (Turn > MaxTurn) {
+          MaxTurn = Turn;
+        }
+      }
+    }
+
+    fCenter.push_back(Center);
+    fRadius.push_back(Radius + 0.5 * MaxStep);
+    fDirection.push_back(Direction);
+    fHalfAngle.push_back(HalfAngle + 0.5 * MaxTurn);
+  }
+
+  return;
+}
+
+
+
+
+size_t TEmissionCones::GetNSegments () const
+{
+  return fCenter.size();
+}
+
+
+
+
+size_t TEmissionCones::GetSegment (size_t const iT, size_t const NTPoints) const
+{
+  // Segment of point iT of a trajectory level with NTPoints equally spaced points.
+  // Point iT is at the fraction (iT + 1/2) / NTPoints of the trajectory time
+
+  return ((2 * iT + 1) * fCenter.size()) / (2 * NTPoints);
+}
+
+
+
+
+TVector3D const& TEmissionCones::GetCenter (size_t const i) const
+{
+  return fCenter[i];
+}
+
+
+
+
+double TEmissionCones::GetRadius (size_t const i) const
+{
+  return fRadius[i];
+}
+
+
+
+
+size_t TEmissionCones::Visible (TVector3D const& Obs,
+                                double const ConeAngle,
+                                std::vector<char>& Mask) const
+{
+  // Mark the segments from which Obs is within ConeAngle of the direction of beta
+  // at some point.  For a point in the segment the direction to Obs is within
+  // asin(R/D) of the direction from the centre, D being the distance from the
+  // centre, and beta is within the half angle of the segment direction.  Returns
+  // the number of segments marked.  A negative ConeAngle marks all segments.
+
+  Mask.resize(fCenter.size());
+
+  size_t NVisible = 0;
+  for (size_t i = 0; i != fCenter.size(); ++i) {
+    TVector3D const D = Obs - fCenter[i];
+    double const Distance = D.Mag();
+
+    bool InCone = true;
+    if (ConeAngle >= 0 && Distance > fRadius[i]) {
+      double const Angle = atan2(fDirection[i].Cross(D).Mag(), fDirection[i].Dot(D));
+      InCone = Angle - fHalfAngle[i] - asin(fRadius[i] / Distance) <= ConeAngle;
+    }
+
+    Mask[i] = InCone ? 1 : 0;
+    if (InCone) {
+      ++NVisible;
+    }
+  }
+
+  return NVisible;
+}
+
+
+
+
+size_t TEmissionCones::Facing (TVector3D const& Obs,
+                               TVector3D const& Normal,
+                               std::vector<char>& Mask) const
+{
+  // Unmark the segments which lie entirely behind the plane through Obs with
+  // normal Normal, that is which cannot reach the front of a surface there.
+  // Returns the number of segments left marked.
+
+  size_t NFacing = 0;
+  for (size_t i = 0; i != fCenter.size(); ++i) {
+    if (Mask[i] && (fCenter[i] - Obs).Dot(Normal) >= fRadius[i]) {
+      Mask[i] = 0;
+    }
+    if (Mask[i]) {
+      ++NFacing;
+    }
+  }
+
+  return NFacing;
+}
+
+
+
+
+void TEmissionCones::Clear ()
+{
+  // Clear all segments
+  fCenter.clear();
+  fRadius.clear();
+  fDirection.clear();
+  fHalfAngle.clear();
+
+  return;
+}
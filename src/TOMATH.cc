@@ -10,12 +10,248 @@
 
 #include <cmath>
 #include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 
 namespace TOMATH
 {
 
 
+
+class TBesselKTable
+{
+  // Tables for fast evaluation of K_1/3, K_2/3, K_5/3 and the integral of K_5/3 from x
+  // to infinity.  For each octave [2^n, 2^(n+1)) split in NSub pieces the scaled
+  // function exp(x) * f(x) is approximated by a Chebyshev interpolant of NCoefficients
+  // points stored as a polynomial in the local variable t in [-1, 1].  The singularity
+  // at x = 0 is far from every piece in units of its width which gives the same fast
+  // convergence in every octave.  The interpolation nodes are evaluated with the
+  // integral representation of Kostroun with a fine step.  Below the first octave the
+  // small-x expansions are used and above the last the functions underflow to zero.
+
+  public:
+    enum TBesselKTable_Function {
+      kK_1_3,
+      kK_2_3,
+      kK_5_3,
+      kK_5_3_IntegralToInfty,
+      kNFunctions
+    };
+
+    TBesselKTable ()
+    {
+      fC.resize(kNFunctions * kNOctaves * kNSub * kNCoefficients);
+
+      // Chebyshev polynomials in monomial form
+      std::vector< std::vector<double> > T(kNCoefficients, std::vector<double>(kNCoefficients, 0));
+      T[0][0] = 1;
+      T[1][1] = 1;
+      for (int n = 2; n < kNCoefficients; ++n) {
+        for (int k = 0; k < kNCoefficients; ++k) {
+          T[n][k] = (k > 0 ? 2. * T[n-1][k-1] : 0) - T[n-2][k];
+        }
+      }
+
+      double const Pi = 3.14159265358979323846;
+      std::vector<double> Node(kNCoefficients);
+      std::vector< std::vector<double> > Values(kNFunctions, std::vector<double>(kNCoefficients));
+
+      for (int io = 0; io != kNOctaves; ++io) {
+        for (int is = 0; is != kNSub; ++is) {
+
+          // Center and half-width of this piece
+          double const Center = std::ldexp(1. + (2. * is + 1.) / (2. * kNSub), kOctaveMin + io);
+          double const HalfWidth = std::ldexp(1. / (2. * kNSub), kOctaveMin + io);
+
+          for (int j = 0; j != kNCoefficients; ++j) {
+            Node[j] = cos(Pi * (j + 0.5) / kNCoefficients);
+            double F[kNFunctions];
+            ScaledReference(Center + HalfWidth * Node[j], F);
+            for (int f = 0; f != kNFunctions; ++f) {
+              Values[f][j] = F[f];
+            }
+          }
+
+          for (int f = 0; f != kNFunctions; ++f) {
+            double* C = &fC[Index(f, io, is)];
+            for (int n = 0; n != kNCoefficients; ++n) {
+              double Cheb = 0;
+              for (int j = 0; j != kNCoefficients; ++j) {
+                Cheb += Values[f][j] * cos(Pi * n * (j + 0.5) / kNCoefficients);
+              }
+              Cheb *= (n == 0 ? 1. : 2.) / kNCoefficients;
+              for (int k = 0; k != kNCoefficients; ++k) {
+                C[k] += Cheb * T[n][k];
+              }
+            }
+          }
+        }
+      }
+
+      // Small-x expansion constants
+      fXMin = std::ldexp(1., kOctaveMin);
+      fXMax = std::ldexp(1., kOctaveMin + kNOctaves);
+      fIntegralK_1_3 = Pi / sqrt(3.);
+      for (int i = 0; i != 3; ++i) {
+        double const Nu = i == 0 ? 1. / 3. : (i == 1 ? 2. / 3. : 5. / 3.);
+        fSmallA[i] = std::tgamma(Nu) / 2. * pow(2., Nu);
+        fSmallB[i] = std::tgamma(-Nu) / 2. * pow(2., -Nu);
+      }
+    }
+
+    ~TBesselKTable ()
+    {
+    }
+
+    double Evaluate (int const f, double const x) const
+    {
+      if (!(x >= fXMin)) {
+        return EvaluateSmall(f, x);
+      }
+      if (x >= fXMax) {
+        return 0;
+      }
+
+      int io;
+      int is;
+      double const t = Locate(x, io, is);
+
+      return Polynomial(&fC[Index(f, io, is)], t) * exp(-x);
+    }
+
+    void EvaluatePair (int const f1, int const f2, double const x, double& F1, double& F2) const
+    {
+      // Two functions at the same x sharing the lookup and exponential
+      if (!(x >= fXMin)) {
+        F1 = EvaluateSmall(f1, x);
+        F2 = EvaluateSmall(f2, x);
+        return;
+      }
+      if (x >= fXMax) {
+        F1 = 0;
+        F2 = 0;
+        return;
+      }
+
+      int io;
+      int is;
+      double const t = Locate(x, io, is);
+      double const E = exp(-x);
+
+      F1 = Polynomial(&fC[Index(f1, io, is)], t) * E;
+      F2 = Polynomial(&fC[Index(f2, io, is)], t) * E;
+      return;
+    }
+
+  private:
+    static int const kOctaveMin = -30;
+    static int const kNOctaves = 40;
+    static int const kNSubBits = 2;
+    static int const kNSub = 1 << kNSubBits;
+    static int const kNCoefficients = 12;
+
+    size_t Index (int const f, int const io, int const is) const
+    {
+      return (((size_t) f * kNOctaves + io) * kNSub + is) * kNCoefficients;
+    }
+
+    static double Locate (double const x, int& io, int& is)
+    {
+      // Octave and piece from the bits of x, returns the local variable t in [-1, 1]
+      uint64_t Bits;
+      std::memcpy(&Bits, &x, sizeof(double));
+      io = (int) ((Bits >> 52) & 0x7ff) - 1023 - kOctaveMin;
+      is = (int) ((Bits >> (52 - kNSubBits)) & (kNSub - 1));
+      uint64_t const MantissaBits = (Bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+      double Mantissa;
+      std::memcpy(&Mantissa, &MantissaBits, sizeof(double));
+      return 2. * kNSub * (Mantissa - 1.) - (2. * is + 1.);
+    }
+
+    static double Polynomial (double const* C, double const t)
+    {
+      double P = C[kNCoefficients - 1];
+      for (int k = kNCoefficients - 2; k >= 0; --k) {
+        P = P * t + C[k];
+      }
+      return P;
+    }
+
+    double EvaluateSmall (int const f, double const x) const
+    {
+      // Leading terms of the expansion in I_-nu and I_nu, relative error of order x^2
+      if (x <= 0) {
+        return std::numeric_limits<double>::infinity();
+      }
+
+      if (f != kK_5_3_IntegralToInfty) {
+        return fSmallA[f] * pow(x, -(f == kK_1_3 ? 1. : (f == kK_2_3 ? 2. : 5.)) / 3.)
+             + fSmallB[f] * pow(x,  (f == kK_1_3 ? 1. : (f == kK_2_3 ? 2. : 5.)) / 3.);
+      }
+
+      // int_x^infty K_5/3 = 2 K_2/3(x) - int_0^infty K_1/3 + int_0^x K_1/3
+      double const x13 = cbrt(x);
+      return 2. * EvaluateSmall(kK_2_3, x) - fIntegralK_1_3 + fSmallA[kK_1_3] * 1.5 * x13 * x13 + fSmallB[kK_1_3] * 0.75 * x13 * x13 * x13 * x13;
+    }
+
+    static void ScaledReference (double const x, double* F)
+    {
+      // exp(x) times each function using the trapezoidal rule on
+      //   K_nu(x) = int_0^infty exp(-x cosh t) cosh(nu t) dt
+      //   int_x^infty K_nu = int_0^infty exp(-x cosh t) cosh(nu t) / cosh t dt
+      // The step is small compared to the width of the integrand so the error is far
+      // below double precision.  Terms are added until they are negligible.
+
+      double const h = 0.1 / sqrt(1. + x);
+
+      for (int f = 0; f != kNFunctions; ++f) {
+        F[f] = 0.5 * h;
+      }
+
+      for (int r = 1; ; ++r) {
+        double const t = r * h;
+        double const u = exp(t / 3.);
+        double const u2 = u * u;
+        double const u3 = u2 * u;
+        double const CoshT = 0.5 * (u3 + 1. / u3);
+        double const Exponent = x * (CoshT - 1.);
+        double const E = exp(-Exponent) * 0.5 * h;
+
+        F[kK_1_3] += E * (u + 1. / u);
+        F[kK_2_3] += E * (u2 + 1. / u2);
+        F[kK_5_3] += E * (u3 * u2 + 1. / (u3 * u2));
+        F[kK_5_3_IntegralToInfty] += E * (u3 * u2 + 1. / (u3 * u2)) / CoshT;
+
+        if (Exponent - 5. / 3. * t > 50.) {
+          break;
+        }
+      }
+
+      return;
+    }
+
+    std::vector<double> fC;
+
+    double fXMin;
+    double fXMax;
+    double fIntegralK_1_3;
+    double fSmallA[3];
+    double fSmallB[3];
+};
+
+
+
+
+static TBesselKTable const& GetBesselKTable ()
+{
+  // Built on first use (thread-safe initialization of a static)
+  static TBesselKTable const Table;
+  return Table;
+}
+
+
 double BesselK (double const nu, double const x)
 {
   // Compute the modified bessel function according to eqn 15 of:
@@ -115,6 +351,111 @@ double BesselK_IntegralToInfty (double const nu, double const x)
 
 
 
+double BesselK_1_3 (double const x)
+{
+  // Fast K_1/3(x)
+  return GetBesselKTable().Evaluate(TBesselKTable::kK_1_3, x);
+}
+
+
+
+
+double BesselK_2_3 (double const x)
+{
+  // Fast K_2/3(x)
+  return GetBesselKTable().Evaluate(TBesselKTable::kK_2_3, x);
+}
+
+
+
+
+double BesselK_5_3 (double const x)
+{
+  // Fast K_5/3(x)
+  return GetBesselKTable().Evaluate(TBesselKTable::kK_5_3, x);
+}
+
+
+
+
+double BesselK_5_3_IntegralToInfty (double const x)
+{
+  // Fast integral of K_5/3 from x to infinity
+  return GetBesselKTable().Evaluate(TBesselKTable::kK_5_3_IntegralToInfty, x);
+}
+
+
+
+
+void BesselK_1_3_2_3 (double const x, double& K_1_3, double& K_2_3)
+{
+  // Fast K_1/3(x) and K_2/3(x) together
+  GetBesselKTable().EvaluatePair(TBesselKTable::kK_1_3, TBesselKTable::kK_2_3, x, K_1_3, K_2_3);
+  return;
+}
+
+
+
+
+void BesselK_1_3 (double const* x, double* K, size_t const N)
+{
+  TBesselKTable const& Table = GetBesselKTable();
+  for (size_t i = 0; i < N; ++i) {
+    K[i] = Table.Evaluate(TBesselKTable::kK_1_3, x[i]);
+  }
+  return;
+}
+
+
+
+
+void BesselK_2_3 (double const* x, double* K, size_t const N)
+{
+  TBesselKTable const& Table = GetBesselKTable();
+  for (size_t i = 0; i < N; ++i) {
+    K[i] = Table.Evaluate(TBesselKTable::kK_2_3, x[i]);
+  }
+  return;
+}
+
+
+
+
+void BesselK_5_3 (double const* x, double* K, size_t const N)
+{
+  TBesselKTable const& Table = GetBesselKTable();
+  for (size_t i = 0; i < N; ++i) {
+    K[i] = Table.Evaluate(TBesselKTable::kK_5_3, x[i]);
+  }
+  return;
+}
+
+
+
+
+void BesselK_5_3_IntegralToInfty (double const* x, double* K, size_t const N)
+{
+  TBesselKTable const& Table = GetBesselKTable();
+  for (size_t i = 0; i < N; ++i) {
+    K[i] = Table.Evaluate(TBesselKTable::kK_5_3_IntegralToInfty, x[i]);
+  }
+  return;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 double BesselJ0 (double const x)
 {
   double ax,z;
@@ -257,6 +598,112 @@ double BesselJ (int const nu, double const x)
 
 
 
+void BesselJ_Sequence (int const NMax, double const x, double* J)
+{
+  // Fill J[n] = J_n(x) for n = 0 to NMax using Miller's backward
+  // recurrence normalized with J_0 + 2 sum J_2k = 1.  One pass gives
+  // all orders, so this is much cheaper than calling BesselJ() for
+  // each order when many are needed for the same argument.
+
+  if (NMax < 0) {
+    return;
+  }
+
+  double const ax = fabs(x);
+  if (ax == 0) {
+    J[0] = 1;
+    for (int n = 1; n <= NMax; ++n) {
+      J[n] = 0;
+    }
+    return;
+  }
+
+  // Start well above both the highest order needed and the argument
+  int const NLarger = NMax > (int) ax ? NMax : (int) ax;
+  int const NStart = 2 * ((NLarger + 16 + (int) sqrt(40. * NLarger)) / 2);
+
+  double const Big = 1e250;
+  double const BigInverse = 1e-250;
+
+  double bjp = 0;
+  double bj  = 1;
+  double sum = 0;
+  for (int j = NStart; j > 0; --j) {
+    double const bjm = 2. * j / ax * bj - bjp;
+    bjp = bj;
+    bj  = bjm;
+
+    // Rescale everything so far if values get too large
+    if (fabs(bj) > Big) {
+      bj  *= BigInverse;
+      bjp *= BigInverse;
+      sum *= BigInverse;
+      for (int n = j; n <= NMax; ++n) {
+        J[n] *= BigInverse;
+      }
+    }
+
+    if (j - 1 <= NMax) {
+      J[j - 1] = bj;
+    }
+    if (j - 1 > 0 && (j - 1) % 2 == 0) {
+      sum += bj;
+    }
+  }
+
+  double const Norm = 1. / (bj + 2. * sum);
+  for (int n = 0; n <= NMax; ++n) {
+    J[n] *= (x < 0 && n % 2 == 1) ? -Norm : Norm;
+  }
+
+  return;
+}
+
+
+
+
+
+void FilonWeights (double const Delta, std::complex<double>* W)
+{
+  // Weights for the integral over s in [0, 1] of g(s) exp(i Delta s) where g is
+  // the cubic Hermite interpolant of g(0), g'(0), g(1), g'(1):
+  //   integral = W[0] g(0) + W[1] g'(0) + W[2] g(1) + W[3] g'(1)
+  // The moments M[k] = int s^k exp(i Delta s) ds come from the power series for
+  // small Delta, where the upward recurrence cancels badly, and the recurrence
+  // otherwise.
+
+  std::complex<double> M[4];
+  std::complex<double> const iDelta(0, Delta);
+
+  if (fabs(Delta) < 1) {
+    for (int k = 0; k != 4; ++k) {
+      M[k] = 0;
+      std::complex<double> Term(1, 0);
+      for (int n = 0; n != 20; ++n) {
+        M[k] += Term / (double) (n + k + 1);
+        Term *= iDelta / (double) (n + 1);
+      }
+    }
+  } else {
+    std::complex<double> const E = std::exp(iDelta);
+    M[0] = (E - 1.) / iDelta;
+    for (int k = 1; k != 4; ++k) {
+      M[k] = (E - (double) k * M[k - 1]) / iDelta;
+    }
+  }
+
+  W[0] = M[0] - 3. * M[2] + 2. * M[3];
+  W[1] = M[1] - 2. * M[2] + M[3];
+  W[2] = 3. * M[2] - 2. * M[3];
+  W[3] = M[3] - M[2];
+
+  return;
+}
+
+
+
+
+
 
 
 
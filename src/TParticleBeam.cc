@@ -25,6 +25,7 @@ TParticleBeam::TParticleBeam ()
   // Default constructor
 
   fBeamDistribution = kBeamDistribution_None;
+  fSigmaEnergyGeV = 0;
 }
 
 
@@ -33,6 +34,7 @@ TParticleBeam::TParticleBeam ()
 TParticleBeam::TParticleBeam (std::string const& PredefinedBeamType, std::string const& Name, double const Weight)
 {
   fBeamDistribution = kBeamDistribution_None;
+  fSigmaEnergyGeV = 0;
 
   // Constructor given a predefined beam name
   this->SetPredefinedBeam(PredefinedBeamType);
@@ -49,6 +51,7 @@ TParticleBeam::TParticleBeam (std::string const& ParticleType, std::string const
   // Constructor given a particle type.
 
   fBeamDistribution = kBeamDistribution_None;
+  fSigmaEnergyGeV = 0;
 
   this->SetParticleType(ParticleType);
   this->SetName(Name);
@@ -67,6 +70,7 @@ TParticleBeam::TParticleBeam (std::string const& ParticleType, std::string const
   // Sets the initial time to 0
 
   fBeamDistribution = kBeamDistribution_None;
+  fSigmaEnergyGeV = 0;
 
   this->SetParticleType(ParticleType);
   this->SetName(Name);
@@ -88,6 +92,7 @@ TParticleBeam::TParticleBeam (std::string const& ParticleType, std::string const
   // Constructor given a particle type.
 
   fBeamDistribution = kBeamDistribution_None;
+  fSigmaEnergyGeV = 0;
 
   if (ParticleType == "custom") {
     this->SetParticleTypeCustom(ParticleType, Charge, Mass);
@@ -301,8 +306,9 @@ void TParticleBeam::SetTwissParametersAtX0 ()
   double const D = (fTwissLatticeReference - fX0).Mag();
   double const L = (fTwissLatticeReference - fX0).Dot(fU0) >= 0 ? D : -1. * D;
 
-  fTwissBetaX0 = fTwissBeta - 2 * L * fTwissAlpha + L * L * fTwissGamma;
-  fTwissAlphaX0 = fTwissAlpha - L * fTwissGamma;
+  // X0 is a distance L upstream of the reference, so this is a drift of -L
+  fTwissBetaX0 = fTwissBeta + 2 * L * fTwissAlpha + L * L * fTwissGamma;
+  fTwissAlphaX0 = fTwissAlpha + L * fTwissGamma;
   fTwissGammaX0 = fTwissGamma;
 
   return;
@@ -533,6 +539,26 @@ TVector2D TParticleBeam::GetEmittance () const
 
 
 
+TVector2D TParticleBeam::GetProjectedSigma (double const L) const
+{
+  // Return the rms beam size in the horizontal and vertical directions a distance L [m]
+  // downstream of the twiss lattice reference assuming a drift from the reference.  This is
+  // the size of the beam projected onto a plane at L: sigma^2 = emittance * beta(L)
+  // where beta(L) = beta - 2 L alpha + L^2 gamma.  A filament beam has zero size.
+
+  if (fBeamDistribution == kBeamDistribution_Filament) {
+    return TVector2D(0, 0);
+  }
+
+  double const BetaH = fTwissBeta[0] - 2. * L * fTwissAlpha[0] + L * L * fTwissGamma[0];
+  double const BetaV = fTwissBeta[1] - 2. * L * fTwissAlpha[1] + L * L * fTwissGamma[1];
+
+  return TVector2D(sqrt(fEmittance[0] * BetaH), sqrt(fEmittance[1] * BetaV));
+}
+
+
+
+
 void TParticleBeam::SetEta (TVector2D const& Eta)
 {
   // Set eta value
@@ -732,25 +758,14 @@ TParticleA TParticleBeam::GetNewParticle ()
   double const Gamma = ENew / TOSCARSSR::kgToGeV(this->GetM()) < 1 ? 1 : ENew / TOSCARSSR::kgToGeV(this->GetM());
   double const Beta = Gamma != 1 ? sqrt(1.0 - 1.0 / (Gamma * Gamma)) : 0;
 
-  double const Ellipse_HA = sqrt(fEmittance[0] * (fTwissBetaX0[0] + fTwissGammaX0[0]));   // aa
-  double const Ellipse_VA = sqrt(fEmittance[1] * (fTwissBetaX0[1] + fTwissGammaX0[1]));
-
-  double const Ellipse_HB = fEmittance[0] / Ellipse_HA; // ba
-  double const Ellipse_VB = fEmittance[1] / Ellipse_VA;
-
-  double const Angle_H = 0.5*atan(2.*fTwissAlphaX0[0] / (fTwissGammaX0[0] - fTwissBetaX0[0]));  // myangle
-  double const Angle_V = 0.5*atan(2.*fTwissAlphaX0[1] / (fTwissGammaX0[1] - fTwissBetaX0[1]));
-
-  double const RHA = Ellipse_HA * gRandomA->Normal();
-  double const RHB = Ellipse_HB * gRandomA->Normal();
-  double const RVA = Ellipse_VA * gRandomA->Normal();
-  double const RVB = Ellipse_VB * gRandomA->Normal();
-
-  double const HOffset  = RHA * cos(Angle_H) - RHB * sin(Angle_H);
-  double const HPOffset = RHA * sin(Angle_H) + RHB * cos(Angle_H);
+  // Sample the gaussian phase space with covariance emittance * [[beta, -alpha], [-alpha, gamma]]
+  // at X0: the offset has variance emittance * beta and the angle is correlated with it
+  // through -alpha / beta leaving an uncorrelated variance of emittance / beta
+  double const HOffset  = sqrt(fEmittance[0] * fTwissBetaX0[0]) * gRandomA->Normal();
+  double const HPOffset = -fTwissAlphaX0[0] / fTwissBetaX0[0] * HOffset + sqrt(fEmittance[0] / fTwissBetaX0[0]) * gRandomA->Normal();
 
-  double const VOffset  = RVA * cos(Angle_V) - RVB * sin(Angle_V);
-  double const VPOffset = RVA * sin(Angle_V) + RVB * cos(Angle_V);
+  double const VOffset  = sqrt(fEmittance[1] * fTwissBetaX0[1]) * gRandomA->Normal();
+  double const VPOffset = -fTwissAlphaX0[1] / fTwissBetaX0[1] * VOffset + sqrt(fEmittance[1] / fTwissBetaX0[1]) * gRandomA->Normal();
 
   // New X0 location for this particle
   TVector3D XNew = this->GetX0();
@@ -761,9 +776,11 @@ TParticleA TParticleBeam::GetNewParticle ()
 
   TVector3D BetaNew = this->GetU0() * Beta;
 
-  // UPDATE: Rotate about the horizontal and vertical beam axes (arbitrary)
+  // UPDATE: Rotate about the horizontal and vertical beam axes (arbitrary).  Rotating about
+  // the vertical turns U0 toward the horizontal, about the horizontal it turns U0 toward the
+  // negative vertical, hence the sign on the vertical angle
   BetaNew.RotateSelf(HPOffset, fVerticalDirection);
-  BetaNew.RotateSelf(VPOffset, fHorizontalDirection);
+  BetaNew.RotateSelf(-VPOffset, fHorizontalDirection);
 
   double    TNew = fT0;
 
@@ -8,6 +8,11 @@
 
 #include "TRandomA.h"
 
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
 // Global random generator
 TRandomA* gRandomA = new TRandomA();
 
@@ -62,3 +67,61 @@ double TRandomA::Uniform ()
 {
   return fUniformDist(*fMT);
 }
+
+
+
+
+void TRandomA::WriteState (std::ostream& os) const
+{
+  // Write the state of the generator and distributions (the normal distribution
+  // caches a value) so that the stream can be continued exactly with ReadState.
+  // The state is stored as a length followed by the standard text representation
+
+  std::ostringstream ss;
+  ss << *fMT << " " << fNormalDist << " " << fUniformDist;
+
+  std::string const State = ss.str();
+  uint64_t const N = (uint64_t) State.size();
+
+  os.write((char*) &N, sizeof(uint64_t));
+  os.write(State.c_str(), N);
+
+  return;
+}
+
+
+
+
+void TRandomA::ReadState (std::istream& is)
+{
+  // Read the state of the generator and distributions as written by WriteState
+
+  uint64_t N = 0;
+  is.read((char*) &N, sizeof(uint64_t));
+
+  // The engine is written as state_size + 1 unsigned 32-bit words, each of at most 10
+  // digits plus a separator, followed by the two distributions which are short.  Check
+  // the length against this before allocating so that a corrupt file is rejected.
+  uint64_t const NWords = (uint64_t) std::mt19937::state_size + 1;
+  uint64_t const NMin = 2 * NWords;
+  uint64_t const NMax = 11 * NWords + 512;
+  if (!is || N < NMin || N > NMax) {
+    throw std::length_error("TRandomA::ReadState state size does not match the generator");
+  }
+
+  std::string State(N, ' ');
+  is.read(&State[0], N);
+
+  if (!is) {
+    throw std::length_error("TRandomA::ReadState cannot read state");
+  }
+
+  std::istringstream ss(State);
+  ss >> *fMT >> fNormalDist >> fUniformDist;
+
+  if (ss.fail()) {
+    throw std::invalid_argument("TRandomA::ReadState state not understood");
+  }
+
+  return;
+}
@@ -0,0 +1,448 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 08:22:16 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TResultFile.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+
+
+TResultFile::TResultFile ()
+{
+  // Default constructor
+  fType = kResultFile_T3DScalar;
+  fNCoordinates = 0;
+  fWeight = 0;
+  fNParticles = 0;
+}
+
+
+
+
+TResultFile::~TResultFile ()
+{
+  // Destructor
+}
+
+
+
+
+void TResultFile::Init (TResultFile_Type const Type,
+                        int const NCoordinates,
+                        std::vector<double> const& Coordinates,
+                        std::vector<double> const& Values,
+                        double const Weight,
+                        uint64_t const NParticles)
+{
+  // Set the contents of this result
+  // Type         - Type of result
+  // NCoordinates - Number of coordinates for each point (1 for spectra, 3 for T3DScalar)
+  // Coordinates  - All coordinates, NCoordinates for each point
+  // Values       - Value for each point
+  // Weight       - Weight of this result when merged with others (eg number of particles)
+  // NParticles   - Number of particles this result represents
+
+  if (NCoordinates < 1 || Coordinates.size() != Values.size() * (size_t) NCoordinates) {
+    throw std::length_error("number of coordinates does not match number of values");
+  }
+
+  fType         = Type;
+  fNCoordinates = NCoordinates;
+  fCoordinates  = Coordinates;
+  fValues       = Values;
+  fWeight       = Weight;
+  fNParticles   = NParticles;
+
+  return;
+}
+
+
+
+
+void TResultFile::AppendToFile (std::string const& FileName) const
+{
+  // Append this result as a new chunk to the file.  If the file does not exist
+  // or is empty the header is written first.  If it exists the header must match.
+
+  bool HasHeader = false;
+
+  std::ifstream fi(FileName.c_str(), std::ios::binary);
+  if (fi.is_open() && fi.peek() != std::ifstream::traits_type::eof()) {
+    TResultFile_Type Type;
+    int NCoordinates;
+    uint64_t NPoints;
+    this->ReadHeader(fi, Type, NCoordinates, NPoints);
+
+    if (Type != fType || NCoordinates != fNCoordinates || NPoints != (uint64_t) this->GetNPoints()) {
+      throw std::invalid_argument("result file exists with a different type or number of points");
+    }
+    HasHeader = true;
+  }
+  fi.close();
+
+  std::ofstream of(FileName.c_str(), std::ios::binary | std::ios::app);
+  if (!of.is_open()) {
+    throw std::invalid_argument("cannot open result file for writing");
+  }
+
+  if (!HasHeader) {
+    this->WriteHeader(of);
+  }
+
+  of.write((char*) &fWeight,     sizeof(double));
+  of.write((char*) &fNParticles, sizeof(uint64_t));
+  of.write((char*) fValues.data(), fValues.size() * sizeof(double));
+
+  of.close();
+  if (!of) {
+    throw std::length_error("error writing result file");
+  }
+
+  return;
+}
+
+
+
+
+void TResultFile::WriteToFile (std::string const& FileName) const
+{
+  // Write this result as the only chunk in a new file
+
+  std::ofstream of(FileName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!of.is_open()) {
+    throw std::invalid_argument("cannot open result file for writing");
+  }
+
+  this->WriteHeader(of);
+
+  of.write((char*) &fWeight,     sizeof(double));
+  of.write((char*) &fNParticles, sizeof(uint64_t));
+  of.write((char*) fValues.data(), fValues.size() * sizeof(double));
+
+  of.close();
+  if (!of) {
+    throw std::length_error("error writing result file");
+  }
+
+  return;
+}
+
+
+
+
+void TResultFile::MergeFromFiles (std::vector<std::string> const& FileNames,
+                                  int const NThreads)
+{
+  // Merge all chunks in all files into this result.  The value at each point is the
+  // weighted mean of all chunks, the weight and number of particles are the totals.
+  // Files are split among threads, each of which reads its files one at a time and
+  // in fixed size blocks into its own compensated sum.  The partial sums are then
+  // combined pairwise.  Memory used is one sum per thread regardless of the number of
+  // files or chunks, and each thread has at most one file open.
+
+  if (FileNames.size() < 1) {
+    throw std::length_error("no files specified");
+  }
+
+  // Coordinates are taken from the first file
+  std::ifstream fi(FileNames[0].c_str(), std::ios::binary);
+  if (!fi.is_open()) {
+    throw std::invalid_argument("cannot open result file: " + FileNames[0]);
+  }
+
+  uint64_t NPoints;
+  this->ReadHeader(fi, fType, fNCoordinates, NPoints);
+
+  fCoordinates.resize(NPoints * fNCoordinates);
+  fi.read((char*) fCoordinates.data(), fCoordinates.size() * sizeof(double));
+  if (!fi) {
+    throw std::length_error("cannot read coordinates from result file: " + FileNames[0]);
+  }
+  fi.close();
+
+  // Number of threads to actually use
+  size_t const NFiles = FileNames.size();
+  size_t const NThreadsActual = NThreads < 1 ? 1 : std::min((size_t) NThreads, NFiles);
+
+  // Partial results for each thread
+  std::vector< std::vector<double> > Sum(NThreadsActual, std::vector<double>(NPoints, 0));
+  std::vector< std::vector<double> > Compensation(NThreadsActual, std::vector<double>(NPoints, 0));
+  std::vector<double>      Weight(NThreadsActual, 0);
+  std::vector<uint64_t>    NParticles(NThreadsActual, 0);
+  std::vector<std::string> Error(NThreadsActual, "");
+
+  // Number of files per thread plus remainder to be added to first threads
+  size_t const NPerThread = NFiles / NThreadsActual;
+  size_t const NRemainder = NFiles % NThreadsActual;
+
+  // Start threads
+  std::vector<std::thread> Threads;
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    size_t const iFirst = it < NRemainder ? NPerThread * it + it: NPerThread * it + NRemainder;
+    size_t const iLast  = it < NRemainder ? iFirst + NPerThread : iFirst + NPerThread - 1;
+
+    Threads.push_back(std::thread(&TResultFile::MergeFromFilesPartial,
+                                  this,
+                                  std::cref(FileNames),
+                                  iFirst,
+                                  iLast,
+                                  std::ref(Sum[it]),
+                                  std::ref(Compensation[it]),
+                                  std::ref(Weight[it]),
+                                  std::ref(NParticles[it]),
+                                  std::ref(Error[it])));
+  }
+
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    Threads[it].join();
+  }
+
+  for (size_t it = 0; it != NThreadsActual; ++it) {
+    if (Error[it] != "") {
+      throw std::invalid_argument(Error[it]);
+    }
+  }
+
+  // Pairwise reduction of the partial sums
+  for (size_t Stride = 1; Stride < NThreadsActual; Stride *= 2) {
+    for (size_t i = 0; i + Stride < NThreadsActual; i += 2 * Stride) {
+      size_t const j = i + Stride;
+      for (size_t ip = 0; ip != NPoints; ++ip) {
+        double const y = (Sum[j][ip] - Compensation[j][ip]) - Compensation[i][ip];
+        double const t = Sum[i][ip] + y;
+        Compensation[i][ip] = (t - Sum[i][ip]) - y;
+        Sum[i][ip] = t;
+      }
+      Weight[i] += Weight[j];
+      NParticles[i] += NParticles[j];
+    }
+  }
+
+  if (Weight[0] == 0) {
+    throw std::invalid_argument("total weight of result files is zero");
+  }
+
+  fWeight = Weight[0];
+  fNParticles = NParticles[0];
+  fValues.resize(NPoints);
+  for (size_t ip = 0; ip != NPoints; ++ip) {
+    fValues[ip] = Sum[0][ip] / fWeight;
+  }
+
+  return;
+}
+
+
+
+
+void TResultFile::MergeFromFilesPartial (std::vector<std::string> const& FileNames,
+                                         size_t const iFirst,
+                                         size_t const iLast,
+                                         std::vector<double>& Sum,
+                                         std::vector<double>& Compensation,
+                                         double& Weight,
+                                         uint64_t& NParticles,
+                                         std::string& Error) const
+{
+  // Add the weighted values of all chunks in files iFirst to iLast (inclusive) to Sum.
+  // Errors are returned in Error since this runs in its own thread.
+
+  // Number of doubles to read at a time
+  size_t const NBlock = 65536;
+  std::vector<double> Block(NBlock);
+
+  size_t const NPoints = Sum.size();
+
+  for (size_t i = iFirst; i <= iLast; ++i) {
+    std::ifstream fi(FileNames[i].c_str(), std::ios::binary);
+    if (!fi.is_open()) {
+      Error = "cannot open result file: " + FileNames[i];
+      return;
+    }
+
+    TResultFile_Type Type;
+    int NCoordinates;
+    uint64_t NPointsFile;
+    try {
+      this->ReadHeader(fi, Type, NCoordinates, NPointsFile);
+    } catch (std::exception& e) {
+      Error = std::string(e.what()) + ": " + FileNames[i];
+      return;
+    }
+
+    if (Type != fType || NCoordinates != fNCoordinates || NPointsFile != (uint64_t) NPoints) {
+      Error = "result file has a different type or number of points: " + FileNames[i];
+      return;
+    }
+
+    // Coordinates must match those of the first file
+    for (size_t j = 0; j < fCoordinates.size(); j += NBlock) {
+      size_t const N = std::min(NBlock, fCoordinates.size() - j);
+      fi.read((char*) Block.data(), N * sizeof(double));
+      if (!fi || std::memcmp(Block.data(), fCoordinates.data() + j, N * sizeof(double)) != 0) {
+        Error = "result file has different coordinates: " + FileNames[i];
+        return;
+      }
+    }
+
+    // Read all chunks
+    double   W;
+    uint64_t NP;
+    while (fi.read((char*) &W, sizeof(double))) {
+      fi.read((char*) &NP, sizeof(uint64_t));
+
+      for (size_t j = 0; j < NPoints; j += NBlock) {
+        size_t const N = std::min(NBlock, NPoints - j);
+        fi.read((char*) Block.data(), N * sizeof(double));
+        if (!fi) {
+          Error = "truncated chunk in result file: " + FileNames[i];
+          return;
+        }
+
+        for (size_t k = 0; k != N; ++k) {
+          double const y = W * Block[k] - Compensation[j + k];
+          double const t = Sum[j + k] + y;
+          Compensation[j + k] = (t - Sum[j + k]) - y;
+          Sum[j + k] = t;
+        }
+      }
+
+      Weight += W;
+      NParticles += NP;
+    }
+  }
+
+  return;
+}
+
+
+
+
+void TResultFile::ReadHeader (std::istream& is,
+                              TResultFile_Type& Type,
+                              int& NCoordinates,
+                              uint64_t& NPoints) const
+{
+  // Read and check the file header, leaving the stream at the coordinates
+
+  char    Magic[8];
+  int32_t Version = 0;
+  int32_t T = 0;
+  int32_t NC = 0;
+  int32_t Reserved = 0;
+
+  is.read(Magic, 8);
+  is.read((char*) &Version,  sizeof(int32_t));
+  is.read((char*) &T,        sizeof(int32_t));
+  is.read((char*) &NC,       sizeof(int32_t));
+  is.read((char*) &Reserved, sizeof(int32_t));
+  is.read((char*) &NPoints,  sizeof(uint64_t));
+
+  if (!is || std::strncmp(Magic, "OSCARSRF", 8) != 0) {
+    throw std::invalid_argument("not a valid result file");
+  }
+  if (Version != 1) {
+    throw std::invalid_argument("result file version not supported");
+  }
+
+  Type = (TResultFile_Type) T;
+  NCoordinates = (int) NC;
+
+  return;
+}
+
+
+
+
+void TResultFile::WriteHeader (std::ostream& os) const
+{
+  // Write the file header and coordinates
+
+  int32_t const  Version  = 1;
+  int32_t const  T        = (int32_t) fType;
+  int32_t const  NC       = (int32_t) fNCoordinates;
+  int32_t const  Reserved = 0;
+  uint64_t const NPoints  = (uint64_t) this->GetNPoints();
+
+  os.write("OSCARSRF", 8);
+  os.write((char*) &Version,  sizeof(int32_t));
+  os.write((char*) &T,        sizeof(int32_t));
+  os.write((char*) &NC,       sizeof(int32_t));
+  os.write((char*) &Reserved, sizeof(int32_t));
+  os.write((char*) &NPoints,  sizeof(uint64_t));
+  os.write((char*) fCoordinates.data(), fCoordinates.size() * sizeof(double));
+
+  return;
+}
+
+
+
+
+TResultFile::TResultFile_Type TResultFile::GetType () const
+{
+  // Get the type of result
+  return fType;
+}
+
+
+
+
+int TResultFile::GetNCoordinates () const
+{
+  // Get the number of coordinates for each point
+  return fNCoordinates;
+}
+
+
+
+
+size_t TResultFile::GetNPoints () const
+{
+  // Get the number of points
+  return fValues.size();
+}
+
+
+
+
+std::vector<double> const& TResultFile::GetCoordinates () const
+{
+  // Get all coordinates
+  return fCoordinates;
+}
+
+
+
+
+std::vector<double> const& TResultFile::GetValues () const
+{
+  // Get all values
+  return fValues;
+}
+
+
+
+
+double TResultFile::GetWeight () const
+{
+  // Get the total weight
+  return fWeight;
+}
+
+
+
+
+uint64_t TResultFile::GetNParticles () const
+{
+  // Get the total number of particles
+  return fNParticles;
+}
@@ -10,10 +10,12 @@
 #include "TSpectrumContainer.h"
 
 #include "TOSCARSSR.h"
+#include "TResultFile.h"
 
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <cstdint>
 
 
 
@@ -73,6 +75,10 @@ void TSpectrumContainer::Init (size_t const N, double const EFirst, double const
     throw std::length_error("no points specified");
   }
 
+  // One not-converged bit for each point
+  fNotConverged.clear();
+  fNotConverged.resize((N + 8 * sizeof(int) - 1) / (8 * sizeof(int)), 0);
+
   // If only one point just set it to the 'First' energy
   if (N == 1) {
     fSpectrumPoints[0].first = EFirst;
@@ -84,9 +90,6 @@ void TSpectrumContainer::Init (size_t const N, double const EFirst, double const
     fSpectrumPoints[i].first = EFirst + (ELast - EFirst) / (N - 1) * (double) (i);
   }
 
-  fNotConverged.clear();
-  fNotConverged.resize(fSpectrumPoints.size() / (8 * sizeof(int)), 0);
-
   return;
 }
 
@@ -109,7 +112,7 @@ void TSpectrumContainer::Init (std::vector<double> const& V)
   }
 
   fNotConverged.clear();
-  fNotConverged.resize(fSpectrumPoints.size() / (8 * sizeof(int)), 0);
+  fNotConverged.resize((fSpectrumPoints.size() + 8 * sizeof(int) - 1) / (8 * sizeof(int)), 0);
 
   return;
 }
@@ -222,6 +225,23 @@ void TSpectrumContainer::Scale (double const ScaleFactor)
 
 
 
+bool TSpectrumContainer::IsConverged (size_t const i) const
+{
+  // Is the converged bit for this point clear
+
+  size_t const VectorIndex = i / (8 * sizeof(int));
+  if (VectorIndex >= fNotConverged.size()) {
+    throw std::length_error("TSpectrumContainer::IsConverged index out of range");
+  }
+
+  int const Bit = (0x1 << (i % (8 * sizeof(int))));
+
+  return (fNotConverged[VectorIndex] & Bit) == 0x0;
+}
+
+
+
+
 bool TSpectrumContainer::AllConverged () const
 {
   for (std::vector<int>::const_iterator it = fNotConverged.begin(); it != fNotConverged.end(); ++it) {
@@ -547,3 +567,139 @@ void TSpectrumContainer::AverageFromFilesBinary (std::vector<std::string> const&
 
   return;
 }
+
+
+
+
+void TSpectrumContainer::WriteToFileChunked (std::string const& OutFileName,
+                                             double const Weight,
+                                             uint64_t const NParticles) const
+{
+  // Append the spectrum as a new chunk to a chunked result file (see TResultFile).
+  // The Weight is used when averaging chunks, typically the number of particles.
+
+  std::vector<double> Energies;
+  std::vector<double> Values;
+  Energies.reserve(fSpectrumPoints.size());
+  Values.reserve(fSpectrumPoints.size());
+
+  for (std::vector< std::pair<double, double> >::const_iterator it = fSpectrumPoints.begin(); it != fSpectrumPoints.end(); ++it) {
+    Energies.push_back(it->first);
+    Values.push_back(it->second);
+  }
+
+  TResultFile R;
+  R.Init(TResultFile::kResultFile_Spectrum, 1, Energies, Values, Weight, NParticles);
+  R.AppendToFile(OutFileName);
+
+  return;
+}
+
+
+
+
+void TSpectrumContainer::AverageFromFilesChunked (std::vector<std::string> const& Files,
+                                                  int const NThreads,
+                                                  std::string const& OutFileName)
+{
+  // Weighted average of all chunks in all chunked result files.  Files are read one at a
+  // time per thread in bounded memory.  If OutFileName is given the merged result is
+  // written there as a single chunk carrying the total weight and number of particles.
+
+  this->Clear();
+
+  TResultFile R;
+  R.MergeFromFiles(Files, NThreads);
+
+  if (R.GetType() != TResultFile::kResultFile_Spectrum) {
+    throw std::invalid_argument("result files are not of spectrum type");
+  }
+
+  std::vector<double> const& Energies = R.GetCoordinates();
+  std::vector<double> const& Values = R.GetValues();
+  for (size_t i = 0; i != Values.size(); ++i) {
+    this->AddPoint(Energies[i], Values[i]);
+  }
+
+  if (OutFileName != "") {
+    R.WriteToFile(OutFileName);
+  }
+
+  return;
+}
+
+
+
+
+void TSpectrumContainer::WriteCheckpoint (std::ostream& os) const
+{
+  // Write the full state of this container in binary (energies, flux, compensation, and
+  // not-converged flags) so that it can be restored exactly with ReadCheckpoint
+
+  uint64_t const NPoints = (uint64_t) fSpectrumPoints.size();
+  uint64_t const NWords  = (uint64_t) fNotConverged.size();
+
+  os.write((char*) &NPoints, sizeof(uint64_t));
+  os.write((char*) &NWords,  sizeof(uint64_t));
+
+  double X[3];
+  for (size_t i = 0; i != fSpectrumPoints.size(); ++i) {
+    X[0] = fSpectrumPoints[i].first;
+    X[1] = fSpectrumPoints[i].second;
+    X[2] = fCompensation[i];
+    os.write((char*) X, 3 * sizeof(double));
+  }
+
+  for (size_t i = 0; i != fNotConverged.size(); ++i) {
+    int32_t const W = (int32_t) fNotConverged[i];
+    os.write((char*) &W, sizeof(int32_t));
+  }
+
+  if (!os) {
+    throw std::length_error("TSpectrumContainer::WriteCheckpoint cannot write checkpoint");
+  }
+
+  return;
+}
+
+
+
+
+void TSpectrumContainer::ReadCheckpoint (std::istream& is)
+{
+  // Read the full state of this container as written by WriteCheckpoint.  Existing
+  // contents are replaced
+
+  this->Clear();
+
+  uint64_t NPoints = 0;
+  uint64_t NWords  = 0;
+
+  is.read((char*) &NPoints, sizeof(uint64_t));
+  is.read((char*) &NWords,  sizeof(uint64_t));
+  if (!is) {
+    throw std::length_error("TSpectrumContainer::ReadCheckpoint cannot read checkpoint");
+  }
+
+  fSpectrumPoints.reserve(NPoints);
+  fCompensation.reserve(NPoints);
+
+  double X[3];
+  for (uint64_t i = 0; i != NPoints; ++i) {
+    is.read((char*) X, 3 * sizeof(double));
+    fSpectrumPoints.push_back(std::make_pair(X[0], X[1]));
+    fCompensation.push_back(X[2]);
+  }
+
+  int32_t W;
+  for (uint64_t i = 0; i != NWords; ++i) {
+    is.read((char*) &W, sizeof(int32_t));
+    fNotConverged.push_back((int) W);
+  }
+
+  if (!is) {
+    throw std::length_error("TSpectrumContainer::ReadCheckpoint cannot read checkpoint");
+  }
+
+  return;
+}
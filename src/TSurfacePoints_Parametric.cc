@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:57:41 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TSurfacePoints_Parametric.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+
+TSurfacePoints_Parametric::TSurfacePoints_Parametric ()
+{
+  // Default constructor
+  fShape = kShape_Rectangle;
+  fUStart = 0;
+  fUStep = 0;
+  fNU = 0;
+  fVStart = 0;
+  fVStep = 0;
+  fNV = 0;
+}
+
+
+
+
+TSurfacePoints_Parametric::TSurfacePoints_Parametric (std::string const& Shape,
+                                                      std::vector<double> const& Parameters,
+                                                      double const UStart,
+                                                      double const UStop,
+                                                      int    const NU,
+                                                      double const VStart,
+                                                      double const VStop,
+                                                      int    const NV,
+                                                      TVector3D const& Rotations,
+                                                      TVector3D const& Translation,
+                                                      int    const Normal)
+{
+  // Constructor with the shape and grid, see Init()
+  this->Init(Shape, Parameters, UStart, UStop, NU, VStart, VStop, NV, Rotations, Translation, Normal);
+}
+
+
+
+
+TSurfacePoints_Parametric::~TSurfacePoints_Parametric ()
+{
+  // Destruction!
+}
+
+
+
+
+void TSurfacePoints_Parametric::Init (std::string const& Shape,
+                                      std::vector<double> const& Parameters,
+                                      double const UStart,
+                                      double const UStop,
+                                      int    const NU,
+                                      double const VStart,
+                                      double const VStop,
+                                      int    const NV,
+                                      TVector3D const& Rotations,
+                                      TVector3D const& Translation,
+                                      int    const Normal)
+{
+  // Generate the points of a shape on an NU x NV grid in u and v, end points
+  // included, u being the outer index.  Points and normals are rotated (about x,
+  // then y, then z) and then the points are translated.  If Normal is -1 the normals
+  // are reversed.
+  //
+  // Shape       Parameters      Position at (u, v)
+  // rectangle   -               (u, v, 0)
+  // curvedrectangle  R          u is the arc length on a cylinder of radius R along y
+  //                             whose axis is at z = R (flat for R = 0)
+  // cylinder    R               (R cos v, R sin v, u)
+  // sphere      R               (R cos u cos v, R sin u cos v, R sin v)
+  // torus       R, r            ((R + r cos u) cos v, (R + r cos u) sin v, r sin u)
+  // cone        r0, r1, L       cylinder with radius from r0 at u = -L/2 to r1 at u = +L/2
+  // disk        -               (u cos v, u sin v, 0)
+
+  std::string S = Shape;
+  std::transform(S.begin(), S.end(), S.begin(), ::tolower);
+
+  size_t NParameters = 0;
+  if (S == "rectangle") {
+    fShape = kShape_Rectangle;
+  } else if (S == "curvedrectangle") {
+    fShape = kShape_CurvedRectangle;
+    NParameters = 1;
+  } else if (S == "cylinder") {
+    fShape = kShape_Cylinder;
+    NParameters = 1;
+  } else if (S == "sphere") {
+    fShape = kShape_Sphere;
+    NParameters = 1;
+  } else if (S == "torus") {
+    fShape = kShape_Torus;
+    NParameters = 2;
+  } else if (S == "cone") {
+    fShape = kShape_Cone;
+    NParameters = 3;
+  } else if (S == "disk") {
+    fShape = kShape_Disk;
+  } else {
+    throw std::invalid_argument("not a valid parametric shape: rectangle curvedrectangle cylinder sphere torus cone disk");
+  }
+
+  if (Parameters.size() < NParameters) {
+    throw std::invalid_argument("not enough parameters for this parametric shape");
+  }
+  if (fShape == kShape_Cone && Parameters[2] == 0) {
+    throw std::invalid_argument("cone length must not be zero");
+  }
+  if (NU < 1 || NV < 1) {
+    throw std::invalid_argument("number of points in u and v must be >= 1");
+  }
+  if (Normal != -1 && Normal != 0 && Normal != 1) {
+    throw std::invalid_argument("normal must be -1, 0, or 1");
+  }
+
+  fParameters = Parameters;
+  fUStart = UStart;
+  fUStep  = NU > 1 ? (UStop - UStart) / (double) (NU - 1) : 0;
+  fNU     = NU;
+  fVStart = VStart;
+  fVStep  = NV > 1 ? (VStop - VStart) / (double) (NV - 1) : 0;
+  fNV     = NV;
+
+  size_t const NPoints = (size_t) NU * (size_t) NV;
+  fX.resize(NPoints);
+  fY.resize(NPoints);
+  fZ.resize(NPoints);
+  fNX.resize(NPoints);
+  fNY.resize(NPoints);
+  fNZ.resize(NPoints);
+
+  TVector3D X;
+  TVector3D N;
+  for (size_t i = 0; i != NPoints; ++i) {
+    this->Evaluate(this->GetX1(i), this->GetX2(i), X, N);
+
+    X.RotateSelfXYZ(Rotations);
+    N.RotateSelfXYZ(Rotations);
+    X += Translation;
+    if (Normal == -1) {
+      N *= -1;
+    }
+
+    fX[i]  = X.GetX();
+    fY[i]  = X.GetY();
+    fZ[i]  = X.GetZ();
+    fNX[i] = N.GetX();
+    fNY[i] = N.GetY();
+    fNZ[i] = N.GetZ();
+  }
+
+  return;
+}
+
+
+
+
+TSurfacePoint const TSurfacePoints_Parametric::GetPoint (size_t const i) const
+{
+  // Get the ith surface point
+  return TSurfacePoint(fX[i], fY[i], fZ[i], fNX[i], fNY[i], fNZ[i]);
+}
+
+
+
+
+size_t TSurfacePoints_Parametric::GetNPoints () const
+{
+  // Get the number of points
+  return fX.size();
+}
+
+
+
+
+double TSurfacePoints_Parametric::GetX1 (size_t const i) const
+{
+  // Get the u parameter of point i
+  return fUStart + fUStep * (double) (i / fNV);
+}
+
+
+
+
+double TSurfacePoints_Parametric::GetX2 (size_t const i) const
+{
+  // Get the v parameter of point i
+  return fVStart + fVStep * (double) (i % fNV);
+}
+
+
+
+
+void TSurfacePoints_Parametric::GetArrays (size_t const iFirst,
+                                           size_t const N,
+                                           double* X,
+                                           double* Y,
+                                           double* Z,
+                                           double* NX,
+                                           double* NY,
+                                           double* NZ) const
+{
+  // Copy a range of positions and normals from the stored arrays
+
+  if (N == 0) {
+    return;
+  }
+  if (iFirst + N > fX.size()) {
+    throw std::out_of_range("range beyond the end of the surface");
+  }
+
+  std::copy(fX.begin() + iFirst, fX.begin() + iFirst + N, X);
+  std::copy(fY.begin() + iFirst, fY.begin() + iFirst + N, Y);
+  std::copy(fZ.begin() + iFirst, fZ.begin() + iFirst + N, Z);
+  if (NX != 0x0) {
+    std::copy(fNX.begin() + iFirst, fNX.begin() + iFirst + N, NX);
+    std::copy(fNY.begin() + iFirst, fNY.begin() + iFirst + N, NY);
+    std::copy(fNZ.begin() + iFirst, fNZ.begin() + iFirst + N, NZ);
+  }
+
+  return;
+}
+
+
+
+
+int TSurfacePoints_Parametric::GetNU () const
+{
+  // Get the number of points in u
+  return fNU;
+}
+
+
+
+
+int TSurfacePoints_Parametric::GetNV () const
+{
+  // Get the number of points in v
+  return fNV;
+}
+
+
+
+
+void TSurfacePoints_Parametric::Evaluate (double const U, double const V, TVector3D& X, TVector3D& N) const
+{
+  // Position and unit normal of the shape at U, V before rotation and translation.
+  // Normals are those of oscars.parametric_surfaces (inward for closed shapes).
+
+  switch (fShape) {
+    case kShape_Rectangle:
+      X.SetXYZ(U, V, 0);
+      N.SetXYZ(0, 0, 1);
+      break;
+    case kShape_CurvedRectangle:
+      {
+        double const R = fParameters[0];
+        if (R == 0) {
+          X.SetXYZ(U, V, 0);
+          N.SetXYZ(0, 0, 1);
+        } else {
+          X.SetXYZ(R * sin(U / R), V, R * (1 - cos(U / R)));
+          N.SetXYZ(-sin(U / R), 0, cos(U / R));
+        }
+      }
+      break;
+    case kShape_Cylinder:
+      X.SetXYZ(fParameters[0] * cos(V), fParameters[0] * sin(V), U);
+      N.SetXYZ(-cos(V), -sin(V), 0);
+      break;
+    case kShape_Sphere:
+      X.SetXYZ(fParameters[0] * cos(U) * cos(V), fParameters[0] * sin(U) * cos(V), fParameters[0] * sin(V));
+      N.SetXYZ(-cos(U) * cos(V), -sin(U) * cos(V), -sin(V));
+      break;
+    case kShape_Torus:
+      {
+        double const RR = fParameters[0] + fParameters[1] * cos(U);
+        X.SetXYZ(RR * cos(V), RR * sin(V), fParameters[1] * sin(U));
+
+        // The normal is along r RR (-cos u cos v, -cos u sin v, -sin u), which is
+        // kept finite where r or RR is zero
+        double const Sign = (fParameters[1] < 0 ? -1 : 1) * (RR < 0 ? -1 : 1);
+        N.SetXYZ(-Sign * cos(U) * cos(V), -Sign * cos(U) * sin(V), -Sign * sin(U));
+      }
+      break;
+    case kShape_Cone:
+      {
+        double const L = fParameters[2];
+        double const Slope = (fParameters[1] - fParameters[0]) / L;
+        double const R = fParameters[0] + Slope * (U + L / 2.);
+        X.SetXYZ(R * cos(V), R * sin(V), U);
+
+        // The normal is along R (-cos v, -sin v, slope).  At the apex (R = 0) take the
+        // limit from the rest of the cone so it stays finite
+        double const Sign = R != 0 ? (R > 0 ? 1 : -1) : (fParameters[0] + fParameters[1] >= 0 ? 1 : -1);
+        N.SetXYZ(-Sign * cos(V), -Sign * sin(V), Sign * Slope);
+        N = N.UnitVector();
+      }
+      break;
+    case kShape_Disk:
+      X.SetXYZ(U * cos(V), U * sin(V), 0);
+      N.SetXYZ(0, 0, 1);
+      break;
+  }
+
+  return;
+}
@@ -326,3 +326,97 @@ double TSurfacePoints_Rectangle::GetElementArea () const
   // UPDATE: calculate area from vectors for skew
   return fX1StepSize * fX2StepSize;
 }
+
+
+
+
+int TSurfacePoints_Rectangle::GetNX1 () const
+{
+  // Get the number of points in X1
+  return fNX1;
+}
+
+
+
+
+int TSurfacePoints_Rectangle::GetNX2 () const
+{
+  // Get the number of points in X2
+  return fNX2;
+}
+
+
+
+
+int TSurfacePoints_Rectangle::GetNormal () const
+{
+  // Get the normal direction flag (-1, 0, 1)
+  return fNormal;
+}
+
+
+
+
+TVector3D const& TSurfacePoints_Rectangle::GetX1Vector () const
+{
+  // Get the step vector in X1
+  return fX1Vector;
+}
+
+
+
+
+TVector3D const& TSurfacePoints_Rectangle::GetX2Vector () const
+{
+  // Get the step vector in X2
+  return fX2Vector;
+}
+
+
+
+
+TVector3D const& TSurfacePoints_Rectangle::GetStartVector () const
+{
+  // Get the position of the first point
+  return fStartVector;
+}
+
+
+
+
+TVector3D TSurfacePoints_Rectangle::GetCenter () const
+{
+  // Get the center of the rectangle
+  return fStartVector + fX1Vector * ((fNX1 - 1) / 2.) + fX2Vector * ((fNX2 - 1) / 2.);
+}
+
+
+
+
+void TSurfacePoints_Rectangle::GetPadded (int const NPadX1, int const NPadX2, TSurfacePoints_Rectangle& Padded) const
+{
+  // Set Padded to a rectangle with the same step vectors and center as this one, but extended
+  // by NPadX1 and NPadX2 points on either side in X1 and X2.  Point (i1, i2) of this
+  // rectangle is point (i1 + NPadX1, i2 + NPadX2) of the padded one
+
+  if (fNX1 < 2 || fNX2 < 2) {
+    throw std::length_error("rectangle must have at least 2 points in each dimension to pad");
+  }
+  if (NPadX1 < 0 || NPadX2 < 0) {
+    throw std::out_of_range("padding must be >= 0");
+  }
+
+  int const NX1 = fNX1 + 2 * NPadX1;
+  int const NX2 = fNX2 + 2 * NPadX2;
+
+  TVector3D const X0 = fStartVector - fX1Vector * NPadX1 - fX2Vector * NPadX2;
+  TVector3D const X1 = X0 + fX1Vector * (NX1 - 1);
+  TVector3D const X2 = X0 + fX2Vector * (NX2 - 1);
+
+  // Normal is kept from this rectangle rather than recomputed
+  Padded.Init(NX1, NX2, X0, X1, X2, 0);
+  Padded.fNormal = fNormal;
+  Padded.fNormalVector = fNormalVector;
+
+  return;
+}
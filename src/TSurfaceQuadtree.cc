@@ -0,0 +1,488 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:48:59 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TSurfaceQuadtree.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Largest depth of refinement, which keeps the lattice index in an int
+static int const kMaxDepth = 16;
+
+
+
+TSurfaceQuadtree::TSurfaceQuadtree ()
+{
+  // Default constructor
+  fScale = 1;
+  fNJ = 0;
+}
+
+
+
+
+TSurfaceQuadtree::~TSurfaceQuadtree ()
+{
+  // Destruction!
+}
+
+
+
+
+void TSurfaceQuadtree::Init (TSurfacePoints_Rectangle const& Surface, int const MaxDepth)
+{
+  // Start from the coarse grid of Surface.  The points of the coarse grid (in the
+  // order of Surface) and the midpoints of every coarse cell are pending.  Cells are
+  // split at most MaxDepth times.
+
+  if (Surface.GetNX1() < 2 || Surface.GetNX2() < 2) {
+    throw std::invalid_argument("adaptive refinement requires at least 2 points in each direction");
+  }
+  if (MaxDepth < 0 || MaxDepth > kMaxDepth) {
+    throw std::invalid_argument("adaptive refinement depth must be between 0 and 16");
+  }
+
+  this->Clear();
+
+  fSurface = Surface;
+  fScale = 1 << MaxDepth;
+  fNJ = (Surface.GetNX2() - 1) * fScale + 1;
+
+  for (int i1 = 0; i1 != Surface.GetNX1(); ++i1) {
+    for (int i2 = 0; i2 != Surface.GetNX2(); ++i2) {
+      this->AddNode(i1 * fScale, i2 * fScale);
+    }
+  }
+
+  // Coarse cells, cell (i1, i2) is number i1 * (NX2 - 1) + i2
+  for (int i1 = 0; i1 != Surface.GetNX1() - 1; ++i1) {
+    for (int i2 = 0; i2 != Surface.GetNX2() - 1; ++i2) {
+      this->AddCell(i1 * fScale, i2 * fScale, fScale);
+      if (fScale > 1) {
+        this->Test((int) fCellI.size() - 1);
+        fActive.push_back((int) fCellI.size() - 1);
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+
+size_t TSurfaceQuadtree::GetPending (TSurfacePoints_3D& Points) const
+{
+  // Add the points still to be calculated to Points.  Returns the number added.
+
+  TVector3D Normal;
+  Normal = fSurface.GetPoint(0).GetNormal();
+  for (size_t i = 0; i != fPending.size(); ++i) {
+    size_t const iNode = fPending[i];
+    TVector3D const X = fSurface.GetStartVector()
+                      + fSurface.GetX1Vector() * ((double) fNodeI[iNode] / (double) fScale)
+                      + fSurface.GetX2Vector() * ((double) fNodeJ[iNode] / (double) fScale);
+    Points.AddPoint(X, Normal);
+  }
+
+  return fPending.size();
+}
+
+
+
+
+void TSurfaceQuadtree::SetPending (T3DScalarContainer const& Values)
+{
+  // Set the values of the pending points, in the order given by GetPending()
+
+  if (Values.GetNPoints() != fPending.size()) {
+    throw std::length_error("number of values does not match the number of pending points");
+  }
+
+  for (size_t i = 0; i != fPending.size(); ++i) {
+    fNodeValue[fPending[i]] = Values.GetPoint(i).GetV();
+    fNodeConverged[fPending[i]] = Values.IsConverged(i) ? 1 : 0;
+  }
+  fPending.clear();
+
+  return;
+}
+
+
+
+
+size_t TSurfaceQuadtree::Refine (double const Tolerance)
+{
+  // Split every cell whose midpoints are known.  The children are refined further
+  // if a midpoint differs from the bilinear interpolation of the corners by more
+  // than Tolerance times the largest absolute value so far.  Leaves next to cells
+  // more than one level finer are refined as well, so the tree stays 2:1 balanced.
+  // Returns the number of points now pending.
+
+  double Scale = 0;
+  for (size_t i = 0; i != fNodeValue.size(); ++i) {
+    if (fabs(fNodeValue[i]) > Scale) {
+      Scale = fabs(fNodeValue[i]);
+    }
+  }
+
+  std::vector<int> Next;
+  for (size_t ia = 0; ia != fActive.size(); ++ia) {
+    int const iCell = fActive[ia];
+    int const I = fCellI[iCell];
+    int const J = fCellJ[iCell];
+    int const S = fCellSize[iCell];
+    int const H = S / 2;
+
+    double const V00 = this->GetValue(I,     J);
+    double const V01 = this->GetValue(I,     J + S);
+    double const V10 = this->GetValue(I + S, J);
+    double const V11 = this->GetValue(I + S, J + S);
+
+    double Error = fabs(this->GetValue(I + H, J + H) - 0.25 * (V00 + V01 + V10 + V11));
+    Error = std::max(Error, fabs(this->GetValue(I + H, J)     - 0.5 * (V00 + V10)));
+    Error = std::max(Error, fabs(this->GetValue(I + H, J + S) - 0.5 * (V01 + V11)));
+    Error = std::max(Error, fabs(this->GetValue(I,     J + H) - 0.5 * (V00 + V01)));
+    Error = std::max(Error, fabs(this->GetValue(I + S, J + H) - 0.5 * (V10 + V11)));
+
+    // Children in the same order as the coarse cells
+    int const iChild = (int) fCellI.size();
+    fCellChild[iCell] = iChild;
+    this->AddCell(I,     J,     H);
+    this->AddCell(I,     J + H, H);
+    this->AddCell(I + H, J,     H);
+    this->AddCell(I + H, J + H, H);
+
+    if (Error > Tolerance * Scale && H > 1) {
+      for (int k = 0; k != 4; ++k) {
+        this->Test(iChild + k);
+        Next.push_back(iChild + k);
+      }
+    }
+  }
+
+  // Balance.  Refining a leaf puts points on the edges of its larger neighbours, so
+  // repeat until no leaf changes
+  std::vector<char> Testing(fCellI.size(), 0);
+  for (size_t i = 0; i != Next.size(); ++i) {
+    Testing[Next[i]] = 1;
+  }
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (size_t iCell = 0; iCell != fCellI.size(); ++iCell) {
+      if (fCellChild[iCell] >= 0 || Testing[iCell] || !this->IsUnbalanced((int) iCell)) {
+        continue;
+      }
+      this->Test((int) iCell);
+      Next.push_back((int) iCell);
+      Testing[iCell] = 1;
+      Changed = true;
+    }
+  }
+
+  fActive = Next;
+
+  return fPending.size();
+}
+
+
+
+
+void TSurfaceQuadtree::Fill (T3DScalarContainer& Container, int const Dimension) const
+{
+  // Add all calculated points to Container, in the order they were calculated.
+  // Positions are in the local coordinates of the rectangle for Dimension 2.
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
+  }
+
+  int const NX1 = fSurface.GetNX1();
+  int const NX2 = fSurface.GetNX2();
+  double const Step1 = fSurface.GetX1Vector().Mag();
+  double const Step2 = fSurface.GetX2Vector().Mag();
+
+  for (size_t i = 0; i != fNodeValue.size(); ++i) {
+    double const U = (double) fNodeI[i] / (double) fScale;
+    double const V = (double) fNodeJ[i] / (double) fScale;
+    if (Dimension == 3) {
+      Container.AddPoint(fSurface.GetStartVector() + fSurface.GetX1Vector() * U + fSurface.GetX2Vector() * V, fNodeValue[i]);
+    } else {
+      Container.AddPoint(TVector3D((U - (NX1 - 1) / 2.) * Step1, (V - (NX2 - 1) / 2.) * Step2, 0), fNodeValue[i]);
+    }
+    if (!fNodeConverged[i]) {
+      Container.SetNotConverged(Container.GetNPoints() - 1);
+    }
+  }
+
+  return;
+}
+
+
+
+
+void TSurfaceQuadtree::Resample (int const NX1,
+                                 int const NX2,
+                                 T3DScalarContainer& Container,
+                                 int const Dimension) const
+{
+  // Add a uniform NX1 x NX2 grid over the same rectangle to Container, each value
+  // interpolated in the leaf cell it falls in, see Interpolate().  Same point order
+  // and coordinates as a TSurfacePoints_Rectangle of NX1 x NX2 points.
+
+  if (Dimension != 2 && Dimension != 3) {
+    throw std::out_of_range("Wrong dimension");
+  }
+  if (NX1 < 1 || NX2 < 1) {
+    throw std::invalid_argument("resampled grid must have at least 1 point in each direction");
+  }
+
+  int const NC1 = fSurface.GetNX1() - 1;
+  int const NC2 = fSurface.GetNX2() - 1;
+  double const Step1 = fSurface.GetX1Vector().Mag();
+  double const Step2 = fSurface.GetX2Vector().Mag();
+
+  for (int i1 = 0; i1 != NX1; ++i1) {
+    double const U = NX1 > 1 ? (double) (i1 * NC1) / (double) (NX1 - 1) : NC1 / 2.;
+    for (int i2 = 0; i2 != NX2; ++i2) {
+      double const V = NX2 > 1 ? (double) (i2 * NC2) / (double) (NX2 - 1) : NC2 / 2.;
+
+      double const Value = this->Interpolate(U, V);
+      if (Dimension == 3) {
+        Container.AddPoint(fSurface.GetStartVector() + fSurface.GetX1Vector() * U + fSurface.GetX2Vector() * V, Value);
+      } else {
+        Container.AddPoint(TVector3D((U - NC1 / 2.) * Step1, (V - NC2 / 2.) * Step2, 0), Value);
+      }
+    }
+  }
+
+  return;
+}
+
+
+
+
+size_t TSurfaceQuadtree::GetNPoints () const
+{
+  return fNodeValue.size();
+}
+
+
+
+
+size_t TSurfaceQuadtree::GetNCells () const
+{
+  return fCellI.size();
+}
+
+
+
+
+size_t TSurfaceQuadtree::GetNLeaves () const
+{
+  size_t N = 0;
+  for (size_t i = 0; i != fCellChild.size(); ++i) {
+    if (fCellChild[i] < 0) {
+      ++N;
+    }
+  }
+  return N;
+}
+
+
+
+
+void TSurfaceQuadtree::Clear ()
+{
+  // Clear all points and cells
+  fNodeIndex.clear();
+  fNodeI.clear();
+  fNodeJ.clear();
+  fNodeValue.clear();
+  fNodeConverged.clear();
+  fPending.clear();
+  fCellI.clear();
+  fCellJ.clear();
+  fCellSize.clear();
+  fCellChild.clear();
+  fActive.clear();
+
+  return;
+}
+
+
+
+
+size_t TSurfaceQuadtree::AddNode (int const I, int const J)
+{
+  // Index of the point at lattice position I, J.  New points are pending.
+
+  uint64_t const Key = (uint64_t) I * (uint64_t) fNJ + (uint64_t) J;
+  std::map<uint64_t, size_t>::const_iterator it = fNodeIndex.find(Key);
+  if (it != fNodeIndex.end()) {
+    return it->second;
+  }
+
+  size_t const iNode = fNodeValue.size();
+  fNodeIndex[Key] = iNode;
+  fNodeI.push_back(I);
+  fNodeJ.push_back(J);
+  fNodeValue.push_back(0);
+  fNodeConverged.push_back(1);
+  fPending.push_back(iNode);
+
+  return iNode;
+}
+
+
+
+
+void TSurfaceQuadtree::AddCell (int const I, int const J, int const Size)
+{
+  // Add a leaf cell.  Its corners are always known.
+
+  fCellI.push_back(I);
+  fCellJ.push_back(J);
+  fCellSize.push_back(Size);
+  fCellChild.push_back(-1);
+
+  return;
+}
+
+
+
+
+void TSurfaceQuadtree::Test (int const iCell)
+{
+  // Add the edge midpoints and centre of a cell to be calculated
+
+  int const I = fCellI[iCell];
+  int const J = fCellJ[iCell];
+  int const S = fCellSize[iCell];
+  int const H = S / 2;
+
+  this->AddNode(I + H, J);
+  this->AddNode(I,     J + H);
+  this->AddNode(I + H, J + H);
+  this->AddNode(I + H, J + S);
+  this->AddNode(I + S, J + H);
+
+  return;
+}
+
+
+
+
+bool TSurfaceQuadtree::IsUnbalanced (int const iCell) const
+{
+  // True if a leaf borders cells more than one level finer than itself.  Those have
+  // points at a quarter of its edges, whether already calculated or pending
+
+  int const I = fCellI[iCell];
+  int const J = fCellJ[iCell];
+  int const S = fCellSize[iCell];
+  int const Q = S / 4;
+
+  if (Q < 1) {
+    return false;
+  }
+
+  return this->HasNode(I + Q, J)     || this->HasNode(I + 3 * Q, J)     ||
+         this->HasNode(I + Q, J + S) || this->HasNode(I + 3 * Q, J + S) ||
+         this->HasNode(I,     J + Q) || this->HasNode(I,     J + 3 * Q) ||
+         this->HasNode(I + S, J + Q) || this->HasNode(I + S, J + 3 * Q);
+}
+
+
+
+
+bool TSurfaceQuadtree::HasNode (int const I, int const J) const
+{
+  // Is there a point at lattice position I, J
+
+  return fNodeIndex.find((uint64_t) I * (uint64_t) fNJ + (uint64_t) J) != fNodeIndex.end();
+}
+
+
+
+
+double TSurfaceQuadtree::GetValue (int const I, int const J) const
+{
+  // Value at a calculated lattice point
+
+  return fNodeValue[fNodeIndex.find((uint64_t) I * (uint64_t) fNJ + (uint64_t) J)->second];
+}
+
+
+
+
+double TSurfaceQuadtree::Interpolate (double const U, double const V) const
+{
+  // Interpolation in the leaf cell containing U, V (in steps of the coarse grid).
+  // Bilinear in the corners, plus a hat function along each edge which has a point
+  // at its midpoint from a finer neighbour.  The value on such an edge is then linear
+  // in each half, as in the neighbour, and there are no cracks between cells.  The
+  // 2:1 balance makes that the only point on the edge
+
+  int const NC1 = fSurface.GetNX1() - 1;
+  int const NC2 = fSurface.GetNX2() - 1;
+
+  int const C1 = std::max(0, std::min((int) floor(U), NC1 - 1));
+  int const C2 = std::max(0, std::min((int) floor(V), NC2 - 1));
+
+  double const X = U * (double) fScale;
+  double const Y = V * (double) fScale;
+
+  int iCell = C1 * NC2 + C2;
+  while (fCellChild[iCell] >= 0) {
+    int const H = fCellSize[iCell] / 2;
+    iCell = fCellChild[iCell] + (X >= fCellI[iCell] + H ? 2 : 0) + (Y >= fCellJ[iCell] + H ? 1 : 0);
+  }
+
+  int const I = fCellI[iCell];
+  int const J = fCellJ[iCell];
+  int const S = fCellSize[iCell];
+  double const Fx = (X - (double) I) / (double) S;
+  double const Fy = (Y - (double) J) / (double) S;
+
+  int const H = S / 2;
+
+  double const V00 = this->GetValue(I,     J);
+  double const V01 = this->GetValue(I,     J + S);
+  double const V10 = this->GetValue(I + S, J);
+  double const V11 = this->GetValue(I + S, J + S);
+
+  double Value = (1 - Fx) * (1 - Fy) * V00
+               + (1 - Fx) * Fy       * V01
+               + Fx       * (1 - Fy) * V10
+               + Fx       * Fy       * V11;
+
+  if (H < 1) {
+    return Value;
+  }
+
+  double const HatX = 1 - fabs(2 * Fx - 1);
+  double const HatY = 1 - fabs(2 * Fy - 1);
+
+  if (this->HasNode(I + H, J)) {
+    Value += (this->GetValue(I + H, J)     - 0.5 * (V00 + V10)) * HatX * (1 - Fy);
+  }
+  if (this->HasNode(I + H, J + S)) {
+    Value += (this->GetValue(I + H, J + S) - 0.5 * (V01 + V11)) * HatX * Fy;
+  }
+  if (this->HasNode(I, J + H)) {
+    Value += (this->GetValue(I,     J + H) - 0.5 * (V00 + V01)) * HatY * (1 - Fx);
+  }
+  if (this->HasNode(I + S, J + H)) {
+    Value += (this->GetValue(I + S, J + H) - 0.5 * (V10 + V11)) * HatY * Fx;
+  }
+
+  return Value;
+}
@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////
+//
+// agent <agent@local>
+//
+// Created on: Mon Oct 19 10:40:16 UTC 2026
+//
+////////////////////////////////////////////////////////////////////
+
+#include "TTriangle3DBVH.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Maximum number of triangles in a leaf and the fraction of the segment length at
+// either end in which intersections are not counted
+static size_t const kLeafSize = 4;
+static double const kEndFraction = 1e-9;
+
+// Depth after which nodes are split in half by count, which keeps the depth of the
+// tree, and so the traversal stack, bounded
+static int const kMaxMiddleSplitDepth = 32;
+static int const kMaxStack = 128;
+
+
+
+TTriangle3DBVH::TTriangle3DBVH ()
+{
+  // Default constructor
+}
+
+
+
+
+TTriangle3DBVH::TTriangle3DBVH (TTriangle3DContainer const& Triangles)
+{
+  // Constructor with the triangles
+  this->Build(Triangles);
+}
+
+
+
+
+TTriangle3DBVH::~TTriangle3DBVH ()
+{
+  // Destruction!
+}
+
+
+
+
+void TTriangle3DBVH::Build (TTriangle3DContainer const& Triangles)
+{
+  // Build the hierarchy.  Each node is split at the middle of the bounds of the
+  // triangle centres along the longest axis, or in half if all centres fall on
+  // one side or the node is deeper than kMaxMiddleSplitDepth, until it has no more
+  // than kLeafSize triangles.
+
+  this->Clear();
+
+  size_t const NTriangles = Triangles.GetNPoints();
+  if (NTriangles == 0) {
+    return;
+  }
+
+  std::vector<TVector3D> Min(NTriangles);
+  std::vector<TVector3D> Max(NTriangles);
+  std::vector<TVector3D> Center(NTriangles);
+  fIndex.resize(NTriangles);
+
+  for (size_t i = 0; i != NTriangles; ++i) {
+    TTriangle3D const T = Triangles.GetPoint(i);
+    for (int j = 0; j != 3; ++j) {
+      Min[i][j] = std::min(T[0][j], std::min(T[1][j], T[2][j]));
+      Max[i][j] = std::max(T[0][j], std::max(T[1][j], T[2][j]));
+    }
+    Center[i] = T.GetCenter();
+    fIndex[i] = i;
+  }
+
+  // Root node
+  fNodeMin.push_back(TVector3D(0, 0, 0));
+  fNodeMax.push_back(TVector3D(0, 0, 0));
+  fNodeChild.push_back(-1);
+  fNodeFirst.push_back(0);
+  fNodeCount.push_back(NTriangles);
+
+  std::vector<int> Stack(1, 0);
+  std::vector<int> StackDepth(1, 0);
+  while (!Stack.empty()) {
+    int const iNode = Stack.back();
+    int const Depth = StackDepth.back();
+    Stack.pop_back();
+    StackDepth.pop_back();
+
+    size_t const First = fNodeFirst[iNode];
+    size_t const Count = fNodeCount[iNode];
+
+    // Bounds of the triangles and of their centres
+    TVector3D NodeMin;
+    TVector3D NodeMax;
+    TVector3D CenterMin;
+    TVector3D CenterMax;
+    NodeMin = Min[fIndex[First]];
+    NodeMax = Max[fIndex[First]];
+    CenterMin = Center[fIndex[First]];
+    CenterMax = Center[fIndex[First]];
+    for (size_t k = First; k != First + Count; ++k) {
+      size_t const i = fIndex[k];
+      for (int j = 0; j != 3; ++j) {
+        NodeMin[j]   = std::min(NodeMin[j],   Min[i][j]);
+        NodeMax[j]   = std::max(NodeMax[j],   Max[i][j]);
+        CenterMin[j] = std::min(CenterMin[j], Center[i][j]);
+        CenterMax[j] = std::max(CenterMax[j], Center[i][j]);
+      }
+    }
+    fNodeMin[iNode] = NodeMin;
+    fNodeMax[iNode] = NodeMax;
+
+    if (Count <= kLeafSize) {
+      continue;
+    }
+
+    // Split along the longest axis of the centres
+    TVector3D const Extent = CenterMax - CenterMin;
+    int Axis = 0;
+    if (Extent[1] > Extent[Axis]) {
+      Axis = 1;
+    }
+    if (Extent[2] > Extent[Axis]) {
+      Axis = 2;
+    }
+    double const Middle = 0.5 * (CenterMin[Axis] + CenterMax[Axis]);
+
+    size_t NLeft = 0;
+    if (Depth < kMaxMiddleSplitDepth) {
+      for (size_t k = First; k != First + Count; ++k) {
+        if (Center[fIndex[k]][Axis] < Middle) {
+          std::swap(fIndex[k], fIndex[First + NLeft]);
+          ++NLeft;
+        }
+      }
+    }
+    if (NLeft == 0 || NLeft == Count) {
+      NLeft = Count / 2;
+    }
+
+    int const iChild = (int) fNodeMin.size();
+    fNodeChild[iNode] = iChild;
+    for (int iSide = 0; iSide != 2; ++iSide) {
+      fNodeMin.push_back(TVector3D(0, 0, 0));
+      fNodeMax.push_back(TVector3D(0, 0, 0));
+      fNodeChild.push_back(-1);
+      fNodeFirst.push_back(iSide == 0 ? First : First + NLeft);
+      fNodeCount.push_back(iSide == 0 ? NLeft : Count - NLeft);
+      Stack.push_back(iChild + iSide);
+      StackDepth.push_back(Depth + 1);
+    }
+  }
+
+  // Triangles in leaf order
+  fA.reserve(NTriangles);
+  fE1.reserve(NTriangles);
+  fE2.reserve(NTriangles);
+  for (size_t k = 0; k != NTriangles; ++k) {
+    TTriangle3D const T = Triangles.GetPoint(fIndex[k]);
+    fA.push_back(T[0]);
+    fE1.push_back(T[1] - T[0]);
+    fE2.push_back(T[2] - T[0]);
+  }
+
+  return;
+}
+
+
+
+
+bool TTriangle3DBVH::Occluded (TVector3D const& From,
+                               TVector3D const& To,
+                               size_t const Ignore) const
+{
+  // Is the line segment From -> To blocked by any triangle other than the one with
+  // index Ignore (in the order the triangles were given)?  Intersections at the
+  // very ends of the segment are not counted so that a surface does not shadow
+  // itself.
+
+  if (fNodeMin.empty()) {
+    return false;
+  }
+
+  TVector3D const D = To - From;
+  TVector3D const InverseD(1. / D.GetX(), 1. / D.GetY(), 1. / D.GetZ());
+
+  int Stack[kMaxStack];
+  int NStack = 0;
+  Stack[NStack++] = 0;
+  while (NStack > 0) {
+    int const iNode = Stack[--NStack];
+
+    if (!this->IntersectBox(iNode, From, InverseD)) {
+      continue;
+    }
+
+    if (fNodeChild[iNode] >= 0) {
+      Stack[NStack++] = fNodeChild[iNode];
+      Stack[NStack++] = fNodeChild[iNode] + 1;
+      continue;
+    }
+
+    for (size_t k = fNodeFirst[iNode]; k != fNodeFirst[iNode] + fNodeCount[iNode]; ++k) {
+      if (fIndex[k] != Ignore && this->IntersectTriangle(k, From, D)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+
+
+size_t TTriangle3DBVH::GetNTriangles () const
+{
+  return fIndex.size();
+}
+
+
+
+
+size_t TTriangle3DBVH::GetNNodes () const
+{
+  return fNodeMin.size();
+}
+
+
+
+
+void TTriangle3DBVH::Clear ()
+{
+  // Clear all nodes and triangles
+  fNodeMin.clear();
+  fNodeMax.clear();
+  fNodeChild.clear();
+  fNodeFirst.clear();
+  fNodeCount.clear();
+  fA.clear();
+  fE1.clear();
+  fE2.clear();
+  fIndex.clear();
+
+  return;
+}
+
+
+
+
+bool TTriangle3DBVH::IntersectBox (int const iNode,
+                                   TVector3D const& From,
+                                   TVector3D const& InverseD) const
+{
+  // Slab test of the segment From + t D, 0 <= t <= 1, against the node box
+
+  double TMin = 0;
+  double TMax = 1;
+  for (int j = 0; j != 3; ++j) {
+    double T0 = (fNodeMin[iNode][j] - From[j]) * InverseD[j];
+    double T1 = (fNodeMax[iNode][j] - From[j]) * InverseD[j];
+    if (T0 > T1) {
+      std::swap(T0, T1);
+    }
+    TMin = T0 > TMin ? T0 : TMin;
+    TMax = T1 < TMax ? T1 : TMax;
+    if (TMin > TMax) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+
+bool TTriangle3DBVH::IntersectTriangle (size_t const iT,
+                                        TVector3D const& From,
+                                        TVector3D const& D) const
+{
+  // Moller-Trumbore intersection of the segment From + t D with triangle iT (in
+  // leaf order)
+
+  TVector3D const P = D.Cross(fE2[iT]);
+  double const Determinant = fE1[iT].Dot(P);
+  if (Determinant == 0) {
+    return false;
+  }
+  double const InverseDeterminant = 1. / Determinant;
+
+  TVector3D const S = From - fA[iT];
+  double const U = S.Dot(P) * InverseDeterminant;
+  if (U < 0 || U > 1) {
+    return false;
+  }
+
+  TVector3D const Q = S.Cross(fE1[iT]);
+  double const V = D.Dot(Q) * InverseDeterminant;
+  if (V < 0 || U + V > 1) {
+    return false;
+  }
+
+  double const T = fE2[iT].Dot(Q) * InverseDeterminant;
+  return T > kEndFraction && T < 1 - kEndFraction;
+}
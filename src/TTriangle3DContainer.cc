@@ -1,6 +1,38 @@
 #include "TTriangle3DContainer.h"
 
 #include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+
+
+
+static void ValueToRGB (double const V,
+                        double const VMin,
+                        double const VMax,
+                        double& R,
+                        double& G,
+                        double& B)
+{
+  // Colour scale from blue (VMin) through cyan, green, and yellow to red (VMax).
+  // R, G, and B are from 0 to 1
+
+  double const F = VMax > VMin ? std::min(1., std::max(0., (V - VMin) / (VMax - VMin))) : 0;
+
+  R = std::min(1., std::max(0., 4 * F - 2));
+  G = std::min(1., std::max(0., F < 0.5 ? 4 * F : 4 - 4 * F));
+  B = std::min(1., std::max(0., 2 - 4 * F));
+
+  return;
+}
+
+
+
 
 TTriangle3DContainer::TTriangle3DContainer ()
 {
@@ -42,6 +74,9 @@ TTriangle3D TTriangle3DContainer::GetPoint (size_t const i) const
 void TTriangle3DContainer::Clear ()
 {
   fT.clear();
+  fVertices.clear();
+  fVertexNormals.clear();
+  fFaces.clear();
   fScale = 1;
   return;
 }
@@ -53,6 +88,10 @@ void TTriangle3DContainer::RotateSelfXYZ (TVector3D const& R)
   for (std::vector<TTriangle3D>::iterator it = fT.begin(); it != fT.end(); ++it) {
     it->RotateSelfXYZ(R);
   }
+  for (size_t i = 0; i != fVertices.size(); ++i) {
+    fVertices[i].RotateSelfXYZ(R);
+    fVertexNormals[i].RotateSelfXYZ(R);
+  }
   return;
 }
 
@@ -64,6 +103,9 @@ void TTriangle3DContainer::TranslateSelf (TVector3D const& T)
   for (std::vector<TTriangle3D>::iterator it = fT.begin(); it != fT.end(); ++it) {
     *it += T;
   }
+  for (size_t i = 0; i != fVertices.size(); ++i) {
+    fVertices[i] += T;
+  }
   return;
 }
 
@@ -72,42 +114,80 @@ void TTriangle3DContainer::TranslateSelf (TVector3D const& T)
 void TTriangle3DContainer::ReadSTLFile (std::string const& FileName,
                                         double const Scale)
 {
-  // Read an STL file and add all points to self
+  // Read a binary or ASCII STL file and add all triangles to self.  The file is
+  // read in one go and parsed from memory.  A file is binary if its size matches
+  // the number of triangles in the header.  Otherwise a file starting with
+  // "solid" is read as ASCII if it contains "facet" or "endsolid", since binary
+  // headers may also start with "solid".  Failing that a file at least as long
+  // as the triangles in its header is read as binary.
 
   // Open the input file
-  std::ifstream fi(FileName.c_str(), std::ios::binary);
+  std::ifstream fi(FileName.c_str(), std::ios::binary | std::ios::ate);
   if (!fi.is_open()) {
-    throw;
+    throw std::invalid_argument("cannot open STL file: " + FileName);
   }
 
-  char H[80];
-  fi.read(H, 80 * sizeof(char));
+  size_t const Size = (size_t) fi.tellg();
+  fi.seekg(0, std::ios::beg);
 
-  uint32_t NTriangles;
-  fi.read((char*) &NTriangles, sizeof(uint32_t));
+  std::vector<char> Buffer(Size + 1, 0);
+  if (Size > 0) {
+    fi.read(&Buffer[0], Size);
+  }
+  fi.close();
 
-  float N[3];
-  float A[3];
-  float B[3];
-  float C[3];
-  short S;
+  // Any welded vertices are no longer complete
+  fVertices.clear();
+  fVertexNormals.clear();
+  fFaces.clear();
 
-  for (int i = 0; i < NTriangles; ++i) {
-    fi.read((char*)  N, 3 * sizeof(float));
-    fi.read((char*)  A, 3 * sizeof(float));
-    fi.read((char*)  B, 3 * sizeof(float));
-    fi.read((char*)  C, 3 * sizeof(float));
-    fi.read((char*) &S ,    sizeof(short));
+  uint32_t NTriangles = 0;
+  if (Size >= 84) {
+    std::memcpy(&NTriangles, &Buffer[80], sizeof(uint32_t));
+  }
 
-    fT.push_back(TTriangle3D(A[0] * Scale, A[1] * Scale, A[2] * Scale,
-                             B[0] * Scale, B[1] * Scale, B[2] * Scale,
-                             C[0] * Scale, C[1] * Scale, C[2] * Scale,
-                             N[0], N[1], N[2]));
+  bool const SizeMatches = Size >= 84 && Size == 84 + 50 * (size_t) NTriangles;
+  bool const SizeFits    = Size >= 84 && Size >= 84 + 50 * (size_t) NTriangles;
+  bool const StartsSolid = Size >= 5 && std::strncmp(&Buffer[0], "solid", 5) == 0;
+
+  if (SizeMatches) {
+    this->ReadSTLBinary(&Buffer[0], Size, Scale);
+  } else if (StartsSolid && this->ReadSTLASCII(&Buffer[0], Size, Scale)) {
+    return;
+  } else if (SizeFits) {
+    this->ReadSTLBinary(&Buffer[0], Size, Scale);
+  } else {
+    throw std::invalid_argument("not a binary or ASCII STL file: " + FileName);
+  }
 
+  return;
+}
 
-  }
 
-  fi.close();
+
+
+void TTriangle3DContainer::ReadSTLBinary (char const* Buffer,
+                                          size_t const Size,
+                                          double const Scale)
+{
+  // Add the triangles of a binary STL file in memory: an 80 byte header, the
+  // number of triangles, then 50 bytes per triangle of normal, three vertices,
+  // and the attribute byte count
+
+  uint32_t NTriangles;
+  std::memcpy(&NTriangles, Buffer + 80, sizeof(uint32_t));
+
+  fT.reserve(fT.size() + NTriangles);
+
+  float V[12];
+  for (size_t i = 0; i < NTriangles; ++i) {
+    std::memcpy(V, Buffer + 84 + 50 * i, 12 * sizeof(float));
+
+    fT.push_back(TTriangle3D(V[3] * Scale, V[4]  * Scale, V[5]  * Scale,
+                             V[6] * Scale, V[7]  * Scale, V[8]  * Scale,
+                             V[9] * Scale, V[10] * Scale, V[11] * Scale,
+                             V[0], V[1], V[2]));
+  }
 
   return;
 }
@@ -115,49 +195,359 @@ void TTriangle3DContainer::ReadSTLFile (std::string const& FileName,
 
 
 
+bool TTriangle3DContainer::ReadSTLASCII (char const* Buffer,
+                                         size_t const Size,
+                                         double const Scale)
+{
+  // Add the triangles of an ASCII STL file in memory.  Only the keywords
+  // "normal", "vertex", and "endfacet" are used, everything else is skipped.
+  // Returns false, having added nothing, if there is no "facet" or "endsolid",
+  // in which case this is not an ASCII STL file.  Buffer must be null terminated
+
+  char const* P = Buffer;
+  char const* const End = Buffer + Size;
+
+  double N[3] = {0, 0, 0};
+  double V[9];
+  int NVertices = 0;
+  bool FoundKeyword = false;
+
+  while (P < End) {
+    // Next word
+    while (P < End && std::isspace((unsigned char) *P)) {
+      ++P;
+    }
+    char const* Word = P;
+    while (P < End && !std::isspace((unsigned char) *P)) {
+      ++P;
+    }
+    size_t const Length = P - Word;
+
+    if ((Length == 5 && std::strncmp(Word, "facet", 5) == 0) || (Length == 8 && std::strncmp(Word, "endsolid", 8) == 0)) {
+      FoundKeyword = true;
+    } else if (!FoundKeyword) {
+      // Nothing is parsed before the first facet
+      continue;
+    } else if (Length == 6 && std::strncmp(Word, "normal", 6) == 0) {
+      for (int j = 0; j != 3; ++j) {
+        char* Next;
+        N[j] = std::strtod(P, &Next);
+        P = Next;
+      }
+    } else if (Length == 6 && std::strncmp(Word, "vertex", 6) == 0) {
+      if (NVertices == 3) {
+        throw std::invalid_argument("ASCII STL facet with more than three vertices");
+      }
+      for (int j = 0; j != 3; ++j) {
+        char* Next;
+        V[3 * NVertices + j] = std::strtod(P, &Next) * Scale;
+        P = Next;
+      }
+      ++NVertices;
+    } else if (Length == 8 && std::strncmp(Word, "endfacet", 8) == 0) {
+      if (NVertices != 3) {
+        throw std::invalid_argument("ASCII STL facet without three vertices");
+      }
+      fT.push_back(TTriangle3D(V[0], V[1], V[2],
+                               V[3], V[4], V[5],
+                               V[6], V[7], V[8],
+                               N[0], N[1], N[2]));
+      NVertices = 0;
+    }
+  }
+
+  return FoundKeyword;
+}
+
+
+
+
 
 void TTriangle3DContainer::WriteSTLFile (std::string const& FileName)
 {
-  // Write an STL file and add all points to self
+  // Write an STL file of all triangles without colour
+  this->WriteSTLFile(FileName, std::vector<double>());
+  return;
+}
+
+
+
+
+void TTriangle3DContainer::WriteSTLFile (std::string const& FileName,
+                                         std::vector<double> const& Values)
+{
+  // Write a binary STL file of all triangles.  If there is one value per
+  // triangle the attribute bytes hold a colour from blue (lowest) to red
+  // (highest) in the VisCAM/SolidView convention: bit 15 set and 5 bits each of
+  // red, green, and blue.
 
   // Open the output file
   std::ofstream fi(FileName.c_str(), std::ios::binary);
   if (!fi.is_open()) {
-    std::cout << "file not open" << std::endl;
-    throw;
+    throw std::invalid_argument("cannot open STL output file: " + FileName);
   }
 
   char H[80];
-  sprintf(H, "%s", "OSCARS OSCARS OSCARS OSCARS OSCARS   ");
+  std::memset(H, ' ', 80);
+  std::memcpy(H, "OSCARS", 6);
   fi.write(H, 80 * sizeof(char));
-  std::cout << "brinted" << std::endl;
 
-  uint32_t NTriangles = (uint32_t) fT.size();;
+  uint32_t NTriangles = (uint32_t) fT.size();
   fi.write((char*) &NTriangles, sizeof(uint32_t));
 
-  float N[3];
-  float A[3];
-  float B[3];
-  float C[3];
-  short S = 0;
+  bool const UseColour = Values.size() == fT.size() && !Values.empty();
+  double VMin = UseColour ? *std::min_element(Values.begin(), Values.end()) : 0;
+  double VMax = UseColour ? *std::max_element(Values.begin(), Values.end()) : 0;
+
+  // All triangles go through one buffer
+  std::vector<char> Buffer(50 * (size_t) NTriangles);
 
-  for (int i = 0; i < NTriangles; ++i) {
+  float V[12];
+  uint16_t S = 0;
+
+  for (size_t i = 0; i < NTriangles; ++i) {
 
     for (int j = 0; j != 3; ++j) {
-      A[j] = fT[i][0][j] * fScale;
-      B[j] = fT[i][1][j] * fScale;
-      C[j] = fT[i][2][j] * fScale;
-      N[j] = fT[i][3][j];
+      V[j]     = fT[i][3][j];
+      V[3 + j] = fT[i][0][j] * fScale;
+      V[6 + j] = fT[i][1][j] * fScale;
+      V[9 + j] = fT[i][2][j] * fScale;
+    }
+
+    if (UseColour) {
+      double R, G, B;
+      ValueToRGB(Values[i], VMin, VMax, R, G, B);
+      S = (uint16_t) (0x8000 | ((int) (R * 31 + 0.5) << 10) | ((int) (G * 31 + 0.5) << 5) | (int) (B * 31 + 0.5));
     }
 
-    fi.write((char*)  N, 3 * sizeof(float));
-    fi.write((char*)  A, 3 * sizeof(float));
-    fi.write((char*)  B, 3 * sizeof(float));
-    fi.write((char*)  C, 3 * sizeof(float));
-    fi.write((char*) &S ,    sizeof(short));
+    std::memcpy(&Buffer[50 * i], V, 12 * sizeof(float));
+    std::memcpy(&Buffer[50 * i + 48], &S, sizeof(uint16_t));
+  }
+
+  if (!Buffer.empty()) {
+    fi.write(&Buffer[0], Buffer.size());
   }
 
   fi.close();
 
   return;
 }
+
+
+
+
+void TTriangle3DContainer::WritePLYFile (std::string const& FileName,
+                                         std::vector<double> const& Values,
+                                         bool const PerVertex)
+{
+  // Write an ASCII PLY file of the welded mesh with a value and colour from blue
+  // (lowest) to red (highest) for each vertex (PerVertex) or each face.  The
+  // vertices are welded first if they are not already.
+
+  if (fFaces.size() != 3 * fT.size()) {
+    this->WeldVertices();
+  }
+
+  size_t const NValues = PerVertex ? fVertices.size() : fT.size();
+  if (Values.size() != NValues) {
+    throw std::length_error("number of values does not match the number of vertices or faces");
+  }
+
+  std::ofstream fo(FileName.c_str());
+  if (!fo.is_open()) {
+    throw std::invalid_argument("cannot open PLY output file: " + FileName);
+  }
+
+  double const VMin = Values.empty() ? 0 : *std::min_element(Values.begin(), Values.end());
+  double const VMax = Values.empty() ? 0 : *std::max_element(Values.begin(), Values.end());
+
+  fo << "ply\n"
+     << "format ascii 1.0\n"
+     << "comment OSCARS\n"
+     << "element vertex " << fVertices.size() << "\n"
+     << "property float x\n"
+     << "property float y\n"
+     << "property float z\n";
+  if (PerVertex) {
+    fo << "property float value\n"
+       << "property uchar red\n"
+       << "property uchar green\n"
+       << "property uchar blue\n";
+  }
+  fo << "element face " << fT.size() << "\n"
+     << "property list uchar int vertex_indices\n";
+  if (!PerVertex) {
+    fo << "property float value\n"
+       << "property uchar red\n"
+       << "property uchar green\n"
+       << "property uchar blue\n";
+  }
+  fo << "end_header\n";
+
+  fo << std::scientific;
+
+  double R, G, B;
+  for (size_t i = 0; i != fVertices.size(); ++i) {
+    fo << fVertices[i].GetX() * fScale << " " << fVertices[i].GetY() * fScale << " " << fVertices[i].GetZ() * fScale;
+    if (PerVertex) {
+      ValueToRGB(Values[i], VMin, VMax, R, G, B);
+      fo << " " << Values[i] << " " << (int) (R * 255 + 0.5) << " " << (int) (G * 255 + 0.5) << " " << (int) (B * 255 + 0.5);
+    }
+    fo << "\n";
+  }
+
+  for (size_t i = 0; i != fT.size(); ++i) {
+    fo << "3 " << fFaces[3 * i] << " " << fFaces[3 * i + 1] << " " << fFaces[3 * i + 2];
+    if (!PerVertex) {
+      ValueToRGB(Values[i], VMin, VMax, R, G, B);
+      fo << " " << Values[i] << " " << (int) (R * 255 + 0.5) << " " << (int) (G * 255 + 0.5) << " " << (int) (B * 255 + 0.5);
+    }
+    fo << "\n";
+  }
+
+  fo.close();
+
+  return;
+}
+
+
+
+
+void TTriangle3DContainer::WeldVertices (double const Tolerance)
+{
+  // Build the indexed mesh: vertices which are the same, or within Tolerance of
+  // an earlier vertex if Tolerance > 0, become one vertex.  The normal of a
+  // vertex is the area weighted mean of the normals of the triangles using it.
+
+  size_t const NCorners = 3 * fT.size();
+
+  fVertices.clear();
+  fVertexNormals.clear();
+  fFaces.assign(NCorners, 0);
+
+  if (Tolerance > 0) {
+    // Vertices are kept in a grid of cubes of side Tolerance.  A close vertex can
+    // be in any of the neighbouring cubes, so the cube of each corner and its 26
+    // neighbours are searched for the closest vertex within Tolerance
+    std::map< std::array<int64_t, 3>, std::vector<size_t> > Grid;
+    double const Tolerance2 = Tolerance * Tolerance;
+
+    for (size_t i = 0; i != NCorners; ++i) {
+      TVector3D const& X = fT[i / 3][i % 3];
+      std::array<int64_t, 3> Cell;
+      for (int j = 0; j != 3; ++j) {
+        Cell[j] = (int64_t) std::floor(X[j] / Tolerance);
+      }
+
+      size_t iVertex = NCorners;
+      double BestDistance2 = Tolerance2;
+      std::array<int64_t, 3> Neighbour;
+      for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dz = -1; dz <= 1; ++dz) {
+            Neighbour[0] = Cell[0] + dx;
+            Neighbour[1] = Cell[1] + dy;
+            Neighbour[2] = Cell[2] + dz;
+            std::map< std::array<int64_t, 3>, std::vector<size_t> >::const_iterator const it = Grid.find(Neighbour);
+            if (it == Grid.end()) {
+              continue;
+            }
+            for (size_t k = 0; k != it->second.size(); ++k) {
+              size_t const iV = it->second[k];
+              double const Distance2 = (fVertices[iV] - X).Mag2();
+              if (Distance2 < BestDistance2 || (Distance2 == BestDistance2 && iV < iVertex)) {
+                BestDistance2 = Distance2;
+                iVertex = iV;
+              }
+            }
+          }
+        }
+      }
+
+      if (iVertex == NCorners) {
+        iVertex = fVertices.size();
+        fVertices.push_back(X);
+        fVertexNormals.push_back(TVector3D(0, 0, 0));
+        Grid[Cell].push_back(iVertex);
+      }
+      fFaces[i] = iVertex;
+    }
+  } else {
+    // Key for each corner followed by the corner index.  Sorting brings equal
+    // vertices together
+    std::vector< std::array<int64_t, 4> > Keys(NCorners);
+    for (size_t i = 0; i != NCorners; ++i) {
+      TVector3D const& X = fT[i / 3][i % 3];
+      for (int j = 0; j != 3; ++j) {
+        double const D = X[j] + 0.0;
+        std::memcpy(&Keys[i][j], &D, sizeof(double));
+      }
+      Keys[i][3] = (int64_t) i;
+    }
+    std::sort(Keys.begin(), Keys.end());
+
+    for (size_t k = 0; k != NCorners; ++k) {
+      size_t const i = (size_t) Keys[k][3];
+      if (k == 0 || Keys[k][0] != Keys[k - 1][0] || Keys[k][1] != Keys[k - 1][1] || Keys[k][2] != Keys[k - 1][2]) {
+        fVertices.push_back(fT[i / 3][i % 3]);
+        fVertexNormals.push_back(TVector3D(0, 0, 0));
+      }
+      fFaces[i] = fVertices.size() - 1;
+    }
+  }
+
+  // Area weighted normals
+  for (size_t iT = 0; iT != fT.size(); ++iT) {
+    TVector3D const Cross = (fT[iT][1] - fT[iT][0]).Cross(fT[iT][2] - fT[iT][0]);
+    TVector3D Normal = fT[iT][3];
+    if (Normal.Mag2() == 0) {
+      Normal = Cross;
+    }
+    if (Normal.Mag2() == 0) {
+      continue;
+    }
+    Normal = Normal.UnitVector() * (0.5 * Cross.Mag());
+    for (int j = 0; j != 3; ++j) {
+      fVertexNormals[fFaces[3 * iT + j]] += Normal;
+    }
+  }
+  for (size_t i = 0; i != fVertexNormals.size(); ++i) {
+    if (fVertexNormals[i].Mag2() > 0) {
+      fVertexNormals[i] = fVertexNormals[i].UnitVector();
+    }
+  }
+
+  return;
+}
+
+
+
+
+size_t TTriangle3DContainer::GetNVertices () const
+{
+  return fVertices.size();
+}
+
+
+
+
+TVector3D const& TTriangle3DContainer::GetVertex (size_t const i) const
+{
+  return fVertices[i];
+}
+
+
+
+
+TVector3D const& TTriangle3DContainer::GetVertexNormal (size_t const i) const
+{
+  return fVertexNormals[i];
+}
+
+
+
+
+size_t TTriangle3DContainer::GetVertexIndex (size_t const iTriangle, int const iCorner) const
+{
+  return fFaces[3 * iTriangle + iCorner];
+}
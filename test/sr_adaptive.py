@@ -0,0 +1,50 @@
+# To test the sr module adaptive refinement of flux and power density rectangles
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# The resampled grid is interpolated without cracks between cells of different
+# size, and is close to a direct calculation on the same grid
+n = 101
+resampled = osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.01, 0.01], npoints=[9, 9], translation=[0, 0, 30], adaptive=0.01, max_depth=4, resample=[n, n])
+direct = osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.01, 0.01], npoints=[n, n], translation=[0, 0, 30])
+
+peak = max([x[1] for x in direct])
+error = max([abs(a[1] - b[1]) for a, b in zip(resampled, direct)]) / peak
+if error > 0.06:
+    raise Exception('resampled flux differs from the direct calculation by ' + str(error) + ' of the peak')
+
+
+# Beam with emittance.  Every round of refinement uses the same particles, so
+# the points equal a direct calculation with the same random seed
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], emittance=[0.55e-9, 0.008e-9], beta=[1.5, 0.8])
+
+osr.set_seed(1)
+adaptive = osr.calculate_power_density_rectangle(plane='XY', width=[0.06, 0.06], npoints=[9, 9], translation=[0, 0, 30], adaptive=0.01, max_depth=3, nparticles=4, dim=3, normal=0)
+osr.set_seed(1)
+direct = osr.calculate_power_density(points=[[x[0], [0, 0, 1]] for x in adaptive], normal=0, nparticles=4)
+
+peak = max([x[1] for x in direct])
+error = max([abs(a[1] - b[1]) for a, b in zip(adaptive, direct)]) / peak
+if error > 1e-9:
+    raise Exception('refinement rounds used different particles: ' + str(error) + ' of the peak')
+
+print('adaptive refinement resamples without cracks and reuses one ensemble')
@@ -0,0 +1,55 @@
+# To test the sr module analytic mode for ideal undulators
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Filament beam starting upstream of the undulator
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -3])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 6)
+
+# Energies across the first harmonic
+energies = [2740 + i for i in range(21)]
+
+
+for nperiods in [31, 250]:
+    osr.clear_bfields()
+    osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=nperiods)
+
+    osr.set_analytic_mode('off')
+    if osr.get_analytic_mode() != 'off':
+        raise Exception('get_analytic_mode does not return what was set')
+    numerical = osr.calculate_spectrum(obs=[0, 0, 80], energy_points_eV=energies)
+
+    # With the default tolerance the end fields of a short undulator are not negligible
+    osr.set_analytic_mode('auto')
+    if osr.get_analytic_mode() != 'auto':
+        raise Exception('get_analytic_mode does not return what was set')
+    spectrum = osr.calculate_spectrum(obs=[0, 0, 80], energy_points_eV=energies)
+    path = osr.get_last_calculation_path()
+    if nperiods == 31 and not path.startswith('numerical'):
+        raise Exception('analytic path taken for a short undulator with the default tolerance')
+    if nperiods == 250 and not path.startswith('analytic'):
+        raise Exception('analytic path not taken for a long undulator')
+
+    # Accepting the approximation the peak is within about 2/nperiods
+    osr.set_analytic_mode('auto', tolerance=0.1)
+    analytic = osr.calculate_spectrum(obs=[0, 0, 80], energy_points_eV=energies)
+    if not osr.get_last_calculation_path().startswith('analytic'):
+        raise Exception('analytic path not taken with a loose tolerance')
+
+    ratio = max(a[1] for a in analytic) / max(n[1] for n in numerical)
+    if abs(ratio - 1) > 3. / nperiods:
+        raise Exception('analytic peak differs from the numerical one by more than expected')
+
+    print('nperiods:', nperiods, 'analytic / numerical peak:', ratio)
+
+osr.set_analytic_mode('off')
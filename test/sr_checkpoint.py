@@ -0,0 +1,98 @@
+# To test the sr module checkpoint and resume of multi-particle calculations
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# For interrupting a run, and reading and patching the checkpoint file
+import os
+import signal
+import struct
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field and a beam similar to NSLSII with emittance so particles are random
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], emittance=[0.55e-9, 0.008e-9], beta=[1.5, 0.8])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+cpfile = 'sr_checkpoint.cp'
+copyfile = 'sr_checkpoint_copy.cp'
+
+
+# Uninterrupted run
+osr.set_seed(1)
+full = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=4)
+
+
+# The same run in a child process writing a checkpoint every 2 particles, killed after the
+# first checkpoint.  Checkpoints are written to cpfile + '.tmp' and then renamed, so making
+# that a fifo hands us the checkpoint after 2 of 4 particles as it is written
+os.mkfifo(cpfile + '.tmp')
+pid = os.fork()
+if pid == 0:
+    osr.set_seed(1)
+    osr.set_checkpoint(cpfile, 2)
+    osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=4)
+    os._exit(0)
+
+with open(cpfile + '.tmp', 'rb') as f:
+    data = f.read()
+os.kill(pid, signal.SIGKILL)
+os.waitpid(pid, 0)
+for f in [cpfile, cpfile + '.tmp']:
+    if os.path.exists(f):
+        os.remove(f)
+
+# Number of particles done follows the magic, version, type, and number of particles
+if struct.unpack('<i', data[20:24])[0] != 2:
+    raise Exception('first checkpoint is not after 2 particles')
+with open(copyfile, 'wb') as f:
+    f.write(data)
+
+# Resume from the copy with a different seed since the random state is in the checkpoint.
+# The result must be bit-identical to the uninterrupted run
+osr.set_seed(3)
+osr.set_checkpoint(copyfile, 2, resume=1)
+resumed = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=4)
+if resumed != full:
+    raise Exception('resumed spectrum differs from the uninterrupted one')
+
+
+# A resume request is used up by the next calculation even if it is single particle
+osr.set_checkpoint(copyfile, 2, resume=1)
+osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11)
+osr.set_seed(2)
+fresh = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=4)
+if fresh == full:
+    raise Exception('stale resume request was used by a later calculation')
+
+
+# A checkpoint with a corrupt random state length must be rejected.  The state is the
+# last thing in the file, preceded by its length
+with open(copyfile, 'rb') as f:
+    data = f.read()
+for i in range(len(data) - 8, 0, -1):
+    if struct.unpack('<Q', data[i:i+8])[0] == len(data) - i - 8:
+        break
+with open(copyfile, 'wb') as f:
+    f.write(data[:i] + struct.pack('<Q', 1 << 40) + data[i+8:])
+
+osr.set_checkpoint(copyfile, 2, resume=1)
+try:
+    osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=4)
+    raise Exception('corrupt checkpoint was accepted')
+except ValueError:
+    pass
+
+osr.clear_checkpoint()
+os.remove(copyfile)
+
+print('checkpoint resume ok, peak:', max(s[1] for s in full))
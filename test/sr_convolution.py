@@ -0,0 +1,81 @@
+# To test the sr module convolution emittance mode for flux and power density rectangles
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Set a seed for the montecarlo comparison
+osr.set_seed(0)
+
+# Undulator field and a beam similar to NSLSII with emittance
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], emittance=[0.55e-9, 0.008e-9], beta=[1.5, 0.8])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Single particle flux and the flux convolved with the beam size
+ideal = osr.calculate_flux_rectangle(plane='XY',
+                                     energy_eV=152,
+                                     width=[0.01, 0.01],
+                                     npoints=[21, 21],
+                                     translation=[0, 0, 30])
+flux = osr.calculate_flux_rectangle(plane='XY',
+                                    energy_eV=152,
+                                    width=[0.01, 0.01],
+                                    npoints=[21, 21],
+                                    translation=[0, 0, 30],
+                                    emittance_mode='convolution')
+
+# Same points, and the beam size can only lower the peak
+if len(flux) != len(ideal):
+    raise Exception('convolved flux has the wrong number of points')
+if max(f[1] for f in flux) > max(f[1] for f in ideal):
+    raise Exception('convolved flux peak above the single particle peak')
+
+
+# Convolution and montecarlo on the first harmonic where the central cone and the projected
+# beam size are both about 0.6 [mm].  With 400 particles the montecarlo peak and integral
+# agree with the convolution to 5% and every point to 10% of the peak
+width = [0.004, 0.004]
+npoints = [11, 11]
+flux = osr.calculate_flux_rectangle(plane='XY',
+                                    energy_eV=2750,
+                                    width=width,
+                                    npoints=npoints,
+                                    translation=[0, 0, 30],
+                                    emittance_mode='convolution')
+mc = osr.calculate_flux_rectangle(plane='XY',
+                                  energy_eV=2750,
+                                  width=width,
+                                  npoints=npoints,
+                                  translation=[0, 0, 30],
+                                  nparticles=400)
+
+peak = max(f[1] for f in mc)
+if abs(max(f[1] for f in flux) / peak - 1) > 0.05:
+    raise Exception('convolution and montecarlo peaks differ by more than 5%')
+if abs(sum(f[1] for f in flux) / sum(f[1] for f in mc) - 1) > 0.05:
+    raise Exception('convolution and montecarlo integrals differ by more than 5%')
+if max(abs(f[1] - m[1]) for f, m in zip(flux, mc)) > 0.10 * peak:
+    raise Exception('convolution and montecarlo differ by more than 10% of the peak')
+
+
+# Power density convolved with the beam size
+power_density = osr.calculate_power_density_rectangle(plane='XY',
+                                                      width=[0.05, 0.05],
+                                                      npoints=[21, 21],
+                                                      translation=[0, 0, 30],
+                                                      emittance_mode='convolution')
+if len(power_density) != 21 * 21 or min(p[1] for p in power_density) < 0:
+    raise Exception('convolved power density is wrong')
+
+print('convolution flux peak:', max(f[1] for f in flux), 'power density peak:', max(p[1] for p in power_density))
@@ -0,0 +1,48 @@
+# To test the sr module emission cone culling for power density
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+# Large surface, mostly outside the emission cone
+osr.set_emission_cone_culling(0)
+if osr.get_emission_cone_culling() != 0:
+    raise Exception('emission cone culling is not off by default')
+full = osr.calculate_power_density_rectangle(plane='XY', width=[0.2, 0.2], npoints=[21, 21], translation=[0, 0, 30])
+
+osr.set_emission_cone_culling(10)
+if osr.get_emission_cone_culling() != 10:
+    raise Exception('get_emission_cone_culling does not return what was set')
+culled = osr.calculate_power_density_rectangle(plane='XY', width=[0.2, 0.2], npoints=[21, 21], translation=[0, 0, 30])
+osr.set_emission_cone_culling(0)
+
+# Culling only drops segments which do not reach a point
+peak = max([x[1] for x in full])
+for i in range(len(full)):
+    if abs(full[i][1] - culled[i][1]) > 1e-5 * peak:
+        raise Exception('culled power density differs at point ' + str(i) + ': ' + str(full[i][1]) + ' ' + str(culled[i][1]))
+
+# A negative cone angle is not allowed
+try:
+    osr.set_emission_cone_culling(-1)
+    raise Exception('negative cone angle was accepted')
+except ValueError:
+    pass
+
+print('emission cone culling agrees with the full calculation')
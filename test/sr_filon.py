@@ -0,0 +1,52 @@
+# To test the sr module filon integrator against the riemann sum
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+# Energies up to the first harmonic
+energies = [2000 + 50 * i for i in range(20)]
+
+
+def compare(a, b, what):
+    for i in range(len(a)):
+        if abs(a[i][1] - b[i][1]) > 0.02 * max(abs(a[i][1]), abs(b[i][1])):
+            raise Exception('filon and riemann ' + what + ' differ at point ' + str(i) + ': ' + str(a[i][1]) + ' ' + str(b[i][1]))
+
+
+results = {}
+for integrator in ['riemann', 'filon']:
+    osr.set_integrator(integrator)
+    if osr.get_integrator() != integrator:
+        raise Exception('get_integrator does not return what was set')
+    for warm_start in [False, True]:
+        osr.set_warm_start(warm_start)
+        spectrum = osr.calculate_spectrum(obs=[0, 0, 30], energy_points_eV=energies)
+        flux = osr.calculate_flux_rectangle(plane='XY', width=[0.004, 0.004], npoints=[5, 5], translation=[0, 0, 30], energy_eV=2650)
+        results[(integrator, warm_start)] = (spectrum, flux)
+
+osr.set_integrator('riemann')
+osr.set_warm_start(False)
+
+# Filon sums over all points up to the converged level and agrees with riemann
+for key in results:
+    compare(results[('riemann', False)][0], results[key][0], 'spectrum')
+    compare(results[('riemann', False)][1], results[key][1], 'flux')
+
+print('filon integrator agrees with riemann')
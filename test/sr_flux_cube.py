@@ -0,0 +1,63 @@
+# To test the sr module flux at many energies in one pass (flux cube)
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+# Energies across the first harmonic
+energies = [2600, 2700, 2750, 2800]
+rectangle = dict(plane='XY', width=[0.004, 0.004], npoints=[5, 5], translation=[0, 0, 30])
+
+cube = osr.calculate_flux_cube(energy_points_eV=energies, **rectangle)
+if len(cube) != 25 or len(cube[0][1]) != len(energies):
+    raise Exception('flux cube has the wrong shape')
+
+# Each energy keeps its own convergence test, so every slice agrees with the map at
+# that energy to the precision
+for k in range(len(energies)):
+    flux = osr.calculate_flux_rectangle(energy_eV=energies[k], **rectangle)
+    for i in range(len(flux)):
+        a = flux[i][1]
+        b = cube[i][1][k]
+        if abs(a - b) > 0.02 * abs(a):
+            raise Exception('flux cube differs from the flux map at energy ' + str(energies[k]) + ' point ' + str(i) + ': ' + str(a) + ' ' + str(b))
+
+# An energy range gives the same as the list of its energies
+ranged = osr.calculate_flux_cube(energy_range_eV=[2600, 2800], nenergies=3, **rectangle)
+listed = osr.calculate_flux_cube(energy_points_eV=[2600, 2700, 2800], **rectangle)
+for i in range(len(ranged)):
+    if ranged[i][1] != listed[i][1]:
+        raise Exception('flux cube from an energy range differs from the energy list at point ' + str(i))
+
+# The cube does not use the filon integrator.  It warns and gives the riemann result
+osr.set_integrator('filon')
+filon = osr.calculate_flux_cube(energy_points_eV=energies, **rectangle)
+osr.set_integrator('riemann')
+for i in range(len(cube)):
+    if filon[i][1] != cube[i][1]:
+        raise Exception('flux cube with the filon integrator set differs at point ' + str(i))
+
+# Energies are required
+try:
+    osr.calculate_flux_cube(**rectangle)
+    raise Exception('flux cube without energies accepted')
+except ValueError:
+    pass
+
+print('flux cube agrees with the flux maps')
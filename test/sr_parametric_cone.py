@@ -0,0 +1,42 @@
+# To test the sr module power density on a native parametric cone with its apex
+
+# Import the OSCARS SR module
+import oscars.sr
+import oscars.parametric_surfaces
+
+import math
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Cone with its apex (r0 = 0) on the beam axis, opening away from the source.
+# The first row of points is the apex, which must have a finite normal
+nv = 8
+cone = oscars.parametric_surfaces.PSCone(r0=0, r1=0.01, L=0.1, nu=5, nv=nv)
+pd = osr.calculate_power_density(surface=cone, translation=[0, 0, 30], normal=1)
+
+for x in pd:
+    if math.isnan(x[1]) or math.isinf(x[1]):
+        raise Exception('power density is not finite at ' + str(x[0]))
+
+# All points of the apex are the same point with the same normal
+apex = [x[1] for x in pd[:nv]]
+if max(apex) - min(apex) > 1e-6 * max(apex) or max(apex) <= 0:
+    raise Exception('apex power density differs between its points: ' + str(apex))
+
+print('parametric cone power density is finite at the apex')
@@ -0,0 +1,41 @@
+# To test the sr module multi-process particle sharding
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(2)
+
+# Undulator field and a filament beam so that every particle is the ideal one
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Single particle references
+spectrum = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11)
+flux = osr.calculate_flux_rectangle(plane='XY', energy_eV=152, width=[0.01, 0.01], npoints=[11, 11], translation=[0, 0, 30])
+
+
+# The same split over processes, twice to check the shared memory is released
+osr.set_nprocesses_global(3)
+for i in range(2):
+    s = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=5)
+    f = osr.calculate_flux_rectangle(plane='XY', energy_eV=152, width=[0.01, 0.01], npoints=[11, 11], translation=[0, 0, 30], nparticles=5)
+
+    for a, b in zip(spectrum, s):
+        if abs(a[1] - b[1]) > 1e-9 * abs(a[1]):
+            raise Exception('spectrum from processes differs from the single particle')
+    for a, b in zip(flux, f):
+        if abs(a[1] - b[1]) > 1e-9 * abs(a[1]) + 1e-30:
+            raise Exception('flux from processes differs from the single particle')
+osr.set_nprocesses_global(1)
+
+print('process sharding ok, spectrum peak:', max(x[1] for x in s))
@@ -0,0 +1,57 @@
+# To test the sr module chunked result files and their averaging
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# For removing the output files
+import os
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field and a beam similar to NSLSII with emittance so particles are random
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], emittance=[0.55e-9, 0.008e-9], beta=[1.5, 0.8])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Two multi-particle spectra appended as chunks to the same file.  The average
+# weighted by the number of particles must match the two results.
+if os.path.exists('sr_result_file_spectrum.bin'):
+    os.remove('sr_result_file_spectrum.bin')
+s1 = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=2, cofile='sr_result_file_spectrum.bin')
+s2 = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[100, 200], npoints=11, nparticles=6, cofile='sr_result_file_spectrum.bin')
+avg = osr.average_spectra(cifiles=['sr_result_file_spectrum.bin'])
+
+for a, b, c in zip(s1, s2, avg):
+    expected = (2 * a[1] + 6 * b[1]) / 8
+    if abs(c[1] - expected) > 1e-9 * abs(expected):
+        raise Exception('chunked spectrum average is wrong')
+
+
+# Flux chunks in two files merged with several threads
+for f in ['sr_result_file_flux_0.bin', 'sr_result_file_flux_1.bin']:
+    if os.path.exists(f):
+        os.remove(f)
+f1 = osr.calculate_flux_rectangle(plane='XY', energy_eV=152, width=[0.01, 0.01], npoints=[11, 11], translation=[0, 0, 30], nparticles=2, cofile='sr_result_file_flux_0.bin')
+f2 = osr.calculate_flux_rectangle(plane='XY', energy_eV=152, width=[0.01, 0.01], npoints=[11, 11], translation=[0, 0, 30], nparticles=2, cofile='sr_result_file_flux_1.bin')
+favg = osr.average_flux(cifiles=['sr_result_file_flux_0.bin', 'sr_result_file_flux_1.bin'], nthreads=2)
+
+if len(favg) != len(f1):
+    raise Exception('chunked flux average has the wrong number of points')
+for a, b, c in zip(f1, f2, favg):
+    expected = (a[1] + b[1]) / 2
+    if abs(c[1] - expected) > 1e-9 * abs(expected):
+        raise Exception('chunked flux average is wrong')
+
+for f in ['sr_result_file_spectrum.bin', 'sr_result_file_flux_0.bin', 'sr_result_file_flux_1.bin']:
+    os.remove(f)
+
+print('chunked averages ok, spectrum peak:', max(s[1] for s in avg), 'flux peak:', max(f[1] for f in favg))
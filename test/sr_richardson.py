@@ -0,0 +1,59 @@
+# To test the sr module richardson convergence mode against level mode
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -0.3])
+
+# The trajectory starts and stops inside the undulator, where the level sums only
+# converge slowly and the extrapolation pays off
+osr.set_ctstartstop(0, 0.6)
+
+# Energies across the first harmonics
+energies = [1000 + 740 * i for i in range(10)]
+
+
+def run(mode, precision):
+    osr.set_convergence_mode(mode)
+    if osr.get_convergence_mode() != mode:
+        raise Exception('get_convergence_mode does not return what was set')
+    spectrum = osr.calculate_spectrum(obs=[0, 0, 30], energy_points_eV=energies, precision=precision)
+    spectrum_levels = osr.calculate_spectrum(obs=[0, 0, 30], energy_points_eV=energies, precision=precision, quantity='level')
+    power = osr.calculate_power_density_rectangle(plane='XY', width=[0.02, 0.02], npoints=[3, 3], translation=[0, 0, 30], precision=precision)
+    power_levels = osr.calculate_power_density_rectangle(plane='XY', width=[0.02, 0.02], npoints=[3, 3], translation=[0, 0, 30], precision=precision, quantity='level')
+    osr.set_convergence_mode('level')
+    return spectrum, sum([x[1] for x in spectrum_levels]), power, sum([x[1] for x in power_levels])
+
+
+reference = run('richardson', 1e-6)
+for precision in [0.01, 0.001]:
+    level = run('level', precision)
+    richardson = run('richardson', precision)
+
+    # Same result to the requested precision
+    for result in [level, richardson]:
+        for i in [0, 2]:
+            for j in range(len(reference[i])):
+                a = reference[i][j][1]
+                b = result[i][j][1]
+                if abs(a - b) > 2 * precision * abs(a):
+                    raise Exception('result differs from the reference at point ' + str(j) + ': ' + str(a) + ' ' + str(b))
+
+    # The extrapolated error estimate stops earlier than level mode
+    if richardson[1] >= level[1] or richardson[3] > level[3]:
+        raise Exception('richardson does not stop earlier than level mode: ' + str(richardson[1]) + ' ' + str(level[1]) + ' ' + str(richardson[3]) + ' ' + str(level[3]))
+    print('precision', precision, 'spectrum levels', level[1], richardson[1], 'power density levels', level[3], richardson[3])
+
+print('richardson convergence mode agrees with level mode and stops earlier')
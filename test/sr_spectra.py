@@ -0,0 +1,53 @@
+# To test the sr module spectra at several observation points in one call
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+# A few points and energies across the first harmonic
+obs = [[0, 0, 30], [0.001, 0, 30], [0, 0.001, 30]]
+energies = [2600 + 25 * i for i in range(9)]
+
+# Reference spectrum at each point
+osr.set_nthreads_global(1)
+reference = [osr.calculate_spectrum(obs=o, energy_points_eV=energies) for o in obs]
+
+# Fewer points than threads, with a number of threads which does not divide evenly
+# over the points, so that the energies of a point are shared between threads
+for nthreads in [1, 2, 7]:
+    energy_eV, flux = osr.calculate_spectra(obs=obs, energy_points_eV=energies, nthreads=nthreads)
+    flux = flux.tolist()
+    if energy_eV != [r[0] for r in reference[0]]:
+        raise Exception('calculate_spectra energies are wrong: ' + str(energy_eV))
+    if len(flux) != len(obs) or any(len(row) != len(energies) for row in flux):
+        raise Exception('calculate_spectra flux has the wrong shape')
+
+    # Each energy keeps its own convergence test, so the spectra are the same
+    for i in range(len(obs)):
+        for k in range(len(energies)):
+            a = reference[i][k][1]
+            b = flux[i][k]
+            if abs(a - b) > 1e-9 * abs(a):
+                raise Exception('calculate_spectra differs from calculate_spectrum with ' + str(nthreads) + ' threads at point ' + str(i) + ' energy ' + str(energies[k]) + ': ' + str(a) + ' ' + str(b))
+
+# An observation point is required
+try:
+    osr.calculate_spectra(obs=[], energy_points_eV=energies)
+    raise Exception('calculate_spectra without points accepted')
+except ValueError:
+    pass
+
+print('calculate_spectra agrees with calculate_spectrum')
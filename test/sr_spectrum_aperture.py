@@ -0,0 +1,56 @@
+# To test the sr module flux through an aperture versus energy
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# A 2 x 1 mm slit at 30 m.  The flux through it in photons/s/0.1%bw is the
+# integral over the slit of the flux density in photons/s/0.1%bw/mm^2
+energies = [2500, 2600, 2700]
+aperture = osr.calculate_spectrum_aperture(width=[0.002, 0.001], translation=[0, 0, 30], energy_points_eV=energies, max_depth=2)
+npoints_ideal = osr.get_last_calculation_path()
+
+n1, n2 = 21, 11
+flux = osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.002, 0.001], npoints=[n1, n2], translation=[0, 0, 30])
+total = 0
+for i in range(n1):
+    for j in range(n2):
+        w1 = 0.5 if i in (0, n1 - 1) else 1
+        w2 = 0.5 if j in (0, n2 - 1) else 1
+        total += w1 * w2 * flux[i * n2 + j][1]
+total *= (2. / (n1 - 1)) * (1. / (n2 - 1))
+
+if abs(aperture[1][1] - total) > 0.02 * total:
+    raise Exception('aperture flux ' + str(aperture[1][1]) + ' does not match the integrated flux density ' + str(total))
+
+
+# Beam with emittance.  The same particles are used at every point, so Monte
+# Carlo noise between points does not drive the refinement
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], emittance=[0.55e-9, 0.008e-9], beta=[1.5, 0.8])
+osr.set_seed(2)
+osr.calculate_spectrum_aperture(width=[0.002, 0.001], translation=[0, 0, 30], energy_points_eV=energies, max_depth=2, nparticles=4)
+npoints_ensemble = osr.get_last_calculation_path()
+
+n_ideal = int(npoints_ideal.split('aperture: ')[1].split(' ')[0])
+n_ensemble = int(npoints_ensemble.split('aperture: ')[1].split(' ')[0])
+if n_ensemble > 1.5 * n_ideal:
+    raise Exception('ensemble refined to ' + str(n_ensemble) + ' points compared to ' + str(n_ideal) + ' for one particle')
+
+print('aperture flux matches the flux density and one ensemble is used for all points')
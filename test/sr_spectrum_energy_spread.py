@@ -0,0 +1,39 @@
+# To test the sr module energy spread convolution for spectra
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field and a beam with energy spread
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1], sigma_energy_GeV=0.003)
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Spectrum with the energy spread by convolution, including one far away energy
+energies = [300 + 20 * i for i in range(20)] + [5000]
+spectrum = osr.calculate_spectrum(obs=[0, 0, 30],
+                                  energy_points_eV=energies,
+                                  energy_spread_mode='convolution')
+
+if len(spectrum) != len(energies) or min(s[1] for s in spectrum) <= 0:
+    raise Exception('energy spread spectrum is wrong')
+
+
+# Energies must be positive
+try:
+    osr.calculate_spectrum(obs=[0, 0, 30], energy_points_eV=[0, 100], energy_spread_mode='convolution')
+    raise Exception('zero energy was accepted')
+except ValueError:
+    pass
+
+print('energy spread spectrum at', spectrum[0][0], 'eV:', spectrum[0][1])
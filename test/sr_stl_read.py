@@ -0,0 +1,65 @@
+# To test the sr module reading of binary STL files and vertex welding
+
+# Import the OSCARS SR module
+import oscars.sr
+
+import os
+import struct
+import tempfile
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# Two triangles at 30 m whose first corners are 1 um apart, on either side of
+# x = 2 mm
+triangles = [
+    [[0.002,    0,     30], [0.003, 0, 30], [0.002, 0.001, 30]],
+    [[0.001999, 0,     30], [0.002, 0.001, 30], [0.001, 0, 30]],
+]
+
+# Binary STL whose header starts with "solid" and which has trailing bytes, as
+# written by some exporters
+fd, stl_file = tempfile.mkstemp(suffix='.stl')
+with os.fdopen(fd, 'wb') as f:
+    f.write(b'solid binary header'.ljust(80, b' '))
+    f.write(struct.pack('<I', len(triangles)))
+    for t in triangles:
+        f.write(struct.pack('<3f', 0, 0, -1))
+        for v in t:
+            f.write(struct.pack('<3f', *v))
+        f.write(struct.pack('<H', 0))
+    f.write(b'\n\n')
+
+try:
+    pd = osr.calculate_power_density_stl(ifile=stl_file, normal=0, evaluate='vertex', weld_tolerance=0.001)
+finally:
+    os.remove(stl_file)
+
+if len(pd) != len(triangles):
+    raise Exception('binary STL with a solid header not read as binary: ' + str(len(pd)) + ' triangles')
+
+# The close corners are in neighbouring cubes of side weld_tolerance but are
+# still welded, so they have the same power density
+if pd[0][1][0] != pd[1][1][0]:
+    raise Exception('corners within the weld tolerance are not welded: ' + str(pd[0][1][0]) + ' ' + str(pd[1][1][0]))
+
+# The shared corner is welded
+if pd[0][1][2] != pd[1][1][1]:
+    raise Exception('identical corners are not welded: ' + str(pd[0][1][2]) + ' ' + str(pd[1][1][1]))
+
+print('binary STL with a solid header read and close vertices welded')
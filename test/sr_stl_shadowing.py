@@ -0,0 +1,69 @@
+# To test the sr module line of sight shadowing for power density on STL triangles
+
+# Import the OSCARS SR module
+import oscars.sr
+
+import os
+import tempfile
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+def square(f, x0, y0, x1, y1, z):
+    # Two triangles of a square in the plane z facing the beam
+    for t in [[[x0, y0, z], [x1, y0, z], [x1, y1, z]], [[x0, y0, z], [x1, y1, z], [x0, y1, z]]]:
+        f.write('facet normal 0 0 -1\n outer loop\n')
+        for v in t:
+            f.write('  vertex ' + ' '.join([str(c) for c in v]) + '\n')
+        f.write(' endloop\nendfacet\n')
+
+
+# A small blocker at 20 m in front of a target at 30 m, in one ASCII STL file
+fd, stl_file = tempfile.mkstemp(suffix='.stl')
+with os.fdopen(fd, 'w') as f:
+    f.write('solid shadowing\n')
+    square(f, -0.002, -0.002, 0.002, 0.002, 20)
+    n = 10
+    for i in range(n):
+        for j in range(n):
+            square(f, -0.01 + 0.02 * i / n, -0.01 + 0.02 * j / n, -0.01 + 0.02 * (i + 1) / n, -0.01 + 0.02 * (j + 1) / n, 30)
+    f.write('endsolid shadowing\n')
+
+try:
+    full = osr.calculate_power_density_stl(ifile=stl_file, normal=0)
+    shadowed = osr.calculate_power_density_stl(ifile=stl_file, normal=0, shadowing=1)
+
+    # A later calculation must not see the triangles of this one
+    osr.calculate_power_density_rectangle(plane='XY', width=[0.01, 0.01], npoints=[3, 3], translation=[0, 0, 30])
+finally:
+    os.remove(stl_file)
+
+if len(full) != 2 + 2 * n * n or len(shadowed) != len(full):
+    raise Exception('wrong number of triangles: ' + str(len(full)) + ' ' + str(len(shadowed)))
+
+peak = max([x[1] for x in full])
+for i in range(len(full)):
+    center = [sum([v[k] for v in full[i][0]]) / 3. for k in range(3)]
+    behind = center[2] > 25 and abs(center[0]) < 0.0025 and abs(center[1]) < 0.0025
+    clear = center[2] < 25 or abs(center[0]) > 0.004 or abs(center[1]) > 0.004
+    if behind and shadowed[i][1] > 1e-3 * peak:
+        raise Exception('triangle behind the blocker is not shadowed: ' + str(center) + ' ' + str(shadowed[i][1]))
+    if clear and abs(shadowed[i][1] - full[i][1]) > 1e-6 * peak:
+        raise Exception('triangle in the clear is shadowed: ' + str(center) + ' ' + str(full[i][1]) + ' ' + str(shadowed[i][1]))
+
+print('stl shadowing hides the triangles behind the blocker')
@@ -0,0 +1,53 @@
+# To test the sr module mirror symmetry of flux and power density rectangles
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+
+# The trajectory is slightly off the centre line in X, so the flux is symmetric
+# in Y only.  The difference in X is about 0.5% of the peak, within the default
+# precision, and must not be mirrored away
+n = 11
+full = osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.004, 0.002], npoints=[n, n], translation=[0, 0, 30])
+auto = osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.004, 0.002], npoints=[n, n], translation=[0, 0, 30], symmetry='auto')
+path = osr.get_last_calculation_path()
+if 'symmetry: x2)' not in path:
+    raise Exception('wrong automatic symmetry: ' + path)
+
+peak = max([x[1] for x in full])
+error = max([abs(a[1] - b[1]) for a, b in zip(auto, full)]) / peak
+if error > 1e-6:
+    raise Exception('automatic symmetry differs from the full calculation by ' + str(error) + ' of the peak')
+
+# Power density likewise
+full = osr.calculate_power_density_rectangle(plane='XY', width=[0.04, 0.02], npoints=[n, n], translation=[0, 0, 30])
+auto = osr.calculate_power_density_rectangle(plane='XY', width=[0.04, 0.02], npoints=[n, n], translation=[0, 0, 30], symmetry='auto')
+path = osr.get_last_calculation_path()
+if 'symmetry: x2)' not in path:
+    raise Exception('wrong automatic symmetry for power density: ' + path)
+
+# Circular polarizations change hand under reflection
+try:
+    osr.calculate_flux_rectangle(energy_eV=2600, plane='XY', width=[0.004, 0.002], npoints=[n, n], translation=[0, 0, 30], polarization='circular-left', symmetry='x2')
+    raise Exception('symmetry accepted for circular polarization')
+except ValueError:
+    pass
+
+print('automatic symmetry keeps small asymmetries, circular polarization rejected')
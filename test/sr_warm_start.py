@@ -0,0 +1,51 @@
+# To test the sr module warm start of the trajectory levels
+
+# Import the OSCARS SR module
+import oscars.sr
+
+# Create a new OSCARS object
+osr = oscars.sr.sr()
+
+# One thread, so the points follow each other in one thread and warm start from
+# their neighbours
+osr.set_nthreads_global(1)
+
+# Undulator field
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+
+# Filament beam
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+
+# Set the start and stop times for the calculation
+osr.set_ctstartstop(0, 2)
+
+# Close energies and a large power density surface mostly outside the emission
+# cone, where neighbouring points converge at about the same level
+energies = [2500 + 5 * i for i in range(60)]
+
+results = {}
+for warm_start in [False, True]:
+    osr.set_warm_start(warm_start)
+    if osr.get_warm_start() != warm_start:
+        raise Exception('get_warm_start does not return what was set')
+    spectrum = osr.calculate_spectrum(obs=[0, 0, 30], energy_points_eV=energies, precision=0.001)
+    power = osr.calculate_power_density_rectangle(plane='XY', width=[0.1, 0.1], npoints=[11, 11], translation=[0, 0, 30])
+    levels = osr.calculate_power_density_rectangle(plane='XY', width=[0.1, 0.1], npoints=[11, 11], translation=[0, 0, 30], quantity='level')
+    results[warm_start] = (spectrum, sum([x[1] for x in levels]), power)
+osr.set_warm_start(False)
+
+# Same result to the requested precision
+for i in [0, 2]:
+    for j in range(len(results[False][i])):
+        a = results[False][i][j][1]
+        b = results[True][i][j][1]
+        if abs(a - b) > 0.02 * abs(a) and abs(a - b) > 1e-6:
+            raise Exception('warm start changes the result at point ' + str(j) + ': ' + str(a) + ' ' + str(b))
+
+# Accepting points from below the usual floor lowers the levels used
+if results[True][1] >= results[False][1]:
+    raise Exception('warm start does not lower the levels: ' + str(results[True][1]) + ' ' + str(results[False][1]))
+
+print('warm start levels', results[False][1], results[True][1])
@@ -0,0 +1,59 @@
+# To test the th module dipole spectrum against an independent Bessel K evaluation
+
+# Import the OSCARS TH module
+import oscars.th
+
+# For the reference integrals
+import math
+
+# Create a new OSCARS object
+oth = oscars.th.th()
+
+# Beam similar to NSLSII
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# Reference values from Kostroun's series with a fine step, evaluated here in python
+#   K_nu(x)           = h sum' exp(-x cosh(rh)) cosh(nu rh)
+#   int_x^inf K_nu(t) = h sum' exp(-x cosh(rh)) cosh(nu rh) / cosh(rh)
+def kostroun(nu, x, integral):
+    h = 0.01
+    s = 0.5 * math.exp(-x)
+    r = 1
+    while True:
+        c = math.cosh(r * h)
+        t = math.exp(-x * c) * math.cosh(nu * r * h)
+        if integral:
+            t /= c
+        s += t
+        if t < 1e-18 * s:
+            break
+        r += 1
+    return s * h
+
+
+bfield = 0.4
+ec = oth.dipole_critical_energy(bfield=bfield)
+y = [0.001, 0.01, 0.1, 0.5, 1, 2, 5, 10, 20, 40]
+energies = [ec * v for v in y]
+
+
+# Angle integrated spectrum is proportional to y * int_y^inf K_5/3.  Compare shapes
+# normalized at y = 1
+flux = oth.dipole_spectrum(bfield=bfield, energy_points_eV=energies, angle_integrated=True)
+ref = [v * kostroun(5. / 3., v, True) for v in y]
+norm = flux[4][1] / ref[4]
+for f, r in zip(flux, ref):
+    if abs(f[1] - norm * r) > 1e-9 * norm * r:
+        raise Exception('angle integrated dipole spectrum disagrees with the reference')
+
+
+# On axis the spectrum is proportional to y^2 K_2/3(y/2)^2
+flux = oth.dipole_spectrum(bfield=bfield, energy_points_eV=energies, angle=0)
+ref = [(v * kostroun(2. / 3., v / 2, False))**2 for v in y]
+norm = flux[4][1] / ref[4]
+for f, r in zip(flux, ref):
+    if abs(f[1] - norm * r) > 1e-9 * norm * r:
+        raise Exception('on axis dipole spectrum disagrees with the reference')
+
+print('dipole spectrum agrees with the reference, critical energy:', ec)
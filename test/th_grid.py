@@ -0,0 +1,40 @@
+# To test the th module batched dipole and undulator grids against the per-point functions
+
+# Import the OSCARS TH module
+import oscars.th
+
+# Create a new OSCARS object
+oth = oscars.th.th()
+
+# Beam similar to NSLSII, with beta and emittance for brightness
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# Dipole flux on an angle x energy grid, each row against dipole_spectrum at that angle
+energies = [100, 1000, 2394, 5000, 20000]
+angles = [-0.0005, -0.0001, 0, 0.0002, 0.0005]
+grid = oth.dipole_spectrum_grid(bfield=0.4, energies_eV=energies, angles=angles, nthreads=3).tolist()
+if len(grid) != len(angles) or len(grid[0]) != len(energies):
+    raise Exception('dipole grid has the wrong shape')
+
+for i, a in enumerate(angles):
+    row = oth.dipole_spectrum(bfield=0.4, energy_points_eV=energies, angle=a, nthreads=1)
+    for j in range(len(energies)):
+        if grid[i][j] != row[j][1] or grid[i][j] <= 0:
+            raise Exception('dipole grid differs from dipole_spectrum')
+
+
+# Undulator brightness on a harmonic x K grid, each row against undulator_brightness
+harmonics = [1, 3, 5]
+K = [0.5, 1.0, 1.5, 2.0]
+e, b = oth.undulator_brightness_grid(period=0.021, nperiods=100, harmonics=harmonics, K_points=K, nthreads=2)
+e = e.tolist()
+b = b.tolist()
+
+for i, h in enumerate(harmonics):
+    row = oth.undulator_brightness(period=0.021, nperiods=100, harmonic=h, K_points=K, nthreads=1)
+    for j in range(len(K)):
+        if e[i][j] != row[j][0] or b[i][j] != row[j][1] or b[i][j] <= 0:
+            raise Exception('undulator brightness grid differs from undulator_brightness')
+
+print('grids agree, first harmonic brightness:', b[0])
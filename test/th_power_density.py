@@ -0,0 +1,32 @@
+# To test the th module analytic undulator power density
+
+# Import the OSCARS TH module
+import oscars.th
+
+# Create a new OSCARS object
+oth = oscars.th.th()
+
+# Beam similar to NSLSII
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# The power density summed over a surface catching the whole fan must give the total
+# power P [kW] = 0.633 E^2 [GeV^2] B^2 [T^2] L [m] I [A]
+npoints = 101
+width = 0.04
+power_density = oth.undulator_power_density_rectangle(plane='XY', period=0.021, nperiods=100, npoints=[npoints, npoints], width=[width, width], bfield=0.5, translation=[0, 0, 30])
+
+area = (width / (npoints - 1) * 1000.)**2
+power = sum(p[1] for p in power_density) * area
+expected = 0.633 * 3**2 * 0.5**2 * (0.021 * 100) * 0.5 * 1000.
+if abs(power / expected - 1) > 0.01:
+    raise Exception('total power from the power density is wrong')
+
+
+# Tilting the surface lowers every point by the incidence angle
+tilted = oth.undulator_power_density_rectangle(plane='XY', period=0.021, nperiods=100, npoints=[5, 5], width=[0.002, 0.002], bfield=0.5, translation=[0, 0, 30], rotations=[0.5, 0, 0])
+flat = oth.undulator_power_density_rectangle(plane='XY', period=0.021, nperiods=100, npoints=[5, 5], width=[0.002, 0.002], bfield=0.5, translation=[0, 0, 30])
+if max(t[1] for t in tilted) >= max(f[1] for f in flat):
+    raise Exception('tilted surface does not lower the power density')
+
+print('power density ok, total power [W]:', power)
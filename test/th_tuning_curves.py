@@ -0,0 +1,43 @@
+# To test the th module undulator tuning curves
+
+# Import the OSCARS TH module
+import oscars.th
+
+# Create a new OSCARS object
+oth = oscars.th.th()
+
+# Beam similar to NSLSII, with beta and emittance for brightness
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# Tuning curves for several harmonics against the single harmonic functions
+harmonics = [1, 2, 3, 5, 7]
+K = [0.3, 0.8, 1.2, 1.9, 2.5]
+e, f, b = oth.undulator_tuning_curves(period=0.021, nperiods=100, harmonics=harmonics, K_points=K, brightness=True, nthreads=3)
+e = e.tolist()
+f = f.tolist()
+b = b.tolist()
+
+for i, h in enumerate(harmonics):
+    if h % 2 == 0:
+        if max(f[i]) != 0 or max(b[i]) != 0:
+            raise Exception('even harmonic is not zero')
+        continue
+
+    onaxis = oth.undulator_flux_onaxis(period=0.021, nperiods=100, harmonic=h, K_points=K)
+    brightness = oth.undulator_brightness(period=0.021, nperiods=100, harmonic=h, K_points=K, nthreads=1)
+    for j in range(len(K)):
+        if abs(e[i][j] / onaxis[j][0] - 1) > 1e-12 or abs(f[i][j] / onaxis[j][1] - 1) > 1e-12:
+            raise Exception('tuning curve flux disagrees with undulator_flux_onaxis')
+        if abs(b[i][j] / brightness[j][1] - 1) > 1e-12:
+            raise Exception('tuning curve brightness disagrees with undulator_brightness')
+
+
+# Harmonic numbers below 1 are rejected
+try:
+    oth.undulator_tuning_curves(period=0.021, nperiods=100, harmonics=[1, 0], K_points=K)
+    raise Exception('harmonic 0 was accepted')
+except ValueError:
+    pass
+
+print('tuning curves ok, first harmonic flux:', f[0])
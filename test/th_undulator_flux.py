@@ -0,0 +1,52 @@
+# To test the th module analytic undulator flux
+
+# Import the OSCARS TH and SR modules
+import oscars.th
+import oscars.sr
+
+# Create new OSCARS objects
+oth = oscars.th.th()
+osr = oscars.sr.sr()
+
+# Set default number of threads
+osr.set_nthreads_global(8)
+
+# Beam similar to NSLSII
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# At the harmonic peaks on axis the spectrum must agree with undulator_flux_onaxis
+K = oth.undulator_K(bfield=0.5, period=0.021)
+for harmonic in [1, 3, 5]:
+    onaxis = oth.undulator_flux_onaxis(period=0.021, nperiods=31, harmonic=harmonic, K_points=[K])
+    flux = oth.undulator_flux(period=0.021, nperiods=31, K=K, energy_eV=onaxis[0][0])
+    if abs(flux[0][1] / onaxis[0][1] - 1) > 1e-6:
+        raise Exception('undulator_flux disagrees with undulator_flux_onaxis')
+
+# On a rectangle at 30 m the centre is the on axis flux per mrad^2 over 30^2 and the
+# map is symmetric about the axis
+rectangle = oth.undulator_flux_rectangle(plane='XY', energy_eV=flux[0][0], period=0.021, nperiods=31, K=K, npoints=[5, 5], width=[0.004, 0.004], translation=[0, 0, 30])
+if abs(rectangle[12][1] * 900. / flux[0][1] - 1) > 1e-6:
+    raise Exception('undulator_flux_rectangle centre disagrees with undulator_flux')
+for i in range(len(rectangle)):
+    if abs(rectangle[i][1] - rectangle[24 - i][1]) > 1e-6 * rectangle[12][1]:
+        raise Exception('undulator_flux_rectangle is not symmetric about the axis')
+
+
+# The first harmonic summed over energy must agree with the numerical calculation at
+# 30 m up to the extra effective period from the end fields
+osr.clear_bfields()
+osr.add_bfield_undulator(bfield=[0, 0.5, 0], period=[0, 0, 0.021], nperiods=31)
+osr.clear_particle_beams()
+osr.set_particle_beam(beam='NSLSII', name='beam_0', x0=[0, 0, -1])
+osr.set_ctstartstop(0, 2)
+
+numerical = osr.calculate_spectrum(obs=[0, 0, 30], energy_range_eV=[2600, 2900], npoints=61)
+analytic = oth.undulator_flux(period=0.021, nperiods=31, bfield=0.5, energy_range_eV=[2600, 2900], npoints=61)
+
+# [photons / s / 0.1%bw / mrad^2] to [photons / s / 0.1%bw / mm^2] at 30 m
+ratio = sum(a[1] / a[0] for a in analytic) / 900. / sum(n[1] / n[0] for n in numerical)
+if abs(ratio - 1) > 0.1:
+    raise Exception('undulator_flux first harmonic disagrees with calculate_spectrum')
+
+print('undulator flux ok, analytic / numerical first harmonic:', ratio)
@@ -0,0 +1,26 @@
+# To test the th module multi-energy wiggler flux
+
+# Import the OSCARS TH module
+import oscars.th
+
+# Create a new OSCARS object
+oth = oscars.th.th()
+
+# Beam similar to NSLSII
+oth.set_particle_beam(beam='NSLSII', name='beam_0')
+
+
+# All energies in one threaded call against one call per energy on a single thread
+energies = [1000, 2750, 5000, 20000]
+points, flux = oth.wiggler_flux(plane='XY', period=0.1, nperiods=20, npoints=[7, 5], width=[0.02, 0.002], bfield=1.5, translation=[0, 0, 30], energies_eV=energies, nthreads=3)
+flux = flux.tolist()
+if len(points) != 7 * 5 or len(flux) != 7 * 5 or len(flux[0]) != len(energies):
+    raise Exception('multi-energy wiggler flux has the wrong shape')
+
+for k, energy in enumerate(energies):
+    single = oth.wiggler_flux(plane='XY', period=0.1, nperiods=20, npoints=[7, 5], width=[0.02, 0.002], bfield=1.5, translation=[0, 0, 30], energy_eV=energy, nthreads=1)
+    for i in range(len(single)):
+        if single[i][0] != points[i] or single[i][1] != flux[i][k] or single[i][1] <= 0:
+            raise Exception('multi-energy wiggler flux differs from the single energy result')
+
+print('wiggler flux ok, on axis:', flux[len(flux) // 2])